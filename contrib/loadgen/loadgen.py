@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018-2020 The NIX Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Sustained load on a regtest nixd: payments, sigma mints and spends, blocks.
+
+Every workload runs on its own thread at a fixed rate for the given duration.
+At the end the throughput and latency percentiles of each RPC are printed,
+together with the ConnectBlock phase times the node measured meanwhile
+(from getperfinfo).
+"""
+
+import argparse
+import os
+import sys
+import threading
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'test', 'functional'))
+from test_framework.authproxy import AuthServiceProxy, JSONRPCException  # noqa: E402
+
+REGTEST_RPC_PORT = 16216
+
+
+def rpc_url(args):
+    if args.rpcuser:
+        user, password = args.rpcuser, args.rpcpassword
+    else:
+        with open(os.path.join(args.datadir, 'regtest', '.cookie'), 'r', encoding='utf8') as f:
+            user, password = f.read().strip().split(':', 1)
+    return 'http://%s:%s@%s:%d' % (user, password, args.rpchost, args.rpcport)
+
+
+class Stats:
+    """Latencies of the calls of one workload"""
+
+    def __init__(self, name):
+        self.name = name
+        self.latencies = []
+        self.errors = 0
+        self.lock = threading.Lock()
+
+    def add(self, seconds):
+        with self.lock:
+            self.latencies.append(seconds)
+
+    def add_error(self):
+        with self.lock:
+            self.errors += 1
+
+    def report(self, duration):
+        with self.lock:
+            lat = sorted(self.latencies)
+            errors = self.errors
+        if not lat:
+            print('%-14s %8d ok %6d errors' % (self.name, 0, errors))
+            return
+
+        def pct(p):
+            return lat[min(len(lat) - 1, int(len(lat) * p / 100))] * 1000
+        print('%-14s %8d ok %6d errors %8.2f/s  p50 %8.1fms  p90 %8.1fms  p99 %8.1fms  max %8.1fms' % (
+            self.name, len(lat), errors, len(lat) / duration, pct(50), pct(90), pct(99), lat[-1] * 1000))
+
+
+def run_workload(args, stats, rate, call, stop):
+    """Call call(rpc) rate times a second until stop is set"""
+    rpc = AuthServiceProxy(rpc_url(args), timeout=600)
+    interval = 1.0 / rate
+    next_call = time.time()
+    while not stop.is_set():
+        start = time.time()
+        try:
+            call(rpc)
+            stats.add(time.time() - start)
+        except JSONRPCException as e:
+            stats.add_error()
+            if args.verbose:
+                print('%s: %s' % (stats.name, e.error['message']), file=sys.stderr)
+        next_call += interval
+        stop.wait(max(0, next_call - time.time()))
+
+
+def block_phase_times(rpc):
+    times = {}
+    for timer in rpc.getperfinfo()['timers']:
+        if timer['name'].startswith('connectblock.'):
+            times[timer['name']] = (timer['time']['count'], timer['time']['total_us'])
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--datadir', default=os.path.expanduser('~/.nix'), help='datadir of the node, for the RPC cookie')
+    parser.add_argument('--rpchost', default='127.0.0.1')
+    parser.add_argument('--rpcport', type=int, default=REGTEST_RPC_PORT)
+    parser.add_argument('--rpcuser', help='instead of the cookie')
+    parser.add_argument('--rpcpassword')
+    parser.add_argument('--duration', type=float, default=60, help='seconds to run for (default: 60)')
+    parser.add_argument('--payments', type=float, default=10, help='payments per second (default: 10, 0 to disable)')
+    parser.add_argument('--mints', type=float, default=1, help='sigma mints per second (default: 1, 0 to disable)')
+    parser.add_argument('--spends', type=float, default=0.5, help='sigma spends per second (default: 0.5, 0 to disable)')
+    parser.add_argument('--blocks', type=float, default=0.2, help='blocks generated per second (default: 0.2, 0 when the node stakes)')
+    parser.add_argument('--denomination', default='1', help='amount of each mint and spend (default: 1)')
+    parser.add_argument('--verbose', action='store_true', help='print every RPC error')
+    args = parser.parse_args()
+
+    rpc = AuthServiceProxy(rpc_url(args), timeout=600)
+    if rpc.getblockchaininfo()['chain'] != 'regtest':
+        sys.exit('the node is not on regtest')
+    address = rpc.getnewaddress()
+    # coins to play with
+    if rpc.getbalance() < 1000:
+        rpc.generate(101)
+
+    workloads = []
+    if args.payments > 0:
+        workloads.append(('payment', args.payments, lambda r: r.sendtoaddress(address, 0.1)))
+    if args.mints > 0:
+        workloads.append(('sigma mint', args.mints, lambda r: r.ghostamountv2(args.denomination)))
+    if args.spends > 0:
+        workloads.append(('sigma spend', args.spends, lambda r: r.unghostamountv2(args.denomination, address)))
+    if args.blocks > 0:
+        workloads.append(('block', args.blocks, lambda r: r.generate(1)))
+
+    phases_before = block_phase_times(rpc)
+    height_before = rpc.getblockcount()
+    stop = threading.Event()
+    stats = []
+    threads = []
+    for name, rate, call in workloads:
+        stats.append(Stats(name))
+        threads.append(threading.Thread(target=run_workload, args=(args, stats[-1], rate, call, stop)))
+    start = time.time()
+    for thread in threads:
+        thread.start()
+    try:
+        stop.wait(args.duration)
+    except KeyboardInterrupt:
+        pass
+    stop.set()
+    for thread in threads:
+        thread.join()
+    duration = time.time() - start
+
+    print('%.1fs, %d blocks, %d transactions left in the mempool' % (
+        duration, rpc.getblockcount() - height_before, rpc.getmempoolinfo()['size']))
+    for s in stats:
+        s.report(duration)
+
+    print('ConnectBlock phases:')
+    for name, (count, total) in sorted(block_phase_times(rpc).items()):
+        count_before, total_before = phases_before.get(name, (0, 0))
+        if count > count_before:
+            print('  %-34s %6d  avg %8.2fms' % (name, count - count_before, (total - total_before) / 1000.0 / (count - count_before)))
+
+
+if __name__ == '__main__':
+    main()
@@ -126,7 +126,15 @@ CAddrDB::CAddrDB()
 
 bool CAddrDB::Write(const CAddrMan& addr)
 {
-    return SerializeFileDB("peers", pathAddr, addr);
+    // Serializing locks the address manager, take a snapshot in memory once so that it is
+    // not held while the snapshot is hashed and written to disk
+    CDataStream ssPeers(SER_DISK, CLIENT_VERSION);
+    try {
+        ssPeers << addr;
+    } catch (const std::exception& e) {
+        return error("%s: Serialize error - %s", __func__, e.what());
+    }
+    return SerializeFileDB("peers", pathAddr, CFlatData(ssPeers.data(), ssPeers.data() + ssPeers.size()));
 }
 
 bool CAddrDB::Read(CAddrMan& addr)
@@ -58,3 +58,17 @@ bool ExtractIndexInfo(const CTxOut *out, int &scriptType, std::vector<uint8_t> &
     return true;
 };
 
+bool ExtractDelegationInfo(const CScript &script, int &scriptType, std::vector<uint8_t> &hashBytes)
+{
+    scriptType = ADDR_INDT_UNKNOWN;
+    if (!HasIsCoinstakeOp(script))
+        return false;
+
+    CScript scriptStaker;
+    if (!GetCoinstakeScriptPath(script, scriptStaker))
+        return false;
+
+    ExtractIndexInfo(&scriptStaker, scriptType, hashBytes);
+    return scriptType != ADDR_INDT_UNKNOWN;
+};
+
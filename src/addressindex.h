@@ -299,8 +299,76 @@ struct CMempoolAddressDeltaKeyCompare
     }
 };
 
+/** Key of a balance checkpoint, the totals of an address after the block at blockHeight */
+struct CAddressBalanceKey {
+    unsigned int type;
+    uint256 hashBytes;
+    int blockHeight;
+
+    size_t GetSerializeSize() const {
+        return 37;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        ser_writedata8(s, type);
+        hashBytes.Serialize(s);
+        // Inverted big-endian height, so seeking to a height finds the last checkpoint at or below it
+        ser_writedata32be(s, ~(uint32_t)blockHeight);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        type = ser_readdata8(s);
+        hashBytes.Unserialize(s);
+        blockHeight = (int)~ser_readdata32be(s);
+    }
+
+    CAddressBalanceKey(unsigned int addressType, uint256 addressHash, int height) {
+        type = addressType;
+        hashBytes = addressHash;
+        blockHeight = height;
+    }
+
+    CAddressBalanceKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        type = ADDR_INDT_UNKNOWN;
+        hashBytes.SetNull();
+        blockHeight = 0;
+    }
+};
+
+struct CAddressBalanceValue {
+    CAmount balance;
+    CAmount received;
+    //! Sum of the deltas at txindex 0, the coinstake entries governance vote weight is made of
+    CAmount staked;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(staked);
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        staked = 0;
+    }
+};
+
 bool ExtractIndexInfo(const CScript *pScript, int &scriptType, std::vector<uint8_t> &hashBytes);
 bool ExtractIndexInfo(const CTxOut *out, int &scriptType, std::vector<uint8_t> &hashBytes, CAmount &nValue, const CScript *&pScript);
+//! Address of the staking path of a conditional stake script, false for other scripts or an unindexable staker
+bool ExtractDelegationInfo(const CScript &script, int &scriptType, std::vector<uint8_t> &hashBytes);
 
 
 #endif // BITCOIN_ADDRESSINDEX_H
@@ -6,6 +6,7 @@
 
 #include <bech32.h>
 #include <hash.h>
+#include <prevector.h>
 #include <script/script.h>
 #include <uint256.h>
 #include <utilstrencodings.h>
@@ -81,34 +82,54 @@ std::string EncodeBase58(const unsigned char* pbegin, const unsigned char* pend)
         pbegin++;
         zeroes++;
     }
-    // Allocate enough space in big-endian base58 representation.
-    int size = (pend - pbegin) * 138 / 100 + 1; // log(256) / log(58), rounded up.
-    std::vector<unsigned char> b58(size);
-    // Process the bytes.
+    // Work in limbs of five base58 digits, little-endian, taking up to four bytes a step:
+    // a limb times 2^32 plus the carry still fits 64 bits. Addresses fit the stack buffer.
+    static const uint32_t LIMB_BASE = 58 * 58 * 58 * 58 * 58;
+    const size_t nMaxLimbs = ((pend - pbegin) * 138 / 100 + 1) / 5 + 1; // log(256) / log(58), rounded up.
+    uint32_t limbsStack[16];
+    std::vector<uint32_t> limbsHeap;
+    uint32_t* limbs = limbsStack;
+    if (nMaxLimbs > sizeof(limbsStack) / sizeof(limbsStack[0])) {
+        limbsHeap.resize(nMaxLimbs);
+        limbs = limbsHeap.data();
+    }
     while (pbegin != pend) {
-        int carry = *pbegin;
-        int i = 0;
-        // Apply "b58 = b58 * 256 + ch".
-        for (std::vector<unsigned char>::reverse_iterator it = b58.rbegin(); (carry != 0 || i < length) && (it != b58.rend()); it++, i++) {
-            carry += 256 * (*it);
-            *it = carry % 58;
-            carry /= 58;
+        // Apply "b58 = b58 * 256^n + next n bytes".
+        int n = std::min<int>(4, pend - pbegin);
+        uint64_t carry = 0;
+        for (int i = 0; i < n; i++)
+            carry = (carry << 8) | *pbegin++;
+        for (int i = 0; i < length; i++) {
+            carry += (uint64_t)limbs[i] << (8 * n);
+            limbs[i] = carry % LIMB_BASE;
+            carry /= LIMB_BASE;
+        }
+        while (carry != 0) {
+            assert((size_t)length < nMaxLimbs);
+            limbs[length++] = carry % LIMB_BASE;
+            carry /= LIMB_BASE;
         }
-
-        assert(carry == 0);
-        length = i;
-        pbegin++;
     }
-    // Skip leading zeroes in base58 result.
-    std::vector<unsigned char>::iterator it = b58.begin() + (size - length);
-    while (it != b58.end() && *it == 0)
-        it++;
-    // Translate the result into a string.
+    // Translate the result into a string, the top limb without its leading zeroes.
+    char digits[5];
+    int nTop = 0;
+    if (length > 0) {
+        for (uint32_t top = limbs[length - 1]; top != 0; top /= 58)
+            digits[nTop++] = pszBase58[top % 58];
+    }
     std::string str;
-    str.reserve(zeroes + (b58.end() - it));
+    str.reserve(zeroes + nTop + 5 * std::max(length - 1, 0));
     str.assign(zeroes, '1');
-    while (it != b58.end())
-        str += pszBase58[*(it++)];
+    while (nTop > 0)
+        str += digits[--nTop];
+    for (int i = length - 2; i >= 0; i--) {
+        uint32_t limb = limbs[i];
+        for (int j = 4; j >= 0; j--) {
+            digits[j] = pszBase58[limb % 58];
+            limb /= 58;
+        }
+        str.append(digits, 5);
+    }
     return str;
 }
 
@@ -125,10 +146,10 @@ bool DecodeBase58(const std::string& str, std::vector<unsigned char>& vchRet)
 std::string EncodeBase58Check(const std::vector<unsigned char>& vchIn)
 {
     // add 4-byte hash check to the end
-    std::vector<unsigned char> vch(vchIn);
+    prevector<128, unsigned char> vch(vchIn.begin(), vchIn.end());
     uint256 hash = Hash(vch.begin(), vch.end());
     vch.insert(vch.end(), (unsigned char*)&hash, (unsigned char*)&hash + 4);
-    return EncodeBase58(vch);
+    return EncodeBase58(vch.data(), vch.data() + vch.size());
 }
 
 bool DecodeBase58Check(const char* psz, std::vector<unsigned char>& vchRet)
@@ -874,6 +895,36 @@ std::string EncodeDestination(const CTxDestination& dest, bool fBech32)
     return boost::apply_visitor(DestinationEncoder(Params(), fBech32), dest);
 }
 
+bool EncodeIndexAddress(int type, const uint256& hash, std::string& address)
+{
+    if (type == ADDR_INDT_SCRIPT_ADDRESS) {
+        address = EncodeDestination(CScriptID(uint160(hash.begin(), 20)));
+    } else if (type == ADDR_INDT_PUBKEY_ADDRESS) {
+        address = EncodeDestination(CKeyID(uint160(hash.begin(), 20)));
+    } else if (type == ADDR_INDT_WITNESS_KEY_HASH) {
+        address = EncodeDestination(WitnessV0KeyHash(uint160(hash.begin(), 20)), true);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool CIndexAddressEncoder::Encode(int type, const uint256& hash, std::string& address)
+{
+    auto key = std::make_pair(type, hash);
+    auto it = mapEncoded.find(key);
+    if (it != mapEncoded.end()) {
+        address = it->second;
+        return true;
+    }
+    if (!EncodeIndexAddress(type, hash, address))
+        return false;
+    if (mapEncoded.size() >= MAX_ENCODED_ADDRESSES)
+        mapEncoded.clear();
+    mapEncoded.emplace(key, address);
+    return true;
+}
+
 CTxDestination DecodeDestination(const std::string& str)
 {
     return DecodeDestination(str, Params());
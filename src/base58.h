@@ -24,7 +24,9 @@
 #include <support/allocators/zeroafterfree.h>
 #include <bech32.h>
 
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 /**
@@ -289,6 +291,20 @@ public:
 };
 
 std::string EncodeDestination(const CTxDestination& dest, bool fBech32=false);
+//! Address of an address index entry, false for index types without one
+bool EncodeIndexAddress(int type, const uint256& hash, std::string& address);
+
+/** Encodes the addresses of the address index entries of one request. Its entries mostly
+ *  repeat a few addresses, each is encoded once. */
+class CIndexAddressEncoder
+{
+public:
+    bool Encode(int type, const uint256& hash, std::string& address);
+
+private:
+    static const size_t MAX_ENCODED_ADDRESSES = 4096;
+    std::map<std::pair<int, uint256>, std::string> mapEncoded;
+};
 CTxDestination DecodeDestination(const std::string& str);
 bool IsValidDestinationString(const std::string& str);
 bool IsValidDestinationString(const std::string& str, const CChainParams& params);
@@ -5,7 +5,9 @@
 #include <bench/bench.h>
 
 #include <validation.h>
+#include <addressindex.h>
 #include <base58.h>
+#include <chainparams.h>
 
 #include <array>
 #include <vector>
@@ -54,6 +56,44 @@ static void Base58Decode(benchmark::State& state)
 }
 
 
+// Entries of an address index reply, a handful of addresses repeated many times
+static std::vector<std::pair<int, uint256>> IndexEntries()
+{
+    std::vector<std::pair<int, uint256>> entries;
+    for (int i = 0; i < 1000; ++i) {
+        uint256 hash;
+        *hash.begin() = i % 8;
+        entries.emplace_back(i % 2 ? ADDR_INDT_PUBKEY_ADDRESS : ADDR_INDT_WITNESS_KEY_HASH, hash);
+    }
+    return entries;
+}
+
+static void IndexAddressEncode(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const std::vector<std::pair<int, uint256>> entries = IndexEntries();
+    std::string address;
+    while (state.KeepRunning()) {
+        for (const auto& entry : entries)
+            EncodeIndexAddress(entry.first, entry.second, address);
+    }
+}
+
+static void IndexAddressEncoder(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const std::vector<std::pair<int, uint256>> entries = IndexEntries();
+    std::string address;
+    while (state.KeepRunning()) {
+        CIndexAddressEncoder encoder;
+        for (const auto& entry : entries)
+            encoder.Encode(entry.first, entry.second, address);
+    }
+}
+
+
 BENCHMARK(Base58Encode, 470 * 1000);
 BENCHMARK(Base58CheckEncode, 320 * 1000);
 BENCHMARK(Base58Decode, 800 * 1000);
+BENCHMARK(IndexAddressEncode, 200);
+BENCHMARK(IndexAddressEncoder, 2 * 1000);
@@ -0,0 +1,59 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <primitives/block.h>
+#include <streams.h>
+#include <version.h>
+
+#include <assert.h>
+
+// A block of 500 Sigma spends: one input each carrying a serialized spend proof,
+// paying to a mint output and a change output.
+static CDataStream SigmaBlockStream()
+{
+    CBlock block;
+    for (int i = 0; i < 500; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript(std::vector<unsigned char>(1800, (unsigned char)i));
+        tx.vout.resize(2);
+        tx.vout[0].scriptPubKey = CScript(std::vector<unsigned char>(35, 0xc1));
+        tx.vout[1].scriptPubKey = CScript(std::vector<unsigned char>(25, 0x76));
+        tx.nLockTime = i;
+        block.vtx.push_back(MakeTransactionRef(std::move(tx)));
+    }
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << block;
+    char a = '\0';
+    stream.write(&a, 1); // Prevent compaction
+    return stream;
+}
+
+static void DeserializeSigmaBlockHeap(benchmark::State& state)
+{
+    CDataStream stream = SigmaBlockStream();
+    size_t nSize = stream.size();
+    while (state.KeepRunning()) {
+        CBlock block;
+        stream >> block;
+        assert(stream.Rewind(nSize - stream.size()));
+    }
+}
+
+static void DeserializeSigmaBlockArena(benchmark::State& state)
+{
+    CDataStream stream = SigmaBlockStream();
+    size_t nSize = stream.size();
+    while (state.KeepRunning()) {
+        CBlock block;
+        UnserializeBlockInArena(stream, block);
+        assert(stream.Rewind(nSize - stream.size()));
+    }
+}
+
+BENCHMARK(DeserializeSigmaBlockHeap, 100);
+BENCHMARK(DeserializeSigmaBlockArena, 100);
@@ -84,4 +84,31 @@ static void CCoinsCaching(benchmark::State& state)
     }
 }
 
+// Filling a cache and flushing it into its parent, as ConnectBlock and the flushes of
+// pcoinsTip do, which is bound by the allocations and memory traffic of the map
+static void CCoinsCachingFlush(benchmark::State& state)
+{
+    CCoinsView coinsDummy;
+    CCoinsViewCache parent(&coinsDummy);
+    uint256 hash;
+    uint64_t n = 0;
+
+    while (state.KeepRunning()) {
+        CCoinsViewCache child(&parent);
+        for (int i = 0; i < 1000; i++) {
+            memcpy(hash.begin(), &++n, sizeof(n));
+            Coin coin;
+            coin.out.nValue = i;
+            coin.out.scriptPubKey << OP_1;
+            child.AddCoin(COutPoint(hash, 0), std::move(coin), false);
+        }
+        bool success = child.Flush();
+        assert(success);
+        // bound the size of the parent
+        if (parent.GetCacheSize() > 100 * 1000)
+            parent.Flush();
+    }
+}
+
 BENCHMARK(CCoinsCaching, 170 * 1000);
+BENCHMARK(CCoinsCachingFlush, 2000);
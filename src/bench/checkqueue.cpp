@@ -6,6 +6,7 @@
 #include <util.h>
 #include <validation.h>
 #include <checkqueue.h>
+#include <crypto/sha256.h>
 #include <prevector.h>
 #include <vector>
 #include <boost/thread/thread.hpp>
@@ -60,3 +61,82 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.join_all();
 }
 BENCHMARK(CCheckQueueSpeedPrevectorJob, 1400);
+
+// Cheap checks hashing once, and expensive ones hashing HEAVY_JOB_HASHES times, standing in
+// for script checks and sigma proof checks.
+static const int HEAVY_JOB_HASHES = 200;
+static const size_t HEAVY_JOB_INTERVAL = 25;
+
+struct HashJob {
+    int nHashes;
+    HashJob() : nHashes(0) {}
+    explicit HashJob(int nHashesIn) : nHashes(nHashesIn) {}
+    bool operator()()
+    {
+        unsigned char hash[CSHA256::OUTPUT_SIZE] = {0};
+        for (int i = 0; i < nHashes; i++)
+            CSHA256().Write(hash, sizeof(hash)).Finalize(hash);
+        return hash[0] != 1 || hash[1] != 1 || hash[2] != 1 || hash[3] != 1;
+    }
+    void swap(HashJob& x) { std::swap(nHashes, x.nHashes); }
+};
+
+struct WeightedHashJob : public HashJob {
+    WeightedHashJob() {}
+    explicit WeightedHashJob(int nHashesIn) : HashJob(nHashesIn) {}
+    unsigned int GetWeight() const { return nHashes; }
+};
+
+template <typename Light, typename Heavy, typename Job>
+static void CCheckQueueMixedJobs(benchmark::State& state)
+{
+    CCheckQueue<Job> queue {QUEUE_BATCH_SIZE};
+    boost::thread_group tg;
+    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
+       tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        CCheckQueueControl<Job> control(&queue);
+        size_t n = 0;
+        for (size_t i = 0; i < BATCHES; i++) {
+            std::vector<Job> vChecks;
+            vChecks.reserve(BATCH_SIZE);
+            for (size_t x = 0; x < BATCH_SIZE; ++x) {
+                // every HEAVY_JOB_INTERVAL-th check costs HEAVY_JOB_HASHES times the others
+                if (++n % HEAVY_JOB_INTERVAL == 0) {
+                    Heavy check(HEAVY_JOB_HASHES);
+                    vChecks.emplace_back(check);
+                } else {
+                    Light check(1);
+                    vChecks.emplace_back(check);
+                }
+            }
+            control.Add(vChecks);
+        }
+        control.Wait();
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+// Cheap and expensive checks without weights, batched by count as for uniform checks
+static void CCheckQueueSpeedMixedJobUnweighted(benchmark::State& state)
+{
+    CCheckQueueMixedJobs<HashJob, HashJob, HashJob>(state);
+}
+
+// The same checks batched by their weight
+static void CCheckQueueSpeedMixedJobWeighted(benchmark::State& state)
+{
+    CCheckQueueMixedJobs<WeightedHashJob, WeightedHashJob, WeightedHashJob>(state);
+}
+
+// Cheap and expensive checks of different types in the same queue
+static void CCheckQueueSpeedMixedJobVariant(benchmark::State& state)
+{
+    CCheckQueueMixedJobs<HashJob, WeightedHashJob, CCheckVariant<HashJob, WeightedHashJob>>(state);
+}
+
+BENCHMARK(CCheckQueueSpeedMixedJobUnweighted, 100);
+BENCHMARK(CCheckQueueSpeedMixedJobWeighted, 100);
+BENCHMARK(CCheckQueueSpeedMixedJobVariant, 100);
@@ -14,6 +14,7 @@
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
+#include <crypto/Lyra2RE/Lyra2RE.h>
 
 /* Number of bytes to hash per iteration */
 static const uint64_t BUFFER_SIZE = 1000*1000;
@@ -52,6 +53,14 @@ static void SHA256_32b(benchmark::State& state)
     }
 }
 
+static void SHA256D64_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(64 * 1024, 0);
+    while (state.KeepRunning()) {
+        SHA256D64(in.data(), in.data(), 1024);
+    }
+}
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -87,12 +96,50 @@ static void FastRandom_1bit(benchmark::State& state)
     }
 }
 
+/* Proof of work hash of a block header */
+static void LYRA2RE2_80b(benchmark::State& state)
+{
+    char hash[32];
+    std::vector<char> in(80, 0);
+    while (state.KeepRunning()) {
+        lyra2re2_hash(in.data(), hash);
+        in[0] = hash[0];
+    }
+}
+
+/* A run of nonces of one header, as the generate RPCs hash them */
+static void LYRA2RE2_80b_64nonces(benchmark::State& state)
+{
+    char hash[32 * 64];
+    std::vector<char> in(80, 0);
+    uint32_t nonce = 0;
+    while (state.KeepRunning()) {
+        lyra2re2_hash_nonces(in.data(), nonce, 64, hash);
+        nonce += 64;
+    }
+}
+
+/* Distinct headers hashed as one batch, as header validation does */
+static void LYRA2RE2_80b_8headers(benchmark::State& state)
+{
+    char hash[32 * 8];
+    std::vector<char> in(80 * 8, 0);
+    while (state.KeepRunning()) {
+        lyra2re2_hash_batch(in.data(), 8, hash);
+        in[0] = hash[0];
+    }
+}
+
 BENCHMARK(RIPEMD160, 440);
 BENCHMARK(SHA1, 570);
 BENCHMARK(SHA256, 340);
 BENCHMARK(SHA512, 330);
 
 BENCHMARK(SHA256_32b, 4700 * 1000);
+BENCHMARK(SHA256D64_1024, 7400);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
+BENCHMARK(LYRA2RE2_80b, 20 * 1000);
+BENCHMARK(LYRA2RE2_80b_64nonces, 300);
+BENCHMARK(LYRA2RE2_80b_8headers, 2500);
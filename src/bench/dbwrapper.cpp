@@ -0,0 +1,45 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <dbwrapper.h>
+#include <random.h>
+#include <uint256.h>
+
+// Looks up coins that are not in a chainstate-like database, as
+// CCoinsViewDB::GetCoin does for every output created since the last flush.
+static void ReadMissingCoins(benchmark::State& state, int nBloomBits)
+{
+    CDBWrapperTuning tuning;
+    tuning.nBloomBits = nBloomBits;
+    CDBWrapper db(fs::path("dbwrapper_bench"), 1 << 20, true, false, false, tuning);
+
+    FastRandomContext rng(true);
+    for (int i = 0; i < 100; i++) {
+        CDBBatch batch(db);
+        for (int j = 0; j < 1000; j++)
+            batch.Write(std::make_pair('C', std::make_pair(rng.rand256(), j)), std::vector<unsigned char>(40));
+        db.WriteBatch(batch);
+    }
+    // Move everything out of the memtable into tables, which is where the filters live
+    db.CompactRange('C', 'D');
+
+    while (state.KeepRunning()) {
+        std::vector<unsigned char> value;
+        db.Read(std::make_pair('C', std::make_pair(rng.rand256(), 0)), value);
+    }
+}
+
+static void DBReadMissNoBloom(benchmark::State& state)
+{
+    ReadMissingCoins(state, 0);
+}
+
+static void DBReadMissBloom(benchmark::State& state)
+{
+    ReadMissingCoins(state, DEFAULT_DB_BLOOM_BITS);
+}
+
+BENCHMARK(DBReadMissNoBloom, 50 * 1000);
+BENCHMARK(DBReadMissBloom, 50 * 1000);
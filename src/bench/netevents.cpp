@@ -0,0 +1,60 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <netevents.h>
+
+#ifndef WIN32
+
+#include <assert.h>
+#include <sys/socket.h>
+#include <vector>
+
+// One socket handler pass over 500 mostly idle peers, a few of which have data
+// waiting: refresh the watched events, then wait without blocking.
+static void SocketHandlerPass(benchmark::State& state, bool fForceSelect)
+{
+    const int nPeers = 500;
+    const int nActive = 5;
+
+    std::vector<std::pair<int, int>> vPairs;
+    for (int i = 0; i < nPeers; i++) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+            break;
+        vPairs.emplace_back(fds[0], fds[1]);
+    }
+    for (int i = 0; i < nActive && i < (int)vPairs.size(); i++)
+        send(vPairs[i].second, "x", 1, 0);
+
+    CSocketEvents events(fForceSelect);
+    std::vector<std::pair<SOCKET, uint8_t>> vReady;
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < vPairs.size(); i++)
+            events.Set(vPairs[i].first, i, CSocketEvents::RECV);
+        events.RemoveStale();
+        events.Wait(0, vReady);
+        assert(vReady.size() == (size_t)std::min(nActive, (int)vPairs.size()));
+    }
+
+    for (const auto& pair : vPairs) {
+        close(pair.first);
+        close(pair.second);
+    }
+}
+
+static void SocketEventsSelect500(benchmark::State& state)
+{
+    SocketHandlerPass(state, true);
+}
+
+static void SocketEventsQueue500(benchmark::State& state)
+{
+    SocketHandlerPass(state, false);
+}
+
+BENCHMARK(SocketEventsSelect500, 5 * 1000);
+BENCHMARK(SocketEventsQueue500, 5 * 1000);
+
+#endif // WIN32
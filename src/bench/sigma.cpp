@@ -0,0 +1,227 @@
+// Copyright (c) 2019 The NIX Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <sigma/sigmaplus_prover.h>
+#include <sigma/sigmaplus_verifier.h>
+#include <streams.h>
+#include <version.h>
+#include <zerocoin/sigma.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+typedef sigma::SigmaPlusProof<Scalar, GroupElement> SigmaProof;
+typedef sigma::SigmaPlusProver<Scalar, GroupElement> SigmaProver;
+typedef sigma::SigmaPlusVerifier<Scalar, GroupElement> SigmaVerifier;
+
+// Commitments to zero but for the one at index and the randomness opening it
+struct SigmaCommitments {
+    std::vector<GroupElement> commits;
+    std::size_t index;
+    Scalar r;
+
+    SigmaCommitments(const sigma::Params* params, std::size_t setSize) : commits(setSize), index(setSize / 3) {
+        for (GroupElement& commit : commits)
+            commit.randomize();
+        r.randomize();
+        commits[index] = params->get_h0() * r;
+    }
+};
+
+// A padded proof over an anonymity set of setSize commitments
+struct SigmaProofSetup : public SigmaCommitments {
+    SigmaProof proof;
+
+    SigmaProofSetup(const sigma::Params* params, std::size_t setSize) : SigmaCommitments(params, setSize), proof(params) {
+        SigmaProver prover(params->get_g(), params->get_h(), params->get_n(), params->get_m(), params->get_h_table());
+        prover.proof(commits, index, r, true, proof);
+    }
+};
+
+// Proving is slow, build each proof once for all the iterations
+static const SigmaProofSetup& GetSigmaProofSetup(const sigma::Params* params, std::size_t setSize)
+{
+    static std::map<std::pair<const sigma::Params*, std::size_t>, std::unique_ptr<SigmaProofSetup>> setups;
+    std::unique_ptr<SigmaProofSetup>& setup = setups[std::make_pair(params, setSize)];
+    if (!setup)
+        setup.reset(new SigmaProofSetup(params, setSize));
+    return *setup;
+}
+
+static void SigmaVerify(benchmark::State& state, std::size_t setSize, const sigma::Params* params = SParams)
+{
+    const SigmaProofSetup& setup = GetSigmaProofSetup(params, setSize);
+    SigmaVerifier verifier(params->get_g(), params->get_h(), params->get_n(), params->get_m(), params->get_h_table());
+    while (state.KeepRunning()) {
+        bool fOk = verifier.verify(setup.commits, setup.proof, true);
+        assert(fOk);
+    }
+}
+
+static void SigmaVerify_100(benchmark::State& state) { SigmaVerify(state, 100); }
+static void SigmaVerify_1000(benchmark::State& state) { SigmaVerify(state, 1000); }
+static void SigmaVerify_5000(benchmark::State& state) { SigmaVerify(state, 5000); }
+static void SigmaVerify_16383(benchmark::State& state) { SigmaVerify(state, 16383); }
+
+// Verify cost against the set size with the extended parameters (m = 8, N up to 65,536),
+// the 16383 case shows what the extra digit costs for the sets of today
+static void SigmaVerifyExtended_16383(benchmark::State& state) { SigmaVerify(state, 16383, sigma::Params::get_extended()); }
+static void SigmaVerifyExtended_32767(benchmark::State& state) { SigmaVerify(state, 32767, sigma::Params::get_extended()); }
+static void SigmaVerifyExtended_65535(benchmark::State& state) { SigmaVerify(state, 65535, sigma::Params::get_extended()); }
+
+// Amortized cost of a proof when SPENDS_PER_BATCH spends of a full group are verified in
+// one batch, as blocks and transactions do
+static const std::size_t SPENDS_PER_BATCH = 8;
+
+struct SigmaSpendBatch {
+    std::vector<GroupElement> coins;
+    std::vector<std::unique_ptr<sigma::CoinSpend>> spends;
+
+    SigmaSpendBatch(const sigma::Params* params, std::size_t setSize) : coins(setSize) {
+        for (GroupElement& coin : coins)
+            coin.randomize();
+
+        std::vector<sigma::PrivateCoin> privateCoins;
+        for (std::size_t i = 0; i < SPENDS_PER_BATCH; ++i) {
+            privateCoins.emplace_back(params, sigma::CoinDenomination::SIGMA_1);
+            coins[i * setSize / SPENDS_PER_BATCH] = privateCoins.back().getPublicCoin().getValue();
+        }
+
+        sigma::SpendMetaData metaData(1, uint256(), uint256());
+        for (const sigma::PrivateCoin& coin : privateCoins)
+            spends.emplace_back(new sigma::CoinSpend(params, coin, coins, coins.size(), metaData, true));
+    }
+};
+
+static void SigmaBatchVerify(benchmark::State& state, const sigma::Params* params, std::size_t setSize)
+{
+    static std::map<std::pair<const sigma::Params*, std::size_t>, std::unique_ptr<SigmaSpendBatch>> batches;
+    std::unique_ptr<SigmaSpendBatch>& batch = batches[std::make_pair(params, setSize)];
+    if (!batch)
+        batch.reset(new SigmaSpendBatch(params, setSize));
+
+    std::vector<const sigma::CoinSpend*> spends;
+    for (const auto& spend : batch->spends)
+        spends.push_back(spend.get());
+    std::vector<std::size_t> setSizes(spends.size(), setSize);
+    std::vector<bool> fPadding(spends.size(), true);
+    while (state.KeepRunning()) {
+        bool fOk = sigma::CoinSpend::BatchVerify(params, batch->coins, spends, setSizes, fPadding);
+        assert(fOk);
+    }
+}
+
+static void SigmaBatchVerify_16384(benchmark::State& state) { SigmaBatchVerify(state, SParams, 16384); }
+static void SigmaBatchVerifyExtended_65536(benchmark::State& state) { SigmaBatchVerify(state, sigma::Params::get_extended(), 65536); }
+
+// The f_i coefficients of every commitment, which verification needs before
+// the multi-exponentiation
+static void SigmaComputeFis_16384(benchmark::State& state)
+{
+    std::vector<Scalar> f(SParams->get_n() * SParams->get_m());
+    for (Scalar& f_j : f)
+        f_j.randomize();
+    while (state.KeepRunning()) {
+        std::vector<Scalar> f_i;
+        sigma::SigmaPrimitives<Scalar, GroupElement>::compute_fis(f, SParams->get_n(), SParams->get_m(), 16384, f_i);
+    }
+}
+
+static void SigmaProve_1000(benchmark::State& state)
+{
+    SigmaCommitments setup(SParams, 1000);
+    SigmaProver prover(SParams->get_g(), SParams->get_h(), SParams->get_n(), SParams->get_m(), SParams->get_h_table());
+    while (state.KeepRunning()) {
+        SigmaProof proof(SParams);
+        prover.proof(setup.commits, setup.index, setup.r, true, proof);
+    }
+}
+
+static void MultiExponentBench(benchmark::State& state, std::size_t size)
+{
+    std::vector<GroupElement> points(size);
+    std::vector<Scalar> powers(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        points[i].randomize();
+        powers[i].randomize();
+    }
+    while (state.KeepRunning()) {
+        secp_primitives::MultiExponent mult(points, powers);
+        mult.get_multiple();
+    }
+}
+
+static void MultiExponent_28(benchmark::State& state) { MultiExponentBench(state, 28); }
+static void MultiExponent_1000(benchmark::State& state) { MultiExponentBench(state, 1000); }
+static void MultiExponent_16384(benchmark::State& state) { MultiExponentBench(state, 16384); }
+
+// Multi-exponentiation over the h generators through their precomputed table
+static void MultiExponentTable_28(benchmark::State& state)
+{
+    const secp_primitives::MultiExponentTable* table = SParams->get_h_table();
+    std::vector<Scalar> powers(table->size());
+    for (Scalar& power : powers)
+        power.randomize();
+    while (state.KeepRunning())
+        table->get_multiple(powers);
+}
+
+// Input spending a coin from an anonymity set of 100 coins of group 1
+static CTxIn GetSigmaSpendInput()
+{
+    std::vector<GroupElement> coins(100);
+    for (GroupElement& coin : coins)
+        coin.randomize();
+    sigma::PrivateCoin privateCoin(SParams, sigma::CoinDenomination::SIGMA_1);
+    coins[42] = privateCoin.getPublicCoin().getValue();
+
+    sigma::SpendMetaData metaData(1, uint256(), uint256());
+    sigma::CoinSpend spend(SParams, privateCoin, coins, coins.size(), metaData, true);
+    spend.setVersion(sigma::SIGMA_VERSION_2);
+
+    CDataStream serialized(SER_NETWORK, PROTOCOL_VERSION);
+    serialized << spend;
+
+    CTxIn in;
+    in.prevout.n = 1;
+    in.scriptSig = CScript() << OP_SIGMASPEND;
+    in.scriptSig.insert(in.scriptSig.end(), serialized.begin(), serialized.end());
+    return in;
+}
+
+static void SigmaParseSpend(benchmark::State& state)
+{
+    CTxIn in = GetSigmaSpendInput();
+    while (state.KeepRunning())
+        ParseSigmaSpend(in);
+}
+
+static void SigmaParseSpendView(benchmark::State& state)
+{
+    CTxIn in = GetSigmaSpendInput();
+    while (state.KeepRunning())
+        ParseSigmaSpendView(in);
+}
+
+BENCHMARK(SigmaVerify_100, 100);
+BENCHMARK(SigmaVerify_1000, 20);
+BENCHMARK(SigmaVerify_5000, 5);
+BENCHMARK(SigmaVerify_16383, 2);
+BENCHMARK(SigmaVerifyExtended_16383, 2);
+BENCHMARK(SigmaVerifyExtended_32767, 2);
+BENCHMARK(SigmaVerifyExtended_65535, 1);
+BENCHMARK(SigmaBatchVerify_16384, 1);
+BENCHMARK(SigmaBatchVerifyExtended_65536, 1);
+BENCHMARK(SigmaComputeFis_16384, 100);
+BENCHMARK(SigmaProve_1000, 5);
+BENCHMARK(MultiExponent_28, 1000);
+BENCHMARK(MultiExponent_1000, 50);
+BENCHMARK(MultiExponent_16384, 5);
+BENCHMARK(MultiExponentTable_28, 2000);
+BENCHMARK(SigmaParseSpend, 2000);
+BENCHMARK(SigmaParseSpendView, 100 * 1000);
@@ -0,0 +1,95 @@
+// Copyright (c) 2019 The NIX Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <checkqueue.h>
+#include <util.h>
+#include <zerocoin/sigma.h>
+
+#include <memory>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+
+static const size_t SPENDS_PER_BLOCK = 50;
+static const size_t ANONYMITY_SET_SIZE = 1000;
+
+// Sigma spends of one block, all in the same coin group
+struct SigmaSpendBlock {
+    std::shared_ptr<std::vector<GroupElement>> coins;
+    std::vector<std::unique_ptr<sigma::CoinSpend>> spends;
+
+    SigmaSpendBlock() : coins(std::make_shared<std::vector<GroupElement>>(ANONYMITY_SET_SIZE)) {
+        for (GroupElement& coin : *coins)
+            coin.randomize();
+
+        std::vector<sigma::PrivateCoin> privateCoins;
+        for (size_t i = 0; i < SPENDS_PER_BLOCK; ++i) {
+            privateCoins.emplace_back(SParams, sigma::CoinDenomination::SIGMA_1);
+            (*coins)[i * ANONYMITY_SET_SIZE / SPENDS_PER_BLOCK] = privateCoins.back().getPublicCoin().getValue();
+        }
+
+        sigma::SpendMetaData metaData(1, uint256(), uint256());
+        for (const sigma::PrivateCoin& coin : privateCoins)
+            spends.emplace_back(new sigma::CoinSpend(SParams, coin, *coins, coins->size(), metaData, true));
+    }
+
+    // Split the spends into nChecks checks the same way CheckSigmaSpendProofs does
+    std::vector<CSigmaProofCheck> GetChecks(size_t nChecks) const {
+        std::vector<CSigmaProofCheck> vChecks;
+        for (size_t i = 0; i < nChecks; ++i) {
+            size_t begin = spends.size() * i / nChecks, end = spends.size() * (i + 1) / nChecks;
+            std::vector<const sigma::CoinSpend*> checkSpends;
+            for (size_t j = begin; j < end; ++j)
+                checkSpends.push_back(spends[j].get());
+            vChecks.emplace_back(coins, checkSpends,
+                std::vector<std::size_t>(end - begin, coins->size()), std::vector<bool>(end - begin, true),
+                std::vector<uint256>());
+        }
+        return vChecks;
+    }
+};
+
+// Proving is slow, build the block once for all the benchmarks
+static const SigmaSpendBlock& GetSigmaSpendBlock()
+{
+    static const SigmaSpendBlock block;
+    return block;
+}
+
+// Verifies all the proofs of the block in one batch on the calling thread
+static void SigmaSpendBlockOneThread(benchmark::State& state)
+{
+    const SigmaSpendBlock& block = GetSigmaSpendBlock();
+    while (state.KeepRunning()) {
+        for (CSigmaProofCheck& check : block.GetChecks(1)) {
+            bool fOk = check();
+            assert(fOk);
+        }
+    }
+}
+
+// Splits the proofs of the block between all the cores
+static void SigmaSpendBlockAllThreads(benchmark::State& state)
+{
+    const SigmaSpendBlock& block = GetSigmaSpendBlock();
+    int nThreads = std::max(2, GetNumCores());
+    CCheckQueue<CSigmaProofCheck> queue(1);
+    boost::thread_group tg;
+    for (int i = 0; i < nThreads - 1; ++i)
+        tg.create_thread([&]{queue.Thread();});
+
+    while (state.KeepRunning()) {
+        CCheckQueueControl<CSigmaProofCheck> control(&queue);
+        std::vector<CSigmaProofCheck> vChecks = block.GetChecks(nThreads);
+        control.Add(vChecks);
+        bool fOk = control.Wait();
+        assert(fOk);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+BENCHMARK(SigmaSpendBlockOneThread, 1);
+BENCHMARK(SigmaSpendBlockAllThreads, 1);
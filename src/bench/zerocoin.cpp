@@ -0,0 +1,53 @@
+// Copyright (c) 2019 The NIX Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <libzerocoin/Zerocoin.h>
+#include <zerocoin/zerocoin.h>
+
+#include <memory>
+
+// A legacy zerocoin spend of the first of two coins accumulated together
+struct ZerocoinSpendSetup {
+    libzerocoin::PrivateCoin coin;
+    libzerocoin::PrivateCoin otherCoin;
+    libzerocoin::Accumulator accumulator;
+    libzerocoin::SpendMetaData metaData;
+    std::unique_ptr<libzerocoin::CoinSpend> spend;
+
+    ZerocoinSpendSetup() : coin(ZCParams), otherCoin(ZCParams), accumulator(ZCParams), metaData(1, uint256()) {
+        libzerocoin::AccumulatorWitness witness(ZCParams, accumulator, coin.getPublicCoin());
+        accumulator += otherCoin.getPublicCoin();
+        witness += otherCoin.getPublicCoin();
+        accumulator += coin.getPublicCoin();
+        spend.reset(new libzerocoin::CoinSpend(ZCParams, coin, accumulator, witness, metaData));
+    }
+};
+
+// Minting and proving are slow, build the spend once for all the benchmarks
+static const ZerocoinSpendSetup& GetZerocoinSpendSetup()
+{
+    static const ZerocoinSpendSetup setup;
+    return setup;
+}
+
+static void ZerocoinSpendVerify(benchmark::State& state)
+{
+    const ZerocoinSpendSetup& setup = GetZerocoinSpendSetup();
+    while (state.KeepRunning()) {
+        bool fOk = setup.spend->Verify(setup.accumulator, setup.metaData);
+        assert(fOk);
+    }
+}
+
+static void ZerocoinAccumulate(benchmark::State& state)
+{
+    const ZerocoinSpendSetup& setup = GetZerocoinSpendSetup();
+    libzerocoin::Accumulator accumulator(ZCParams);
+    while (state.KeepRunning())
+        accumulator.accumulate(setup.coin.getPublicCoin());
+}
+
+BENCHMARK(ZerocoinSpendVerify, 5);
+BENCHMARK(ZerocoinAccumulate, 1000);
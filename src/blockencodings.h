@@ -149,7 +149,12 @@ public:
     // Dummy for deserialization
     CBlockHeaderAndShortTxIDs() {}
 
-    CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID);
+    /**
+     * Prefills the coinbase. With a mempool, Sigma spends it does not hold are
+     * prefilled too: they are large, and peers that lacked them as well would
+     * otherwise need another round trip.
+     */
+    CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID, const CTxMemPool* pool = nullptr);
 
     uint64_t GetShortID(const uint256& txhash) const;
 
@@ -194,6 +199,22 @@ public:
     }
 };
 
+/** Where the transactions of reconstructed compact blocks came from, Sigma spends apart */
+struct CompactBlockTxCounts {
+    uint64_t nSigmaAvailable = 0; //!< prefilled or found in the mempool
+    uint64_t nSigmaRequested = 0;
+    uint64_t nOtherAvailable = 0;
+    uint64_t nOtherRequested = 0;
+
+    CompactBlockTxCounts& operator+=(const CompactBlockTxCounts& other) {
+        nSigmaAvailable += other.nSigmaAvailable;
+        nSigmaRequested += other.nSigmaRequested;
+        nOtherAvailable += other.nOtherAvailable;
+        nOtherRequested += other.nOtherRequested;
+        return *this;
+    }
+};
+
 class PartiallyDownloadedBlock {
 protected:
     std::vector<CTransactionRef> txn_available;
@@ -202,6 +223,7 @@ protected:
 public:
     CBlockHeader header;
     std::vector<uint8_t> vchBlockSig;
+    CompactBlockTxCounts txCounts; //!< set by a successful FillBlock
     explicit PartiallyDownloadedBlock(CTxMemPool* poolIn) : pool(poolIn) {}
 
     // extra_txn is a list of extra transactions to look at, in <witness hash, reference> form
@@ -0,0 +1,346 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilter.h>
+
+#include <coins.h>
+#include <hash.h>
+#include <primitives/block.h>
+#include <script/interpreter.h>
+#include <script/script.h>
+#include <streams.h>
+#include <undo.h>
+#include <zerocoin/sigma.h>
+
+#include <algorithm>
+#include <ios>
+#include <limits>
+
+namespace {
+
+/** Appends bits to a byte vector, most significant bit first */
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<unsigned char>& vIn) : v(vIn), nBuffer(0), nOffset(0) {}
+
+    //! Write the nBits low bits of data, nBits <= 64
+    void Write(uint64_t data, int nBits)
+    {
+        while (nBits > 0) {
+            int nChunk = std::min(8 - nOffset, nBits);
+            uint8_t bits = (data >> (nBits - nChunk)) & ((1 << nChunk) - 1);
+            nBuffer |= bits << (8 - nOffset - nChunk);
+            nOffset += nChunk;
+            nBits -= nChunk;
+            if (nOffset == 8)
+                Flush();
+        }
+    }
+
+    //! Write out the partial last byte, padded with zeros
+    void Flush()
+    {
+        if (nOffset == 0)
+            return;
+        v.push_back(nBuffer);
+        nBuffer = 0;
+        nOffset = 0;
+    }
+
+private:
+    std::vector<unsigned char>& v;
+    uint8_t nBuffer;
+    int nOffset;
+};
+
+/** Reads bits written by BitWriter */
+class BitReader
+{
+public:
+    BitReader(const unsigned char* pbeginIn, const unsigned char* pendIn) : p(pbeginIn), pend(pendIn), nBuffer(0), nOffset(8) {}
+
+    uint64_t Read(int nBits)
+    {
+        uint64_t data = 0;
+        while (nBits > 0) {
+            if (nOffset == 8) {
+                if (p == pend)
+                    throw std::ios_base::failure("BitReader::Read(): end of data");
+                nBuffer = *p++;
+                nOffset = 0;
+            }
+            int nChunk = std::min(8 - nOffset, nBits);
+            data = (data << nChunk) | ((nBuffer >> (8 - nOffset - nChunk)) & ((1 << nChunk) - 1));
+            nOffset += nChunk;
+            nBits -= nChunk;
+        }
+        return data;
+    }
+
+private:
+    const unsigned char* p;
+    const unsigned char* pend;
+    uint8_t nBuffer;
+    int nOffset;
+};
+
+void GolombRiceEncode(BitWriter& writer, uint8_t nP, uint64_t x)
+{
+    // The quotient in unary, ones closed by a zero
+    uint64_t q = x >> nP;
+    while (q > 0) {
+        int nBits = q <= 64 ? (int)q : 64;
+        writer.Write(~0ULL, nBits);
+        q -= nBits;
+    }
+    writer.Write(0, 1);
+    writer.Write(x, nP);
+}
+
+uint64_t GolombRiceDecode(BitReader& reader, uint8_t nP)
+{
+    uint64_t q = 0;
+    while (reader.Read(1) == 1)
+        q++;
+    return (q << nP) + reader.Read(nP);
+}
+
+/** x * n / 2^64, maps a uniform 64 bit hash to [0, n) without a division */
+uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return (uint64_t)(((unsigned __int128)x * (unsigned __int128)n) >> 64);
+#else
+    uint64_t x_hi = x >> 32, x_lo = x & 0xFFFFFFFF;
+    uint64_t n_hi = n >> 32, n_lo = n & 0xFFFFFFFF;
+    uint64_t ac = x_hi * n_hi;
+    uint64_t ad = x_hi * n_lo;
+    uint64_t bc = x_lo * n_hi;
+    uint64_t bd = x_lo * n_lo;
+    uint64_t mid34 = (bd >> 32) + (bc & 0xFFFFFFFF) + (ad & 0xFFFFFFFF);
+    return ac + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+#endif
+}
+
+void AddElement(GCSFilter::ElementSet& elements, const uint256& hash)
+{
+    elements.emplace(hash.begin(), hash.end());
+}
+
+/** The elements an output script adds to the basic filter */
+void AddScriptElements(GCSFilter::ElementSet& elements, const CScript& script)
+{
+    if (script.empty() || script[0] == OP_RETURN)
+        return;
+    elements.emplace(script.begin(), script.end());
+
+    if (script.IsSigmaMint()) {
+        if (script.size() < 1 + GroupElement::serialize_size)
+            return;
+        try {
+            AddElement(elements, GetPubCoinValueHash(ParseSigmaMintScript(script)));
+        } catch (const std::exception&) {
+        }
+    } else if (HasIsCoinstakeOp(script)) {
+        CScript scriptPath;
+        if (GetCoinstakeScriptPath(script, scriptPath) && !scriptPath.empty())
+            elements.emplace(scriptPath.begin(), scriptPath.end());
+        if (GetNonCoinstakeScriptPath(script, scriptPath) && !scriptPath.empty())
+            elements.emplace(scriptPath.begin(), scriptPath.end());
+    }
+}
+
+} // namespace
+
+GCSFilter::GCSFilter(const Params& paramsIn) : params(paramsIn), nN(0), nF(0)
+{
+    CVectorWriter stream(SER_NETWORK, 0, vEncoded, 0);
+    WriteCompactSize(stream, nN);
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn, std::vector<unsigned char> vEncodedIn) : params(paramsIn), vEncoded(std::move(vEncodedIn))
+{
+    CSpanReader stream(SER_NETWORK, 0, vEncoded.data(), vEncoded.size());
+    uint64_t nElements = ReadCompactSize(stream);
+    if (nElements > std::numeric_limits<uint32_t>::max())
+        throw std::ios_base::failure("GCSFilter: N must be < 2^32");
+    nN = nElements;
+    nF = (uint64_t)nN * params.nM;
+
+    // Every element takes at least P + 1 bits
+    if (stream.size() * 8 < (uint64_t)nN * (params.nP + 1))
+        throw std::ios_base::failure("GCSFilter: encoded filter too short for N");
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn, const ElementSet& elements) : params(paramsIn)
+{
+    if (elements.size() > std::numeric_limits<uint32_t>::max())
+        throw std::invalid_argument("GCSFilter: N must be < 2^32");
+    nN = elements.size();
+    nF = (uint64_t)nN * params.nM;
+
+    CVectorWriter stream(SER_NETWORK, 0, vEncoded, 0);
+    WriteCompactSize(stream, nN);
+    if (elements.empty())
+        return;
+
+    BitWriter writer(vEncoded);
+    uint64_t nLast = 0;
+    for (uint64_t value : BuildHashedSet(elements)) {
+        GolombRiceEncode(writer, params.nP, value - nLast);
+        nLast = value;
+    }
+    writer.Flush();
+}
+
+uint64_t GCSFilter::HashToRange(const Element& element) const
+{
+    uint64_t hash = CSipHasher(params.nSipHashK0, params.nSipHashK1).Write(element.data(), element.size()).Finalize();
+    return MapIntoRange(hash, nF);
+}
+
+std::vector<uint64_t> GCSFilter::BuildHashedSet(const ElementSet& elements) const
+{
+    std::vector<uint64_t> vHashed;
+    vHashed.reserve(elements.size());
+    for (const Element& element : elements)
+        vHashed.push_back(HashToRange(element));
+    std::sort(vHashed.begin(), vHashed.end());
+    return vHashed;
+}
+
+bool GCSFilter::MatchInternal(const uint64_t* pQuery, size_t nQuery) const
+{
+    const size_t nHeaderSize = GetSizeOfCompactSize(nN);
+    BitReader reader(vEncoded.data() + nHeaderSize, vEncoded.data() + vEncoded.size());
+
+    // Both the set and the query are sorted, walk them together
+    uint64_t value = 0;
+    size_t q = 0;
+    for (uint32_t i = 0; i < nN; i++) {
+        value += GolombRiceDecode(reader, params.nP);
+        while (true) {
+            if (q == nQuery)
+                return false;
+            if (pQuery[q] == value)
+                return true;
+            if (pQuery[q] > value)
+                break;
+            q++;
+        }
+    }
+    return false;
+}
+
+bool GCSFilter::Match(const Element& element) const
+{
+    uint64_t query = HashToRange(element);
+    return MatchInternal(&query, 1);
+}
+
+bool GCSFilter::MatchAny(const ElementSet& elements) const
+{
+    if (elements.empty())
+        return false;
+    const std::vector<uint64_t> vQuery = BuildHashedSet(elements);
+    return MatchInternal(vQuery.data(), vQuery.size());
+}
+
+static const std::pair<BlockFilterType, std::string> BLOCK_FILTER_TYPE_NAMES[] = {
+    {BlockFilterType::BASIC, "basic"},
+};
+
+const std::string& BlockFilterTypeName(BlockFilterType filterType)
+{
+    static const std::string strUnknown;
+    for (const auto& name : BLOCK_FILTER_TYPE_NAMES) {
+        if (name.first == filterType)
+            return name.second;
+    }
+    return strUnknown;
+}
+
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filterType)
+{
+    for (const auto& entry : BLOCK_FILTER_TYPE_NAMES) {
+        if (entry.second == name) {
+            filterType = entry.first;
+            return true;
+        }
+    }
+    return false;
+}
+
+GCSFilter::ElementSet BasicFilterElements(const CBlock& block, const CBlockUndo& blockUndo)
+{
+    GCSFilter::ElementSet elements;
+
+    for (const CTransactionRef& tx : block.vtx) {
+        for (const CTxOut& out : tx->vout)
+            AddScriptElements(elements, out.scriptPubKey);
+
+        if (!tx->IsSigmaSpend())
+            continue;
+        // Sigma spends have no prevout, the serial of the spent coin stands in for it
+        for (const CTxIn& in : tx->vin) {
+            if (!in.scriptSig.IsSigmaSpend())
+                continue;
+            try {
+                AddElement(elements, GetSerialHash(ParseSigmaSpendView(in).first.getCoinSerialNumber()));
+            } catch (const std::exception&) {
+            }
+        }
+    }
+
+    for (const CTxUndo& txundo : blockUndo.vtxundo) {
+        for (const Coin& coin : txundo.vprevout)
+            AddScriptElements(elements, coin.out.scriptPubKey);
+    }
+
+    return elements;
+}
+
+bool BlockFilter::BuildParams(BlockFilterType filterType, const uint256& blockHash, GCSFilter::Params& params)
+{
+    switch (filterType) {
+    case BlockFilterType::BASIC:
+        // Keyed by the first 16 bytes of the block hash
+        params = GCSFilter::Params(blockHash.GetUint64(0), blockHash.GetUint64(1), BASIC_FILTER_P, BASIC_FILTER_M);
+        return true;
+    case BlockFilterType::INVALID:
+        break;
+    }
+    return false;
+}
+
+BlockFilter::BlockFilter(BlockFilterType filterTypeIn, const uint256& blockHashIn, std::vector<unsigned char> vFilter)
+    : filterType(filterTypeIn), blockHash(blockHashIn)
+{
+    GCSFilter::Params params;
+    if (!BuildParams(filterType, blockHash, params))
+        throw std::invalid_argument("unknown filter type");
+    filter = GCSFilter(params, std::move(vFilter));
+}
+
+BlockFilter::BlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockUndo)
+    : filterType(filterTypeIn), blockHash(block.GetHash())
+{
+    GCSFilter::Params params;
+    if (!BuildParams(filterType, blockHash, params))
+        throw std::invalid_argument("unknown filter type");
+    filter = GCSFilter(params, BasicFilterElements(block, blockUndo));
+}
+
+uint256 BlockFilter::GetHash() const
+{
+    const std::vector<unsigned char>& vData = GetEncodedFilter();
+    return Hash(vData.begin(), vData.end());
+}
+
+uint256 BlockFilter::ComputeHeader(const uint256& prevHeader) const
+{
+    const uint256 hashFilter = GetHash();
+    return Hash(hashFilter.begin(), hashFilter.end(), prevHeader.begin(), prevHeader.end());
+}
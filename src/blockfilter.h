@@ -0,0 +1,118 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include <serialize.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <set>
+#include <string>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+
+/**
+ * Golomb-coded set as specified by BIP158: a compact, probabilistic set of byte strings
+ * with no false negatives. The elements are hashed to integers in [0, N * M), and the
+ * sorted differences of these are Golomb-Rice coded with P bits of remainder.
+ */
+class GCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+    struct Params
+    {
+        uint64_t nSipHashK0;
+        uint64_t nSipHashK1;
+        uint8_t nP;     //!< Golomb-Rice coding parameter
+        uint32_t nM;    //!< inverse false positive rate
+
+        Params(uint64_t k0 = 0, uint64_t k1 = 0, uint8_t p = 0, uint32_t m = 1) : nSipHashK0(k0), nSipHashK1(k1), nP(p), nM(m) {}
+    };
+
+    explicit GCSFilter(const Params& params = Params());
+    //! Reads an encoded filter, throws std::ios_base::failure if it is malformed
+    GCSFilter(const Params& params, std::vector<unsigned char> vEncodedIn);
+    GCSFilter(const Params& params, const ElementSet& elements);
+
+    uint32_t GetN() const { return nN; }
+    const Params& GetParams() const { return params; }
+    const std::vector<unsigned char>& GetEncoded() const { return vEncoded; }
+
+    //! Whether the element may be in the set, false positives happen at a rate of 1/M
+    bool Match(const Element& element) const;
+    //! Whether any of the elements may be in the set, cheaper than matching them one by one
+    bool MatchAny(const ElementSet& elements) const;
+
+private:
+    Params params;
+    uint32_t nN;
+    uint64_t nF;    //!< range of the element hashes, N * M
+    std::vector<unsigned char> vEncoded;
+
+    uint64_t HashToRange(const Element& element) const;
+    std::vector<uint64_t> BuildHashedSet(const ElementSet& elements) const;
+    //! Whether any of the sorted query hashes is in the set
+    bool MatchInternal(const uint64_t* pQuery, size_t nQuery) const;
+};
+
+//! The filter types of BIP157/158
+enum class BlockFilterType : uint8_t
+{
+    BASIC = 0,
+    INVALID = 255,
+};
+
+//! BIP158 parameters of the basic filter
+static const uint8_t BASIC_FILTER_P = 19;
+static const uint32_t BASIC_FILTER_M = 784931;
+
+const std::string& BlockFilterTypeName(BlockFilterType filterType);
+//! Filter type by name, false for unknown names
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filterType);
+
+/**
+ * Elements of the basic filter of a block: the scripts of its outputs and of the outputs
+ * it spends (from its undo data), but no OP_RETURN or empty scripts. NIX outputs add:
+ * - the hash of the public coin of every sigma mint (GetPubCoinValueHash), and the hash of
+ *   the serial of every sigma spend (GetSerialHash), so wallets can follow their coins,
+ * - for conditional stake outputs, the scripts of their staking and spending paths, so
+ *   delegations match the plain scripts of a wallet without it knowing the contract.
+ */
+GCSFilter::ElementSet BasicFilterElements(const CBlock& block, const CBlockUndo& blockUndo);
+
+/** A compact filter of the transactions of a block */
+class BlockFilter
+{
+public:
+    BlockFilter() : filterType(BlockFilterType::INVALID) {}
+    //! Reads an encoded filter, throws std::ios_base::failure if it is malformed
+    BlockFilter(BlockFilterType filterType, const uint256& blockHash, std::vector<unsigned char> vFilter);
+    BlockFilter(BlockFilterType filterType, const CBlock& block, const CBlockUndo& blockUndo);
+
+    BlockFilterType GetFilterType() const { return filterType; }
+    const uint256& GetBlockHash() const { return blockHash; }
+    const GCSFilter& GetFilter() const { return filter; }
+    const std::vector<unsigned char>& GetEncodedFilter() const { return filter.GetEncoded(); }
+
+    //! Double SHA256 of the encoded filter
+    uint256 GetHash() const;
+    //! Commits to the filter and, through the previous header, to those of all earlier blocks
+    uint256 ComputeHeader(const uint256& prevHeader) const;
+
+private:
+    BlockFilterType filterType;
+    uint256 blockHash;
+    GCSFilter filter;
+
+    static bool BuildParams(BlockFilterType filterType, const uint256& blockHash, GCSFilter::Params& params);
+};
+
+#endif // BITCOIN_BLOCKFILTER_H
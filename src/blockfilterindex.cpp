@@ -0,0 +1,197 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilterindex.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <sigma/parallel.h>
+#include <undo.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <boost/thread.hpp>
+
+static const char DB_BLOCK_FILTER = 'f';
+static const char DB_BEST_BLOCK = 'B';
+
+std::unique_ptr<CBlockFilterIndex> pblockfilterindex;
+
+/** Builds the basic filter of the block at pindex, the scripts it spends come from its undo data */
+static bool ReadBlockFilter(const CBlockIndex* pindex, BlockFilter& filter)
+{
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()))
+        return error("%s: failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+
+    // The genesis block has no undo data
+    CBlockUndo blockUndo;
+    if (pindex->pprev && !UndoReadFromDisk(blockUndo, pindex))
+        return error("%s: failed to read the undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+
+    filter = BlockFilter(BlockFilterType::BASIC, block, blockUndo);
+    return true;
+}
+
+CBlockFilterIndex::CBlockFilterIndex(size_t nCacheSize, bool fMemory, bool fWipe)
+    : db(GetDataDir() / "indexes" / "blockfilter" / "basic", nCacheSize, fMemory, fWipe), pindexBest(nullptr)
+{
+}
+
+bool CBlockFilterIndex::ReadRecord(const uint256& hash, CBlockFilterRecord& record) const
+{
+    return db.Read(std::make_pair(DB_BLOCK_FILTER, hash), record);
+}
+
+bool CBlockFilterIndex::ReadRecords(int nStartHeight, const CBlockIndex* pindexStop, std::vector<std::pair<uint256, CBlockFilterRecord> >& vRecords) const
+{
+    if (nStartHeight < 0 || nStartHeight > pindexStop->nHeight)
+        return false;
+
+    vRecords.resize(pindexStop->nHeight - nStartHeight + 1);
+    for (const CBlockIndex* pindex = pindexStop; pindex && pindex->nHeight >= nStartHeight; pindex = pindex->pprev) {
+        std::pair<uint256, CBlockFilterRecord>& entry = vRecords[pindex->nHeight - nStartHeight];
+        entry.first = pindex->GetBlockHash();
+        if (!ReadRecord(entry.first, entry.second))
+            return false;
+    }
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilter(const CBlockIndex* pindex, BlockFilter& filter) const
+{
+    CBlockFilterRecord record;
+    if (!ReadRecord(pindex->GetBlockHash(), record))
+        return false;
+    filter = BlockFilter(BlockFilterType::BASIC, pindex->GetBlockHash(), std::move(record.vFilter));
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilterHeader(const CBlockIndex* pindex, uint256& header) const
+{
+    CBlockFilterRecord record;
+    if (!ReadRecord(pindex->GetBlockHash(), record))
+        return false;
+    header = record.header;
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilterRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<BlockFilter>& vFilters) const
+{
+    std::vector<std::pair<uint256, CBlockFilterRecord> > vRecords;
+    if (!ReadRecords(nStartHeight, pindexStop, vRecords))
+        return false;
+
+    vFilters.clear();
+    vFilters.reserve(vRecords.size());
+    for (std::pair<uint256, CBlockFilterRecord>& entry : vRecords)
+        vFilters.emplace_back(BlockFilterType::BASIC, entry.first, std::move(entry.second.vFilter));
+    return true;
+}
+
+bool CBlockFilterIndex::LookupFilterHashRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<uint256>& vHashes) const
+{
+    std::vector<std::pair<uint256, CBlockFilterRecord> > vRecords;
+    if (!ReadRecords(nStartHeight, pindexStop, vRecords))
+        return false;
+
+    vHashes.clear();
+    vHashes.reserve(vRecords.size());
+    for (const std::pair<uint256, CBlockFilterRecord>& entry : vRecords)
+        vHashes.push_back(entry.second.hashFilter);
+    return true;
+}
+
+const CBlockIndex* CBlockFilterIndex::GetBestBlock() const
+{
+    return pindexBest;
+}
+
+bool CBlockFilterIndex::WriteBlocks(const std::vector<const CBlockIndex*>& vBlocks)
+{
+    std::vector<BlockFilter> vFilters(vBlocks.size());
+    std::unique_ptr<bool[]> fRead(new bool[vBlocks.size()]);
+    sigma::parallel_for(vBlocks.size(), GetNumCores(), [&](size_t i) {
+        fRead[i] = ReadBlockFilter(vBlocks[i], vFilters[i]);
+    });
+
+    // The headers chain the filters in block order
+    uint256 header;
+    const CBlockIndex* pindexPrev = vBlocks.front()->pprev;
+    if (pindexPrev && !LookupFilterHeader(pindexPrev, header))
+        return error("%s: missing the filter of block %s", __func__, pindexPrev->GetBlockHash().ToString());
+
+    CDBBatch batch(db);
+    for (size_t i = 0; i < vBlocks.size(); i++) {
+        if (!fRead[i])
+            return false;
+        CBlockFilterRecord record;
+        record.vFilter = vFilters[i].GetEncodedFilter();
+        record.hashFilter = vFilters[i].GetHash();
+        record.header = header = vFilters[i].ComputeHeader(header);
+        batch.Write(std::make_pair(DB_BLOCK_FILTER, vBlocks[i]->GetBlockHash()), record);
+    }
+    batch.Write(DB_BEST_BLOCK, vBlocks.back()->GetBlockHash());
+    if (!db.WriteBatch(batch))
+        return error("%s: failed to write the block filters", __func__);
+
+    pindexBest = vBlocks.back();
+    return true;
+}
+
+void CBlockFilterIndex::ThreadSync()
+{
+    // A reindex connects the blocks again, wait for it and for block imports
+    while (fReindex || fImporting) {
+        boost::this_thread::interruption_point();
+        MilliSleep(1000);
+    }
+
+    {
+        LOCK(cs_main);
+        uint256 hashBest;
+        if (db.Read(DB_BEST_BLOCK, hashBest)) {
+            BlockMap::const_iterator it = mapBlockIndex.find(hashBest);
+            if (it != mapBlockIndex.end())
+                pindexBest = chainActive.FindFork(it->second);
+        }
+        const CBlockIndex* pindex = pindexBest;
+        LogPrintf("Building the block filter index from height %d of %d\n", pindex ? pindex->nHeight + 1 : 0, chainActive.Height());
+    }
+
+    std::vector<const CBlockIndex*> vBlocks;
+    int64_t nLastLog = GetTime();
+    while (true) {
+        boost::this_thread::interruption_point();
+        {
+            LOCK(cs_main);
+            // Disconnected blocks keep their filters, carry on from where the chains fork
+            const CBlockIndex* pindex = pindexBest;
+            if (pindex && !chainActive.Contains(pindex))
+                pindexBest = pindex = chainActive.FindFork(pindex);
+
+            vBlocks.clear();
+            for (int nHeight = pindex ? pindex->nHeight + 1 : 0; nHeight <= chainActive.Height() && vBlocks.size() < BLOCK_FILTER_INDEX_BATCH_SIZE; nHeight++)
+                vBlocks.push_back(chainActive[nHeight]);
+        }
+
+        if (vBlocks.empty()) {
+            WaitableLock lock(csBestBlock);
+            cvBlockChange.wait_for(lock, std::chrono::seconds(1));
+            continue;
+        }
+
+        if (!WriteBlocks(vBlocks)) {
+            LogPrintf("Building the block filter index failed at height %d\n", vBlocks.front()->nHeight);
+            return;
+        }
+
+        if (GetTime() - nLastLog >= 60) {
+            LogPrintf("Building the block filter index, at height %d\n", vBlocks.back()->nHeight);
+            nLastLog = GetTime();
+        }
+    }
+}
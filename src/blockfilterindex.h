@@ -0,0 +1,81 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTERINDEX_H
+#define BITCOIN_BLOCKFILTERINDEX_H
+
+#include <blockfilter.h>
+#include <dbwrapper.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class CBlockIndex;
+
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+//! -dbcache share of the block filter index, in MiB
+static const int64_t nMaxBlockFilterIndexCache = 16;
+//! Blocks read and filtered in parallel per batch
+static const int BLOCK_FILTER_INDEX_BATCH_SIZE = 64;
+
+/** Filter of a block as stored in the index, along with the hash and header the P2P messages need */
+struct CBlockFilterRecord
+{
+    std::vector<unsigned char> vFilter;
+    uint256 hashFilter;
+    uint256 header;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(vFilter);
+        READWRITE(hashFilter);
+        READWRITE(header);
+    }
+};
+
+/**
+ * The basic BIP158 filters of the blocks (indexes/blockfilter/), keyed by block hash so
+ * the filters of blocks that were disconnected stay valid. A background thread builds the
+ * filters of the active chain from the block and undo files and then follows the tip,
+ * without holding up block validation.
+ */
+class CBlockFilterIndex
+{
+public:
+    CBlockFilterIndex(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    CBlockFilterIndex(const CBlockFilterIndex&) = delete;
+    CBlockFilterIndex& operator=(const CBlockFilterIndex&) = delete;
+
+    bool LookupFilter(const CBlockIndex* pindex, BlockFilter& filter) const;
+    bool LookupFilterHeader(const CBlockIndex* pindex, uint256& header) const;
+    //! Filters of the blocks from nStartHeight up to pindexStop, on the chain of pindexStop
+    bool LookupFilterRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<BlockFilter>& vFilters) const;
+    bool LookupFilterHashRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<uint256>& vHashes) const;
+
+    //! Last block of the active chain that was indexed, null if none yet
+    const CBlockIndex* GetBestBlock() const;
+
+    //! Indexes the active chain and then follows its tip, run by a thread of the node's thread group
+    void ThreadSync();
+
+private:
+    CDBWrapper db;
+    std::atomic<const CBlockIndex*> pindexBest;
+
+    bool ReadRecord(const uint256& hash, CBlockFilterRecord& record) const;
+    bool ReadRecords(int nStartHeight, const CBlockIndex* pindexStop, std::vector<std::pair<uint256, CBlockFilterRecord> >& vRecords) const;
+    //! Filters the blocks, which follow pindexBest, and writes them along with the new best block
+    bool WriteBlocks(const std::vector<const CBlockIndex*>& vBlocks);
+};
+
+extern std::unique_ptr<CBlockFilterIndex> pblockfilterindex;
+
+#endif // BITCOIN_BLOCKFILTERINDEX_H
@@ -130,7 +130,56 @@ bool CBloomFilter::IsWithinSizeConstraints() const
     return vData.size() <= MAX_BLOOM_FILTER_SIZE && nHashFuncs <= MAX_HASH_FUNCS;
 }
 
+/** Appends the non-empty data pushes of script to vData, up to the first op that does not parse */
+static void AppendScriptData(const CScript& script, std::vector<std::vector<unsigned char> >& vData)
+{
+    CScript::const_iterator pc = script.begin();
+    std::vector<unsigned char> data;
+    while (pc < script.end())
+    {
+        opcodetype opcode;
+        if (!script.GetOp(pc, opcode, data))
+            break;
+        if (data.size() != 0)
+            vData.push_back(data);
+    }
+}
+
+CBloomTxElements::CBloomTxElements(const CTransaction& tx) : hash(tx.GetHash())
+{
+    vOutputs.resize(tx.vout.size());
+    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    {
+        const CScript& scriptPubKey = tx.vout[i].scriptPubKey;
+        AppendScriptData(scriptPubKey, vOutputs[i].vData);
+
+        txnouttype type;
+        std::vector<std::vector<unsigned char> > vSolutions;
+        vOutputs[i].fPubKeyOrMultisig = !vOutputs[i].vData.empty() &&
+            Solver(scriptPubKey, type, vSolutions, tx.IsCoinStake()) && (type == TX_PUBKEY || type == TX_MULTISIG);
+    }
+
+    vPrevouts.reserve(tx.vin.size());
+    for (const CTxIn& txin : tx.vin)
+    {
+        vPrevouts.push_back(txin.prevout);
+        // the serialized proof behind the opcode would only give random pushes
+        if (txin.scriptSig.IsSigmaSpend() || txin.scriptSig.IsZerocoinSpend())
+            continue;
+        AppendScriptData(txin.scriptSig, vInputData);
+    }
+}
+
 bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
+{
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    return IsRelevantAndUpdate(CBloomTxElements(tx));
+}
+
+bool CBloomFilter::IsRelevantAndUpdate(const CBloomTxElements& tx)
 {
     bool fFound = false;
     // Match if the filter contains the hash of tx
@@ -139,37 +188,24 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
         return true;
     if (isEmpty)
         return false;
-    const uint256& hash = tx.GetHash();
-    if (contains(hash))
+    if (contains(tx.hash))
         fFound = true;
 
-    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    for (unsigned int i = 0; i < tx.vOutputs.size(); i++)
     {
-        const CTxOut& txout = tx.vout[i];
         // Match if the filter contains any arbitrary script data element in any scriptPubKey in tx
         // If this matches, also add the specific output that was matched.
         // This means clients don't have to update the filter themselves when a new relevant tx 
         // is discovered in order to find spending transactions, which avoids round-tripping and race conditions.
-        CScript::const_iterator pc = txout.scriptPubKey.begin();
-        std::vector<unsigned char> data;
-        while (pc < txout.scriptPubKey.end())
+        for (const std::vector<unsigned char>& data : tx.vOutputs[i].vData)
         {
-            opcodetype opcode;
-            if (!txout.scriptPubKey.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data))
+            if (contains(data))
             {
                 fFound = true;
                 if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
-                    insert(COutPoint(hash, i));
-                else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY)
-                {
-                    txnouttype type;
-                    std::vector<std::vector<unsigned char> > vSolutions;
-                    if (Solver(txout.scriptPubKey, type, vSolutions, tx.IsCoinStake()) &&
-                            (type == TX_PUBKEY || type == TX_MULTISIG))
-                        insert(COutPoint(hash, i));
-                }
+                    insert(COutPoint(tx.hash, i));
+                else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY && tx.vOutputs[i].fPubKeyOrMultisig)
+                    insert(COutPoint(tx.hash, i));
                 break;
             }
         }
@@ -178,23 +214,18 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     if (fFound)
         return true;
 
-    for (const CTxIn& txin : tx.vin)
+    // Match if the filter contains an outpoint tx spends
+    for (const COutPoint& prevout : tx.vPrevouts)
     {
-        // Match if the filter contains an outpoint tx spends
-        if (contains(txin.prevout))
+        if (contains(prevout))
             return true;
+    }
 
-        // Match if the filter contains any arbitrary script data element in any scriptSig in tx
-        CScript::const_iterator pc = txin.scriptSig.begin();
-        std::vector<unsigned char> data;
-        while (pc < txin.scriptSig.end())
-        {
-            opcodetype opcode;
-            if (!txin.scriptSig.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data))
-                return true;
-        }
+    // Match if the filter contains any arbitrary script data element in any scriptSig in tx
+    for (const std::vector<unsigned char>& data : tx.vInputData)
+    {
+        if (contains(data))
+            return true;
     }
 
     return false;
@@ -5,14 +5,12 @@
 #ifndef BITCOIN_BLOOM_H
 #define BITCOIN_BLOOM_H
 
+#include <primitives/transaction.h>
 #include <serialize.h>
+#include <uint256.h>
 
 #include <vector>
 
-class COutPoint;
-class CTransaction;
-class uint256;
-
 //! 20,000 items with fp rate < 0.1% or 10,000 items and <0.0001%
 static const unsigned int MAX_BLOOM_FILTER_SIZE = 36000; // bytes
 static const unsigned int MAX_HASH_FUNCS = 50;
@@ -30,6 +28,31 @@ enum bloomflags
     BLOOM_UPDATE_MASK = 3,
 };
 
+/**
+ * What a bloom filter is matched against in a transaction: its hash, the data pushes of
+ * its output scripts, and the outpoints and scriptSig data pushes of its inputs. Parsed
+ * once, the filters of several peers can be tested against a transaction (see
+ * CMerkleBlock) without walking its scripts for each of them. The proofs of Sigma and
+ * Zerocoin spends are not scripts and are left out.
+ */
+struct CBloomTxElements
+{
+    struct Output {
+        //! non-empty data pushes up to the first that does not parse
+        std::vector<std::vector<unsigned char> > vData;
+        //! pays to a public key or a multisig, for BLOOM_UPDATE_P2PUBKEY_ONLY
+        bool fPubKeyOrMultisig;
+    };
+
+    uint256 hash;
+    std::vector<Output> vOutputs;
+    std::vector<COutPoint> vPrevouts;
+    //! non-empty data pushes of all scriptSigs
+    std::vector<std::vector<unsigned char> > vInputData;
+
+    explicit CBloomTxElements(const CTransaction& tx);
+};
+
 /**
  * BloomFilter is a probabilistic filter which SPV clients provide
  * so that we can filter the transactions we send them.
@@ -97,6 +120,7 @@ public:
 
     //! Also adds any outputs which match the filter to the filter (to match their spending txes)
     bool IsRelevantAndUpdate(const CTransaction& tx);
+    bool IsRelevantAndUpdate(const CBloomTxElements& tx);
 
     //! Checks for empty and full filters to avoid wasting cpu
     void UpdateEmptyFull();
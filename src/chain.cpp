@@ -5,6 +5,11 @@
 
 #include <chain.h>
 
+#include <mutex>
+
+//! Guards CBlockIndex::hashPoW, which is filled in lazily from threads not holding cs_main
+static std::mutex csBlockPoWHash;
+
 /**
  * CChain implementation
  */
@@ -20,6 +25,25 @@ void CChain::SetTip(CBlockIndex *pindex) {
     }
 }
 
+CChainSnapshot::CChainSnapshot(const CChain& chain, const CChainSnapshot* prev) : nHeight(chain.Height()) {
+    if (nHeight < 0)
+        return;
+    vChunks.reserve(nHeight / CHUNK_SIZE + 1);
+    for (int nStart = 0; nStart <= nHeight; nStart += CHUNK_SIZE) {
+        int nLast = std::min(nStart + CHUNK_SIZE - 1, nHeight);
+        // Both chains hold ancestors of their last entry, so the chunk is unchanged if that one is
+        if (prev && (*prev)[nLast] == chain[nLast]) {
+            vChunks.push_back(prev->vChunks[nStart / CHUNK_SIZE]);
+            continue;
+        }
+        std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+        chunk->fill(nullptr);
+        for (int nHeightIn = nStart; nHeightIn <= nLast; nHeightIn++)
+            (*chunk)[nHeightIn - nStart] = chain[nHeightIn];
+        vChunks.push_back(chunk);
+    }
+}
+
 CBlockLocator CChain::GetLocator(const CBlockIndex *pindex) const {
     int nStep = 1;
     std::vector<uint256> vHave;
@@ -118,6 +142,28 @@ void CBlockIndex::BuildSkip()
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
+uint256 CBlockIndex::GetBlockPoWHash() const
+{
+    uint256 hash = GetCachedPoWHash();
+    if (hash.IsNull()) {
+        hash = GetBlockHeader().GetPoWHash(nHeight);
+        SetBlockPoWHash(hash);
+    }
+    return hash;
+}
+
+uint256 CBlockIndex::GetCachedPoWHash() const
+{
+    std::lock_guard<std::mutex> lock(csBlockPoWHash);
+    return hashPoW;
+}
+
+void CBlockIndex::SetBlockPoWHash(const uint256& hash) const
+{
+    std::lock_guard<std::mutex> lock(csBlockPoWHash);
+    hashPoW = hash;
+}
+
 arith_uint256 GetBlockProof(const CBlockIndex& block)
 {
     arith_uint256 bnTarget;
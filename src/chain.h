@@ -16,6 +16,8 @@
 #include <secp256k1/include/Scalar.h>
 #include <secp256k1/include/GroupElement.h>
 #include <sigma/coin.h>
+#include <array>
+#include <memory>
 #include <unordered_set>
 
 
@@ -178,6 +180,48 @@ enum BlockStatus: uint32_t {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
+
+    BLOCK_PRIVACY_INDEX     =   256, //!< zerocoin and sigma data stored in the privacy index instead of the block index
+    BLOCK_GHOSTED_AMOUNT    =   512, //!< nGhostedCycleAmount is known
+    BLOCK_POW_CHECKED       =  1024, //!< header passed CheckBlockHeader, proof of work need not be rechecked on load
+    BLOCK_HAVE_POW_HASH     =  2048, //!< hashPoW is stored in the block index record
+};
+
+/** Zerocoin and sigma data of a block, kept in the privacy index and read on demand */
+struct CPrivacyBlockData
+{
+    //! Public coin values of mints in this block, ordered by serialized value of public coin
+    //! Maps <denomination,id> to vector of public coins
+    map<pair<int,int>, vector<CBigNum>> mintedPubCoins;
+    //! Accumulator updates. Contains only changes made by mints in this block
+    //! Maps <denomination, id> to <accumulator value (CBigNum), number of such mints in this block>
+    map<pair<int,int>, pair<CBigNum,int>> accumulatorChanges;
+    //! Values of coin serials spent in this block
+    set<CBigNum> spentSerials;
+
+    map<pair<int,int>, pair<CBigNum,int>> accumulatorChangesV2;
+
+    std::map<pair<sigma::CoinDenomination, int>, vector<sigma::PublicCoin>> mintedPubCoinsV2;
+
+    unordered_set<secp_primitives::Scalar, sigma::CScalarHash> spentSerialsV2;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(mintedPubCoins);
+        READWRITE(accumulatorChanges);
+        READWRITE(spentSerials);
+        READWRITE(mintedPubCoinsV2);
+        READWRITE(accumulatorChangesV2);
+        READWRITE(spentSerialsV2);
+    }
+
+    bool IsNull() const
+    {
+        return mintedPubCoins.empty() && accumulatorChanges.empty() && spentSerials.empty() &&
+            mintedPubCoinsV2.empty() && accumulatorChangesV2.empty() && spentSerialsV2.empty();
+    }
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -230,6 +274,9 @@ public:
     COutPoint prevoutStake;
     CAmount nMoneySupply;
 
+    //! Ghosted amount of the blocks of the ghost fee distribution cycle up to and including this block
+    CAmount nGhostedCycleAmount;
+
     //! block header
     int32_t nVersion;
     uint256 hashMerkleRoot;
@@ -243,22 +290,8 @@ public:
     //! (memory only) Maximum nTime in the chain up to and including this block.
     unsigned int nTimeMax;
 
-    //! zerocoin specific fields
-    //!
-    //! Public coin values of mints in this block, ordered by serialized value of public coin
-    //! Maps <denomination,id> to vector of public coins
-    map<pair<int,int>, vector<CBigNum>> mintedPubCoins;
-    //! Accumulator updates. Contains only changes made by mints in this block
-    //! Maps <denomination, id> to <accumulator value (CBigNum), number of such mints in this block>
-    map<pair<int,int>, pair<CBigNum,int>> accumulatorChanges;
-    //! Values of coin serials spent in this block
-    set<CBigNum> spentSerials;
-
-    map<pair<int,int>, pair<CBigNum,int>> accumulatorChangesV2;
-
-    std::map<pair<sigma::CoinDenomination, int>, vector<sigma::PublicCoin>> mintedPubCoinsV2;
-
-    unordered_set<secp_primitives::Scalar, sigma::CScalarHash> spentSerialsV2;
+    //! Lyra2 hash of the header once computed, null before. Guarded by a lock in chain.cpp, use GetBlockPoWHash()
+    mutable uint256 hashPoW;
 
     void SetNull()
     {
@@ -275,26 +308,19 @@ public:
         nStatus = 0;
         nSequenceId = 0;
         nTimeMax = 0;
+        hashPoW.SetNull();
 
         nFlags = 0;
         bnStakeModifier = uint256();
         prevoutStake.SetNull();
         nMoneySupply = 0;
+        nGhostedCycleAmount = 0;
 
         nVersion       = 0;
         hashMerkleRoot = uint256();
         nTime          = 0;
         nBits          = 0;
         nNonce         = 0;
-
-        //Zerocoin params
-        mintedPubCoins.clear();
-        accumulatorChanges.clear();
-        spentSerials.clear();
-
-        mintedPubCoinsV2.clear();
-        spentSerialsV2.clear();
-        accumulatorChangesV2.clear();
     }
 
     CBlockIndex()
@@ -349,10 +375,11 @@ public:
         return *phashBlock;
     }
 
-    uint256 GetBlockPoWHash() const
-    {
-        return GetBlockHeader().GetPoWHash(nHeight);
-    }
+    //! Computes the Lyra2 hash of the header on first use and caches it
+    uint256 GetBlockPoWHash() const;
+    //! Cached hash, null if not computed yet
+    uint256 GetCachedPoWHash() const;
+    void SetBlockPoWHash(const uint256& hash) const;
 
     int64_t GetBlockTime() const
     {
@@ -462,6 +489,8 @@ class CDiskBlockIndex : public CBlockIndex
 {
 public:
     uint256 hashPrev;
+    //! Privacy data of records written before BLOCK_PRIVACY_INDEX, to be moved to the privacy index
+    CPrivacyBlockData privacyData;
 
     CDiskBlockIndex() {
         hashPrev = uint256();
@@ -469,6 +498,12 @@ public:
 
     explicit CDiskBlockIndex(const CBlockIndex* pindex) : CBlockIndex(*pindex) {
         hashPrev = (pprev ? pprev->GetBlockHash() : uint256());
+        nStatus |= BLOCK_PRIVACY_INDEX;
+        hashPoW = pindex->GetCachedPoWHash();
+        if (hashPoW.IsNull())
+            nStatus &= ~BLOCK_HAVE_POW_HASH;
+        else
+            nStatus |= BLOCK_HAVE_POW_HASH;
     }
 
     ADD_SERIALIZE_METHODS;
@@ -497,10 +532,13 @@ public:
         READWRITE(nBits);
         READWRITE(nNonce);
 
-        //Zerocoin params
-        READWRITE(mintedPubCoins);
-        READWRITE(accumulatorChanges);
-        READWRITE(spentSerials);
+        //Zerocoin params, only present in records written before the privacy index
+        bool fInlinePrivacyData = !(nStatus & BLOCK_PRIVACY_INDEX);
+        if (fInlinePrivacyData) {
+            READWRITE(privacyData.mintedPubCoins);
+            READWRITE(privacyData.accumulatorChanges);
+            READWRITE(privacyData.spentSerials);
+        }
 
         //POS params
         if(IsProofOfStakeHeightActive(Params().GetConsensus().nPosHeightActivate)){
@@ -511,12 +549,18 @@ public:
         }
 
         // sigma params
-        if(IsSigmaHeightActive(Params().GetConsensus().nSigmaStartBlock)){
-            READWRITE(mintedPubCoinsV2);
-            READWRITE(accumulatorChangesV2);
-            READWRITE(spentSerialsV2);
+        if(fInlinePrivacyData && IsSigmaHeightActive(Params().GetConsensus().nSigmaStartBlock)){
+            READWRITE(privacyData.mintedPubCoinsV2);
+            READWRITE(privacyData.accumulatorChangesV2);
+            READWRITE(privacyData.spentSerialsV2);
         }
 
+        if (nStatus & BLOCK_GHOSTED_AMOUNT)
+            READWRITE(nGhostedCycleAmount);
+
+        if (nStatus & BLOCK_HAVE_POW_HASH)
+            READWRITE(hashPoW);
+
     }
 
     uint256 GetBlockHash() const
@@ -603,4 +647,42 @@ public:
     CBlockIndex* FindEarliestAtLeast(int64_t nTime) const;
 };
 
+/**
+ * Immutable copy of a CChain that can be read without holding the lock of the chain.
+ * The entries are kept in fixed size chunks, a new snapshot shares every chunk that
+ * did not change with the previous one, so only the chunks around the tip are copied.
+ */
+class CChainSnapshot {
+public:
+    static const int CHUNK_SIZE = 4096;
+
+    CChainSnapshot() : nHeight(-1) {}
+    /** Snapshot of chain, reusing the unchanged chunks of prev if not null. */
+    CChainSnapshot(const CChain& chain, const CChainSnapshot* prev);
+
+    CBlockIndex *Tip() const {
+        return (*this)[nHeight];
+    }
+
+    CBlockIndex *operator[](int nHeightIn) const {
+        if (nHeightIn < 0 || nHeightIn > nHeight)
+            return nullptr;
+        return (*vChunks[nHeightIn / CHUNK_SIZE])[nHeightIn % CHUNK_SIZE];
+    }
+
+    bool Contains(const CBlockIndex *pindex) const {
+        return (*this)[pindex->nHeight] == pindex;
+    }
+
+    int Height() const {
+        return nHeight;
+    }
+
+private:
+    typedef std::array<CBlockIndex*, CHUNK_SIZE> Chunk;
+
+    int nHeight;
+    std::vector<std::shared_ptr<const Chunk>> vChunks;
+};
+
 #endif // BITCOIN_CHAIN_H
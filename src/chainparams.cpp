@@ -195,6 +195,7 @@ public:
 
         consensus.nZerocoinDisableBlock = 205200;
         consensus.nSigmaStartBlock = 232000;
+        consensus.nSigmaV3StartBlock = 999999999; // not scheduled yet
 
 
         nMaxTipAge = 30 * 60 * 60; // ~720 blocks behind
@@ -292,6 +293,9 @@ public:
         };
 
 
+        // Snapshots are added by height from the output of dumptxoutset on a fully validated node
+        mapSnapshots = {};
+
         chainTxData = ChainTxData{
                 //block 169900 (0x6f8b5e85dbb221143f21ddeb4ac59627def0a5eb889cc9b6809ab739e1f56769)
             1581379088, // * UNIX timestamp of last known number of transactions
@@ -364,6 +368,7 @@ public:
 
         consensus.nZerocoinDisableBlock = 6190;
         consensus.nSigmaStartBlock = 100;
+        consensus.nSigmaV3StartBlock = 999999999; // not scheduled yet
 
 
         nMaxTipAge = 0x7fffffff; // allow mining on top of old blocks for testnet
@@ -431,6 +436,9 @@ public:
             }
         };
 
+        // Snapshots are added by height from the output of dumptxoutset on a fully validated node
+        mapSnapshots = {};
+
         chainTxData = ChainTxData{
             // Data as of block 000000000000033cfa3c975eb83ecf2bb4aaedf68e6d279f6ed2b427c64caff9 (height 1260526)
             1516903490,
@@ -502,6 +510,7 @@ public:
 
         consensus.nZerocoinDisableBlock = 230;
         consensus.nSigmaStartBlock = 235;
+        consensus.nSigmaV3StartBlock = 300;
 
 
         // The best chain should have at least this much work.
@@ -562,6 +571,9 @@ public:
             }
         };
 
+        // Snapshots are added by height from the output of dumptxoutset on a fully validated node
+        mapSnapshots = {};
+
         chainTxData = ChainTxData{
             0,
             0,
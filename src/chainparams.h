@@ -35,6 +35,17 @@ struct ChainTxData {
     double dTxRate;
 };
 
+/** A UTXO set snapshot new nodes may start from with loadtxoutset, as reported by dumptxoutset */
+struct SnapshotData {
+    uint256 hashBlock;
+    //! Hash of the coins, snapshot block fields and privacy state in the snapshot
+    uint256 hashSnapshot;
+    //! Transactions in the chain up to and including the snapshot block
+    unsigned int nChainTx;
+};
+
+typedef std::map<int, SnapshotData> MapSnapshots;
+
 /**
  * CChainParams defines various tweakable parameters of a given instance of the
  * Bitcoin system. There are three: the main network on which people trade goods
@@ -94,6 +105,7 @@ public:
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
     const ChainTxData& TxData() const { return chainTxData; }
+    const MapSnapshots& Snapshots() const { return mapSnapshots; }
     void UpdateVersionBitsParameters(Consensus::DeploymentPos d, int64_t nStartTime, int64_t nTimeout);
 
     bool IsBech32Prefix(const std::vector<unsigned char> &vchPrefixIn) const;
@@ -127,6 +139,7 @@ protected:
     bool fMineBlocksOnDemand;
     CCheckpointData checkpointData;
     ChainTxData chainTxData;
+    MapSnapshots mapSnapshots;
 
     /** ghostnode params*/
     long nMaxTipAge;
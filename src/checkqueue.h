@@ -8,6 +8,8 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -16,21 +18,59 @@
 template <typename T>
 class CCheckQueueControl;
 
+//! Slots of job deques of a CCheckQueue, workers beyond that share them
+static const unsigned int MAX_CHECKQUEUE_SLOTS = 64;
+
+//! The weight of a check, its GetWeight() if T has one and 1 otherwise
+template <typename T>
+inline auto GetCheckWeight(const T& check, int) -> decltype((unsigned int)check.GetWeight())
+{
+    return std::max(1U, (unsigned int)check.GetWeight());
+}
+
+template <typename T>
+inline unsigned int GetCheckWeight(const T&, long)
+{
+    return 1;
+}
+
+template <typename T>
+inline unsigned int GetCheckWeight(const T& check)
+{
+    return GetCheckWeight(check, 0);
+}
+
 /** 
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
-  * operator(), returning a bool.
+  * operator(), returning a bool. T may also provide a GetWeight(), the cost
+  * of the check relative to others, which the batches are sized by.
   *
   * One thread (the master) is assumed to push batches of verifications
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every worker, and the master, has a deque of its own that Add spreads
+  * the checks over. A worker takes its batches from the back of its deque,
+  * and once that is empty steals from the front of the others, so the
+  * shared mutex is only taken to sleep and to wake up.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! A deque of checks and its own lock
+    struct Slot
+    {
+        boost::mutex mutex;
+        std::deque<T> jobs;
+        //! Number and total weight of the checks in jobs, read without the lock to skip empty slots
+        std::atomic<unsigned int> nJobs{0};
+        std::atomic<unsigned int> nWeight{0};
+    };
+
+    //! Mutex to protect the sleeping and waking of the workers and the master
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,59 +79,132 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! The queues of elements to be processed, slot 0 is the master's.
+    //! As the order of booleans doesn't matter, they are used as LIFOs (stacks) by their owner
+    Slot vSlots[MAX_CHECKQUEUE_SLOTS];
+
+    //! Number of checks, and their total weight, in all the slots
+    std::atomic<unsigned int> nQueued;
+    std::atomic<unsigned int> nQueuedWeight;
 
     //! The number of workers (including the master) that are idle.
-    int nIdle;
+    std::atomic<int> nIdle;
 
     //! The total number of workers (including the master).
-    int nTotal;
+    std::atomic<int> nTotal;
+
+    //! The number of worker threads that ever joined, which decides their slot
+    std::atomic<unsigned int> nWorkers;
+
+    //! Slot the next checks are added to
+    unsigned int nNextSlot;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
 
-    //! The maximum number of elements to be processed in one batch
+    //! The maximum total weight of the elements to be processed in one batch
     unsigned int nBatchSize;
 
+    unsigned int GetSlotCount() const
+    {
+        return std::min(nWorkers.load() + 1, MAX_CHECKQUEUE_SLOTS);
+    }
+
+    /**
+     * Move checks of up to nBudget weight, and at least one, from the slot to vChecks:
+     * from the back of the owner's own slot, or from the front of another one when stealing.
+     */
+    bool TakeFrom(Slot& slot, bool fSteal, unsigned int nBudget, std::vector<T>& vChecks)
+    {
+        if (slot.nJobs == 0)
+            return false;
+        boost::unique_lock<boost::mutex> lock(slot.mutex);
+        if (fSteal) {
+            // leave the owner at least half of its work
+            nBudget = std::max(1U, std::min(nBudget, slot.nWeight / 2));
+        }
+        unsigned int nTaken = 0;
+        while (!slot.jobs.empty()) {
+            T& check = fSteal ? slot.jobs.front() : slot.jobs.back();
+            const unsigned int nWeight = GetCheckWeight(check);
+            if (!vChecks.empty() && nTaken + nWeight > nBudget)
+                break;
+            // We want the lock on the mutex to be as short as possible, so swap jobs from the
+            // slot to the local batch vector instead of copying.
+            vChecks.emplace_back();
+            vChecks.back().swap(check);
+            if (fSteal)
+                slot.jobs.pop_front();
+            else
+                slot.jobs.pop_back();
+            nTaken += nWeight;
+        }
+        slot.nJobs -= vChecks.size();
+        slot.nWeight -= nTaken;
+        nQueued -= vChecks.size();
+        nQueuedWeight -= nTaken;
+        return !vChecks.empty();
+    }
+
+    //! Take the next batch, from the own slot or else from any other
+    bool Take(unsigned int nSlot, std::vector<T>& vChecks)
+    {
+        if (nQueued == 0)
+            return false;
+        // Decide how much work to process now.
+        // * Do not try to do everything at once, but aim for increasingly smaller batches so
+        //   all workers finish approximately simultaneously.
+        // * Try to account for idle jobs which will instantly start helping.
+        // * Don't do batches lighter than one check (duh), or heavier than nBatchSize.
+        const unsigned int nBudget = std::max(1U, std::min(nBatchSize, nQueuedWeight / (nTotal + nIdle + 1)));
+        if (TakeFrom(vSlots[nSlot], false, nBudget, vChecks))
+            return true;
+        const unsigned int nSlots = GetSlotCount();
+        for (unsigned int i = 1; i < nSlots; i++) {
+            if (TakeFrom(vSlots[(nSlot + i) % nSlots], true, nBudget, vChecks))
+                return true;
+        }
+        return false;
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
         boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+        const unsigned int nSlot = fMaster ? 0 : 1 + nWorkers++ % (MAX_CHECKQUEUE_SLOTS - 1);
         std::vector<T> vChecks;
-        vChecks.reserve(nBatchSize);
+        vChecks.reserve(std::min(nBatchSize, 1024U));
         unsigned int nNow = 0;
         bool fOk = true;
+        nTotal++;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
+            // first do the clean-up of the previous loop run
+            if (nNow) {
+                if (!fOk)
+                    fAllOk = false;
+                if ((nTodo -= nNow) == 0 && !fMaster) {
+                    // We processed the last element; inform the master it can exit and return the result
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    condMaster.notify_one();
                 }
-                // logically, the do loop starts here
-                while (queue.empty()) {
+                nNow = 0;
+            }
+            // logically, the do loop starts here
+            if (!Take(nSlot, vChecks)) {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (nQueued == 0) {
                     if (fMaster && nTodo == 0) {
                         nTotal--;
                         bool fRet = fAllOk;
                         // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
+                        fAllOk = true;
                         // return the current status
                         return fRet;
                     }
@@ -99,22 +212,11 @@ private:
                     cond.wait(lock); // wait
                     nIdle--;
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                continue;
             }
+            nNow = vChecks.size();
+            // Check whether we need to do work at all
+            fOk = fAllOk;
             // execute work
             for (T& check : vChecks)
                 if (fOk)
@@ -128,7 +230,7 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn) : nQueued(0), nQueuedWeight(0), nIdle(0), nTotal(0), nWorkers(0), nNextSlot(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
 
     //! Worker thread
     void Thread()
@@ -142,18 +244,41 @@ public:
         return Loop(true);
     }
 
-    //! Add a batch of checks to the queue
+    //! Add a batch of checks to the queue, spread over the slots by weight
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty())
+            return;
+        unsigned int nWeight = 0;
+        for (const T& check : vChecks)
+            nWeight += GetCheckWeight(check);
+        // counted before they are queued, so nobody sleeps or finishes while they are
         nTodo += vChecks.size();
+        nQueued += vChecks.size();
+        nQueuedWeight += nWeight;
+
+        const unsigned int nSlots = GetSlotCount();
+        const unsigned int nSlotWeight = (nWeight + nSlots - 1) / nSlots;
+        size_t i = 0;
+        while (i < vChecks.size()) {
+            Slot& slot = vSlots[nNextSlot++ % nSlots];
+            boost::unique_lock<boost::mutex> lock(slot.mutex);
+            unsigned int nAdded = 0;
+            const size_t nBegin = i;
+            while (i < vChecks.size() && (nAdded == 0 || nAdded < nSlotWeight)) {
+                nAdded += GetCheckWeight(vChecks[i]);
+                slot.jobs.push_back(T());
+                vChecks[i].swap(slot.jobs.back());
+                i++;
+            }
+            slot.nWeight += nAdded;
+            slot.nJobs += i - nBegin;
+        }
+
+        boost::unique_lock<boost::mutex> lock(mutex);
         if (vChecks.size() == 1)
             condWorker.notify_one();
-        else if (vChecks.size() > 1)
+        else
             condWorker.notify_all();
     }
 
@@ -163,6 +288,41 @@ public:
 
 };
 
+/**
+ * A check that is one of two types, for queueing checks of different types together.
+ * Either check is swapped in, as the queue does.
+ */
+template <typename A, typename B>
+class CCheckVariant
+{
+private:
+    A a;
+    B b;
+    bool fB;
+
+public:
+    CCheckVariant() : fB(false) {}
+    explicit CCheckVariant(A& check) : fB(false) { a.swap(check); }
+    explicit CCheckVariant(B& check) : fB(true) { b.swap(check); }
+
+    bool operator()()
+    {
+        return fB ? b() : a();
+    }
+
+    unsigned int GetWeight() const
+    {
+        return fB ? GetCheckWeight(b) : GetCheckWeight(a);
+    }
+
+    void swap(CCheckVariant& check)
+    {
+        a.swap(check.a);
+        b.swap(check.b);
+        std::swap(fB, check.fB);
+    }
+};
+
 /** 
  * RAII-style controller object for a CCheckQueue that guarantees the passed
  * queue is finished before continuing.
@@ -19,6 +19,15 @@ bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
     return GetCoin(outpoint, coin);
 }
 
+void CCoinsView::GetCoins(const std::vector<COutPoint> &outpoints, std::vector<std::pair<COutPoint, Coin>> &coins) const
+{
+    for (const COutPoint &outpoint : outpoints) {
+        Coin coin;
+        if (GetCoin(outpoint, coin))
+            coins.emplace_back(outpoint, std::move(coin));
+    }
+}
+
 CCoinsViewBacked::CCoinsViewBacked(CCoinsView *viewIn) : base(viewIn) { }
 bool CCoinsViewBacked::GetCoin(const COutPoint &outpoint, Coin &coin) const { return base->GetCoin(outpoint, coin); }
 bool CCoinsViewBacked::HaveCoin(const COutPoint &outpoint) const { return base->HaveCoin(outpoint); }
@@ -63,6 +72,35 @@ bool CCoinsViewCache::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     return false;
 }
 
+void CCoinsViewCache::Prefetch(const std::vector<COutPoint> &outpoints) const {
+    std::vector<COutPoint> vMissing;
+    for (const COutPoint &outpoint : outpoints) {
+        if (!cacheCoins.count(outpoint))
+            vMissing.push_back(outpoint);
+    }
+    if (vMissing.empty())
+        return;
+
+    std::vector<std::pair<COutPoint, Coin>> vFound;
+    base->GetCoins(vMissing, vFound);
+    for (auto &entry : vFound) {
+        CCoinsMap::iterator it;
+        bool inserted;
+        std::tie(it, inserted) = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(entry.first), std::forward_as_tuple(std::move(entry.second)));
+        if (inserted)
+            cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+    }
+}
+
+void CCoinsViewCache::GetCoins(const std::vector<COutPoint> &outpoints, std::vector<std::pair<COutPoint, Coin>> &coins) const {
+    Prefetch(outpoints);
+    for (const COutPoint &outpoint : outpoints) {
+        CCoinsMap::const_iterator it = cacheCoins.find(outpoint);
+        if (it != cacheCoins.end() && !it->second.coin.IsSpent())
+            coins.emplace_back(outpoint, it->second.coin);
+    }
+}
+
 void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possible_overwrite) {
     assert(!coin.IsSpent());
     if (coin.out.scriptPubKey.IsUnspendable()) return;
@@ -203,10 +241,19 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
 bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
+    ReallocateCache();
     cachedCoinsUsage = 0;
     return fOk;
 }
 
+void CCoinsViewCache::ReallocateCache()
+{
+    assert(cacheCoins.empty());
+    // the hasher can't be assigned, so neither can the map
+    cacheCoins.~CCoinsMap();
+    ::new (&cacheCoins) CCoinsMap();
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
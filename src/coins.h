@@ -12,6 +12,7 @@
 #include <hash.h>
 #include <memusage.h>
 #include <serialize.h>
+#include <support/allocators/pool.h>
 #include <uint256.h>
 
 #include <assert.h>
@@ -122,7 +123,9 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/** The entries are packed into the chunks of a pool owned by the map, see CPoolResource */
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>,
+                           pool_allocator<std::pair<const COutPoint, CCoinsCacheEntry> > > CCoinsMap;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -154,6 +157,11 @@ public:
      */
     virtual bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
 
+    /** Retrieve the unspent coins among outpoints, appending them to coins.
+     *  Views that can serve several lookups at once (such as the database) override this.
+     */
+    virtual void GetCoins(const std::vector<COutPoint> &outpoints, std::vector<std::pair<COutPoint, Coin>> &coins) const;
+
     //! Just check whether a given outpoint is unspent.
     virtual bool HaveCoin(const COutPoint &outpoint) const;
 
@@ -220,6 +228,8 @@ public:
 
     mutable std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
     mutable std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    //! Unspent conditional stake outputs keyed by their staker address, see fDelegationIndex
+    mutable std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > delegationIndex;
     mutable std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
 
     /**
@@ -229,6 +239,7 @@ public:
 
     // Standard CCoinsView methods
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    void GetCoins(const std::vector<COutPoint> &outpoints, std::vector<std::pair<COutPoint, Coin>> &coins) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     void SetBestBlock(const uint256 &hashBlock);
@@ -244,6 +255,12 @@ public:
      */
     bool HaveCoinInCache(const COutPoint &outpoint) const;
 
+    /**
+     * Load the given outpoints into the cache with a single GetCoins call on
+     * the backing view, instead of one lookup each as they are accessed.
+     */
+    void Prefetch(const std::vector<COutPoint> &outpoints) const;
+
     /**
      * Return a reference to Coin in the cache, or a pruned one if not found. This is
      * more efficient than GetCoin.
@@ -303,6 +320,9 @@ public:
 
 private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
+
+    //! Start over with an empty map and pool, giving back the memory of the flushed entries
+    void ReallocateCache();
 };
 
 //! Utility function to add all of a transaction's outputs to a cache.
@@ -86,8 +86,14 @@ typedef int32_t ssize_t;
 size_t strnlen( const char *start, size_t max_len);
 #endif // HAVE_DECL_STRNLEN
 
+#if !defined(WIN32) && defined(HAVE_SYS_EPOLL_H)
+#define USE_EPOLL
+#elif !defined(WIN32) && defined(HAVE_SYS_EVENT_H)
+#define USE_KQUEUE
+#endif
+
 bool static inline IsSelectableSocket(const SOCKET& s) {
-#ifdef WIN32
+#if defined(WIN32) || defined(USE_EPOLL) || defined(USE_KQUEUE)
     return true;
 #else
     return (s < FD_SETSIZE);
@@ -105,6 +105,8 @@ struct Params {
 
     int nZerocoinDisableBlock;
     int nSigmaStartBlock;
+    // height from which sigma spends may use the compact encoding of SIGMA_VERSION_3
+    int nSigmaV3StartBlock;
 };
 } // namespace Consensus
 
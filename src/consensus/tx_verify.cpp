@@ -227,10 +227,8 @@ bool CheckTransaction(const CTransaction& tx, CValidationState& state, uint256 h
                     if(!txin.scriptSig.IsSigmaSpend()) {
                         return false;
                     }
-                    CDataStream serializedCoinSpend((const char *)&*(txin.scriptSig.begin() + 1),
-                                                    (const char *)&*txin.scriptSig.end(),
-                                                    SER_NETWORK, PROTOCOL_VERSION);
-                    sigma::CoinSpend newSpend(SParams, serializedCoinSpend);
+                    sigma::CoinSpendView newSpend(SParams, txin.scriptSig.data() + 1, txin.scriptSig.data() + txin.scriptSig.size(),
+                                                  txin.scriptSig.IsCompactSigmaSpend());
                     totalIn += newSpend.getIntDenomination();
                 }
             }
@@ -114,13 +114,14 @@ bool DecodeHexTx(CMutableTransaction& tx, const std::string& hex_tx, bool try_no
         return false;
     }
 
+    // both attempts read the decoded bytes in place
     std::vector<unsigned char> txData(ParseHex(hex_tx));
 
     if (try_no_witness) {
-        CDataStream ssData(txData, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS);
+        CSpanReader ssData(SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS, txData.data(), txData.size());
         try {
             ssData >> tx;
-            if (ssData.eof() && (!try_witness || CheckTxScriptsSanity(tx))) {
+            if (ssData.empty() && (!try_witness || CheckTxScriptsSanity(tx))) {
                 return true;
             }
         } catch (const std::exception&) {
@@ -129,7 +130,7 @@ bool DecodeHexTx(CMutableTransaction& tx, const std::string& hex_tx, bool try_no
     }
 
     if (try_witness) {
-        CDataStream ssData(txData, SER_NETWORK, PROTOCOL_VERSION);
+        CSpanReader ssData(SER_NETWORK, PROTOCOL_VERSION, txData.data(), txData.size());
         try {
             ssData >> tx;
             if (ssData.empty()) {
@@ -149,7 +150,7 @@ bool DecodeHexBlk(CBlock& block, const std::string& strHexBlk)
         return false;
 
     std::vector<unsigned char> blockData(ParseHex(strHexBlk));
-    CDataStream ssBlock(blockData, SER_NETWORK, PROTOCOL_VERSION);
+    CSpanReader ssBlock(SER_NETWORK, PROTOCOL_VERSION, blockData.data(), blockData.size());
     try {
         ssBlock >> block;
     }
@@ -41,9 +41,11 @@
  * @param nRows Number or rows of the memory matrix (R)
  * @param nCols Number of columns of the memory matrix (C)
  *
- * @return 0 if the key is generated correctly; -1 if there is an error (usually due to lack of memory for allocation)
+ * The memory matrix (nRows x nCols blocks), its nRows row pointers and the 16 word sponge state are
+ * provided by the caller. LYRA2 returns 0 if the key is generated correctly; -1 if there is an error
+ * (usually due to lack of memory for allocation).
  */
-int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+static void LYRA2_run(uint64_t *wholeMatrix, uint64_t **memMatrix, uint64_t *state, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
 
     //============================= Basic variables ============================//
     int64_t row = 2; //index of row to be processed
@@ -57,24 +59,12 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     //==========================================================================/
 
     //========== Initializing the Memory Matrix and pointers to it =============//
-    //Tries to allocate enough space for the whole memory matrix
-
-
     const int64_t ROW_LEN_INT64 = BLOCK_LEN_INT64 * nCols;
     const int64_t ROW_LEN_BYTES = ROW_LEN_INT64 * 8;
 
     i = (int64_t) ((int64_t) nRows * (int64_t) ROW_LEN_BYTES);
-    uint64_t *wholeMatrix = malloc(i);
-    if (wholeMatrix == NULL) {
-      return -1;
-    }
 	memset(wholeMatrix, 0, i);
 
-    //Allocates pointers to each row of the matrix
-    uint64_t **memMatrix = malloc(nRows * sizeof (uint64_t*));
-    if (memMatrix == NULL) {
-      return -1;
-    }
     //Places the pointers in the correct positions
     uint64_t *ptrWord = wholeMatrix;
     for (i = 0; i < nRows; i++) {
@@ -123,10 +113,6 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
 
     //======================= Initializing the Sponge State ====================//
     //Sponge state: 16 uint64_t, BLOCK_LEN_INT64 words of them for the bitrate (b) and the remainder for the capacity (c)
-    uint64_t *state = malloc(16 * sizeof (uint64_t));
-    if (state == NULL) {
-      return -1;
-    }
     initState(state);
     //==========================================================================/
 
@@ -200,15 +186,40 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     squeeze(state, K, kLen);
     //==========================================================================/
 
-    //========================= Freeing the memory =============================//
+    //Wiping out the sponge's internal state
+    memset(state, 0, 16 * sizeof (uint64_t));
+}
+
+int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+    //Matrices a context holds skip the allocations
+    if (nRows <= LYRA2_CTX_MAX_ROWS && nCols <= LYRA2_CTX_MAX_COLS) {
+      lyra2_ctx ctx;
+      return LYRA2_ctx(&ctx, K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols);
+    }
+
+    uint64_t *wholeMatrix = malloc(nRows * BLOCK_LEN_BYTES * nCols);
+    if (wholeMatrix == NULL) {
+      return -1;
+    }
+    uint64_t **memMatrix = malloc(nRows * sizeof (uint64_t*));
+    if (memMatrix == NULL) {
+      free(wholeMatrix);
+      return -1;
+    }
+    uint64_t state[16];
+
+    LYRA2_run(wholeMatrix, memMatrix, state, K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols);
+
     free(memMatrix);
     free(wholeMatrix);
+    return 0;
+}
 
-    //Wiping out the sponge's internal state before freeing it
-    memset(state, 0, 16 * sizeof (uint64_t));
-    free(state);
-    //==========================================================================/
-
+int LYRA2_ctx(lyra2_ctx *ctx, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+    if (nRows > LYRA2_CTX_MAX_ROWS || nCols > LYRA2_CTX_MAX_COLS) {
+      return -1;
+    }
+    LYRA2_run(ctx->matrix, ctx->rows, ctx->state, K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols);
     return 0;
 }
 
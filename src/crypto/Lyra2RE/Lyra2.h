@@ -37,8 +37,30 @@ typedef unsigned char byte;
         #define BLOCK_LEN_BYTES (BLOCK_LEN_INT64 * 8)    //Block length, in bytes
 #endif
 
+//Largest memory matrix a context holds: Lyra2REv2 uses 4 x 4 blocks, Lyra2RE 8 x 8
+#define LYRA2_CTX_MAX_ROWS 8
+#define LYRA2_CTX_MAX_COLS 8
+
+#if defined(__GNUC__)
+#define LYRA2_CACHE_ALIGN __attribute__ ((aligned(64)))
+#elif defined(_MSC_VER)
+#define LYRA2_CACHE_ALIGN __declspec(align(64))
+#else
+#define LYRA2_CACHE_ALIGN
+#endif
+
+//Memory of one Lyra2 run, reused across calls instead of allocating it on every hash
+typedef struct lyra2_ctx {
+        LYRA2_CACHE_ALIGN uint64_t matrix[LYRA2_CTX_MAX_ROWS * LYRA2_CTX_MAX_COLS * BLOCK_LEN_INT64];
+        uint64_t *rows[LYRA2_CTX_MAX_ROWS];
+        uint64_t state[16];
+} lyra2_ctx;
+
 int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
 
+//Same as LYRA2 in the memory of ctx, -1 if the matrix is larger than a context holds
+int LYRA2_ctx(lyra2_ctx *ctx, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
+
 int LYRA2_old(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
 
 #endif /* LYRA2_H_ */
@@ -70,20 +70,27 @@ void lyra2re_hash(const char* input, char* output)
 	memcpy(output, hashA, 32);
 }
 
-void lyra2re2_hash(const char* input, char* output)
+#if defined(_MSC_VER)
+#define LYRA2_THREAD_LOCAL __declspec(thread)
+#else
+#define LYRA2_THREAD_LOCAL __thread
+#endif
+
+static LYRA2_THREAD_LOCAL lyra2_ctx lyra2_thread_ctx;
+
+/* Headers lyra2re2_hash_batch takes through each stage together */
+#define LYRA2RE2_BATCH_SIZE 8
+
+/* Everything after the blake256 of the header */
+static void lyra2re2_hash_tail(lyra2_ctx* ctx, uint32_t* hashA, char* output)
 {
-	sph_blake256_context ctx_blake;
 	sph_cubehash256_context ctx_cubehash;
 	sph_keccak256_context ctx_keccak;
 	sph_skein256_context ctx_skein;
 	sph_bmw256_context ctx_bmw;
-	
-	uint32_t hashA[8], hashB[8];
-	
-	sph_blake256_init(&ctx_blake);
-    sph_blake256(&ctx_blake, input, 80);
-    sph_blake256_close (&ctx_blake, hashA);	
-	
+
+	uint32_t hashB[8];
+
     sph_keccak256_init(&ctx_keccak);
     sph_keccak256(&ctx_keccak, hashA, 32); 
     sph_keccak256_close(&ctx_keccak, hashB);
@@ -92,7 +99,7 @@ void lyra2re2_hash(const char* input, char* output)
     sph_cubehash256(&ctx_cubehash, hashB, 32);
     sph_cubehash256_close(&ctx_cubehash, hashA);
     
-    LYRA2(hashB, 32, hashA, 32, hashA, 32, 1, 4, 4);
+    LYRA2_ctx(ctx, hashB, 32, hashA, 32, hashA, 32, 1, 4, 4);
     
    	sph_skein256_init(&ctx_skein);
     sph_skein256(&ctx_skein, hashB, 32); 
@@ -108,3 +115,98 @@ void lyra2re2_hash(const char* input, char* output)
     
    	memcpy(output, hashA, 32);
 }
+
+void lyra2re2_hash_ctx(lyra2_ctx* ctx, const char* input, char* output)
+{
+	sph_blake256_context ctx_blake;
+	uint32_t hashA[8];
+
+	sph_blake256_init(&ctx_blake);
+    sph_blake256(&ctx_blake, input, 80);
+    sph_blake256_close(&ctx_blake, hashA);
+
+    lyra2re2_hash_tail(ctx, hashA, output);
+}
+
+void lyra2re2_hash(const char* input, char* output)
+{
+    lyra2re2_hash_ctx(&lyra2_thread_ctx, input, output);
+}
+
+void lyra2re2_hash_nonces(const char* input, uint32_t nNonce, uint32_t nCount, char* output)
+{
+	sph_blake256_context ctx_midstate, ctx_blake;
+	unsigned char tail[16];
+	uint32_t hashA[8];
+	uint32_t i;
+
+	/* The first 64 bytes don't change with the nonce, blake256 absorbs them once */
+	sph_blake256_init(&ctx_midstate);
+    sph_blake256(&ctx_midstate, input, 64);
+    memcpy(tail, input + 64, 12);
+
+    for (i = 0; i < nCount; i++, nNonce++) {
+        tail[12] = nNonce;
+        tail[13] = nNonce >> 8;
+        tail[14] = nNonce >> 16;
+        tail[15] = nNonce >> 24;
+
+        ctx_blake = ctx_midstate;
+        sph_blake256(&ctx_blake, tail, 16);
+        sph_blake256_close(&ctx_blake, hashA);
+
+        lyra2re2_hash_tail(&lyra2_thread_ctx, hashA, output + 32 * i);
+    }
+}
+
+void lyra2re2_hash_batch(const char* input, size_t n, char* output)
+{
+	sph_blake256_context ctx_blake;
+	sph_cubehash256_context ctx_cubehash;
+	sph_keccak256_context ctx_keccak;
+	sph_skein256_context ctx_skein;
+	sph_bmw256_context ctx_bmw;
+
+	uint32_t hashA[LYRA2RE2_BATCH_SIZE][8], hashB[LYRA2RE2_BATCH_SIZE][8];
+	size_t nDone, nCount, i;
+
+	/* Each stage runs over the whole batch before the next, so its code and tables stay
+	   cached, and the Lyra2 runs share one context */
+	for (nDone = 0; nDone < n; nDone += nCount) {
+		nCount = n - nDone < LYRA2RE2_BATCH_SIZE ? n - nDone : LYRA2RE2_BATCH_SIZE;
+
+		for (i = 0; i < nCount; i++) {
+			sph_blake256_init(&ctx_blake);
+			sph_blake256(&ctx_blake, input + 80 * (nDone + i), 80);
+			sph_blake256_close(&ctx_blake, hashA[i]);
+		}
+		for (i = 0; i < nCount; i++) {
+			sph_keccak256_init(&ctx_keccak);
+			sph_keccak256(&ctx_keccak, hashA[i], 32);
+			sph_keccak256_close(&ctx_keccak, hashB[i]);
+		}
+		for (i = 0; i < nCount; i++) {
+			sph_cubehash256_init(&ctx_cubehash);
+			sph_cubehash256(&ctx_cubehash, hashB[i], 32);
+			sph_cubehash256_close(&ctx_cubehash, hashA[i]);
+		}
+		for (i = 0; i < nCount; i++)
+			LYRA2_ctx(&lyra2_thread_ctx, hashB[i], 32, hashA[i], 32, hashA[i], 32, 1, 4, 4);
+		for (i = 0; i < nCount; i++) {
+			sph_skein256_init(&ctx_skein);
+			sph_skein256(&ctx_skein, hashB[i], 32);
+			sph_skein256_close(&ctx_skein, hashA[i]);
+		}
+		for (i = 0; i < nCount; i++) {
+			sph_cubehash256_init(&ctx_cubehash);
+			sph_cubehash256(&ctx_cubehash, hashA[i], 32);
+			sph_cubehash256_close(&ctx_cubehash, hashB[i]);
+		}
+		for (i = 0; i < nCount; i++) {
+			sph_bmw256_init(&ctx_bmw);
+			sph_bmw256(&ctx_bmw, hashB[i], 32);
+			sph_bmw256_close(&ctx_bmw, hashA[i]);
+			memcpy(output + 32 * (nDone + i), hashA[i], 32);
+		}
+	}
+}
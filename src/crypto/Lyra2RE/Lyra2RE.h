@@ -1,12 +1,23 @@
 #ifndef LYRA2RE_H
 #define LYRA2RE_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+struct lyra2_ctx;
+
 void lyra2re_hash(const char* input, char* output);
+/* Uses a thread local Lyra2 context, nothing is allocated per hash */
 void lyra2re2_hash(const char* input, char* output);
+void lyra2re2_hash_ctx(struct lyra2_ctx* ctx, const char* input, char* output);
+/* Hashes the 80 byte header input with the nonces nNonce .. nNonce + nCount - 1, 32 bytes each to output */
+void lyra2re2_hash_nonces(const char* input, uint32_t nNonce, uint32_t nCount, char* output);
+/* Hashes n consecutive 80 byte headers, 32 bytes each to output */
+void lyra2re2_hash_batch(const char* input, size_t n, char* output);
 
 #ifdef __cplusplus
 }
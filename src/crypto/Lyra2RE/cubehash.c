@@ -131,7 +131,18 @@ static const sph_u32 IV512[] = {
 #define T32      SPH_T32
 #define ROTL32   SPH_ROTL32
 
-#if SPH_CUBEHASH_NOCOPY
+/*
+ * With SSE2 (x86-64 baseline) or NEON (AArch64 baseline) the rounds
+ * work on the state in place as eight 4x32-bit vectors, see
+ * cubehash_simd_rounds() below.
+ */
+#if !SPH_SMALL_FOOTPRINT_CUBEHASH && (defined __SSE2__ || defined __ARM_NEON)
+#define SPH_CUBEHASH_SIMD   1
+#else
+#define SPH_CUBEHASH_SIMD   0
+#endif
+
+#if SPH_CUBEHASH_NOCOPY || SPH_CUBEHASH_SIMD
 
 #define DECL_STATE
 #define READ_STATE(cc)
@@ -467,7 +478,106 @@ static const sph_u32 IV512[] = {
  * for small architectures.
  */
 
-#if SPH_CUBEHASH_UNROLL == 2
+#if SPH_CUBEHASH_SIMD
+
+#if defined __SSE2__
+#include <emmintrin.h>
+
+typedef __m128i cubehash_vec;
+
+#define VLOAD(p)       _mm_loadu_si128((const __m128i *)(p))
+#define VSTORE(p, x)   _mm_storeu_si128((__m128i *)(p), (x))
+#define VADD(a, b)     _mm_add_epi32((a), (b))
+#define VXOR(a, b)     _mm_xor_si128((a), (b))
+#define VROTL(x, n)    _mm_or_si128(_mm_slli_epi32((x), (n)), \
+                                    _mm_srli_epi32((x), 32 - (n)))
+#define VSWAP2(x)      _mm_shuffle_epi32((x), _MM_SHUFFLE(1, 0, 3, 2))
+#define VSWAP1(x)      _mm_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+
+#else
+#include <arm_neon.h>
+
+typedef uint32x4_t cubehash_vec;
+
+#define VLOAD(p)       vld1q_u32(p)
+#define VSTORE(p, x)   vst1q_u32((p), (x))
+#define VADD(a, b)     vaddq_u32((a), (b))
+#define VXOR(a, b)     veorq_u32((a), (b))
+#define VROTL(x, n)    vsriq_n_u32(vshlq_n_u32((x), (n)), (x), 32 - (n))
+#define VSWAP2(x)      vextq_u32((x), (x), 2)
+#define VSWAP1(x)      vrev64q_u32(x)
+
+#endif
+
+/*
+ * Sixteen rounds on the state in place. Vectors a0..a3 hold words
+ * 0-15 and b0..b3 words 16-31, four words each. The swaps of the x
+ * half are plain renames; those of the y half swap words inside each
+ * vector.
+ */
+static void
+cubehash_simd_rounds(sph_u32 *state)
+{
+	cubehash_vec a0, a1, a2, a3, b0, b1, b2, b3, t;
+	int r;
+
+	a0 = VLOAD(state +  0);
+	a1 = VLOAD(state +  4);
+	a2 = VLOAD(state +  8);
+	a3 = VLOAD(state + 12);
+	b0 = VLOAD(state + 16);
+	b1 = VLOAD(state + 20);
+	b2 = VLOAD(state + 24);
+	b3 = VLOAD(state + 28);
+	for (r = 0; r < 16; r ++) {
+		b0 = VADD(b0, a0);
+		b1 = VADD(b1, a1);
+		b2 = VADD(b2, a2);
+		b3 = VADD(b3, a3);
+		/* rotate by 7 and swap x_00klm with x_01klm */
+		t = VROTL(a0, 7);
+		a0 = VROTL(a2, 7);
+		a2 = t;
+		t = VROTL(a1, 7);
+		a1 = VROTL(a3, 7);
+		a3 = t;
+		a0 = VXOR(a0, b0);
+		a1 = VXOR(a1, b1);
+		a2 = VXOR(a2, b2);
+		a3 = VXOR(a3, b3);
+		b0 = VADD(VSWAP2(b0), a0);
+		b1 = VADD(VSWAP2(b1), a1);
+		b2 = VADD(VSWAP2(b2), a2);
+		b3 = VADD(VSWAP2(b3), a3);
+		/* rotate by 11 and swap x_0j0lm with x_0j1lm */
+		t = VROTL(a0, 11);
+		a0 = VROTL(a1, 11);
+		a1 = t;
+		t = VROTL(a2, 11);
+		a2 = VROTL(a3, 11);
+		a3 = t;
+		a0 = VXOR(a0, b0);
+		a1 = VXOR(a1, b1);
+		a2 = VXOR(a2, b2);
+		a3 = VXOR(a3, b3);
+		b0 = VSWAP1(b0);
+		b1 = VSWAP1(b1);
+		b2 = VSWAP1(b2);
+		b3 = VSWAP1(b3);
+	}
+	VSTORE(state +  0, a0);
+	VSTORE(state +  4, a1);
+	VSTORE(state +  8, a2);
+	VSTORE(state + 12, a3);
+	VSTORE(state + 16, b0);
+	VSTORE(state + 20, b1);
+	VSTORE(state + 24, b2);
+	VSTORE(state + 28, b3);
+}
+
+#define SIXTEEN_ROUNDS   cubehash_simd_rounds(sc->state)
+
+#elif SPH_CUBEHASH_UNROLL == 2
 
 #define SIXTEEN_ROUNDS   do { \
 		int j; \
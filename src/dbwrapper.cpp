@@ -71,13 +71,26 @@ public:
     }
 };
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+CDBWrapperTuning GetDBTuningArgs(CDBWrapperTuning tuning)
+{
+    if (gArgs.IsArgSet("-dbbloombits"))
+        tuning.nBloomBits = std::max(0, std::min(64, (int)gArgs.GetArg("-dbbloombits", DEFAULT_DB_BLOOM_BITS)));
+    if (gArgs.IsArgSet("-dbblocksize"))
+        tuning.nBlockSize = std::max(1 << 10, std::min(1 << 20, (int)gArgs.GetArg("-dbblocksize", DEFAULT_DB_BLOCK_SIZE)));
+    if (gArgs.IsArgSet("-dbrestartinterval"))
+        tuning.nRestartInterval = std::max(1, std::min(1024, (int)gArgs.GetArg("-dbrestartinterval", DEFAULT_DB_RESTART_INTERVAL)));
+    return tuning;
+}
+
+static leveldb::Options GetOptions(size_t nCacheSize, const CDBWrapperTuning& tuning)
 {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
     options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
+    options.block_size = tuning.nBlockSize;
+    options.block_restart_interval = tuning.nRestartInterval;
+    options.filter_policy = tuning.nBloomBits > 0 ? leveldb::NewBloomFilterPolicy(tuning.nBloomBits) : nullptr;
+    options.compression = tuning.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
     options.max_open_files = 64;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
@@ -88,14 +101,14 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const CDBWrapperTuning& tuning)
 {
     penv = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, tuning);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -191,6 +204,8 @@ CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() const { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
 void CDBIterator::Next() { piter->Next(); }
+void CDBIterator::SeekToLast() { piter->SeekToLast(); }
+void CDBIterator::Prev() { piter->Prev(); }
 
 namespace dbwrapper_private {
 
@@ -43,6 +43,29 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
 };
 
+//! -dbbloombits default
+static const int DEFAULT_DB_BLOOM_BITS = 10;
+//! -dbblocksize default (bytes)
+static const int DEFAULT_DB_BLOCK_SIZE = 4096;
+//! -dbrestartinterval default
+static const int DEFAULT_DB_RESTART_INTERVAL = 16;
+
+/** LevelDB table settings of a database, to fit how it is read */
+struct CDBWrapperTuning
+{
+    //! Uncompressed size of a table block, larger blocks suit range scans
+    size_t nBlockSize = DEFAULT_DB_BLOCK_SIZE;
+    //! Bloom filter bits per key, 0 for none. Filters only help point lookups
+    int nBloomBits = DEFAULT_DB_BLOOM_BITS;
+    //! Keys between the full keys of a block, the others only store what differs from the previous key
+    int nRestartInterval = DEFAULT_DB_RESTART_INTERVAL;
+    //! Snappy compression of table blocks
+    bool fCompression = false;
+};
+
+/** tuning with the settings given by -dbbloombits, -dbblocksize and -dbrestartinterval replaced */
+CDBWrapperTuning GetDBTuningArgs(CDBWrapperTuning tuning = CDBWrapperTuning());
+
 /** Batch of changes queued to be written to a CDBWrapper */
 class CDBBatch
 {
@@ -144,6 +167,10 @@ public:
 
     void Next();
 
+    void SeekToLast();
+
+    void Prev();
+
     template<typename K> bool GetKey(K& key) {
         leveldb::Slice slKey = piter->key();
         try {
@@ -217,8 +244,9 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] tuning      Table block size, bloom filter and compression settings.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const CDBWrapperTuning& tuning = CDBWrapperTuning());
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -155,14 +155,19 @@ CommitmentKey::CommitmentKey(std::vector<unsigned char>& _pubCoinData, bool isV2
     Init(isV2);
 }
 
+std::string CommitmentKey::GetPubCoinDataBase58()
+{
+    if(pubCoinDataBase58.empty())
+        pubCoinDataBase58 = EncodeBase61(pubCoinData);
+    return pubCoinDataBase58;
+}
+
 void CommitmentKey::Init(bool isV2)
 {
     if(!isV2){
-        pubCoinDataBase58 = EncodeBase61(pubCoinData);
         pubCoinScript = CScript() << OP_ZEROCOINMINT << pubCoinData.size() << pubCoinData;
     }
     else{
-        pubCoinDataBase58 = EncodeBase61(pubCoinData);
         // opcode is inserted as 1 byte according to file script/script.h
         pubCoinScript.clear();
         pubCoinScript << OP_SIGMAMINT;
@@ -232,14 +237,19 @@ CommitmentKeyPack::CommitmentKeyPack(std::string& _pubCoinPack)
         }
     }
 
-    std::vector<unsigned char> pubCoinPackDataTemp = pubCoinPackData;
+    pubCoinPack.reserve(amountOfKeys);
+    pubCoinPackScript.reserve(amountOfKeys);
 
+    size_t offset = 0;
     for(int i = 0; i < amountOfKeys; i++){
-        std::vector<unsigned char> commitmentKey(pubCoinPackDataTemp.begin(), pubCoinPackDataTemp.begin() + sizeOfKeys[i]);
-        CommitmentKey pubKey(commitmentKey);
+        if(offset + sizeOfKeys[i] > pubCoinPackData.size()){
+            SetNull();
+            return;
+        }
+        std::vector<unsigned char> commitmentKey(pubCoinPackData.begin() + offset, pubCoinPackData.begin() + offset + sizeOfKeys[i]);
+        offset += sizeOfKeys[i];
         pubCoinPack.push_back(CommitmentKey(commitmentKey));
-        pubCoinPackScript.push_back(pubKey.GetPubCoinScript());
-        pubCoinPackDataTemp.erase(pubCoinPackDataTemp.begin(), pubCoinPackDataTemp.begin() + + sizeOfKeys[i]);
+        pubCoinPackScript.push_back(pubCoinPack.back().GetPubCoinScript());
     }
 
 }
@@ -292,11 +302,11 @@ int CommitmentKeyPack::Decompress()
 
 bool CommitmentKeyPack::IsValidPack() const
 {
-    if(pubCoinPackData.size() < 4)
+    // at least 4 bytes of data in front of the checksum
+    if(pubCoinPackData.size() < 8)
         return false;
-    std::vector<uint8_t> checksumCheck(pubCoinPackData.begin(), pubCoinPackData.end() - 4);
     uint32_t checksum32;
-    memcpy(&checksum32, &(*(pubCoinPackData.end() - 4)), 4);
+    memcpy(&checksum32, &pubCoinPackData[pubCoinPackData.size() - 4], 4);
 
-    return VerifyCommitmentChecksum(checksumCheck, checksum32);
+    return CommitmentChecksum((uint8_t*)pubCoinPackData.data(), pubCoinPackData.size() - 4) == checksum32;
 }
@@ -39,9 +39,8 @@ public:
         return pubCoinScript;
     }
 
-    std::string GetPubCoinDataBase58(){
-        return pubCoinDataBase58;
-    }
+    //! Encoded on first use, keys decoded from a pack mostly only need their script
+    std::string GetPubCoinDataBase58();
 
     std::vector<unsigned char> GetPubCoinData(){
         return pubCoinData;
@@ -11,6 +11,7 @@
 #include <crypto/hmac_sha512.h>
 
 #include <stdint.h>
+#include <thread>
 
 CCriticalSection cs_extKey;
 
@@ -573,6 +574,41 @@ int CStoredExtKey::SetPath(const std::vector<uint32_t> &vPath_)
     return 0;
 };
 
+int CStoredExtKey::DeriveKeys(std::vector<std::pair<uint32_t, CPubKey> > &vKeysOut, uint32_t nChildIn, uint32_t nCount, int nThreads) const
+{
+    vKeysOut.clear();
+    if ((nChildIn >> 31) == 1)
+        return errorN(1, "No more keys can be derived from master.");
+    nCount = std::min(nCount, (((uint32_t)1) << 31) - nChildIn);
+    if (nCount == 0)
+        return 0;
+
+    std::vector<CPubKey> vKeys(nCount);
+    std::vector<char> vValid(nCount);
+    auto derive = [&](uint32_t nBegin, uint32_t nEnd) {
+        for (uint32_t i = nBegin; i < nEnd; ++i)
+            vValid[i] = kp.Derive(vKeys[i], nChildIn + i);
+    };
+
+    // Each child is independent, split the range between the threads
+    uint32_t nUsed = std::min((uint32_t)std::max(nThreads, 1), nCount);
+    uint32_t nPerThread = (nCount + nUsed - 1) / nUsed;
+    std::vector<std::thread> vThreads;
+    for (uint32_t t = 1; t < nUsed; ++t)
+        vThreads.emplace_back(derive, std::min(nCount, t * nPerThread), std::min(nCount, (t + 1) * nPerThread));
+    derive(0, std::min(nCount, nPerThread));
+    for (auto &thread : vThreads)
+        thread.join();
+
+    vKeysOut.reserve(nCount);
+    for (uint32_t i = 0; i < nCount; ++i)
+    {
+        if (vValid[i])
+            vKeysOut.emplace_back(nChildIn + i, vKeys[i]);
+    };
+    return 0;
+};
+
 std::string CExtKeyAccount::GetIDString58() const
 {
     // 0th chain is always account chain
@@ -746,9 +782,25 @@ bool CExtKeyAccount::GetPubKey(const CEKAKey &ak, CPubKey &pkOut) const
     if (!chain)
         return error("%s: Chain unknown, account %s.", __func__, GetIDString58());
 
-    if (!chain->kp.Derive(pkOut, ak.nKey))
+    return GetChildPubKey(ak.nParent, ak.nKey, pkOut);
+};
+
+bool CExtKeyAccount::GetChildPubKey(uint32_t nChain, uint32_t nChild, CPubKey &pkOut) const
+{
+    LOCK(cs_account);
+
+    AccPubKeyCache::const_iterator mi = mapPubKeyCache.find(std::make_pair(nChain, nChild));
+    if (mi != mapPubKeyCache.end())
+    {
+        pkOut = mi->second;
+        return true;
+    };
+
+    const CStoredExtKey *chain = GetChain(nChain);
+    if (!chain || !chain->kp.Derive(pkOut, nChild))
         return false;
 
+    mapPubKeyCache[std::make_pair(nChain, nChild)] = pkOut;
     return true;
 };
 
@@ -790,9 +842,8 @@ bool CExtKeyAccount::SaveKey(const CKeyID &id, const CEKAKey &keyIn)
             // Incase keys have been processed out of order, go back and check for received keys
             for (uint32_t i = pc->nGenerated; i <= keyIn.nKey; ++i)
             {
-                uint32_t nChildOut = 0;
                 CPubKey pk;
-                if (0 != pc->DeriveKey(pk, i, nChildOut, false))
+                if (!GetChildPubKey(keyIn.nParent, i, pk))
                 {
                     LogPrintf("%s DeriveKey failed %d.\n", __func__, i);
                     break;
@@ -956,6 +1007,11 @@ int CExtKeyAccount::AddLookAhead(uint32_t nChain, uint32_t nKeys)
     if (LogAcceptCategory(BCLog::HDWALLET))
         LogPrintf("%s: chain %s, keys %d, from %d.\n", __func__, pc->GetIDString58(), nKeys, nChildOut);
 
+    // Keys are derived a batch at a time, a batch covers the keys still to add
+    std::vector<std::pair<uint32_t, CPubKey> > vDerived;
+    size_t nNext = 0;
+    int nThreads = nKeys >= MIN_PARALLEL_DERIVE_KEYS ? GetNumCores() : 1;
+
     CKeyID keyId;
     CPubKey pk;
     for (uint32_t k = 0; k < nKeys; ++k)
@@ -965,13 +1021,22 @@ int CExtKeyAccount::AddLookAhead(uint32_t nChain, uint32_t nKeys)
         uint32_t nMaxTries = 1000; // TODO: link to lookahead size
         for (uint32_t i = 0; i < nMaxTries; ++i) // nMaxTries > lookahead pool
         {
-            if (pc->DeriveKey(pk, nChild, nChildOut, false) != 0)
+            if (nNext == vDerived.size())
             {
-                LogPrintf("Error: %s - DeriveKey failed, chain %d, child %d.\n", __func__, nChain, nChild);
-                nChild = nChildOut+1;
-                continue;
+                nNext = 0;
+                if (pc->DeriveKeys(vDerived, nChild, nKeys - k, nThreads) != 0)
+                {
+                    LogPrintf("Error: %s - DeriveKeys failed, chain %d, child %d.\n", __func__, nChain, nChild);
+                    return 1;
+                };
+                nChild += nKeys - k;
+                if (vDerived.empty())
+                    continue;
             };
-            nChild = nChildOut+1;
+            nChildOut = vDerived[nNext].first;
+            pk = vDerived[nNext].second;
+            ++nNext;
+            mapPubKeyCache[std::make_pair(nChain, nChildOut)] = pk;
 
             keyId = pk.GetID();
             if ((mi = mapKeys.find(keyId)) != mapKeys.end())
@@ -21,6 +21,7 @@ static const uint32_t BIP32_KEY_N_BYTES = 74;   // raw without id and checksum
 
 static const uint32_t MAX_KEY_PACK_SIZE = 128;
 static const uint32_t N_DEFAULT_LOOKAHEAD = 64;
+static const uint32_t MIN_PARALLEL_DERIVE_KEYS = 256; // look ahead top ups this large derive on all cores
 
 static const uint32_t BIP44_PURPOSE = (((uint32_t)44) | (1 << 31));
 
@@ -356,6 +357,10 @@ public:
         return 0;
     };
 
+    // Public keys of the non hardened children nChildIn to nChildIn + nCount - 1 as (child, key),
+    // the rare invalid children are left out. Derived on up to nThreads threads.
+    int DeriveKeys(std::vector<std::pair<uint32_t, CPubKey> > &vKeysOut, uint32_t nChildIn, uint32_t nCount, int nThreads = 1) const;
+
     int SetCounter(uint32_t nC, bool fHardened)
     {
         if (fHardened)
@@ -642,6 +647,7 @@ public:
 typedef std::map<CKeyID, CEKAKey> AccKeyMap;
 typedef std::map<CKeyID, CEKASCKey> AccKeySCMap;
 typedef std::map<CKeyID, CEKAStealthKey> AccStealthKeyMap;
+typedef std::map<std::pair<uint32_t, uint32_t>, CPubKey> AccPubKeyCache;
 
 class CExtKeyAccount
 { // stored by idAccount
@@ -667,6 +673,7 @@ public:
             delete *it;
             *it = nullptr;
         };
+        mapPubKeyCache.clear();
         return 0;
     };
 
@@ -692,6 +699,8 @@ public:
     bool GetPubKey(const CKeyID &id, CPubKey &pkOut) const;
     bool GetPubKey(const CEKAKey &ak, CPubKey &pkOut) const;
     bool GetPubKey(const CEKASCKey &asck, CPubKey &pkOut) const;
+    // Public key of child nChild of chain nChain, derived once and then cached
+    bool GetChildPubKey(uint32_t nChain, uint32_t nChild, CPubKey &pkOut) const;
 
     bool SaveKey(const CKeyID &id, const CEKAKey &keyIn);
     bool SaveKey(const CKeyID &id, const CEKASCKey &keyIn);
@@ -822,6 +831,8 @@ public:
 
     AccKeySCMap mapStealthChildKeys; // keys derived from stealth addresses
 
+    mutable AccPubKeyCache mapPubKeyCache; // by (chain, child), in memory only
+
     AccStealthKeyMap mapStealthKeys;
     AccStealthKeyMap mapLookAheadStealth;
 
@@ -20,9 +20,15 @@ void CActiveGhostnode::ManageState() {
         return;
     }
 
+    // waitforghostnodestatus callers are woken when the status changes
+    int nStatePrev = nState;
+    std::string strNotCapableReasonPrev = strNotCapableReason;
+
     if (Params().NetworkIDString() != CBaseChainParams::REGTEST && !ghostnodeSync.IsBlockchainSynced()) {
         nState = ACTIVE_GHOSTNODE_SYNC_IN_PROCESS;
         //LogPrint("CActiveGhostnode::ManageState -- %s: %s\n", GetStateString(), GetStatus());
+        if (nState != nStatePrev)
+            NotifyStateChange();
         return;
     }
 
@@ -47,6 +53,9 @@ void CActiveGhostnode::ManageState() {
     }
 
     SendGhostnodePing();
+
+    if (nState != nStatePrev || strNotCapableReason != strNotCapableReasonPrev)
+        NotifyStateChange();
 }
 
 std::string CActiveGhostnode::GetStateString() const {
@@ -17,7 +17,10 @@
 #include "util.h"
 #include "utilmoneystr.h"
 #include "net_processing.h"
+#include "netfulfilledman.h"
 #include "netmessagemaker.h"
+#include "perf.h"
+#include "scheduler.h"
 
 #include <boost/lexical_cast.hpp>
 
@@ -343,18 +346,10 @@ void CDarksendPool::ProcessMessage(CNode *pfrom, std::string &strCommand, CDataS
 
         //LogPrint("privatesend", "DSSIGNFINALTX -- vecTxIn.size() %s\n", vecTxIn.size());
 
-        int nTxInIndex = 0;
-        int nTxInsCount = (int) vecTxIn.size();
-
-        BOOST_FOREACH(
-        const CTxIn txin, vecTxIn) {
-            nTxInIndex++;
-            if (!AddScriptSig(txin)) {
-                //LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() failed at %d/%d, session: %d\n", nTxInIndex, nTxInsCount, nSessionID);
-                RelayStatus(STATUS_REJECTED);
-                return;
-            }
-            //LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() %d/%d success\n", nTxInIndex, nTxInsCount);
+        if (!AddScriptSigs(vecTxIn)) {
+            //LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSigs() failed, session: %d\n", nSessionID);
+            RelayStatus(STATUS_REJECTED);
+            return;
         }
         // all is good
         CheckPool();
@@ -463,6 +458,7 @@ void CDarksendPool::ResetPool() {
 void CDarksendPool::SetNull() {
     // MN side
     vecSessionCollaterals.clear();
+    mapCollateralsChecked.clear();
 
     // Client side
     nEntriesCount = 0;
@@ -862,54 +858,19 @@ void CDarksendPool::CheckForCompleteQueue() {
     }
 }
 
-// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-bool CDarksendPool::IsInputScriptSigValid(const CTxIn &txin) {
-    CMutableTransaction txNew;
-    txNew.vin.clear();
-    txNew.vout.clear();
-
-    int i = 0;
-    int nTxInIndex = -1;
-    CScript sigPubKey = CScript();
-
-    BOOST_FOREACH(CDarkSendEntry & entry, vecEntries)
-    {
-
-        BOOST_FOREACH(
-        const CTxDSOut &txdsout, entry.vecTxDSOut)
-        txNew.vout.push_back(txdsout);
-
-        BOOST_FOREACH(
-        const CTxDSIn &txdsin, entry.vecTxDSIn) {
-            txNew.vin.push_back(txdsin);
-
-            if (txdsin.prevout == txin.prevout) {
-                nTxInIndex = i;
-                sigPubKey = txdsin.prevPubKey;
-            }
-            i++;
-        }
-    }
-
-    if (nTxInIndex >= 0) { //might have to do this one input at a time?
-        txNew.vin[nTxInIndex].scriptSig = txin.scriptSig;
-        const CAmount &amount = txNew.vout[nTxInIndex].nValue;
-        //LogPrint("privatesend", "CDarksendPool::IsInputScriptSigValid -- verifying scriptSig %s\n", ScriptToAsmStr(txin.scriptSig).substr(0, 24));
-//        if(!VerifyScript(txNew.vin[nTxInIndex].scriptSig, sigPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, MutableTransactionSignatureChecker(&txNew, nTxInIndex, amount))) {
-//            //LogPrint("privatesend", "CDarksendPool::IsInputScriptSigValid -- VerifyScript() failed on input %d\n", nTxInIndex);
-//            return false;
-//        }
-    } else {
-        //LogPrint("privatesend", "CDarksendPool::IsInputScriptSigValid -- Failed to find matching input in pool, %s\n", txin.ToString());
-        return false;
-    }
-
-    //LogPrint("privatesend", "CDarksendPool::IsInputScriptSigValid -- Successfully validated input and scriptSig\n");
-    return true;
-}
-
 // check to make sure the collateral provided by the client is valid
 bool CDarksendPool::IsCollateralValid(const CTransaction &txCollateral) {
+    // a collateral is checked when its client asks to join and again with its entry
+    std::map<uint256, bool>::const_iterator it = mapCollateralsChecked.find(txCollateral.GetHash());
+    if (it != mapCollateralsChecked.end())
+        return it->second;
+
+    bool fValid = CheckCollateral(txCollateral);
+    mapCollateralsChecked[txCollateral.GetHash()] = fValid;
+    return fValid;
+}
+
+bool CDarksendPool::CheckCollateral(const CTransaction &txCollateral) {
     if (txCollateral.vout.empty()) return false;
     if (txCollateral.nLockTime != 0) return false;
 
@@ -954,8 +915,7 @@ bool CDarksendPool::IsCollateralValid(const CTransaction &txCollateral) {
     {
         LOCK(cs_main);
         CValidationState validationState;
-        CTransactionRef txRef(&txCollateral);
-        if (!AcceptToMemoryPool(mempool, validationState, txRef, nullptr, nullptr, false, 0)) {
+        if (!AcceptToMemoryPool(mempool, validationState, MakeTransactionRef(txCollateral), nullptr, nullptr, false, 0)) {
             //LogPrint("privatesend", "CDarksendPool::IsCollateralValid -- didn't pass AcceptToMemoryPool()\n");
             return false;
         }
@@ -1017,44 +977,77 @@ bool CDarksendPool::AddEntry(const CDarkSendEntry &entryNew, PoolMessage &nMessa
     return true;
 }
 
-bool CDarksendPool::AddScriptSig(const CTxIn &txinNew) {
-    //LogPrint("privatesend", "CDarksendPool::AddScriptSig -- scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
+bool CDarksendPool::AddScriptSigs(const std::vector<CTxIn> &vecTxIn) {
+    if (vecTxIn.empty()) return false;
 
+    // Match every signed input with its place in the final transaction and the
+    // script it spends, as submitted with the entry
+    CMutableTransaction txSigned(finalMutableTransaction);
+    std::vector<std::pair<unsigned int, CScript>> vecToVerify;
+    std::set<COutPoint> setSeen;
     BOOST_FOREACH(
-    const CDarkSendEntry &entry, vecEntries) {
+    const CTxIn &txinNew, vecTxIn) {
+        if (!setSeen.insert(txinNew.prevout).second) return false;
+
+        const CTxDSIn *pEntryIn = NULL;
         BOOST_FOREACH(
-        const CTxDSIn &txdsin, entry.vecTxDSIn) {
-            if (txdsin.scriptSig == txinNew.scriptSig) {
-                //LogPrint("privatesend", "CDarksendPool::AddScriptSig -- already exists\n");
-                return false;
+        const CDarkSendEntry &entry, vecEntries) {
+            BOOST_FOREACH(
+            const CTxDSIn &txdsin, entry.vecTxDSIn) {
+                if (txdsin.scriptSig == txinNew.scriptSig) {
+                    //LogPrint("privatesend", "CDarksendPool::AddScriptSigs -- already exists\n");
+                    return false;
+                }
+                if (txdsin.prevout == txinNew.prevout && txdsin.nSequence == txinNew.nSequence)
+                    pEntryIn = &txdsin;
+            }
+        }
+        if (pEntryIn == NULL || pEntryIn->fHasSig) {
+            //LogPrint("privatesend", "CDarksendPool::AddScriptSigs -- Failed to find matching input in pool, %s\n", txinNew.ToString());
+            return false;
+        }
+
+        bool fFound = false;
+        for (unsigned int i = 0; i < txSigned.vin.size(); i++) {
+            if (txSigned.vin[i].prevout == txinNew.prevout && txSigned.vin[i].nSequence == txinNew.nSequence) {
+                txSigned.vin[i].scriptSig = txinNew.scriptSig;
+                vecToVerify.emplace_back(i, pEntryIn->prevPubKey);
+                fFound = true;
+                break;
             }
         }
+        if (!fFound) return false;
     }
 
-    if (!IsInputScriptSigValid(txinNew)) {
-        //LogPrint("privatesend", "CDarksendPool::AddScriptSig -- Invalid scriptSig\n");
+    // Clients sign the final transaction, so verify against it rather than a
+    // rebuilt copy, all inputs at once on the script checking threads
+    const CTransaction txFinal(txSigned);
+    PrecomputedTransactionData txdata(txFinal);
+    std::vector<CScriptCheck> vChecks;
+    vChecks.reserve(vecToVerify.size());
+    for (const auto &toVerify : vecToVerify)
+        vChecks.emplace_back(CTxOut(0, toVerify.second), txFinal, toVerify.first, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, false, &txdata);
+    if (!RunScriptChecks(vChecks)) {
+        //LogPrint("privatesend", "CDarksendPool::AddScriptSigs -- Invalid scriptSig\n");
         return false;
     }
 
-    //LogPrint("privatesend", "CDarksendPool::AddScriptSig -- scriptSig=%s new\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
-
-    BOOST_FOREACH(CTxIn & txin, finalMutableTransaction.vin)
-    {
-        if (txinNew.prevout == txin.prevout && txin.nSequence == txinNew.nSequence) {
-            txin.scriptSig = txinNew.scriptSig;
-            txin.prevPubKey = txinNew.prevPubKey;
-            //LogPrint("privatesend", "CDarksendPool::AddScriptSig -- adding to finalMutableTransaction, scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
+    BOOST_FOREACH(
+    const CTxIn &txinNew, vecTxIn) {
+        BOOST_FOREACH(CTxIn & txin, finalMutableTransaction.vin)
+        {
+            if (txinNew.prevout == txin.prevout && txin.nSequence == txinNew.nSequence) {
+                txin.scriptSig = txinNew.scriptSig;
+                txin.prevPubKey = txinNew.prevPubKey;
+            }
         }
-    }
-    for (int i = 0; i < GetEntriesCount(); i++) {
-        if (vecEntries[i].AddScriptSig(txinNew)) {
-            //LogPrint("privatesend", "CDarksendPool::AddScriptSig -- adding to entries, scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
-            return true;
+        for (int i = 0; i < GetEntriesCount(); i++) {
+            if (vecEntries[i].AddScriptSig(txinNew))
+                break;
         }
     }
 
-    //LogPrint("CDarksendPool::AddScriptSig -- Couldn't set sig!\n");
-    return false;
+    return true;
 }
 
 // Check to make sure everything is signed
@@ -2515,59 +2508,97 @@ void CDarksendPool::UpdatedBlockTip(const CBlockIndex *pindex) {
     }
 }
 
-//TODO: Rename/move to core
-void ThreadCheckDarkSendPool() {
-    if (fLiteMode) return; // disable all Dash specific functionality
-
-    static bool fOneThread;
-    if (fOneThread) return;
-    fOneThread = true;
-
-    // Make this thread recognisable as the PrivateSend thread
-    RenameThread("dash-privatesend");
-
-    unsigned int nTick = 0;
-    unsigned int nDoAutoNextRun = nTick + PRIVATESEND_AUTO_TIMEOUT_MIN;
-
-    while (true) {
-        MilliSleep(1000);
-
-        // try to sync from all available nodes, one step at a time
-        ghostnodeSync.ProcessTick();
-
-        if (ghostnodeSync.IsBlockchainSynced() && !ShutdownRequested()) {
-
-            nTick++;
-
-            // make sure to check all ghostnodes first
-            mnodeman.Check();
+// The time critical ghostnode tasks (syncing, pings, mixing) and the sweeps over every
+// ghostnode, payment vote and lock each run on a scheduler of their own, so a slow sweep
+// doesn't hold up the pings.
+static CScheduler schedulerGhostnode;
+static CScheduler schedulerGhostnodeSweep;
+
+static CPerfTimer perfSyncTick("ghostnode.sync_tick");
+static CPerfTimer perfCheck("ghostnode.check");
+static CPerfTimer perfManageState("ghostnode.manage_state");
+static CPerfTimer perfDarksendTimeouts("privatesend.timeouts");
+static CPerfTimer perfAutoDenominate("privatesend.auto_denominate");
+static CPerfTimer perfConnections("ghostnode.connections");
+static CPerfTimer perfGhostnodeSweep("ghostnode.sweep");
+static CPerfTimer perfPaymentsSweep("ghostnode.payments_sweep");
+static CPerfTimer perfInstantSendSweep("instantsend.sweep");
+static CPerfTimer perfFulfilledSweep("netfulfilled.sweep");
+static CPerfTimer perfFullVerification("ghostnode.full_verification");
+
+//! Most tasks only run once the blockchain is synced, until then they are retried this often
+static const int64_t GHOSTNODE_TASK_RETRY_MS = 1000;
+
+static bool IsGhostnodeTaskReady()
+{
+    return ghostnodeSync.IsBlockchainSynced() && !ShutdownRequested();
+}
 
-            // check if we should activate or ping every few minutes,
-            // slightly postpone first run to give net thread a chance to connect to some peers
-            if (nTick % GHOSTNODE_MIN_MNP_SECONDS == 15)
-                activeGhostnode.ManageState();
+/**
+ * Run a maintenance task and schedule its next run nIntervalMs plus up to nJitterMs later.
+ * A task returns false if it had nothing to do yet, it is then retried shortly.
+ */
+static void RunGhostnodeTask(CScheduler* scheduler, CPerfTimer* timer, std::function<bool()> task, int64_t nIntervalMs, int64_t nJitterMs)
+{
+    bool fRan;
+    {
+        CPerfScope perfScope(*timer);
+        fRan = task();
+    }
+    int64_t nDelayMs = fRan ? nIntervalMs + (nJitterMs > 0 ? GetRand(nJitterMs + 1) : 0) : GHOSTNODE_TASK_RETRY_MS;
+    scheduler->scheduleFromNow(std::bind(&RunGhostnodeTask, scheduler, timer, task, nIntervalMs, nJitterMs), nDelayMs);
+}
 
-            if (nTick % 60 == 0) {
-                mnodeman.ProcessGhostnodeConnections();
-                mnodeman.CheckAndRemove();
-                mnpayments.CheckAndRemove();
-                instantsend.CheckAndRemove();
-            }
-            if (fGhostNode && (nTick % (60 * 5) == 0)) {
-                mnodeman.DoFullVerificationStep();
-            }
+static void ScheduleGhostnodeTask(CScheduler& scheduler, CPerfTimer& timer, std::function<bool()> task, int64_t nIntervalMs, int64_t nJitterMs, int64_t nFirstMs)
+{
+    scheduler.scheduleFromNow(std::bind(&RunGhostnodeTask, &scheduler, &timer, task, nIntervalMs, nJitterMs), nFirstMs);
+}
 
-//            if(nTick % (60 * 5) == 0) {
-//                governance.DoMaintenance();
-//            }
+/** A task that only runs once the blockchain is synced */
+static std::function<bool()> WhenSynced(std::function<void()> func)
+{
+    return [func] {
+        if (!IsGhostnodeTaskReady())
+            return false;
+        func();
+        return true;
+    };
+}
 
-            darkSendPool.CheckTimeout();
-            darkSendPool.CheckForCompleteQueue();
+void StartGhostnodeMaintenance(boost::thread_group& threadGroup)
+{
+    if (fLiteMode) return; // disable all Dash specific functionality
 
-            if (nDoAutoNextRun == nTick) {
-                darkSendPool.DoAutomaticDenominating();
-                nDoAutoNextRun = nTick + PRIVATESEND_AUTO_TIMEOUT_MIN + GetRandInt(PRIVATESEND_AUTO_TIMEOUT_MAX - PRIVATESEND_AUTO_TIMEOUT_MIN);
-            }
-        }
+    const int64_t nSweepMs = std::max<int64_t>(gArgs.GetArg("-ghostnodesweepinterval", DEFAULT_GHOSTNODE_SWEEP_INTERVAL), 1) * 1000;
+    const int64_t nJitterMs = std::max<int64_t>(gArgs.GetArg("-ghostnodesweepjitter", DEFAULT_GHOSTNODE_SWEEP_JITTER), 0) * 1000;
+
+    // try to sync from all available nodes, one step at a time
+    ScheduleGhostnodeTask(schedulerGhostnode, perfSyncTick, [] { ghostnodeSync.ProcessTick(); return true; }, 1000, 0, 1000);
+    ScheduleGhostnodeTask(schedulerGhostnode, perfCheck, WhenSynced([] { mnodeman.Check(); }), 1000, 0, 1000);
+    // check if we should activate or ping every few minutes,
+    // slightly postpone first run to give net thread a chance to connect to some peers
+    ScheduleGhostnodeTask(schedulerGhostnode, perfManageState, WhenSynced([] { activeGhostnode.ManageState(); }),
+                          GHOSTNODE_MIN_MNP_SECONDS * 1000, 0, 15 * 1000);
+    ScheduleGhostnodeTask(schedulerGhostnode, perfDarksendTimeouts, WhenSynced([] {
+        darkSendPool.CheckTimeout();
+        darkSendPool.CheckForCompleteQueue();
+    }), 1000, 0, 1000);
+    ScheduleGhostnodeTask(schedulerGhostnode, perfAutoDenominate, WhenSynced([] { darkSendPool.DoAutomaticDenominating(); }),
+                          PRIVATESEND_AUTO_TIMEOUT_MIN * 1000, (PRIVATESEND_AUTO_TIMEOUT_MAX - PRIVATESEND_AUTO_TIMEOUT_MIN) * 1000,
+                          PRIVATESEND_AUTO_TIMEOUT_MIN * 1000);
+
+    ScheduleGhostnodeTask(schedulerGhostnodeSweep, perfConnections, WhenSynced([] { mnodeman.ProcessGhostnodeConnections(); }), nSweepMs, nJitterMs, nSweepMs);
+    ScheduleGhostnodeTask(schedulerGhostnodeSweep, perfGhostnodeSweep, WhenSynced([] { mnodeman.CheckAndRemove(); }), nSweepMs, nJitterMs, nSweepMs);
+    ScheduleGhostnodeTask(schedulerGhostnodeSweep, perfPaymentsSweep, WhenSynced([] { mnpayments.CheckAndRemove(); }), nSweepMs, nJitterMs, nSweepMs);
+    ScheduleGhostnodeTask(schedulerGhostnodeSweep, perfInstantSendSweep, WhenSynced([] { instantsend.CheckAndRemove(); }), nSweepMs, nJitterMs, nSweepMs);
+    ScheduleGhostnodeTask(schedulerGhostnodeSweep, perfFulfilledSweep, WhenSynced([] { netfulfilledman.CheckAndRemove(); }), nSweepMs, nJitterMs, nSweepMs);
+    if (fGhostNode) {
+        ScheduleGhostnodeTask(schedulerGhostnodeSweep, perfFullVerification, WhenSynced([] { mnodeman.DoFullVerificationStep(); }),
+                              5 * nSweepMs, nJitterMs, 5 * nSweepMs);
     }
+
+    threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "ghostnode",
+                                          CScheduler::Function(boost::bind(&CScheduler::serviceQueue, &schedulerGhostnode))));
+    threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "ghostsweep",
+                                          CScheduler::Function(boost::bind(&CScheduler::serviceQueue, &schedulerGhostnodeSweep))));
 }
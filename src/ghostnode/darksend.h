@@ -14,12 +14,21 @@ class CDarksendPool;
 class CDarkSendSigner;
 class CDarksendBroadcastTx;
 
+namespace boost {
+class thread_group;
+} // namespace boost
+
 // timeouts
 static const int PRIVATESEND_AUTO_TIMEOUT_MIN       = 5;
 static const int PRIVATESEND_AUTO_TIMEOUT_MAX       = 15;
 static const int PRIVATESEND_QUEUE_TIMEOUT          = 30;
 static const int PRIVATESEND_SIGNING_TIMEOUT        = 15;
 
+//! -ghostnodesweepinterval default, seconds between the sweeps over ghostnodes, payment votes, locks and fulfilled requests
+static const int DEFAULT_GHOSTNODE_SWEEP_INTERVAL   = 60;
+//! -ghostnodesweepjitter default, up to this many seconds are added to each sweep interval
+static const int DEFAULT_GHOSTNODE_SWEEP_JITTER     = 10;
+
 //! minimum peer version accepted by mixing pool
 static const int MIN_PRIVATESEND_PEER_PROTO_VERSION = 70020;
 
@@ -315,6 +324,8 @@ private:
     // Mixing uses collateral transactions to trust parties entering the pool
     // to behave honestly. If they don't it takes their money.
     std::vector<CTransaction> vecSessionCollaterals;
+    // Collaterals already checked this session, so they are not run through the mempool again
+    std::map<uint256, bool> mapCollateralsChecked;
     std::vector<CDarkSendEntry> vecEntries; // Ghostnode/clients entries
 
     PoolState nState; // should be one of the POOL_STATE_XXX values
@@ -339,8 +350,8 @@ private:
 
     /// Add a clients entry to the pool
     bool AddEntry(const CDarkSendEntry& entryNew, PoolMessage& nMessageIDRet);
-    /// Add signature to a txin
-    bool AddScriptSig(const CTxIn& txin);
+    /// Add signatures to txins, verifying all of them in one batch
+    bool AddScriptSigs(const std::vector<CTxIn>& vecTxIn);
 
     /// Charge fees to bad actors (Charge clients a fee if they're abusive)
     void ChargeFees();
@@ -372,10 +383,9 @@ private:
 
     /// If the collateral is valid given by a client
     bool IsCollateralValid(const CTransaction& txCollateral);
+    bool CheckCollateral(const CTransaction& txCollateral);
     /// Check that all inputs are signed. (Are all inputs signed?)
     bool IsSignaturesComplete();
-    /// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-    bool IsInputScriptSigValid(const CTxIn& txin);
     /// Are these outputs compatible with other client in the pool?
     bool IsOutputsCompatibleWithSessionDenom(const std::vector<CTxDSOut>& vecTxDSOut);
 
@@ -480,6 +490,7 @@ public:
     void UpdatedBlockTip(const CBlockIndex *pindex);
 };
 
-void ThreadCheckDarkSendPool();
+/** Schedule the periodic ghostnode and mixing tasks and start the threads running them */
+void StartGhostnodeMaintenance(boost::thread_group& threadGroup);
 
 #endif
@@ -13,6 +13,7 @@
 #include "util.h"
 #include "netmessagemaker.h"
 #include "chainparams.h"
+#include "core_memusage.h"
 
 #include <boost/lexical_cast.hpp>
 
@@ -118,6 +119,62 @@ void CGhostnodePayments::Clear() {
     LOCK2(cs_mapGhostnodeBlocks, cs_mapGhostnodePaymentVotes);
     mapGhostnodeBlocks.clear();
     mapGhostnodePaymentVotes.clear();
+    mapPaymentVoteHashes.clear();
+    mapRequiredPaymentsStrings.clear();
+}
+
+CGhostnodePaymentVote& CGhostnodePayments::StorePaymentVote(const uint256& nHash, const CGhostnodePaymentVote& vote) {
+    AssertLockHeld(cs_mapGhostnodePaymentVotes);
+
+    std::pair<std::unordered_map<uint256, CGhostnodePaymentVote, BlockHasher>::iterator, bool> ret =
+            mapGhostnodePaymentVotes.insert(std::make_pair(nHash, vote));
+    if (ret.second) {
+        mapPaymentVoteHashes[vote.nBlockHeight].push_back(nHash);
+    } else {
+        ret.first->second = vote;
+    }
+    return ret.first->second;
+}
+
+/** Approximate heap memory of a stored vote: its map node, the signature and its hash in the height bucket and payee */
+static size_t PaymentVoteUsage() {
+    return memusage::MallocUsage(sizeof(memusage::unordered_node<std::pair<const uint256, CGhostnodePaymentVote> >)) + sizeof(void*) +
+           memusage::MallocUsage(CPubKey::COMPACT_SIGNATURE_SIZE) + 2 * sizeof(uint256);
+}
+
+bool CGhostnodePayments::MakeRoomForVote(const uint256& nHash) {
+    AssertLockHeld(cs_mapGhostnodeBlocks);
+    AssertLockHeld(cs_mapGhostnodePaymentVotes);
+
+    if (nMaxMemory == 0 || mapGhostnodePaymentVotes.count(nHash)) return true;
+    size_t nMaxVotes = nMaxMemory / PaymentVoteUsage();
+    if (mapGhostnodePaymentVotes.size() < nMaxVotes) return true;
+
+    // the votes of connected blocks are only kept to sync peers, drop the oldest heights first
+    int nTipHeight = pCurrentBlockIndex ? pCurrentBlockIndex->nHeight : 0;
+    std::map<int, std::vector<uint256> >::iterator it = mapPaymentVoteHashes.begin();
+    while (mapGhostnodePaymentVotes.size() >= nMaxVotes && it != mapPaymentVoteHashes.end() && it->first < nTipHeight) {
+        for (const uint256& hash : it->second) {
+            nVotesEvicted += mapGhostnodePaymentVotes.erase(hash);
+        }
+        mapGhostnodeBlocks.erase(it->first);
+        mapRequiredPaymentsStrings.erase(it->first);
+        mapPaymentVoteHashes.erase(it++);
+    }
+    if (mapGhostnodePaymentVotes.size() >= nMaxVotes) {
+        ++nVotesRejected;
+        return false;
+    }
+    return true;
+}
+
+void CGhostnodePayments::RebuildPaymentVoteHashes() {
+    LOCK(cs_mapGhostnodePaymentVotes);
+
+    mapPaymentVoteHashes.clear();
+    for (const auto& entry : mapGhostnodePaymentVotes) {
+        mapPaymentVoteHashes[entry.second.nBlockHeight].push_back(entry.first);
+    }
 }
 
 bool CGhostnodePayments::CanVote(COutPoint outGhostnode, int nBlockHeight) {
@@ -132,6 +189,10 @@ bool CGhostnodePayments::CanVote(COutPoint outGhostnode, int nBlockHeight) {
     return true;
 }
 
+size_t CGhostnodePayee::DynamicMemoryUsage() const {
+    return RecursiveDynamicUsage(scriptPubKey) + memusage::DynamicUsage(vecVoteHashes);
+}
+
 std::string CGhostnodePayee::ToString() const {
     CTxDestination address1;
     ExtractDestination(scriptPubKey, address1);
@@ -160,15 +221,22 @@ void CGhostnodePayments::FillBlockPayee(CMutableTransaction &txNew, int nBlockHe
         // no ghostnode detected...
         // //LogPrint("no ghostnode detected...\n");
         foundMaxVotedPayee = false;
-        int nCount = 0;
-        CGhostnode *winningNode = mnodeman.GetNextGhostnodeInQueueForPayment(nBlockHeight, true, nCount);
-        if (!winningNode) {
-            // ...and we can't calculate it on our own
-            //LogPrint("CGhostnodePayments::FillBlockPayee -- Failed to detect ghostnode to pay\n");
-            return;
+        LOCK(cs_fallbackPayee);
+        if (nFallbackPayeeHeight == nBlockHeight) {
+            payee = fallbackPayee;
+        } else {
+            int nCount = 0;
+            CGhostnode *winningNode = mnodeman.GetNextGhostnodeInQueueForPayment(nBlockHeight, true, nCount);
+            if (!winningNode) {
+                // ...and we can't calculate it on our own
+                //LogPrint("CGhostnodePayments::FillBlockPayee -- Failed to detect ghostnode to pay\n");
+                return;
+            }
+            // fill payee with locally calculated winner and hope for the best
+            payee = GetScriptForDestination(winningNode->pubKeyCollateralAddress.GetID());
+            fallbackPayee = payee;
+            nFallbackPayeeHeight = nBlockHeight;
         }
-        // fill payee with locally calculated winner and hope for the best
-        payee = GetScriptForDestination(winningNode->pubKeyCollateralAddress.GetID());
         //LogPrint("payee=%s\n", winningNode->ToString());
     }
     txoutGhostnodeRet = CTxOut(ghostnodePayment, payee);
@@ -207,13 +275,13 @@ void CGhostnodePayments::ProcessMessage(CNode *pfrom, std::string &strCommand, C
         int nCountNeeded;
         vRecv >> nCountNeeded;
 
-        if (netfulfilledman.HasFulfilledRequest(pfrom->addr, NetMsgType::GHOSTNODEPAYMENTSYNC)) {
+        if (netfulfilledman.HasFulfilledRequest(pfrom->addr, FULFILLED_PAYMENT_VOTES)) {
             // Asking for the payments list multiple times in a short period of time is no good
             //LogPrintf("GHOSTNODEPAYMENTSYNC -- peer already asked me for the list\n");
             Misbehaving(pfrom->GetId(), 20);
             return;
         }
-        netfulfilledman.AddFulfilledRequest(pfrom->addr, NetMsgType::GHOSTNODEPAYMENTSYNC);
+        netfulfilledman.AddFulfilledRequest(pfrom->addr, FULFILLED_PAYMENT_VOTES);
 
         Sync(pfrom);
         //LogPrintf("mnpayments GHOSTNODEPAYMENTSYNC -- Sent Ghostnode payment votes to peer \n");
@@ -223,81 +291,102 @@ void CGhostnodePayments::ProcessMessage(CNode *pfrom, std::string &strCommand, C
         CGhostnodePaymentVote vote;
         vRecv >> vote;
 
-        if (pfrom->nVersion < GetMinGhostnodePaymentsProto()) return;
-
-        if (!pCurrentBlockIndex) return;
-
-        uint256 nHash = vote.GetHash();
+        ProcessPaymentVote(pfrom, vote);
 
-        pfrom->setAskFor.erase(nHash);
+    } else if (strCommand == NetMsgType::GHOSTNODEPAYMENTBATCH) { // Ghostnode Payments Votes in bulk
 
-        {
-            LOCK(cs_mapGhostnodePaymentVotes);
-            if (mapGhostnodePaymentVotes.count(nHash)) {
-                //LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- nHeight=%d seen\n", pCurrentBlockIndex->nHeight);
-                return;
-            }
+        std::vector<CGhostnodePaymentVote> vecVotes;
+        vRecv >> vecVotes;
 
-            // Avoid processing same vote multiple times
-            mapGhostnodePaymentVotes[nHash] = vote;
-            // but first mark vote as non-verified,
-            // AddPaymentVote() below should take care of it if vote is actually ok
-            mapGhostnodePaymentVotes[nHash].MarkAsNotVerified();
-        }
-
-        int nFirstBlock = pCurrentBlockIndex->nHeight - GetStorageLimit();
-        if (vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > pCurrentBlockIndex->nHeight + 20) {
-            //LogPrintf("mnpaymentsGHOSTNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, pCurrentBlockIndex->nHeight);
+        if (vecVotes.size() > MNPAYMENTS_BATCH_MAX_ENTRIES) {
+            Misbehaving(pfrom->GetId(), 20);
             return;
         }
 
-        std::string strError = "";
-        if (!vote.IsValid(pfrom, pCurrentBlockIndex->nHeight, strError)) {
-            //LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- invalid message, error: %s\n", strError);
-            return;
+        BOOST_FOREACH(CGhostnodePaymentVote& vote, vecVotes) {
+            ProcessPaymentVote(pfrom, vote);
         }
+    }
+}
 
-        if (!CanVote(vote.vinGhostnode.prevout, vote.nBlockHeight)) {
-            //LogPrintf("GHOSTNODEPAYMENTVOTE -- ghostnode already voted, ghostnode\n");
-            return;
-        }
+void CGhostnodePayments::ProcessPaymentVote(CNode *pfrom, CGhostnodePaymentVote &vote) {
+    if (pfrom->nVersion < GetMinGhostnodePaymentsProto()) return;
+
+    if (!pCurrentBlockIndex) return;
+
+    uint256 nHash = vote.GetHash();
+
+    pfrom->setAskFor.erase(nHash);
 
-        ghostnode_info_t mnInfo = mnodeman.GetGhostnodeInfo(vote.vinGhostnode);
-        if (!mnInfo.fInfoValid) {
-            // mn was not found, so we can't check vote, some info is probably missing
-            //LogPrintf("GHOSTNODEPAYMENTVOTE -- ghostnode is missing \n");
-            mnodeman.AskForMN(pfrom, vote.vinGhostnode);
+    {
+        LOCK2(cs_mapGhostnodeBlocks, cs_mapGhostnodePaymentVotes);
+        if (mapGhostnodePaymentVotes.count(nHash)) {
+            //LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- nHeight=%d seen\n", pCurrentBlockIndex->nHeight);
             return;
         }
-
-        int nDos = 0;
-        if (!vote.CheckSignature(mnInfo.pubKeyGhostnode, pCurrentBlockIndex->nHeight, nDos)) {
-            if (nDos) {
-                //LogPrintf("GHOSTNODEPAYMENTVOTE -- ERROR: invalid signature\n");
-                Misbehaving(pfrom->GetId(), nDos);
-            } else {
-                // only warn about anything non-critical (i.e. nDos == 0) in debug mode
-                //LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- WARNING: invalid signature\n");
-            }
-            // Either our info or vote info could be outdated.
-            // In case our info is outdated, ask for an update,
-            mnodeman.AskForMN(pfrom, vote.vinGhostnode);
-            // but there is nothing we can do if vote info itself is outdated
-            // (i.e. it was signed by a mn which changed its key),
-            // so just quit here.
+        if (!MakeRoomForVote(nHash)) {
+            LogPrint(BCLog::GHOST, "GHOSTNODEPAYMENTVOTE -- over -maxghostnodepaymentsmem, vote %s dropped\n", nHash.ToString());
             return;
         }
 
-        CTxDestination address1;
-        ExtractDestination(vote.payee, address1);
-        CBitcoinAddress address2(address1);
+        // Avoid processing same vote multiple times
+        // but first mark vote as non-verified,
+        // AddPaymentVote() below should take care of it if vote is actually ok
+        StorePaymentVote(nHash, vote).MarkAsNotVerified();
+    }
+
+    int nFirstBlock = pCurrentBlockIndex->nHeight - GetStorageLimit();
+    if (vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > pCurrentBlockIndex->nHeight + 20) {
+        //LogPrintf("mnpaymentsGHOSTNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, pCurrentBlockIndex->nHeight);
+        return;
+    }
 
-        //LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- vote: address=%s, nBlockHeight=%d, nHeight=%d, prevout=%s\n", address2.ToString(), vote.nBlockHeight, pCurrentBlockIndex->nHeight, vote.vinGhostnode.prevout.ToStringShort());
+    std::string strError = "";
+    if (!vote.IsValid(pfrom, pCurrentBlockIndex->nHeight, strError)) {
+        //LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- invalid message, error: %s\n", strError);
+        return;
+    }
+
+    if (!CanVote(vote.vinGhostnode.prevout, vote.nBlockHeight)) {
+        //LogPrintf("GHOSTNODEPAYMENTVOTE -- ghostnode already voted, ghostnode\n");
+        return;
+    }
+
+    ghostnode_info_t mnInfo = mnodeman.GetGhostnodeInfo(vote.vinGhostnode);
+    if (!mnInfo.fInfoValid) {
+        // mn was not found, so we can't check vote, some info is probably missing
+        //LogPrintf("GHOSTNODEPAYMENTVOTE -- ghostnode is missing \n");
+        mnodeman.AskForMN(pfrom, vote.vinGhostnode);
+        return;
+    }
 
-        if (AddPaymentVote(vote)) {
-            vote.Relay();
-            ghostnodeSync.AddedPaymentVote();
+    int nDos = 0;
+    if (!vote.CheckSignature(mnInfo.pubKeyGhostnode, pCurrentBlockIndex->nHeight, nDos)) {
+        if (nDos) {
+            //LogPrintf("GHOSTNODEPAYMENTVOTE -- ERROR: invalid signature\n");
+            Misbehaving(pfrom->GetId(), nDos);
+        } else {
+            // only warn about anything non-critical (i.e. nDos == 0) in debug mode
+            //LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- WARNING: invalid signature\n");
         }
+        // Either our info or vote info could be outdated.
+        // In case our info is outdated, ask for an update,
+        mnodeman.AskForMN(pfrom, vote.vinGhostnode);
+        // but there is nothing we can do if vote info itself is outdated
+        // (i.e. it was signed by a mn which changed its key),
+        // so just quit here.
+        return;
+    }
+
+    CTxDestination address1;
+    ExtractDestination(vote.payee, address1);
+    CBitcoinAddress address2(address1);
+
+    //LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- vote: address=%s, nBlockHeight=%d, nHeight=%d, prevout=%s\n", address2.ToString(), vote.nBlockHeight, pCurrentBlockIndex->nHeight, vote.vinGhostnode.prevout.ToStringShort());
+
+    if (AddPaymentVote(vote)) {
+        vote.Relay();
+        ghostnodeSync.AddedPaymentVote();
     }
 }
 
@@ -358,23 +447,42 @@ bool CGhostnodePayments::AddPaymentVote(const CGhostnodePaymentVote &vote) {
     }
     if (HasVerifiedPaymentVote(vote.GetHash())) return false;
 
-    LOCK2(cs_mapGhostnodeBlocks, cs_mapGhostnodePaymentVotes);
+    bool fNextPayeeChanged = false;
+    {
+        LOCK2(cs_mapGhostnodeBlocks, cs_mapGhostnodePaymentVotes);
 
-    mapGhostnodePaymentVotes[vote.GetHash()] = vote;
+        if (!MakeRoomForVote(vote.GetHash())) return false;
+        StorePaymentVote(vote.GetHash(), vote);
 
-    if (!mapGhostnodeBlocks.count(vote.nBlockHeight)) {
-        CGhostnodeBlockPayees blockPayees(vote.nBlockHeight);
-        mapGhostnodeBlocks[vote.nBlockHeight] = blockPayees;
-    }
+        if (!mapGhostnodeBlocks.count(vote.nBlockHeight)) {
+            CGhostnodeBlockPayees blockPayees(vote.nBlockHeight);
+            mapGhostnodeBlocks[vote.nBlockHeight] = blockPayees;
+        }
 
-    mapGhostnodeBlocks[vote.nBlockHeight].AddPayee(vote);
+        CGhostnodeBlockPayees& blockPayees = mapGhostnodeBlocks[vote.nBlockHeight];
+        const CBlockIndex* pindexTip = pCurrentBlockIndex;
+        bool fNextBlock = pindexTip && vote.nBlockHeight == pindexTip->nHeight + 1;
+        CScript payeeBefore, payeeAfter;
+        if (fNextBlock)
+            blockPayees.GetBestPayee(payeeBefore);
+        blockPayees.AddPayee(vote);
+        if (fNextBlock) {
+            blockPayees.GetBestPayee(payeeAfter);
+            fNextPayeeChanged = payeeAfter != payeeBefore;
+        }
+        mapRequiredPaymentsStrings.erase(vote.nBlockHeight);
+    }
 
+    if (fNextPayeeChanged) {
+        ++nNextPayeeUpdates;
+        NotifyStateChange();
+    }
     return true;
 }
 
 bool CGhostnodePayments::HasVerifiedPaymentVote(uint256 hashIn) {
     LOCK(cs_mapGhostnodePaymentVotes);
-    std::map<uint256, CGhostnodePaymentVote>::iterator it = mapGhostnodePaymentVotes.find(hashIn);
+    std::unordered_map<uint256, CGhostnodePaymentVote, BlockHasher>::iterator it = mapGhostnodePaymentVotes.find(hashIn);
     return it != mapGhostnodePaymentVotes.end() && it->second.IsVerified();
 }
 
@@ -503,11 +611,19 @@ std::string CGhostnodeBlockPayees::GetRequiredPaymentsString() {
 std::string CGhostnodePayments::GetRequiredPaymentsString(int nBlockHeight) {
     LOCK(cs_mapGhostnodeBlocks);
 
-    if (mapGhostnodeBlocks.count(nBlockHeight)) {
-        return mapGhostnodeBlocks[nBlockHeight].GetRequiredPaymentsString();
+    std::map<int, std::string>::const_iterator itCached = mapRequiredPaymentsStrings.find(nBlockHeight);
+    if (itCached != mapRequiredPaymentsStrings.end()) {
+        return itCached->second;
     }
 
-    return "Unknown";
+    std::map<int, CGhostnodeBlockPayees>::iterator it = mapGhostnodeBlocks.find(nBlockHeight);
+    if (it == mapGhostnodeBlocks.end()) {
+        return "Unknown";
+    }
+
+    std::string strPayments = it->second.GetRequiredPaymentsString();
+    mapRequiredPaymentsStrings.emplace(nBlockHeight, strPayments);
+    return strPayments;
 }
 
 bool CGhostnodePayments::IsTransactionValid(const CTransaction &txNew, int nBlockHeight) {
@@ -526,19 +642,19 @@ void CGhostnodePayments::CheckAndRemove() {
     LOCK2(cs_mapGhostnodeBlocks, cs_mapGhostnodePaymentVotes);
 
     int nLimit = GetStorageLimit();
-
-    std::map<uint256, CGhostnodePaymentVote>::iterator it = mapGhostnodePaymentVotes.begin();
-    while (it != mapGhostnodePaymentVotes.end()) {
-        CGhostnodePaymentVote vote = (*it).second;
-
-        if (pCurrentBlockIndex->nHeight - vote.nBlockHeight > nLimit) {
-            //LogPrint("mnpayments", "CGhostnodePayments::CheckAndRemove -- Removing old Ghostnode payment: nBlockHeight=%d\n", vote.nBlockHeight);
-            mapGhostnodePaymentVotes.erase(it++);
-            mapGhostnodeBlocks.erase(vote.nBlockHeight);
-        } else {
-            ++it;
+    int nFirstBlock = pCurrentBlockIndex->nHeight - nLimit;
+
+    // drop the buckets of the heights that fell out of the storage window
+    std::map<int, std::vector<uint256> >::iterator it = mapPaymentVoteHashes.begin();
+    while (it != mapPaymentVoteHashes.end() && it->first < nFirstBlock) {
+        //LogPrint("mnpayments", "CGhostnodePayments::CheckAndRemove -- Removing old Ghostnode payments: nBlockHeight=%d\n", it->first);
+        BOOST_FOREACH(const uint256& hash, it->second) {
+            mapGhostnodePaymentVotes.erase(hash);
         }
+        mapPaymentVoteHashes.erase(it++);
     }
+    mapGhostnodeBlocks.erase(mapGhostnodeBlocks.begin(), mapGhostnodeBlocks.lower_bound(nFirstBlock));
+    mapRequiredPaymentsStrings.erase(mapRequiredPaymentsStrings.begin(), mapRequiredPaymentsStrings.lower_bound(nFirstBlock));
     //LogPrint("CGhostnodePayments::CheckAndRemove -- %s\n", ToString());
 }
 
@@ -708,11 +824,14 @@ std::string CGhostnodePaymentVote::ToString() const {
 
 // Send only votes for future blocks, node should request every other missing payment block individually
 void CGhostnodePayments::Sync(CNode *pnode) {
-    LOCK(cs_mapGhostnodeBlocks);
+    LOCK2(cs_mapGhostnodeBlocks, cs_mapGhostnodePaymentVotes);
 
     if (!pCurrentBlockIndex) return;
 
     int nInvCount = 0;
+    const CNetMsgMaker msgMaker(pnode->GetSendVersion());
+    // peers that asked for batches get the votes themselves instead of one inv per vote
+    std::vector<CGhostnodePaymentVote> vecVoteBatch;
 
     for (int h = pCurrentBlockIndex->nHeight; h < pCurrentBlockIndex->nHeight + 20; h++) {
         if (mapGhostnodeBlocks.count(h)) {
@@ -722,15 +841,26 @@ void CGhostnodePayments::Sync(CNode *pnode) {
                 BOOST_FOREACH(uint256 & hash, vecVoteHashes)
                 {
                     if (!HasVerifiedPaymentVote(hash)) continue;
-                    pnode->PushInventory(CInv(MSG_GHOSTNODE_PAYMENT_VOTE, hash));
+                    if (pnode->fSendGhostnodeBatches) {
+                        vecVoteBatch.push_back(mapGhostnodePaymentVotes[hash]);
+                        if (vecVoteBatch.size() == MNPAYMENTS_BATCH_MAX_ENTRIES) {
+                            g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::GHOSTNODEPAYMENTBATCH, vecVoteBatch));
+                            vecVoteBatch.clear();
+                        }
+                    } else {
+                        pnode->PushInventory(CInv(MSG_GHOSTNODE_PAYMENT_VOTE, hash));
+                    }
                     nInvCount++;
                 }
             }
         }
     }
 
+    if (!vecVoteBatch.empty()) {
+        g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::GHOSTNODEPAYMENTBATCH, vecVoteBatch));
+    }
+
     //LogPrint("CGhostnodePayments::Sync -- Sent %d votes to peer %d\n", nInvCount, pnode->GetId());
-    const CNetMsgMaker msgMaker(pnode->GetSendVersion());
     g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::SYNCSTATUSCOUNT, GHOSTNODE_SYNC_MNW, nInvCount));
 }
 
@@ -817,6 +947,31 @@ void CGhostnodePayments::RequestLowDataPaymentBlocks(CNode *pnode) {
     }
 }
 
+size_t CGhostnodePayments::DynamicMemoryUsage() {
+    LOCK2(cs_mapGhostnodeBlocks, cs_mapGhostnodePaymentVotes);
+    size_t nUsage = memusage::DynamicUsage(mapGhostnodePaymentVotes);
+    for (const auto& vote : mapGhostnodePaymentVotes) {
+        nUsage += RecursiveDynamicUsage(vote.second.vinGhostnode) + RecursiveDynamicUsage(vote.second.payee) +
+                  memusage::DynamicUsage(vote.second.vchSig);
+    }
+
+    nUsage += memusage::DynamicUsage(mapGhostnodeBlocks);
+    {
+        LOCK(cs_vecPayees);
+        for (const auto& block : mapGhostnodeBlocks) {
+            nUsage += memusage::DynamicUsage(block.second.vecPayees);
+            for (const CGhostnodePayee& payee : block.second.vecPayees)
+                nUsage += payee.DynamicMemoryUsage();
+        }
+    }
+
+    nUsage += memusage::DynamicUsage(mapGhostnodesLastVote) + memusage::DynamicUsageWithValues(mapPaymentVoteHashes);
+    nUsage += memusage::DynamicUsage(mapRequiredPaymentsStrings);
+    for (const auto& payments : mapRequiredPaymentsStrings)
+        nUsage += memusage::MallocUsage(payments.second.capacity());
+    return nUsage;
+}
+
 std::string CGhostnodePayments::ToString() const {
     std::ostringstream info;
 
@@ -13,12 +13,18 @@
 #include "ghostnode.h"
 #include "utilstrencodings.h"
 
+#include <atomic>
+
 class CGhostnodePayments;
 class CGhostnodePaymentVote;
 class CGhostnodeBlockPayees;
 
 static const int MNPAYMENTS_SIGNATURES_REQUIRED         = 6;
 static const int MNPAYMENTS_SIGNATURES_TOTAL            = 10;
+// max number of votes in one "mnwbatch" message
+static const size_t MNPAYMENTS_BATCH_MAX_ENTRIES        = 2000;
+//! -maxghostnodepaymentsmem default, megabytes of payment votes kept
+static const unsigned int DEFAULT_MAX_GHOSTNODE_PAYMENTS_MEMORY = 64;
 
 //! minimum peer version that can receive and send ghostnode payment messages,
 //  vote for ghostnode and be elected as a payment winner
@@ -72,6 +78,8 @@ public:
     std::vector<uint256> GetVoteHashes() { return vecVoteHashes; }
     int GetVoteCount() { return vecVoteHashes.size(); }
     std::string ToString() const;
+
+    size_t DynamicMemoryUsage() const;
 };
 
 // Keep track of votes for payees from ghostnodes
@@ -177,12 +185,42 @@ private:
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
+    // hashes of the votes in mapGhostnodePaymentVotes bucketed by block height,
+    // expired heights are dropped a bucket at a time
+    std::map<int, std::vector<uint256> > mapPaymentVoteHashes;
+
+    /// Insert or replace a vote, new votes go into the bucket of their height
+    CGhostnodePaymentVote& StorePaymentVote(const uint256& nHash, const CGhostnodePaymentVote& vote);
+    void RebuildPaymentVoteHashes();
+
+    // payee worked out from the payment queue when no votes are known for a height, stake
+    // attempts for the same height reuse it instead of walking the queue again
+    CCriticalSection cs_fallbackPayee;
+    int nFallbackPayeeHeight;
+    CScript fallbackPayee;
+
+    // GetRequiredPaymentsString() of the heights asked for, protected by cs_mapGhostnodeBlocks.
+    // A height is dropped when a vote for it arrives or it leaves the storage window
+    std::map<int, std::string> mapRequiredPaymentsStrings;
+
+    // budget of the votes in bytes, 0 for none; the votes of the oldest connected blocks
+    // are dropped to stay below it and new votes refused when that isn't enough
+    size_t nMaxMemory;
+    std::atomic<uint64_t> nVotesEvicted;
+    std::atomic<uint64_t> nVotesRejected;
+
+    // times a vote changed the payee of the block on top of the tip, for long-polling templates
+    std::atomic<uint64_t> nNextPayeeUpdates;
+
+    /// Make room for one more vote within nMaxMemory, false if there is none
+    bool MakeRoomForVote(const uint256& nHash);
+
 public:
-    std::map<uint256, CGhostnodePaymentVote> mapGhostnodePaymentVotes;
+    std::unordered_map<uint256, CGhostnodePaymentVote, BlockHasher> mapGhostnodePaymentVotes;
     std::map<int, CGhostnodeBlockPayees> mapGhostnodeBlocks;
     std::map<COutPoint, int> mapGhostnodesLastVote;
 
-    CGhostnodePayments() : nStorageCoeff(1.25), nMinBlocksToStore(5000) {}
+    CGhostnodePayments() : nStorageCoeff(1.25), nMinBlocksToStore(5000), nFallbackPayeeHeight(-1), nMaxMemory(0), nVotesEvicted(0), nVotesRejected(0), nNextPayeeUpdates(0) {}
 
     ADD_SERIALIZE_METHODS;
 
@@ -190,6 +228,11 @@ public:
     inline void SerializationOp(Stream& s, Operation ser_action) {
         READWRITE(mapGhostnodePaymentVotes);
         READWRITE(mapGhostnodeBlocks);
+        if (ser_action.ForRead()) {
+            RebuildPaymentVoteHashes();
+            LOCK(cs_mapGhostnodeBlocks);
+            mapRequiredPaymentsStrings.clear();
+        }
     }
 
     void Clear();
@@ -210,9 +253,19 @@ public:
 
     int GetMinGhostnodePaymentsProto();
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
+    /// Handle a payment vote received alone or as part of a batch
+    void ProcessPaymentVote(CNode* pfrom, CGhostnodePaymentVote& vote);
     std::string GetRequiredPaymentsString(int nBlockHeight);
     void FillBlockPayee(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, CTxOut& txoutGhostnodeRet);
     std::string ToString() const;
+    /// Heap memory of the votes and payees kept for the recent blocks
+    size_t DynamicMemoryUsage();
+
+    void SetMaxMemory(size_t nBytes) { nMaxMemory = nBytes; }
+    /// Votes dropped to stay within the memory budget and new votes refused for lack of room
+    uint64_t GetVotesEvicted() const { return nVotesEvicted; }
+    uint64_t GetVotesRejected() const { return nVotesRejected; }
+    uint64_t GetNextPayeeUpdates() const { return nNextPayeeUpdates; }
 
     int GetBlockCount() { return mapGhostnodeBlocks.size(); }
     int GetVoteCount() { return mapGhostnodePaymentVotes.size(); }
@@ -237,10 +237,10 @@ void CGhostnodeSync::ClearFulfilledRequests() {
 
     BOOST_FOREACH(CNode * pnode, g_connman->vNodes)
     {
-        netfulfilledman.RemoveFulfilledRequest(pnode->addr, "spork-sync");
-        netfulfilledman.RemoveFulfilledRequest(pnode->addr, "ghostnode-list-sync");
-        netfulfilledman.RemoveFulfilledRequest(pnode->addr, "ghostnode-payment-sync");
-        netfulfilledman.RemoveFulfilledRequest(pnode->addr, "full-sync");
+        netfulfilledman.RemoveFulfilledRequest(pnode->addr, FULFILLED_SPORK_SYNC);
+        netfulfilledman.RemoveFulfilledRequest(pnode->addr, FULFILLED_GHOSTNODE_LIST_SYNC);
+        netfulfilledman.RemoveFulfilledRequest(pnode->addr, FULFILLED_GHOSTNODE_PAYMENT_SYNC);
+        netfulfilledman.RemoveFulfilledRequest(pnode->addr, FULFILLED_FULL_SYNC);
     }
 }
 
@@ -325,7 +325,7 @@ void CGhostnodeSync::ProcessTick() {
 
         // NORMAL NETWORK MODE - TESTNET/MAINNET
         {
-            if (netfulfilledman.HasFulfilledRequest(pnode->addr, "full-sync")) {
+            if (netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_FULL_SYNC)) {
                 // We already fully synced from this node recently,
                 // disconnect to free this connection slot for another peer.
                 pnode->fDisconnect = true;
@@ -335,9 +335,9 @@ void CGhostnodeSync::ProcessTick() {
 
             // SPORK : ALWAYS ASK FOR SPORKS AS WE SYNC (we skip this mode now)
 
-            if (!netfulfilledman.HasFulfilledRequest(pnode->addr, "spork-sync")) {
+            if (!netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_SPORK_SYNC)) {
                 // only request once from each peer
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "spork-sync");
+                netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_SPORK_SYNC);
                 // get current network sporks
                 const CNetMsgMaker msgMaker(pnode->GetSendVersion());
                 g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::GETSPORKS));
@@ -364,8 +364,8 @@ void CGhostnodeSync::ProcessTick() {
                 }
 
                 // only request once from each peer
-                if (netfulfilledman.HasFulfilledRequest(pnode->addr, "ghostnode-list-sync")) continue;
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "ghostnode-list-sync");
+                if (netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_GHOSTNODE_LIST_SYNC)) continue;
+                netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_GHOSTNODE_LIST_SYNC);
 
                 if (pnode->nVersion < mnpayments.GetMinGhostnodePaymentsProto()) continue;
                 nRequestedGhostnodeAttempt++;
@@ -408,8 +408,8 @@ void CGhostnodeSync::ProcessTick() {
                 }
 
                 // only request once from each peer
-                if (netfulfilledman.HasFulfilledRequest(pnode->addr, "ghostnode-payment-sync")) continue;
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "ghostnode-payment-sync");
+                if (netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_GHOSTNODE_PAYMENT_SYNC)) continue;
+                netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_GHOSTNODE_PAYMENT_SYNC);
 
                 if (pnode->nVersion < mnpayments.GetMinGhostnodePaymentsProto()) continue;
                 nRequestedGhostnodeAttempt++;
@@ -5,6 +5,7 @@
 
 #include "activeghostnode.h"
 #include "consensus/validation.h"
+#include "core_memusage.h"
 #include "darksend.h"
 #include "init.h"
 #include "ghostnode.h"
@@ -13,9 +14,47 @@
 #include "ghostnodeman.h"
 #include "util.h"
 #include "netbase.h"
+#include "validationinterface.h"
 
 #include <boost/lexical_cast.hpp>
 
+#include <unordered_set>
+
+/** Signatures verified ahead of time by PreVerifySignature(), each entry is consumed by the CheckSignature() of the same message */
+static CCriticalSection cs_setPreVerifiedSignatures;
+static std::unordered_set<uint256, BlockHasher> setPreVerifiedSignatures;
+static const size_t MAX_PREVERIFIED_SIGNATURES = 100000;
+
+static uint256 GetSignatureEntry(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const std::string& strMessage)
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << pubKey << vchSig << strMessage;
+    return ss.GetHash();
+}
+
+static bool PreVerifyMessage(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const std::string& strMessage)
+{
+    std::string strError;
+    if (!darkSendSigner.VerifyMessage(pubKey, vchSig, strMessage, strError))
+        return false;
+
+    LOCK(cs_setPreVerifiedSignatures);
+    if (setPreVerifiedSignatures.size() >= MAX_PREVERIFIED_SIGNATURES)
+        setPreVerifiedSignatures.clear();
+    setPreVerifiedSignatures.insert(GetSignatureEntry(pubKey, vchSig, strMessage));
+    return true;
+}
+
+static bool VerifyGhostnodeMessage(const CPubKey& pubKey, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet)
+{
+    {
+        LOCK(cs_setPreVerifiedSignatures);
+        if (!setPreVerifiedSignatures.empty() && setPreVerifiedSignatures.erase(GetSignatureEntry(pubKey, vchSig, strMessage)))
+            return true;
+    }
+    return darkSendSigner.VerifyMessage(pubKey, vchSig, strMessage, strErrorRet);
+}
+
 
 CGhostnode::CGhostnode() :
         vin(),
@@ -27,6 +66,7 @@ CGhostnode::CGhostnode() :
         sigTime(GetAdjustedTime()),
         nLastDsq(0),
         nTimeLastChecked(0),
+        nTimeCollateralChecked(0),
         nTimeLastPaid(0),
         nTimeLastWatchdogVote(0),
         nActiveState(GHOSTNODE_ENABLED),
@@ -48,6 +88,7 @@ CGhostnode::CGhostnode(CService addrNew, CTxIn vinNew, CPubKey pubKeyCollateralA
         sigTime(GetAdjustedTime()),
         nLastDsq(0),
         nTimeLastChecked(0),
+        nTimeCollateralChecked(0),
         nTimeLastPaid(0),
         nTimeLastWatchdogVote(0),
         nActiveState(GHOSTNODE_ENABLED),
@@ -69,6 +110,7 @@ CGhostnode::CGhostnode(const CGhostnode &other) :
         sigTime(other.sigTime),
         nLastDsq(other.nLastDsq),
         nTimeLastChecked(other.nTimeLastChecked),
+        nTimeCollateralChecked(other.nTimeCollateralChecked),
         nTimeLastPaid(other.nTimeLastPaid),
         nTimeLastWatchdogVote(other.nTimeLastWatchdogVote),
         nActiveState(other.nActiveState),
@@ -90,6 +132,7 @@ CGhostnode::CGhostnode(const CGhostnodeBroadcast &mnb) :
         sigTime(mnb.sigTime),
         nLastDsq(0),
         nTimeLastChecked(0),
+        nTimeCollateralChecked(0),
         nTimeLastPaid(0),
         nTimeLastWatchdogVote(mnb.sigTime),
         nActiveState(mnb.nActiveState),
@@ -110,6 +153,7 @@ bool CGhostnode::UpdateFromNewBroadcast(CGhostnodeBroadcast &mnb) {
 
     pubKeyGhostnode = mnb.pubKeyGhostnode;
     sigTime = mnb.sigTime;
+    mnodeman.NotifyGhostnodeStateChanged();
     vchSig = mnb.vchSig;
     nProtocolVersion = mnb.nProtocolVersion;
     addr = mnb.addr;
@@ -160,6 +204,18 @@ arith_uint256 CGhostnode::CalculateScore(const uint256 &blockHash) {
 void CGhostnode::Check(bool fForce) {
     LOCK(cs);
 
+    bool fWasEnabled = IsEnabled();
+    int nStatePrev = nActiveState;
+    UpdateState(fForce);
+    if (IsEnabled() != fWasEnabled)
+        mnodeman.NotifyGhostnodeStateChanged();
+    if (nActiveState != nStatePrev) {
+        mnodeman.NotifyGhostnodeListChanged();
+        GetMainSignals().NotifyGhostnodeState(vin.prevout, nActiveState);
+    }
+}
+
+void CGhostnode::UpdateState(bool fForce) {
     if (ShutdownRequested()) return;
 
     if (!fForce && (GetTime() - nTimeLastChecked < GHOSTNODE_CHECK_SECONDS)) return;
@@ -172,19 +228,24 @@ void CGhostnode::Check(bool fForce) {
 
     int nHeight = 0;
     if (!fUnitTest) {
-        TRY_LOCK(cs_main, lockMain);
-        if (!lockMain) return;
-
-        Coin coin;
-        if (!pcoinsTip->GetCoin(vin.prevout, coin) ||
-            /*(unsigned int) vin.prevout.n >= coin.out || */
-            coin.out.IsNull()) {
-            nActiveState = GHOSTNODE_OUTPOINT_SPENT;
-            //LogPrint("ghostnode", "CGhostnode::Check -- Failed to find Ghostnode UTXO, ghostnode=%s\n", vin.prevout.ToStringShort());
-            return;
+        // Collateral spends are reported by CGhostnodeMan::CheckSpentCollaterals as blocks connect,
+        // the UTXO set is only looked up once in a while to catch anything that slipped past it.
+        if (fForce || GetTime() - nTimeCollateralChecked >= GHOSTNODE_COLLATERAL_CHECK_SECONDS) {
+            TRY_LOCK(cs_main, lockMain);
+            if (!lockMain) return;
+
+            Coin coin;
+            if (!pcoinsTip->GetCoin(vin.prevout, coin) ||
+                /*(unsigned int) vin.prevout.n >= coin.out || */
+                coin.out.IsNull()) {
+                nActiveState = GHOSTNODE_OUTPOINT_SPENT;
+                //LogPrint("ghostnode", "CGhostnode::Check -- Failed to find Ghostnode UTXO, ghostnode=%s\n", vin.prevout.ToStringShort());
+                return;
+            }
+            nTimeCollateralChecked = GetTime();
         }
 
-        nHeight = chainActive.Height();
+        nHeight = mnodeman.GetCachedBlockHeight();
     }
 
     if (IsPoSeBanned()) {
@@ -370,6 +431,13 @@ std::string CGhostnode::ToString() const {
     return str;
 }
 
+size_t CGhostnode::DynamicMemoryUsage() const {
+    LOCK(cs);
+    return RecursiveDynamicUsage(vin) + memusage::DynamicUsage(vchSig) +
+           RecursiveDynamicUsage(lastPing.vin) + memusage::DynamicUsage(lastPing.vchSig) +
+           memusage::DynamicUsage(mapGovernanceObjectsVotedOn);
+}
+
 int CGhostnode::GetCollateralAge() {
     int nHeight;
     {
@@ -418,6 +486,7 @@ void CGhostnode::UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScanB
             if (mnpayee == txout.scriptPubKey && nGhostnodePayment == txout.nValue) {
                 nBlockLastPaid = BlockReading->nHeight;
                 nTimeLastPaid = BlockReading->nTime;
+                mnodeman.NotifyGhostnodeListChanged();
                 return;
             }
         }
@@ -816,18 +885,26 @@ bool CGhostnodeBroadcast::Sign(CKey &keyCollateralAddress) {
     return true;
 }
 
+std::string CGhostnodeBroadcast::GetSignatureMessage() const {
+    return addr.ToString() + boost::lexical_cast<std::string>(sigTime) +
+           pubKeyCollateralAddress.GetID().ToString() + pubKeyGhostnode.GetID().ToString() +
+           boost::lexical_cast<std::string>(nProtocolVersion);
+}
+
+bool CGhostnodeBroadcast::PreVerifySignature() const {
+    return PreVerifyMessage(pubKeyCollateralAddress, vchSig, GetSignatureMessage());
+}
+
 bool CGhostnodeBroadcast::CheckSignature(int &nDos) {
     std::string strMessage;
     std::string strError = "";
     nDos = 0;
 
-    strMessage = addr.ToString() + boost::lexical_cast<std::string>(sigTime) +
-                 pubKeyCollateralAddress.GetID().ToString() + pubKeyGhostnode.GetID().ToString() +
-                 boost::lexical_cast<std::string>(nProtocolVersion);
+    strMessage = GetSignatureMessage();
 
     //LogPrintf("CGhostnodeBroadcast::CheckSignature -- strMessage: %s  pubKeyCollateralAddress address: %s  sig: %s\n", strMessage, CBitcoinAddress(pubKeyCollateralAddress.GetID()).ToString(), EncodeBase64(&vchSig[0], vchSig.size()));
 
-    if (!darkSendSigner.VerifyMessage(pubKeyCollateralAddress, vchSig, strMessage, strError)) {
+    if (!VerifyGhostnodeMessage(pubKeyCollateralAddress, vchSig, strMessage, strError)) {
         //LogPrintf("CGhostnodeBroadcast::CheckSignature -- Got bad Ghostnode announce signature, error: %s\n", strError);
         nDos = 100;
         return false;
@@ -892,12 +969,17 @@ bool CGhostnodePing::Sign(CKey &keyGhostnode, CPubKey &pubKeyGhostnode, int64_t
     return true;
 }
 
+bool CGhostnodePing::PreVerifySignature(const CPubKey &pubKeyGhostnode) const {
+    std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+    return PreVerifyMessage(pubKeyGhostnode, vchSig, strMessage);
+}
+
 bool CGhostnodePing::CheckSignature(CPubKey &pubKeyGhostnode, int &nDos) {
     std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
     std::string strError = "";
     nDos = 0;
 
-    if (!darkSendSigner.VerifyMessage(pubKeyGhostnode, vchSig, strMessage, strError)) {
+    if (!VerifyGhostnodeMessage(pubKeyGhostnode, vchSig, strMessage, strError)) {
         //LogPrint("CGhostnodePing::CheckSignature -- Got bad Ghostnode ping signature, ghostnode=%s, error: %s\n", vin.prevout.ToStringShort(), strError);
         nDos = 33;
         return false;
@@ -991,6 +1073,7 @@ bool CGhostnodePing::CheckAndUpdate(CGhostnode *pmn, bool fFromNewBroadcast, int
     // let's store this ping as the last one
     //LogPrint("ghostnode", "CGhostnodePing::CheckAndUpdate -- Ghostnode ping accepted, ghostnode=%s\n", vin.prevout.ToStringShort());
     pmn->lastPing = *this;
+    mnodeman.NotifyGhostnodeListChanged();
 
     // and update ghostnodeman.mapSeenGhostnodeBroadcast.lastPing which is probably outdated
     CGhostnodeBroadcast mnb(*pmn);
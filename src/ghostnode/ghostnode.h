@@ -18,6 +18,7 @@ class CGhostnodeBroadcast;
 class CGhostnodePing;
 
 static const int GHOSTNODE_CHECK_SECONDS               =   5;
+static const int GHOSTNODE_COLLATERAL_CHECK_SECONDS    =  10 * 60;
 static const int GHOSTNODE_MIN_MNB_SECONDS             =   5 * 60; //BROADCAST_TIME
 static const int GHOSTNODE_MIN_MNP_SECONDS             =  10 * 60; //PRE_ENABLE_TIME
 static const int GHOSTNODE_EXPIRATION_SECONDS          =  65 * 60;
@@ -84,6 +85,9 @@ public:
     bool Sign(CKey& keyGhostnode, CPubKey& pubKeyGhostnode);
     bool Sign(CKey& keyGhostnode, CPubKey& pubKeyGhostnode, int64_t time);
     bool CheckSignature(CPubKey& pubKeyGhostnode, int &nDos);
+    /// Verify the signature ahead of CheckSignature(), which then finds it in the verified signature cache.
+    /// Takes no locks so batches can be checked on worker threads
+    bool PreVerifySignature(const CPubKey& pubKeyGhostnode) const;
     bool SimpleCheck(int& nDos);
     bool CheckAndUpdate(CGhostnode* pmn, bool fFromNewBroadcast, int& nDos);
     void Relay();
@@ -147,6 +151,8 @@ private:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
+    void UpdateState(bool fForce);
+
 public:
     enum state {
         GHOSTNODE_PRE_ENABLED,
@@ -168,6 +174,7 @@ public:
     int64_t sigTime; //mnb message time
     int64_t nLastDsq; //the dsq count from the last dsq broadcast of this node
     int64_t nTimeLastChecked;
+    int64_t nTimeCollateralChecked; // not serialized, last time the collateral was looked up in the UTXO set
     int64_t nTimeLastPaid;
     int64_t nTimeLastWatchdogVote;
     int nActiveState;
@@ -230,6 +237,7 @@ public:
         swap(first.sigTime, second.sigTime);
         swap(first.nLastDsq, second.nLastDsq);
         swap(first.nTimeLastChecked, second.nTimeLastChecked);
+        swap(first.nTimeCollateralChecked, second.nTimeCollateralChecked);
         swap(first.nTimeLastPaid, second.nTimeLastPaid);
         swap(first.nTimeLastWatchdogVote, second.nTimeLastWatchdogVote);
         swap(first.nActiveState, second.nActiveState);
@@ -269,6 +277,8 @@ public:
     bool IsPoSeVerified() { return nPoSeBanScore <= -GHOSTNODE_POSE_BAN_MAX_SCORE; }
     bool IsExpired() { return nActiveState == GHOSTNODE_EXPIRED; }
     bool IsOutpointSpent() { return nActiveState == GHOSTNODE_OUTPOINT_SPENT; }
+
+    void SetOutpointSpent() { LOCK(cs); nActiveState = GHOSTNODE_OUTPOINT_SPENT; }
     bool IsUpdateRequired() { return nActiveState == GHOSTNODE_UPDATE_REQUIRED; }
     bool IsWatchdogExpired() { return nActiveState == GHOSTNODE_WATCHDOG_EXPIRED; }
     bool IsNewStartRequired() { return nActiveState == GHOSTNODE_NEW_START_REQUIRED; }
@@ -296,10 +306,13 @@ public:
     std::string GetStatus() const;
     std::string ToString() const;
 
+    /// Heap memory of the signatures, scripts and governance votes
+    size_t DynamicMemoryUsage() const;
+
     int GetCollateralAge();
 
-    int GetLastPaidTime() { return nTimeLastPaid; }
-    int GetLastPaidBlock() { return nBlockLastPaid; }
+    int GetLastPaidTime() const { return nTimeLastPaid; }
+    int GetLastPaidBlock() const { return nBlockLastPaid; }
     void UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScanBack);
 
     // KEEP TRACK OF EACH GOVERNANCE ITEM INCASE THIS NODE GOES OFFLINE, SO WE CAN RECALC THEIR STATUS
@@ -377,7 +390,13 @@ public:
 
     bool Sign(CKey& keyCollateralAddress);
     bool CheckSignature(int& nDos);
+    /// Verify the signature ahead of CheckSignature(), which then finds it in the verified signature cache.
+    /// Takes no locks so batches can be checked on worker threads
+    bool PreVerifySignature() const;
     void RelayGhostNode();
+
+private:
+    std::string GetSignatureMessage() const;
 };
 
 class CGhostnodeVerification
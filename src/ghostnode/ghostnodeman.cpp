@@ -5,6 +5,8 @@
 
 #include "activeghostnode.h"
 #include "addrman.h"
+#include "core_memusage.h"
+#include "crypto/sha256.h"
 #include "darksend.h"
 #include "ghostnode-payments.h"
 #include "ghostnode-sync.h"
@@ -12,6 +14,7 @@
 #include "netfulfilledman.h"
 #include "util.h"
 #include "netmessagemaker.h"
+#include "sigma/parallel.h"
 
 /** Ghostnode manager */
 CGhostnodeMan mnodeman;
@@ -114,6 +117,15 @@ CGhostnodeMan::CGhostnodeMan() : cs(),
   fGhostnodesRemoved(false),
 //  vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
+  nGhostFeePayeesActiveBefore(0),
+  nGhostFeePayeesStateVersion(0),
+  nGhostnodeStateVersion(0),
+  nRankCacheStateVersion(0),
+  nListSnapshotVersion(0),
+  nGhostnodeListVersion(0),
+  nMaxSeenMemory(0),
+  nSeenBroadcastsEvicted(0),
+  nSeenPingsEvicted(0),
   mapSeenGhostnodeBroadcast(),
   mapSeenGhostnodePing(),
   nDsqCount(0)
@@ -127,8 +139,10 @@ bool CGhostnodeMan::Add(CGhostnode &mn)
     if (pmn == NULL) {
         //LogPrint("ghostnode", "CGhostnodeMan::Add -- Adding new Ghostnode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
         vGhostnodes.push_back(mn);
+        IndexGhostnode(vGhostnodes.size() - 1);
         indexGhostnodes.AddGhostnodeVIN(mn.vin);
         fGhostnodesAdded = true;
+        NotifyGhostnodeStateChanged();
         return true;
     }
 
@@ -208,7 +222,9 @@ void CGhostnodeMan::CheckAndRemove()
                 // and finally remove it from the list
 //                it->FlagGovernanceItemsAsDirty();
                 it = vGhostnodes.erase(it);
+                RebuildLookupIndexes();
                 fGhostnodesRemoved = true;
+                NotifyGhostnodeStateChanged();
             } else {
                 bool fAsk = pCurrentBlockIndex &&
                             (nAskForMnbRecovery > 0) &&
@@ -329,6 +345,8 @@ void CGhostnodeMan::CheckAndRemove()
         }
 
         // NOTE: do not expire mapSeenGhostnodeBroadcast entries here, clean them on mnb updates!
+        // (unless they are over -maxghostnodeseenmem)
+        LimitSeenMaps();
 
         // remove expired mapSeenGhostnodePing
         std::map<uint256, CGhostnodePing>::iterator it4 = mapSeenGhostnodePing.begin();
@@ -364,10 +382,55 @@ void CGhostnodeMan::CheckAndRemove()
     }
 }
 
+/** Approximate heap memory of a seen broadcast and ping: the map node and the signatures */
+static size_t SeenBroadcastUsage()
+{
+    return memusage::MallocUsage(sizeof(memusage::stl_tree_node<std::pair<const uint256, std::pair<int64_t, CGhostnodeBroadcast> > >)) +
+           2 * memusage::MallocUsage(CPubKey::COMPACT_SIGNATURE_SIZE);
+}
+
+static size_t SeenPingUsage()
+{
+    return memusage::MallocUsage(sizeof(memusage::stl_tree_node<std::pair<const uint256, CGhostnodePing> >)) +
+           memusage::MallocUsage(CPubKey::COMPACT_SIGNATURE_SIZE);
+}
+
+/** Erase the oldest nCount entries of a seen map by the time given by GetTime, returns how many were erased */
+template <typename M, typename F>
+static size_t EraseOldest(M& map, size_t nCount, F GetTime)
+{
+    nCount = std::min(nCount, map.size());
+    if (nCount == 0) return 0;
+    std::vector<std::pair<int64_t, uint256> > vTimes;
+    vTimes.reserve(map.size());
+    for (const auto& entry : map)
+        vTimes.emplace_back(GetTime(entry.second), entry.first);
+    std::nth_element(vTimes.begin(), vTimes.begin() + (nCount - 1), vTimes.end());
+    for (size_t i = 0; i < nCount; i++)
+        map.erase(vTimes[i].second);
+    return nCount;
+}
+
+void CGhostnodeMan::LimitSeenMaps()
+{
+    AssertLockHeld(cs);
+
+    size_t nUsage = mapSeenGhostnodeBroadcast.size() * SeenBroadcastUsage() + mapSeenGhostnodePing.size() * SeenPingUsage();
+    if (nMaxSeenMemory == 0 || nUsage + SeenBroadcastUsage() <= nMaxSeenMemory) return;
+
+    // a tenth at a time, so the scan for the oldest entries doesn't happen on every insert
+    nSeenBroadcastsEvicted += EraseOldest(mapSeenGhostnodeBroadcast, mapSeenGhostnodeBroadcast.size() / 10 + 1,
+                                          [](const std::pair<int64_t, CGhostnodeBroadcast>& seen) { return seen.first; });
+    nSeenPingsEvicted += EraseOldest(mapSeenGhostnodePing, mapSeenGhostnodePing.size() / 10 + 1,
+                                     [](const CGhostnodePing& mnp) { return mnp.sigTime; });
+}
+
 void CGhostnodeMan::Clear()
 {
     LOCK(cs);
     vGhostnodes.clear();
+    RebuildLookupIndexes();
+    NotifyGhostnodeStateChanged();
     mAskedUsForGhostnodeList.clear();
     mWeAskedForGhostnodeList.clear();
     mWeAskedForGhostnodeListEntry.clear();
@@ -379,6 +442,36 @@ void CGhostnodeMan::Clear()
     indexGhostnodesOld.Clear();
 }
 
+std::shared_ptr<const std::vector<CScript> > CGhostnodeMan::GetGhostFeePayees(int64_t nActiveBefore)
+{
+    LOCK(cs);
+    int nStateVersion = nGhostnodeStateVersion;
+    if (pGhostFeePayees && nGhostFeePayeesActiveBefore == nActiveBefore && nGhostFeePayeesStateVersion == nStateVersion)
+        return pGhostFeePayees;
+
+    std::shared_ptr<std::vector<CScript> > pPayees = std::make_shared<std::vector<CScript> >();
+    for (CGhostnode &mn : vGhostnodes) {
+        if (mn.IsEnabled() && mn.sigTime <= nActiveBefore)
+            pPayees->push_back(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()));
+    }
+
+    pGhostFeePayees = pPayees;
+    nGhostFeePayeesActiveBefore = nActiveBefore;
+    nGhostFeePayeesStateVersion = nStateVersion;
+    return pGhostFeePayees;
+}
+
+std::shared_ptr<const std::vector<CGhostnode> > CGhostnodeMan::GetGhostnodeListSnapshot()
+{
+    LOCK(cs);
+    int nListVersion = nGhostnodeListVersion;
+    if (!pListSnapshot || nListSnapshotVersion != nListVersion) {
+        pListSnapshot = std::make_shared<const std::vector<CGhostnode> >(vGhostnodes);
+        nListSnapshotVersion = nListVersion;
+    }
+    return pListSnapshot;
+}
+
 int CGhostnodeMan::CountGhostnodes(int nProtocolVersion)
 {
     LOCK(cs);
@@ -446,40 +539,74 @@ void CGhostnodeMan::DsegUpdate(CNode* pnode)
     //LogPrint("ghostnode", "CGhostnodeMan::DsegUpdate -- asked %s for the list\n", pnode->addr.ToString());
 }
 
+void CGhostnodeMan::IndexGhostnode(size_t nPos)
+{
+    AssertLockHeld(cs);
+
+    const CGhostnode& mn = vGhostnodes[nPos];
+    mapGhostnodeOutpoints.emplace(mn.vin.prevout, nPos);
+    mapGhostnodePubKeys.emplace(mn.pubKeyGhostnode.GetID(), nPos);
+    mapGhostnodePayees.emplace(CScriptID(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID())), nPos);
+    setLastPaidQueue.insert(std::make_pair(mn.nBlockLastPaid, mn.vin.prevout));
+    setGhostnodeAddrs.insert(std::make_pair(mn.addr, mn.vin.prevout));
+}
+
+void CGhostnodeMan::RebuildLookupIndexes()
+{
+    AssertLockHeld(cs);
+
+    mapGhostnodeOutpoints.clear();
+    mapGhostnodePubKeys.clear();
+    mapGhostnodePayees.clear();
+    setLastPaidQueue.clear();
+    setGhostnodeAddrs.clear();
+    for (size_t i = 0; i < vGhostnodes.size(); i++)
+        IndexGhostnode(i);
+}
+
+void CGhostnodeMan::UpdateAddrIndex(const CGhostnode& mn, const CService& addrOld)
+{
+    AssertLockHeld(cs);
+
+    if (mn.addr == addrOld) return;
+    setGhostnodeAddrs.erase(std::make_pair(addrOld, mn.vin.prevout));
+    setGhostnodeAddrs.insert(std::make_pair(mn.addr, mn.vin.prevout));
+}
+
 CGhostnode* CGhostnodeMan::Find(const CScript &payee)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CGhostnode& mn, vGhostnodes)
-    {
-        if(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()) == payee)
-            return &mn;
-    }
-    return NULL;
+    auto it = mapGhostnodePayees.find(CScriptID(payee));
+    if (it == mapGhostnodePayees.end())
+        return NULL;
+    CGhostnode& mn = vGhostnodes[it->second];
+    if (GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()) != payee)
+        return NULL;
+    return &mn;
 }
 
 CGhostnode* CGhostnodeMan::Find(const CTxIn &vin)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CGhostnode& mn, vGhostnodes)
-    {
-        if(mn.vin.prevout == vin.prevout)
-            return &mn;
-    }
-    return NULL;
+    auto it = mapGhostnodeOutpoints.find(vin.prevout);
+    if (it == mapGhostnodeOutpoints.end())
+        return NULL;
+    return &vGhostnodes[it->second];
 }
 
 CGhostnode* CGhostnodeMan::Find(const CPubKey &pubKeyGhostnode)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CGhostnode& mn, vGhostnodes)
-    {
-        if(mn.pubKeyGhostnode == pubKeyGhostnode)
-            return &mn;
-    }
-    return NULL;
+    auto it = mapGhostnodePubKeys.find(pubKeyGhostnode.GetID());
+    if (it == mapGhostnodePubKeys.end())
+        return NULL;
+    CGhostnode& mn = vGhostnodes[it->second];
+    if (mn.pubKeyGhostnode != pubKeyGhostnode)
+        return NULL;
+    return &mn;
 }
 
 bool CGhostnodeMan::Get(const CPubKey& pubKeyGhostnode, CGhostnode& ghostnode)
@@ -518,6 +645,19 @@ ghostnode_info_t CGhostnodeMan::GetGhostnodeInfo(const CTxIn& vin)
     return info;
 }
 
+std::vector<ghostnode_info_t> CGhostnodeMan::GetGhostnodeInfos(const std::vector<CTxIn>& vecVin)
+{
+    std::vector<ghostnode_info_t> vecInfo(vecVin.size());
+    LOCK(cs);
+    for (size_t i = 0; i < vecVin.size(); i++) {
+        CGhostnode* pMN = Find(vecVin[i]);
+        if (pMN) {
+            vecInfo[i] = pMN->GetInfo();
+        }
+    }
+    return vecInfo;
+}
+
 ghostnode_info_t CGhostnodeMan::GetGhostnodeInfo(const CPubKey& pubKeyGhostnode)
 {
     ghostnode_info_t info;
@@ -537,46 +677,57 @@ bool CGhostnodeMan::Has(const CTxIn& vin)
     return (pMN != NULL);
 }
 
-char* CGhostnodeMan::GetNotQualifyReason(CGhostnode& mn, int nBlockHeight, bool fFilterSigTime, int nMnCount)
+bool CGhostnodeMan::IsQualifiedForPayment(CGhostnode& mn, int nBlockHeight, bool fFilterSigTime, int nMnCount, std::string* pstrReason)
 {
     if (!mn.IsValidForPayment()) {
-        char* reasonStr = new char[256];
-        sprintf(reasonStr, "false: 'not valid for payment'");
-        return reasonStr;
+        if (pstrReason)
+            *pstrReason = "false: 'not valid for payment'";
+        return false;
     }
     // //check protocol version
     if (mn.nProtocolVersion < mnpayments.GetMinGhostnodePaymentsProto()) {
-        // //LogPrint("Invalid nProtocolVersion!\n");
-        // //LogPrint("mn.nProtocolVersion=%s!\n", mn.nProtocolVersion);
-        // //LogPrint("mnpayments.GetMinGhostnodePaymentsProto=%s!\n", mnpayments.GetMinGhostnodePaymentsProto());
-        char* reasonStr = new char[256];
-        sprintf(reasonStr, "false: 'Invalid nProtocolVersion', nProtocolVersion=%d", mn.nProtocolVersion);
-        return reasonStr;
+        if (pstrReason)
+            *pstrReason = strprintf("false: 'Invalid nProtocolVersion', nProtocolVersion=%d", mn.nProtocolVersion);
+        return false;
     }
     //it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
     if (mnpayments.IsScheduled(mn, nBlockHeight)) {
-        // //LogPrint("mnpayments.IsScheduled!\n");
-        char* reasonStr = new char[256];
-        sprintf(reasonStr, "false: 'is scheduled'");
-        return reasonStr;
+        if (pstrReason)
+            *pstrReason = "false: 'is scheduled'";
+        return false;
     }
     //it's too new, wait for a cycle
     if (fFilterSigTime && mn.sigTime + (nMnCount * 2.6 * 60) > GetAdjustedTime()) {
-        // //LogPrint("it's too new, wait for a cycle!\n");
-        char* reasonStr = new char[256];
-        sprintf(reasonStr, "false: 'too new', sigTime=%s, will be qualifed after=%s",
-                DateTimeStrFormat("%Y-%m-%d %H:%M UTC", mn.sigTime).c_str(), DateTimeStrFormat("%Y-%m-%d %H:%M UTC", mn.sigTime + (nMnCount * 2.6 * 60)).c_str());
-        return reasonStr;
+        if (pstrReason)
+            *pstrReason = strprintf("false: 'too new', sigTime=%s, will be qualifed after=%s",
+                                    DateTimeStrFormat("%Y-%m-%d %H:%M UTC", mn.sigTime), DateTimeStrFormat("%Y-%m-%d %H:%M UTC", mn.sigTime + (nMnCount * 2.6 * 60)));
+        return false;
     }
     //make sure it has at least as many confirmations as there are ghostnodes
     if (mn.GetCollateralAge() < nMnCount) {
-        // //LogPrint("mn.GetCollateralAge()=%s!\n", mn.GetCollateralAge());
-        // //LogPrint("nMnCount=%s!\n", nMnCount);
-        char* reasonStr = new char[256];
-        sprintf(reasonStr, "false: 'collateralAge < znCount', collateralAge=%d, znCount=%d", mn.GetCollateralAge(), nMnCount);
-        return reasonStr;
+        if (pstrReason)
+            *pstrReason = strprintf("false: 'collateralAge < znCount', collateralAge=%d, znCount=%d", mn.GetCollateralAge(), nMnCount);
+        return false;
     }
-    return NULL;
+    return true;
+}
+
+int CGhostnodeMan::CountQualifiedForPayment(int nBlockHeight, bool fFilterSigTime)
+{
+    LOCK2(cs_main, cs);
+
+    int nMnCount = CountEnabled();
+    int nCount = 0;
+    BOOST_FOREACH(CGhostnode &mn, vGhostnodes) {
+        if (IsQualifiedForPayment(mn, nBlockHeight, fFilterSigTime, nMnCount))
+            nCount++;
+    }
+
+    //when the network is in the process of upgrading, don't penalize nodes that recently restarted
+    if (fFilterSigTime && nCount < nMnCount / 3)
+        return CountQualifiedForPayment(nBlockHeight, false);
+
+    return nCount;
 }
 
 //
@@ -597,63 +748,81 @@ CGhostnode* CGhostnodeMan::GetNextGhostnodeInQueueForPayment(int nBlockHeight, b
     LOCK2(cs_main,cs);
 
     CGhostnode *pBestGhostnode = NULL;
-    std::vector<std::pair<int, CGhostnode*> > vecGhostnodeLastPaid;
+    std::vector<CGhostnode*> vecGhostnodeOldest;
 
-    /*
-        Make a vector with all of the last paid times
-    */
-    //LogPrintf("\nGhostnode InQueueForPayment \n");
+    // Look at 1/10 of the oldest nodes (by last payment), calculate their scores and pay the best one
+    //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
+    //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
+    //  -- (chance per block * chances before IsScheduled will fire)
     int nMnCount = CountEnabled();
-    int index = 0;
-    BOOST_FOREACH(CGhostnode &mn, vGhostnodes)
-    {
-        index += 1;
+    size_t nTenthNetwork = std::max(nMnCount / 10, 1);
+    // qualified ghostnodes needed to keep filtering by sigTime
+    int nMinCount = fFilterSigTime ? nMnCount / 3 : 0;
 
-        char* reasonStr = GetNotQualifyReason(mn, nBlockHeight, fFilterSigTime, nMnCount);
-        if (reasonStr != NULL) {
-            //LogPrint("ghostnodeman", "Ghostnode, %s, addr(%s), qualify %s\n",
-                     //mn.vin.prevout.ToStringShort(), CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString(), reasonStr);
-            delete [] reasonStr;
+    /*
+        Walk the payment queue from the oldest payment until we have the oldest tenth
+        and know whether enough ghostnodes qualify
+    */
+    nCount = 0;
+    BOOST_FOREACH(const PAIRTYPE(int, COutPoint)& entry, setLastPaidQueue) {
+        CGhostnode& mn = vGhostnodes[mapGhostnodeOutpoints.at(entry.second)];
+        if (!IsQualifiedForPayment(mn, nBlockHeight, fFilterSigTime, nMnCount))
             continue;
-        }
-        //LogPrintf("\nNODE Last Paid\n");
-        vecGhostnodeLastPaid.push_back(std::make_pair(mn.GetLastPaidBlock(), &mn));
+        nCount++;
+        if (vecGhostnodeOldest.size() < nTenthNetwork)
+            vecGhostnodeOldest.push_back(&mn);
+        if (vecGhostnodeOldest.size() >= nTenthNetwork && nCount >= nMinCount)
+            break;
     }
-    nCount = (int)vecGhostnodeLastPaid.size();
 
     //when the network is in the process of upgrading, don't penalize nodes that recently restarted
-    if(fFilterSigTime && nCount < nMnCount / 3) {
+    if(nCount < nMinCount) {
         LogPrintf("Need Return, nCount=%s, nMnCount/3=%s\n", nCount, nMnCount/3);
         return GetNextGhostnodeInQueueForPayment(nBlockHeight, false, nCount);
     }
 
-    // Sort them low to high
-    sort(vecGhostnodeLastPaid.begin(), vecGhostnodeLastPaid.end(), CompareLastPaidBlock());
-
     uint256 blockHash;
     if(!GetBlockHash(blockHash, nBlockHeight - 100)) {
         LogPrintf("CGhostnode::GetNextGhostnodeInQueueForPayment -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", (nBlockHeight - 100));
         return NULL;
     }
-    // Look at 1/10 of the oldest nodes (by last payment), calculate their scores and pay the best one
-    //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
-    //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
-    //  -- (chance per block * chances before IsScheduled will fire)
-    int nTenthNetwork = nMnCount/10;
-    int nCountTenth = 0;
     arith_uint256 nHighest = 0;
-    BOOST_FOREACH (PAIRTYPE(int, CGhostnode*)& s, vecGhostnodeLastPaid){
-        arith_uint256 nScore = s.second->CalculateScore(blockHash);
-        if(nScore > nHighest){
-            nHighest = nScore;
-            pBestGhostnode = s.second;
+    std::vector<arith_uint256> vecScores = CalculateScores(blockHash, vecGhostnodeOldest);
+    for (size_t i = 0; i < vecGhostnodeOldest.size(); i++) {
+        if(vecScores[i] > nHighest){
+            nHighest = vecScores[i];
+            pBestGhostnode = vecGhostnodeOldest[i];
         }
-        nCountTenth++;
-        if(nCountTenth >= nTenthNetwork) break;
     }
     return pBestGhostnode;
 }
 
+std::vector<arith_uint256> CGhostnodeMan::CalculateScores(const uint256& blockHash, const std::vector<CGhostnode*>& vecGhostnodesIn)
+{
+    arith_uint256 hash2 = UintToArith256(Hash(blockHash.begin(), blockHash.end()));
+
+    // hash3 of a ghostnode is the double SHA256 of the 64 bytes blockHash || aux
+    std::vector<unsigned char> vchIn(vecGhostnodesIn.size() * 64);
+    std::vector<unsigned char> vchOut(vecGhostnodesIn.size() * 32);
+    for (size_t i = 0; i < vecGhostnodesIn.size(); i++) {
+        const COutPoint& prevout = vecGhostnodesIn[i]->vin.prevout;
+        uint256 aux = ArithToUint256(UintToArith256(prevout.hash) + prevout.n);
+        memcpy(&vchIn[i * 64], blockHash.begin(), 32);
+        memcpy(&vchIn[i * 64 + 32], aux.begin(), 32);
+    }
+    SHA256D64(vchOut.data(), vchIn.data(), vecGhostnodesIn.size());
+
+    std::vector<arith_uint256> vecScores;
+    vecScores.reserve(vecGhostnodesIn.size());
+    for (size_t i = 0; i < vecGhostnodesIn.size(); i++) {
+        uint256 hash;
+        memcpy(hash.begin(), &vchOut[i * 32], 32);
+        arith_uint256 hash3 = UintToArith256(hash);
+        vecScores.push_back(hash3 > hash2 ? hash3 - hash2 : hash2 - hash3);
+    }
+    return vecScores;
+}
+
 CGhostnode* CGhostnodeMan::FindRandomNotInVec(const std::vector<CTxIn> &vecToExclude, int nProtocolVersion)
 {
     LOCK(cs);
@@ -697,68 +866,90 @@ CGhostnode* CGhostnodeMan::FindRandomNotInVec(const std::vector<CTxIn> &vecToExc
     return NULL;
 }
 
-int CGhostnodeMan::GetGhostnodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
+const CGhostnodeMan::CGhostnodeRanking& CGhostnodeMan::GetRanking(const uint256& blockHash, int nMinProtocol, RankFilter filter)
 {
-    std::vector<std::pair<int64_t, CGhostnode*> > vecGhostnodeScores;
+    AssertLockHeld(cs);
 
-    //make sure we know about this block
-    uint256 blockHash = uint256();
-    if(!GetBlockHash(blockHash, nBlockHeight)) return -1;
+    int nStateVersion = nGhostnodeStateVersion;
+    if (nRankCacheStateVersion != nStateVersion) {
+        listRankCache.clear();
+        mapRankCache.clear();
+        nRankCacheStateVersion = nStateVersion;
+    }
 
-    LOCK(cs);
+    rank_cache_key_t key = std::make_tuple(blockHash, nMinProtocol, filter);
+    std::map<rank_cache_key_t, rank_cache_list_t::iterator>::iterator mi = mapRankCache.find(key);
+    if (mi != mapRankCache.end()) {
+        listRankCache.splice(listRankCache.begin(), listRankCache, mi->second);
+        return mi->second->second;
+    }
 
-    // scan for winner
+    std::vector<CGhostnode*> vecRanked;
     BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
         if(mn.nProtocolVersion < nMinProtocol) continue;
-        if(fOnlyActive) {
-            if(!mn.IsEnabled()) continue;
-        }
-        else {
-            if(!mn.IsValidForPayment()) continue;
-        }
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
+        if(filter == RANK_ACTIVE && !mn.IsEnabled()) continue;
+        if(filter == RANK_PAYABLE && !mn.IsValidForPayment()) continue;
+        vecRanked.push_back(&mn);
+    }
 
-        vecGhostnodeScores.push_back(std::make_pair(nScore, &mn));
+    std::vector<arith_uint256> vecScores = CalculateScores(blockHash, vecRanked);
+    std::vector<std::pair<int64_t, CGhostnode*> > vecGhostnodeScores;
+    vecGhostnodeScores.reserve(vecRanked.size());
+    for (size_t i = 0; i < vecRanked.size(); i++) {
+        vecGhostnodeScores.push_back(std::make_pair((int64_t)vecScores[i].GetCompact(false), vecRanked[i]));
     }
 
     sort(vecGhostnodeScores.rbegin(), vecGhostnodeScores.rend(), CompareScoreMN());
 
-    int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CGhostnode*)& scorePair, vecGhostnodeScores) {
-        nRank++;
-        if(scorePair.second->vin.prevout == vin.prevout) return nRank;
+    listRankCache.emplace_front(key, CGhostnodeRanking());
+    CGhostnodeRanking& ranking = listRankCache.front().second;
+    ranking.vecOutpoints.reserve(vecGhostnodeScores.size());
+    BOOST_FOREACH (PAIRTYPE(int64_t, CGhostnode*)& s, vecGhostnodeScores) {
+        ranking.vecOutpoints.push_back(s.second->vin.prevout);
+        ranking.mapRanks.emplace(s.second->vin.prevout, ranking.vecOutpoints.size());
+    }
+    mapRankCache[key] = listRankCache.begin();
+
+    if (listRankCache.size() > RANK_CACHE_SIZE) {
+        mapRankCache.erase(listRankCache.back().first);
+        listRankCache.pop_back();
     }
 
-    return -1;
+    return ranking;
 }
 
-std::vector<std::pair<int, CGhostnode> > CGhostnodeMan::GetGhostnodeRanks(int nBlockHeight, int nMinProtocol)
+int CGhostnodeMan::GetGhostnodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CGhostnode*> > vecGhostnodeScores;
-    std::vector<std::pair<int, CGhostnode> > vecGhostnodeRanks;
-
     //make sure we know about this block
     uint256 blockHash = uint256();
-    if(!GetBlockHash(blockHash, nBlockHeight)) return vecGhostnodeRanks;
+    if(!GetBlockHash(blockHash, nBlockHeight)) return -1;
 
     LOCK(cs);
 
-    // scan for winner
-    BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
+    const CGhostnodeRanking& ranking = GetRanking(blockHash, nMinProtocol, fOnlyActive ? RANK_ACTIVE : RANK_PAYABLE);
+    auto it = ranking.mapRanks.find(vin.prevout);
+    if (it == ranking.mapRanks.end())
+        return -1;
 
-        if(mn.nProtocolVersion < nMinProtocol || !mn.IsEnabled()) continue;
+    return it->second;
+}
 
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
+std::vector<std::pair<int, CGhostnode> > CGhostnodeMan::GetGhostnodeRanks(int nBlockHeight, int nMinProtocol)
+{
+    std::vector<std::pair<int, CGhostnode> > vecGhostnodeRanks;
 
-        vecGhostnodeScores.push_back(std::make_pair(nScore, &mn));
-    }
+    //make sure we know about this block
+    uint256 blockHash = uint256();
+    if(!GetBlockHash(blockHash, nBlockHeight)) return vecGhostnodeRanks;
 
-    sort(vecGhostnodeScores.rbegin(), vecGhostnodeScores.rend(), CompareScoreMN());
+    LOCK(cs);
 
+    const CGhostnodeRanking& ranking = GetRanking(blockHash, nMinProtocol, RANK_ACTIVE);
+    vecGhostnodeRanks.reserve(ranking.vecOutpoints.size());
     int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CGhostnode*)& s, vecGhostnodeScores) {
+    BOOST_FOREACH(const COutPoint& outpoint, ranking.vecOutpoints) {
         nRank++;
-        vecGhostnodeRanks.push_back(std::make_pair(nRank, *s.second));
+        vecGhostnodeRanks.push_back(std::make_pair(nRank, vGhostnodes[mapGhostnodeOutpoints.at(outpoint)]));
     }
 
     return vecGhostnodeRanks;
@@ -766,8 +957,6 @@ std::vector<std::pair<int, CGhostnode> > CGhostnodeMan::GetGhostnodeRanks(int nB
 
 CGhostnode* CGhostnodeMan::GetGhostnodeByRank(int nRank, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
 {
-    std::vector<std::pair<int64_t, CGhostnode*> > vecGhostnodeScores;
-
     LOCK(cs);
 
     uint256 blockHash;
@@ -776,28 +965,11 @@ CGhostnode* CGhostnodeMan::GetGhostnodeByRank(int nRank, int nBlockHeight, int n
         return NULL;
     }
 
-    // Fill scores
-    BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
-
-        if(mn.nProtocolVersion < nMinProtocol) continue;
-        if(fOnlyActive && !mn.IsEnabled()) continue;
-
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
-
-        vecGhostnodeScores.push_back(std::make_pair(nScore, &mn));
-    }
-
-    sort(vecGhostnodeScores.rbegin(), vecGhostnodeScores.rend(), CompareScoreMN());
-
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CGhostnode*)& s, vecGhostnodeScores){
-        rank++;
-        if(rank == nRank) {
-            return s.second;
-        }
-    }
+    const CGhostnodeRanking& ranking = GetRanking(blockHash, nMinProtocol, fOnlyActive ? RANK_ACTIVE : RANK_ALL);
+    if(nRank < 1 || nRank > (int)ranking.vecOutpoints.size())
+        return NULL;
 
-    return NULL;
+    return &vGhostnodes[mapGhostnodeOutpoints.at(ranking.vecOutpoints[nRank - 1])];
 }
 
 void CGhostnodeMan::ProcessGhostnodeConnections()
@@ -851,6 +1023,61 @@ std::pair<CService, std::set<uint256> > CGhostnodeMan::PopScheduledMnbRequestCon
 }
 
 
+void CGhostnodeMan::ProcessBroadcast(CNode* pfrom, CGhostnodeBroadcast& mnb)
+{
+    pfrom->setAskFor.erase(mnb.GetHash());
+
+    //LogPrint("MNANNOUNCE -- Ghostnode announce, ghostnode=%s\n", mnb.vin.prevout.ToStringShort());
+
+    int nDos = 0;
+
+    if (CheckMnbAndUpdateGhostnodeList(pfrom, mnb, nDos)) {
+        // use announced Ghostnode as a peer
+        g_connman->addrman.Add(CAddress(mnb.addr, NODE_NETWORK), pfrom->addr, 2*60*60);
+    } else if(nDos > 0) {
+        Misbehaving(pfrom->GetId(), nDos);
+    }
+}
+
+void CGhostnodeMan::ProcessPing(CNode* pfrom, CGhostnodePing& mnp)
+{
+    uint256 nHash = mnp.GetHash();
+
+    pfrom->setAskFor.erase(nHash);
+
+    //LogPrint("ghostnode", "MNPING -- Ghostnode ping, ghostnode=%s\n", mnp.vin.prevout.ToStringShort());
+
+    // Need LOCK2 here to ensure consistent locking order because the CheckAndUpdate call below locks cs_main
+    LOCK2(cs_main, cs);
+
+    if(mapSeenGhostnodePing.count(nHash)) return; //seen
+    LimitSeenMaps();
+    mapSeenGhostnodePing.insert(std::make_pair(nHash, mnp));
+
+    //LogPrint("ghostnode", "MNPING -- Ghostnode ping, ghostnode=%s new\n", mnp.vin.prevout.ToStringShort());
+
+    // see if we have this Ghostnode
+    CGhostnode* pmn = mnodeman.Find(mnp.vin);
+
+    // too late, new MNANNOUNCE is required
+    if(pmn && pmn->IsNewStartRequired()) return;
+
+    int nDos = 0;
+    if(mnp.CheckAndUpdate(pmn, false, nDos)) return;
+
+    if(nDos > 0) {
+        // if anything significant failed, mark that node
+        Misbehaving(pfrom->GetId(), nDos);
+    } else if(pmn != NULL) {
+        // nothing significant failed, mn is a known one too
+        return;
+    }
+
+    // something significant is broken or mn is unknown,
+    // we might have to ask for a ghostnode entry once
+    AskForMN(pfrom, mnp.vin);
+}
+
 void CGhostnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
 {
 
@@ -862,17 +1089,39 @@ void CGhostnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
         CGhostnodeBroadcast mnb;
         vRecv >> mnb;
 
-        pfrom->setAskFor.erase(mnb.GetHash());
+        ProcessBroadcast(pfrom, mnb);
 
-        //LogPrint("MNANNOUNCE -- Ghostnode announce, ghostnode=%s\n", mnb.vin.prevout.ToStringShort());
+        if(fGhostnodesAdded) {
+            NotifyGhostnodeUpdates();
+        }
+    } else if (strCommand == NetMsgType::MNANNOUNCEBATCH) { //Ghostnode Broadcasts in bulk
+        std::vector<CGhostnodeBroadcast> vecMnb;
+        vRecv >> vecMnb;
 
-        int nDos = 0;
+        if (vecMnb.size() > MNB_BATCH_MAX_ENTRIES) {
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
 
-        if (CheckMnbAndUpdateGhostnodeList(pfrom, mnb, nDos)) {
-            // use announced Ghostnode as a peer
-            g_connman->addrman.Add(CAddress(mnb.addr, NODE_NETWORK), pfrom->addr, 2*60*60);
-        } else if(nDos > 0) {
-            Misbehaving(pfrom->GetId(), nDos);
+        // verify the signatures on the worker threads first without holding any lock,
+        // the checks below then only look them up
+        sigma::parallel_for(vecMnb.size(), std::max(nScriptCheckThreads, 1), [&vecMnb](std::size_t i) {
+            const CGhostnodeBroadcast& mnb = vecMnb[i];
+            if (mnb.PreVerifySignature() && mnb.lastPing != CGhostnodePing()) {
+                mnb.lastPing.PreVerifySignature(mnb.pubKeyGhostnode);
+            }
+        });
+
+        {
+            // apply the whole batch under one lock
+            LOCK2(cs_main, cs);
+            BOOST_FOREACH(CGhostnodeBroadcast& mnb, vecMnb) {
+                ProcessBroadcast(pfrom, mnb);
+                // batches carry the latest ping inside the broadcast instead of a separate inv
+                if (mnb.lastPing != CGhostnodePing()) {
+                    ProcessPing(pfrom, mnb.lastPing);
+                }
+            }
         }
 
         if(fGhostnodesAdded) {
@@ -883,40 +1132,7 @@ void CGhostnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
         CGhostnodePing mnp;
         vRecv >> mnp;
 
-        uint256 nHash = mnp.GetHash();
-
-        pfrom->setAskFor.erase(nHash);
-
-        //LogPrint("ghostnode", "MNPING -- Ghostnode ping, ghostnode=%s\n", mnp.vin.prevout.ToStringShort());
-
-        // Need LOCK2 here to ensure consistent locking order because the CheckAndUpdate call below locks cs_main
-        LOCK2(cs_main, cs);
-
-        if(mapSeenGhostnodePing.count(nHash)) return; //seen
-        mapSeenGhostnodePing.insert(std::make_pair(nHash, mnp));
-
-        //LogPrint("ghostnode", "MNPING -- Ghostnode ping, ghostnode=%s new\n", mnp.vin.prevout.ToStringShort());
-
-        // see if we have this Ghostnode
-        CGhostnode* pmn = mnodeman.Find(mnp.vin);
-
-        // too late, new MNANNOUNCE is required
-        if(pmn && pmn->IsNewStartRequired()) return;
-
-        int nDos = 0;
-        if(mnp.CheckAndUpdate(pmn, false, nDos)) return;
-
-        if(nDos > 0) {
-            // if anything significant failed, mark that node
-            Misbehaving(pfrom->GetId(), nDos);
-        } else if(pmn != NULL) {
-            // nothing significant failed, mn is a known one too
-            return;
-        }
-
-        // something significant is broken or mn is unknown,
-        // we might have to ask for a ghostnode entry once
-        AskForMN(pfrom, mnp.vin);
+        ProcessPing(pfrom, mnp);
 
     } else if (strCommand == NetMsgType::DSEG) { //Get Ghostnode list or specific entry
         // Ignore such requests until we are fully synced.
@@ -947,6 +1163,10 @@ void CGhostnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
         } //else, asking for a specific node which is ok
 
         int nInvCount = 0;
+        const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+        // peers that asked for batches get the full list in a few messages instead of two invs per entry
+        bool fBatch = vin == CTxIn() && pfrom->fSendGhostnodeBatches;
+        std::vector<CGhostnodeBroadcast> vecMnbBatch;
 
         BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
             if (vin != CTxIn() && vin != mn.vin) continue; // asked for specific vin but we are not there yet
@@ -956,8 +1176,16 @@ void CGhostnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
             //LogPrint("ghostnode", "DSEG -- Sending Ghostnode entry: ghostnode=%s  addr=%s\n", mn.vin.prevout.ToStringShort(), mn.addr.ToString());
             CGhostnodeBroadcast mnb = CGhostnodeBroadcast(mn);
             uint256 hash = mnb.GetHash();
-            pfrom->PushInventory(CInv(MSG_GHOSTNODE_ANNOUNCE, hash));
-            pfrom->PushInventory(CInv(MSG_GHOSTNODE_PING, mn.lastPing.GetHash()));
+            if (fBatch) {
+                vecMnbBatch.push_back(mnb);
+                if (vecMnbBatch.size() == MNB_BATCH_MAX_ENTRIES) {
+                    g_connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNANNOUNCEBATCH, vecMnbBatch));
+                    vecMnbBatch.clear();
+                }
+            } else {
+                pfrom->PushInventory(CInv(MSG_GHOSTNODE_ANNOUNCE, hash));
+                pfrom->PushInventory(CInv(MSG_GHOSTNODE_PING, mn.lastPing.GetHash()));
+            }
             nInvCount++;
 
             if (!mapSeenGhostnodeBroadcast.count(hash)) {
@@ -971,7 +1199,9 @@ void CGhostnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
         }
 
         if(vin == CTxIn()) {
-            const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+            if (!vecMnbBatch.empty()) {
+                g_connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNANNOUNCEBATCH, vecMnbBatch));
+            }
             g_connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SYNCSTATUSCOUNT, GHOSTNODE_SYNC_LIST, nInvCount));
             //LogPrint("DSEG -- Sent %d Ghostnode invs to peer %d\n", nInvCount, pfrom->GetId());
             return;
@@ -1078,7 +1308,7 @@ void CGhostnodeMan::DoFullVerificationStep()
 
 bool CGhostnodeMan::CheckVerifyRequestAddr(const CAddress& addr, CConnman& connman)
 {
-    if(netfulfilledman.HasFulfilledRequest(addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request")) {
+    if(netfulfilledman.HasFulfilledRequest(addr, FULFILLED_MNVERIFY_REQUEST)) {
         // we already asked for verification, not a good idea to do this too often, skip it
         return false;
     }
@@ -1093,7 +1323,7 @@ void CGhostnodeMan::PrepareVerifyRequest(const CAddress& addr, CConnman& connman
         return;
     }
 
-    netfulfilledman.AddFulfilledRequest(addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request");
+    netfulfilledman.AddFulfilledRequest(addr, FULFILLED_MNVERIFY_REQUEST);
     CGhostnodeVerification mnv(addr, GetRandInt(999999), pCurrentBlockIndex->nHeight - 1);
     mWeAskedForVerification[addr] = mnv;
     const CNetMsgMaker msgMaker(pnode->GetSendVersion());
@@ -1108,49 +1338,33 @@ void CGhostnodeMan::DoFullVerificationStep()
     if(activeGhostnode.vin == CTxIn()) return;
     if(!ghostnodeSync.IsSynced()) return;
 
-    std::vector<std::pair<int, CGhostnode> > vecGhostnodeRanks = GetGhostnodeRanks(pCurrentBlockIndex->nHeight - 1, MIN_POSE_PROTO_VERSION);
+    uint256 blockHash;
+    if(!GetBlockHash(blockHash, pCurrentBlockIndex->nHeight - 1)) return;
 
     std::vector<CAddress> vAddr;
     {
     LOCK(cs);
 
-    int nMyRank = -1;
-
-    // send verify requests only if we are in top MAX_POSE_RANK
-    for (auto& rankPair : vecGhostnodeRanks) {
-        if(rankPair.first > MAX_POSE_RANK) {
-            return;
-        }
-        if(rankPair.second.vin == activeGhostnode.vin) {
-            nMyRank = rankPair.first;
-            break;
-        }
-    }
+    // the ranking is shared with the other rank lookups and only rebuilt when the
+    // ghostnode states change, only the ghostnodes to contact are looked at
+    const CGhostnodeRanking& ranking = GetRanking(blockHash, MIN_POSE_PROTO_VERSION, RANK_ACTIVE);
+    int nRanksTotal = (int)ranking.vecOutpoints.size();
 
+    // send verify requests only if we are in top MAX_POSE_RANK,
     // edge case: list is too short and this masternode is not enabled
-    if(nMyRank == -1) return;
+    auto itMyRank = ranking.mapRanks.find(activeGhostnode.vin.prevout);
+    if(itMyRank == ranking.mapRanks.end() || itMyRank->second > MAX_POSE_RANK) return;
 
     // send verify requests to up to MAX_POSE_CONNECTIONS masternodes
     // starting from MAX_POSE_RANK + nMyRank and using MAX_POSE_CONNECTIONS as a step
-    int nOffset = MAX_POSE_RANK + nMyRank - 1;
-    if(nOffset >= (int)vecGhostnodeRanks.size()) return;
-
-    auto it = vecGhostnodeRanks.begin() + nOffset;
-    while(it != vecGhostnodeRanks.end()) {
-        if(it->second.IsPoSeVerified() || it->second.IsPoSeBanned()) {
-            nOffset += MAX_POSE_CONNECTIONS;
-            if(nOffset >= (int)vecGhostnodeRanks.size()) break;
-            it += MAX_POSE_CONNECTIONS;
-            continue;
-        }
-        CAddress addr = CAddress(it->second.addr, NODE_NETWORK);
+    for (int nOffset = MAX_POSE_RANK + itMyRank->second - 1; nOffset < nRanksTotal; nOffset += MAX_POSE_CONNECTIONS) {
+        CGhostnode& mn = vGhostnodes[mapGhostnodeOutpoints.at(ranking.vecOutpoints[nOffset])];
+        if(mn.IsPoSeVerified() || mn.IsPoSeBanned()) continue;
+        CAddress addr = CAddress(mn.addr, NODE_NETWORK);
         if(CheckVerifyRequestAddr(addr, *g_connman.get())) {
             vAddr.push_back(addr);
             if((int)vAddr.size() >= MAX_POSE_CONNECTIONS) break;
         }
-        nOffset += MAX_POSE_CONNECTIONS;
-        if(nOffset >= (int)vecGhostnodeRanks.size()) break;
-        it += MAX_POSE_CONNECTIONS;
     }
     } // cs
 
@@ -1169,7 +1383,6 @@ void CGhostnodeMan::CheckSameAddr()
     if(!ghostnodeSync.IsSynced() || vGhostnodes.empty()) return;
 
     std::vector<CGhostnode*> vBan;
-    std::vector<CGhostnode*> vSortedByAddr;
 
     {
         LOCK(cs);
@@ -1177,13 +1390,13 @@ void CGhostnodeMan::CheckSameAddr()
         CGhostnode* pprevGhostnode = NULL;
         CGhostnode* pverifiedGhostnode = NULL;
 
-        BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
-            vSortedByAddr.push_back(&mn);
-        }
-
-        sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
-
-        BOOST_FOREACH(CGhostnode* pmn, vSortedByAddr) {
+        // walk the address index, skipping the addresses used by a single ghostnode
+        for (auto it = setGhostnodeAddrs.begin(); it != setGhostnodeAddrs.end(); ++it) {
+            auto itNext = std::next(it);
+            bool fShared = (itNext != setGhostnodeAddrs.end() && itNext->first == it->first) ||
+                           (it != setGhostnodeAddrs.begin() && std::prev(it)->first == it->first);
+            if (!fShared) continue;
+            CGhostnode* pmn = &vGhostnodes[mapGhostnodeOutpoints.at(it->second)];
             // check only (pre)enabled ghostnodes
             if(!pmn->IsEnabled() && !pmn->IsPreEnabled()) continue;
             // initial step
@@ -1219,7 +1432,7 @@ void CGhostnodeMan::CheckSameAddr()
 
 bool CGhostnodeMan::SendVerifyRequest(const CAddress& addr, const std::vector<CGhostnode*>& vSortedByAddr)
 {
-    if(netfulfilledman.HasFulfilledRequest(addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request")) {
+    if(netfulfilledman.HasFulfilledRequest(addr, FULFILLED_MNVERIFY_REQUEST)) {
         // we already asked for verification, not a good idea to do this too often, skip it
         //LogPrint("ghostnode", "CGhostnodeMan::SendVerifyRequest -- too many requests, skipping... addr=%s\n", addr.ToString());
         return false;
@@ -1231,7 +1444,7 @@ bool CGhostnodeMan::SendVerifyRequest(const CAddress& addr, const std::vector<CG
         return false;
     }
 
-    netfulfilledman.AddFulfilledRequest(addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request");
+    netfulfilledman.AddFulfilledRequest(addr, FULFILLED_MNVERIFY_REQUEST);
     // use random nonce, store it and require node to reply with correct one later
     CGhostnodeVerification mnv(addr, GetRandInt(999999), pCurrentBlockIndex->nHeight - 1);
     mWeAskedForVerification[addr] = mnv;
@@ -1252,7 +1465,7 @@ void CGhostnodeMan::SendVerifyReply(CNode* pnode, CGhostnodeVerification& mnv)
         return;
     }
 
-    if(netfulfilledman.HasFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-reply")) {
+    if(netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_REPLY)) {
 //        // peer should not ask us that often
         //LogPrint("GhostnodeMan::SendVerifyReply -- ERROR: peer already asked me recently, peer=%d\n", pnode->GetId());
         Misbehaving(pnode->GetId(), 20);
@@ -1281,7 +1494,7 @@ void CGhostnodeMan::SendVerifyReply(CNode* pnode, CGhostnodeVerification& mnv)
 
     const CNetMsgMaker msgMaker(pnode->GetSendVersion());
     g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::MNVERIFY, mnv));
-    netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-reply");
+    netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_REPLY);
 }
 
 void CGhostnodeMan::ProcessVerifyReply(CNode* pnode, CGhostnodeVerification& mnv)
@@ -1289,7 +1502,7 @@ void CGhostnodeMan::ProcessVerifyReply(CNode* pnode, CGhostnodeVerification& mnv
     std::string strError;
 
     // did we even ask for it? if that's the case we should have matching fulfilled request
-    if(!netfulfilledman.HasFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request")) {
+    if(!netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_REQUEST)) {
         //LogPrint("CGhostnodeMan::ProcessVerifyReply -- ERROR: we didn't ask for verification of %s, peer=%d\n", pnode->addr.ToString(), pnode->GetId());
         Misbehaving(pnode->GetId(), 20);
         return;
@@ -1319,7 +1532,7 @@ void CGhostnodeMan::ProcessVerifyReply(CNode* pnode, CGhostnodeVerification& mnv
     }
 
 //    // we already verified this address, why node is spamming?
-    if(netfulfilledman.HasFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done")) {
+    if(netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_DONE)) {
         //LogPrint("CGhostnodeMan::ProcessVerifyReply -- ERROR: already verified %s recently\n", pnode->addr.ToString());
         Misbehaving(pnode->GetId(), 20);
         return;
@@ -1340,7 +1553,7 @@ void CGhostnodeMan::ProcessVerifyReply(CNode* pnode, CGhostnodeVerification& mnv
                     if(!it->IsPoSeVerified()) {
                         it->DecreasePoSeBanScore();
                     }
-                    netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
+                    netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_DONE);
 
                     // we can only broadcast it if we are an activated ghostnode
                     if(activeGhostnode.vin == CTxIn()) continue;
@@ -1510,6 +1723,48 @@ std::string CGhostnodeMan::ToString() const
     return info.str();
 }
 
+size_t CGhostnodeMan::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    size_t nUsage = memusage::DynamicUsage(vGhostnodes);
+    for (const CGhostnode& mn : vGhostnodes)
+        nUsage += mn.DynamicMemoryUsage();
+    nUsage += memusage::DynamicUsage(mapGhostnodeOutpoints) + memusage::DynamicUsage(mapGhostnodePubKeys) +
+              memusage::DynamicUsage(mapGhostnodePayees);
+    nUsage += memusage::DynamicUsage(setLastPaidQueue) + memusage::DynamicUsage(setGhostnodeAddrs);
+    nUsage += indexGhostnodes.DynamicMemoryUsage() + indexGhostnodesOld.DynamicMemoryUsage();
+
+    nUsage += memusage::DynamicUsage(mAskedUsForGhostnodeList) + memusage::DynamicUsage(mWeAskedForGhostnodeList) +
+              memusage::DynamicUsageWithValues(mWeAskedForGhostnodeListEntry) + memusage::DynamicUsage(mWeAskedForVerification);
+    nUsage += memusage::DynamicUsage(mMnbRecoveryRequests);
+    for (const auto& request : mMnbRecoveryRequests)
+        nUsage += memusage::DynamicUsage(request.second.second);
+    nUsage += memusage::DynamicUsage(mMnbRecoveryGoodReplies);
+    for (const auto& replies : mMnbRecoveryGoodReplies) {
+        nUsage += memusage::DynamicUsage(replies.second);
+        for (const CGhostnodeBroadcast& mnb : replies.second)
+            nUsage += mnb.DynamicMemoryUsage();
+    }
+    nUsage += memusage::DynamicUsage(listScheduledMnbRequestConnections);
+
+    nUsage += memusage::DynamicUsage(listRankCache) + memusage::DynamicUsage(mapRankCache);
+    for (const auto& ranking : listRankCache)
+        nUsage += memusage::DynamicUsage(ranking.second.vecOutpoints) + memusage::DynamicUsage(ranking.second.mapRanks);
+
+    if (pGhostFeePayees) {
+        nUsage += memusage::DynamicUsage(pGhostFeePayees) + memusage::DynamicUsage(*pGhostFeePayees);
+        for (const CScript& payee : *pGhostFeePayees)
+            nUsage += RecursiveDynamicUsage(payee);
+    }
+    // the list RPCs may still hold an older copy, only the current one is counted
+    if (pListSnapshot) {
+        nUsage += memusage::DynamicUsage(pListSnapshot) + memusage::DynamicUsage(*pListSnapshot);
+        for (const CGhostnode& mn : *pListSnapshot)
+            nUsage += mn.DynamicMemoryUsage();
+    }
+    return nUsage;
+}
+
 void CGhostnodeMan::UpdateGhostnodeList(CGhostnodeBroadcast mnb)
 {
     try {
@@ -1528,9 +1783,16 @@ void CGhostnodeMan::UpdateGhostnodeList(CGhostnodeBroadcast mnb)
             }
         } else {
             CGhostnodeBroadcast mnbOld = mapSeenGhostnodeBroadcast[CGhostnodeBroadcast(*pmn).GetHash()].second;
+            CPubKey pubKeyGhostnodeOld = pmn->pubKeyGhostnode;
+            CService addrOld = pmn->addr;
             if (pmn->UpdateFromNewBroadcast(mnb)) {
                 ghostnodeSync.AddedGhostnodeList();
                 mapSeenGhostnodeBroadcast.erase(mnbOld.GetHash());
+                if (pmn->pubKeyGhostnode != pubKeyGhostnodeOld) {
+                    RebuildLookupIndexes();
+                } else {
+                    UpdateAddrIndex(*pmn, addrOld);
+                }
             }
         }
     } catch (const std::exception &e) {
@@ -1538,6 +1800,14 @@ void CGhostnodeMan::UpdateGhostnodeList(CGhostnodeBroadcast mnb)
     }
 }
 
+void CGhostnodeMan::UpdateGhostnodeList(const std::vector<CGhostnodeBroadcast>& vecMnb)
+{
+    LOCK2(cs_main, cs);
+    for (const CGhostnodeBroadcast& mnb : vecMnb) {
+        UpdateGhostnodeList(mnb);
+    }
+}
+
 bool CGhostnodeMan::CheckMnbAndUpdateGhostnodeList(CNode* pfrom, CGhostnodeBroadcast mnb, int& nDos)
 {
     // Need LOCK2 here to ensure consistent locking order because the SimpleCheck call below locks cs_main
@@ -1580,6 +1850,7 @@ bool CGhostnodeMan::CheckMnbAndUpdateGhostnodeList(CNode* pfrom, CGhostnodeBroad
             }
             return true;
         }
+        LimitSeenMaps();
         mapSeenGhostnodeBroadcast.insert(std::make_pair(hash, std::make_pair(GetTime(), mnb)));
 
        // LogPrintf("CGhostnodeMan::CheckMnbAndUpdateGhostnodeList -- ghostnode=%s new\n", mnb.vin.prevout.ToStringShort());
@@ -1593,7 +1864,15 @@ bool CGhostnodeMan::CheckMnbAndUpdateGhostnodeList(CNode* pfrom, CGhostnodeBroad
         CGhostnode *pmn = Find(mnb.vin);
         if (pmn) {
             CGhostnodeBroadcast mnbOld = mapSeenGhostnodeBroadcast[CGhostnodeBroadcast(*pmn).GetHash()].second;
-            if (!mnb.Update(pmn, nDos)) {
+            CPubKey pubKeyGhostnodeOld = pmn->pubKeyGhostnode;
+            CService addrOld = pmn->addr;
+            bool fUpdated = mnb.Update(pmn, nDos);
+            if (pmn->pubKeyGhostnode != pubKeyGhostnodeOld) {
+                RebuildLookupIndexes();
+            } else {
+                UpdateAddrIndex(*pmn, addrOld);
+            }
+            if (!fUpdated) {
                 //LogPrintf("CGhostnodeMan::CheckMnbAndUpdateGhostnodeList -- Update() failed, ghostnode=%s\n", mnb.vin.prevout.ToStringShort());
                 return false;
             }
@@ -1648,7 +1927,13 @@ void CGhostnodeMan::UpdateLastPaid()
                             // pCurrentBlockIndex->nHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
 
     BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
+        int nBlockLastPaidOld = mn.GetLastPaidBlock();
         mn.UpdateLastPaid(pCurrentBlockIndex, nMaxBlocksToScanBack);
+        if (mn.GetLastPaidBlock() != nBlockLastPaidOld) {
+            // move it in the payment queue
+            setLastPaidQueue.erase(std::make_pair(nBlockLastPaidOld, mn.vin.prevout));
+            setLastPaidQueue.insert(std::make_pair(mn.GetLastPaidBlock(), mn.vin.prevout));
+        }
     }
 
     // every time is like the first time if winners list is not synced
@@ -1757,6 +2042,7 @@ void CGhostnodeMan::SetGhostnodeLastPing(const CTxIn& vin, const CGhostnodePing&
         return;
     }
     pMN->lastPing = mnp;
+    NotifyGhostnodeListChanged();
     mapSeenGhostnodePing.insert(std::make_pair(mnp.GetHash(), mnp));
 
     CGhostnodeBroadcast mnb(*pMN);
@@ -1779,6 +2065,25 @@ void CGhostnodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
     }
 }
 
+void CGhostnodeMan::CheckSpentCollaterals(const CBlock& block)
+{
+    LOCK(cs);
+    if(mapGhostnodeOutpoints.empty()) return;
+
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase()) continue;
+        for (const auto& txin : tx->vin) {
+            auto it = mapGhostnodeOutpoints.find(txin.prevout);
+            if (it == mapGhostnodeOutpoints.end()) continue;
+            CGhostnode& mn = vGhostnodes[it->second];
+            if (mn.IsOutpointSpent()) continue;
+            //LogPrint("ghostnode", "CGhostnodeMan::CheckSpentCollaterals -- ghostnode=%s collateral spent\n", txin.prevout.ToStringShort());
+            mn.SetOutpointSpent();
+            NotifyGhostnodeStateChanged();
+        }
+    }
+}
+
 void CGhostnodeMan::NotifyGhostnodeUpdates()
 {
     // Avoid double locking
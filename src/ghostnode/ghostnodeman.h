@@ -7,14 +7,25 @@
 #define GHOSTNODEMAN_H
 
 #include "ghostnode.h"
+#include "memusage.h"
 #include "sync.h"
 
+#include <atomic>
+#include <list>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+
 using namespace std;
 
 class CGhostnodeMan;
 
 extern CGhostnodeMan mnodeman;
 
+//! -maxghostnodeseenmem default, megabytes of ghostnode broadcasts and pings remembered as seen
+static const unsigned int DEFAULT_MAX_GHOSTNODE_SEEN_MEMORY = 32;
+
 /**
  * Provides a forward and reverse index between MN vin's and integers.
  *
@@ -53,6 +64,10 @@ public:
         return nSize;
     }
 
+    size_t DynamicMemoryUsage() const {
+        return memusage::DynamicUsage(mapIndex) + memusage::DynamicUsage(mapReverseIndex);
+    }
+
     /// Retrieve ghostnode vin by index
     bool Get(int nIndex, CTxIn& vinGhostnode) const;
 
@@ -79,6 +94,12 @@ private:
 
 };
 
+/** Hasher for the uint160 keys (key ids, script ids) of the ghostnode lookup indexes */
+struct CGhostnodeKeyHasher
+{
+    size_t operator()(const uint160& hash) const { return ReadLE64(hash.begin()); }
+};
+
 class CGhostnodeMan
 {
 public:
@@ -98,6 +119,8 @@ private:
 
     static const int DSEG_UPDATE_SECONDS        = 3 * 60 * 60;
 
+    static const size_t MNB_BATCH_MAX_ENTRIES   = 1000;
+
     static const int LAST_PAID_SCAN_BLOCKS      = 100;
 
     static const int MIN_POSE_PROTO_VERSION     = 70203;
@@ -111,12 +134,39 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    static const size_t RANK_CACHE_SIZE             = 32;
+
+    /// Which ghostnodes take part in a ranking
+    enum RankFilter {
+        RANK_ALL,           // any ghostnode
+        RANK_ACTIVE,        // enabled ghostnodes
+        RANK_PAYABLE,       // ghostnodes valid for payment
+    };
+
+    /// Ghostnode outpoints sorted by score for one block, ranks start at 1
+    struct CGhostnodeRanking
+    {
+        std::vector<COutPoint> vecOutpoints;
+        std::unordered_map<COutPoint, int, SaltedOutpointHasher> mapRanks;
+    };
+
+    typedef std::tuple<uint256, int, RankFilter> rank_cache_key_t;
+    typedef std::list<std::pair<rank_cache_key_t, CGhostnodeRanking> > rank_cache_list_t;
+
 
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
     // map to hold all MNs
     std::vector<CGhostnode> vGhostnodes;
+    // positions in vGhostnodes by collateral outpoint, ghostnode key id and payee script id
+    std::unordered_map<COutPoint, size_t, SaltedOutpointHasher> mapGhostnodeOutpoints;
+    std::unordered_map<CKeyID, size_t, CGhostnodeKeyHasher> mapGhostnodePubKeys;
+    std::unordered_map<CScriptID, size_t, CGhostnodeKeyHasher> mapGhostnodePayees;
+    // payment queue, ghostnode outpoints ordered by last paid block (oldest first), then by outpoint
+    std::set<std::pair<int, COutPoint> > setLastPaidQueue;
+    // ghostnode outpoints ordered by address, ghostnodes sharing an address are adjacent
+    std::set<std::pair<CService, COutPoint> > setGhostnodeAddrs;
     // who's asked for the Ghostnode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForGhostnodeList;
     // who we asked for the Ghostnode list and the last time
@@ -150,8 +200,46 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    // Collateral scripts of the ghostnodes paid the ghost fees of the distribution cycle
+    // requiring them to be active before nGhostFeePayeesActiveBefore
+    std::shared_ptr<const std::vector<CScript> > pGhostFeePayees;
+    int64_t nGhostFeePayeesActiveBefore;
+    // pGhostFeePayees is only valid for the version of the ghostnode states it was built from
+    int nGhostFeePayeesStateVersion;
+    std::atomic<int> nGhostnodeStateVersion;
+
+    // LRU of rankings by (block hash, min protocol, filter), most recently used first;
+    // only valid for the version of the ghostnode states it was built from
+    rank_cache_list_t listRankCache;
+    std::map<rank_cache_key_t, rank_cache_list_t::iterator> mapRankCache;
+    int nRankCacheStateVersion;
+
+    // Copy of vGhostnodes handed out to the list RPCs, replaced when anything they show changes
+    std::shared_ptr<const std::vector<CGhostnode> > pListSnapshot;
+    int nListSnapshotVersion;
+    std::atomic<int> nGhostnodeListVersion;
+
+    // budget of the seen broadcasts and pings in bytes, 0 for none; once over it the oldest
+    // tenth of both maps is forgotten
+    size_t nMaxSeenMemory;
+    std::atomic<uint64_t> nSeenBroadcastsEvicted;
+    std::atomic<uint64_t> nSeenPingsEvicted;
+
     friend class CGhostnodeSync;
 
+    /// Index vGhostnodes[nPos] in the lookup maps, an earlier entry with the same key wins
+    void IndexGhostnode(size_t nPos);
+    /// Rebuild the lookup maps from scratch, required whenever vGhostnodes is reordered or a key changes
+    void RebuildLookupIndexes();
+    /// Move a ghostnode whose address was changed by a new broadcast in the address index
+    void UpdateAddrIndex(const CGhostnode& mn, const CService& addrOld);
+
+    /// Ranking of the ghostnodes for blockHash, from the rank cache if the ghostnode states haven't changed
+    const CGhostnodeRanking& GetRanking(const uint256& blockHash, int nMinProtocol, RankFilter filter);
+
+    /// Forget the oldest seen broadcasts and pings if there is no room for another within nMaxSeenMemory
+    void LimitSeenMaps();
+
 public:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -194,6 +282,10 @@ public:
         if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
             Clear();
         }
+        if(ser_action.ForRead()) {
+            RebuildLookupIndexes();
+            NotifyGhostnodeStateChanged();
+        }
     }
 
     CGhostnodeMan();
@@ -284,9 +376,17 @@ public:
 
     ghostnode_info_t GetGhostnodeInfo(const CPubKey& pubKeyGhostnode);
 
-    char* GetNotQualifyReason(CGhostnode& mn, int nBlockHeight, bool fFilterSigTime, int nMnCount);
+    /// Info of each of the given ghostnodes from one snapshot of the list, fInfoValid is false for those not in it
+    std::vector<ghostnode_info_t> GetGhostnodeInfos(const std::vector<CTxIn>& vecVin);
+
+    /// Check whether mn may be paid at nBlockHeight, the reason it can't is put in pstrReason if given
+    bool IsQualifiedForPayment(CGhostnode& mn, int nBlockHeight, bool fFilterSigTime, int nMnCount, std::string* pstrReason = NULL);
+    /// Count the ghostnodes that may be paid at nBlockHeight
+    int CountQualifiedForPayment(int nBlockHeight, bool fFilterSigTime);
 
-    /// Find an entry in the ghostnode list that is next to be paid
+    /// Find an entry in the ghostnode list that is next to be paid.
+    /// Only walks the payment queue until the oldest tenth is found, so nCount is the number of
+    /// qualified ghostnodes seen, use CountQualifiedForPayment() for the total
     CGhostnode* GetNextGhostnodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCount);
     /// Same as above but use current block height
     CGhostnode* GetNextGhostnodeInQueueForPayment(bool fFilterSigTime, int& nCount);
@@ -294,7 +394,20 @@ public:
     /// Find a random entry
     CGhostnode* FindRandomNotInVec(const std::vector<CTxIn> &vecToExclude, int nProtocolVersion = -1);
 
-    std::vector<CGhostnode> GetFullGhostnodeVector() { return vGhostnodes; }
+    std::vector<CGhostnode> GetFullGhostnodeVector() { LOCK(cs); return vGhostnodes; }
+    /// Immutable copy of the ghostnode list, shared by all callers until the list changes.
+    /// Prefer it over GetFullGhostnodeVector() for read only listings
+    std::shared_ptr<const std::vector<CGhostnode> > GetGhostnodeListSnapshot();
+
+    /// Collateral scripts of the enabled ghostnodes active before nActiveBefore, in list order.
+    /// Built once per ghost fee distribution cycle and kept until the ghostnode states change
+    std::shared_ptr<const std::vector<CScript> > GetGhostFeePayees(int64_t nActiveBefore);
+    /// Called whenever a ghostnode is added, removed, updated or enabled/disabled
+    void NotifyGhostnodeStateChanged() { nGhostnodeStateVersion++; nGhostnodeListVersion++; }
+    /// Called when a ghostnode field shown by the list changes without affecting payments (ping, status, last paid)
+    void NotifyGhostnodeListChanged() { nGhostnodeListVersion++; }
+    /// Changes whenever NotifyGhostnodeStateChanged() is called
+    int GetStateVersion() const { return nGhostnodeStateVersion; }
 
     std::vector<std::pair<int, CGhostnode> > GetGhostnodeRanks(int nBlockHeight = -1, int nMinProtocol=0);
     int GetGhostnodeRank(const CTxIn &vin, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
@@ -304,6 +417,9 @@ public:
     std::pair<CService, std::set<uint256> > PopScheduledMnbRequestConnection();
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
+    /// Handle a ghostnode broadcast or ping received alone or as part of a batch
+    void ProcessBroadcast(CNode* pfrom, CGhostnodeBroadcast& mnb);
+    void ProcessPing(CNode* pfrom, CGhostnodePing& mnp);
 
     void DoFullVerificationStep();
     void CheckSameAddr();
@@ -319,8 +435,22 @@ public:
 
     std::string ToString() const;
 
+    /// CGhostnode::CalculateScore of every ghostnode for blockHash, with the block hashed once and
+    /// the ghostnodes hashed several at a time
+    static std::vector<arith_uint256> CalculateScores(const uint256& blockHash, const std::vector<CGhostnode*>& vecGhostnodesIn);
+
+    /// Heap memory of the ghostnode list, its indexes and the sync and ranking caches
+    size_t DynamicMemoryUsage() const;
+
+    void SetMaxSeenMemory(size_t nBytes) { nMaxSeenMemory = nBytes; }
+    /// Seen broadcasts and pings forgotten to stay within the memory budget
+    uint64_t GetSeenBroadcastsEvicted() const { return nSeenBroadcastsEvicted; }
+    uint64_t GetSeenPingsEvicted() const { return nSeenPingsEvicted; }
+
     /// Update ghostnode list and maps using provided CGhostnodeBroadcast
     void UpdateGhostnodeList(CGhostnodeBroadcast mnb);
+    /// Same for a batch of broadcasts, all under one lock
+    void UpdateGhostnodeList(const std::vector<CGhostnodeBroadcast>& vecMnb);
     /// Perform complete check and only then update list and maps
     bool CheckMnbAndUpdateGhostnodeList(CNode* pfrom, CGhostnodeBroadcast mnb, int& nDos);
     bool IsMnbRecoveryRequested(const uint256& hash) { return mMnbRecoveryRequests.count(hash); }
@@ -358,6 +488,10 @@ public:
     void SetGhostnodeLastPing(const CTxIn& vin, const CGhostnodePing& mnp);
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
+    int GetCachedBlockHeight() const { return pCurrentBlockIndex ? pCurrentBlockIndex->nHeight : 0; }
+
+    /// Mark ghostnodes whose collateral is spent by a newly connected block
+    void CheckSpentCollaterals(const CBlock& block);
 
     /**
      * Called to notify CGovernanceManager that the ghostnode index has been updated.
@@ -7,6 +7,7 @@
 #include "darksend.h"
 #include "instantx.h"
 #include "key.h"
+#include "lifecycle.h"
 #include "validation.h"
 #include "ghostnode-sync.h"
 #include "ghostnodeman.h"
@@ -17,14 +18,19 @@
 #include "txmempool.h"
 #include "util.h"
 #include "consensus/validation.h"
+#include "core_memusage.h"
+#include "validationinterface.h"
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 extern CWallet* pwalletMain;
 extern CTxMemPool mempool;
 
 bool fEnableInstantSend = true;
+
+static const char DB_TXLOCK = 'l';
 int nInstantSendDepth = DEFAULT_INSTANTSEND_DEPTH;
 int nCompleteTXLocks;
 
@@ -80,7 +86,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest)
     // Check to see if we conflict with existing completed lock,
     // fail if so, there can't be 2 completed locks for the same outpoint
     BOOST_FOREACH(const CTxIn& txin, txLockRequest.vin) {
-        std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(txin.prevout);
+        locked_outpoint_map_t::iterator it = mapLockedOutpoints.find(txin.prevout);
         if(it != mapLockedOutpoints.end()) {
             // Conflicting with complete lock, ignore this one
             // (this could be the one we have but we don't want to try to lock it twice anyway)
@@ -93,7 +99,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest)
     // Check to see if there are votes for conflicting request,
     // if so - do not fail, just warn user
     BOOST_FOREACH(const CTxIn& txin, txLockRequest.vin) {
-        std::map<COutPoint, std::set<uint256> >::iterator it = mapVotedOutpoints.find(txin.prevout);
+        voted_outpoint_map_t::iterator it = mapVotedOutpoints.find(txin.prevout);
         if(it != mapVotedOutpoints.end()) {
             BOOST_FOREACH(const uint256& hash, it->second) {
                 if(hash != txLockRequest.GetHash()) {
@@ -111,10 +117,10 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest)
     }
     //LogPrint("CInstantSend::ProcessTxLockRequest -- accepted, txid=%s\n", txHash.ToString());
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    tx_lock_candidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     CTxLockCandidate& txLockCandidate = itLockCandidate->second;
     Vote(txLockCandidate);
-    ProcessOrphanTxLockVotes();
+    ProcessOrphanTxLockVotes(txHash);
 
     // Ghostnodes will sometimes propagate votes before the transaction is known to the client.
     // If this just happened - lock inputs, resolve conflicting locks, update transaction status
@@ -133,7 +139,7 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    tx_lock_candidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate == mapTxLockCandidates.end()) {
         //LogPrint("CInstantSend::CreateTxLockCandidate -- new, txid=%s\n", txHash.ToString());
 
@@ -187,14 +193,14 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
 
         //LogPrint("instantsend", "CInstantSend::Vote -- In the top %d (%d)\n", nSignaturesTotal, n);
 
-        std::map<COutPoint, std::set<uint256> >::iterator itVoted = mapVotedOutpoints.find(itOutpointLock->first);
+        voted_outpoint_map_t::iterator itVoted = mapVotedOutpoints.find(itOutpointLock->first);
 
         // Check to see if we already voted for this outpoint,
         // refuse to vote twice or to include the same outpoint in another tx
         bool fAlreadyVoted = false;
         if(itVoted != mapVotedOutpoints.end()) {
             BOOST_FOREACH(const uint256& hash, itVoted->second) {
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                tx_lock_candidate_map_t::iterator it2 = mapTxLockCandidates.find(hash);
                 if(it2->second.HasGhostnodeVoted(itOutpointLock->first, activeGhostnode.vin.prevout)) {
                     // we already voted for this outpoint to be included either in the same tx or in a competing one,
                     // skip it anyway
@@ -265,10 +271,10 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
     // Ghostnodes will sometimes propagate votes before the transaction is known to the client,
     // will actually process only after the lock request itself has arrived
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    tx_lock_candidate_map_t::iterator it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end()) {
         if(!mapTxLockVotesOrphan.count(vote.GetHash())) {
-            mapTxLockVotesOrphan[vote.GetHash()] = vote;
+            AddOrphanTxLockVote(vote);
             //LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Orphan vote: txid=%s  ghostnode=%s new\n",
                 //    txHash.ToString(), vote.GetGhostnodeOutpoint().ToStringShort());
             bool fReprocess = true;
@@ -296,32 +302,31 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
         // TODO: make sure this works good enough for multi-quorum
 
         int nGhostnodeOrphanExpireTime = GetTime() + 60*10; // keep time data for 10 minutes
-        if(!mapGhostnodeOrphanVotes.count(vote.GetGhostnodeOutpoint())) {
-            mapGhostnodeOrphanVotes[vote.GetGhostnodeOutpoint()] = nGhostnodeOrphanExpireTime;
-        } else {
-            int64_t nPrevOrphanVote = mapGhostnodeOrphanVotes[vote.GetGhostnodeOutpoint()];
+        orphan_vote_time_map_t::iterator itOrphanTime = mapGhostnodeOrphanVotes.find(vote.GetGhostnodeOutpoint());
+        if(itOrphanTime != mapGhostnodeOrphanVotes.end()) {
+            int64_t nPrevOrphanVote = itOrphanTime->second;
             if(nPrevOrphanVote > GetTime() && nPrevOrphanVote > GetAverageGhostnodeOrphanVoteTime()) {
                 //LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- ghostnode is spamming orphan Transaction Lock Votes: txid=%s  ghostnode=%s\n",
                     //    txHash.ToString(), vote.GetGhostnodeOutpoint().ToStringShort());
                 // Misbehaving(pfrom->id, 1);
                 return false;
             }
-            // not spamming, refresh
-            mapGhostnodeOrphanVotes[vote.GetGhostnodeOutpoint()] = nGhostnodeOrphanExpireTime;
         }
+        // new or not spamming, refresh
+        SetGhostnodeOrphanVoteTime(vote.GetGhostnodeOutpoint(), nGhostnodeOrphanExpireTime);
 
         return true;
     }
 
     //LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Transaction Lock Vote, txid=%s\n", txHash.ToString());
 
-    std::map<COutPoint, std::set<uint256> >::iterator it1 = mapVotedOutpoints.find(vote.GetOutpoint());
+    voted_outpoint_map_t::iterator it1 = mapVotedOutpoints.find(vote.GetOutpoint());
     if(it1 != mapVotedOutpoints.end()) {
         BOOST_FOREACH(const uint256& hash, it1->second) {
             if(hash != txHash) {
                 // same outpoint was already voted to be locked by another tx lock request,
                 // find out if the same mn voted on this outpoint before
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                tx_lock_candidate_map_t::iterator it2 = mapTxLockCandidates.find(hash);
                 if(it2->second.HasGhostnodeVoted(vote.GetOutpoint(), vote.GetGhostnodeOutpoint())) {
                     // yes, it did, refuse to accept a vote to include the same outpoint in another tx
                     // from the same ghostnode.
@@ -361,19 +366,75 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
     return true;
 }
 
-void CInstantSend::ProcessOrphanTxLockVotes()
+void CInstantSend::ProcessOrphanTxLockVotes(const uint256& txHash)
 {
     LOCK2(cs_main, cs_instantsend);
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while(it != mapTxLockVotesOrphan.end()) {
-        if(ProcessTxLockVote(NULL, it->second)) {
-            mapTxLockVotesOrphan.erase(it++);
-        } else {
-            ++it;
+    tx_hash_set_map_t::iterator itByTx = mapTxLockVotesOrphanByTx.find(txHash);
+    if(itByTx == mapTxLockVotesOrphanByTx.end()) return;
+
+    // copy, processed votes are removed from the index below
+    std::set<uint256> setVoteHashes = itByTx->second;
+    BOOST_FOREACH(const uint256& nVoteHash, setVoteHashes) {
+        tx_lock_vote_map_t::iterator it = mapTxLockVotesOrphan.find(nVoteHash);
+        if(it != mapTxLockVotesOrphan.end() && ProcessTxLockVote(NULL, it->second)) {
+            EraseOrphanTxLockVote(nVoteHash);
         }
     }
 }
 
+/** Approximate heap memory of an orphan vote: its map node, the signature and its hash in the by-tx set and expiry bucket */
+static size_t OrphanVoteUsage()
+{
+    return memusage::MallocUsage(sizeof(memusage::unordered_node<std::pair<const uint256, CTxLockVote> >)) + sizeof(void*) +
+           memusage::MallocUsage(CPubKey::COMPACT_SIGNATURE_SIZE) + memusage::MallocUsage(sizeof(memusage::stl_tree_node<uint256>)) +
+           sizeof(uint256);
+}
+
+void CInstantSend::AddOrphanTxLockVote(const CTxLockVote& vote)
+{
+    if(nMaxOrphanMemory != 0) {
+        size_t nMaxVotes = nMaxOrphanMemory / OrphanVoteUsage();
+        std::map<int64_t, std::vector<uint256> >::iterator itOrphanExpiry = mapOrphanVoteExpiry.begin();
+        while(mapTxLockVotesOrphan.size() >= nMaxVotes && itOrphanExpiry != mapOrphanVoteExpiry.end()) {
+            BOOST_FOREACH(const uint256& nVoteHash, itOrphanExpiry->second) {
+                if(!mapTxLockVotesOrphan.count(nVoteHash)) continue;
+                mapTxLockVotes.erase(nVoteHash);
+                EraseOrphanTxLockVote(nVoteHash);
+                ++nOrphanVotesEvicted;
+            }
+            mapOrphanVoteExpiry.erase(itOrphanExpiry++);
+        }
+    }
+
+    uint256 nVoteHash = vote.GetHash();
+    mapTxLockVotesOrphan[nVoteHash] = vote;
+    mapTxLockVotesOrphanByTx[vote.GetTxHash()].insert(nVoteHash);
+    mapOrphanVoteExpiry[vote.GetTimeCreated() + ORPHAN_VOTE_SECONDS].push_back(nVoteHash);
+}
+
+void CInstantSend::EraseOrphanTxLockVote(const uint256& nVoteHash)
+{
+    tx_lock_vote_map_t::iterator it = mapTxLockVotesOrphan.find(nVoteHash);
+    if(it == mapTxLockVotesOrphan.end()) return;
+
+    tx_hash_set_map_t::iterator itByTx = mapTxLockVotesOrphanByTx.find(it->second.GetTxHash());
+    if(itByTx != mapTxLockVotesOrphanByTx.end()) {
+        itByTx->second.erase(nVoteHash);
+        if(itByTx->second.empty()) mapTxLockVotesOrphanByTx.erase(itByTx);
+    }
+    mapTxLockVotesOrphan.erase(it);
+}
+
+void CInstantSend::SetGhostnodeOrphanVoteTime(const COutPoint& outpointGhostnode, int64_t nTime)
+{
+    std::pair<orphan_vote_time_map_t::iterator, bool> ret = mapGhostnodeOrphanVotes.insert(std::make_pair(outpointGhostnode, nTime));
+    if(!ret.second) {
+        nGhostnodeOrphanVoteTimeTotal -= ret.first->second;
+        ret.first->second = nTime;
+    }
+    nGhostnodeOrphanVoteTimeTotal += nTime;
+}
+
 bool CInstantSend::IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest)
 {
     // There could be a situation when we already have quite a lot of votes
@@ -391,16 +452,18 @@ bool CInstantSend::IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, co
 {
     // Scan orphan votes to check if this outpoint has enough orphan votes to be locked in some tx.
     LOCK2(cs_main, cs_instantsend);
+    tx_hash_set_map_t::iterator itByTx = mapTxLockVotesOrphanByTx.find(txHash);
+    if(itByTx == mapTxLockVotesOrphanByTx.end()) return false;
+
     int nCountVotes = 0;
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while(it != mapTxLockVotesOrphan.end()) {
-        if(it->second.GetTxHash() == txHash && it->second.GetOutpoint() == outpoint) {
+    BOOST_FOREACH(const uint256& nVoteHash, itByTx->second) {
+        tx_lock_vote_map_t::iterator it = mapTxLockVotesOrphan.find(nVoteHash);
+        if(it != mapTxLockVotesOrphan.end() && it->second.GetOutpoint() == outpoint) {
             nCountVotes++;
             if(nCountVotes >= COutPointLock::SIGNATURES_REQUIRED) {
                 return true;
             }
         }
-        ++it;
     }
     return false;
 }
@@ -415,7 +478,15 @@ void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCand
         //LogPrint("instantsend", "CInstantSend::TryToFinalizeLockCandidate -- Transaction Lock is ready to complete, txid=%s\n", txHash.ToString());
         if(ResolveConflicts(txLockCandidate, Params().GetConsensus().nInstantSendKeepLock)) {
             LockTransactionInputs(txLockCandidate);
+            WriteTxLock(txLockCandidate);
             UpdateLockedTransaction(txLockCandidate);
+            TraceLifecycle(LifecycleObject::TX, txHash, LifecycleStage::INSTANTSEND_LOCKED);
+
+            int64_t nLatency = GetTimeMicros() - txLockCandidate.GetTimeCreated();
+            nLockLatencyCount++;
+            nLockLatencyTotal += nLatency;
+            LogPrint(BCLog::BENCH, "CInstantSend::TryToFinalizeLockCandidate -- txid=%s locked in %.2fms [%.2fms avg over %d locks]\n",
+                     txHash.ToString(), nLatency * 0.001, nLockLatencyTotal * 0.001 / nLockLatencyCount, nLockLatencyCount);
         }
     }
 }
@@ -444,7 +515,7 @@ void CInstantSend::UpdateLockedTransaction(const CTxLockCandidate& txLockCandida
     }
 #endif
 
-//    GetMainSignals().NotifyTransactionLock(txLockCandidate.txLockRequest);
+    GetMainSignals().NotifyTransactionLock(MakeTransactionRef(txLockCandidate.txLockRequest));
 
     //LogPrint("instantsend", "CInstantSend::UpdateLockedTransaction -- done, txid=%s\n", txHash.ToString());
 }
@@ -469,7 +540,7 @@ void CInstantSend::LockTransactionInputs(const CTxLockCandidate& txLockCandidate
 bool CInstantSend::GetLockedOutPointTxHash(const COutPoint& outpoint, uint256& hashRet)
 {
     LOCK(cs_instantsend);
-    std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(outpoint);
+    locked_outpoint_map_t::iterator it = mapLockedOutpoints.find(outpoint);
     if(it == mapLockedOutpoints.end()) return false;
     hashRet = it->second;
     return true;
@@ -491,8 +562,8 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate, int
         if(GetLockedOutPointTxHash(txin.prevout, hashConflicting) && txHash != hashConflicting) {
             // completed lock which conflicts with another completed one?
             // this means that majority of MNs in the quorum for this specific tx input are malicious!
-            std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
-            std::map<uint256, CTxLockCandidate>::iterator itLockCandidateConflicting = mapTxLockCandidates.find(hashConflicting);
+            tx_lock_candidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+            tx_lock_candidate_map_t::iterator itLockCandidateConflicting = mapTxLockCandidates.find(hashConflicting);
             if(itLockCandidate == mapTxLockCandidates.end() || itLockCandidateConflicting == mapTxLockCandidates.end()) {
                 // safety check, should never really happen
                 //LogPrint("CInstantSend::ResolveConflicts -- ERROR: Found conflicting completed Transaction Lock, but one of txLockCandidate-s is missing, txid=%s, conflicting txid=%s\n",
@@ -559,15 +630,7 @@ int64_t CInstantSend::GetAverageGhostnodeOrphanVoteTime()
     // NOTE: should never actually call this function when mapGhostnodeOrphanVotes is empty
     if(mapGhostnodeOrphanVotes.empty()) return 0;
 
-    std::map<COutPoint, int64_t>::iterator it = mapGhostnodeOrphanVotes.begin();
-    int64_t total = 0;
-
-    while(it != mapGhostnodeOrphanVotes.end()) {
-        total+= it->second;
-        ++it;
-    }
-
-    return total / mapGhostnodeOrphanVotes.size();
+    return nGhostnodeOrphanVoteTimeTotal / (int64_t)mapGhostnodeOrphanVotes.size();
 }
 
 void CInstantSend::CheckAndRemove()
@@ -576,59 +639,64 @@ void CInstantSend::CheckAndRemove()
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.begin();
-
-    // remove expired candidates
-    while(itLockCandidate != mapTxLockCandidates.end()) {
-        CTxLockCandidate &txLockCandidate = itLockCandidate->second;
-        uint256 txHash = txLockCandidate.GetHash();
-        if(txLockCandidate.IsExpired(pCurrentBlockIndex->nHeight)) {
+    int nHeight = pCurrentBlockIndex->nHeight;
+    std::vector<uint256> vExpiredLocks;
+
+    // remove expired candidates and their votes, only txes confirmed deep enough can expire
+    std::map<int, std::vector<uint256> >::iterator itConfirmed = mapConfirmedTxLocks.begin();
+    while(itConfirmed != mapConfirmedTxLocks.end() && nHeight - itConfirmed->first > Params().GetConsensus().nInstantSendKeepLock) {
+        BOOST_FOREACH(const uint256& txHash, itConfirmed->second) {
+            tx_lock_candidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+            if(itLockCandidate == mapTxLockCandidates.end()) continue;
+            CTxLockCandidate &txLockCandidate = itLockCandidate->second;
+            // reorged out or confirmed again at another height since this bucket entry was added
+            if(!txLockCandidate.IsExpired(nHeight)) continue;
             //LogPrint("CInstantSend::CheckAndRemove -- Removing expired Transaction Lock Candidate: txid=%s\n", txHash.ToString());
             std::map<COutPoint, COutPointLock>::iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
             while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
                 mapLockedOutpoints.erase(itOutpointLock->first);
                 mapVotedOutpoints.erase(itOutpointLock->first);
+                // remove expired votes
+                BOOST_FOREACH(const CTxLockVote& vote, itOutpointLock->second.GetVotes()) {
+                    tx_lock_vote_map_t::iterator itVote = mapTxLockVotes.find(vote.GetHash());
+                    if(itVote != mapTxLockVotes.end() && itVote->second.IsExpired(nHeight)) {
+                        //LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired vote: txid=%s  ghostnode=%s\n",
+                            //    itVote->second.GetTxHash().ToString(), itVote->second.GetGhostnodeOutpoint().ToStringShort());
+                        mapTxLockVotes.erase(itVote);
+                    }
+                }
                 ++itOutpointLock;
             }
             mapLockRequestAccepted.erase(txHash);
             mapLockRequestRejected.erase(txHash);
-            mapTxLockCandidates.erase(itLockCandidate++);
-        } else {
-            ++itLockCandidate;
+            mapTxLockCandidates.erase(itLockCandidate);
+            vExpiredLocks.push_back(txHash);
         }
+        mapConfirmedTxLocks.erase(itConfirmed++);
     }
-
-    // remove expired votes
-    std::map<uint256, CTxLockVote>::iterator itVote = mapTxLockVotes.begin();
-    while(itVote != mapTxLockVotes.end()) {
-        if(itVote->second.IsExpired(pCurrentBlockIndex->nHeight)) {
-            //LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired vote: txid=%s  ghostnode=%s\n",
-                //    itVote->second.GetTxHash().ToString(), itVote->second.GetGhostnodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itVote++);
-        } else {
-            ++itVote;
-        }
+    if(pdb && !vExpiredLocks.empty() && !pdb->EraseTxLocks(vExpiredLocks)) {
+        LogPrintf("CInstantSend::CheckAndRemove -- failed to erase %u expired locks\n", vExpiredLocks.size());
     }
 
     // remove expired orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(GetTime() - itOrphanVote->second.GetTimeCreated() > ORPHAN_VOTE_SECONDS) {
-            //LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan vote: txid=%s  ghostnode=%s\n",
-               //     itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetGhostnodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itOrphanVote->first);
-            mapTxLockVotesOrphan.erase(itOrphanVote++);
-        } else {
-            ++itOrphanVote;
+    std::map<int64_t, std::vector<uint256> >::iterator itOrphanExpiry = mapOrphanVoteExpiry.begin();
+    while(itOrphanExpiry != mapOrphanVoteExpiry.end() && itOrphanExpiry->first < GetTime()) {
+        BOOST_FOREACH(const uint256& nVoteHash, itOrphanExpiry->second) {
+            if(!mapTxLockVotesOrphan.count(nVoteHash)) continue;
+            //LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan vote: vote=%s\n", nVoteHash.ToString());
+            mapTxLockVotes.erase(nVoteHash);
+            EraseOrphanTxLockVote(nVoteHash);
         }
+        mapOrphanVoteExpiry.erase(itOrphanExpiry++);
     }
 
     // remove expired ghostnode orphan votes (DOS protection)
-    std::map<COutPoint, int64_t>::iterator itGhostnodeOrphan = mapGhostnodeOrphanVotes.begin();
+    orphan_vote_time_map_t::iterator itGhostnodeOrphan = mapGhostnodeOrphanVotes.begin();
     while(itGhostnodeOrphan != mapGhostnodeOrphanVotes.end()) {
         if(itGhostnodeOrphan->second < GetTime()) {
             //LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan ghostnode vote: ghostnode=%s\n",
                //     itGhostnodeOrphan->first.ToStringShort());
+            nGhostnodeOrphanVoteTimeTotal -= itGhostnodeOrphan->second;
             mapGhostnodeOrphanVotes.erase(itGhostnodeOrphan++);
         } else {
             ++itGhostnodeOrphan;
@@ -666,7 +734,7 @@ bool CInstantSend::GetTxLockRequest(const uint256& txHash, CTxLockRequest& txLoc
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    tx_lock_candidate_map_t::iterator it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end()) return false;
 
     //TODO: find a solution for calling
@@ -679,7 +747,7 @@ bool CInstantSend::GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotes.find(hash);
+    tx_lock_vote_map_t::iterator it = mapTxLockVotes.find(hash);
     if(it == mapTxLockVotes.end()) return false;
     txLockVoteRet = it->second;
 
@@ -694,7 +762,7 @@ bool CInstantSend::IsInstantSendReadyToLock(const uint256& txHash)
      LOCK2(cs_main, cs_instantsend);
     // There must be a successfully verified lock request
     // and all outputs must be locked (i.e. have enough signatures)
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    tx_lock_candidate_map_t::iterator it = mapTxLockCandidates.find(txHash);
     return it != mapTxLockCandidates.end() && it->second.IsAllOutPointsReady();
 }
 
@@ -706,7 +774,7 @@ bool CInstantSend::IsLockedInstantSendTransaction(const uint256& txHash)
     LOCK(cs_instantsend);
 
     // there must be a lock candidate
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    tx_lock_candidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate == mapTxLockCandidates.end()) return false;
 
     // which should have outpoints
@@ -731,7 +799,7 @@ int CInstantSend::GetTransactionLockSignatures(const uint256& txHash)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    tx_lock_candidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate != mapTxLockCandidates.end()) {
         return itLockCandidate->second.CountVotes();
     }
@@ -745,7 +813,7 @@ bool CInstantSend::IsTxLockRequestTimedOut(const uint256& txHash)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    tx_lock_candidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if (itLockCandidate != mapTxLockCandidates.end()) {
         return !itLockCandidate->second.IsAllOutPointsReady() &&
                 itLockCandidate->second.txLockRequest.IsTimedOut();
@@ -758,17 +826,125 @@ void CInstantSend::Relay(const uint256& txHash)
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::const_iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    tx_lock_candidate_map_t::const_iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if (itLockCandidate != mapTxLockCandidates.end()) {
         itLockCandidate->second.Relay();
     }
 }
 
+void CInstantSend::QueueVoteRelay(const uint256& nVoteHash)
+{
+    LOCK(cs_voterelay);
+    vecVoteRelayQueue.push_back(CInv(MSG_TXLOCK_VOTE, nVoteHash));
+}
+
+void CInstantSend::RelayQueuedVotes()
+{
+    std::vector<CInv> vInv;
+    {
+        LOCK(cs_voterelay);
+        if(vecVoteRelayQueue.empty()) return;
+        vInv.swap(vecVoteRelayQueue);
+    }
+    if(!g_connman) return;
+    // one pass over the peers for the whole batch, SendMessages packs them into a single inv per peer
+    g_connman->RelayInvs(vInv, MIN_INSTANTSEND_PROTO_VERSION);
+}
+
 void CInstantSend::UpdatedBlockTip(const CBlockIndex *pindex)
 {
     pCurrentBlockIndex = pindex;
 }
 
+CInstantSend::~CInstantSend() {}
+
+void CInstantSend::WriteTxLock(const CTxLockCandidate& txLockCandidate)
+{
+    AssertLockHeld(cs_instantsend);
+    if(!pdb) return;
+
+    CTxLockRecord record;
+    record.tx = txLockCandidate.txLockRequest;
+    BOOST_FOREACH(const PAIRTYPE(COutPoint, COutPointLock)& outpointLock, txLockCandidate.mapOutPointLocks) {
+        std::vector<CTxLockVote> vVotes = outpointLock.second.GetVotes();
+        record.vecVotes.insert(record.vecVotes.end(), vVotes.begin(), vVotes.end());
+    }
+    record.nConfirmedHeight = txLockCandidate.GetConfirmedHeight();
+    record.nUpdateHeight = pCurrentBlockIndex ? pCurrentBlockIndex->nHeight : 0;
+
+    if(!pdb->WriteTxLock(txLockCandidate.GetHash(), record)) {
+        LogPrintf("CInstantSend::WriteTxLock -- failed to store the lock of %s\n", txLockCandidate.GetHash().ToString());
+    }
+}
+
+bool CInstantSend::RestoreTxLock(const uint256& txHash, const CTxLockRecord& record)
+{
+    AssertLockHeld(cs_instantsend);
+
+    CTxLockRequest txLockRequest((CTransaction(record.tx)));
+    if(txLockRequest.GetHash() != txHash || mapTxLockCandidates.count(txHash)) return false;
+
+    CTxLockCandidate txLockCandidate(txLockRequest);
+    BOOST_REVERSE_FOREACH(const CTxIn& txin, txLockRequest.vin) {
+        txLockCandidate.AddOutPointLock(txin.prevout);
+    }
+    txLockCandidate.SetConfirmedHeight(record.nConfirmedHeight);
+
+    std::vector<CTxLockVote> vVotes;
+    BOOST_FOREACH(CTxLockVote vote, record.vecVotes) {
+        vote.SetConfirmedHeight(record.nConfirmedHeight);
+        if(vote.GetTxHash() != txHash || !txLockCandidate.AddVote(vote)) continue;
+        vVotes.push_back(vote);
+    }
+    // the votes were checked when they arrived, they only have to add up to a lock again
+    if(!txLockCandidate.IsAllOutPointsReady()) return false;
+
+    BOOST_FOREACH(const CTxLockVote& vote, vVotes) {
+        mapTxLockVotes.emplace(vote.GetHash(), vote);
+        mapVotedOutpoints[vote.GetOutpoint()].insert(txHash);
+    }
+    mapLockRequestAccepted.emplace(txHash, txLockRequest);
+    if(record.nConfirmedHeight != -1) mapConfirmedTxLocks[record.nConfirmedHeight].push_back(txHash);
+    tx_lock_candidate_map_t::iterator it = mapTxLockCandidates.emplace(txHash, txLockCandidate).first;
+    LockTransactionInputs(it->second);
+    return true;
+}
+
+bool CInstantSend::LoadTxLocks()
+{
+    LOCK2(cs_main, cs_instantsend);
+
+    pdb.reset(new CInstantSendDB(INSTANTSEND_DB_CACHE));
+
+    std::vector<std::pair<uint256, CTxLockRecord> > vRecords;
+    if(!pdb->ReadTxLocks(vRecords)) {
+        return error("CInstantSend::LoadTxLocks -- failed to read the lock database");
+    }
+
+    int nHeight = chainActive.Height();
+    int nKeepLock = Params().GetConsensus().nInstantSendKeepLock;
+    std::vector<uint256> vDropped;
+    for (const auto& item : vRecords) {
+        const CTxLockRecord& record = item.second;
+        int nHeightFrom = record.nConfirmedHeight != -1 ? record.nConfirmedHeight : record.nUpdateHeight;
+        if(nHeight - nHeightFrom > nKeepLock || !RestoreTxLock(item.first, record)) {
+            vDropped.push_back(item.first);
+        }
+    }
+    if(!vDropped.empty() && !pdb->EraseTxLocks(vDropped)) {
+        return error("CInstantSend::LoadTxLocks -- failed to erase expired locks");
+    }
+
+    LogPrintf("CInstantSend::LoadTxLocks -- restored %u transaction locks, %u expired\n", vRecords.size() - vDropped.size(), vDropped.size());
+    return true;
+}
+
+void CInstantSend::CloseTxLockDB()
+{
+    LOCK(cs_instantsend);
+    pdb.reset();
+}
+
 void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
 {
     // Update lock candidates and votes if corresponding tx confirmed
@@ -787,18 +963,20 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     //LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d\n", txHash.ToString(), nHeightNew);
 
     // Check lock candidates
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    tx_lock_candidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate != mapTxLockCandidates.end()) {
         //LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d lock candidate updated\n",
                // txHash.ToString(), nHeightNew);
         itLockCandidate->second.SetConfirmedHeight(nHeightNew);
+        if(nHeightNew != -1) mapConfirmedTxLocks[nHeightNew].push_back(txHash);
+        if(IsLockedInstantSendTransaction(txHash)) WriteTxLock(itLockCandidate->second);
         // Loop through outpoint locks
         std::map<COutPoint, COutPointLock>::iterator itOutpointLock = itLockCandidate->second.mapOutPointLocks.begin();
         while(itOutpointLock != itLockCandidate->second.mapOutPointLocks.end()) {
             // Check corresponding lock votes
             std::vector<CTxLockVote> vVotes = itOutpointLock->second.GetVotes();
             std::vector<CTxLockVote>::iterator itVote = vVotes.begin();
-            std::map<uint256, CTxLockVote>::iterator it;
+            tx_lock_vote_map_t::iterator it;
             while(itVote != vVotes.end()) {
                 uint256 nVoteHash = itVote->GetHash();
                 //LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
@@ -814,17 +992,84 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     }
 
     // check orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(itOrphanVote->second.GetTxHash() == txHash) {
+    tx_hash_set_map_t::iterator itByTx = mapTxLockVotesOrphanByTx.find(txHash);
+    if(itByTx != mapTxLockVotesOrphanByTx.end()) {
+        BOOST_FOREACH(const uint256& nVoteHash, itByTx->second) {
             //LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
-                 //   txHash.ToString(), nHeightNew, itOrphanVote->first.ToString());
-            mapTxLockVotes[itOrphanVote->first].SetConfirmedHeight(nHeightNew);
+                 //   txHash.ToString(), nHeightNew, nVoteHash.ToString());
+            mapTxLockVotes[nVoteHash].SetConfirmedHeight(nHeightNew);
         }
-        ++itOrphanVote;
     }
 }
 
+size_t CInstantSend::DynamicMemoryUsage()
+{
+    LOCK(cs_instantsend);
+    size_t nUsage = memusage::DynamicUsage(mapLockRequestAccepted) + memusage::DynamicUsage(mapLockRequestRejected);
+    for (const auto& request : mapLockRequestAccepted)
+        nUsage += RecursiveDynamicUsage(request.second);
+    for (const auto& request : mapLockRequestRejected)
+        nUsage += RecursiveDynamicUsage(request.second);
+
+    nUsage += memusage::DynamicUsage(mapTxLockVotes) + memusage::DynamicUsage(mapTxLockVotesOrphan);
+    for (const auto& vote : mapTxLockVotes)
+        nUsage += vote.second.DynamicMemoryUsage();
+    for (const auto& vote : mapTxLockVotesOrphan)
+        nUsage += vote.second.DynamicMemoryUsage();
+    nUsage += memusage::DynamicUsageWithValues(mapTxLockVotesOrphanByTx);
+
+    nUsage += memusage::DynamicUsage(mapTxLockCandidates);
+    for (const auto& candidate : mapTxLockCandidates) {
+        nUsage += RecursiveDynamicUsage(candidate.second.txLockRequest) + memusage::DynamicUsage(candidate.second.mapOutPointLocks);
+        for (const auto& outpointLock : candidate.second.mapOutPointLocks)
+            nUsage += outpointLock.second.DynamicMemoryUsage();
+    }
+
+    nUsage += memusage::DynamicUsageWithValues(mapVotedOutpoints) + memusage::DynamicUsage(mapLockedOutpoints);
+    nUsage += memusage::DynamicUsage(mapGhostnodeOrphanVotes);
+    nUsage += memusage::DynamicUsageWithValues(mapOrphanVoteExpiry) + memusage::DynamicUsageWithValues(mapConfirmedTxLocks);
+    {
+        LOCK(cs_voterelay);
+        nUsage += memusage::DynamicUsage(vecVoteRelayQueue);
+    }
+    return nUsage;
+}
+
+//
+// CInstantSendDB
+//
+
+CInstantSendDB::CInstantSendDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "instantsend", nCacheSize, fMemory, fWipe) {
+}
+
+bool CInstantSendDB::WriteTxLock(const uint256& txHash, const CTxLockRecord& record) {
+    return Write(std::make_pair(DB_TXLOCK, txHash), record);
+}
+
+bool CInstantSendDB::EraseTxLocks(const std::vector<uint256>& vTxHashes) {
+    CDBBatch batch(*this);
+    for (const uint256& txHash : vTxHashes)
+        batch.Erase(std::make_pair(DB_TXLOCK, txHash));
+    return WriteBatch(batch);
+}
+
+bool CInstantSendDB::ReadTxLocks(std::vector<std::pair<uint256, CTxLockRecord> >& vRecords) {
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_TXLOCK, uint256()));
+    while (pcursor->Valid()) {
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_TXLOCK)
+            break;
+        CTxLockRecord record;
+        if (!pcursor->GetValue(record))
+            return error("%s: failed to read the lock of %s", __func__, key.second.ToString());
+        vRecords.emplace_back(key.second, record);
+        pcursor->Next();
+    }
+    return true;
+}
+
 //
 // CTxLockRequest
 //
@@ -1043,8 +1288,7 @@ bool CTxLockVote::Sign()
 
 void CTxLockVote::Relay() const
 {
-//    CInv inv(MSG_TXLOCK_VOTE, GetHash());
-//    RelayInv(inv);
+    instantsend.QueueVoteRelay(GetHash());
 }
 
 bool CTxLockVote::IsExpired(int nHeight) const
@@ -1081,6 +1325,14 @@ bool COutPointLock::HasGhostnodeVoted(const COutPoint& outpointGhostnodeIn) cons
     return mapGhostnodeVotes.count(outpointGhostnodeIn);
 }
 
+size_t COutPointLock::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(mapGhostnodeVotes);
+    for (const auto& vote : mapGhostnodeVotes)
+        nUsage += vote.second.DynamicMemoryUsage();
+    return nUsage;
+}
+
 void COutPointLock::Relay() const
 {
     std::map<COutPoint, CTxLockVote>::const_iterator itVote = mapGhostnodeVotes.begin();
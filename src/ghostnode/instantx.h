@@ -5,13 +5,22 @@
 #ifndef INSTANTX_H
 #define INSTANTX_H
 
+#include "dbwrapper.h"
+#include "memusage.h"
 #include "net.h"
 #include "primitives/transaction.h"
+#include "validation.h"
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
 
 class CTxLockVote;
 class COutPointLock;
 class CTxLockRequest;
 class CTxLockCandidate;
+class CTxLockRecord;
+class CInstantSendDB;
 class CInstantSend;
 
 extern CInstantSend instantsend;
@@ -30,6 +39,15 @@ static const int DEFAULT_INSTANTSEND_DEPTH          = 5;
 
 static const int MIN_INSTANTSEND_PROTO_VERSION      = 70015;
 
+// how often queued lock votes are announced to peers
+static const int INSTANTSEND_VOTE_RELAY_INTERVAL_MS = 50;
+
+// cache of the completed lock database (instantsend/)
+static const size_t INSTANTSEND_DB_CACHE            = 1 << 20;
+
+//! -maxinstantsendorphanmem default, megabytes of lock votes kept while their lock request is missing
+static const unsigned int DEFAULT_MAX_INSTANTSEND_ORPHAN_MEMORY = 8;
+
 extern bool fEnableInstantSend;
 extern int nInstantSendDepth;
 extern int nCompleteTXLocks;
@@ -42,26 +60,57 @@ private:
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
+    typedef std::unordered_map<uint256, CTxLockVote, BlockHasher> tx_lock_vote_map_t;
+    typedef std::unordered_map<uint256, CTxLockCandidate, BlockHasher> tx_lock_candidate_map_t;
+    typedef std::unordered_map<uint256, std::set<uint256>, BlockHasher> tx_hash_set_map_t;
+    typedef std::unordered_map<COutPoint, std::set<uint256>, SaltedOutpointHasher> voted_outpoint_map_t;
+    typedef std::unordered_map<COutPoint, uint256, SaltedOutpointHasher> locked_outpoint_map_t;
+    typedef std::unordered_map<COutPoint, int64_t, SaltedOutpointHasher> orphan_vote_time_map_t;
+
     // maps for AlreadyHave
     std::map<uint256, CTxLockRequest> mapLockRequestAccepted; // tx hash - tx
     std::map<uint256, CTxLockRequest> mapLockRequestRejected; // tx hash - tx
-    std::map<uint256, CTxLockVote> mapTxLockVotes; // vote hash - vote
-    std::map<uint256, CTxLockVote> mapTxLockVotesOrphan; // vote hash - vote
+    tx_lock_vote_map_t mapTxLockVotes; // vote hash - vote
+    tx_lock_vote_map_t mapTxLockVotesOrphan; // vote hash - vote
+    tx_hash_set_map_t mapTxLockVotesOrphanByTx; // tx hash - orphan vote hash set
 
-    std::map<uint256, CTxLockCandidate> mapTxLockCandidates; // tx hash - lock candidate
+    tx_lock_candidate_map_t mapTxLockCandidates; // tx hash - lock candidate
 
-    std::map<COutPoint, std::set<uint256> > mapVotedOutpoints; // utxo - tx hash set
-    std::map<COutPoint, uint256> mapLockedOutpoints; // utxo - tx hash
+    voted_outpoint_map_t mapVotedOutpoints; // utxo - tx hash set
+    locked_outpoint_map_t mapLockedOutpoints; // utxo - tx hash
 
     //track ghostnodes who voted with no txreq (for DOS protection)
-    std::map<COutPoint, int64_t> mapGhostnodeOrphanVotes; // mn outpoint - time
+    orphan_vote_time_map_t mapGhostnodeOrphanVotes; // mn outpoint - time
+    int64_t nGhostnodeOrphanVoteTimeTotal; // sum of mapGhostnodeOrphanVotes times
+
+    // expiry buckets, entries are re-checked when their bucket is due so stale ones are simply skipped
+    std::map<int64_t, std::vector<uint256> > mapOrphanVoteExpiry; // expiration time - orphan vote hashes
+    std::map<int, std::vector<uint256> > mapConfirmedTxLocks; // confirmed height - tx hashes
+
+    // budget of the orphan votes in bytes, 0 for none, the votes closest to expiry are dropped first
+    size_t nMaxOrphanMemory;
+    std::atomic<uint64_t> nOrphanVotesEvicted;
+
+    // votes waiting to be announced by RelayQueuedVotes
+    CCriticalSection cs_voterelay;
+    std::vector<CInv> vecVoteRelayQueue;
+
+    // time from lock candidate creation to lock completion
+    int64_t nLockLatencyCount;
+    int64_t nLockLatencyTotal; // microseconds
+
+    // completed locks are kept on disk until they expire so they survive a restart
+    std::unique_ptr<CInstantSendDB> pdb;
 
     bool CreateTxLockCandidate(const CTxLockRequest& txLockRequest);
     void Vote(CTxLockCandidate& txLockCandidate);
 
     //process consensus vote message
     bool ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote);
-    void ProcessOrphanTxLockVotes();
+    void ProcessOrphanTxLockVotes(const uint256& txHash);
+    void AddOrphanTxLockVote(const CTxLockVote& vote);
+    void EraseOrphanTxLockVote(const uint256& nVoteHash);
+    void SetGhostnodeOrphanVoteTime(const COutPoint& outpointGhostnode, int64_t nTime);
     bool IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest);
     bool IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, const COutPoint& outpoint);
     int64_t GetAverageGhostnodeOrphanVoteTime();
@@ -72,11 +121,23 @@ private:
     void UpdateLockedTransaction(const CTxLockCandidate& txLockCandidate);
     bool ResolveConflicts(const CTxLockCandidate& txLockCandidate, int nMaxBlocks);
 
+    // store a completed lock with its votes and current confirmation height
+    void WriteTxLock(const CTxLockCandidate& txLockCandidate);
+    // put a stored lock back in the maps as if its votes had just been processed
+    bool RestoreTxLock(const uint256& txHash, const CTxLockRecord& record);
+
     bool IsInstantSendReadyToLock(const uint256 &txHash);
 
 public:
     CCriticalSection cs_instantsend;
 
+    CInstantSend() : pCurrentBlockIndex(NULL), nGhostnodeOrphanVoteTimeTotal(0), nMaxOrphanMemory(0), nOrphanVotesEvicted(0), nLockLatencyCount(0), nLockLatencyTotal(0) {}
+    ~CInstantSend();
+
+    // open the lock database and restore the locks that haven't expired at the current tip
+    bool LoadTxLocks();
+    void CloseTxLockDB();
+
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
     bool ProcessTxLockRequest(const CTxLockRequest& txLockRequest);
@@ -103,9 +164,19 @@ public:
     bool IsTxLockRequestTimedOut(const uint256& txHash);
 
     void Relay(const uint256& txHash);
+    // queue a vote for the next batched announcement instead of relaying it right away
+    void QueueVoteRelay(const uint256& nVoteHash);
+    void RelayQueuedVotes();
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+
+    /// Heap memory of the lock requests, candidates and votes
+    size_t DynamicMemoryUsage();
+
+    void SetMaxOrphanMemory(size_t nBytes) { nMaxOrphanMemory = nBytes; }
+    /// Orphan votes dropped to stay within the memory budget
+    uint64_t GetOrphanVotesEvicted() const { return nOrphanVotesEvicted; }
 };
 
 class CTxLockRequest : public CMutableTransaction
@@ -189,6 +260,8 @@ public:
     bool CheckSignature() const;
 
     void Relay() const;
+
+    size_t DynamicMemoryUsage() const { return memusage::DynamicUsage(vchGhostnodeSignature); }
 };
 
 class COutPointLock
@@ -215,16 +288,20 @@ public:
     bool IsReady() const { return CountVotes() >= SIGNATURES_REQUIRED; }
 
     void Relay() const;
+
+    size_t DynamicMemoryUsage() const;
 };
 
 class CTxLockCandidate
 {
 private:
     int nConfirmedHeight; // when corresponding tx is 0-confirmed or conflicted, nConfirmedHeight is -1
+    int64_t nTimeCreated; // microseconds
 
 public:
     CTxLockCandidate(const CTxLockRequest& txLockRequestIn) :
         nConfirmedHeight(-1),
+        nTimeCreated(GetTimeMicros()),
         txLockRequest(txLockRequestIn),
         mapOutPointLocks()
         {}
@@ -233,6 +310,7 @@ public:
     std::map<COutPoint, COutPointLock> mapOutPointLocks;
 
     uint256 GetHash() const { return txLockRequest.GetHash(); }
+    int64_t GetTimeCreated() const { return nTimeCreated; }
 
     void AddOutPointLock(const COutPoint& outpoint);
     bool AddVote(const CTxLockVote& vote);
@@ -242,9 +320,46 @@ public:
     int CountVotes() const;
 
     void SetConfirmedHeight(int nConfirmedHeightIn) { nConfirmedHeight = nConfirmedHeightIn; }
+    int GetConfirmedHeight() const { return nConfirmedHeight; }
     bool IsExpired(int nHeight) const;
 
     void Relay() const;
 };
 
+/** A completed transaction lock as stored in the lock database */
+class CTxLockRecord
+{
+public:
+    CMutableTransaction tx;
+    std::vector<CTxLockVote> vecVotes;
+    int nConfirmedHeight; // -1 while the tx is unconfirmed
+    int nUpdateHeight; // chain height when the record was written, unconfirmed locks expire from it
+
+    CTxLockRecord() : nConfirmedHeight(-1), nUpdateHeight(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(tx);
+        READWRITE(vecVotes);
+        READWRITE(nConfirmedHeight);
+        READWRITE(nUpdateHeight);
+    }
+};
+
+/** Completed transaction locks by tx hash (instantsend/) */
+class CInstantSendDB : public CDBWrapper
+{
+public:
+    explicit CInstantSendDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    CInstantSendDB(const CInstantSendDB&) = delete;
+    CInstantSendDB& operator=(const CInstantSendDB&) = delete;
+
+    bool WriteTxLock(const uint256& txHash, const CTxLockRecord& record);
+    bool EraseTxLocks(const std::vector<uint256>& vTxHashes);
+    bool ReadTxLocks(std::vector<std::pair<uint256, CTxLockRecord> >& vRecords);
+};
+
 #endif
@@ -4,34 +4,109 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chainparams.h"
+#include "hash.h"
 #include "netfulfilledman.h"
+#include "random.h"
 #include "util.h"
 
 CNetFulfilledRequestManager netfulfilledman;
 
-void CNetFulfilledRequestManager::AddFulfilledRequest(CAddress addr, std::string strRequest)
+std::string FulfilledRequestName(FulfilledRequest request)
+{
+    switch (request) {
+    case FULFILLED_MNVERIFY_REQUEST:        return std::string(NetMsgType::MNVERIFY) + "-request";
+    case FULFILLED_MNVERIFY_REPLY:          return std::string(NetMsgType::MNVERIFY) + "-reply";
+    case FULFILLED_MNVERIFY_DONE:           return std::string(NetMsgType::MNVERIFY) + "-done";
+    case FULFILLED_PAYMENT_VOTES:           return NetMsgType::GHOSTNODEPAYMENTSYNC;
+    case FULFILLED_SPORK_SYNC:              return "spork-sync";
+    case FULFILLED_GHOSTNODE_LIST_SYNC:     return "ghostnode-list-sync";
+    case FULFILLED_GHOSTNODE_PAYMENT_SYNC:  return "ghostnode-payment-sync";
+    case FULFILLED_FULL_SYNC:               return "full-sync";
+    case FULFILLED_REQUEST_COUNT:           break;
+    }
+    assert(false);
+}
+
+SaltedNetAddrHasher::SaltedNetAddrHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t SaltedNetAddrHasher::operator()(const CNetAddr& addr) const
+{
+    unsigned char vch[16];
+    for (int i = 0; i < 16; i++)
+        vch[i] = addr.GetByte(15 - i);
+    return CSipHasher(k0, k1).Write(vch, sizeof(vch)).Finalize();
+}
+
+void CNetFulfilledRequestManager::Schedule(const CNetAddr& addr, fulfilledreqentry_t& entry, int64_t nTick)
+{
+    // never behind the wheel, e.g. when the clock went back
+    nTick = std::max(nTick, nWheelNextTick);
+    entry.nWheelTick = nTick;
+    vWheel[nTick % WHEEL_SLOTS].push_back(addr);
+}
+
+void CNetFulfilledRequestManager::AddFulfilledRequest(const CAddress& addr, FulfilledRequest request)
 {
     LOCK(cs_mapFulfilledRequests);
-    mapFulfilledRequests[addr][strRequest] = GetTime() + Params().FulfilledRequestExpireTime();
+    fulfilledreqentry_t& entry = mapFulfilledRequests[addr];
+    int64_t nExpires = GetTime() + Params().FulfilledRequestExpireTime();
+    entry.vExpires[request] = nExpires;
+
+    // an address is on the wheel once, at the tick of its earliest expiry
+    int64_t nTick = nExpires / WHEEL_SLOT_SECONDS;
+    if (entry.nWheelTick == 0 || nTick < entry.nWheelTick) {
+        Schedule(addr, entry, nTick);
+    }
 }
 
-bool CNetFulfilledRequestManager::HasFulfilledRequest(CAddress addr, std::string strRequest)
+bool CNetFulfilledRequestManager::HasFulfilledRequest(const CAddress& addr, FulfilledRequest request)
 {
     LOCK(cs_mapFulfilledRequests);
-    fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addr);
+    fulfilledreqmap_t::const_iterator it = mapFulfilledRequests.find(addr);
 
-    return  it != mapFulfilledRequests.end() &&
-            it->second.find(strRequest) != it->second.end() &&
-            it->second[strRequest] > GetTime();
+    return it != mapFulfilledRequests.end() && it->second.vExpires[request] > GetTime();
 }
 
-void CNetFulfilledRequestManager::RemoveFulfilledRequest(CAddress addr, std::string strRequest)
+void CNetFulfilledRequestManager::RemoveFulfilledRequest(const CAddress& addr, FulfilledRequest request)
 {
     LOCK(cs_mapFulfilledRequests);
     fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addr);
 
     if (it != mapFulfilledRequests.end()) {
-        it->second.erase(strRequest);
+        it->second.vExpires[request] = 0;
+        // its wheel entry is skipped once the address is gone
+        bool fEmpty = true;
+        for (int64_t nExpires : it->second.vExpires)
+            fEmpty = fEmpty && nExpires == 0;
+        if (fEmpty)
+            mapFulfilledRequests.erase(it);
+    }
+}
+
+void CNetFulfilledRequestManager::RebuildWheel(int64_t nNow)
+{
+    AssertLockHeld(cs_mapFulfilledRequests);
+
+    for (std::vector<CNetAddr>& vSlot : vWheel)
+        vSlot.clear();
+    nWheelNextTick = nNow / WHEEL_SLOT_SECONDS;
+
+    fulfilledreqmap_t::iterator it = mapFulfilledRequests.begin();
+    while (it != mapFulfilledRequests.end()) {
+        int64_t nNextExpires = 0;
+        for (int64_t& nExpires : it->second.vExpires) {
+            if (nExpires <= nNow) {
+                nExpires = 0;
+            } else if (nNextExpires == 0 || nExpires < nNextExpires) {
+                nNextExpires = nExpires;
+            }
+        }
+        if (nNextExpires == 0) {
+            it = mapFulfilledRequests.erase(it);
+        } else {
+            Schedule(it->first, it->second, nNextExpires / WHEEL_SLOT_SECONDS);
+            ++it;
+        }
     }
 }
 
@@ -40,22 +115,46 @@ void CNetFulfilledRequestManager::CheckAndRemove()
     LOCK(cs_mapFulfilledRequests);
 
     int64_t now = GetTime();
-    fulfilledreqmap_t::iterator it = mapFulfilledRequests.begin();
+    int64_t nNowTick = now / WHEEL_SLOT_SECONDS;
+
+    // not called for a whole turn of the wheel (or never), check everything once
+    if (nNowTick - nWheelNextTick >= WHEEL_SLOTS) {
+        RebuildWheel(now);
+        return;
+    }
+
+    // a tick is checked once all of its seconds have passed, so whatever is left
+    // of a due address expires in a later tick
+    for (; nWheelNextTick < nNowTick; ++nWheelNextTick) {
+        std::vector<CNetAddr> vDue;
+        vDue.swap(vWheel[nWheelNextTick % WHEEL_SLOTS]);
+
+        for (const CNetAddr& addr : vDue) {
+            fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addr);
+            if (it == mapFulfilledRequests.end()) continue;
 
-    while(it != mapFulfilledRequests.end()) {
-        fulfilledreqmapentry_t::iterator it_entry = it->second.begin();
-        while(it_entry != it->second.end()) {
-            if(now > it_entry->second) {
-                it->second.erase(it_entry++);
+            fulfilledreqentry_t& entry = it->second;
+            if (entry.nWheelTick != nWheelNextTick) {
+                // due on a later turn of the wheel, otherwise it was moved to another slot
+                if (entry.nWheelTick > nWheelNextTick && (entry.nWheelTick - nWheelNextTick) % WHEEL_SLOTS == 0)
+                    vWheel[nWheelNextTick % WHEEL_SLOTS].push_back(addr);
+                continue;
+            }
+
+            int64_t nNextExpires = 0;
+            for (int64_t& nExpires : entry.vExpires) {
+                if (nExpires <= now) {
+                    nExpires = 0;
+                } else if (nNextExpires == 0 || nExpires < nNextExpires) {
+                    nNextExpires = nExpires;
+                }
+            }
+            if (nNextExpires == 0) {
+                mapFulfilledRequests.erase(it);
             } else {
-                ++it_entry;
+                Schedule(addr, entry, nNextExpires / WHEEL_SLOT_SECONDS);
             }
         }
-        if(it->second.size() == 0) {
-            mapFulfilledRequests.erase(it++);
-        } else {
-            ++it;
-        }
     }
 }
 
@@ -63,6 +162,35 @@ void CNetFulfilledRequestManager::Clear()
 {
     LOCK(cs_mapFulfilledRequests);
     mapFulfilledRequests.clear();
+    for (std::vector<CNetAddr>& vSlot : vWheel)
+        vSlot.clear();
+}
+
+std::map<CNetAddr, std::map<std::string, int64_t> > CNetFulfilledRequestManager::GetNamedRequests() const
+{
+    std::map<CNetAddr, std::map<std::string, int64_t> > mapNamed;
+    for (const std::pair<const CNetAddr, fulfilledreqentry_t>& item : mapFulfilledRequests) {
+        for (unsigned int i = 0; i < FULFILLED_REQUEST_COUNT; i++) {
+            if (item.second.vExpires[i] != 0)
+                mapNamed[item.first][FulfilledRequestName((FulfilledRequest)i)] = item.second.vExpires[i];
+        }
+    }
+    return mapNamed;
+}
+
+void CNetFulfilledRequestManager::SetNamedRequests(const std::map<CNetAddr, std::map<std::string, int64_t> >& mapNamed)
+{
+    AssertLockHeld(cs_mapFulfilledRequests);
+
+    mapFulfilledRequests.clear();
+    for (const std::pair<const CNetAddr, std::map<std::string, int64_t> >& item : mapNamed) {
+        for (unsigned int i = 0; i < FULFILLED_REQUEST_COUNT; i++) {
+            std::map<std::string, int64_t>::const_iterator it = item.second.find(FulfilledRequestName((FulfilledRequest)i));
+            if (it != item.second.end())
+                mapFulfilledRequests[item.first].vExpires[i] = it->second;
+        }
+    }
+    RebuildWheel(GetTime());
 }
 
 std::string CNetFulfilledRequestManager::ToString() const
@@ -11,36 +11,101 @@
 #include "serialize.h"
 #include "sync.h"
 
+#include <array>
+#include <unordered_map>
+
 // Fulfilled requests are used to prevent nodes from asking for the same data on sync
 // and from being banned for doing so too often.
 class CNetFulfilledRequestManager;
 extern CNetFulfilledRequestManager netfulfilledman;
 
+/** The kinds of requests tracked per peer address */
+enum FulfilledRequest : unsigned int {
+    FULFILLED_MNVERIFY_REQUEST,
+    FULFILLED_MNVERIFY_REPLY,
+    FULFILLED_MNVERIFY_DONE,
+    FULFILLED_PAYMENT_VOTES,        //!< a peer asked us for the payment votes
+    FULFILLED_SPORK_SYNC,
+    FULFILLED_GHOSTNODE_LIST_SYNC,
+    FULFILLED_GHOSTNODE_PAYMENT_SYNC,
+    FULFILLED_FULL_SYNC,
+    FULFILLED_REQUEST_COUNT
+};
+
+/** Name a request was stored under in netfulfilled.dat */
+std::string FulfilledRequestName(FulfilledRequest request);
+
+/** Salted hasher of peer addresses, the keys come from the network */
+class SaltedNetAddrHasher
+{
+private:
+    const uint64_t k0, k1;
+
+public:
+    SaltedNetAddrHasher();
+
+    size_t operator()(const CNetAddr& addr) const;
+};
+
 class CNetFulfilledRequestManager
 {
 private:
-    typedef std::map<std::string, int64_t> fulfilledreqmapentry_t;
-    typedef std::map<CNetAddr, fulfilledreqmapentry_t> fulfilledreqmap_t;
+    //! Expiry is checked a wheel slot at a time, a slot covers this many seconds ...
+    static const int64_t WHEEL_SLOT_SECONDS = 60;
+    //! ... and the wheel goes round every WHEEL_SLOTS slots
+    static const int WHEEL_SLOTS = 64;
+
+    struct fulfilledreqentry_t {
+        //! Expiry time of each kind of request, 0 when there is none
+        std::array<int64_t, FULFILLED_REQUEST_COUNT> vExpires;
+        //! Wheel tick the address is due to be checked at
+        int64_t nWheelTick;
+
+        fulfilledreqentry_t() : nWheelTick(0) { vExpires.fill(0); }
+    };
+    typedef std::unordered_map<CNetAddr, fulfilledreqentry_t, SaltedNetAddrHasher> fulfilledreqmap_t;
 
     //keep track of what node has/was asked for and when
     fulfilledreqmap_t mapFulfilledRequests;
     CCriticalSection cs_mapFulfilledRequests;
 
+    // addresses by the slot of the tick their next request expires in, entries whose
+    // nWheelTick moved since are skipped when their slot comes round
+    std::array<std::vector<CNetAddr>, WHEEL_SLOTS> vWheel;
+    // first tick not checked yet
+    int64_t nWheelNextTick;
+
+    void Schedule(const CNetAddr& addr, fulfilledreqentry_t& entry, int64_t nTick);
+    /// Drop the expired requests of every address and put the rest back on the wheel
+    void RebuildWheel(int64_t nNow);
+
+    std::map<CNetAddr, std::map<std::string, int64_t> > GetNamedRequests() const;
+    void SetNamedRequests(const std::map<CNetAddr, std::map<std::string, int64_t> >& mapNamed);
+
 public:
-    CNetFulfilledRequestManager() {}
+    CNetFulfilledRequestManager() : nWheelNextTick(0) {}
 
     ADD_SERIALIZE_METHODS;
 
+    // stored by request name to keep the format of netfulfilled.dat
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
         LOCK(cs_mapFulfilledRequests);
-        READWRITE(mapFulfilledRequests);
+        std::map<CNetAddr, std::map<std::string, int64_t> > mapNamed;
+        if (!ser_action.ForRead()) {
+            mapNamed = GetNamedRequests();
+        }
+        READWRITE(mapNamed);
+        if (ser_action.ForRead()) {
+            SetNamedRequests(mapNamed);
+        }
     }
 
-    void AddFulfilledRequest(CAddress addr, std::string strRequest); // expire after 1 hour by default
-    bool HasFulfilledRequest(CAddress addr, std::string strRequest);
-    void RemoveFulfilledRequest(CAddress addr, std::string strRequest);
+    void AddFulfilledRequest(const CAddress& addr, FulfilledRequest request); // expire after 1 hour by default
+    bool HasFulfilledRequest(const CAddress& addr, FulfilledRequest request);
+    void RemoveFulfilledRequest(const CAddress& addr, FulfilledRequest request);
 
+    /// Forget the requests that expired since the last call
     void CheckAndRemove();
     void Clear();
 
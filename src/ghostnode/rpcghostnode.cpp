@@ -18,6 +18,7 @@
 #include "base58.h"
 #include "netbase.h"
 #include "wallet/rpcwallet.h"
+#include "sigma/parallel.h"
 
 #include <fstream>
 #include <iomanip>
@@ -100,6 +101,32 @@ UniValue getpoolinfo(const JSONRPCRequest& req) {
 }
 
 
+/** Collateral inputs of the ghostnode.conf entries, in the same order */
+static std::vector<CTxIn> ConfiguredGhostnodeVins(const std::vector<CGhostnodeConfig::CGhostnodeEntry>& vecEntries)
+{
+    std::vector<CTxIn> vecVin;
+    for (const CGhostnodeConfig::CGhostnodeEntry& mne : vecEntries) {
+        vecVin.push_back(CTxIn(uint256S(mne.getTxHash()), uint32_t(atoi(mne.getOutputIndex().c_str()))));
+    }
+    return vecVin;
+}
+
+static UniValue ActiveGhostnodeStatusToJSON()
+{
+    UniValue mnObj(UniValue::VOBJ);
+
+    mnObj.push_back(Pair("vin", activeGhostnode.vin.ToString()));
+    mnObj.push_back(Pair("service", activeGhostnode.service.ToString()));
+
+    CGhostnode mn;
+    if (mnodeman.Get(activeGhostnode.vin, mn)) {
+        mnObj.push_back(Pair("payee", CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString()));
+    }
+
+    mnObj.push_back(Pair("status", activeGhostnode.GetStatus()));
+    return mnObj;
+}
+
 UniValue ghostnode(const JSONRPCRequest& req) {
     std::string strCommand;
     bool fHelp = req.fHelp;
@@ -114,7 +141,7 @@ UniValue ghostnode(const JSONRPCRequest& req) {
     if (fHelp ||
         (strCommand != "start" && strCommand != "start-alias" && strCommand != "start-all" &&
          strCommand != "start-missing" &&
-         strCommand != "start-disabled" && strCommand != "list" && strCommand != "list-conf" && strCommand != "count" &&
+         strCommand != "start-disabled" && strCommand != "list" && strCommand != "list-conf" && strCommand != "status-conf" && strCommand != "count" &&
          strCommand != "debug" && strCommand != "current" && strCommand != "winner" && strCommand != "winners" &&
          strCommand != "genkey" &&
          strCommand != "connect" && strCommand != "outputs" && strCommand != "status"))
@@ -135,6 +162,7 @@ UniValue ghostnode(const JSONRPCRequest& req) {
                         "  status       - Print ghostnode status information\n"
                         "  list         - Print list of all known ghostnodes (see ghostnodelist for more info)\n"
                         "  list-conf    - Print ghostnode.conf in JSON format\n"
+                        "  status-conf  - Print the state of every ghostnode in ghostnode.conf, from one snapshot of the list\n"
                         "  winner       - Print info on next ghostnode winner to vote for\n"
                         "  winners      - Print list of ghostnode winners\n"
         );
@@ -188,8 +216,12 @@ UniValue ghostnode(const JSONRPCRequest& req) {
         if (strMode == "enabled")
             return mnodeman.CountEnabled();
 
-        int nCount;
-        mnodeman.GetNextGhostnodeInQueueForPayment(true, nCount);
+        int nCount = 0;
+        {
+            LOCK(cs_main);
+            if (chainActive.Tip())
+                nCount = mnodeman.CountQualifiedForPayment(chainActive.Height(), true);
+        }
 
         if (strMode == "qualify")
             return nCount;
@@ -322,36 +354,49 @@ UniValue ghostnode(const JSONRPCRequest& req) {
         int nSuccessful = 0;
         int nFailed = 0;
 
-        UniValue resultsObj(UniValue::VOBJ);
-
-        BOOST_FOREACH(CGhostnodeConfig::CGhostnodeEntry mne, ghostnodeConfig.getEntries()) {
-            std::string strError;
-
-            CTxIn vin = CTxIn(uint256S(mne.getTxHash()), uint32_t(atoi(mne.getOutputIndex().c_str())));
-            CGhostnode *pmn = mnodeman.Find(vin);
-            CGhostnodeBroadcast mnb;
-
-            if (strCommand == "start-missing" && pmn) continue;
-            if (strCommand == "start-disabled" && pmn && pmn->IsEnabled()) continue;
-
-            bool fResult = CGhostnodeBroadcast::Create(mne.getIp(), mne.getPrivKey(), mne.getTxHash(),
-                                                       mne.getOutputIndex(), strError, mnb);
+        // pick the entries to start from one snapshot of the list
+        std::vector<CGhostnodeConfig::CGhostnodeEntry> vecEntries = ghostnodeConfig.getEntries();
+        std::vector<ghostnode_info_t> vecInfo = mnodeman.GetGhostnodeInfos(ConfiguredGhostnodeVins(vecEntries));
+        std::vector<CGhostnodeConfig::CGhostnodeEntry> vecToStart;
+        for (size_t i = 0; i < vecEntries.size(); i++) {
+            if (strCommand == "start-missing" && vecInfo[i].fInfoValid) continue;
+            if (strCommand == "start-disabled" && vecInfo[i].fInfoValid && vecInfo[i].nActiveState == CGhostnode::GHOSTNODE_ENABLED) continue;
+            vecToStart.push_back(vecEntries[i]);
+        }
 
+        // look up the collaterals and sign the broadcasts of all of them at once, ...
+        std::vector<CGhostnodeBroadcast> vecMnb(vecToStart.size());
+        std::vector<std::string> vecError(vecToStart.size());
+        std::vector<char> vecResult(vecToStart.size(), false);
+        sigma::parallel_for(vecToStart.size(), GetNumCores(), [&](std::size_t i) {
+            const CGhostnodeConfig::CGhostnodeEntry& mne = vecToStart[i];
+            vecResult[i] = CGhostnodeBroadcast::Create(mne.getIp(), mne.getPrivKey(), mne.getTxHash(),
+                                                       mne.getOutputIndex(), vecError[i], vecMnb[i]);
+        });
+
+        // ... then add them to the list under one lock and announce them in one inventory
+        UniValue resultsObj(UniValue::VOBJ);
+        std::vector<CGhostnodeBroadcast> vecStarted;
+        std::vector<CInv> vInv;
+        for (size_t i = 0; i < vecToStart.size(); i++) {
             UniValue statusObj(UniValue::VOBJ);
-            statusObj.push_back(Pair("alias", mne.getAlias()));
-            statusObj.push_back(Pair("result", fResult ? "successful" : "failed"));
+            statusObj.push_back(Pair("alias", vecToStart[i].getAlias()));
+            statusObj.push_back(Pair("result", vecResult[i] ? "successful" : "failed"));
 
-            if (fResult) {
+            if (vecResult[i]) {
                 nSuccessful++;
-                mnodeman.UpdateGhostnodeList(mnb);
-                mnb.RelayGhostNode();
+                vecStarted.push_back(vecMnb[i]);
+                vInv.push_back(CInv(MSG_GHOSTNODE_ANNOUNCE, vecMnb[i].GetHash()));
             } else {
                 nFailed++;
-                statusObj.push_back(Pair("errorMessage", strError));
+                statusObj.push_back(Pair("errorMessage", vecError[i]));
             }
 
             resultsObj.push_back(Pair("status", statusObj));
         }
+        mnodeman.UpdateGhostnodeList(vecStarted);
+        if (!vInv.empty())
+            g_connman->RelayInvs(vInv);
         mnodeman.NotifyGhostnodeUpdates();
 
         UniValue returnObj(UniValue::VOBJ);
@@ -372,12 +417,13 @@ UniValue ghostnode(const JSONRPCRequest& req) {
 
     if (strCommand == "list-conf") {
         UniValue resultObj(UniValue::VOBJ);
-        int i = 0;
-        BOOST_FOREACH(CGhostnodeConfig::CGhostnodeEntry mne, ghostnodeConfig.getEntries()) {
-            CTxIn vin = CTxIn(uint256S(mne.getTxHash()), uint32_t(atoi(mne.getOutputIndex().c_str())));
-            CGhostnode *pmn = mnodeman.Find(vin);
+        std::vector<CGhostnodeConfig::CGhostnodeEntry> vecEntries = ghostnodeConfig.getEntries();
+        std::vector<ghostnode_info_t> vecInfo = mnodeman.GetGhostnodeInfos(ConfiguredGhostnodeVins(vecEntries));
+        for (size_t i = 0; i < vecEntries.size(); i++) {
+            const CGhostnodeConfig::CGhostnodeEntry& mne = vecEntries[i];
+            const ghostnode_info_t& info = vecInfo[i];
 
-            std::string strStatus = pmn ? pmn->GetStatus() : "MISSING";
+            std::string strStatus = info.fInfoValid ? CGhostnode::StateToString(info.nActiveState) : "MISSING";
 
             UniValue mnObj(UniValue::VOBJ);
             mnObj.push_back(Pair("alias", mne.getAlias()));
@@ -386,16 +432,50 @@ UniValue ghostnode(const JSONRPCRequest& req) {
             mnObj.push_back(Pair("txHash", mne.getTxHash()));
             mnObj.push_back(Pair("outputIndex", mne.getOutputIndex()));
             mnObj.push_back(Pair("status", strStatus));
-            mnObj.push_back(Pair("paymentAddress", pmn ? CBitcoinAddress(pmn->pubKeyCollateralAddress.GetID()).ToString() : "N/A"));
-            mnObj.push_back(Pair("lastSeen", pmn ? std::to_string(pmn->nTimeLastChecked) : "N/A"));
-            mnObj.push_back(Pair("protocolVersion", pmn ? std::to_string(pmn->nProtocolVersion) : "N/A"));
+            mnObj.push_back(Pair("paymentAddress", info.fInfoValid ? CBitcoinAddress(info.pubKeyCollateralAddress.GetID()).ToString() : "N/A"));
+            mnObj.push_back(Pair("lastSeen", info.fInfoValid ? std::to_string(info.nTimeLastChecked) : "N/A"));
+            mnObj.push_back(Pair("protocolVersion", info.fInfoValid ? std::to_string(info.nProtocolVersion) : "N/A"));
             resultObj.push_back(Pair("ghostnode_" + std::to_string(i), mnObj));
-            i++;
         }
 
         return resultObj;
     }
 
+    if (strCommand == "status-conf") {
+        std::vector<CGhostnodeConfig::CGhostnodeEntry> vecEntries = ghostnodeConfig.getEntries();
+        std::vector<ghostnode_info_t> vecInfo = mnodeman.GetGhostnodeInfos(ConfiguredGhostnodeVins(vecEntries));
+
+        int nEnabled = 0;
+        UniValue nodesArr(UniValue::VARR);
+        for (size_t i = 0; i < vecEntries.size(); i++) {
+            const CGhostnodeConfig::CGhostnodeEntry& mne = vecEntries[i];
+            const ghostnode_info_t& info = vecInfo[i];
+
+            UniValue mnObj(UniValue::VOBJ);
+            mnObj.push_back(Pair("alias", mne.getAlias()));
+            mnObj.push_back(Pair("address", mne.getIp()));
+            mnObj.push_back(Pair("outpoint", mne.getTxHash() + "-" + mne.getOutputIndex()));
+            mnObj.push_back(Pair("status", info.fInfoValid ? CGhostnode::StateToString(info.nActiveState) : "MISSING"));
+            if (info.fInfoValid) {
+                if (info.nActiveState == CGhostnode::GHOSTNODE_ENABLED)
+                    nEnabled++;
+                mnObj.push_back(Pair("protocolVersion", info.nProtocolVersion));
+                mnObj.push_back(Pair("payee", CBitcoinAddress(info.pubKeyCollateralAddress.GetID()).ToString()));
+                mnObj.push_back(Pair("lastPing", info.nTimeLastPing));
+                mnObj.push_back(Pair("activeSeconds", info.nTimeLastPing > info.sigTime ? info.nTimeLastPing - info.sigTime : 0));
+                mnObj.push_back(Pair("lastPaidTime", info.nTimeLastPaid));
+            }
+            nodesArr.push_back(mnObj);
+        }
+
+        UniValue resultObj(UniValue::VOBJ);
+        resultObj.push_back(Pair("time", GetAdjustedTime()));
+        resultObj.push_back(Pair("total", (int)vecEntries.size()));
+        resultObj.push_back(Pair("enabled", nEnabled));
+        resultObj.push_back(Pair("ghostnodes", nodesArr));
+        return resultObj;
+    }
+
     if (strCommand == "outputs") {
         // Find possible candidates
         std::vector <COutput> vPossibleCoins;
@@ -415,18 +495,7 @@ UniValue ghostnode(const JSONRPCRequest& req) {
         if (!fGhostNode)
             throw JSONRPCError(RPC_INTERNAL_ERROR, "This is not a ghostnode");
 
-        UniValue mnObj(UniValue::VOBJ);
-
-        mnObj.push_back(Pair("vin", activeGhostnode.vin.ToString()));
-        mnObj.push_back(Pair("service", activeGhostnode.service.ToString()));
-
-        CGhostnode mn;
-        if (mnodeman.Get(activeGhostnode.vin, mn)) {
-            mnObj.push_back(Pair("payee", CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString()));
-        }
-
-        mnObj.push_back(Pair("status", activeGhostnode.GetStatus()));
-        return mnObj;
+        return ActiveGhostnodeStatusToJSON();
     }
 
     if (strCommand == "winners") {
@@ -468,6 +537,50 @@ UniValue ghostnode(const JSONRPCRequest& req) {
     return NullUniValue;
 }
 
+UniValue waitforghostnodestatus(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            "waitforghostnodestatus ( \"status\" timeout )\n"
+            "\nWaits for the status of this ghostnode to differ from the given one and returns it, as 'ghostnode status' does.\n"
+            "\nReturns the current status on timeout or exit.\n"
+            "\nArguments:\n"
+            "1. \"status\"  (string, optional) The status last seen, the current one if not given\n"
+            "2. timeout     (int, optional, default=0) Time in milliseconds to wait for a response. 0 indicates no timeout.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"vin\" : \"...\",       (string) The collateral input\n"
+            "  \"service\" : \"...\",   (string) The address the ghostnode runs on\n"
+            "  \"payee\" : \"...\",     (string) The collateral address, once the ghostnode is in the list\n"
+            "  \"status\" : \"...\"     (string) The status\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("waitforghostnodestatus", "\"\" 60000")
+            + HelpExampleRpc("waitforghostnodestatus", "\"\", 60000")
+        );
+
+    if (!fGhostNode)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "This is not a ghostnode");
+
+    std::string strStatus = activeGhostnode.GetStatus();
+    if (!request.params[0].isNull() && !request.params[0].get_str().empty())
+        strStatus = request.params[0].get_str();
+    int timeout = 0;
+    if (!request.params[1].isNull())
+        timeout = request.params[1].get_int();
+
+    {
+        // woken by NotifyStateChange() when the status changes, on new tips and on shutdown
+        WaitableLock lock(csBestBlock);
+        auto changed = [&strStatus]{ return activeGhostnode.GetStatus() != strStatus || !IsRPCRunning(); };
+        if (timeout)
+            cvBlockChange.wait_for(lock, std::chrono::milliseconds(timeout), changed);
+        else
+            cvBlockChange.wait(lock, changed);
+    }
+    return ActiveGhostnodeStatusToJSON();
+}
+
 UniValue ghostnodelist(const JSONRPCRequest &req) {
     UniValue params = req.params;
     bool fHelp = req.fHelp;
@@ -524,8 +637,8 @@ UniValue ghostnodelist(const JSONRPCRequest &req) {
             obj.push_back(Pair(strOutpoint, s.first));
         }
     } else {
-        std::vector <CGhostnode> vGhostnodes = mnodeman.GetFullGhostnodeVector();
-        for(CGhostnode & mn: vGhostnodes)
+        std::shared_ptr<const std::vector<CGhostnode> > pGhostnodes = mnodeman.GetGhostnodeListSnapshot();
+        for(const CGhostnode & mn: *pGhostnodes)
         {
             std::string strOutpoint = mn.vin.prevout.ToStringShort();
             if (strMode == "activeseconds") {
@@ -590,10 +703,13 @@ UniValue ghostnodelist(const JSONRPCRequest &req) {
                     nBlockHeight = pindex->nHeight;
                 }
                 int nMnCount = mnodeman.CountEnabled();
-                char* reasonStr = mnodeman.GetNotQualifyReason(mn, nBlockHeight, true, nMnCount);
+                std::string strReason;
+                // the snapshot is shared, the checks cache collateral data in the entry they get
+                CGhostnode mnQualify(mn);
+                bool fQualified = mnodeman.IsQualifiedForPayment(mnQualify, nBlockHeight, true, nMnCount, &strReason);
                 std::string strOutpoint = mn.vin.prevout.ToStringShort();
                 if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, (reasonStr != NULL) ? reasonStr : "true"));
+                obj.push_back(Pair(strOutpoint, fQualified ? "true" : strReason));
             }
         }
     }
@@ -16,6 +16,12 @@ CSporkManager sporkManager;
 
 std::map<uint256, CSporkMessage> mapSporks;
 
+CSporkManager::CSporkManager() : nSporksSigned(0)
+{
+    for (int nSporkID = SPORK_START; nSporkID <= SPORK_END; nSporkID++)
+        arrSporkValues[nSporkID - SPORK_START] = GetSporkDefaultValue(nSporkID);
+}
+
 void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
 {
     if(fLiteMode) return; // disable all Dash specific functionality
@@ -36,25 +42,33 @@ void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStr
             strLogMsg = strprintf("SPORK -- hash: %s id: %d value: %10d bestHeight: %d peer=%d", hash.ToString(), spork.nSporkID, spork.nValue, chainActive.Height(), pfrom->GetId());
         }
 
-        if(mapSporksActive.count(spork.nSporkID)) {
-            if (mapSporksActive[spork.nSporkID].nTimeSigned >= spork.nTimeSigned) {
-                //LogPrint("spork", "%s seen\n", strLogMsg);
-                return;
+        bool fInvalidSignature = false;
+        {
+            LOCK(cs);
+            if(mapSporksActive.count(spork.nSporkID)) {
+                if (mapSporksActive[spork.nSporkID].nTimeSigned >= spork.nTimeSigned) {
+                    //LogPrint("spork", "%s seen\n", strLogMsg);
+                    return;
+                } else {
+                    //LogPrint("%s updated\n", strLogMsg);
+                }
             } else {
-                //LogPrint("%s updated\n", strLogMsg);
+                //LogPrint("%s new\n", strLogMsg);
             }
-        } else {
-            //LogPrint("%s new\n", strLogMsg);
-        }
 
-        if(!spork.CheckSignature()) {
-            //LogPrint("CSporkManager::ProcessSpork -- invalid signature\n");
+            if(!spork.CheckSignature()) {
+                //LogPrint("CSporkManager::ProcessSpork -- invalid signature\n");
+                fInvalidSignature = true;
+            } else {
+                mapSporks[hash] = spork;
+                mapSporksActive[spork.nSporkID] = spork;
+                SetSporkValue(spork.nSporkID, spork.nValue);
+            }
+        }
+        if (fInvalidSignature) {
             Misbehaving(pfrom->GetId(), 100);
             return;
         }
-
-        mapSporks[hash] = spork;
-        mapSporksActive[spork.nSporkID] = spork;
         spork.Relay();
 
         //does a task if needed
@@ -62,6 +76,7 @@ void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStr
 
     } else if (strCommand == NetMsgType::GETSPORKS) {
 
+        LOCK(cs);
         std::map<int, CSporkMessage>::iterator it = mapSporksActive.begin();
 
         while(it != mapSporksActive.end()) {
@@ -110,48 +125,47 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue)
 
     if(spork.Sign(strMasterPrivKey)) {
         spork.Relay();
+        LOCK(cs);
         mapSporks[spork.GetHash()] = spork;
         mapSporksActive[nSporkID] = spork;
+        SetSporkValue(nSporkID, nValue);
         return true;
     }
 
     return false;
 }
 
+void CSporkManager::SetSporkValue(int nSporkID, int64_t nValue)
+{
+    if (nSporkID < SPORK_START || nSporkID > SPORK_END)
+        return;
+    arrSporkValues[nSporkID - SPORK_START].store(nValue, std::memory_order_relaxed);
+    nSporksSigned.fetch_or(1u << (nSporkID - SPORK_START), std::memory_order_release);
+}
+
 // grab the spork, otherwise say it's off
 bool CSporkManager::IsSporkActive(int nSporkID)
 {
-    int64_t r = -1;
-
-    if(mapSporksActive.count(nSporkID)){
-        r = mapSporksActive[nSporkID].nValue;
-    } else {
-        switch (nSporkID) {
-            case SPORK_2_INSTANTSEND_ENABLED:               r = SPORK_2_INSTANTSEND_ENABLED_DEFAULT; break;
-            case SPORK_3_INSTANTSEND_BLOCK_FILTERING:       r = SPORK_3_INSTANTSEND_BLOCK_FILTERING_DEFAULT; break;
-            case SPORK_5_INSTANTSEND_MAX_VALUE:             r = SPORK_5_INSTANTSEND_MAX_VALUE_DEFAULT; break;
-            case SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT:    r = SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT_DEFAULT; break;
-            case SPORK_9_SUPERBLOCKS_ENABLED:               r = SPORK_9_SUPERBLOCKS_ENABLED_DEFAULT; break;
-            case SPORK_10_GHOSTNODE_PAY_UPDATED_NODES:     r = SPORK_10_GHOSTNODE_PAY_UPDATED_NODES_DEFAULT; break;
-            case SPORK_12_RECONSIDER_BLOCKS:                r = SPORK_12_RECONSIDER_BLOCKS_DEFAULT; break;
-            case SPORK_13_OLD_SUPERBLOCK_FLAG:              r = SPORK_13_OLD_SUPERBLOCK_FLAG_DEFAULT; break;
-            case SPORK_14_REQUIRE_SENTINEL_FLAG:            r = SPORK_14_REQUIRE_SENTINEL_FLAG_DEFAULT; break;
-            default:
-                //LogPrint("spork", "CSporkManager::IsSporkActive -- Unknown Spork ID %d\n", nSporkID);
-                r = 4070908800ULL; // 2099-1-1 i.e. off by default
-                break;
-        }
-    }
+    if (nSporkID < SPORK_START || nSporkID > SPORK_END)
+        return false;
+    // sporks without a default stay off until a signed value arrives
+    if (!(nSporksSigned.load(std::memory_order_acquire) & (1u << (nSporkID - SPORK_START))) &&
+            GetSporkDefaultValue(nSporkID) == -1)
+        return false;
 
-    return r < GetTime();
+    return arrSporkValues[nSporkID - SPORK_START].load(std::memory_order_relaxed) < GetTime();
 }
 
 // grab the value of the spork on the network, or the default
 int64_t CSporkManager::GetSporkValue(int nSporkID)
 {
-    if (mapSporksActive.count(nSporkID))
-        return mapSporksActive[nSporkID].nValue;
+    if (nSporkID < SPORK_START || nSporkID > SPORK_END)
+        return -1;
+    return arrSporkValues[nSporkID - SPORK_START].load(std::memory_order_relaxed);
+}
 
+int64_t CSporkManager::GetSporkDefaultValue(int nSporkID)
+{
     switch (nSporkID) {
         case SPORK_2_INSTANTSEND_ENABLED:               return SPORK_2_INSTANTSEND_ENABLED_DEFAULT;
         case SPORK_3_INSTANTSEND_BLOCK_FILTERING:       return SPORK_3_INSTANTSEND_BLOCK_FILTERING_DEFAULT;
@@ -163,7 +177,7 @@ int64_t CSporkManager::GetSporkValue(int nSporkID)
         case SPORK_13_OLD_SUPERBLOCK_FLAG:              return SPORK_13_OLD_SUPERBLOCK_FLAG_DEFAULT;
         case SPORK_14_REQUIRE_SENTINEL_FLAG:            return SPORK_14_REQUIRE_SENTINEL_FLAG_DEFAULT;
         default:
-            //LogPrint("spork", "CSporkManager::GetSporkValue -- Unknown Spork ID %d\n", nSporkID);
+            //LogPrint("spork", "CSporkManager::GetSporkDefaultValue -- Unknown Spork ID %d\n", nSporkID);
             return -1;
     }
 
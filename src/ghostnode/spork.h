@@ -12,6 +12,9 @@
 #include "utilstrencodings.h"
 #include "util.h"
 
+#include <array>
+#include <atomic>
+
 class CSporkMessage;
 
 /*
@@ -101,11 +104,22 @@ class CSporkManager
 private:
     std::vector<unsigned char> vchSig;
     std::string strMasterPrivKey;
+    // protects mapSporksActive
+    CCriticalSection cs;
     std::map<int, CSporkMessage> mapSporksActive;
 
+    // Current value of every spork id in range, indexed by nSporkID - SPORK_START.
+    // Written only after a spork's signature checks out, read without locking.
+    std::array<std::atomic<int64_t>, SPORK_END - SPORK_START + 1> arrSporkValues;
+    // Bit nSporkID - SPORK_START is set once a signed message for that spork was accepted
+    std::atomic<uint32_t> nSporksSigned;
+
+    static int64_t GetSporkDefaultValue(int nSporkID);
+    void SetSporkValue(int nSporkID, int64_t nValue);
+
 public:
 
-    CSporkManager() {}
+    CSporkManager();
 
     void ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
     void ExecuteSpork(int nSporkID, int nValue);
@@ -8,79 +8,107 @@
 #include <iostream>
 #include <string>
 #include <util.h>
+#include <fs.h>
+
+#include <algorithm>
+
+#include <boost/algorithm/string.hpp>
 
 CGovernance g_governance;
 uint64_t last_refresh_time = 0;
 
 std::vector<char> g_data;
 
+// Whether the body of the current response uses chunked transfer encoding
+static bool g_chunked = false;
+// Whether the server answered 304, the cached proposal list is still current
+static bool g_not_modified = false;
+// Validators of the current response
+static std::string g_etag;
+static std::string g_last_modified;
+
+// Endpoints of the governance server from the last successful resolve
+static std::vector<tcp::endpoint> g_endpoints;
+static int64_t g_endpoints_time = 0;
+static const int64_t ENDPOINT_CACHE_TIME = 60 * 60;
+
+// Strips the chunk framing of a chunked response body
+static std::string DecodeChunked(const std::string& body)
+{
+    std::string result;
+    size_t pos = 0;
+    while (pos < body.size()) {
+        size_t eol = body.find("\r\n", pos);
+        if (eol == std::string::npos)
+            break;
+        size_t chunkSize = strtoul(body.substr(pos, eol - pos).c_str(), nullptr, 16);
+        if (chunkSize == 0)
+            break;
+        pos = eol + 2;
+        result.append(body, pos, chunkSize);
+        pos += chunkSize + 2;
+    }
+    return result;
+}
+
+// Field values are kept as their text, whether the server sends them as strings or numbers
+static std::string GetFieldText(const UniValue& obj, const std::string& key)
+{
+    const UniValue& value = find_value(obj, key);
+    if (value.isNull())
+        return "";
+    if (value.isStr())
+        return value.get_str();
+    return value.write();
+}
+
+static void ParseEntry(const UniValue& entry)
+{
+    if (!entry.isObject())
+        return;
+
+    //  parse proposal and place into proposal list
+    if (!g_governance.isPost) {
+        Proposals prop;
+        prop.vote_id = GetFieldText(entry, "voteid");
+        prop.name = GetFieldText(entry, "name");
+        prop.start_time = GetFieldText(entry, "date");
+        prop.end_time = GetFieldText(entry, "expiration");
+        prop.details = GetFieldText(entry, "details");
+        prop.address = GetFieldText(entry, "address");
+        prop.amount = GetFieldText(entry, "amount");
+        prop.txid = GetFieldText(entry, "txid");
+        prop.votes_affirm = GetFieldText(entry, "affirm");
+        prop.votes_oppose = GetFieldText(entry, "oppose");
+        g_governance.proposals.push_back(prop);
+    }
+    else {
+        Votes prop;
+        prop.vote_id = GetFieldText(entry, "voteid");
+        prop.address = GetFieldText(entry, "address");
+        prop.signature = GetFieldText(entry, "signature");
+        prop.vote = GetFieldText(entry, "ballot");
+        prop.weight = GetFieldText(entry, "weight");
+        g_governance.votes.push_back(prop);
+    }
+}
+
 void ParseProposals(){
-    while(g_governance.g_data.find("{") != std::string::npos){
-        bool isPost = g_governance.isPost;
-        // check first proposal
-        unsigned first = g_governance.g_data.find("{");
-        unsigned last = g_governance.g_data.find("}");
-        std::string propStr = g_governance.g_data.substr (first,last-first);
-
-        // delete first proposal
-        g_governance.g_data = g_governance.g_data.substr(last + 1);
-
-        //  parse proposal and place into proposal list
-        if(!isPost){
-            Proposals prop;
-            first = propStr.find("\"voteid\":") + 10;
-            last = propStr.find(",\"name\"") - 1;
-            prop.vote_id = propStr.substr (first,last-first);
-            first = propStr.find("\"name\":") + 8;
-            last = propStr.find(",\"date\"") - 1;
-            prop.name = propStr.substr (first,last-first);
-            first = propStr.find("\"date\":") + 7;
-            last = propStr.find(",\"expiration\"");
-            prop.start_time = propStr.substr (first,last-first);
-            first = propStr.find("\"expiration\":") + 13;
-            last = propStr.find(",\"details\"");
-            prop.end_time = propStr.substr (first,last-first);
-            first = propStr.find("\"details\":") + 11;
-            last = propStr.find(",\"address\"") - 1;
-            prop.details = propStr.substr (first,last-first);
-            first = propStr.find("\"address\":") + 11;
-            last = propStr.find(",\"amount\"") - 1;
-            prop.address = propStr.substr (first,last-first);
-            first = propStr.find("\"amount\":") + 9;
-            last = propStr.find(",\"txid\"");
-            prop.amount = propStr.substr (first,last-first);
-            first = propStr.find("\"txid\":") + 8;
-            last = propStr.find(",\"affirm\"") - 1;
-            prop.txid = propStr.substr (first,last-first);
-            first = propStr.find("\"affirm\":") + 9;
-            last = propStr.find(",\"oppose\"");
-            prop.votes_affirm = propStr.substr (first,last-first);
-            first = propStr.find("\"oppose\":") + 9;
-            last = propStr.find("}") - 3;
-            prop.votes_oppose = propStr.substr (first,last-first);
-            g_governance.proposals.push_back(prop);
-        }
-        else{
-            Votes prop;
-            first = propStr.find("\"voteid\":") + 10;
-            last = propStr.find(",\"address\"") - 1;
-            prop.vote_id = propStr.substr (first,last-first);
-            first = propStr.find("\"address\":") + 11;
-            last = propStr.find(",\"signature\"") - 1;
-            prop.address = propStr.substr (first,last-first);
-            first = propStr.find("\"signature\":") + 13;
-            last = propStr.find(",\"ballot\"") - 1;
-            prop.signature = propStr.substr (first,last-first);
-            first = propStr.find("\"ballot\":") + 8;
-            last = propStr.find(",\"weight\"");
-            prop.vote = propStr.substr (first,last-first);
-            first = propStr.find("\"weight\":") + 9;
-            last = propStr.find("}") - 3;
-            prop.weight = propStr.substr (first,last-first);
-            g_governance.votes.push_back(prop);
-        }
+    UniValue response;
+    if (!response.read(g_governance.g_data)) {
+        LogPrintf("ParseProposals(): invalid governance response\n");
+        return;
     }
 
+    // A list of entries, a paginated envelope holding one, or a single entry
+    const UniValue& results = response.isObject() ? find_value(response, "results") : NullUniValue;
+    const UniValue& entries = results.isArray() ? results : response;
+    if (entries.isArray()) {
+        for (size_t i = 0; i < entries.size(); i++)
+            ParseEntry(entries[i]);
+    } else {
+        ParseEntry(entries);
+    }
 }
 
 void OnDataReceived(char* data, size_t dataLen)
@@ -92,16 +120,28 @@ void OnDataReceived(char* data, size_t dataLen)
 
 void OnRequestCompleted()
 {
-    // print contents of data we received back...
-    g_data.push_back('\0');
-    g_governance.g_data = std::string(g_data.begin(), g_data.end());
+    if (g_not_modified) {
+        g_data.clear();
+        g_governance.setReady();
+        return;
+    }
+
+    g_governance.g_data.assign(g_data.begin(), g_data.end());
+    if (g_chunked)
+        g_governance.g_data = DecodeChunked(g_governance.g_data);
     if(g_governance.isPost)
         g_governance.votes.clear();
     else
         g_governance.proposals.clear();
 
     ParseProposals();
+    if (g_governance.requestType == GET_PROPOSALS && g_governance.statusOK && !g_governance.proposals.empty()) {
+        g_governance.etag = g_etag;
+        g_governance.lastModified = g_last_modified;
+        g_governance.WriteCache(g_governance.g_data);
+    }
     g_data.clear();
+    g_governance.g_data.clear();
     g_governance.setReady();
 }
 
@@ -109,7 +149,9 @@ void OnRequestCompleted()
 void OnRequestFailed()
 {
     g_data.clear();
-    g_governance.statusOK = false;
+    g_endpoints.clear();
+    // Keep serving the last proposal list while the server is unreachable
+    g_governance.statusOK = g_governance.requestType == GET_PROPOSALS && !g_governance.proposals.empty();
     g_governance.setReady();
 }
 
@@ -119,18 +161,78 @@ CGovernance::CGovernance():
 {
     ready = true;
     isPost = false;
+    statusOK = false;
+    requestType = GET_PROPOSALS;
+    cacheLoaded = false;
 }
 
 CGovernance::~CGovernance(){
 
 }
 
+void CGovernance::LoadCache()
+{
+    if (cacheLoaded)
+        return;
+    cacheLoaded = true;
+
+    fs::ifstream file(GetDataDir() / GOVERNANCE_CACHE_FILE);
+    if (!file.is_open())
+        return;
+    std::string str((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    UniValue cache;
+    if (!cache.read(str) || !cache.isObject() || !find_value(cache, "body").isStr()) {
+        LogPrintf("CGovernance::LoadCache(): ignoring invalid %s\n", GOVERNANCE_CACHE_FILE);
+        return;
+    }
+
+    isPost = false;
+    proposals.clear();
+    g_data = find_value(cache, "body").get_str();
+    ParseProposals();
+    g_data.clear();
+    if (proposals.empty())
+        return;
+
+    // Served until the first refresh succeeds
+    statusOK = true;
+    if (find_value(cache, "etag").isStr())
+        etag = find_value(cache, "etag").get_str();
+    if (find_value(cache, "last_modified").isStr())
+        lastModified = find_value(cache, "last_modified").get_str();
+}
+
+void CGovernance::WriteCache(const std::string& body)
+{
+    UniValue cache(UniValue::VOBJ);
+    cache.pushKV("etag", etag);
+    cache.pushKV("last_modified", lastModified);
+    cache.pushKV("body", body);
+
+    fs::path pathTmp = GetDataDir() / (GOVERNANCE_CACHE_FILE + ".new");
+    {
+        fs::ofstream file(pathTmp, std::ios_base::out | std::ios_base::trunc);
+        if (!file.is_open())
+            return;
+        file << cache.write();
+        if (!file.good())
+            return;
+    }
+    if (!RenameOver(pathTmp, GetDataDir() / GOVERNANCE_CACHE_FILE))
+        LogPrintf("CGovernance::WriteCache(): failed to write %s\n", GOVERNANCE_CACHE_FILE);
+}
+
 void CGovernance::SendRequests(RequestTypes rType, std::string json){
 
     while(!ready){}
     std::string urlRequest = "";
     bool isGet = true;
 
+    if (rType == GET_PROPOSALS)
+        LoadCache();
+
+    requestType = rType;
     isPost = false;
     switch (rType) {
         case GET_PROPOSALS: {
@@ -213,6 +315,12 @@ void HTTPGetRequest::sendRequest(bool isGet)
     request_stream << "Host: " << m_host << "\r\n";
     request_stream << "Accept: */*\r\n";
     request_stream << "Content-Type: application/json\r\n";
+    if (isGet && g_governance.requestType == GET_PROPOSALS) {
+        if (!g_governance.etag.empty())
+            request_stream << "If-None-Match: " << g_governance.etag << "\r\n";
+        if (!g_governance.lastModified.empty())
+            request_stream << "If-Modified-Since: " << g_governance.lastModified << "\r\n";
+    }
     if(isGet)
         request_stream << "Connection: close\r\n\r\n";
     else{
@@ -220,6 +328,24 @@ void HTTPGetRequest::sendRequest(bool isGet)
         request_stream << m_postURL;
     }
 
+    // Skip the lookup while the server's endpoints are known
+    if (!g_endpoints.empty() && GetTime() < g_endpoints_time + ENDPOINT_CACHE_TIME) {
+        #ifdef USING_SSL
+        m_socket.set_verify_mode(boost::asio::ssl::verify_peer);
+        m_socket.set_verify_callback(
+                    boost::bind(&HTTPGetRequest::VerifyCertificate, this, _1, _2));
+
+        boost::asio::async_connect(m_socket.lowest_layer(), g_endpoints.begin(), g_endpoints.end(),
+                                   boost::bind(&HTTPGetRequest::HandleConnect, this,
+                                               boost::asio::placeholders::error));
+        #else
+        boost::asio::async_connect(m_socket, g_endpoints.begin(), g_endpoints.end(),
+                                   boost::bind(&HTTPGetRequest::HandleConnect, this,
+                                               boost::asio::placeholders::error));
+        #endif
+        return;
+    }
+
     #ifdef USING_SSL
     tcp::resolver::query query(m_host, "https");
     #else
@@ -238,6 +364,8 @@ void HTTPGetRequest::HandleResolve(const boost::system::error_code& err,
     if (!err)
     {
         //LogPrintf("HTTPGetRequest::HandleResolve(): Resolve OK \n");
+        g_endpoints.assign(endpoint_iterator, tcp::resolver::iterator());
+        g_endpoints_time = GetTime();
 
 
     #ifdef USING_SSL
@@ -370,7 +498,8 @@ void HTTPGetRequest::HandleReadStatus(const boost::system::error_code& err)
             LogPrintf("HTTPGetRequest::HandleReadStatus(): Invalid response \n");
             OnRequestFailed();
         }
-        if (status_code != 200 && status_code != 201 && status_code != 202 && status_code != 400)
+        g_not_modified = status_code == 304;
+        if (status_code != 200 && status_code != 201 && status_code != 202 && status_code != 304 && status_code != 400)
         {
             LogPrintf("HTTPGetRequest::HandleReadStatus(): status code error: %d \n", status_code);
             OnRequestFailed();
@@ -406,7 +535,20 @@ void HTTPGetRequest::HandleReadHeaders(const boost::system::error_code& err)
         std::istream response_stream(&m_response);
         std::string header;
         //LogPrintf("HTTPGetRequest::HandleReadHeaders(): \n");
-        while (std::getline(response_stream, header) && header != "\r") {}
+        g_chunked = false;
+        g_etag.clear();
+        g_last_modified.clear();
+        while (std::getline(response_stream, header) && header != "\r") {
+            std::string name = header.substr(0, header.find(':'));
+            std::string value = header.size() > name.size() ? boost::trim_copy(header.substr(name.size() + 1)) : "";
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            if (name == "transfer-encoding" && value.find("chunked") != std::string::npos)
+                g_chunked = true;
+            else if (name == "etag")
+                g_etag = value;
+            else if (name == "last-modified")
+                g_last_modified = value;
+        }
 
         // Start reading remaining data until EOF.
         #ifdef USING_SSL
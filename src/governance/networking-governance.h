@@ -10,6 +10,7 @@
 #include <amount.h>
 #include <univalue.h>
 
+#include <atomic>
 #include <stdexcept>
 #include <vector>
 
@@ -27,6 +28,9 @@ static const std::string GOVERNANCE_URL = "gov.nixplatform.io";
 // amount of time in second for how often to refresh proposals
 static const uint64_t REFRESH_TIME = 5;
 
+// file in the data directory the last proposal list is kept in
+static const std::string GOVERNANCE_CACHE_FILE = "governance.json";
+
 extern CGovernance g_governance;
 extern uint64_t last_refresh_time;
 
@@ -93,18 +97,28 @@ struct Votes{
 class CGovernance
 {
 private:
-    bool ready;
+    std::atomic<bool> ready;
 
 public:
     CGovernance();
     ~CGovernance();
 
     void SendRequests(RequestTypes rType, std::string json = "");
+    //! Loads the proposal list saved by the last successful refresh, if not loaded yet
+    void LoadCache();
+    //! Saves the proposal response body and its validators for revalidation and the next start
+    void WriteCache(const std::string& body);
     //data
     std::string g_data;
     bool statusOK;
     bool isPost;
 
+    RequestTypes requestType;
+    // Validators of the cached proposal list, sent as If-None-Match and If-Modified-Since
+    std::string etag;
+    std::string lastModified;
+    bool cacheLoaded;
+
     std::vector<Proposals> proposals;
     std::vector<Votes> votes;
 
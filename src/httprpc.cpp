@@ -10,10 +10,13 @@
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <random.h>
+#include <streams.h>
 #include <sync.h>
+#include <uint256.h>
 #include <util.h>
 #include <utilstrencodings.h>
 #include <ui_interface.h>
+#include <version.h>
 #include <crypto/hmac_sha256.h>
 #include <stdio.h>
 
@@ -142,14 +145,9 @@ static bool RPCAuthorized(const std::string& strAuth, std::string& strAuthUserna
     return multiUserAuthorized(strUserPass);
 }
 
-static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
+/** Check the credentials of a request, replying 401 Unauthorized when they are missing or wrong */
+static bool HTTPAuthorized(HTTPRequest* req, std::string& strAuthUsernameOut)
 {
-    // JSONRPC handles only POST
-    if (req->GetRequestMethod() != HTTPRequest::POST) {
-        req->WriteReply(HTTP_BAD_METHOD, "JSONRPC server handles only POST requests");
-        return false;
-    }
-    // Check authorization
     std::pair<bool, std::string> authHeader = req->GetHeader("authorization");
     if (!authHeader.first) {
         req->WriteHeader("WWW-Authenticate", WWW_AUTH_HEADER_DATA);
@@ -157,8 +155,7 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         return false;
     }
 
-    JSONRPCRequest jreq;
-    if (!RPCAuthorized(authHeader.second, jreq.authUser)) {
+    if (!RPCAuthorized(authHeader.second, strAuthUsernameOut)) {
         LogPrintf("ThreadRPCServer incorrect password attempt from %s\n", req->GetPeer().ToString());
 
         /* Deter brute-forcing
@@ -170,6 +167,20 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         req->WriteReply(HTTP_UNAUTHORIZED);
         return false;
     }
+    return true;
+}
+
+static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
+{
+    // JSONRPC handles only POST
+    if (req->GetRequestMethod() != HTTPRequest::POST) {
+        req->WriteReply(HTTP_BAD_METHOD, "JSONRPC server handles only POST requests");
+        return false;
+    }
+    // Check authorization
+    JSONRPCRequest jreq;
+    if (!HTTPAuthorized(req, jreq.authUser))
+        return false;
 
     try {
         // Parse request
@@ -192,7 +203,7 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 
         // array of requests
         } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(jreq, valRequest.get_array());
+            strReply = JSONRPCExecBatch(jreq, valRequest.get_array(), HTTPRunOnWorker, HTTPWorkerCount() - 1);
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
@@ -208,6 +219,170 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
     return true;
 }
 
+/** Methods served on /rpcbin, by the id a request frame starts with */
+enum BinaryRPCMethod : uint8_t {
+    RPCBIN_SENDRAWTRANSACTION = 0,
+    RPCBIN_GETRAWTRANSACTION = 1,
+    RPCBIN_GETBLOCK = 2,
+    RPCBIN_GETBLOCKHEADER = 3,
+    RPCBIN_GETADDRESSUTXOS = 4,
+};
+
+/** Turn the params of a binary request frame into those of the JSON method */
+static UniValue BinaryRPCParams(uint8_t nMethod, CDataStream& ssFrame, std::string& strMethodOut)
+{
+    UniValue params(UniValue::VARR);
+    switch (nMethod) {
+    case RPCBIN_SENDRAWTRANSACTION: {
+        bool fAllowHighFees;
+        ssFrame >> fAllowHighFees;
+        // the rest of the frame is the transaction, decoded by the method
+        strMethodOut = "sendrawtransaction";
+        params.push_back(HexStr(ssFrame.begin(), ssFrame.end()));
+        params.push_back(fAllowHighFees);
+        ssFrame.clear();
+        break;
+    }
+    case RPCBIN_GETRAWTRANSACTION:
+    case RPCBIN_GETBLOCK:
+    case RPCBIN_GETBLOCKHEADER: {
+        uint256 hash;
+        ssFrame >> hash;
+        strMethodOut = nMethod == RPCBIN_GETRAWTRANSACTION ? "getrawtransaction" :
+                       nMethod == RPCBIN_GETBLOCK ? "getblock" : "getblockheader";
+        params.push_back(hash.GetHex());
+        // not verbose, the result is the hex of the serialized object
+        if (nMethod == RPCBIN_GETBLOCK)
+            params.push_back(0);
+        else
+            params.push_back(false);
+        break;
+    }
+    case RPCBIN_GETADDRESSUTXOS: {
+        std::vector<std::string> vAddresses;
+        int32_t nLimit;
+        std::string strAfter;
+        ssFrame >> vAddresses >> nLimit >> strAfter;
+        strMethodOut = "getaddressutxos";
+        UniValue addresses(UniValue::VARR);
+        for (const std::string& strAddress : vAddresses)
+            addresses.push_back(strAddress);
+        UniValue options(UniValue::VOBJ);
+        options.pushKV("addresses", addresses);
+        if (nLimit > 0) {
+            options.pushKV("limit", nLimit);
+            if (!strAfter.empty())
+                options.pushKV("after", strAfter);
+        }
+        params.push_back(options);
+        break;
+    }
+    default:
+        throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
+    }
+    if (!ssFrame.empty())
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Unexpected data at the end of the frame");
+    return params;
+}
+
+/** Serialize the result of the JSON method behind a binary request */
+static void WriteBinaryRPCResult(uint8_t nMethod, const UniValue& result, CDataStream& ssOut)
+{
+    switch (nMethod) {
+    case RPCBIN_SENDRAWTRANSACTION:
+        ssOut << uint256S(result.get_str());
+        break;
+    case RPCBIN_GETRAWTRANSACTION:
+    case RPCBIN_GETBLOCK:
+    case RPCBIN_GETBLOCKHEADER: {
+        std::vector<unsigned char> vch(ParseHex(result.get_str()));
+        ssOut.write((const char*)vch.data(), vch.size());
+        break;
+    }
+    case RPCBIN_GETADDRESSUTXOS: {
+        // a page when a limit was given, all of them otherwise
+        const UniValue& utxos = result.isObject() ? find_value(result, "utxos") : result;
+        WriteCompactSize(ssOut, utxos.size());
+        for (size_t i = 0; i < utxos.size(); i++) {
+            const UniValue& utxo = utxos[i];
+            ssOut << find_value(utxo, "address").get_str();
+            ssOut << uint256S(find_value(utxo, "txid").get_str());
+            ssOut << (uint32_t)find_value(utxo, "outputIndex").get_int();
+            ssOut << ParseHex(find_value(utxo, "script").get_str());
+            ssOut << find_value(utxo, "satoshis").get_int64();
+            ssOut << (int32_t)find_value(utxo, "height").get_int();
+        }
+        const UniValue& next = result.isObject() ? find_value(result, "next") : NullUniValue;
+        ssOut << (next.isStr() ? next.get_str() : std::string());
+        break;
+    }
+    }
+}
+
+/**
+ * Binary counterpart of the JSON-RPC endpoint for the methods moving raw transactions and blocks.
+ * The body is a sequence of frames, each a compact size length followed by a method id and its
+ * serialized params. Every frame is run through the RPC table like a JSON request and answered
+ * by a frame of the same form holding an int32 code, 0 followed by the serialized result or an
+ * RPC error code followed by the message. See doc/binary-rpc.md.
+ */
+static bool HTTPReq_BinaryRPC(HTTPRequest* req, const std::string &)
+{
+    if (req->GetRequestMethod() != HTTPRequest::POST) {
+        req->WriteReply(HTTP_BAD_METHOD, "Binary RPC server handles only POST requests");
+        return false;
+    }
+    std::string strAuthUser;
+    if (!HTTPAuthorized(req, strAuthUser))
+        return false;
+
+    std::string strBody = req->ReadBody();
+    CDataStream ssBody(strBody.data(), strBody.data() + strBody.size(), SER_NETWORK, PROTOCOL_VERSION);
+    CDataStream ssReply(SER_NETWORK, PROTOCOL_VERSION);
+    try {
+        while (!ssBody.empty()) {
+            uint64_t nLen = ReadCompactSize(ssBody);
+            if (nLen == 0 || nLen > ssBody.size())
+                throw std::ios_base::failure("frame length out of range");
+            CDataStream ssFrame(ssBody.begin(), ssBody.begin() + nLen, SER_NETWORK, PROTOCOL_VERSION);
+            ssBody.ignore(nLen);
+
+            CDataStream ssResult(SER_NETWORK, PROTOCOL_VERSION);
+            try {
+                uint8_t nMethod;
+                ssFrame >> nMethod;
+
+                JSONRPCRequest jreq;
+                jreq.authUser = strAuthUser;
+                jreq.URI = req->GetURI();
+                try {
+                    jreq.params = BinaryRPCParams(nMethod, ssFrame, jreq.strMethod);
+                } catch (const std::ios_base::failure& e) {
+                    throw JSONRPCError(RPC_DESERIALIZATION_ERROR, e.what());
+                }
+                UniValue result = tableRPC.execute(jreq);
+                ssResult << (int32_t)0;
+                WriteBinaryRPCResult(nMethod, result, ssResult);
+            } catch (const UniValue& objError) {
+                ssResult.clear();
+                ssResult << (int32_t)find_value(objError, "code").get_int() << find_value(objError, "message").get_str();
+            } catch (const std::exception& e) {
+                ssResult.clear();
+                ssResult << (int32_t)RPC_MISC_ERROR << std::string(e.what());
+            }
+            WriteCompactSize(ssReply, ssResult.size());
+            ssReply.write(ssResult.data(), ssResult.size());
+        }
+    } catch (const std::exception& e) {
+        req->WriteReply(HTTP_BAD_REQUEST, strprintf("Malformed frame: %s", e.what()));
+        return false;
+    }
+
+    req->WriteHeader("Content-Type", "application/octet-stream");
+    req->WriteReply(HTTP_OK, std::string(ssReply.begin(), ssReply.end()));
+    return true;
+}
+
 static bool InitRPCAuthentication()
 {
     if (gArgs.GetArg("-rpcpassword", "") == "")
@@ -233,6 +408,7 @@ bool StartHTTPRPC()
         return false;
 
     RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/rpcbin", true, HTTPReq_BinaryRPC);
 #ifdef ENABLE_WALLET
     // ifdef can be removed once we switch to better endpoint support and API versioning
     RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC);
@@ -252,6 +428,7 @@ void StopHTTPRPC()
 {
     LogPrint(BCLog::RPC, "Stopping HTTP RPC server\n");
     UnregisterHTTPHandler("/", true);
+    UnregisterHTTPHandler("/rpcbin", true);
     if (httpRPCTimerInterface) {
         RPCUnsetTimerInterface(httpRPCTimerInterface.get());
         httpRPCTimerInterface.reset();
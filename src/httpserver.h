@@ -46,6 +46,13 @@ void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPR
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/** Run a task on one of the HTTP worker threads. Returns false if the work
+ * queue is full or not running, in which case the task is not run.
+ */
+bool HTTPRunOnWorker(const std::function<void()>& task);
+/** Number of HTTP worker threads, zero before the server is started */
+int HTTPWorkerCount();
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
@@ -105,6 +112,12 @@ public:
      */
     void WriteHeader(const std::string& hdr, const std::string& value);
 
+    /**
+     * Append to the body of the reply, sent along with WriteReply's strReply.
+     * Lets large replies be produced piecewise without building them in one string.
+     */
+    void WriteReplyPart(const std::string& strPart);
+
     /**
      * Write HTTP reply.
      * nStatus is the HTTP status code to send.
@@ -0,0 +1,293 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <indexbuilder.h>
+
+#include <addressindex.h>
+#include <chainparams.h>
+#include <sigma/parallel.h>
+#include <spentindex.h>
+#include <txdb.h>
+#include <undo.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <boost/thread.hpp>
+
+namespace {
+
+/** The records a block adds to the indexes being built, as ConnectBlock writes them */
+struct CBlockIndexRecords
+{
+    std::vector<std::pair<uint256, CDiskTxPos> > vTxPos;
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vAddress;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vAddressUnspent;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > vSpent;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vDelegation;
+};
+
+std::string GetIndexNames(unsigned int nIndexes)
+{
+    static const std::pair<unsigned int, const char*> names[] = {
+        {INDEX_BUILD_TX, "transaction"}, {INDEX_BUILD_ADDRESS, "address"}, {INDEX_BUILD_SPENT, "spent"},
+        {INDEX_BUILD_TIMESTAMP, "timestamp"}, {INDEX_BUILD_DELEGATION, "delegation"},
+    };
+    std::string strNames;
+    for (const auto& name : names) {
+        if (nIndexes & name.first)
+            strNames += (strNames.empty() ? "" : ", ") + std::string(name.second);
+    }
+    return strNames;
+}
+
+template <typename T>
+void Append(std::vector<T>& to, std::vector<T>& from)
+{
+    to.insert(to.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+}
+
+/** Collects the records of the block at pindex, the coins it spends are read from its undo data */
+bool ReadBlockRecords(const CBlockIndex* pindex, unsigned int nIndexes, CBlockIndexRecords& records)
+{
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()))
+        return error("%s: failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+
+    if (nIndexes & INDEX_BUILD_TX) {
+        CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
+        records.vTxPos.reserve(block.vtx.size());
+        for (const CTransactionRef& tx : block.vtx) {
+            records.vTxPos.push_back(std::make_pair(tx->GetHash(), pos));
+            pos.nTxOffset += ::GetSerializeSize(*tx, SER_DISK, CLIENT_VERSION);
+        }
+    }
+
+    if (!(nIndexes & (INDEX_BUILD_ADDRESS | INDEX_BUILD_SPENT | INDEX_BUILD_DELEGATION)))
+        return true;
+
+    CBlockUndo blockUndo;
+    if (!UndoReadFromDisk(blockUndo, pindex))
+        return error("%s: failed to read the undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+
+    // Every transaction but the coinbase has an undo entry, spends of mints have empty ones
+    size_t nUndo = 0;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256 txHash = tx.GetHash();
+        std::vector<uint8_t> hashBytes;
+        int scriptType = 0;
+
+        if (!tx.IsCoinBase()) {
+            if (nUndo >= blockUndo.vtxundo.size())
+                return error("%s: block %s and its undo data are inconsistent", __func__, pindex->GetBlockHash().ToString());
+            const CTxUndo& txundo = blockUndo.vtxundo[nUndo++];
+
+            if (!tx.IsZerocoinSpend() && !tx.IsSigmaSpend()) {
+                if (txundo.vprevout.size() != tx.vin.size())
+                    return error("%s: transaction %s and its undo data are inconsistent", __func__, txHash.ToString());
+
+                for (size_t j = 0; j < tx.vin.size(); j++) {
+                    const COutPoint& prevout = tx.vin[j].prevout;
+                    const Coin& coin = txundo.vprevout[j];
+
+                    if ((nIndexes & INDEX_BUILD_DELEGATION) && ExtractDelegationInfo(coin.out.scriptPubKey, scriptType, hashBytes))
+                        records.vDelegation.push_back(std::make_pair(CAddressUnspentKey(scriptType, uint256(hashBytes.data(), hashBytes.size()), prevout.hash, prevout.n), CAddressUnspentValue()));
+
+                    if (!ExtractIndexInfo(&coin.out.scriptPubKey, scriptType, hashBytes) || scriptType == 0)
+                        continue;
+                    uint256 hashAddress(hashBytes.data(), hashBytes.size());
+
+                    if (nIndexes & INDEX_BUILD_ADDRESS) {
+                        records.vAddress.push_back(std::make_pair(CAddressIndexKey(scriptType, hashAddress, pindex->nHeight, i, txHash, j, true), coin.out.nValue * -1));
+                        records.vAddressUnspent.push_back(std::make_pair(CAddressUnspentKey(scriptType, hashAddress, prevout.hash, prevout.n), CAddressUnspentValue()));
+                    }
+                    if (nIndexes & INDEX_BUILD_SPENT)
+                        records.vSpent.push_back(std::make_pair(CSpentIndexKey(prevout.hash, prevout.n), CSpentIndexValue(txHash, j, pindex->nHeight, coin.out.nValue, scriptType, hashAddress)));
+                }
+            }
+        }
+
+        for (size_t k = 0; k < tx.vout.size(); k++) {
+            const CTxOut& out = tx.vout[k];
+
+            if ((nIndexes & INDEX_BUILD_DELEGATION) && ExtractDelegationInfo(out.scriptPubKey, scriptType, hashBytes))
+                records.vDelegation.push_back(std::make_pair(CAddressUnspentKey(scriptType, uint256(hashBytes.data(), hashBytes.size()), txHash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
+
+            if (!(nIndexes & INDEX_BUILD_ADDRESS) || !ExtractIndexInfo(&out.scriptPubKey, scriptType, hashBytes) || scriptType == 0)
+                continue;
+            uint256 hashAddress(hashBytes.data(), hashBytes.size());
+            records.vAddress.push_back(std::make_pair(CAddressIndexKey(scriptType, hashAddress, pindex->nHeight, i, txHash, k, false), out.nValue));
+            records.vAddressUnspent.push_back(std::make_pair(CAddressUnspentKey(scriptType, hashAddress, txHash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
+        }
+    }
+    return true;
+}
+
+/** Decodes the blocks in parallel, then writes their records in chain order */
+bool IndexBlocks(const std::vector<const CBlockIndex*>& vBlocks, unsigned int nIndexes)
+{
+    std::vector<CBlockIndexRecords> vRecords(vBlocks.size());
+    std::unique_ptr<bool[]> fRead(new bool[vBlocks.size()]);
+    sigma::parallel_for(vBlocks.size(), GetNumCores(), [&](size_t i) {
+        fRead[i] = ReadBlockRecords(vBlocks[i], nIndexes, vRecords[i]);
+    });
+
+    CBlockIndexRecords all;
+    for (size_t i = 0; i < vBlocks.size(); i++) {
+        if (!fRead[i])
+            return false;
+        Append(all.vTxPos, vRecords[i].vTxPos);
+        Append(all.vAddress, vRecords[i].vAddress);
+        Append(all.vAddressUnspent, vRecords[i].vAddressUnspent);
+        Append(all.vSpent, vRecords[i].vSpent);
+        Append(all.vDelegation, vRecords[i].vDelegation);
+    }
+
+    if ((nIndexes & INDEX_BUILD_TX) && !pblocktree->WriteTxIndex(all.vTxPos))
+        return error("%s: failed to write transaction index", __func__);
+    if (nIndexes & INDEX_BUILD_ADDRESS) {
+        if (!pblocktree->WriteAddressIndex(all.vAddress) || !pblocktree->UpdateAddressUnspentIndex(all.vAddressUnspent))
+            return error("%s: failed to write address index", __func__);
+        if (gArgs.GetBoolArg("-addressbalanceindex", DEFAULT_ADDRESSBALANCEINDEX) && !pblocktree->UpdateAddressBalanceIndex(all.vAddress, false))
+            return error("%s: failed to write address balance index", __func__);
+    }
+    if ((nIndexes & INDEX_BUILD_SPENT) && !pblocktree->UpdateSpentIndex(all.vSpent))
+        return error("%s: failed to write spent index", __func__);
+    if ((nIndexes & INDEX_BUILD_DELEGATION) && !pblocktree->UpdateDelegationIndex(all.vDelegation))
+        return error("%s: failed to write delegation index", __func__);
+    if (nIndexes & INDEX_BUILD_TIMESTAMP) {
+        for (const CBlockIndex* pindex : vBlocks) {
+            if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())) ||
+                !pblocktree->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(pindex->nTime)))
+                return error("%s: failed to write timestamp index", __func__);
+        }
+    }
+    return true;
+}
+
+/** Blocks after pindexLast up to nHeight, false if pindexLast was disconnected meanwhile */
+bool GetNextBlocks(const CBlockIndex* pindexLast, int nHeight, std::vector<const CBlockIndex*>& vBlocks)
+{
+    AssertLockHeld(cs_main);
+    if (!chainActive.Contains(pindexLast))
+        return false;
+    vBlocks.clear();
+    for (int h = pindexLast->nHeight + 1; h <= nHeight; h++)
+        vBlocks.push_back(chainActive[h]);
+    return true;
+}
+
+/** Hands the built indexes over to ConnectBlock */
+void EnableIndexes(unsigned int nIndexes)
+{
+    AssertLockHeld(cs_main);
+    if (nIndexes & INDEX_BUILD_TX)
+        pblocktree->WriteFlag("txindex", fTxIndex = true);
+    if (nIndexes & INDEX_BUILD_ADDRESS) {
+        pblocktree->WriteFlag("addressindex", fAddressIndex = true);
+        pblocktree->WriteFlag("addressbalanceindex", fAddressBalanceIndex = gArgs.GetBoolArg("-addressbalanceindex", DEFAULT_ADDRESSBALANCEINDEX));
+    }
+    if (nIndexes & INDEX_BUILD_SPENT)
+        pblocktree->WriteFlag("spentindex", fSpentIndex = true);
+    if (nIndexes & INDEX_BUILD_TIMESTAMP)
+        pblocktree->WriteFlag("timestampindex", fTimestampIndex = true);
+    if (nIndexes & INDEX_BUILD_DELEGATION)
+        pblocktree->WriteFlag("delegationindex", fDelegationIndex = true);
+    pblocktree->EraseIndexBuildState();
+}
+
+} // namespace
+
+unsigned int GetMissingIndexes()
+{
+    unsigned int nMissing = 0;
+    if (!fTxIndex && gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
+        nMissing |= INDEX_BUILD_TX;
+    if (!fAddressIndex && gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX))
+        nMissing |= INDEX_BUILD_ADDRESS;
+    if (!fSpentIndex && gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX))
+        nMissing |= INDEX_BUILD_SPENT;
+    if (!fTimestampIndex && gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX))
+        nMissing |= INDEX_BUILD_TIMESTAMP;
+    if (!fDelegationIndex && gArgs.GetBoolArg("-delegationindex", DEFAULT_DELEGATIONINDEX))
+        nMissing |= INDEX_BUILD_DELEGATION;
+    return nMissing;
+}
+
+void ThreadBuildIndexes()
+{
+    // A reindex writes the indexes itself, wait for it and for block imports
+    while (fReindex || fImporting)
+        MilliSleep(1000);
+
+    const unsigned int nIndexes = GetMissingIndexes();
+    if (!nIndexes)
+        return;
+    const std::string strNames = GetIndexNames(nIndexes);
+
+    uint256 hashSnapshot;
+    unsigned int nSnapshotTx;
+    if (fHavePruned || pblocktree->ReadSnapshotBlock(hashSnapshot, nSnapshotTx)) {
+        LogPrintf("Can't build the %s index without the full block history, restart with -reindex to build it\n", strNames);
+        return;
+    }
+
+    const CBlockIndex* pindexLast = nullptr;
+    {
+        LOCK(cs_main);
+        unsigned int nStored;
+        uint256 hashStored;
+        if (pblocktree->ReadIndexBuildState(nStored, hashStored) && nStored == nIndexes) {
+            BlockMap::const_iterator it = mapBlockIndex.find(hashStored);
+            if (it == mapBlockIndex.end() || !chainActive.Contains(it->second)) {
+                LogPrintf("The partly built %s index is ahead of the active chain, restart with -reindex to build it\n", strNames);
+                return;
+            }
+            pindexLast = it->second;
+        } else {
+            // The genesis block has no index records
+            pindexLast = chainActive.Genesis();
+        }
+        LogPrintf("Building the %s index from height %d of %d\n", strNames, pindexLast->nHeight + 1, chainActive.Height());
+    }
+
+    std::vector<const CBlockIndex*> vBlocks;
+    int64_t nLastLog = GetTime();
+    while (true) {
+        boost::this_thread::interruption_point();
+        {
+            LOCK(cs_main);
+            int nTarget = chainActive.Height() - INDEX_BUILD_TIP_DISTANCE;
+            if (!GetNextBlocks(pindexLast, std::min(nTarget, pindexLast->nHeight + INDEX_BUILD_BATCH_SIZE), vBlocks))
+                break;
+            if (vBlocks.empty()) {
+                // Index the last few blocks and switch over without letting the tip move
+                if (!GetNextBlocks(pindexLast, chainActive.Height(), vBlocks))
+                    break;
+                if (!IndexBlocks(vBlocks, nIndexes)) {
+                    LogPrintf("Building the %s index failed at height %d\n", strNames, pindexLast->nHeight + 1);
+                    return;
+                }
+                EnableIndexes(nIndexes);
+                LogPrintf("Built the %s index up to height %d\n", strNames, chainActive.Height());
+                return;
+            }
+        }
+
+        if (!IndexBlocks(vBlocks, nIndexes)) {
+            LogPrintf("Building the %s index failed at height %d\n", strNames, pindexLast->nHeight + 1);
+            return;
+        }
+        pindexLast = vBlocks.back();
+        pblocktree->WriteIndexBuildState(nIndexes, pindexLast->GetBlockHash());
+
+        if (GetTime() - nLastLog >= 60) {
+            LogPrintf("Building the %s index, at height %d\n", strNames, pindexLast->nHeight);
+            nLastLog = GetTime();
+        }
+    }
+
+    LogPrintf("Building the %s index stopped, block %s was disconnected, restart with -reindex to build it\n", strNames, pindexLast->GetBlockHash().ToString());
+}
@@ -0,0 +1,37 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEXBUILDER_H
+#define BITCOIN_INDEXBUILDER_H
+
+/**
+ * Builds the optional indexes that were switched on after the chain was synced, so
+ * enabling them doesn't need a -reindex. A background thread replays the active
+ * chain from the block and undo files, decoding a batch of blocks in parallel and
+ * writing their records in chain order. Near the tip it takes cs_main, indexes the
+ * remaining blocks and turns the indexes on. From then on ConnectBlock and
+ * DisconnectBlock keep them current, like an index enabled from the start.
+ * Progress is saved after each batch, an interrupted build resumes on restart.
+ */
+
+enum IndexBuildFlags : unsigned int {
+    INDEX_BUILD_TX          = 1 << 0,
+    INDEX_BUILD_ADDRESS     = 1 << 1, //!< along with the balance checkpoints if -addressbalanceindex is set
+    INDEX_BUILD_SPENT       = 1 << 2,
+    INDEX_BUILD_TIMESTAMP   = 1 << 3,
+    INDEX_BUILD_DELEGATION  = 1 << 4,
+};
+
+//! Blocks decoded in parallel per batch
+static const int INDEX_BUILD_BATCH_SIZE = 64;
+//! The builder runs unlocked until it is this close to the tip
+static const int INDEX_BUILD_TIP_DISTANCE = 6;
+
+/** The indexes requested on the command line that aren't built yet, see IndexBuildFlags */
+unsigned int GetMissingIndexes();
+
+/** Builds the missing indexes, run by a thread of the node's thread group */
+void ThreadBuildIndexes();
+
+#endif // BITCOIN_INDEXBUILDER_H
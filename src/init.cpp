@@ -20,6 +20,8 @@
 #include <fs.h>
 #include <httpserver.h>
 #include <httprpc.h>
+#include <blockfilterindex.h>
+#include <indexbuilder.h>
 #include <key.h>
 #include <validation.h>
 #include <miner.h>
@@ -49,7 +51,10 @@
 #endif
 #include <pos/miner.h>
 #include <wallet/autoghoster.h>
+#include <wallet/ghostkeypool.h>
+#include <wallet/spendjobs.h>
 #include <warnings.h>
+#include <zerocoin/sigmacache.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <memory>
@@ -78,6 +83,10 @@
 #include <event2/event.h>
 #include <event2/thread.h>
 
+extern "C" {
+#include <tor/src/or/tor_api.h>
+}
+
 #include "ghostnode/activeghostnode.h"
 #include "ghostnode/darksend.h"
 #include "ghostnode/ghostnode-payments.h"
@@ -91,6 +100,8 @@
 
 #if ENABLE_ZMQ
 #include <zmq/zmqnotificationinterface.h>
+#include <zmq/zmqpublishnotifier.h>
+#include <zmq/zmqrpc.h>
 #endif
 
 bool fFeeEstimatesInitialized = false;
@@ -124,16 +135,17 @@ namespace fs = boost::filesystem;
 extern const char tor_git_revision[];
 const char tor_git_revision[] = "";
 
+static boost::thread torEnabledThread;
 
-static char *convert_str(const std::string &s) {
-    char *pc = new char[s.size()+1];
-    std::strcpy(pc, s.c_str());
-    return pc;
-}
-
-void RunTor(){
-    printf("TOR thread started.\n");
-
+/**
+ * Runs the bundled Tor until it exits. Its DataDirectory lives under
+ * datadir/tor, so the cached consensus, descriptors and guard state survive a
+ * restart and Tor can build circuits without bootstrapping from scratch.
+ * Tor is owned by nOwningControlFd: it exits once the other end of that
+ * socket, handed to torcontrol, is closed.
+ */
+static void RunTor(int nOwningControlFd)
+{
     boost::optional < std::string > clientTransportPlugin;
     struct stat sb;
     if ((stat("obfs4proxy", &sb) == 0 && sb.st_mode & S_IXUSR)
@@ -151,77 +163,79 @@ void RunTor(){
     argv.push_back("tor");
     argv.push_back("--Log");
     argv.push_back("notice file " + log_file.string());
+    argv.push_back("--DataDirectory");
+    argv.push_back(tor_dir.string());
     argv.push_back("--SocksPort");
     argv.push_back("9050");
     argv.push_back("--ignore-missing-torrc");
     argv.push_back("-f");
     argv.push_back((tor_dir / "torrc").string());
-    argv.push_back("--HiddenServiceDir");
-    argv.push_back((tor_dir / "onion").string());
-    argv.push_back("--HiddenServicePort");
-    argv.push_back("6214");
+    // Signals belong to nixd, Tor is stopped through its owning controller
+    argv.push_back("--__DisableSignalHandlers");
+    argv.push_back("1");
+    if (nOwningControlFd >= 0) {
+        argv.push_back("--__OwningControllerFD");
+        argv.push_back(std::to_string(nOwningControlFd));
+    } else {
+        // No owning socket on Windows, torcontrol uses the control port instead
+        argv.push_back("--ControlPort");
+        argv.push_back(DEFAULT_TOR_CONTROL);
+        argv.push_back("--CookieAuthentication");
+        argv.push_back("1");
+    }
 
     if (clientTransportPlugin) {
-        printf("Using OBFS4.\n");
+        LogPrintf("tor: Using OBFS4\n");
         argv.push_back("--ClientTransportPlugin");
         argv.push_back(*clientTransportPlugin);
         argv.push_back("--UseBridges");
         argv.push_back("1");
     } else {
-        printf("No OBFS4 found, not using it.\n");
+        LogPrintf("tor: No OBFS4 found, not using it\n");
     }
 
+    // Tor expects argv to stay unchanged until tor_run_main returns
     std::vector<char *> argv_c;
-    std::transform(argv.begin(), argv.end(), std::back_inserter(argv_c),
-            convert_str);
-
-    //TODO: linking error for linux&windows, order in makefile
-    //tor_main(argv_c.size(), &argv_c[0]);
-}
-
-
-struct event_base *baseTor;
-boost::thread torEnabledThread;
-
-static void TorEnabledThread()
-{
-    RunTor();
-    event_base_dispatch(baseTor);
+    for (std::string& arg : argv)
+        argv_c.push_back(&arg[0]);
+    argv_c.push_back(nullptr);
+
+    tor_main_configuration_t *cfg = tor_main_configuration_new();
+    if (!cfg || tor_main_configuration_set_command_line(cfg, argv.size(), argv_c.data()) != 0) {
+        LogPrintf("tor: Unable to configure the in-process Tor\n");
+        if (cfg)
+            tor_main_configuration_free(cfg);
+        return;
+    }
+    LogPrintf("tor: Starting in-process Tor, data directory %s\n", tor_dir.string());
+    int nRet = tor_run_main(cfg);
+    tor_main_configuration_free(cfg);
+    LogPrintf("tor: In-process Tor exited with code %d\n", nRet);
 }
 
-
 void StartTorEnabled(boost::thread_group& threadGroup, CScheduler& scheduler)
 {
-    assert(!baseTor);
-#ifdef WIN32
-    evthread_use_windows_threads();
-#else
-    evthread_use_pthreads();
-#endif
-    baseTor = event_base_new();
-    if (!baseTor) {
-        LogPrintf("tor: Unable to create event_base\n");
+    assert(!torEnabledThread.joinable());
+
+    int nOwningControlFd = -1;
+#ifndef WIN32
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        LogPrintf("tor: Unable to create the control socket pair\n");
         return;
     }
+    nOwningControlFd = fds[0];
+    SetTorControlSocket(fds[1]);
+#endif
 
-    torEnabledThread = boost::thread(boost::bind(&TraceThread<void (*)()>, "torcontrol", &TorEnabledThread));
-}
-
-void InterruptTorEnabled()
-{
-    if (baseTor) {
-        LogPrintf("tor: Thread interrupt\n");
-        event_base_loopbreak(baseTor);
-    }
+    torEnabledThread = boost::thread(boost::bind(&TraceThread<std::function<void()> >, "tor", std::function<void()>(std::bind(&RunTor, nOwningControlFd))));
 }
 
 void StopTorEnabled()
 {
-    if (baseTor) {
+    // Tor exits once StopTorControl closed its owning control socket
+    if (torEnabledThread.joinable())
         torEnabledThread.join();
-        event_base_free(baseTor);
-        baseTor = 0;
-    }
 }
 
 
@@ -252,6 +266,7 @@ void StopTorEnabled()
 
 std::atomic<bool> fRequestShutdown(false);
 std::atomic<bool> fDumpMempoolLater(false);
+std::atomic<bool> fDumpPrivacyStateLater(false);
 
 void StartShutdown()
 {
@@ -284,6 +299,15 @@ public:
             abort();
         }
     }
+    void GetCoins(const std::vector<COutPoint> &outpoints, std::vector<std::pair<COutPoint, Coin>> &coins) const override {
+        try {
+            base->GetCoins(outpoints, coins);
+        } catch(const std::runtime_error& e) {
+            uiInterface.ThreadSafeMessageBox(_("Error reading from database, shutting down."), "", CClientUIInterface::MSG_ERROR);
+            LogPrintf("Error reading from database: %s\n", e.what());
+            abort();
+        }
+    }
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
@@ -330,6 +354,8 @@ void Shutdown()
     if(gArgs.GetBoolArg("-autoghost", false)){
         ShutdownThreadAutoGhoster();
     }
+    ghostKeyPool.Stop();
+    spendJobQueue.Stop();
     FlushWallets();
 #endif
     MapPort(false);
@@ -337,11 +363,14 @@ void Shutdown()
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
+    StopGhostnodeMessageThread();
+    StopBlockPrefetchThreads();
     if (g_connman) g_connman->Stop();
     peerLogic.reset();
     g_connman.reset();
 
     StopTorControl();
+    StopTorEnabled();
 
     // After everything has been shut down, but before things get flushed, stop the
     // CScheduler/checkqueue threadGroup
@@ -384,11 +413,17 @@ void Shutdown()
         if (pcoinsTip != nullptr) {
             FlushStateToDisk();
         }
+        if (fDumpPrivacyStateLater) {
+            DumpPrivacyState();
+        }
         pcoinsTip.reset();
         pcoinscatcher.reset();
         pcoinsdbview.reset();
         pblocktree.reset();
+        pprivacyindex.reset();
+        pblockfilterindex.reset();
     }
+    instantsend.CloseTxLockDB();
 #ifdef ENABLE_WALLET
     StopWallets();
 #endif
@@ -449,11 +484,14 @@ static void registerSignalHandler(int signal, void(*handler)(int))
 void OnRPCStarted()
 {
     uiInterface.NotifyBlockTip.connect(&RPCNotifyBlockChange);
+    uiInterface.NotifyBlockTip.connect(&RPCClearResponseCache);
 }
 
 void OnRPCStopped()
 {
     uiInterface.NotifyBlockTip.disconnect(&RPCNotifyBlockChange);
+    uiInterface.NotifyBlockTip.disconnect(&RPCClearResponseCache);
+    RPCClearResponseCache(false, nullptr);
     RPCNotifyBlockChange(false, nullptr);
     cvBlockChange.notify_all();
     LogPrint(BCLog::RPC, "RPC stopped.\n");
@@ -486,7 +524,11 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     if (showDebug) {
+        strUsage += HelpMessageOpt("-dbbackgroundflush", strprintf("Write the coin cache to the database on a separate thread instead of holding up block validation, which can use up to twice -dbcache while a flush is in progress (default: %u)", DEFAULT_DB_BACKGROUND_FLUSH));
         strUsage += HelpMessageOpt("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize));
+        strUsage += HelpMessageOpt("-dbbloombits=<n>", strprintf("Bloom filter bits per key of the chainstate and index databases, 0 to disable (default: %u)", DEFAULT_DB_BLOOM_BITS));
+        strUsage += HelpMessageOpt("-dbblocksize=<n>", strprintf("Table block size in bytes of the chainstate and index databases (default: %u, address index: 16384)", DEFAULT_DB_BLOCK_SIZE));
+        strUsage += HelpMessageOpt("-dbrestartinterval=<n>", strprintf("Keys between restart points in table blocks of the chainstate and index databases (default: %u)", DEFAULT_DB_RESTART_INTERVAL));
     }
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     if (showDebug)
@@ -511,6 +553,9 @@ std::string HelpMessage(HelpMessageMode mode)
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >%u = automatically prune block files to stay under the specified target size in MiB)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
     strUsage += HelpMessageOpt("-reindex-chainstate", _("Rebuild chain state from the currently indexed blocks"));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild chain state and block index from the blk*.dat files on disk"));
+    strUsage += HelpMessageOpt("-reindexreaders=<n>", strprintf(_("Set the number of block files read at once by -reindex (1 to %d, 0 = auto, default: %d)"),
+        MAX_REINDEX_READERS, DEFAULT_REINDEX_READERS));
+    strUsage += HelpMessageOpt("-compressblocks", strprintf(_("Store new blocks LZ4 compressed in the block files when that saves space. Block files written this way can not be read by earlier versions (default: %u)"), DEFAULT_COMPRESS_BLOCKS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
@@ -518,7 +563,10 @@ std::string HelpMessage(HelpMessageMode mode)
 
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
+    strUsage += HelpMessageOpt("-addressbalanceindex", strprintf(_("Keep per block balance checkpoints of each address along with -addressindex, for fast balance and vote weight queries (default: %u)"), DEFAULT_ADDRESSBALANCEINDEX));
+    strUsage += HelpMessageOpt("-delegationindex", strprintf(_("Maintain an index of unspent conditional stake outputs by the address they are delegated to, used by pool operators to query their delegations (default: %u)"), DEFAULT_DELEGATIONINDEX));
     strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)"), DEFAULT_SPENTINDEX));
+    strUsage += HelpMessageOpt("-blockfilterindex", strprintf(_("Maintain an index of BIP158 compact block filters, built in the background, used by the getblockfilter rpc call and -peerblockfilters (default: %u)"), DEFAULT_BLOCKFILTERINDEX));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open (see the `addnode` RPC command help for more info)"));
@@ -534,6 +582,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-listen", _("Accept connections from outside (default: 1 if no -proxy or -connect)"));
     strUsage += HelpMessageOpt("-listenonion", strprintf(_("Automatically create Tor hidden service (default: %d)"), DEFAULT_LISTEN_ONION));
     strUsage += HelpMessageOpt("-maxconnections=<n>", strprintf(_("Maintain at most <n> connections to peers (default: %u)"), DEFAULT_MAX_PEER_CONNECTIONS));
+    strUsage += HelpMessageOpt("-msghandthreads=<n>", strprintf(_("Number of threads processing peer messages, requests for blocks and headers are served in parallel (1 to %d, default: %d)"), MAX_MSGHAND_THREADS, DEFAULT_MSGHAND_THREADS));
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXRECEIVEBUFFER));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXSENDBUFFER));
     strUsage += HelpMessageOpt("-maxtimeadjustment", strprintf(_("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)"), DEFAULT_MAX_TIME_ADJUSTMENT));
@@ -541,11 +590,13 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), DEFAULT_PERMIT_BAREMULTISIG));
     strUsage += HelpMessageOpt("-peerbloomfilters", strprintf(_("Support filtering of blocks and transaction with bloom filters (default: %u)"), DEFAULT_PEERBLOOMFILTERS));
+    strUsage += HelpMessageOpt("-peerblockfilters", strprintf(_("Serve compact block filters to peers per BIP157, requires -blockfilterindex (default: %u)"), DEFAULT_PEERBLOCKFILTERS));
     strUsage += HelpMessageOpt("-port=<port>", strprintf(_("Listen for connections on <port> (default: %u or testnet: %u)"), defaultChainParams->GetDefaultPort(), testnetChainParams->GetDefaultPort()));
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
-    strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), DEFAULT_PROXYRANDOMIZE));
+    strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Use separate random credentials for the proxy connections to every peer. This enables Tor stream isolation (default: %u)"), DEFAULT_PROXYRANDOMIZE));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
+    strUsage += HelpMessageOpt("-torcircuitpool=<n>", strprintf(_("Number of circuits the Tor controller keeps built ahead for outbound connections through Tor (0-%d, default: %d)"), MAX_TOR_CIRCUIT_POOL, DEFAULT_TOR_CIRCUIT_POOL));
     strUsage += HelpMessageOpt("-torcontrol=<ip>:<port>", strprintf(_("Tor control port to use if onion listening enabled (default: %s)"), DEFAULT_TOR_CONTROL));
     strUsage += HelpMessageOpt("-torpassword=<pass>", _("Tor control port password (default: empty)"));
 #ifdef USE_UPNP
@@ -570,6 +621,13 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubsigmamint=<address>", _("Enable publish Sigma mints of connected blocks in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubsigmaspend=<address>", _("Enable publish Sigma spends of connected blocks in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubstake=<address>", _("Enable publish stakes of connected blocks in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubghostnode=<address>", _("Enable publish ghostnode state changes in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubtxlock=<address>", _("Enable publish InstantSend transaction locks in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubmempoolseq=<address>", _("Enable publish mempool additions and removals with their sequence number in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubqueuesize=<n>", strprintf(_("Messages waiting to be published before new ones are dropped (default: %u)"), DEFAULT_ZMQ_QUEUE_SIZE));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -579,6 +637,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), DEFAULT_CHECKBLOCKS));
         strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), DEFAULT_CHECKLEVEL));
         strUsage += HelpMessageOpt("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. Also sets -checkmempool (default: %u)", defaultChainParams->DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt("-checkblockindexpow", strprintf("Recheck the proof of work of every block index entry at startup, also those already checked (default: %u)", DEFAULT_CHECKBLOCKINDEXPOW));
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", defaultChainParams->DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED));
         strUsage += HelpMessageOpt("-disablesafemode", strprintf("Disable safemode, override a real safe mode event (default: %u)", DEFAULT_DISABLE_SAFEMODE));
@@ -586,6 +645,11 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-testsafemode", strprintf("Force safe mode (default: %u)", DEFAULT_TESTSAFEMODE));
         strUsage += HelpMessageOpt("-dropmessagestest=<n>", "Randomly drop 1 of every <n> network messages");
         strUsage += HelpMessageOpt("-fuzzmessagestest=<n>", "Randomly fuzz 1 of every <n> network messages");
+        strUsage += HelpMessageOpt("-ghostnodesweepinterval=<n>", strprintf("Seconds between the sweeps over ghostnodes, payment votes, InstantSend locks and fulfilled requests (default: %u)", DEFAULT_GHOSTNODE_SWEEP_INTERVAL));
+        strUsage += HelpMessageOpt("-ghostnodesweepjitter=<n>", strprintf("Add up to <n> random seconds to each ghostnode sweep interval (default: %u)", DEFAULT_GHOSTNODE_SWEEP_JITTER));
+        strUsage += HelpMessageOpt("-maxghostnodepaymentsmem=<n>", strprintf("Keep the ghostnode payment votes below <n> megabytes, dropping those of the oldest blocks first, 0 = no limit (default: %u)", DEFAULT_MAX_GHOSTNODE_PAYMENTS_MEMORY));
+        strUsage += HelpMessageOpt("-maxghostnodeseenmem=<n>", strprintf("Keep the ghostnode broadcasts and pings remembered as seen below <n> megabytes, 0 = no limit (default: %u)", DEFAULT_MAX_GHOSTNODE_SEEN_MEMORY));
+        strUsage += HelpMessageOpt("-maxinstantsendorphanmem=<n>", strprintf("Keep the InstantSend votes waiting for their lock request below <n> megabytes, 0 = no limit (default: %u)", DEFAULT_MAX_INSTANTSEND_ORPHAN_MEMORY));
         strUsage += HelpMessageOpt("-stopafterblockimport", strprintf("Stop running after importing blocks from disk (default: %u)", DEFAULT_STOPAFTERBLOCKIMPORT));
         strUsage += HelpMessageOpt("-stopatheight", strprintf("Stop running after reaching the given height in the main chain (default: %u)", DEFAULT_STOPATHEIGHT));
 
@@ -599,6 +663,8 @@ std::string HelpMessage(HelpMessageMode mode)
         _("If <category> is not supplied or if <category> = 1, output all debugging information.") + " " + _("<category> can be:") + " " + ListLogCategories() + ".");
     strUsage += HelpMessageOpt("-debugexclude=<category>", strprintf(_("Exclude debugging information for a category. Can be used in conjunction with -debug=1 to output debug logs for all categories except one or more specified categories.")));
     strUsage += HelpMessageOpt("-help-debug", _("Show all debugging options (usage: --help -help-debug)"));
+    strUsage += HelpMessageOpt("-lifecycletrace", strprintf(_("Record when recent transactions and blocks reach each processing stage, reported by gettxlifecycle and getblocklifecycle (default: %u)"), DEFAULT_LIFECYCLE_TRACING));
+    strUsage += HelpMessageOpt("-lockprofile", strprintf(_("Record wait and hold times of every lock site, reported by getperfinfo (default: %u)"), DEFAULT_LOCK_PROFILING));
     strUsage += HelpMessageOpt("-logips", strprintf(_("Include IP addresses in debug output (default: %u)"), DEFAULT_LOGIPS));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"), DEFAULT_LOGTIMESTAMPS));
     if (showDebug)
@@ -606,6 +672,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS));
         strUsage += HelpMessageOpt("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)");
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxsigmacachesize=<n>", strprintf("Limit sigma proof cache size to <n> MiB (default: %u)", DEFAULT_MAX_SIGMA_CACHE_SIZE));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
     }
     strUsage += HelpMessageOpt("-maxtxfee=<amt>", strprintf(_("Maximum total fees (in %s) to use in a single wallet transaction or raw transaction; setting this too low may abort large transactions (default: %s)"),
@@ -614,6 +681,7 @@ std::string HelpMessage(HelpMessageMode mode)
     if (showDebug)
     {
         strUsage += HelpMessageOpt("-printpriority", strprintf("Log transaction fee per kB when mining blocks (default: %u)", DEFAULT_PRINTPRIORITY));
+        strUsage += HelpMessageOpt("-schedulerthreads=<n>", strprintf("Number of threads running notifications and periodic tasks (1 to %d, default: %d)", MAX_SCHEDULER_THREADS, DEFAULT_SCHEDULER_THREADS));
     }
     strUsage += HelpMessageOpt("-shrinkdebugfile", _("Shrink debug.log file on client startup (default: 1 when no -debug)"));
 
@@ -652,6 +720,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), defaultBaseParams->RPCPort(), testnetBaseParams->RPCPort()));
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcserialversion", strprintf(_("Sets the serialization of raw transaction or block hex returned in non-verbose mode, non-segwit(0) or segwit(1) (default: %d)"), DEFAULT_RPC_SERIALIZE_VERSION));
+    strUsage += HelpMessageOpt("-rpccachesize=<n>", strprintf(_("Cache responses of RPC calls that only change with new blocks, up to <n> MiB (default: %u)"), DEFAULT_RPC_CACHE_SIZE));
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
     if (showDebug) {
         strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
@@ -775,17 +844,25 @@ void ThreadImport(std::vector<fs::path> vImportFiles)
 
     // -reindex
     if (fReindex) {
-        int nFile = 0;
-        while (true) {
-            CDiskBlockPos pos(nFile, 0);
-            if (!fs::exists(GetBlockPosFilename(pos, "blk")))
-                break; // No block files left to reindex
-            FILE *file = OpenBlockFile(pos, true);
-            if (!file)
-                break; // This error is logged in OpenBlockFile
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-            LoadExternalBlockFile(chainparams, file, &pos);
-            nFile++;
+        int nReaders = gArgs.GetArg("-reindexreaders", DEFAULT_REINDEX_READERS);
+        if (nReaders <= 0)
+            nReaders = GetNumCores();
+        nReaders = std::min(nReaders, MAX_REINDEX_READERS);
+        if (nReaders > 1) {
+            ReindexBlockFiles(chainparams, nReaders);
+        } else {
+            int nFile = 0;
+            while (true) {
+                CDiskBlockPos pos(nFile, 0);
+                if (!fs::exists(GetBlockPosFilename(pos, "blk")))
+                    break; // No block files left to reindex
+                FILE *file = OpenBlockFile(pos, true);
+                if (!file)
+                    break; // This error is logged in OpenBlockFile
+                LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+                LoadExternalBlockFile(chainparams, file, &pos);
+                nFile++;
+            }
         }
         pblocktree->WriteReindexing(false);
         fReindex = false;
@@ -972,6 +1049,8 @@ void InitLogging()
     fLogTimestamps = gArgs.GetBoolArg("-logtimestamps", DEFAULT_LOGTIMESTAMPS);
     fLogTimeMicros = gArgs.GetBoolArg("-logtimemicros", DEFAULT_LOGTIMEMICROS);
     fLogIPs = gArgs.GetBoolArg("-logips", DEFAULT_LOGIPS);
+    g_lock_profiling = gArgs.GetBoolArg("-lockprofile", DEFAULT_LOCK_PROFILING);
+    g_lifecycle_tracing = gArgs.GetBoolArg("-lifecycletrace", DEFAULT_LIFECYCLE_TRACING);
 
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     std::string version_string = FormatFullVersion();
@@ -1078,7 +1157,9 @@ bool AppInitParameterInteraction()
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
     // Trim requested connection counts, to fit into system limitations
+#if !defined(USE_EPOLL) && !defined(USE_KQUEUE)
     nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
+#endif
     nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS + MAX_ADDNODE_CONNECTIONS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -1141,6 +1222,7 @@ bool AppInitParameterInteraction()
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fCompressBlocks = gArgs.GetBoolArg("-compressblocks", DEFAULT_COMPRESS_BLOCKS);
 
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
@@ -1260,6 +1342,12 @@ bool AppInitParameterInteraction()
     if (gArgs.GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS))
         nLocalServices = ServiceFlags(nLocalServices | NODE_BLOOM);
 
+    if (gArgs.GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS)) {
+        if (!gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+            return InitError(_("-peerblockfilters requires -blockfilterindex."));
+        nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_FILTERS);
+    }
+
     if (gArgs.GetArg("-rpcserialversion", DEFAULT_RPC_SERIALIZE_VERSION) < 0)
         return InitError("rpcserialversion must be non-negative.");
 
@@ -1394,16 +1482,21 @@ bool AppInitMain()
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitSigmaProofCache();
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
+    StartBlockPrefetchThreads(std::max(1, nScriptCheckThreads / 2));
 
-    // Start the lightweight task scheduler thread
+    // Start the lightweight task scheduler threads, clients of the scheduler run in
+    // parallel while the callbacks of each client stay serial
+    int nSchedulerThreads = std::max(1, std::min<int>(gArgs.GetArg("-schedulerthreads", DEFAULT_SCHEDULER_THREADS), MAX_SCHEDULER_THREADS));
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    for (int i = 0; i < nSchedulerThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
 
     GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
     GetMainSignals().RegisterWithMempoolSignals(mempool);
@@ -1415,6 +1508,9 @@ bool AppInitMain()
 #ifdef ENABLE_WALLET
     RegisterWalletRPC(tableRPC);
 #endif
+#if ENABLE_ZMQ
+    RegisterZMQRPCCommands(tableRPC);
+#endif
 
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
@@ -1447,6 +1543,7 @@ bool AppInitMain()
 
     peerLogic.reset(new PeerLogicValidation(&connman, scheduler));
     RegisterValidationInterface(peerLogic.get());
+    StartGhostnodeMessageThread();
 
     // sanitize comments per BIP-0014, format user agent and check total size
     std::vector<std::string> uacomments;
@@ -1601,9 +1698,19 @@ bool AppInitMain()
     int64_t nTotalCache = (gArgs.GetArg("-dbcache", nDefaultDbCache) << 20);
     nTotalCache = std::max(nTotalCache, nMinDbCache << 20); // total cache cannot be less than nMinDbCache
     nTotalCache = std::min(nTotalCache, nMaxDbCache << 20); // total cache cannot be greater than nMaxDbcache
-    int64_t nBlockTreeDBCache = nTotalCache / 8;
-    nBlockTreeDBCache = std::min(nBlockTreeDBCache, (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxBlockDBAndTxIndexCache : nMaxBlockDBCache) << 20);
+    int64_t nBlockTreeDBCache = std::min(nTotalCache / 8, nMaxBlockDBCache << 20);
     nTotalCache -= nBlockTreeDBCache;
+    int64_t nIndexDBCache = 0;
+    if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) || gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ||
+        gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) || gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX) ||
+        gArgs.GetBoolArg("-delegationindex", DEFAULT_DELEGATIONINDEX))
+        nIndexDBCache = std::min(nTotalCache / 8, nMaxIndexDBCache << 20);
+    nTotalCache -= nIndexDBCache;
+    int64_t nPrivacyIndexDBCache = std::min(nTotalCache / 16, nMaxPrivacyIndexDBCache << 20);
+    nTotalCache -= nPrivacyIndexDBCache;
+    const bool fBlockFilterIndex = gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX);
+    int64_t nBlockFilterIndexCache = fBlockFilterIndex ? std::min(nTotalCache / 16, nMaxBlockFilterIndexCache << 20) : 0;
+    nTotalCache -= nBlockFilterIndexCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1611,6 +1718,10 @@ bool AppInitMain()
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for transaction, address, spent and timestamp index databases\n", nIndexDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for privacy index database\n", nPrivacyIndexDBCache * (1.0 / 1024 / 1024));
+    if (fBlockFilterIndex)
+        LogPrintf("* Using %.1fMiB for block filter index database\n", nBlockFilterIndexCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
@@ -1631,7 +1742,12 @@ bool AppInitMain()
                 // new CBlockTreeDB tries to delete the existing file, which
                 // fails if it's still open from the previous loop. Close it first:
                 pblocktree.reset();
-                pblocktree.reset(new CBlockTreeDB(nBlockTreeDBCache, false, fReset));
+                pblocktree.reset(new CBlockTreeDB(nBlockTreeDBCache, nIndexDBCache, false, fReset));
+                pprivacyindex.reset();
+                pprivacyindex.reset(new CPrivacyIndexDB(nPrivacyIndexDBCache, false, fReset));
+                pblockfilterindex.reset();
+                if (fBlockFilterIndex)
+                    pblockfilterindex.reset(new CBlockFilterIndex(nBlockFilterIndexCache, false, fReset));
 
                 if (fReset) {
                     pblocktree->WriteReindexing(true);
@@ -1657,8 +1773,8 @@ bool AppInitMain()
                 if (!mapBlockIndex.empty() && mapBlockIndex.count(chainparams.GetConsensus().hashGenesisBlock) == 0)
                     return InitError(_("Incorrect or no genesis block found. Wrong datadir for network?"));
 
-                // Check for changed -txindex state
-                if (fTxIndex != gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
+                // Check for a disabled -txindex, indexes that were switched on are built in the background
+                if (fTxIndex && !gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
                     strLoadError = _("You need to rebuild the database using -reindex to change -txindex");
                     break;
                 }
@@ -1698,6 +1814,9 @@ bool AppInitMain()
                     break;
                 }
 
+                if (gArgs.GetBoolArg("-dbbackgroundflush", DEFAULT_DB_BACKGROUND_FLUSH))
+                    pcoinsdbview->StartBackgroundFlush();
+
                 // The on-disk coinsdb is now in a good state, create the cache
                 pcoinsTip.reset(new CCoinsViewCache(pcoinscatcher.get()));
 
@@ -1754,6 +1873,7 @@ bool AppInitMain()
             }
 
             fLoaded = true;
+            fDumpPrivacyStateLater = true;
         } while(false);
 
         if (!fLoaded && !fRequestShutdown) {
@@ -1807,6 +1927,10 @@ bool AppInitMain()
 
     // if pruning, unset the service bit and perform the initial blockstore prune
     // after any wallet rescanning has taken place.
+    if (pindexSnapshotBlock) {
+        LogPrintf("Unsetting NODE_NETWORK, the blocks up to the UTXO snapshot were never downloaded\n");
+        nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
+    }
     if (fPruneMode) {
         LogPrintf("Unsetting NODE_NETWORK on prune mode\n");
         nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
@@ -1848,6 +1972,13 @@ bool AppInitMain()
 
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
 
+    // Indexes switched on after the chain was synced are built without a reindex
+    if (GetMissingIndexes())
+        threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "indexbuild", &ThreadBuildIndexes));
+
+    if (pblockfilterindex)
+        threadGroup.create_thread(boost::bind(&TraceThread<std::function<void()> >, "blockfilter", std::function<void()>(std::bind(&CBlockFilterIndex::ThreadSync, pblockfilterindex.get()))));
+
     // Wait for genesis block to be processed
     {
         WaitableLock lock(cs_GenesisWait);
@@ -1895,6 +2026,7 @@ bool AppInitMain()
     connOptions.m_msgproc = peerLogic.get();
     connOptions.nSendBufferMaxSize = 1000*gArgs.GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize = 1000*gArgs.GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
+    connOptions.nMessageHandlerThreads = gArgs.GetArg("-msghandthreads", DEFAULT_MSGHAND_THREADS);
     connOptions.m_added_nodes = gArgs.GetArgs("-addnode");
 
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
@@ -1939,6 +2071,9 @@ bool AppInitMain()
     if (!connman.Start(scheduler, connOptions)) {
         return false;
     }
+    // The addresses come in random order, Tor fetches the descriptors of the first onion peers
+    if (gArgs.GetBoolArg("-listenonion", DEFAULT_LISTEN_ONION) && IsReachable(NET_TOR))
+        PrewarmTorOnions(connman.GetAddresses());
 
     // ********************************************************* Step 11a: setup PrivateSend
     fGhostNode = gArgs.GetBoolArg("-ghostnode", false);
@@ -2014,10 +2149,17 @@ bool AppInitMain()
 
     // ********************************************************* Step 11b: Load cache data
 
+    mnodeman.SetMaxSeenMemory(std::max<int64_t>(gArgs.GetArg("-maxghostnodeseenmem", DEFAULT_MAX_GHOSTNODE_SEEN_MEMORY), 0) * 1000000);
+    mnpayments.SetMaxMemory(std::max<int64_t>(gArgs.GetArg("-maxghostnodepaymentsmem", DEFAULT_MAX_GHOSTNODE_PAYMENTS_MEMORY), 0) * 1000000);
+    instantsend.SetMaxOrphanMemory(std::max<int64_t>(gArgs.GetArg("-maxinstantsendorphanmem", DEFAULT_MAX_INSTANTSEND_ORPHAN_MEMORY), 0) * 1000000);
+
 
     CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
     flatdb4.Load(netfulfilledman);
 
+    if (!fLiteMode && !instantsend.LoadTxLocks())
+        return InitError(_("Failed to load the InstantSend lock database"));
+
 
     // ********************************************************* Step 11c: update block tip in nix modules
 
@@ -2026,10 +2168,12 @@ bool AppInitMain()
     darkSendPool.UpdatedBlockTip(chainActive.Tip());
     mnpayments.UpdatedBlockTip(chainActive.Tip());
     ghostnodeSync.UpdatedBlockTip(chainActive.Tip());
+    instantsend.UpdatedBlockTip(chainActive.Tip());
 
-    // ********************************************************* Step 11d: start ghostnode thread
+    // ********************************************************* Step 11d: start ghostnode maintenance
 
-    threadGroup.create_thread(boost::bind(&ThreadCheckDarkSendPool));
+    StartGhostnodeMaintenance(threadGroup);
+    scheduler.scheduleEvery(std::bind(&CInstantSend::RelayQueuedVotes, &instantsend), INSTANTSEND_VOTE_RELAY_INTERVAL_MS);
 
 
     // ********************************************************* Step 11e: start staking
@@ -2046,7 +2190,10 @@ bool AppInitMain()
             size_t nWallets = vpwallets.size();
             assert(nWallets > 0);
             size_t nThreads = std::min(nWallets, (size_t)gArgs.GetArg("-stakingthreads", 1));
+            // threads left over by the wallets split each wallet's kernel search
+            nStakeSearchThreads = std::max(1, (int)(gArgs.GetArg("-stakingthreads", 1) / nThreads));
 
+            StartStakeTemplateUpdates();
             size_t nPerThread = nWallets / nThreads;
             for (size_t i = 0; i < nThreads; ++i)
             {
@@ -2082,6 +2229,14 @@ bool AppInitMain()
         #endif
     }
 
+    // ********************************************************* Step 11g: start ghostkey generation
+    #ifdef ENABLE_WALLET
+    if (!vpwallets.empty()) {
+        ghostKeyPool.Start(std::max((int)gArgs.GetArg("-ghostkeypool", DEFAULT_GHOSTKEY_POOL_SIZE), 0), gArgs.GetArg("-ghostkeythreads", DEFAULT_GHOSTKEY_THREADS));
+        spendJobQueue.Start(gArgs.GetArg("-spendjobthreads", DEFAULT_SPEND_JOB_THREADS));
+    }
+    #endif
+
     // ********************************************************* Step 12: finished
 
     SetRPCWarmupFinished();
@@ -33,6 +33,7 @@ void CBasicKeyStore::ImplicitlyLearnRelatedKeyScripts(const CPubKey& pubkey)
         // This does not use AddCScript, as it may be overridden.
         CScriptID id(script);
         mapScripts[id] = std::move(script);
+        KeyStoreAdded(ToByteVector(id));
     }
 }
 
@@ -56,6 +57,7 @@ bool CBasicKeyStore::AddKeyPubKey(const CKey& key, const CPubKey &pubkey)
 {
     LOCK(cs_KeyStore);
     mapKeys[pubkey.GetID()] = key;
+    KeyStoreAdded(ToByteVector(pubkey.GetID()));
     ImplicitlyLearnRelatedKeyScripts(pubkey);
     return true;
 }
@@ -104,6 +106,7 @@ bool CBasicKeyStore::AddCScript(const CScript& redeemScript)
 
     LOCK(cs_KeyStore);
     mapScripts[CScriptID(redeemScript)] = redeemScript;
+    KeyStoreAdded(ToByteVector(CScriptID(redeemScript)));
     return true;
 }
 
@@ -155,9 +158,11 @@ bool CBasicKeyStore::AddWatchOnly(const CScript &dest)
 {
     LOCK(cs_KeyStore);
     setWatchOnly.insert(dest);
+    KeyStoreAdded(ToByteVector(dest));
     CPubKey pubKey;
     if (ExtractPubKey(dest, pubKey)) {
         mapWatchKeys[pubKey.GetID()] = pubKey;
+        KeyStoreAdded(ToByteVector(pubKey.GetID()));
         ImplicitlyLearnRelatedKeyScripts(pubKey);
     }
     return true;
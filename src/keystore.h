@@ -66,6 +66,8 @@ protected:
     WatchOnlySet setWatchOnly;
 
     void ImplicitlyLearnRelatedKeyScripts(const CPubKey& pubkey);
+    //! Called with cs_KeyStore held for every key id, script id and watch-only script added
+    virtual void KeyStoreAdded(const std::vector<unsigned char>& vchId) {}
 
 public:
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey) override;
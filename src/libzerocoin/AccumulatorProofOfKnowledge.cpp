@@ -34,9 +34,9 @@ namespace libzerocoin {
         Bignum r_2 = Bignum::randBignum(params->accumulatorModulus / 4);
         Bignum r_3 = Bignum::randBignum(params->accumulatorModulus / 4);
 
-        this->C_e = g_n.pow_mod(e, params->accumulatorModulus) * h_n.pow_mod(r_1, params->accumulatorModulus);
-        this->C_u = witness.getValue() * h_n.pow_mod(r_2, params->accumulatorModulus);
-        this->C_r = g_n.pow_mod(r_2, params->accumulatorModulus) * h_n.pow_mod(r_3, params->accumulatorModulus);
+        this->C_e = g_n.pow_mod(e, params->accumulatorModulus, params->accumulatorModulusMont) * h_n.pow_mod(r_1, params->accumulatorModulus, params->accumulatorModulusMont);
+        this->C_u = witness.getValue() * h_n.pow_mod(r_2, params->accumulatorModulus, params->accumulatorModulusMont);
+        this->C_r = g_n.pow_mod(r_2, params->accumulatorModulus, params->accumulatorModulusMont) * h_n.pow_mod(r_3, params->accumulatorModulus, params->accumulatorModulusMont);
 
         Bignum r_alpha = Bignum::randBignum(params->maxCoinValue * Bignum(2).pow(params->k_prime + params->k_dprime));
         if (!(Bignum::randBignum(Bignum(3)) % 2)) {
@@ -78,31 +78,31 @@ namespace libzerocoin {
             r_delta = 0 - r_delta;
         }
 
-        this->st_1 = (sg.pow_mod(r_alpha, params->accumulatorPoKCommitmentGroup.modulus) *
-                      sh.pow_mod(r_phi, params->accumulatorPoKCommitmentGroup.modulus)) %
+        this->st_1 = (sg.pow_mod(r_alpha, params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont) *
+                      sh.pow_mod(r_phi, params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont)) %
                      params->accumulatorPoKCommitmentGroup.modulus;
         this->st_2 = (((commitmentToCoin.getCommitmentValue() *
                         sg.inverse(params->accumulatorPoKCommitmentGroup.modulus)).pow_mod(r_gamma,
-                                                                                           params->accumulatorPoKCommitmentGroup.modulus)) *
-                      sh.pow_mod(r_psi, params->accumulatorPoKCommitmentGroup.modulus)) %
+                                                                                           params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont)) *
+                      sh.pow_mod(r_psi, params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont)) %
                      params->accumulatorPoKCommitmentGroup.modulus;
         this->st_3 = ((sg * commitmentToCoin.getCommitmentValue()).pow_mod(r_sigma,
-                                                                           params->accumulatorPoKCommitmentGroup.modulus) *
-                      sh.pow_mod(r_xi, params->accumulatorPoKCommitmentGroup.modulus)) %
+                                                                           params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont) *
+                      sh.pow_mod(r_xi, params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont)) %
                      params->accumulatorPoKCommitmentGroup.modulus;
 
         this->t_1 =
-                (h_n.pow_mod(r_zeta, params->accumulatorModulus) * g_n.pow_mod(r_epsilon, params->accumulatorModulus)) %
+                (h_n.pow_mod(r_zeta, params->accumulatorModulus, params->accumulatorModulusMont) * g_n.pow_mod(r_epsilon, params->accumulatorModulus, params->accumulatorModulusMont)) %
                 params->accumulatorModulus;
         this->t_2 =
-                (h_n.pow_mod(r_eta, params->accumulatorModulus) * g_n.pow_mod(r_alpha, params->accumulatorModulus)) %
+                (h_n.pow_mod(r_eta, params->accumulatorModulus, params->accumulatorModulusMont) * g_n.pow_mod(r_alpha, params->accumulatorModulus, params->accumulatorModulusMont)) %
                 params->accumulatorModulus;
-        this->t_3 = (C_u.pow_mod(r_alpha, params->accumulatorModulus) *
-                     ((h_n.inverse(params->accumulatorModulus)).pow_mod(r_beta, params->accumulatorModulus))) %
+        this->t_3 = (C_u.pow_mod(r_alpha, params->accumulatorModulus, params->accumulatorModulusMont) *
+                     ((h_n.inverse(params->accumulatorModulus)).pow_mod(r_beta, params->accumulatorModulus, params->accumulatorModulusMont))) %
                     params->accumulatorModulus;
-        this->t_4 = (C_r.pow_mod(r_alpha, params->accumulatorModulus) *
-                     ((h_n.inverse(params->accumulatorModulus)).pow_mod(r_delta, params->accumulatorModulus)) *
-                     ((g_n.inverse(params->accumulatorModulus)).pow_mod(r_beta, params->accumulatorModulus))) %
+        this->t_4 = (C_r.pow_mod(r_alpha, params->accumulatorModulus, params->accumulatorModulusMont) *
+                     ((h_n.inverse(params->accumulatorModulus)).pow_mod(r_delta, params->accumulatorModulus, params->accumulatorModulusMont)) *
+                     ((g_n.inverse(params->accumulatorModulus)).pow_mod(r_beta, params->accumulatorModulus, params->accumulatorModulusMont))) %
                     params->accumulatorModulus;
 
         CHashWriter hasher(0, 0);
@@ -144,37 +144,37 @@ namespace libzerocoin {
 
         Bignum c = Bignum(hasher.GetHash()); //this hash should be of length k_prime bits
 
-        Bignum st_1_prime = (valueOfCommitmentToCoin.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) *
-                             sg.pow_mod(s_alpha, params->accumulatorPoKCommitmentGroup.modulus) *
-                             sh.pow_mod(s_phi, params->accumulatorPoKCommitmentGroup.modulus)) %
+        Bignum st_1_prime = (valueOfCommitmentToCoin.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont) *
+                             sg.pow_mod(s_alpha, params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont) *
+                             sh.pow_mod(s_phi, params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont)) %
                             params->accumulatorPoKCommitmentGroup.modulus;
-        Bignum st_2_prime = (sg.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) * ((valueOfCommitmentToCoin *
+        Bignum st_2_prime = (sg.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont) * ((valueOfCommitmentToCoin *
                                                                                               sg.inverse(
                                                                                                       params->accumulatorPoKCommitmentGroup.modulus)).pow_mod(
-                s_gamma, params->accumulatorPoKCommitmentGroup.modulus)) *
-                             sh.pow_mod(s_psi, params->accumulatorPoKCommitmentGroup.modulus)) %
+                s_gamma, params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont)) *
+                             sh.pow_mod(s_psi, params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont)) %
                             params->accumulatorPoKCommitmentGroup.modulus;
-        Bignum st_3_prime = (sg.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) *
+        Bignum st_3_prime = (sg.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont) *
                              (sg * valueOfCommitmentToCoin).pow_mod(s_sigma,
-                                                                    params->accumulatorPoKCommitmentGroup.modulus) *
-                             sh.pow_mod(s_xi, params->accumulatorPoKCommitmentGroup.modulus)) %
+                                                                    params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont) *
+                             sh.pow_mod(s_xi, params->accumulatorPoKCommitmentGroup.modulus, params->accumulatorPoKCommitmentGroup.modulusMont)) %
                             params->accumulatorPoKCommitmentGroup.modulus;
 
         Bignum t_1_prime =
-                (C_r.pow_mod(c, params->accumulatorModulus) * h_n.pow_mod(s_zeta, params->accumulatorModulus) *
-                 g_n.pow_mod(s_epsilon, params->accumulatorModulus)) % params->accumulatorModulus;
+                (C_r.pow_mod(c, params->accumulatorModulus, params->accumulatorModulusMont) * h_n.pow_mod(s_zeta, params->accumulatorModulus, params->accumulatorModulusMont) *
+                 g_n.pow_mod(s_epsilon, params->accumulatorModulus, params->accumulatorModulusMont)) % params->accumulatorModulus;
         Bignum t_2_prime =
-                (C_e.pow_mod(c, params->accumulatorModulus) * h_n.pow_mod(s_eta, params->accumulatorModulus) *
-                 g_n.pow_mod(s_alpha, params->accumulatorModulus)) % params->accumulatorModulus;
+                (C_e.pow_mod(c, params->accumulatorModulus, params->accumulatorModulusMont) * h_n.pow_mod(s_eta, params->accumulatorModulus, params->accumulatorModulusMont) *
+                 g_n.pow_mod(s_alpha, params->accumulatorModulus, params->accumulatorModulusMont)) % params->accumulatorModulus;
 
-        Bignum t_3_prime = ((a.getValue()).pow_mod(c, params->accumulatorModulus) *
-                            C_u.pow_mod(s_alpha, params->accumulatorModulus) *
-                            ((h_n.inverse(params->accumulatorModulus)).pow_mod(s_beta, params->accumulatorModulus))) %
+        Bignum t_3_prime = ((a.getValue()).pow_mod(c, params->accumulatorModulus, params->accumulatorModulusMont) *
+                            C_u.pow_mod(s_alpha, params->accumulatorModulus, params->accumulatorModulusMont) *
+                            ((h_n.inverse(params->accumulatorModulus)).pow_mod(s_beta, params->accumulatorModulus, params->accumulatorModulusMont))) %
                            params->accumulatorModulus;
 
-        Bignum t_4_prime = (C_r.pow_mod(s_alpha, params->accumulatorModulus) *
-                            ((h_n.inverse(params->accumulatorModulus)).pow_mod(s_delta, params->accumulatorModulus)) *
-                            ((g_n.inverse(params->accumulatorModulus)).pow_mod(s_beta, params->accumulatorModulus))) %
+        Bignum t_4_prime = (C_r.pow_mod(s_alpha, params->accumulatorModulus, params->accumulatorModulusMont) *
+                            ((h_n.inverse(params->accumulatorModulus)).pow_mod(s_delta, params->accumulatorModulus, params->accumulatorModulusMont)) *
+                            ((g_n.inverse(params->accumulatorModulus)).pow_mod(s_beta, params->accumulatorModulus, params->accumulatorModulusMont))) %
                            params->accumulatorModulus;
 
         bool result = false;
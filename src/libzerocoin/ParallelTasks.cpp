@@ -1,122 +1,176 @@
 #include "ParallelTasks.h"
 
-#define BOOST_THREAD_PROVIDES_FUTURE
-
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
-#include <boost/thread/future.hpp>
-#include <boost/chrono.hpp>
 
-#include <queue>
+#include <atomic>
+#include <deque>
+#include <exception>
 #include <vector>
-#include <list>
 #include <algorithm>
 #include <functional>
+#include <mutex>
 
 namespace libzerocoin {
 
-#ifdef ZEROCOIN_THREADING
+// Tasks added so far and not finished yet, shared with the tasks themselves
+// so the waiting list can be reset while they run
+struct ParallelTasks::TaskGroup {
+    boost::mutex                              mutex;
+    boost::condition_variable                 condition;
+    size_t                                    outstanding;
+    std::exception_ptr                        error;
+
+    TaskGroup() : outstanding(0) {}
+
+    void Run(const std::function<void()> &task) {
+        std::exception_ptr taskError;
+        try {
+            task();
+        } catch (...) {
+            taskError = std::current_exception();
+        }
 
-// Number of seconds before thread shuts down if idle
-constexpr static int secondsBeforeThreadShutdown = 10;
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (taskError && !error)
+            error = taskError;
+        if (--outstanding == 0)
+            condition.notify_all();
+    }
+};
 
-// Simple thread pool class for using multiple cores effeciently
+#ifdef ZEROCOIN_THREADING
+
+// Thread pool sized to the hardware shared by all the parallel operations. Every
+// worker has its own queue, runs the newest task of it first and steals the
+// oldest tasks of the other workers when it runs out of work.
 
 static class ParallelOpThreadPool {
 private:
-    std::list<boost::thread>                  threads;
-    std::queue<boost::packaged_task<void>>    taskQueue;
-    boost::mutex                              taskQueueMutex;
-    boost::condition_variable                 taskQueueCondition;
-
+    struct WorkerQueue {
+        boost::mutex                          mutex;
+        std::deque<std::function<void()>>     tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<boost::thread>                threads;
+    std::once_flag                            startFlag;
+    std::atomic<size_t>                       nextQueue;
+
+    // Signals the idle workers that tasks were queued
+    boost::mutex                              wakeMutex;
+    boost::condition_variable                 wakeCondition;
+    size_t                                    queued;
     bool                                      shutdown;
-    size_t                                    numberOfThreads;
 
-    void ThreadProc() {
+    // Index of the worker run by the current thread, or -1 outside of the pool
+    static thread_local int workerIndex;
+
+    bool PopTask(int self, std::function<void()> &task) {
+        size_t nQueues = queues.size();
+        for (size_t n = 0; n < nQueues; n++) {
+            size_t i = self < 0 ? n : (self + n) % nQueues;
+            WorkerQueue &queue = *queues[i];
+            boost::unique_lock<boost::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                continue;
+            if (n == 0 && self >= 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            lock.unlock();
+
+            boost::unique_lock<boost::mutex> wakeLock(wakeMutex);
+            queued--;
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadProc(int index) {
+        workerIndex = index;
         for (;;) {
-            boost::packaged_task<void> job;
-            {
-                boost::unique_lock<boost::mutex> lock(taskQueueMutex);
-
-                taskQueueCondition.wait_for(lock, boost::chrono::seconds(secondsBeforeThreadShutdown),
-                                            [this] { return !taskQueue.empty() || shutdown; });
-                if (taskQueue.empty()) {
-                    // Either timeout or shutdown. If it's a timeout we need to delete ourself from the thread list and detach the thread
-                    // In case of shutdown thread list will be empty and destructor will wait for this thread completion
-                    boost::thread::id currentId = boost::this_thread::get_id();
-                    auto pThread = find_if(threads.begin(), threads.end(), [=](const boost::thread &t) { return t.get_id() == currentId; });
-                    if (pThread != threads.end()) {
-                        pThread->detach();
-                        threads.erase(pThread);
-                    }
-                    break;
-                }
-                job = std::move(taskQueue.front());
-                taskQueue.pop();
+            std::function<void()> task;
+            if (PopTask(index, task)) {
+                task();
+                continue;
             }
-            job();
+
+            boost::unique_lock<boost::mutex> lock(wakeMutex);
+            while (queued == 0 && !shutdown)
+                wakeCondition.wait(lock);
+            if (queued == 0 && shutdown)
+                break;
         }
     }
 
     void StartThreads() {
-        // should be called with mutex aquired
-        // start missing threads
-        while(threads.size() < numberOfThreads)
-            threads.emplace_back(std::bind(&ParallelOpThreadPool::ThreadProc, this));
+        for (size_t i = 0; i < queues.size(); i++)
+            threads.emplace_back(std::bind(&ParallelOpThreadPool::ThreadProc, this, (int)i));
     }
 
 public:
-    ParallelOpThreadPool() : shutdown(false), numberOfThreads(boost::thread::hardware_concurrency()) {}
+    ParallelOpThreadPool() : nextQueue(0), queued(0), shutdown(false) {
+        size_t numberOfThreads = std::max(boost::thread::hardware_concurrency(), 1u);
+        for (size_t i = 0; i < numberOfThreads; i++)
+            queues.emplace_back(new WorkerQueue());
+    }
 
     ~ParallelOpThreadPool() {
-        std::list<boost::thread> threadsToJoin;
-
-        taskQueueMutex.lock();
-
-        shutdown = true;
-        taskQueueCondition.notify_all();
-
-        // move the list to separate variable to wait for the shutdown process to complete
-        threadsToJoin.swap(threads);
-
-        taskQueueMutex.unlock();
+        {
+            boost::unique_lock<boost::mutex> lock(wakeMutex);
+            shutdown = true;
+            wakeCondition.notify_all();
+        }
 
         // wait for all the threads
-        for (boost::thread &t: threadsToJoin)
+        for (boost::thread &t: threads)
             t.join();
     }
 
-    // Post a task to the thread pool and return a future to wait for its completion
-    boost::future<void> PostTask(function<void()> task) {
-        boost::packaged_task<void> packagedTask(std::move(task));
-        boost::future<void> ret = packagedTask.get_future();
-
-        taskQueueMutex.lock();
-
-        // lazy start threads on first request or after shutdown
-        if (threads.size() < numberOfThreads)
-            StartThreads();
+    // Queue a task, on the queue of the current worker when called from the pool
+    void PostTask(std::function<void()> task) {
+        // lazy start threads on first request
+        std::call_once(startFlag, &ParallelOpThreadPool::StartThreads, this);
 
-        taskQueue.emplace(std::move(packagedTask));
-        taskQueueCondition.notify_one();
+        size_t i = workerIndex >= 0 ? workerIndex : nextQueue++ % queues.size();
 
-        taskQueueMutex.unlock();
+        boost::unique_lock<boost::mutex> lock(wakeMutex);
+        {
+            boost::unique_lock<boost::mutex> queueLock(queues[i]->mutex);
+            queues[i]->tasks.emplace_back(std::move(task));
+        }
+        queued++;
+        wakeCondition.notify_one();
+    }
 
-        return ret;
+    // Run one queued task on the calling thread, returns false if there are none
+    bool RunTask() {
+        std::function<void()> task;
+        if (!PopTask(workerIndex, task))
+            return false;
+        task();
+        return true;
     }
 
 } s_parallelOpThreadPool;
 
+thread_local int ParallelOpThreadPool::workerIndex = -1;
+
 #else
 
 static class ParallelOpThreadPool {
 public:
-    boost::future<void> PostTask(function<void()> task) {
+    void PostTask(std::function<void()> task) {
         task();
-        boost::promise<void> promise;
-        promise.set_value();
-        return promise.get_future();
+    }
+
+    bool RunTask() {
+        return false;
     }
 } s_parallelOpThreadPool;
 
@@ -124,21 +178,47 @@ public:
 
 // High level API to create number of parallel tasks and wait for completion
 
-ParallelTasks::ParallelTasks(int n) {
-    tasks.reserve(n);
+ParallelTasks::ParallelTasks(int n) : group(std::make_shared<TaskGroup>()) {
 }
 
-void ParallelTasks::Add(function<void()> task) {
-    tasks.push_back(s_parallelOpThreadPool.PostTask(std::move(task)));
+void ParallelTasks::Add(std::function<void()> task) {
+    {
+        boost::unique_lock<boost::mutex> lock(group->mutex);
+        group->outstanding++;
+    }
+    std::shared_ptr<TaskGroup> taskGroup = group;
+    s_parallelOpThreadPool.PostTask([taskGroup, task] { taskGroup->Run(task); });
 }
 
 void ParallelTasks::Wait() {
-    for (boost::future<void> &f: tasks)
-        f.get();
+    // Help with the queued tasks instead of blocking, so waiting from inside
+    // a task of the pool can not starve it
+    for (;;) {
+        {
+            boost::unique_lock<boost::mutex> lock(group->mutex);
+            if (group->outstanding == 0)
+                break;
+        }
+        if (s_parallelOpThreadPool.RunTask())
+            continue;
+
+        boost::unique_lock<boost::mutex> lock(group->mutex);
+        while (group->outstanding != 0)
+            group->condition.wait(lock);
+        break;
+    }
+
+    std::exception_ptr error;
+    {
+        boost::unique_lock<boost::mutex> lock(group->mutex);
+        std::swap(error, group->error);
+    }
+    if (error)
+        std::rethrow_exception(error);
 }
 
 void ParallelTasks::Reset() {
-    tasks.clear();
+    group = std::make_shared<TaskGroup>();
 }
 
 } // namespace libzerocoin
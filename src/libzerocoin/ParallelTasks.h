@@ -3,18 +3,17 @@
 
 #include <vector>
 #include <functional>
-
-#define BOOST_THREAD_PROVIDES_FUTURE
+#include <memory>
 
 #include "libzerocoin/Zerocoin.h"
-#include <boost/thread/future.hpp>
 #include <boost/thread.hpp>
 
 namespace libzerocoin {
 
 class ParallelTasks {
 private:
-    vector<boost::future<void>> tasks;
+    struct TaskGroup;
+    std::shared_ptr<TaskGroup> group;
 
 public:
     ParallelTasks(int n=0);
@@ -22,7 +21,8 @@ public:
     // add new task
     void Add(std::function<void()> task);
 
-    // wait for everything added so far
+    // wait for everything added so far, running queued tasks meanwhile.
+    // Rethrows the first exception thrown by one of the tasks
     void Wait();
 
     // clear all the tasks from the waiting list
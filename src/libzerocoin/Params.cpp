@@ -25,21 +25,36 @@ Params::Params(CBigNum N, CBigNum Nseed, uint32_t securityLevel) {
 
 	this->accumulatorParams.initialized = true;
 	this->initialized = true;
+
+	this->accumulatorParams.precompute();
+	this->coinCommitmentGroup.precompute();
+	this->serialNumberSoKCommitmentGroup.precompute();
 }
 
 AccumulatorAndProofParams::AccumulatorAndProofParams() {
 	this->initialized = false;
 }
 
+void AccumulatorAndProofParams::precompute() {
+	this->accumulatorModulusMont.Set(this->accumulatorModulus);
+	this->accumulatorPoKCommitmentGroup.precompute();
+	this->accumulatorQRNCommitmentGroup.precompute();
+}
+
 IntegerGroupParams::IntegerGroupParams() {
 	this->initialized = false;
 }
 
+void IntegerGroupParams::precompute() {
+	this->modulusMont.Set(this->modulus);
+	this->groupOrderMont.Set(this->groupOrder);
+}
+
 Bignum IntegerGroupParams::randomElement() const {
 	// The generator of the group raised
 	// to a random number less than the order of the group
 	// provides us with a uniformly distributed random number.
-	return this->g.pow_mod(Bignum::randBignum(this->groupOrder),this->modulus);
+	return this->g.pow_mod(Bignum::randBignum(this->groupOrder),this->modulus,this->modulusMont);
 }
 
 } /* namespace libzerocoin */
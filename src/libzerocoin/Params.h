@@ -53,6 +53,18 @@ public:
 	 */
     CBigNum groupOrder;
 
+	/**
+	 * Montgomery forms of the modulus and of the order,
+	 * derived from them by precompute()
+	 */
+    CBigNumMont modulusMont;
+    CBigNumMont groupOrderMont;
+
+	/**
+	 * Precomputes the Montgomery forms of the modulus and of the order
+	 */
+	void precompute();
+
 	ADD_SERIALIZE_METHODS;
 
 	template <typename Stream, typename Operation>
@@ -96,6 +108,12 @@ public:
 	 */
     CBigNum accumulatorModulus;
 
+	/**
+	 * Montgomery form of the accumulator modulus,
+	 * derived from it by precompute()
+	 */
+    CBigNumMont accumulatorModulusMont;
+
 	/**
 	 * The initial value for the accumulator
 	 * A random Quadratic residue mod n thats not 1
@@ -139,6 +157,12 @@ public:
 	 * The statistical zero-knowledgeness of the accumulator proof.
 	 */
 	uint32_t k_dprime;
+
+	/**
+	 * Precomputes the Montgomery forms of the moduli used by the accumulator proof
+	 */
+	void precompute();
+
 	ADD_SERIALIZE_METHODS;
 
 	template <typename Stream, typename Operation>
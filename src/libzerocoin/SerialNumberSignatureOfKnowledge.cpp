@@ -88,7 +88,7 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const Params*
             challenges.Add([this, i, &r, &v, &b, &commitmentToCoin, &coin] {
                 s_notprime[i]   = r[i] - coin.getRandomness();
                 sprime[i]       = v[i] - (commitmentToCoin.getRandomness() *
-			                              b.pow_mod(r[i] - coin.getRandomness(), params->serialNumberSoKCommitmentGroup.groupOrder));
+			                              b.pow_mod(r[i] - coin.getRandomness(), params->serialNumberSoKCommitmentGroup.groupOrder, params->serialNumberSoKCommitmentGroup.groupOrderMont));
             });
 		}
     }
@@ -103,10 +103,10 @@ inline Bignum SerialNumberSignatureOfKnowledge::challengeCalculation(const Bignu
 	Bignum g = params->serialNumberSoKCommitmentGroup.g;
 	Bignum h = params->serialNumberSoKCommitmentGroup.h;
 
-	Bignum exponent = (a.pow_mod(a_exp, params->serialNumberSoKCommitmentGroup.groupOrder)
-	                   * b.pow_mod(b_exp, params->serialNumberSoKCommitmentGroup.groupOrder)) % params->serialNumberSoKCommitmentGroup.groupOrder;
+	Bignum exponent = (a.pow_mod(a_exp, params->serialNumberSoKCommitmentGroup.groupOrder, params->serialNumberSoKCommitmentGroup.groupOrderMont)
+	                   * b.pow_mod(b_exp, params->serialNumberSoKCommitmentGroup.groupOrder, params->serialNumberSoKCommitmentGroup.groupOrderMont)) % params->serialNumberSoKCommitmentGroup.groupOrder;
 
-	return (g.pow_mod(exponent, params->serialNumberSoKCommitmentGroup.modulus) * h.pow_mod(h_exp, params->serialNumberSoKCommitmentGroup.modulus)) % params->serialNumberSoKCommitmentGroup.modulus;
+	return (g.pow_mod(exponent, params->serialNumberSoKCommitmentGroup.modulus, params->serialNumberSoKCommitmentGroup.modulusMont) * h.pow_mod(h_exp, params->serialNumberSoKCommitmentGroup.modulus, params->serialNumberSoKCommitmentGroup.modulusMont)) % params->serialNumberSoKCommitmentGroup.modulus;
 }
 
 bool SerialNumberSignatureOfKnowledge::Verify(const Bignum& coinSerialNumber, const Bignum& valueOfCommitmentToCoin,
@@ -143,9 +143,9 @@ bool SerialNumberSignatureOfKnowledge::Verify(const Bignum& coinSerialNumber, co
             if(challenge_bit) {
                 tprime[i] = challengeCalculation(coinSerialNumber, s_notprime[i], sprime[i]);
             } else {
-                Bignum exp = b.pow_mod(s_notprime[i], params->serialNumberSoKCommitmentGroup.groupOrder);
-                tprime[i] = ((valueOfCommitmentToCoin.pow_mod(exp, params->serialNumberSoKCommitmentGroup.modulus) % params->serialNumberSoKCommitmentGroup.modulus) *
-                             (h.pow_mod(sprime[i], params->serialNumberSoKCommitmentGroup.modulus) % params->serialNumberSoKCommitmentGroup.modulus)) %
+                Bignum exp = b.pow_mod(s_notprime[i], params->serialNumberSoKCommitmentGroup.groupOrder, params->serialNumberSoKCommitmentGroup.groupOrderMont);
+                tprime[i] = ((valueOfCommitmentToCoin.pow_mod(exp, params->serialNumberSoKCommitmentGroup.modulus, params->serialNumberSoKCommitmentGroup.modulusMont) % params->serialNumberSoKCommitmentGroup.modulus) *
+                             (h.pow_mod(sprime[i], params->serialNumberSoKCommitmentGroup.modulus, params->serialNumberSoKCommitmentGroup.modulusMont) % params->serialNumberSoKCommitmentGroup.modulus)) %
                             params->serialNumberSoKCommitmentGroup.modulus;
             }
         });
@@ -42,6 +42,10 @@
 // Activate multithreaded mode for proof verification
 #define ZEROCOIN_THREADING 1
 
+// Reuse one bignum context per thread and the precomputed Montgomery forms
+// of the moduli of the parameters in the exponentiations of the proofs
+#define ZEROCOIN_MONTGOMERY 1
+
 // Uses a fast technique for coin generation. Could be more vulnerable
 // to timing attacks. Turn off if an attacker can measure coin minting time.
 #define	ZEROCOIN_FAST_MINT 1
@@ -5,6 +5,7 @@
 #ifndef BITCOIN_BIGNUM_H
 #define BITCOIN_BIGNUM_H
 
+#include <memory>
 #include <stdexcept>
 #include <vector>
 #include <openssl/bn.h>
@@ -50,6 +51,25 @@ public:
     bool operator!() { return (pctx == NULL); }
 };
 
+#ifdef ZEROCOIN_MONTGOMERY
+/** BN_CTX of the calling thread, reused by every operation instead of allocating a context each time */
+class CThreadBN_CTX
+{
+public:
+    operator BN_CTX*()
+    {
+        static thread_local CAutoBN_CTX pctx;
+        return pctx;
+    }
+};
+
+typedef CThreadBN_CTX CBigNumCtx;
+#else
+typedef CAutoBN_CTX CBigNumCtx;
+#endif
+
+class CBigNumMont;
+
 
 /** C++ wrapper for BIGNUM (OpenSSL bignum) */class CBigNum
 {
@@ -452,7 +472,7 @@ public:
 
     std::string ToString(int nBase=10) const
     {
-        CAutoBN_CTX pctx;
+        CBigNumCtx pctx;
         CBigNum bnBase = nBase;
         CBigNum bn0 = 0;
         std::string str;
@@ -515,7 +535,7 @@ public:
      * @return
      */
     CBigNum pow(const CBigNum& e) const {
-        CAutoBN_CTX pctx;
+        CBigNumCtx pctx;
         CBigNum ret;
         if (!BN_exp(&ret, bn, &e, pctx))
             throw bignum_error("CBigNum::pow : BN_exp failed");
@@ -528,7 +548,7 @@ public:
      * @param m modulus
      */
     CBigNum mul_mod(const CBigNum& b, const CBigNum& m) const {
-        CAutoBN_CTX pctx;
+        CBigNumCtx pctx;
         CBigNum ret;
         if (!BN_mod_mul(&ret, bn, &b, &m, pctx))
             throw bignum_error("CBigNum::mul_mod : BN_mod_mul failed");
@@ -539,7 +559,7 @@ public:
 
     CBigNum mod_sqrt(const CBigNum& b){
         CBigNum ret;
-        CAutoBN_CTX pctx;
+        CBigNumCtx pctx;
         if (!BN_mod_sqrt(&ret,bn,&b,pctx))
             throw bignum_error("CBigNum::mod_sqrt : BN_mod_sqrt failed");
         return ret;
@@ -551,7 +571,7 @@ public:
      * @param m modulus
      */
     CBigNum pow_mod(const CBigNum& e, const CBigNum& m) const {
-        CAutoBN_CTX pctx;
+        CBigNumCtx pctx;
         CBigNum ret;
         if( e < 0){
             // g^-x = (g^-1)^x
@@ -566,6 +586,14 @@ public:
         return ret;
     }
 
+    /**
+     * modular exponentiation: this^e mod n, using the precomputed Montgomery form of n
+     * @param e exponent
+     * @param m modulus
+     * @param mont Montgomery form of m
+     */
+    CBigNum pow_mod(const CBigNum& e, const CBigNum& m, const CBigNumMont& mont) const;
+
     /**
      * Calculates the inverse of this element mod m.
      * i.e. i such this*i = 1 mod m
@@ -573,7 +601,7 @@ public:
      * @return the inverse
      */
     CBigNum inverse(const CBigNum& m) const {
-        CAutoBN_CTX pctx;
+        CBigNumCtx pctx;
         CBigNum ret;
         if (!BN_mod_inverse(&ret, bn, &m, pctx))
             throw bignum_error("CBigNum::inverse*= :BN_mod_inverse");
@@ -599,7 +627,7 @@ public:
      * @return the GCD
      */
     CBigNum gcd( const CBigNum& b) const{
-        CAutoBN_CTX pctx;
+        CBigNumCtx pctx;
         CBigNum ret;
         if (!BN_gcd(&ret, bn, &b, pctx))
             throw bignum_error("CBigNum::gcd*= :BN_gcd");
@@ -613,7 +641,7 @@ public:
      * @return true if prime
      */
     bool isPrime(const int checks=BN_prime_checks) const {
-        CAutoBN_CTX pctx;
+        CBigNumCtx pctx;
         int ret = BN_is_prime_ex(bn, checks, pctx, NULL);
         if(ret < 0){
             throw bignum_error("CBigNum::isPrime :BN_is_prime");
@@ -647,7 +675,7 @@ public:
 
     CBigNum& operator*=(const CBigNum& b)
     {
-        CAutoBN_CTX pctx;
+        CBigNumCtx pctx;
         if (!BN_mul(bn, bn, &b, pctx))
             throw bignum_error("CBigNum::operator*= : BN_mul failed");
         return *this;
@@ -741,6 +769,55 @@ public:
 
 
 
+/** Montgomery form of an odd modulus, computed once and shared by all the exponentiations modulo it */
+class CBigNumMont
+{
+private:
+    std::shared_ptr<BN_MONT_CTX> pmont;
+
+public:
+    /**
+     * Precomputes the Montgomery form of m. Nothing is computed for an even
+     * modulus or without ZEROCOIN_MONTGOMERY, exponentiations then use BN_mod_exp.
+     */
+    void Set(const CBigNum& m)
+    {
+        pmont.reset();
+#ifdef ZEROCOIN_MONTGOMERY
+        if (!BN_is_odd(&m))
+            return;
+        std::shared_ptr<BN_MONT_CTX> pnew(BN_MONT_CTX_new(), BN_MONT_CTX_free);
+        if (!pnew)
+            throw bignum_error("CBigNumMont::Set : BN_MONT_CTX_new failed");
+        CBigNumCtx pctx;
+        if (!BN_MONT_CTX_set(pnew.get(), &m, pctx))
+            throw bignum_error("CBigNumMont::Set : BN_MONT_CTX_set failed");
+        pmont = pnew;
+#endif
+    }
+
+    BN_MONT_CTX* get() const { return pmont.get(); }
+};
+
+inline CBigNum CBigNum::pow_mod(const CBigNum& e, const CBigNum& m, const CBigNumMont& mont) const
+{
+    if (mont.get() == NULL)
+        return pow_mod(e, m);
+
+    CBigNumCtx pctx;
+    CBigNum ret;
+    if (e < 0) {
+        // g^-x = (g^-1)^x
+        CBigNum inv = this->inverse(m);
+        CBigNum posE = e * -1;
+        if (!BN_mod_exp_mont(&ret, &inv, &posE, &m, pctx, mont.get()))
+            throw bignum_error("CBigNum::pow_mod : BN_mod_exp_mont failed on negative exponent");
+    } else if (!BN_mod_exp_mont(&ret, bn, &e, &m, pctx, mont.get()))
+        throw bignum_error("CBigNum::pow_mod : BN_mod_exp_mont failed");
+
+    return ret;
+}
+
 inline const CBigNum operator+(const CBigNum& a, const CBigNum& b)
 {
     CBigNum r;
@@ -766,7 +843,7 @@ inline const CBigNum operator-(const CBigNum& a)
 
 inline const CBigNum operator*(const CBigNum& a, const CBigNum& b)
 {
-    CAutoBN_CTX pctx;
+    CBigNumCtx pctx;
     CBigNum r;
     if (!BN_mul(&r, &a, &b, pctx))
         throw bignum_error("CBigNum::operator* : BN_mul failed");
@@ -775,7 +852,7 @@ inline const CBigNum operator*(const CBigNum& a, const CBigNum& b)
 
 inline const CBigNum operator/(const CBigNum& a, const CBigNum& b)
 {
-    CAutoBN_CTX pctx;
+    CBigNumCtx pctx;
     CBigNum r;
     if (!BN_div(&r, NULL, &a, &b, pctx))
         throw bignum_error("CBigNum::operator/ : BN_div failed");
@@ -784,7 +861,7 @@ inline const CBigNum operator/(const CBigNum& a, const CBigNum& b)
 
 inline const CBigNum operator%(const CBigNum& a, const CBigNum& b)
 {
-    CAutoBN_CTX pctx;
+    CBigNumCtx pctx;
     CBigNum r;
     if (!BN_nnmod(&r, &a, &b, pctx))
         throw bignum_error("CBigNum::operator% : BN_div failed");
@@ -0,0 +1,120 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/nix-config.h>
+#endif
+
+#include <lifecycle.h>
+
+#include <perf.h>
+#include <utiltime.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#ifdef ENABLE_USDT
+#include <sys/sdt.h>
+#endif
+
+std::atomic<bool> g_lifecycle_tracing(DEFAULT_LIFECYCLE_TRACING);
+
+namespace {
+
+struct CheapHasher
+{
+    size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
+};
+
+/** Fixed ring of records, a new object takes the place of the oldest */
+class CLifecycleRing
+{
+public:
+    explicit CLifecycleRing(size_t nSize) : vRecords(nSize), nNext(0)
+    {
+        mapIndex.reserve(nSize);
+    }
+
+    void Trace(const uint256& hash, LifecycleStage stage, bool fCreate)
+    {
+        const int64_t nNow = PerfTimeMicros();
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = mapIndex.find(hash);
+        if (it == mapIndex.end()) {
+            if (!fCreate)
+                return;
+            CLifecycleRecord& oldest = vRecords[nNext];
+            auto itOldest = mapIndex.find(oldest.hash);
+            if (itOldest != mapIndex.end() && itOldest->second == nNext)
+                mapIndex.erase(itOldest);
+            oldest.hash = hash;
+            oldest.nTime = GetTimeMicros();
+            oldest.vStageMicros.fill(0);
+            it = mapIndex.emplace(hash, nNext).first;
+            nNext = (nNext + 1) % vRecords.size();
+        }
+        int64_t& nStageMicros = vRecords[it->second].vStageMicros[(size_t)stage];
+        if (nStageMicros == 0)
+            nStageMicros = nNow;
+    }
+
+    bool Get(const uint256& hash, CLifecycleRecord& record)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = mapIndex.find(hash);
+        if (it == mapIndex.end())
+            return false;
+        record = vRecords[it->second];
+        return true;
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<CLifecycleRecord> vRecords;
+    std::unordered_map<uint256, size_t, CheapHasher> mapIndex;
+    size_t nNext;
+};
+
+CLifecycleRing& GetRing(LifecycleObject object)
+{
+    static CLifecycleRing txRing(LIFECYCLE_TX_RECORDS);
+    static CLifecycleRing blockRing(LIFECYCLE_BLOCK_RECORDS);
+    return object == LifecycleObject::TX ? txRing : blockRing;
+}
+
+} // namespace
+
+const char* LifecycleStageName(LifecycleStage stage)
+{
+    switch (stage) {
+    case LifecycleStage::RECEIVED: return "received";
+    case LifecycleStage::ACCEPTED: return "accepted";
+    case LifecycleStage::INSTANTSEND_LOCKED: return "instantsend_locked";
+    case LifecycleStage::GHOSTNODE_CHECKED: return "ghostnode_checked";
+    case LifecycleStage::CONNECTED: return "connected";
+    case LifecycleStage::TIP_UPDATED: return "tip_updated";
+    case LifecycleStage::RELAYED: return "relayed";
+    case LifecycleStage::ZMQ_PUBLISHED: return "zmq_published";
+    case LifecycleStage::WALLET_NOTIFIED: return "wallet_notified";
+    case LifecycleStage::COUNT: break;
+    }
+    return "unknown";
+}
+
+void TraceLifecycle(LifecycleObject object, const uint256& hash, LifecycleStage stage)
+{
+#ifdef ENABLE_USDT
+    DTRACE_PROBE3(nix, lifecycle, (int)object, hash.begin(), (int)stage);
+#endif
+    if (!g_lifecycle_tracing.load(std::memory_order_relaxed))
+        return;
+    const bool fCreate = object == LifecycleObject::BLOCK || stage == LifecycleStage::RECEIVED || stage == LifecycleStage::ACCEPTED;
+    GetRing(object).Trace(hash, stage, fCreate);
+}
+
+bool GetLifecycle(LifecycleObject object, const uint256& hash, CLifecycleRecord& record)
+{
+    return GetRing(object).Get(hash, record);
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_LIFECYCLE_H
+#define BITCOIN_LIFECYCLE_H
+
+#include <uint256.h>
+
+#include <array>
+#include <atomic>
+#include <stdint.h>
+
+/** -lifecycletrace default */
+static const bool DEFAULT_LIFECYCLE_TRACING = true;
+//! Transactions and blocks whose stages are kept, the oldest are overwritten
+static const size_t LIFECYCLE_TX_RECORDS = 4096;
+static const size_t LIFECYCLE_BLOCK_RECORDS = 256;
+
+enum class LifecycleObject : uint8_t
+{
+    TX,
+    BLOCK,
+};
+
+/** Stages of a transaction or block between receiving it and acting on it, roughly in their order */
+enum class LifecycleStage : uint8_t
+{
+    RECEIVED,           //!< received from a peer
+    ACCEPTED,           //!< tx: accepted to the mempool, its sigma proofs verified; block: checked and stored
+    INSTANTSEND_LOCKED, //!< tx: its InstantSend lock completed
+    GHOSTNODE_CHECKED,  //!< block: its ghostnode payments checked
+    CONNECTED,          //!< tx: connected in a block; block: connected by ConnectBlock
+    TIP_UPDATED,        //!< block: became the tip of the active chain
+    RELAYED,            //!< announced to peers
+    ZMQ_PUBLISHED,      //!< published to the ZMQ notifiers
+    WALLET_NOTIFIED,    //!< handed to the wallets
+    COUNT,
+};
+
+const char* LifecycleStageName(LifecycleStage stage);
+
+/** The stages a transaction or block went through */
+struct CLifecycleRecord
+{
+    uint256 hash;
+    //! Wall clock time of the first stage, in microseconds
+    int64_t nTime;
+    //! PerfTimeMicros of every stage, 0 for the stages not reached
+    std::array<int64_t, (size_t)LifecycleStage::COUNT> vStageMicros;
+};
+
+/** Whether stages are kept in the ring buffers, the tracepoints fire regardless */
+extern std::atomic<bool> g_lifecycle_tracing;
+
+/**
+ * Records that the transaction or block reached a stage, only its first time there counts.
+ * Fires the nix:lifecycle USDT tracepoint when built with --enable-usdt, with the object
+ * type, a pointer to the 32 byte hash and the stage as arguments. Transactions only get a
+ * new record when received or accepted, later stages of others are not kept.
+ */
+void TraceLifecycle(LifecycleObject object, const uint256& hash, LifecycleStage stage);
+
+bool GetLifecycle(LifecycleObject object, const uint256& hash, CLifecycleRecord& record);
+
+#endif // BITCOIN_LIFECYCLE_H
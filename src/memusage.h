@@ -6,9 +6,11 @@
 #define BITCOIN_MEMUSAGE_H
 
 #include <indirectmap.h>
+#include <support/allocators/pool.h>
 
 #include <stdlib.h>
 
+#include <list>
 #include <map>
 #include <set>
 #include <vector>
@@ -146,9 +148,10 @@ static inline size_t DynamicUsage(const std::shared_ptr<X>& p)
 }
 
 template<typename X>
-struct unordered_node : private X
+struct unordered_node
 {
 private:
+    X x;
     void* ptr;
 };
 
@@ -164,6 +167,38 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+// The nodes live in the chunks of the pool, which are kept when nodes are erased
+template<typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z, std::equal_to<X>, pool_allocator<std::pair<const X, Y> > >& m)
+{
+    return MallocUsage(CPoolResource::CHUNK_SIZE) * m.get_allocator().pool->Chunks() + MallocUsage(sizeof(void*) * m.bucket_count());
+}
+
+template<typename X>
+struct stl_list_node
+{
+private:
+    void* prev;
+    void* next;
+    X x;
+};
+
+template<typename X>
+static inline size_t DynamicUsage(const std::list<X>& l)
+{
+    return MallocUsage(sizeof(stl_list_node<X>)) * l.size();
+}
+
+/** Usage of a map together with the heap memory held by its values, which must have a DynamicUsage of their own */
+template<typename M>
+static inline size_t DynamicUsageWithValues(const M& m)
+{
+    size_t nUsage = DynamicUsage(m);
+    for (const auto& entry : m)
+        nUsage += DynamicUsage(entry.second);
+    return nUsage;
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
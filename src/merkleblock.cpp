@@ -9,6 +9,62 @@
 #include <consensus/consensus.h>
 #include <utilstrencodings.h>
 
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace {
+
+/** Bloom filter elements of the recently filtered blocks, by block hash */
+class CBloomElementsCache
+{
+private:
+    typedef std::pair<uint256, std::shared_ptr<const std::vector<CBloomTxElements> > > Entry;
+    std::mutex mtx;
+    std::list<Entry> lru;
+    std::map<uint256, std::list<Entry>::iterator> mapBlocks;
+
+public:
+    std::shared_ptr<const std::vector<CBloomTxElements> > Get(const CBlock& block)
+    {
+        uint256 hash = block.GetHash();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = mapBlocks.find(hash);
+            if (it != mapBlocks.end()) {
+                lru.splice(lru.begin(), lru, it->second);
+                return it->second->second;
+            }
+        }
+
+        // parsed outside the lock, a block asked for twice at once is parsed twice
+        auto pelements = std::make_shared<std::vector<CBloomTxElements> >();
+        pelements->reserve(block.vtx.size());
+        for (const auto& tx : block.vtx)
+            pelements->emplace_back(*tx);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!mapBlocks.count(hash)) {
+            lru.emplace_front(hash, pelements);
+            mapBlocks.emplace(hash, lru.begin());
+            if (lru.size() > MAX_BLOOM_ELEMENTS_CACHE) {
+                mapBlocks.erase(lru.back().first);
+                lru.pop_back();
+            }
+        }
+        return pelements;
+    }
+};
+
+CBloomElementsCache bloomElementsCache;
+
+} // namespace
+
+std::shared_ptr<const std::vector<CBloomTxElements> > GetBlockBloomElements(const CBlock& block)
+{
+    return bloomElementsCache.Get(block);
+}
+
 
 CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter* filter, const std::set<uint256>* txids)
 {
@@ -20,12 +76,16 @@ CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter* filter, const std:
     vMatch.reserve(block.vtx.size());
     vHashes.reserve(block.vtx.size());
 
+    std::shared_ptr<const std::vector<CBloomTxElements> > pelements;
+    if (filter)
+        pelements = GetBlockBloomElements(block);
+
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const uint256& hash = block.vtx[i]->GetHash();
         if (txids && txids->count(hash)) {
             vMatch.push_back(true);
-        } else if (filter && filter->IsRelevantAndUpdate(*block.vtx[i])) {
+        } else if (filter && filter->IsRelevantAndUpdate((*pelements)[i])) {
             vMatch.push_back(true);
             vMatchedTxn.emplace_back(i, hash);
         } else {
@@ -11,8 +11,15 @@
 #include <primitives/block.h>
 #include <bloom.h>
 
+#include <memory>
 #include <vector>
 
+//! Blocks whose bloom filter elements are kept for the next peers asking for them filtered
+static const unsigned int MAX_BLOOM_ELEMENTS_CACHE = 16;
+
+/** The bloom filter elements of the transactions of block, parsed once for the recently filtered blocks */
+std::shared_ptr<const std::vector<CBloomTxElements> > GetBlockBloomElements(const CBlock& block);
+
 /** Data structure that represents a partial merkle tree.
  *
  * It represents a subset of the txid's of a known block, in a way that
@@ -78,7 +78,7 @@ BlockAssembler::BlockAssembler(const CChainParams& params, const Options& option
     nBlockMaxWeight = std::max<size_t>(4000, std::min<size_t>(MAX_BLOCK_WEIGHT - 4000, options.nBlockMaxWeight));
 }
 
-static BlockAssembler::Options DefaultOptions(const CChainParams& params)
+BlockAssembler::Options BlockAssembler::DefaultOptions(const CChainParams& params)
 {
     // Block resource limits
     // If neither -blockmaxsize or -blockmaxweight is given, limit to DEFAULT_BLOCK_MAX_*
@@ -106,6 +106,7 @@ void BlockAssembler::resetBlock()
     nBlockWeight = 4000;
     nBlockSize = 0;
     nBlockSigOpsCost = 400;
+    nBlockValidationWeight = 0;
     fIncludeWitness = false;
 
     // These counters do not include coinbase tx
@@ -304,6 +305,7 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
     nBlockWeight += iter->GetTxWeight();
     ++nBlockTx;
     nBlockSigOpsCost += iter->GetSigOpCost();
+    nBlockValidationWeight += iter->GetValidationWeight();
     nFees += iter->GetFee();
     inBlock.insert(iter);
 
@@ -497,6 +499,10 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
             bool isMint = sortedEntries[i]->GetTx().IsZerocoinMint() || sortedEntries[i]->GetTx().IsSigmaMint();
             bool isSpend = sortedEntries[i]->GetTx().IsZerocoinSpend() || sortedEntries[i]->GetTx().IsSigmaSpend();
 
+            // bound the time needed to verify the proofs of the block
+            if (isSpend && nBlockValidationWeight + sortedEntries[i]->GetValidationWeight() > MAX_BLOCK_VALIDATION_WEIGHT)
+                continue;
+
             //require 0.25% tx fee for new zerocoin mints
             if(isMint && !isSpend){
                 CAmount mintAmount = 0;
@@ -28,6 +28,7 @@ struct CBlockTemplate
     std::vector<CAmount> vTxFees;
     std::vector<int64_t> vTxSigOpsCost;
     std::vector<unsigned char> vchCoinbaseCommitment;
+    CAmount nGhostFees = -1; //!< Ghost fees of the transactions, set by the staker on first use
 };
 
 // Container for tracking updates to ancestor feerate as we include (parent)
@@ -138,6 +139,7 @@ private:
     uint64_t nBlockTx;
     uint64_t nBlockSize;
     uint64_t nBlockSigOpsCost;
+    uint64_t nBlockValidationWeight;
     CAmount nFees;
     CTxMemPool::setEntries inBlock;
 
@@ -156,6 +158,9 @@ public:
     explicit BlockAssembler(const CChainParams& params);
     BlockAssembler(const CChainParams& params, const Options& options);
 
+    /** Options from -blockmaxweight and -blockmintxfee */
+    static Options DefaultOptions(const CChainParams& params);
+
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx=true);
 
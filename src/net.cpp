@@ -16,6 +16,7 @@
 #include <crypto/sha256.h>
 #include <primitives/transaction.h>
 #include <netbase.h>
+#include <netevents.h>
 #include <scheduler.h>
 #include <ui_interface.h>
 #include <utilstrencodings.h>
@@ -711,6 +712,10 @@ void CNode::copyStats(CNodeStats &stats)
         X(mapRecvBytesPerMsgCmd);
         X(nRecvBytes);
     }
+    {
+        LOCK(cs_processStats);
+        X(mapProcessPerMsgCmd);
+    }
     X(fWhitelisted);
 
     // It is common for nodes with good ping times to suddenly become lagged,
@@ -727,6 +732,7 @@ void CNode::copyStats(CNodeStats &stats)
     // Raw ping time is in microseconds, but show it to user as whole seconds (Bitcoin users should be well used to small numbers with many decimal places by now :)
     stats.dPingTime = (((double)nPingUsecTime) / 1e6);
     stats.dMinPing  = (((double)nMinPingUsecTime) / 1e6);
+    stats.dBlockDelivery = (((double)nBlockDeliveryUsec) / 1e6);
     stats.dPingWait = (((double)nPingUsecWait) / 1e6);
 
     // Leave string empty if addrLocal invalid (not filled in yet)
@@ -1151,6 +1157,15 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
 
 void CConnman::ThreadSocketHandler()
 {
+    CSocketEvents events;
+    LogPrint(BCLog::NET, "socket handler using %s\n", events.GetBackendName());
+    std::vector<std::pair<SOCKET, uint8_t>> vReady;
+    std::unordered_map<SOCKET, uint8_t> mapReady;
+    auto fnReady = [&mapReady](SOCKET hSocket) {
+        auto it = mapReady.find(hSocket);
+        return it == mapReady.end() ? uint8_t(CSocketEvents::NONE) : it->second;
+    };
+
     unsigned int nPrevNodeCount = 0;
     while (!interruptNet)
     {
@@ -1218,24 +1233,11 @@ void CConnman::ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
+        const int nTimeoutMs = 50; // frequency to poll pnode->vSend
 
-        for (const ListenSocket& hListenSocket : vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
+        // Only sockets whose events changed since the last pass reach the kernel
+        for (const ListenSocket& hListenSocket : vhListenSocket)
+            events.Set(hListenSocket.socket, -1, CSocketEvents::RECV);
 
         {
             LOCK(cs_vNodes);
@@ -1263,46 +1265,41 @@ void CConnman::ThreadSocketHandler()
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
 
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
-                }
+                uint8_t nEvents = CSocketEvents::NONE;
+                if (select_send)
+                    nEvents = CSocketEvents::SEND;
+                else if (select_recv)
+                    nEvents = CSocketEvents::RECV;
+                events.Set(pnode->hSocket, pnode->GetId(), nEvents);
             }
         }
+        events.RemoveStale();
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        bool fWaited = events.Wait(nTimeoutMs, vReady);
         if (interruptNet)
             return;
 
-        if (nSelect == SOCKET_ERROR)
+        if (!fWaited)
         {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
+            int nErr = WSAGetLastError();
+            events.GetWatched(vReady);
+            if (!vReady.empty())
+                LogPrintf("socket %s error %s\n", events.GetBackendName(), NetworkErrorString(nErr));
+            for (auto& ready : vReady)
+                ready.second = CSocketEvents::RECV;
+            if (!interruptNet.sleep_for(std::chrono::milliseconds(nTimeoutMs)))
                 return;
         }
+        mapReady.clear();
+        for (const auto& ready : vReady)
+            mapReady[ready.first] |= ready.second;
 
         //
         // Accept new connections
         //
         for (const ListenSocket& hListenSocket : vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket != INVALID_SOCKET && (fnReady(hListenSocket.socket) & CSocketEvents::RECV))
             {
                 AcceptConnection(hListenSocket);
             }
@@ -1333,9 +1330,10 @@ void CConnman::ThreadSocketHandler()
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+                uint8_t nReady = fnReady(pnode->hSocket);
+                recvSet = nReady & CSocketEvents::RECV;
+                sendSet = nReady & CSocketEvents::SEND;
+                errorSet = nReady & CSocketEvents::ERR;
             }
             if (recvSet || errorSet)
             {
@@ -1451,7 +1449,7 @@ void CConnman::WakeMessageHandler()
         std::lock_guard<std::mutex> lock(mutexMsgProc);
         fMsgProcWake = true;
     }
-    condMsgProc.notify_one();
+    condMsgProc.notify_all();
 }
 
 
@@ -1777,6 +1775,7 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
         // Only connect out to one peer per network group (/16 for IPv4).
         // Do this here so we don't have to critsect vNodes inside mapAddresses critsect.
         int nOutbound = 0;
+        int nClearnetOutbound = 0;
         std::set<std::vector<unsigned char> > setConnected;
         {
             LOCK(cs_vNodes);
@@ -1789,6 +1788,8 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
                     // to prevent us from connecting to particular hosts if we used them here.
                     setConnected.insert(pnode->addr.GetGroup());
                     nOutbound++;
+                    if (pnode->addr.IsIPv4() || pnode->addr.IsIPv6())
+                        nClearnetOutbound++;
                 }
             }
         }
@@ -1817,6 +1818,10 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
             }
         }
 
+        // Onion peers are fine for transactions and ghostnode messages, but blocks
+        // propagate faster over a few low latency IPv4/IPv6 peers.
+        bool fNeedClearnet = !fFeeler && nClearnetOutbound < MIN_CLEARNET_OUTBOUND_CONNECTIONS && PreferClearnetOutbound();
+
         int64_t nANow = GetAdjustedTime();
         int nTries = 0;
         while (!interruptNet)
@@ -1837,6 +1842,10 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
             if (IsLimited(addr))
                 continue;
 
+            // look for IPv4/IPv6 peers first, unless addrman has hardly any
+            if (fNeedClearnet && !addr.IsIPv4() && !addr.IsIPv6() && nTries < 50)
+                continue;
+
             // only consider very recently tried nodes after 30 failed attempts
             if (nANow - addr.nLastTry < 600 && nTries < 30)
                 continue;
@@ -1992,7 +2001,7 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
     }
 }
 
-void CConnman::ThreadMessageHandler()
+void CConnman::ThreadMessageHandler(int nWorker)
 {
     while (!flagInterruptMsgProc)
     {
@@ -2007,11 +2016,18 @@ void CConnman::ThreadMessageHandler()
 
         bool fMoreWork = false;
 
-        for (CNode* pnode : vNodesCopy)
+        // Workers start at different peers, a peer taken by another worker is skipped
+        size_t nStart = vNodesCopy.size() * nWorker / nMessageHandlerThreads;
+        for (size_t i = 0; i < vNodesCopy.size(); i++)
         {
+            CNode* pnode = vNodesCopy[(nStart + i) % vNodesCopy.size()];
             if (pnode->fDisconnect)
                 continue;
 
+            bool fBusy = false;
+            if (!pnode->fProcessingMessages.compare_exchange_strong(fBusy, true))
+                continue;
+
             // Receive messages
             bool fMoreNodeWork = m_msgproc->ProcessMessages(pnode, flagInterruptMsgProc);
             fMoreWork |= (fMoreNodeWork && !pnode->fPauseSend);
@@ -2022,6 +2038,7 @@ void CConnman::ThreadMessageHandler()
                 LOCK(pnode->cs_sendProcessing);
                 m_msgproc->SendMessages(pnode, flagInterruptMsgProc);
             }
+            pnode->fProcessingMessages = false;
 
             if (flagInterruptMsgProc)
                 return;
@@ -2263,6 +2280,13 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         nMaxOutboundTotalBytesSentInCycle = 0;
         nMaxOutboundCycleStartTime = 0;
     }
+    {
+        LOCK(cs_totalProcess);
+        mapTotalProcessPerMsgCmd.clear();
+        for (const std::string &msg : getAllNetMessageTypes())
+            mapTotalProcessPerMsgCmd[msg];
+        mapTotalProcessPerMsgCmd[NET_MESSAGE_COMMAND_OTHER];
+    }
 
     if (fListen && !InitBinds(connOptions.vBinds, connOptions.vWhiteBinds)) {
         if (clientInterface) {
@@ -2360,7 +2384,9 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         threadOpenConnections = std::thread(&TraceThread<std::function<void()> >, "opencon", std::function<void()>(std::bind(&CConnman::ThreadOpenConnections, this, connOptions.m_specified_outgoing)));
 
     // Process messages
-    threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    LogPrintf("Using %d message handler threads\n", nMessageHandlerThreads);
+    for (int i = 0; i < nMessageHandlerThreads; i++)
+        threadMessageHandlers.emplace_back(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this, i)));
 
     // Dump network addresses
     scheduler.scheduleEvery(std::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL * 1000);
@@ -2409,8 +2435,9 @@ void CConnman::Interrupt()
 
 void CConnman::Stop()
 {
-    if (threadMessageHandler.joinable())
-        threadMessageHandler.join();
+    for (std::thread& thread : threadMessageHandlers)
+        thread.join();
+    threadMessageHandlers.clear();
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
@@ -2669,6 +2696,88 @@ uint64_t CConnman::GetTotalBytesSent()
     return nTotalBytesSent;
 }
 
+static void AddLatencySample(int64_t& nAverage, int64_t nSample)
+{
+    nAverage = nAverage ? (nAverage * 7 + nSample) / 8 : nSample;
+}
+
+void CConnman::RecordPingTime(CNode* pnode, int64_t nPingUsec)
+{
+    LOCK(cs_netLatency);
+    AddLatencySample(netLatency[pnode->addr.GetNetwork()].nPingUsec, nPingUsec);
+}
+
+void CConnman::RecordBlockDelivery(CNode* pnode, int64_t nDeliveryUsec)
+{
+    int64_t nNodeAverage = pnode->nBlockDeliveryUsec;
+    AddLatencySample(nNodeAverage, nDeliveryUsec);
+    pnode->nBlockDeliveryUsec = nNodeAverage;
+
+    LOCK(cs_netLatency);
+    AddLatencySample(netLatency[pnode->addr.GetNetwork()].nBlockDeliveryUsec, nDeliveryUsec);
+}
+
+CNetLatencyStats CConnman::GetNetworkLatency(enum Network net)
+{
+    LOCK(cs_netLatency);
+    return netLatency[net];
+}
+
+bool CConnman::PreferClearnetOutbound()
+{
+    if (IsLimited(NET_IPV4) && IsLimited(NET_IPV6))
+        return false;
+
+    // Until both sides are measured assume clearnet is faster, which it usually is
+    LOCK(cs_netLatency);
+    const CNetLatencyStats& onion = netLatency[NET_TOR];
+    int64_t nClearnetPing = 0;
+    int64_t nClearnetDelivery = 0;
+    for (enum Network net : {NET_IPV4, NET_IPV6}) {
+        if (netLatency[net].nPingUsec && (!nClearnetPing || netLatency[net].nPingUsec < nClearnetPing))
+            nClearnetPing = netLatency[net].nPingUsec;
+        if (netLatency[net].nBlockDeliveryUsec && (!nClearnetDelivery || netLatency[net].nBlockDeliveryUsec < nClearnetDelivery))
+            nClearnetDelivery = netLatency[net].nBlockDeliveryUsec;
+    }
+    if (onion.nBlockDeliveryUsec && nClearnetDelivery)
+        return nClearnetDelivery < onion.nBlockDeliveryUsec;
+    if (onion.nPingUsec && nClearnetPing)
+        return nClearnetPing < onion.nPingUsec;
+    return true;
+}
+
+static void AddMessageProcessing(mapMsgCmdProcess& mapProcess, const std::string& strCommand, int64_t nMicros, bool fNewMessage)
+{
+    // Only known commands get an entry of their own, so a peer cannot grow the map
+    mapMsgCmdProcess::iterator i = mapProcess.find(strCommand);
+    if (i == mapProcess.end())
+        i = mapProcess.find(NET_MESSAGE_COMMAND_OTHER);
+    assert(i != mapProcess.end());
+    if (fNewMessage)
+        i->second.nCount++;
+    i->second.nTimeMicros += nMicros > 0 ? nMicros : 0;
+}
+
+void CNode::RecordMessageProcessing(const std::string& strCommand, int64_t nMicros, bool fNewMessage)
+{
+    LOCK(cs_processStats);
+    AddMessageProcessing(mapProcessPerMsgCmd, strCommand, nMicros, fNewMessage);
+}
+
+void CConnman::RecordMessageProcessing(CNode* pnode, const std::string& strCommand, int64_t nMicros, bool fNewMessage)
+{
+    pnode->RecordMessageProcessing(strCommand, nMicros, fNewMessage);
+
+    LOCK(cs_totalProcess);
+    AddMessageProcessing(mapTotalProcessPerMsgCmd, strCommand, nMicros, fNewMessage);
+}
+
+mapMsgCmdProcess CConnman::GetTotalProcessPerMsgCmd()
+{
+    LOCK(cs_totalProcess);
+    return mapTotalProcessPerMsgCmd;
+}
+
 ServiceFlags CConnman::GetLocalServices() const
 {
     return nLocalServices;
@@ -2740,18 +2849,24 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nPingUsecTime = 0;
     fPingQueued = false;
     nMinPingUsecTime = std::numeric_limits<int64_t>::max();
+    nBlockDeliveryUsec = 0;
     minFeeFilter = 0;
     lastSentFeeFilter = 0;
     nextSendTimeFeeFilter = 0;
     fPauseRecv = false;
     fPauseSend = false;
+    fProcessingMessages = false;
     nProcessQueueSize = 0;
     //Ghostnode
     fGhostnode = false;
+    fSendGhostnodeBatches = false;
 
-    for (const std::string &msg : getAllNetMessageTypes())
+    for (const std::string &msg : getAllNetMessageTypes()) {
         mapRecvBytesPerMsgCmd[msg] = 0;
+        mapProcessPerMsgCmd[msg];
+    }
     mapRecvBytesPerMsgCmd[NET_MESSAGE_COMMAND_OTHER] = 0;
+    mapProcessPerMsgCmd[NET_MESSAGE_COMMAND_OTHER];
 
     if (fLogIPs) {
         LogPrint(BCLog::NET, "Added connection to %s peer=%d\n", addrName, id);
@@ -2812,7 +2927,7 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
     std::vector<unsigned char> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
-    uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
+    uint256 hash = msg.hashData.IsNull() ? Hash(msg.data.data(), msg.data.data() + nMessageSize) : msg.hashData;
     CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), nMessageSize);
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
@@ -2883,6 +2998,18 @@ void CConnman::RelayInv(CInv &inv, const int minProtoVersion) {
     }
 }
 
+void CConnman::RelayInvs(const std::vector<CInv>& vInv, const int minProtoVersion) {
+    LOCK(cs_vNodes);
+    BOOST_FOREACH(CNode * pnode, vNodes)
+    {
+        if (pnode->nVersion >= minProtoVersion) {
+            LOCK(pnode->cs_inventory);
+            BOOST_FOREACH(const CInv& inv, vInv)
+                pnode->PushInventory(inv);
+        }
+    }
+}
+
 std::vector<CNode *> CConnman::CopyNodeVector() {
     std::vector < CNode * > vecNodesCopy;
     LOCK(cs_vNodes);
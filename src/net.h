@@ -57,6 +57,8 @@ static const unsigned int MAX_PROTOCOL_MESSAGE_LENGTH = 4 * 1000 * 1000;
 static const unsigned int MAX_SUBVERSION_LENGTH = 256;
 /** Maximum number of automatic outgoing nodes */
 static const int MAX_OUTBOUND_CONNECTIONS = 8;
+/** Automatic outgoing nodes kept on IPv4/IPv6 for block relay while they answer faster than onion peers */
+static const int MIN_CLEARNET_OUTBOUND_CONNECTIONS = 2;
 /** Maximum number of addnode outgoing nodes */
 static const int MAX_ADDNODE_CONNECTIONS = 8;
 /** -listen default */
@@ -83,6 +85,9 @@ static const bool DEFAULT_BLOCKSONLY = false;
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** -msghandthreads default and limit */
+static const int DEFAULT_MSGHAND_THREADS = 2;
+static const int MAX_MSGHAND_THREADS = 16;
 
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Default 24-hour ban
@@ -100,6 +105,18 @@ struct AddedNodeInfo
 class CNodeStats;
 class CClientUIInterface;
 
+struct CMsgProcessStats {
+    uint64_t nCount = 0;
+    uint64_t nTimeMicros = 0;
+};
+typedef std::map<std::string, CMsgProcessStats> mapMsgCmdProcess; //command, messages handled and time spent on them
+
+/** Moving averages of the latency of the peers on one network, 0 until measured */
+struct CNetLatencyStats {
+    int64_t nPingUsec = 0;
+    int64_t nBlockDeliveryUsec = 0;
+};
+
 struct CSerializedNetMsg
 {
     CSerializedNetMsg() = default;
@@ -111,6 +128,8 @@ struct CSerializedNetMsg
 
     std::vector<unsigned char> data;
     std::string command;
+    // Hash of data when the sender already has it, PushMessage computes it otherwise
+    uint256 hashData;
 };
 
 class NetEventsInterface;
@@ -137,6 +156,7 @@ public:
         NetEventsInterface* m_msgproc = nullptr;
         unsigned int nSendBufferMaxSize = 0;
         unsigned int nReceiveFloodSize = 0;
+        int nMessageHandlerThreads = 1;
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
         std::vector<std::string> vSeedNodes;
@@ -158,6 +178,7 @@ public:
         m_msgproc = connOptions.m_msgproc;
         nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
         nReceiveFloodSize = connOptions.nReceiveFloodSize;
+        nMessageHandlerThreads = std::max(1, std::min(connOptions.nMessageHandlerThreads, MAX_MSGHAND_THREADS));
         {
             LOCK(cs_totalBytesSent);
             nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -305,6 +326,15 @@ public:
     uint64_t GetTotalBytesRecv();
     uint64_t GetTotalBytesSent();
 
+    /** Adds a ping round trip or the time a requested block took to arrive to the averages of pnode's network */
+    void RecordPingTime(CNode* pnode, int64_t nPingUsec);
+    void RecordBlockDelivery(CNode* pnode, int64_t nDeliveryUsec);
+    CNetLatencyStats GetNetworkLatency(enum Network net);
+
+    /** Accounts time spent handling a message from pnode to the node and to the totals */
+    void RecordMessageProcessing(CNode* pnode, const std::string& strCommand, int64_t nMicros, bool fNewMessage = true);
+    mapMsgCmdProcess GetTotalProcessPerMsgCmd();
+
     void SetBestHeight(int height);
     int GetBestHeight() const;
 
@@ -315,6 +345,7 @@ public:
 
     void WakeMessageHandler();
     void RelayInv(CInv &inv, const int minProtoVersion = MIN_PEER_PROTO_VERSION);
+    void RelayInvs(const std::vector<CInv>& vInv, const int minProtoVersion = MIN_PEER_PROTO_VERSION);
     std::vector<CNode*> vNodes;
     mutable CCriticalSection cs_vNodes;
     CNode* ConnectNode(CAddress addrConnect, const char *pszDest, bool fCountFailure, bool fConnectToGhostnode = false);
@@ -341,7 +372,7 @@ private:
     void AddOneShot(const std::string& strDest);
     void ProcessOneShot();
     void ThreadOpenConnections(std::vector<std::string> connect);
-    void ThreadMessageHandler();
+    void ThreadMessageHandler(int nWorker);
     void AcceptConnection(const ListenSocket& hListenSocket);
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
@@ -379,6 +410,17 @@ private:
     uint64_t nTotalBytesRecv GUARDED_BY(cs_totalBytesRecv);
     uint64_t nTotalBytesSent GUARDED_BY(cs_totalBytesSent);
 
+    /** Whether outbound slots should go to IPv4/IPv6 peers first, for faster block relay */
+    bool PreferClearnetOutbound();
+
+    // Latency per network class
+    CCriticalSection cs_netLatency;
+    CNetLatencyStats netLatency[NET_MAX] GUARDED_BY(cs_netLatency);
+
+    // Message handling totals over all peers
+    CCriticalSection cs_totalProcess;
+    mapMsgCmdProcess mapTotalProcessPerMsgCmd GUARDED_BY(cs_totalProcess);
+
     // outbound limit & stats
     uint64_t nMaxOutboundTotalBytesSentInCycle GUARDED_BY(cs_totalBytesSent);
     uint64_t nMaxOutboundCycleStartTime GUARDED_BY(cs_totalBytesSent);
@@ -415,6 +457,7 @@ private:
     int nMaxAddnode;
     int nMaxFeeler;
     std::atomic<int> nBestHeight;
+    int nMessageHandlerThreads;
     CClientUIInterface* clientInterface;
     NetEventsInterface* m_msgproc;
 
@@ -434,7 +477,7 @@ private:
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
-    std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessageHandlers;
 
     /** flag for deciding to connect to an extra outbound peer,
      *  in excess of nMaxOutbound
@@ -541,10 +584,12 @@ public:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     uint64_t nRecvBytes;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    mapMsgCmdProcess mapProcessPerMsgCmd;
     bool fWhitelisted;
     double dPingTime;
     double dPingWait;
     double dMinPing;
+    double dBlockDelivery;
     // Our address, as reported by the peer
     std::string addrLocal;
     // Address of this peer
@@ -685,11 +730,16 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+    // Set while a message handler thread processes this peer, which keeps its messages in order
+    std::atomic_bool fProcessingMessages;
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
 
+    CCriticalSection cs_processStats;
+    mapMsgCmdProcess mapProcessPerMsgCmd GUARDED_BY(cs_processStats);
+
 public:
     uint256 hashContinue;
     std::atomic<int> nStartingHeight;
@@ -739,6 +789,8 @@ public:
     std::atomic<int64_t> nPingUsecTime;
     // Best measured round-trip time.
     std::atomic<int64_t> nMinPingUsecTime;
+    // Moving average of the time requested blocks took to arrive, 0 until measured.
+    std::atomic<int64_t> nBlockDeliveryUsec;
     // Whether a ping is requested.
     std::atomic<bool> fPingQueued;
     // Minimum fee rate with which to filter inv's to this node
@@ -754,6 +806,8 @@ public:
 
     //Ghostnode
     bool fGhostnode;
+    // peer sent "sendmnbatch", reply to ghostnode list and payment sync requests with batches
+    std::atomic<bool> fSendGhostnodeBatches;
     SecMsgNode smsgData;
 
 private:
@@ -794,6 +848,9 @@ public:
 
     bool ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete);
 
+    /** Adds time spent handling a message, fNewMessage counts it as a message of its own */
+    void RecordMessageProcessing(const std::string& strCommand, int64_t nMicros, bool fNewMessage);
+
     void SetRecvVersion(int nVersionIn)
     {
         nRecvVersion = nVersionIn;
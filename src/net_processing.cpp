@@ -8,14 +8,17 @@
 #include <addrman.h>
 #include <arith_uint256.h>
 #include <blockencodings.h>
+#include <blockfilterindex.h>
 #include <chainparams.h>
 #include <consensus/validation.h>
 #include <hash.h>
 #include <init.h>
+#include <lifecycle.h>
 #include <validation.h>
 #include <merkleblock.h>
 #include <netmessagemaker.h>
 #include <netbase.h>
+#include <perf.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <primitives/block.h>
@@ -29,6 +32,7 @@
 #include <util.h>
 #include <utilmoneystr.h>
 #include <utilstrencodings.h>
+#include <zerocoin/sigma.h>
 
 #include "ghostnode/activeghostnode.h"
 #include "ghostnode/darksend.h"
@@ -41,6 +45,15 @@
 #include "ghostnode/spork.h"
 #include "ghostnode/flat-database.h"
 
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
 #if defined(NDEBUG)
 # error "NIX cannot be compiled without assertions."
 #endif
@@ -80,6 +93,17 @@ static const int STALE_RELAY_AGE_LIMIT = 30 * 24 * 60 * 60;
 /// limiting block relay. Set to one week, denominated in seconds.
 static const int HISTORICAL_BLOCK_AGE = 7 * 24 * 60 * 60;
 
+/// Blocks kept in their serialized form for peers that request the same block
+/// at about the same time, such as a new tip.
+static const size_t MAX_RAW_BLOCK_CACHE = 8;
+
+/// Most filters served for one getcfilters, and filter hashes for one getcfheaders,
+/// as BIP157 limits them.
+static const uint32_t MAX_GETCFILTERS_SIZE = 1000;
+static const uint32_t MAX_GETCFHEADERS_SIZE = 2000;
+/// Height interval of the filter headers in a cfcheckpt message.
+static const int CFCHECKPT_INTERVAL = 1000;
+
 // Internal stuff
 namespace {
     /** Number of nodes with fSyncStarted. */
@@ -123,6 +147,7 @@ namespace {
         const CBlockIndex* pindex;                               //!< Optional.
         bool fValidatedHeaders;                                  //!< Whether this block has validated headers at the time of request.
         std::unique_ptr<PartiallyDownloadedBlock> partialBlock;  //!< Optional, used for CMPCTBLOCK downloads
+        int64_t nTimeRequested;                                  //!< When we asked for the block, in microseconds.
     };
     std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> > mapBlocksInFlight;
 
@@ -217,6 +242,11 @@ struct CNodeState {
      * otherwise: whether this peer sends non-witnesses in cmpctblocks/blocktxns.
      */
     bool fSupportsDesiredCmpctVersion;
+    //! Compact blocks from this peer we reconstructed, and ones we had to fetch in full
+    int nCmpctReconstructed;
+    int nCmpctFallback;
+    //! Where the transactions of those reconstructed blocks came from
+    CompactBlockTxCounts cmpctTxCounts;
 
     /** State used to enforce CHAIN_SYNC_TIMEOUT
       * Only in effect for outbound, non-manual connections, with
@@ -270,6 +300,8 @@ struct CNodeState {
         fHaveWitness = false;
         fWantsCmpctWitness = false;
         fSupportsDesiredCmpctVersion = false;
+        nCmpctReconstructed = 0;
+        nCmpctFallback = 0;
         m_chain_sync = { 0, nullptr, false, false };
         m_last_block_announcement = 0;
     }
@@ -365,7 +397,7 @@ bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlockIndex*
     MarkBlockAsReceived(hash);
 
     std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(),
-            {hash, pindex, pindex != nullptr, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : nullptr)});
+            {hash, pindex, pindex != nullptr, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : nullptr), GetTimeMicros()});
     state->nBlocksInFlight++;
     state->nBlocksInFlightValidHeaders += it->fValidatedHeaders;
     if (state->nBlocksInFlight == 1) {
@@ -381,6 +413,15 @@ bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlockIndex*
     return true;
 }
 
+// Requires cs_main.
+/** Adds how long pfrom took to deliver a block we asked it for to its latency stats */
+static void RecordBlockDelivery(CNode* pfrom, const uint256& hash, CConnman* connman)
+{
+    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight != mapBlocksInFlight.end() && itInFlight->second.first == pfrom->GetId())
+        connman->RecordBlockDelivery(pfrom, GetTimeMicros() - itInFlight->second.second->nTimeRequested);
+}
+
 /** Check whether the last unknown block a peer advertised is not yet known. */
 void ProcessBlockAvailability(NodeId nodeid) {
     CNodeState *state = State(nodeid);
@@ -536,7 +577,8 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
                 return;
             }
             if (pindex->nStatus & BLOCK_HAVE_DATA || chainActive.Contains(pindex)) {
-                if (pindex->nChainTx)
+                // blocks below a UTXO snapshot are in the chain without nChainTx
+                if (pindex->nChainTx || chainActive.Contains(pindex))
                     state->pindexLastCommonBlock = pindex;
             } else if (mapBlocksInFlight.count(pindex->GetBlockHash()) == 0) {
                 // The block is not already downloaded, and not yet in flight.
@@ -637,6 +679,9 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.nCmpctReconstructed = state->nCmpctReconstructed;
+    stats.nCmpctFallback = state->nCmpctFallback;
+    stats.cmpctTxCounts = state->cmpctTxCounts;
     return true;
 }
 
@@ -807,6 +852,39 @@ static bool BlockRequestAllowed(const CBlockIndex* pindex, const Consensus::Para
         (GetBlockProofEquivalentTime(*pindexBestHeader, *pindex, *pindexBestHeader, consensusParams) < STALE_RELAY_AGE_LIMIT);
 }
 
+/**
+ * Checks a BIP157 request and finds the block it stops at. Peers asking for filters
+ * we don't offer, or for too many, are disconnected.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, const CChainParams& chainparams, uint8_t nFilterType, uint32_t nStartHeight,
+                                      const uint256& stopHash, uint32_t nMaxHeightDiff, const CBlockIndex*& pindexStop)
+{
+    if (!(pfrom->GetLocalServices() & NODE_COMPACT_FILTERS) || !pblockfilterindex || nFilterType != (uint8_t)BlockFilterType::BASIC) {
+        LogPrint(BCLog::NET, "peer %d requested unsupported block filter type: %d\n", pfrom->GetId(), nFilterType);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(stopHash);
+        if (it == mapBlockIndex.end() || !BlockRequestAllowed(it->second, chainparams.GetConsensus())) {
+            LogPrint(BCLog::NET, "peer %d requested block filters up to an invalid block hash: %s\n", pfrom->GetId(), stopHash.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+        pindexStop = it->second;
+    }
+
+    uint32_t nStopHeight = pindexStop->nHeight;
+    if (nStartHeight > nStopHeight || nStopHeight - nStartHeight >= nMaxHeightDiff) {
+        LogPrint(BCLog::NET, "peer %d requested block filters of an invalid height range: %d to %d\n", pfrom->GetId(), nStartHeight, nStopHeight);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    return true;
+}
+
 PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &scheduler) : connman(connmanIn), m_stale_tip_check_time(0) {
     // Initialize global variables that cannot be constructed at startup.
     recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
@@ -860,7 +938,7 @@ static uint256 most_recent_block_hash;
 static bool fWitnessesPresentInMostRecentCompactBlock;
 
 void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) {
-    std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs> (*pblock, true);
+    std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs> (*pblock, true, &mempool);
     const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
 
     LOCK(cs_main);
@@ -898,6 +976,7 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
             state.pindexBestHeaderSent = pindex;
         }
     });
+    TraceLifecycle(LifecycleObject::BLOCK, hashBlock, LifecycleStage::RELAYED);
 }
 
 void PeerLogicValidation::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
@@ -926,6 +1005,8 @@ void PeerLogicValidation::UpdatedBlockTip(const CBlockIndex *pindexNew, const CB
             }
         });
         connman->WakeMessageHandler();
+        for (const uint256& hash : vHashes)
+            TraceLifecycle(LifecycleObject::BLOCK, hash, LifecycleStage::RELAYED);
     }
 
     nTimeBestReceived = GetTime();
@@ -1112,6 +1193,80 @@ static void RelayAddress(const CAddress& addr, bool fReachable, CConnman* connma
     connman->ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
 }
 
+/** A block as sent on the wire with witness data, and the hash for its message checksum */
+struct CRawBlock
+{
+    uint256 hashBlock;
+    std::vector<unsigned char> data;
+    uint256 hashData;
+};
+
+/** The blocks most recently served from their raw bytes */
+class CRawBlockCache
+{
+private:
+    std::mutex mtx;
+    std::list<std::shared_ptr<const CRawBlock>> lru;
+    std::map<uint256, std::list<std::shared_ptr<const CRawBlock>>::iterator> mapBlocks;
+
+public:
+    std::shared_ptr<const CRawBlock> Get(const uint256& hash)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = mapBlocks.find(hash);
+        if (it == mapBlocks.end())
+            return nullptr;
+        lru.splice(lru.begin(), lru, it->second);
+        return *it->second;
+    }
+
+    void Add(const std::shared_ptr<const CRawBlock>& raw)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (mapBlocks.count(raw->hashBlock))
+            return;
+        lru.push_front(raw);
+        mapBlocks.emplace(raw->hashBlock, lru.begin());
+        if (lru.size() > MAX_RAW_BLOCK_CACHE) {
+            mapBlocks.erase(lru.back()->hashBlock);
+            lru.pop_back();
+        }
+    }
+};
+
+static CRawBlockCache rawBlockCache;
+
+/**
+ * Sends a witness block as the bytes its block file holds, skipping the decoding and
+ * re-encoding of the block and, for cached blocks, hashing it for the checksum.
+ */
+static bool PushRawBlock(CNode* pfrom, const CBlockIndex* pindex, CConnman* connman)
+{
+    const uint256 hashBlock = pindex->GetBlockHash();
+    std::shared_ptr<const CRawBlock> raw = rawBlockCache.Get(hashBlock);
+    if (!raw) {
+        CDiskBlockPos pos;
+        {
+            LOCK(cs_main);
+            pos = pindex->GetBlockPos();
+        }
+        std::shared_ptr<CRawBlock> read = std::make_shared<CRawBlock>();
+        if (!ReadRawBlockFromDisk(read->data, pos, Params().MessageStart()))
+            return false;
+        read->hashBlock = hashBlock;
+        read->hashData = Hash(read->data.begin(), read->data.end());
+        rawBlockCache.Add(read);
+        raw = read;
+    }
+
+    CSerializedNetMsg msg;
+    msg.command = NetMsgType::BLOCK;
+    msg.data = raw->data;
+    msg.hashData = raw->hashData;
+    connman->PushMessage(pfrom, std::move(msg));
+    return true;
+}
+
 void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensusParams, const CInv& inv, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
 {
     bool send = false;
@@ -1147,52 +1302,72 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
         ActivateBestChain(dummy, Params(), a_recent_block);
     }
 
-    LOCK(cs_main);
-    BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
-    if (mi != mapBlockIndex.end()) {
-        send = BlockRequestAllowed(mi->second, consensusParams);
-        if (!send) {
-            LogPrint(BCLog::NET, "%s: ignoring request from peer=%i for old block that isn't in the main chain\n", __func__, pfrom->GetId());
-        }
-    }
-    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
-    // disconnect node in case we have reached the outbound limit for serving historical blocks
-    // never disconnect whitelisted nodes
-    if (send && connman->OutboundTargetReached(true) && ( ((pindexBestHeader != nullptr) && (pindexBestHeader->GetBlockTime() - mi->second->GetBlockTime() > HISTORICAL_BLOCK_AGE)) || inv.type == MSG_FILTERED_BLOCK) && !pfrom->fWhitelisted)
+    // Decide under cs_main, then read and send the block without it so that serving
+    // blocks from disk runs in parallel with the other message handler threads
+    const CBlockIndex* pindex = nullptr;
+    bool fPeerWantsWitness = false;
+    bool fSendCompact = false;
+    uint256 hashTip;
     {
-        LogPrint(BCLog::NET, "historical block serving limit reached, disconnect peer=%d\n", pfrom->GetId());
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
+        if (mi != mapBlockIndex.end()) {
+            pindex = mi->second;
+            send = BlockRequestAllowed(pindex, consensusParams);
+            if (!send) {
+                LogPrint(BCLog::NET, "%s: ignoring request from peer=%i for old block that isn't in the main chain\n", __func__, pfrom->GetId());
+            }
+        }
+        // disconnect node in case we have reached the outbound limit for serving historical blocks
+        // never disconnect whitelisted nodes
+        if (send && connman->OutboundTargetReached(true) && ( ((pindexBestHeader != nullptr) && (pindexBestHeader->GetBlockTime() - pindex->GetBlockTime() > HISTORICAL_BLOCK_AGE)) || inv.type == MSG_FILTERED_BLOCK) && !pfrom->fWhitelisted)
+        {
+            LogPrint(BCLog::NET, "historical block serving limit reached, disconnect peer=%d\n", pfrom->GetId());
 
-        //disconnect node
-        pfrom->fDisconnect = true;
-        send = false;
-    }
-    // Avoid leaking prune-height by never sending blocks below the NODE_NETWORK_LIMITED threshold
-    if (send && !pfrom->fWhitelisted && (
-            (((pfrom->GetLocalServices() & NODE_NETWORK_LIMITED) == NODE_NETWORK_LIMITED) && ((pfrom->GetLocalServices() & NODE_NETWORK) != NODE_NETWORK) && (chainActive.Tip()->nHeight - mi->second->nHeight > (int)NODE_NETWORK_LIMITED_MIN_BLOCKS + 2 /* add two blocks buffer extension for possible races */) )
-       )) {
-        LogPrint(BCLog::NET, "Ignore block request below NODE_NETWORK_LIMITED threshold from peer=%d\n", pfrom->GetId());
+            //disconnect node
+            pfrom->fDisconnect = true;
+            send = false;
+        }
+        // Avoid leaking prune-height by never sending blocks below the NODE_NETWORK_LIMITED threshold
+        if (send && !pfrom->fWhitelisted && (
+                (((pfrom->GetLocalServices() & NODE_NETWORK_LIMITED) == NODE_NETWORK_LIMITED) && ((pfrom->GetLocalServices() & NODE_NETWORK) != NODE_NETWORK) && (chainActive.Tip()->nHeight - pindex->nHeight > (int)NODE_NETWORK_LIMITED_MIN_BLOCKS + 2 /* add two blocks buffer extension for possible races */) )
+           )) {
+            LogPrint(BCLog::NET, "Ignore block request below NODE_NETWORK_LIMITED threshold from peer=%d\n", pfrom->GetId());
 
-        //disconnect node and prevent it from stalling (would otherwise wait for the missing block)
-        pfrom->fDisconnect = true;
-        send = false;
-    }
-    // Pruned nodes may have deleted the block, so check whether
-    // it's available before trying to send.
-    if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
+            //disconnect node and prevent it from stalling (would otherwise wait for the missing block)
+            pfrom->fDisconnect = true;
+            send = false;
+        }
+        // Pruned nodes may have deleted the block, so check whether
+        // it's available before trying to send.
+        send = send && (pindex->nStatus & BLOCK_HAVE_DATA);
+        if (send) {
+            fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
+            fSendCompact = CanDirectFetch(consensusParams) && pindex->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH;
+            hashTip = chainActive.Tip()->GetBlockHash();
+        }
+    } // release cs_main
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    if (send)
     {
         std::shared_ptr<const CBlock> pblock;
-        if (a_recent_block && a_recent_block->GetHash() == (*mi).second->GetBlockHash()) {
+        bool fSentRaw = inv.type == MSG_WITNESS_BLOCK && PushRawBlock(pfrom, pindex, connman);
+        if (fSentRaw) {
+            // the block went out as stored, only the getblocks continuation is left
+        } else if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
             pblock = a_recent_block;
         } else {
-            // Send block from disk
-            std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
-            if (!ReadBlockFromDisk(*pblockRead, (*mi).second, consensusParams))
-                assert(!"cannot load block from disk");
-            pblock = pblockRead;
+            // Send block from disk. Pruning can remove it once cs_main is released.
+            if (!ReadBlockFromDisk(pblock, pindex, consensusParams)) {
+                LogPrint(BCLog::NET, "cannot load block %s from disk, disconnect peer=%d\n", pindex->GetBlockHash().ToString(), pfrom->GetId());
+                pfrom->fDisconnect = true;
+                return;
+            }
         }
         if (inv.type == MSG_BLOCK)
             connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
-        else if (inv.type == MSG_WITNESS_BLOCK)
+        else if (inv.type == MSG_WITNESS_BLOCK && !fSentRaw)
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
         else if (inv.type == MSG_FILTERED_BLOCK)
         {
@@ -1226,10 +1401,9 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
             // they won't have a useful mempool to match against a compact block,
             // and we don't feel like constructing the object for them, so
             // instead we respond with the full, non-compact block.
-            bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
             int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
-            if (CanDirectFetch(consensusParams) && mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
-                if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == mi->second->GetBlockHash()) {
+            if (fSendCompact) {
+                if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
                     connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
                 } else {
                     CBlockHeaderAndShortTxIDs cmpctblock(*pblock, fPeerWantsWitness);
@@ -1247,7 +1421,7 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
             // and we want it right after the last block so they don't
             // wait for other stuff first.
             std::vector<CInv> vInv;
-            vInv.push_back(CInv(MSG_BLOCK, chainActive.Tip()->GetBlockHash()));
+            vInv.push_back(CInv(MSG_BLOCK, hashTip));
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::INV, vInv));
             pfrom->hashContinue.SetNull();
         }
@@ -1783,6 +1957,180 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
     return true;
 }
 
+typedef void (*ExtensionMessageHandler)(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
+
+/**
+ * The ghostnode, PrivateSend, InstantSend and spork subsystem that owns each of
+ * their messages, so a message only goes through the one that handles it.
+ */
+static ExtensionMessageHandler GetExtensionMessageHandler(const std::string& strCommand)
+{
+    // Built on first use, NetMsgType constants live in another translation unit
+    static const std::unordered_map<std::string, ExtensionMessageHandler> mapHandlers = [] {
+        ExtensionMessageHandler darksend = [](CNode* pfrom, std::string& strCommand, CDataStream& vRecv) { darkSendPool.ProcessMessage(pfrom, strCommand, vRecv); };
+        ExtensionMessageHandler ghostnodes = [](CNode* pfrom, std::string& strCommand, CDataStream& vRecv) { mnodeman.ProcessMessage(pfrom, strCommand, vRecv); };
+        ExtensionMessageHandler payments = [](CNode* pfrom, std::string& strCommand, CDataStream& vRecv) { mnpayments.ProcessMessage(pfrom, strCommand, vRecv); };
+        ExtensionMessageHandler instantSend = [](CNode* pfrom, std::string& strCommand, CDataStream& vRecv) { instantsend.ProcessMessage(pfrom, strCommand, vRecv); };
+        ExtensionMessageHandler sporks = [](CNode* pfrom, std::string& strCommand, CDataStream& vRecv) { sporkManager.ProcessSpork(pfrom, strCommand, vRecv); };
+        ExtensionMessageHandler sync = [](CNode* pfrom, std::string& strCommand, CDataStream& vRecv) { ghostnodeSync.ProcessMessage(pfrom, strCommand, vRecv); };
+        return std::unordered_map<std::string, ExtensionMessageHandler>{
+            {NetMsgType::DSACCEPT, darksend},
+            {NetMsgType::DSQUEUE, darksend},
+            {NetMsgType::DSVIN, darksend},
+            {NetMsgType::DSSTATUSUPDATE, darksend},
+            {NetMsgType::DSSIGNFINALTX, darksend},
+            {NetMsgType::DSFINALTX, darksend},
+            {NetMsgType::DSCOMPLETE, darksend},
+            {NetMsgType::MNANNOUNCE, ghostnodes},
+            {NetMsgType::MNANNOUNCEBATCH, ghostnodes},
+            {NetMsgType::MNPING, ghostnodes},
+            {NetMsgType::DSEG, ghostnodes},
+            {NetMsgType::MNVERIFY, ghostnodes},
+            {NetMsgType::GHOSTNODEPAYMENTSYNC, payments},
+            {NetMsgType::GHOSTNODEPAYMENTVOTE, payments},
+            {NetMsgType::GHOSTNODEPAYMENTBATCH, payments},
+            {NetMsgType::TXLOCKVOTE, instantSend},
+            {NetMsgType::SPORK, sporks},
+            {NetMsgType::GETSPORKS, sporks},
+            {NetMsgType::SYNCSTATUSCOUNT, sync},
+        };
+    }();
+
+    auto it = mapHandlers.find(strCommand);
+    return it == mapHandlers.end() ? nullptr : it->second;
+}
+
+/**
+ * Runs the extension message handlers on their own thread, so a ghostnode vote
+ * storm and the cs_main it takes do not hold up block and transaction relay on
+ * the message handler thread. Messages are handled in the order they arrived.
+ * The chain state these subsystems use is handed over in their UpdatedBlockTip
+ * calls from UpdateTip.
+ */
+class CGhostnodeMessageQueue
+{
+private:
+    struct Item
+    {
+        CNode* pfrom;
+        std::string strCommand;
+        CDataStream vRecv;
+        ExtensionMessageHandler handler;
+        CConnman* connman;
+    };
+
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::deque<Item> queue;
+    size_t nQueuedBytes;
+    std::thread thread;
+    bool fRunning;
+    bool fStop;
+
+    void ThreadProcess()
+    {
+        RenameThread("nix-ghostnode");
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            cond.wait(lock, [this] { return fStop || !queue.empty(); });
+            if (fStop)
+                return;
+
+            Item item = std::move(queue.front());
+            queue.pop_front();
+            nQueuedBytes -= item.vRecv.size();
+            lock.unlock();
+
+            if (!item.pfrom->fDisconnect) {
+                const std::string strCommand = item.strCommand;
+                int64_t nTimeStart = PerfTimeMicros();
+                try {
+                    item.handler(item.pfrom, item.strCommand, item.vRecv);
+                } catch (const std::ios_base::failure& e) {
+                    LogPrint(BCLog::NET, "%s(%s, %u bytes): Exception '%s' caught\n", __func__, SanitizeString(item.strCommand), item.vRecv.size(), e.what());
+                } catch (const std::exception& e) {
+                    PrintExceptionContinue(&e, "CGhostnodeMessageQueue");
+                }
+                // ProcessMessages already counted the message when it queued it
+                item.connman->RecordMessageProcessing(item.pfrom, strCommand, PerfTimeMicros() - nTimeStart, false);
+            }
+            item.pfrom->Release();
+            lock.lock();
+        }
+    }
+
+public:
+    CGhostnodeMessageQueue() : nQueuedBytes(0), fRunning(false), fStop(false) {}
+
+    void Start()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (fRunning)
+            return;
+        fStop = false;
+        fRunning = true;
+        thread = std::thread(&CGhostnodeMessageQueue::ThreadProcess, this);
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!fRunning)
+                return;
+            fStop = true;
+            fRunning = false;
+        }
+        cond.notify_all();
+        thread.join();
+
+        std::lock_guard<std::mutex> lock(mtx);
+        for (Item& item : queue)
+            item.pfrom->Release();
+        queue.clear();
+        nQueuedBytes = 0;
+    }
+
+    /** Queues a message for the ghostnode thread, false when it is not running */
+    bool Push(CNode* pfrom, const std::string& strCommand, const CDataStream& vRecv, ExtensionMessageHandler handler, CConnman* connman)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!fRunning)
+                return false;
+            if (nQueuedBytes + vRecv.size() > MAX_GHOSTNODE_QUEUE_BYTES) {
+                LogPrint(BCLog::NET, "Ghostnode message queue full, dropping %s from peer=%d\n", SanitizeString(strCommand), pfrom->GetId());
+                return true;
+            }
+            queue.push_back(Item{pfrom->AddRef(), strCommand, vRecv, handler, connman});
+            nQueuedBytes += vRecv.size();
+        }
+        cond.notify_one();
+        return true;
+    }
+};
+
+static CGhostnodeMessageQueue ghostnodeMessageQueue;
+
+void StartGhostnodeMessageThread()
+{
+    ghostnodeMessageQueue.Start();
+}
+
+void StopGhostnodeMessageThread()
+{
+    ghostnodeMessageQueue.Stop();
+}
+
+static bool IsKnownNetMessageType(const std::string& strCommand)
+{
+    static const std::unordered_set<std::string> setKnown = [] {
+        const std::vector<std::string>& allMessages = getAllNetMessageTypes();
+        return std::unordered_set<std::string>(allMessages.begin(), allMessages.end());
+    }();
+    return setKnown.count(strCommand) != 0;
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
@@ -2051,6 +2399,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             // nodes)
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDHEADERS));
         }
+        // Tell our peer we prefer batched ghostnode list and payment syncs,
+        // peers that don't know the message ignore it and keep sending invs
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDMNBATCH));
         if (pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION) {
             // Tell our peer we are willing to provide version 1 or 2 cmpctblocks
             // However, we do not request new block announcements using
@@ -2131,6 +2482,11 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         State(pfrom->GetId())->fPreferHeaders = true;
     }
 
+    else if (strCommand == NetMsgType::SENDMNBATCH)
+    {
+        pfrom->fSendGhostnodeBatches = true;
+    }
+
     else if (strCommand == NetMsgType::SENDCMPCT)
     {
         bool fAnnounceUsingCMPCTBLOCK = false;
@@ -2316,37 +2672,109 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
-        LOCK(cs_main);
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
 
-        BlockMap::iterator it = mapBlockIndex.find(req.blockhash);
-        if (it == mapBlockIndex.end() || !(it->second->nStatus & BLOCK_HAVE_DATA)) {
-            LogPrint(BCLog::NET, "Peer %d sent us a getblocktxn for a block we don't have", pfrom->GetId());
+            BlockMap::iterator it = mapBlockIndex.find(req.blockhash);
+            if (it == mapBlockIndex.end() || !(it->second->nStatus & BLOCK_HAVE_DATA)) {
+                LogPrint(BCLog::NET, "Peer %d sent us a getblocktxn for a block we don't have", pfrom->GetId());
+                return true;
+            }
+            pindex = it->second;
+
+            if (pindex->nHeight < chainActive.Height() - MAX_BLOCKTXN_DEPTH) {
+                // If an older block is requested (should never happen in practice,
+                // but can happen in tests) send a block response instead of a
+                // blocktxn response. Sending a full block response instead of a
+                // small blocktxn response is preferable in the case where a peer
+                // might maliciously send lots of getblocktxn requests to trigger
+                // expensive disk reads, because it will require the peer to
+                // actually receive all the data read from disk over the network.
+                LogPrint(BCLog::NET, "Peer %d sent us a getblocktxn for a block > %i deep", pfrom->GetId(), MAX_BLOCKTXN_DEPTH);
+                CInv inv;
+                inv.type = State(pfrom->GetId())->fWantsCmpctWitness ? MSG_WITNESS_BLOCK : MSG_BLOCK;
+                inv.hash = req.blockhash;
+                pfrom->vRecvGetData.push_back(inv);
+                // The message processing loop will go around again (without pausing) and we'll respond then (without cs_main)
+                return true;
+            }
+        } // release cs_main
+
+        std::shared_ptr<const CBlock> pblock;
+        if (!ReadBlockFromDisk(pblock, pindex, chainparams.GetConsensus())) {
+            LogPrint(BCLog::NET, "cannot load block %s from disk, disconnect peer=%d\n", req.blockhash.ToString(), pfrom->GetId());
+            pfrom->fDisconnect = true;
             return true;
         }
 
-        if (it->second->nHeight < chainActive.Height() - MAX_BLOCKTXN_DEPTH) {
-            // If an older block is requested (should never happen in practice,
-            // but can happen in tests) send a block response instead of a
-            // blocktxn response. Sending a full block response instead of a
-            // small blocktxn response is preferable in the case where a peer
-            // might maliciously send lots of getblocktxn requests to trigger
-            // expensive disk reads, because it will require the peer to
-            // actually receive all the data read from disk over the network.
-            LogPrint(BCLog::NET, "Peer %d sent us a getblocktxn for a block > %i deep", pfrom->GetId(), MAX_BLOCKTXN_DEPTH);
-            CInv inv;
-            inv.type = State(pfrom->GetId())->fWantsCmpctWitness ? MSG_WITNESS_BLOCK : MSG_BLOCK;
-            inv.hash = req.blockhash;
-            pfrom->vRecvGetData.push_back(inv);
-            ProcessGetData(pfrom, chainparams.GetConsensus(), connman, interruptMsgProc);
-            // The message processing loop will go around again (without pausing) and we'll respond then (without cs_main)
+        SendBlockTransactions(*pblock, req, pfrom, connman);
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFILTERS)
+    {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 stopHash;
+        vRecv >> nFilterType >> nStartHeight >> stopHash;
+
+        const CBlockIndex* pindexStop;
+        if (!PrepareBlockFilterRequest(pfrom, chainparams, nFilterType, nStartHeight, stopHash, MAX_GETCFILTERS_SIZE, pindexStop))
+            return true;
+
+        std::vector<BlockFilter> vFilters;
+        if (!pblockfilterindex->LookupFilterRange(nStartHeight, pindexStop, vFilters)) {
+            LogPrint(BCLog::NET, "block filters from height %d to %s are not indexed yet, peer=%d\n", nStartHeight, stopHash.ToString(), pfrom->GetId());
             return true;
         }
+        for (const BlockFilter& filter : vFilters)
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, nFilterType, filter.GetBlockHash(), filter.GetEncodedFilter()));
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFHEADERS)
+    {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 stopHash;
+        vRecv >> nFilterType >> nStartHeight >> stopHash;
 
-        CBlock block;
-        bool ret = ReadBlockFromDisk(block, it->second, chainparams.GetConsensus());
-        assert(ret);
+        const CBlockIndex* pindexStop;
+        if (!PrepareBlockFilterRequest(pfrom, chainparams, nFilterType, nStartHeight, stopHash, MAX_GETCFHEADERS_SIZE, pindexStop))
+            return true;
 
-        SendBlockTransactions(block, req, pfrom, connman);
+        uint256 prevHeader;
+        std::vector<uint256> vHashes;
+        if ((nStartHeight > 0 && !pblockfilterindex->LookupFilterHeader(pindexStop->GetAncestor(nStartHeight - 1), prevHeader)) ||
+            !pblockfilterindex->LookupFilterHashRange(nStartHeight, pindexStop, vHashes)) {
+            LogPrint(BCLog::NET, "block filters from height %d to %s are not indexed yet, peer=%d\n", nStartHeight, stopHash.ToString(), pfrom->GetId());
+            return true;
+        }
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFHEADERS, nFilterType, stopHash, prevHeader, vHashes));
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFCHECKPT)
+    {
+        uint8_t nFilterType;
+        uint256 stopHash;
+        vRecv >> nFilterType >> stopHash;
+
+        const CBlockIndex* pindexStop;
+        if (!PrepareBlockFilterRequest(pfrom, chainparams, nFilterType, 0, stopHash, std::numeric_limits<uint32_t>::max(), pindexStop))
+            return true;
+
+        std::vector<uint256> vHeaders(pindexStop->nHeight / CFCHECKPT_INTERVAL);
+        const CBlockIndex* pindex = pindexStop;
+        for (int i = (int)vHeaders.size() - 1; i >= 0; i--) {
+            pindex = pindex->GetAncestor((i + 1) * CFCHECKPT_INTERVAL);
+            if (!pblockfilterindex->LookupFilterHeader(pindex, vHeaders[i])) {
+                LogPrint(BCLog::NET, "block filter header at height %d is not indexed yet, peer=%d\n", pindex->nHeight, pfrom->GetId());
+                return true;
+            }
+        }
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFCHECKPT, nFilterType, stopHash, vHeaders));
     }
 
 
@@ -2356,43 +2784,50 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         uint256 hashStop;
         vRecv >> locator >> hashStop;
 
-        LOCK(cs_main);
-        if (IsInitialBlockDownload() && !pfrom->fWhitelisted) {
-            LogPrint(BCLog::NET, "Ignoring getheaders from peer=%d because node is in initial block download\n", pfrom->GetId());
-            return true;
-        }
-
-        CNodeState *nodestate = State(pfrom->GetId());
+        // The start is found under cs_main, the headers are copied from the chain
+        // snapshot taken with it so other peers are not held up meanwhile
         const CBlockIndex* pindex = nullptr;
-        if (locator.IsNull())
+        std::shared_ptr<const CChainSnapshot> chain;
+        bool fTipDuplicateStake;
         {
-            // If locator is null, return the hashStop block
-            BlockMap::iterator mi = mapBlockIndex.find(hashStop);
-            if (mi == mapBlockIndex.end())
+            LOCK(cs_main);
+            if (IsInitialBlockDownload() && !pfrom->fWhitelisted) {
+                LogPrint(BCLog::NET, "Ignoring getheaders from peer=%d because node is in initial block download\n", pfrom->GetId());
                 return true;
-            pindex = (*mi).second;
+            }
 
-            if (!BlockRequestAllowed(pindex, chainparams.GetConsensus())) {
-                LogPrint(BCLog::NET, "%s: ignoring request from peer=%i for old block header that isn't in the main chain\n", __func__, pfrom->GetId());
-                return true;
+            if (locator.IsNull())
+            {
+                // If locator is null, return the hashStop block
+                BlockMap::iterator mi = mapBlockIndex.find(hashStop);
+                if (mi == mapBlockIndex.end())
+                    return true;
+                pindex = (*mi).second;
+
+                if (!BlockRequestAllowed(pindex, chainparams.GetConsensus())) {
+                    LogPrint(BCLog::NET, "%s: ignoring request from peer=%i for old block header that isn't in the main chain\n", __func__, pfrom->GetId());
+                    return true;
+                }
             }
-        }
-        else
-        {
-            // Find the last block the caller has in the main chain
-            pindex = FindForkInGlobalIndex(chainActive, locator);
-            if (pindex)
-                pindex = chainActive.Next(pindex);
+            else
+            {
+                // Find the last block the caller has in the main chain
+                pindex = FindForkInGlobalIndex(chainActive, locator);
+                if (pindex)
+                    pindex = chainActive.Next(pindex);
+            }
+
+            chain = GetChainSnapshot();
+            fTipDuplicateStake = chain->Tip() && (chain->Tip()->nFlags & BLOCK_FAILED_DUPLICATE_STAKE);
         }
 
         // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
         std::vector<CBlock> vHeaders;
         int nLimit = MAX_HEADERS_RESULTS;
         LogPrint(BCLog::NET, "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.IsNull() ? "end" : hashStop.ToString(), pfrom->GetId());
-        for (; pindex; pindex = chainActive.Next(pindex))
+        for (; pindex; pindex = chain->Contains(pindex) ? (*chain)[pindex->nHeight + 1] : nullptr)
         {
-            if (pindex == chainActive.Tip()
-                && pindex->nFlags & BLOCK_FAILED_DUPLICATE_STAKE)
+            if (pindex == chain->Tip() && fTipDuplicateStake)
             {
                 break;
             }
@@ -2413,7 +2848,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // without the new block. By resetting the BestHeaderSent, we ensure we
         // will re-announce the new block via headers (or compact blocks again)
         // in the SendMessages logic.
-        nodestate->pindexBestHeaderSent = pindex ? pindex : chainActive.Tip();
+        {
+            LOCK(cs_main);
+            State(pfrom->GetId())->pindexBestHeaderSent = pindex ? pindex : chain->Tip();
+        }
         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
     }
 
@@ -2475,6 +2913,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             nInvType = MSG_DSTX;
         }
         const CTransaction& tx = *ptx;
+        TraceLifecycle(LifecycleObject::TX, tx.GetHash(), LifecycleStage::RECEIVED);
 
         CInv inv(MSG_TX, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
@@ -2517,11 +2956,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             pmn->fAllowMixingTx = false;
         }
 
+        CValidationState state;
+        // Verify the sigma proofs before taking cs_main, the check under the lock then hits the proof cache
+        bool fSigmaProofsValid = !tx.IsSigmaSpend() || mempool.exists(tx.GetHash()) || PreVerifySigmaSpend(tx, state);
+
         LOCK2(cs_main, g_cs_orphans);
 
         bool fMissingInputs = false;
         bool fMissingZerocoinInputs = false;
-        CValidationState state;
 
         pfrom->setAskFor.erase(inv.hash);
         mapAlreadyAskedFor.erase(inv.hash);
@@ -2604,7 +3046,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             for (uint256 hash : vEraseQueue)
                 EraseOrphanTx(hash);
         }
-        else if (!AlreadyHave(inv) && (tx.IsZerocoinSpend() || tx.IsSigmaSpend()) && AcceptToMemoryPool(mempool, state, ptx, &fMissingZerocoinInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
+        else if (!AlreadyHave(inv) && (tx.IsZerocoinSpend() || tx.IsSigmaSpend()) && fSigmaProofsValid && AcceptToMemoryPool(mempool, state, ptx, &fMissingZerocoinInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
             RelayTransaction(tx, connman);
 
         }
@@ -2694,6 +3136,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     {
         CBlockHeaderAndShortTxIDs cmpctblock;
         vRecv >> cmpctblock;
+        TraceLifecycle(LifecycleObject::BLOCK, cmpctblock.header.GetHash(), LifecycleStage::RECEIVED);
 
         bool received_new_header = false;
 
@@ -2811,6 +3254,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                     return true;
                 } else if (status == READ_STATUS_FAILED) {
                     // Duplicate txindexes, the block is now in-flight, so just request it
+                    nodestate->nCmpctFallback++;
                     std::vector<CInv> vInv(1);
                     vInv[0] = CInv(MSG_BLOCK | GetFetchFlags(pfrom), cmpctblock.header.GetHash());
                     connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, vInv));
@@ -2848,6 +3292,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 status = tempBlock.FillBlock(*pblock, dummy);
                 if (status == READ_STATUS_OK) {
                     fBlockReconstructed = true;
+                    nodestate->nCmpctReconstructed++;
+                    nodestate->cmpctTxCounts += tempBlock.txCounts;
                 }
             }
         } else {
@@ -2939,6 +3385,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 return true;
             } else if (status == READ_STATUS_FAILED) {
                 // Might have collided, fall back to getdata now :(
+                State(pfrom->GetId())->nCmpctFallback++;
                 std::vector<CInv> invs;
                 invs.push_back(CInv(MSG_BLOCK | GetFetchFlags(pfrom), resp.blockhash));
                 connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, invs));
@@ -2960,6 +3407,12 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 // though the block was successfully read, and rely on the
                 // handling in ProcessNewBlock to ensure the block index is
                 // updated, reject messages go out, etc.
+                if (status == READ_STATUS_OK) {
+                    CNodeState* nodestate = State(pfrom->GetId());
+                    nodestate->nCmpctReconstructed++;
+                    nodestate->cmpctTxCounts += partialBlock.txCounts;
+                }
+                RecordBlockDelivery(pfrom, resp.blockhash, connman);
                 MarkBlockAsReceived(resp.blockhash); // it is now an empty pointer
                 fBlockRead = true;
                 // mapBlockSource is only used for sending reject messages and DoS scores,
@@ -3017,7 +3470,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-        vRecv >> *pblock;
+        UnserializeBlockInArena(vRecv, *pblock);
+        TraceLifecycle(LifecycleObject::BLOCK, pblock->GetHash(), LifecycleStage::RECEIVED);
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->GetId());
 
@@ -3027,6 +3481,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             LOCK(cs_main);
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
+            RecordBlockDelivery(pfrom, hash, connman);
             forceProcessing |= MarkBlockAsReceived(hash);
             // mapBlockSource is only used for sending reject messages and DoS scores,
             // so the race between here and cs_main in ProcessNewBlock is fine.
@@ -3144,6 +3599,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                         // Successful ping time measurement, replace previous
                         pfrom->nPingUsecTime = pingUsecTime;
                         pfrom->nMinPingUsecTime = std::min(pfrom->nMinPingUsecTime.load(), pingUsecTime);
+                        connman->RecordPingTime(pfrom, pingUsecTime);
                     } else {
                         // This should never happen
                         sProblem = "Timing mishap";
@@ -3253,26 +3709,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
     else {
-        // Ignore unknown commands for extensibility
-        bool found = false;
-        const std::vector <std::string> &allMessages = getAllNetMessageTypes();
-        BOOST_FOREACH(const std::string msg, allMessages) {
-            if (msg == strCommand) {
-                found = true;
-                break;
+        ExtensionMessageHandler handler = GetExtensionMessageHandler(strCommand);
+        if (handler) {
+            if (!ghostnodeMessageQueue.Push(pfrom, strCommand, vRecv, handler, connman)) {
+                std::string strCommandNonConst = strCommand;
+                handler(pfrom, strCommandNonConst, vRecv);
             }
-        }
-
-        if (found) {
-            std::string strCommandNonConst = strCommand;
-            //probably one the extensions
-            darkSendPool.ProcessMessage(pfrom, strCommandNonConst, vRecv);
-            mnodeman.ProcessMessage(pfrom, strCommandNonConst, vRecv);
-            mnpayments.ProcessMessage(pfrom, strCommandNonConst, vRecv);
-            instantsend.ProcessMessage(pfrom, strCommandNonConst, vRecv);
-            sporkManager.ProcessSpork(pfrom, strCommandNonConst, vRecv);
-            ghostnodeSync.ProcessMessage(pfrom, strCommandNonConst, vRecv);
-        } else {
+        } else if (!IsKnownNetMessageType(strCommand)) {
             // Ignore unknown commands for extensibility
             LogPrintf("Unknown command \"%s\" from peer=%d\n", SanitizeString(strCommand), pfrom->GetId());
         }
@@ -3313,6 +3756,22 @@ static bool SendRejectsAndCheckIfBanned(CNode* pnode, CConnman* connman)
     return false;
 }
 
+/**
+ * Held by a message handler thread for every message except the requests below and
+ * while sending, so messages changing chain, mempool and peer state are still handled
+ * one at a time as on a single thread.
+ */
+static std::mutex g_msgproc_serial;
+
+/** Requests served from the chain and the block files, handled in parallel */
+static bool IsParallelMessage(const std::string& strCommand)
+{
+    return strCommand == NetMsgType::GETDATA || strCommand == NetMsgType::GETHEADERS ||
+           strCommand == NetMsgType::GETBLOCKS || strCommand == NetMsgType::GETBLOCKTXN ||
+           strCommand == NetMsgType::GETCFILTERS || strCommand == NetMsgType::GETCFHEADERS ||
+           strCommand == NetMsgType::GETCFCHECKPT;
+}
+
 bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& interruptMsgProc)
 {
     const CChainParams& chainparams = Params();
@@ -3384,8 +3843,13 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         return fMoreWork;
     }
 
+    std::unique_lock<std::mutex> serialLock(g_msgproc_serial, std::defer_lock);
+    if (!IsParallelMessage(strCommand))
+        serialLock.lock();
+
     // Process message
     bool fRet = false;
+    int64_t nProcessStart = PerfTimeMicros();
     try
     {
         fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc);
@@ -3422,6 +3886,7 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     } catch (...) {
         PrintExceptionContinue(nullptr, "ProcessMessages()");
     }
+    connman->RecordMessageProcessing(pfrom, strCommand, PerfTimeMicros() - nProcessStart);
 
     if (!fRet) {
         LogPrint(BCLog::NET, "%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->GetId());
@@ -3588,6 +4053,8 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
         if (!pto->fSuccessfullyConnected || pto->fDisconnect)
             return true;
 
+        std::lock_guard<std::mutex> serialLock(g_msgproc_serial);
+
         // If we get here, the outgoing message serialization version is set and can't change.
         const CNetMsgMaker msgMaker(pto->GetSendVersion());
 
@@ -6,9 +6,11 @@
 #ifndef BITCOIN_NET_PROCESSING_H
 #define BITCOIN_NET_PROCESSING_H
 
+#include <blockencodings.h>
 #include <net.h>
 #include <validationinterface.h>
 #include <consensus/params.h>
+#include <lifecycle.h>
 
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
@@ -34,6 +36,8 @@ static constexpr int64_t STALE_CHECK_INTERVAL = 2 * 60; // 2 minutes
 static constexpr int64_t EXTRA_PEER_CHECK_INTERVAL = 45;
 /** Minimum time an outbound-peer-eviction candidate must be connected for, in order to evict, in seconds */
 static constexpr int64_t MINIMUM_CONNECT_TIME = 30;
+/** Ghostnode, PrivateSend, InstantSend and spork messages waiting for their thread, in bytes; more are dropped */
+static constexpr size_t MAX_GHOSTNODE_QUEUE_BYTES = 32 * 1000 * 1000;
 
 class PeerLogicValidation : public CValidationInterface, public NetEventsInterface {
 private:
@@ -74,8 +78,16 @@ struct CNodeStateStats {
     int nSyncHeight;
     int nCommonHeight;
     std::vector<int> vHeightInFlight;
+    int nCmpctReconstructed;
+    int nCmpctFallback;
+    CompactBlockTxCounts cmpctTxCounts;
 };
 
+/** Handle ghostnode, PrivateSend, InstantSend and spork messages on a separate thread */
+void StartGhostnodeMessageThread();
+/** Stop that thread, must happen before the connection manager deletes its nodes */
+void StopGhostnodeMessageThread();
+
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 /** Increase a node's misbehavior score. */
@@ -88,6 +100,7 @@ static void RelayTransaction(const CTransaction& tx, CConnman* connman)
     {
         pnode->PushInventory(inv);
     });
+    TraceLifecycle(LifecycleObject::TX, tx.GetHash(), LifecycleStage::RELAYED);
 }
 
 bool IncomingBlockChecked(const CBlock &block, CValidationState &state);
@@ -13,9 +13,11 @@
 #include <utilstrencodings.h>
 
 #include <atomic>
+#include <limits>
 
 #ifndef WIN32
 #include <fcntl.h>
+#include <poll.h>
 #endif
 
 #include <boost/algorithm/string/case_conv.hpp> // for to_lower()
@@ -230,6 +232,27 @@ enum class IntrRecvError {
     Interrupted
 };
 
+/**
+ * Wait for a single socket to become readable or writable, returns like select().
+ * Uses poll where available since the socket may be past FD_SETSIZE.
+ */
+static int WaitForSocket(const SOCKET& hSocket, bool fWrite, int64_t nTimeout)
+{
+#ifdef WIN32
+    struct timeval tval = MillisToTimeval(nTimeout);
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(hSocket, &fdset);
+    return select(hSocket + 1, fWrite ? nullptr : &fdset, fWrite ? &fdset : nullptr, nullptr, &tval);
+#else
+    struct pollfd pollfd;
+    pollfd.fd = hSocket;
+    pollfd.events = fWrite ? POLLOUT : POLLIN;
+    pollfd.revents = 0;
+    return poll(&pollfd, 1, nTimeout);
+#endif
+}
+
 /**
  * Read bytes from socket. This will either read the full number of bytes requested
  * or return False on error or timeout.
@@ -261,11 +284,7 @@ static IntrRecvError InterruptibleRecv(uint8_t* data, size_t len, int timeout, c
                 if (!IsSelectableSocket(hSocket)) {
                     return IntrRecvError::NetworkError;
                 }
-                struct timeval tval = MillisToTimeval(std::min(endTime - curTime, maxWait));
-                fd_set fdset;
-                FD_ZERO(&fdset);
-                FD_SET(hSocket, &fdset);
-                int nRet = select(hSocket + 1, &fdset, nullptr, nullptr, &tval);
+                int nRet = WaitForSocket(hSocket, false, std::min(endTime - curTime, maxWait));
                 if (nRet == SOCKET_ERROR) {
                     return IntrRecvError::NetworkError;
                 }
@@ -486,11 +505,7 @@ bool ConnectSocketDirectly(const CService &addrConnect, const SOCKET& hSocket, i
         // WSAEINVAL is here because some legacy version of winsock uses it
         if (nErr == WSAEINPROGRESS || nErr == WSAEWOULDBLOCK || nErr == WSAEINVAL)
         {
-            struct timeval timeout = MillisToTimeval(nTimeout);
-            fd_set fdset;
-            FD_ZERO(&fdset);
-            FD_SET(hSocket, &fdset);
-            int nRet = select(hSocket + 1, nullptr, &fdset, nullptr, &timeout);
+            int nRet = WaitForSocket(hSocket, true, nTimeout);
             if (nRet == 0)
             {
                 LogPrint(BCLog::NET, "connection to %s timeout\n", addrConnect.ToString());
@@ -578,6 +593,23 @@ bool IsProxy(const CNetAddr &addr) {
     return false;
 }
 
+/**
+ * Credentials of the proxy connections to a peer. Tor only lets streams with the same
+ * credentials share a circuit, so the streams to different peers can't be linked while a
+ * reconnect to the same peer may reuse its circuit. They are a salted hash of the peer,
+ * the salt differs on every start.
+ */
+static ProxyCredentials GetIsolationCredentials(const std::string& strDest, int port)
+{
+    static const uint64_t k0 = GetRand(std::numeric_limits<uint64_t>::max());
+    static const uint64_t k1 = GetRand(std::numeric_limits<uint64_t>::max());
+    uint64_t hash = CSipHasher(k0, k1).Write((const unsigned char*)strDest.data(), strDest.size()).Write(port).Finalize();
+
+    ProxyCredentials auth;
+    auth.username = auth.password = strprintf("%016x", hash);
+    return auth;
+}
+
 bool ConnectThroughProxy(const proxyType &proxy, const std::string& strDest, int port, const SOCKET& hSocket, int nTimeout, bool *outProxyConnectionFailed)
 {
     // first connect to proxy server
@@ -588,10 +620,8 @@ bool ConnectThroughProxy(const proxyType &proxy, const std::string& strDest, int
     }
     // do socks negotiation
     if (proxy.randomize_credentials) {
-        ProxyCredentials random_auth;
-        static std::atomic_int counter(0);
-        random_auth.username = random_auth.password = strprintf("%i", counter++);
-        if (!Socks5(strDest, (unsigned short)port, &random_auth, hSocket)) {
+        ProxyCredentials peer_auth = GetIsolationCredentials(strDest, port);
+        if (!Socks5(strDest, (unsigned short)port, &peer_auth, hSocket)) {
             return false;
         }
     } else {
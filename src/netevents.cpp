@@ -0,0 +1,234 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <netevents.h>
+
+#include <netbase.h>
+#include <util.h>
+
+#include <algorithm>
+
+#if defined(USE_EPOLL)
+#include <sys/epoll.h>
+#elif defined(USE_KQUEUE)
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+// Most ready sockets returned by one wait, the rest stay ready for the next
+static const size_t MAX_READY_EVENTS = 1024;
+
+CSocketEvents::CSocketEvents(bool fForceSelect) : nQueueFd(-1)
+{
+    if (fForceSelect)
+        return;
+#if defined(USE_EPOLL)
+    nQueueFd = epoll_create1(EPOLL_CLOEXEC);
+#elif defined(USE_KQUEUE)
+    nQueueFd = kqueue();
+#endif
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+    // Sockets past FD_SETSIZE are accepted in these builds and can't be waited for
+    // with select, the fallback only covers a kernel refusing the queue.
+    if (nQueueFd == -1)
+        LogPrintf("Creating the socket event queue failed, using select: %s\n", NetworkErrorString(WSAGetLastError()));
+#endif
+}
+
+CSocketEvents::~CSocketEvents()
+{
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+    if (nQueueFd != -1)
+        close(nQueueFd);
+#endif
+}
+
+const char* CSocketEvents::GetBackendName() const
+{
+    if (nQueueFd == -1)
+        return "select";
+#if defined(USE_EPOLL)
+    return "epoll";
+#else
+    return "kqueue";
+#endif
+}
+
+void CSocketEvents::Set(SOCKET hSocket, int64_t nOwner, uint8_t nEvents)
+{
+    auto it = mapWatched.find(hSocket);
+    if (it != mapWatched.end() && it->second.nOwner == nOwner) {
+        if (it->second.nEvents != nEvents && nQueueFd != -1)
+            Register(hSocket, nEvents, false);
+        it->second.nEvents = nEvents;
+        it->second.fSeen = true;
+        return;
+    }
+
+    if (nQueueFd != -1) {
+        // The descriptor was closed and reused since the last pass
+        if (it != mapWatched.end())
+            Unregister(hSocket);
+        Register(hSocket, nEvents, true);
+    }
+    mapWatched[hSocket] = Watch{nOwner, nEvents, true};
+}
+
+void CSocketEvents::RemoveStale()
+{
+    for (auto it = mapWatched.begin(); it != mapWatched.end(); ) {
+        if (!it->second.fSeen) {
+            if (nQueueFd != -1)
+                Unregister(it->first);
+            it = mapWatched.erase(it);
+        } else {
+            it->second.fSeen = false;
+            ++it;
+        }
+    }
+}
+
+void CSocketEvents::GetWatched(std::vector<std::pair<SOCKET, uint8_t>>& vWatched) const
+{
+    vWatched.clear();
+    for (const auto& entry : mapWatched)
+        vWatched.emplace_back(entry.first, entry.second.nEvents);
+}
+
+bool CSocketEvents::Register(SOCKET hSocket, uint8_t nEvents, bool fNew)
+{
+#if defined(USE_EPOLL)
+    struct epoll_event ev;
+    ev.events = ((nEvents & RECV) ? EPOLLIN : 0) | ((nEvents & SEND) ? EPOLLOUT : 0);
+    ev.data.u64 = 0;
+    ev.data.fd = hSocket;
+    int nRet = epoll_ctl(nQueueFd, fNew ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, hSocket, &ev);
+    // a registration the closing of the old socket didn't drop, or one it did
+    if (nRet == -1 && errno == EEXIST)
+        nRet = epoll_ctl(nQueueFd, EPOLL_CTL_MOD, hSocket, &ev);
+    else if (nRet == -1 && errno == ENOENT)
+        nRet = epoll_ctl(nQueueFd, EPOLL_CTL_ADD, hSocket, &ev);
+#elif defined(USE_KQUEUE)
+    // EV_ADD also updates, both filters stay registered and get enabled as needed
+    struct kevent changes[2];
+    EV_SET(&changes[0], hSocket, EVFILT_READ, EV_ADD | ((nEvents & RECV) ? EV_ENABLE : EV_DISABLE), 0, 0, nullptr);
+    EV_SET(&changes[1], hSocket, EVFILT_WRITE, EV_ADD | ((nEvents & SEND) ? EV_ENABLE : EV_DISABLE), 0, 0, nullptr);
+    int nRet = kevent(nQueueFd, changes, 2, nullptr, 0, nullptr);
+#else
+    int nRet = 0;
+#endif
+    if (nRet == -1) {
+        LogPrint(BCLog::NET, "socket event registration of %d failed: %s\n", hSocket, NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    return true;
+}
+
+void CSocketEvents::Unregister(SOCKET hSocket)
+{
+    // Fails harmlessly once the socket is closed, the kernel dropped it then
+#if defined(USE_EPOLL)
+    struct epoll_event ev = {};
+    epoll_ctl(nQueueFd, EPOLL_CTL_DEL, hSocket, &ev);
+#elif defined(USE_KQUEUE)
+    struct kevent changes[2];
+    EV_SET(&changes[0], hSocket, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+    EV_SET(&changes[1], hSocket, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+    kevent(nQueueFd, changes, 2, nullptr, 0, nullptr);
+#endif
+}
+
+bool CSocketEvents::Wait(int nTimeoutMs, std::vector<std::pair<SOCKET, uint8_t>>& vReady)
+{
+    vReady.clear();
+    if (nQueueFd == -1)
+        return WaitSelect(nTimeoutMs, vReady);
+
+#if defined(USE_EPOLL)
+    std::vector<struct epoll_event> events(std::min(std::max(mapWatched.size(), size_t(1)), MAX_READY_EVENTS));
+    int nRet = epoll_wait(nQueueFd, events.data(), events.size(), nTimeoutMs);
+    if (nRet == -1)
+        return errno == EINTR;
+    for (int i = 0; i < nRet; i++) {
+        uint8_t nEvents = NONE;
+        if (events[i].events & EPOLLIN)
+            nEvents |= RECV;
+        if (events[i].events & EPOLLOUT)
+            nEvents |= SEND;
+        if (events[i].events & (EPOLLERR | EPOLLHUP))
+            nEvents |= ERR;
+        vReady.emplace_back((SOCKET)events[i].data.fd, nEvents);
+    }
+#elif defined(USE_KQUEUE)
+    // One event per filter, so a socket can be reported twice
+    std::vector<struct kevent> events(std::min(std::max(2 * mapWatched.size(), size_t(1)), MAX_READY_EVENTS));
+    struct timespec timeout;
+    timeout.tv_sec = nTimeoutMs / 1000;
+    timeout.tv_nsec = (nTimeoutMs % 1000) * 1000000;
+    int nRet = kevent(nQueueFd, nullptr, 0, events.data(), events.size(), &timeout);
+    if (nRet == -1)
+        return errno == EINTR;
+    for (int i = 0; i < nRet; i++) {
+        uint8_t nEvents = NONE;
+        if (events[i].filter == EVFILT_READ)
+            nEvents |= RECV;
+        if (events[i].filter == EVFILT_WRITE)
+            nEvents |= SEND;
+        if (events[i].flags & (EV_EOF | EV_ERROR))
+            nEvents |= ERR;
+        vReady.emplace_back((SOCKET)events[i].ident, nEvents);
+    }
+#endif
+    return true;
+}
+
+bool CSocketEvents::WaitSelect(int nTimeoutMs, std::vector<std::pair<SOCKET, uint8_t>>& vReady)
+{
+    struct timeval timeout = MillisToTimeval(nTimeoutMs);
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+    bool have_fds = false;
+
+    for (const auto& entry : mapWatched) {
+#ifndef WIN32
+        if (entry.first >= FD_SETSIZE)
+            continue;
+#endif
+        FD_SET(entry.first, &fdsetError);
+        if (entry.second.nEvents & RECV)
+            FD_SET(entry.first, &fdsetRecv);
+        if (entry.second.nEvents & SEND)
+            FD_SET(entry.first, &fdsetSend);
+        hSocketMax = std::max(hSocketMax, entry.first);
+        have_fds = true;
+    }
+
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                         &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    if (nSelect == SOCKET_ERROR)
+        return false;
+
+    for (const auto& entry : mapWatched) {
+#ifndef WIN32
+        if (entry.first >= FD_SETSIZE)
+            continue;
+#endif
+        uint8_t nEvents = NONE;
+        if (FD_ISSET(entry.first, &fdsetRecv))
+            nEvents |= RECV;
+        if (FD_ISSET(entry.first, &fdsetSend))
+            nEvents |= SEND;
+        if (FD_ISSET(entry.first, &fdsetError))
+            nEvents |= ERR;
+        if (nEvents != NONE)
+            vReady.emplace_back(entry.first, nEvents);
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NETEVENTS_H
+#define BITCOIN_NETEVENTS_H
+
+#include <compat.h>
+
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Readiness of a set of sockets for the socket handler, backed by epoll on Linux,
+ * kqueue on the BSDs and macOS, and select elsewhere or when the kernel queue can't
+ * be created. Sockets stay registered with the kernel between waits, so a wait costs
+ * the number of ready sockets rather than the number watched and isn't limited to
+ * FD_SETSIZE. Readiness is level-triggered: the handler reads at most one buffer per
+ * pass and stops reading from paused peers, an edge would be lost in both cases.
+ */
+class CSocketEvents
+{
+public:
+    enum : uint8_t {
+        NONE = 0,
+        RECV = 1 << 0,
+        SEND = 1 << 1,
+        ERR = 1 << 2,
+    };
+
+    explicit CSocketEvents(bool fForceSelect = false);
+    ~CSocketEvents();
+
+    CSocketEvents(const CSocketEvents&) = delete;
+    CSocketEvents& operator=(const CSocketEvents&) = delete;
+
+    /**
+     * Watch a socket for RECV and/or SEND, errors are always reported. nOwner tells a
+     * reused descriptor apart from the closed socket it was registered for. Only a
+     * change of events or owner reaches the kernel.
+     */
+    void Set(SOCKET hSocket, int64_t nOwner, uint8_t nEvents);
+    /** Stop watching every socket not Set since the previous call */
+    void RemoveStale();
+
+    /** Wait up to nTimeoutMs for watched sockets to become ready. False on error */
+    bool Wait(int nTimeoutMs, std::vector<std::pair<SOCKET, uint8_t>>& vReady);
+
+    /** All watched sockets, for treating them as readable after a failed wait */
+    void GetWatched(std::vector<std::pair<SOCKET, uint8_t>>& vWatched) const;
+
+    const char* GetBackendName() const;
+
+private:
+    struct Watch {
+        int64_t nOwner;
+        uint8_t nEvents;
+        bool fSeen;
+    };
+
+    bool Register(SOCKET hSocket, uint8_t nEvents, bool fNew);
+    void Unregister(SOCKET hSocket);
+    bool WaitSelect(int nTimeoutMs, std::vector<std::pair<SOCKET, uint8_t>>& vReady);
+
+    std::unordered_map<SOCKET, Watch> mapWatched;
+    // epoll or kqueue descriptor, -1 when using select
+    int nQueueFd;
+};
+
+#endif // BITCOIN_NETEVENTS_H
@@ -27,6 +27,7 @@
 #include <boost/algorithm/string.hpp>
 
 static bool fCreateBlank;
+static bool fBatch;
 static std::map<std::string,UniValue> registers;
 static const int CONTINUE_EXECUTION=-1;
 
@@ -50,6 +51,7 @@ static int AppInitRawTx(int argc, char* argv[])
     }
 
     fCreateBlank = gArgs.GetBoolArg("-create", false);
+    fBatch = gArgs.GetBoolArg("-batch", false);
 
     if (argc<2 || gArgs.IsArgSet("-?") || gArgs.IsArgSet("-h") || gArgs.IsArgSet("-help"))
     {
@@ -58,14 +60,17 @@ static int AppInitRawTx(int argc, char* argv[])
             _("Usage:") + "\n" +
               "  nix-tx [options] <hex-tx> [commands]  " + _("Update hex-encoded nix transaction") + "\n" +
               "  nix-tx [options] -create [commands]   " + _("Create hex-encoded nix transaction") + "\n" +
+              "  nix-tx [options] -batch [commands]    " + _("Update hex-encoded nix transactions read from standard input") + "\n" +
               "\n";
 
         fprintf(stdout, "%s", strUsage.c_str());
 
         strUsage = HelpMessageGroup(_("Options:"));
         strUsage += HelpMessageOpt("-?", _("This help message"));
+        strUsage += HelpMessageOpt("-batch", _("Read hex-encoded transactions from standard input, one per line, and apply the commands to each of them. The results are output one per line, in the same order"));
         strUsage += HelpMessageOpt("-create", _("Create new, empty TX."));
         strUsage += HelpMessageOpt("-json", _("Select JSON output"));
+        strUsage += HelpMessageOpt("-signthreads=<n>", strprintf(_("Number of threads the inputs of a transaction are signed on (default: %u, the number of cores)"), GetNumCores()));
         strUsage += HelpMessageOpt("-txid", _("Output only the hex-encoded transaction id of the resultant transaction."));
         AppendParamsHelpMessages(strUsage);
 
@@ -545,12 +550,9 @@ static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
         if (!findSighashFlags(nHashType, flagStr))
             throw std::runtime_error("unknown sighash flag/sign option");
 
-    std::vector<CTransaction> txVariants;
-    txVariants.push_back(tx);
-
     // mergedTx will end up with all the signatures; it
     // starts as a clone of the raw tx:
-    CMutableTransaction mergedTx(txVariants[0]);
+    CMutableTransaction mergedTx(tx);
     bool fComplete = true;
     CCoinsView viewDummy;
     CCoinsViewCache view(&viewDummy);
@@ -632,32 +634,17 @@ static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
 
     const CKeyStore& keystore = tempKeystore;
 
-    bool fHashSingle = ((nHashType & ~SIGHASH_ANYONECANPAY) == SIGHASH_SINGLE);
-
-    // Sign what we can:
+    // Sign what we can, the inputs in parallel, and merge in the signatures mergedTx already has:
+    std::vector<CTxOut> vSpent(mergedTx.vin.size());
     for (unsigned int i = 0; i < mergedTx.vin.size(); i++) {
-        CTxIn& txin = mergedTx.vin[i];
-        const Coin& coin = view.AccessCoin(txin.prevout);
-        if (coin.IsSpent()) {
-            fComplete = false;
-            continue;
-        }
-        const CScript& prevPubKey = coin.out.scriptPubKey;
-        const CAmount& amount = coin.out.nValue;
-
-        SignatureData sigdata;
-        // Only sign SIGHASH_SINGLE if there's a corresponding output:
-        if (!fHashSingle || (i < mergedTx.vout.size()))
-            ProduceSignature(MutableTransactionSignatureCreator(&keystore, &mergedTx, i, amount, nHashType), prevPubKey, sigdata, mergedTx.IsCoinStake());
-
-        // ... and merge in other signatures:
-        for (const CTransaction& txv : txVariants)
-            sigdata = CombineSignatures(prevPubKey, MutableTransactionSignatureChecker(&mergedTx, i, amount), sigdata, DataFromTransaction(txv, i), mergedTx.IsCoinStake());
-        UpdateTransaction(mergedTx, i, sigdata);
-
-        if (!VerifyScript(txin.scriptSig, prevPubKey, &txin.scriptWitness, STANDARD_SCRIPT_VERIFY_FLAGS, MutableTransactionSignatureChecker(&mergedTx, i, amount), mergedTx.IsCoinStake()))
-            fComplete = false;
+        const Coin& coin = view.AccessCoin(mergedTx.vin[i].prevout);
+        if (!coin.IsSpent())
+            vSpent[i] = coin.out;
     }
+    std::vector<ScriptError> vErrors;
+    const int nThreads = gArgs.GetArg("-signthreads", GetNumCores());
+    if (!SignTransaction(mergedTx, keystore, vSpent, nHashType, vErrors, nThreads))
+        fComplete = false;
 
     if (fComplete) {
         // do nothing... for now
@@ -680,10 +667,10 @@ public:
     }
 };
 
+//! ecc is started by the first command that needs it, and kept for the following ones
 static void MutateTx(CMutableTransaction& tx, const std::string& command,
-                     const std::string& commandVal)
+                     const std::string& commandVal, std::unique_ptr<Secp256k1Init>& ecc)
 {
-    std::unique_ptr<Secp256k1Init> ecc;
 
     if (command == "nversion")
         MutateTxVersion(tx, commandVal);
@@ -703,10 +690,10 @@ static void MutateTx(CMutableTransaction& tx, const std::string& command,
     else if (command == "outaddr")
         MutateTxAddOutAddr(tx, commandVal);
     else if (command == "outpubkey") {
-        ecc.reset(new Secp256k1Init());
+        if (!ecc) ecc.reset(new Secp256k1Init());
         MutateTxAddOutPubKey(tx, commandVal);
     } else if (command == "outmultisig") {
-        ecc.reset(new Secp256k1Init());
+        if (!ecc) ecc.reset(new Secp256k1Init());
         MutateTxAddOutMultiSig(tx, commandVal);
     } else if (command == "outscript")
         MutateTxAddOutScript(tx, commandVal);
@@ -714,7 +701,7 @@ static void MutateTx(CMutableTransaction& tx, const std::string& command,
         MutateTxAddOutData(tx, commandVal);
 
     else if (command == "sign") {
-        ecc.reset(new Secp256k1Init());
+        if (!ecc) ecc.reset(new Secp256k1Init());
         MutateTxSign(tx, commandVal);
     }
 
@@ -761,6 +748,21 @@ static void OutputTx(const CTransaction& tx)
         OutputTxHex(tx);
 }
 
+//! Applies a command line argument, a command and its value separated by "="
+static void MutateTxCommand(CMutableTransaction& tx, const std::string& arg, std::unique_ptr<Secp256k1Init>& ecc)
+{
+    std::string key, value;
+    size_t eqpos = arg.find('=');
+    if (eqpos == std::string::npos)
+        key = arg;
+    else {
+        key = arg.substr(0, eqpos);
+        value = arg.substr(eqpos + 1);
+    }
+
+    MutateTx(tx, key, value, ecc);
+}
+
 static std::string readStdin()
 {
     char buf[4096];
@@ -793,6 +795,32 @@ static int CommandLineRawTx(int argc, char* argv[])
             argv++;
         }
 
+        std::unique_ptr<Secp256k1Init> ecc;
+
+        if (fBatch) {
+            if (fCreateBlank)
+                throw std::runtime_error("-batch and -create can not be combined");
+
+            // One transaction per line, all of them have the commands applied
+            std::string strLines = readStdin();
+            std::vector<std::string> vLines;
+            boost::split(vLines, strLines, boost::is_any_of("\n"));
+            for (size_t nLine = 0; nLine < vLines.size(); nLine++) {
+                std::string strHexTx = vLines[nLine];
+                boost::algorithm::trim(strHexTx);
+                if (strHexTx.empty())
+                    continue;
+
+                CMutableTransaction tx;
+                if (!DecodeHexTx(tx, strHexTx, true))
+                    throw std::runtime_error(strprintf("invalid transaction encoding on line %u", nLine + 1));
+                for (int i = 1; i < argc; i++)
+                    MutateTxCommand(tx, argv[i], ecc);
+                OutputTx(tx);
+            }
+            return nRet;
+        }
+
         CMutableTransaction tx;
         int startArg;
 
@@ -813,19 +841,8 @@ static int CommandLineRawTx(int argc, char* argv[])
         } else
             startArg = 1;
 
-        for (int i = startArg; i < argc; i++) {
-            std::string arg = argv[i];
-            std::string key, value;
-            size_t eqpos = arg.find('=');
-            if (eqpos == std::string::npos)
-                key = arg;
-            else {
-                key = arg.substr(0, eqpos);
-                value = arg.substr(eqpos + 1);
-            }
-
-            MutateTx(tx, key, value);
-        }
+        for (int i = startArg; i < argc; i++)
+            MutateTxCommand(tx, argv[i], ecc);
 
         OutputTx(tx);
     }
@@ -0,0 +1,174 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <perf.h>
+
+#include <tinyformat.h>
+
+#include <mutex>
+
+std::atomic<bool> g_lock_profiling(DEFAULT_LOCK_PROFILING);
+
+CPerfHistogram::CPerfHistogram() : nSumMicros(0), nMaxMicros(0)
+{
+    for (std::atomic<uint64_t>& bucket : vBuckets)
+        bucket = 0;
+}
+
+void CPerfHistogram::Add(int64_t nMicros)
+{
+    uint64_t nValue = nMicros > 0 ? nMicros : 0;
+    int nBucket = 0;
+    while (nBucket < BUCKETS - 1 && nValue >= (uint64_t)BucketBound(nBucket))
+        nBucket++;
+
+    nSumMicros.fetch_add(nValue, std::memory_order_relaxed);
+    vBuckets[nBucket].fetch_add(1, std::memory_order_relaxed);
+    uint64_t nMax = nMaxMicros.load(std::memory_order_relaxed);
+    while (nValue > nMax && !nMaxMicros.compare_exchange_weak(nMax, nValue, std::memory_order_relaxed)) {}
+}
+
+CPerfHistogram::Snapshot CPerfHistogram::Get() const
+{
+    Snapshot snapshot;
+    snapshot.nCount = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        snapshot.vBuckets[i] = vBuckets[i].load(std::memory_order_relaxed);
+        snapshot.nCount += snapshot.vBuckets[i];
+    }
+    snapshot.nSumMicros = nSumMicros.load(std::memory_order_relaxed);
+    snapshot.nMaxMicros = nMaxMicros.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+static std::mutex& PerfTimersMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<const CPerfTimer*>& PerfTimers()
+{
+    static std::vector<const CPerfTimer*> timers;
+    return timers;
+}
+
+CPerfTimer::CPerfTimer(const char* pszNameIn) : pszName(pszNameIn)
+{
+    std::lock_guard<std::mutex> lock(PerfTimersMutex());
+    PerfTimers().push_back(this);
+}
+
+std::vector<const CPerfTimer*> GetPerfTimers()
+{
+    std::lock_guard<std::mutex> lock(PerfTimersMutex());
+    return PerfTimers();
+}
+
+// Lock sites live in a fixed open addressing table, so recording a lock never
+// allocates or takes another lock. Slots are claimed once and never released.
+static const size_t LOCK_PROFILE_SITES = 2048;
+static CLockSiteStats lockSites[LOCK_PROFILE_SITES];
+
+static uint64_t LockSiteKey(const char* pszName, const char* pszFile, int nLine)
+{
+    uint64_t nKey = (uint64_t)(uintptr_t)pszFile * 0x9E3779B97F4A7C15ULL;
+    nKey ^= (uint64_t)(uintptr_t)pszName + 0x7F4A7C159E3779B9ULL + (nKey << 6) + (nKey >> 2);
+    nKey ^= (uint64_t)nLine * 0xC2B2AE3D27D4EB4FULL;
+    return nKey ? nKey : 1;
+}
+
+CLockSiteStats* GetLockSiteStats(const char* pszName, const char* pszFile, int nLine)
+{
+    const uint64_t nKey = LockSiteKey(pszName, pszFile, nLine);
+    for (size_t i = 0; i < LOCK_PROFILE_SITES; i++) {
+        CLockSiteStats& site = lockSites[(nKey + i) % LOCK_PROFILE_SITES];
+        uint64_t nSlotKey = site.nKey.load(std::memory_order_acquire);
+        if (nSlotKey == 0) {
+            if (site.nKey.compare_exchange_strong(nSlotKey, nKey, std::memory_order_acq_rel)) {
+                site.pszName = pszName;
+                site.pszFile = pszFile;
+                site.nLine = nLine;
+                site.fReady.store(true, std::memory_order_release);
+                return &site;
+            }
+            // nSlotKey now holds the key of whoever claimed the slot first
+        }
+        if (nSlotKey != nKey)
+            continue;
+        while (!site.fReady.load(std::memory_order_acquire)) {}
+        if (site.pszName == pszName && site.pszFile == pszFile && site.nLine == nLine)
+            return &site;
+    }
+    return nullptr;
+}
+
+std::vector<const CLockSiteStats*> GetLockSites()
+{
+    std::vector<const CLockSiteStats*> vSites;
+    for (const CLockSiteStats& site : lockSites) {
+        if (site.fReady.load(std::memory_order_acquire))
+            vSites.push_back(&site);
+    }
+    return vSites;
+}
+
+static std::string EscapeLabel(const std::string& str)
+{
+    std::string strRet;
+    for (char c : str) {
+        if (c == '\\' || c == '"')
+            strRet += '\\';
+        if (c == '\n') {
+            strRet += "\\n";
+            continue;
+        }
+        strRet += c;
+    }
+    return strRet;
+}
+
+static void FormatHistogram(std::string& strOut, const std::string& strMetric, const std::string& strLabels, const CPerfHistogram::Snapshot& snapshot)
+{
+    uint64_t nCumulative = 0;
+    for (int i = 0; i < CPerfHistogram::BUCKETS - 1; i++) {
+        nCumulative += snapshot.vBuckets[i];
+        strOut += strprintf("%s_bucket{%s,le=\"%d\"} %u\n", strMetric, strLabels, CPerfHistogram::BucketBound(i), nCumulative);
+    }
+    strOut += strprintf("%s_bucket{%s,le=\"+Inf\"} %u\n", strMetric, strLabels, snapshot.nCount);
+    strOut += strprintf("%s_sum{%s} %u\n", strMetric, strLabels, snapshot.nSumMicros);
+    strOut += strprintf("%s_count{%s} %u\n", strMetric, strLabels, snapshot.nCount);
+}
+
+std::string FormatPerfStatsPrometheus()
+{
+    std::string strOut;
+    const std::vector<const CLockSiteStats*> vSites = GetLockSites();
+
+    strOut += "# HELP nix_lock_profiling Whether lock sites are being profiled (-lockprofile)\n";
+    strOut += "# TYPE nix_lock_profiling gauge\n";
+    strOut += strprintf("nix_lock_profiling %d\n", g_lock_profiling.load() ? 1 : 0);
+
+    strOut += "# HELP nix_lock_contended_total Acquisitions that found the lock held, per LOCK site\n";
+    strOut += "# TYPE nix_lock_contended_total counter\n";
+    for (const CLockSiteStats* site : vSites)
+        strOut += strprintf("nix_lock_contended_total{lock=\"%s\",site=\"%s:%d\"} %u\n", EscapeLabel(site->pszName), EscapeLabel(site->pszFile), site->nLine, site->nContended.load());
+
+    strOut += "# HELP nix_lock_wait_microseconds Time spent acquiring a lock, per LOCK site\n";
+    strOut += "# TYPE nix_lock_wait_microseconds histogram\n";
+    for (const CLockSiteStats* site : vSites)
+        FormatHistogram(strOut, "nix_lock_wait_microseconds", strprintf("lock=\"%s\",site=\"%s:%d\"", EscapeLabel(site->pszName), EscapeLabel(site->pszFile), site->nLine), site->wait.Get());
+
+    strOut += "# HELP nix_lock_hold_microseconds Time a lock was held, per LOCK site\n";
+    strOut += "# TYPE nix_lock_hold_microseconds histogram\n";
+    for (const CLockSiteStats* site : vSites)
+        FormatHistogram(strOut, "nix_lock_hold_microseconds", strprintf("lock=\"%s\",site=\"%s:%d\"", EscapeLabel(site->pszName), EscapeLabel(site->pszFile), site->nLine), site->hold.Get());
+
+    strOut += "# HELP nix_timer_microseconds Time spent in instrumented code paths\n";
+    strOut += "# TYPE nix_timer_microseconds histogram\n";
+    for (const CPerfTimer* timer : GetPerfTimers())
+        FormatHistogram(strOut, "nix_timer_microseconds", strprintf("timer=\"%s\"", EscapeLabel(timer->GetName())), timer->Get());
+
+    return strOut;
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_PERF_H
+#define BITCOIN_PERF_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** -lockprofile default */
+static const bool DEFAULT_LOCK_PROFILING = false;
+
+/** Monotonic microseconds for measuring durations */
+inline int64_t PerfTimeMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Lock-free histogram of durations in power-of-two microsecond buckets.
+ * Bucket i counts durations below 2^(i+1) us, the last one everything longer.
+ */
+class CPerfHistogram
+{
+public:
+    static const int BUCKETS = 24;
+
+    struct Snapshot {
+        uint64_t nCount;
+        uint64_t nSumMicros;
+        uint64_t nMaxMicros;
+        std::array<uint64_t, BUCKETS> vBuckets;
+    };
+
+    CPerfHistogram();
+
+    void Add(int64_t nMicros);
+    Snapshot Get() const;
+
+    /** Exclusive upper bound of bucket i in microseconds */
+    static int64_t BucketBound(int i) { return int64_t(1) << (i + 1); }
+
+private:
+    std::atomic<uint64_t> nSumMicros;
+    std::atomic<uint64_t> nMaxMicros;
+    std::array<std::atomic<uint64_t>, BUCKETS> vBuckets;
+};
+
+/** A named duration histogram for a hot code path, registered for getperfinfo on construction */
+class CPerfTimer
+{
+public:
+    explicit CPerfTimer(const char* pszNameIn);
+
+    void Add(int64_t nMicros) { hist.Add(nMicros); }
+    const char* GetName() const { return pszName; }
+    CPerfHistogram::Snapshot Get() const { return hist.Get(); }
+
+private:
+    const char* pszName;
+    CPerfHistogram hist;
+};
+
+/** Adds the time spent in its scope to a CPerfTimer */
+class CPerfScope
+{
+public:
+    explicit CPerfScope(CPerfTimer& timerIn) : timer(timerIn), nStart(PerfTimeMicros()) {}
+    ~CPerfScope() { timer.Add(PerfTimeMicros() - nStart); }
+
+private:
+    CPerfTimer& timer;
+    int64_t nStart;
+};
+
+std::vector<const CPerfTimer*> GetPerfTimers();
+
+/** Whether LOCK sites record their wait and hold times */
+extern std::atomic<bool> g_lock_profiling;
+
+/** Wait and hold times of one LOCK site */
+struct CLockSiteStats {
+    std::atomic<uint64_t> nKey;
+    std::atomic<bool> fReady;
+    const char* pszName;
+    const char* pszFile;
+    int nLine;
+    std::atomic<uint64_t> nContended;
+    CPerfHistogram wait;
+    CPerfHistogram hold;
+};
+
+/** The stats of a lock site, nullptr once the fixed table of sites is full */
+CLockSiteStats* GetLockSiteStats(const char* pszName, const char* pszFile, int nLine);
+std::vector<const CLockSiteStats*> GetLockSites();
+
+/** All lock sites and timers in the Prometheus text exposition format */
+std::string FormatPerfStatsPrometheus();
+
+#endif // BITCOIN_PERF_H
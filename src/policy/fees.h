@@ -101,6 +101,14 @@ enum class FeeEstimateMode {
 
 bool FeeModeFromString(const std::string& mode_string, FeeEstimateMode& fee_estimate_mode);
 
+/* The kinds of transactions that are estimated apart. Privacy transactions (sigma and
+ * zerocoin mints and spends) are bigger, far fewer, and their fee includes the ghost
+ * protocol fee, they are tracked by the feerate they pay on top of it. */
+enum class FeeEstimateTrack {
+    STANDARD,
+    PRIVACY,
+};
+
 /* Used to return detailed information about a feerate bucket */
 struct EstimatorBucket
 {
@@ -184,6 +192,8 @@ private:
      * Therefore it makes sense to exponentially space the buckets
      */
     static constexpr double FEE_SPACING = 1.05;
+    /** Privacy transactions are lumped into wider buckets, there are too few of them to fill narrow ones */
+    static constexpr double PRIVACY_FEE_SPACING = 1.2;
 
 public:
     /** Create new BlockPolicyEstimator and initialize stats tracking classes with default values */
@@ -208,13 +218,13 @@ public:
      *  the closest target where one can be given.  'conservative' estimates are
      *  valid over longer time horizons also.
      */
-    CFeeRate estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative) const;
+    CFeeRate estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative, FeeEstimateTrack track = FeeEstimateTrack::STANDARD) const;
 
     /** Return a specific fee estimate calculation with a given success
      * threshold and time horizon, and optionally return detailed data about
      * calculation
      */
-    CFeeRate estimateRawFee(int confTarget, double successThreshold, FeeEstimateHorizon horizon, EstimationResult *result = nullptr) const;
+    CFeeRate estimateRawFee(int confTarget, double successThreshold, FeeEstimateHorizon horizon, EstimationResult *result = nullptr, FeeEstimateTrack track = FeeEstimateTrack::STANDARD) const;
 
     /** Write estimation data to a file */
     bool Write(CAutoFile& fileout) const;
@@ -238,32 +248,48 @@ private:
     {
         unsigned int blockHeight;
         unsigned int bucketIndex;
-        TxStatsInfo() : blockHeight(0), bucketIndex(0) {}
+        FeeEstimateTrack track;
+        TxStatsInfo() : blockHeight(0), bucketIndex(0), track(FeeEstimateTrack::STANDARD) {}
     };
 
     // map of txids to information about that transaction
     std::map<uint256, TxStatsInfo> mapMemPoolTxs;
 
-    /** Classes to track historical data on transaction confirmations */
-    std::unique_ptr<TxConfirmStats> feeStats;
-    std::unique_ptr<TxConfirmStats> shortStats;
-    std::unique_ptr<TxConfirmStats> longStats;
+    /** The feerate buckets and confirmation stats of one FeeEstimateTrack */
+    struct FeeTrack
+    {
+        std::vector<double> buckets;              // The upper-bound of the range for the bucket (inclusive)
+        std::map<double, unsigned int> bucketMap; // Map of bucket upper-bound to index into all vectors by bucket
+
+        /** Classes to track historical data on transaction confirmations */
+        std::unique_ptr<TxConfirmStats> feeStats;
+        std::unique_ptr<TxConfirmStats> shortStats;
+        std::unique_ptr<TxConfirmStats> longStats;
+    };
+    FeeTrack standardTrack;
+    FeeTrack privacyTrack;
 
     unsigned int trackedTxs;
     unsigned int untrackedTxs;
 
-    std::vector<double> buckets;              // The upper-bound of the range for the bucket (inclusive)
-    std::map<double, unsigned int> bucketMap; // Map of bucket upper-bound to index into all vectors by bucket
-
     mutable CCriticalSection cs_feeEstimator;
 
+    const FeeTrack& GetTrack(FeeEstimateTrack track) const;
+    FeeTrack& GetTrack(FeeEstimateTrack track);
+    /** Set up the buckets of a track, exponentially spaced by spacing, and empty stats on them */
+    static void InitTrack(FeeTrack& track, double spacing);
+    /** Read the buckets and stats of a track written by Write into track */
+    static void ReadTrack(CAutoFile& filein, int nFileVersion, FeeTrack& track);
+    /** The track and feerate a transaction is estimated by */
+    static FeeEstimateTrack GetTxTrack(const CTxMemPoolEntry& entry, CFeeRate& feeRate);
+
     /** Process a transaction confirmed in a block*/
     bool processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry);
 
     /** Helper for estimateSmartFee */
-    double estimateCombinedFee(unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result) const;
+    double estimateCombinedFee(const FeeTrack& track, unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result) const;
     /** Helper for estimateSmartFee */
-    double estimateConservativeFee(unsigned int doubleTarget, EstimationResult *result) const;
+    double estimateConservativeFee(const FeeTrack& track, unsigned int doubleTarget, EstimationResult *result) const;
     /** Number of blocks of data recorded while fee estimates have been running */
     unsigned int BlockSpan() const;
     /** Number of blocks of recorded fee estimate data represented in saved data file */
@@ -274,6 +274,37 @@ CFeeRate incrementalRelayFee = CFeeRate(DEFAULT_INCREMENTAL_RELAY_FEE);
 CFeeRate dustRelayFee = CFeeRate(DUST_RELAY_TX_FEE);
 unsigned int nBytesPerSigOp = DEFAULT_BYTES_PER_SIGOP;
 
+int64_t GetPrivateSpendValidationWeight(const CTransaction& tx)
+{
+    if (!tx.IsSigmaSpend() && !tx.IsZerocoinSpend())
+        return 0;
+    return (int64_t)tx.vin.size() * PRIVATE_SPEND_VALIDATION_WEIGHT;
+}
+
+bool IsPrivacyTransaction(const CTransaction& tx)
+{
+    return tx.IsSigmaMint() || tx.IsSigmaSpend() || tx.IsZerocoinMint() || tx.IsZerocoinSpend();
+}
+
+CAmount GetGhostProtocolFee(const CTransaction& tx, CAmount nFee)
+{
+    // As GetBlockGhostedAmount counts them: mints pay 0.25% of the amount they mint, and
+    // sigma spends that mint again pay all of their fee as ghost fee
+    const bool isSpend = tx.IsZerocoinSpend() || tx.IsSigmaSpend();
+    const bool isMint = tx.IsZerocoinMint() || tx.IsSigmaMint();
+    if (tx.IsSigmaSpend() && isMint)
+        return nFee;
+    if (isSpend || !isMint)
+        return 0;
+
+    CAmount nGhosted = 0;
+    for (const CTxOut& txout : tx.vout) {
+        if (txout.scriptPubKey.IsZerocoinMint() || txout.scriptPubKey.IsSigmaMint())
+            nGhosted += txout.nValue;
+    }
+    return std::min(nFee, (CAmount)(nGhosted * 0.0025));
+}
+
 int64_t GetVirtualTransactionSize(int64_t nWeight, int64_t nSigOpCost)
 {
     return (std::max(nWeight, nSigOpCost * nBytesPerSigOp) + WITNESS_SCALE_FACTOR - 1) / WITNESS_SCALE_FACTOR;
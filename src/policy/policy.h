@@ -32,6 +32,10 @@ static const unsigned int DEFAULT_MAX_MEMPOOL_SIZE = 300;
 static const unsigned int DEFAULT_INCREMENTAL_RELAY_FEE = 1000;
 /** Default for -bytespersigop */
 static const unsigned int DEFAULT_BYTES_PER_SIGOP = 20;
+/** Weight added to each Sigma or Zerocoin spend input for the cost of verifying its proof, used for mempool and mining feerates */
+static const unsigned int PRIVATE_SPEND_VALIDATION_WEIGHT = 20000;
+/** The maximum proof validation weight of the private spends the mining code puts in a block */
+static const unsigned int MAX_BLOCK_VALIDATION_WEIGHT = MAX_BLOCK_WEIGHT / 2;
 /** The maximum number of witness stack items in a standard P2WSH script */
 static const unsigned int MAX_STANDARD_P2WSH_STACK_ITEMS = 100;
 /** The maximum size of each witness stack item in a standard P2WSH script */
@@ -99,6 +103,15 @@ extern CFeeRate incrementalRelayFee;
 extern CFeeRate dustRelayFee;
 extern unsigned int nBytesPerSigOp;
 
+/** Weight standing for the proof verification cost of a transaction, zero unless it spends private coins */
+int64_t GetPrivateSpendValidationWeight(const CTransaction& tx);
+
+/** Whether a transaction mints or spends private coins, their fees are estimated apart */
+bool IsPrivacyTransaction(const CTransaction& tx);
+
+/** The part of nFee, the fee of tx, that is the ghost protocol fee of the coins it mints */
+CAmount GetGhostProtocolFee(const CTransaction& tx, CAmount nFee);
+
 /** Compute the virtual transaction size (weight reinterpreted as bytes). */
 int64_t GetVirtualTransactionSize(int64_t nWeight, int64_t nSigOpCost);
 int64_t GetVirtualTransactionSize(const CTransaction& tx, int64_t nSigOpCost = 0);
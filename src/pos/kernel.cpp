@@ -19,6 +19,11 @@
 #include <policy/policy.h>
 #include <consensus/validation.h>
 #include <coins.h>
+#include <sigma/parallel.h>
+#include <rpc/blockchain.h>
+
+#include <atomic>
+#include <deque>
 
 /**
  * Stake Modifier (hash modifier of proof-of-stake):
@@ -32,9 +37,15 @@ uint256 ComputeStakeModifierV2(const CBlockIndex *pindexPrev, const uint256 &ker
     if (!pindexPrev)
         return uint256();  // genesis block's modifier is 0
 
-    CDataStream ss(SER_GETHASH, 0);
+    CHashWriter ss(SER_GETHASH, 0);
     ss << kernel << pindexPrev->bnStakeModifier;
-    return Hash(ss.begin(), ss.end());
+    return ss.GetHash();
+}
+
+void WriteStakeKernelPrefix(CHashWriter &ss, const uint256 &bnStakeModifier, uint32_t nBlockFromTime, const COutPoint &prevout)
+{
+    ss << bnStakeModifier;
+    ss << nBlockFromTime << prevout.hash << prevout.n;
 }
 
 /**
@@ -88,12 +99,10 @@ bool CheckStakeKernelHash(const CBlockIndex *pindexPrev,
 
     uint256 bnStakeModifier = pindexPrev->bnStakeModifier;
 
-
-
-    CDataStream ss(SER_GETHASH, 0);
-    ss << bnStakeModifier;
-    ss << nBlockFromTime << prevout.hash << prevout.n << nTime;
-    hashProofOfStake = Hash(ss.begin(), ss.end());
+    CHashWriter ss(SER_GETHASH, 0);
+    WriteStakeKernelPrefix(ss, bnStakeModifier, nBlockFromTime, prevout);
+    ss << nTime;
+    hashProofOfStake = ss.GetHash();
 
     /*
     LogPrintf("CheckStakeKernelHash(): \n"
@@ -168,14 +177,18 @@ bool CheckProofOfStake(const CBlockIndex *pindexPrev, const CTransaction &tx, in
     Coin coin;
     if (!pcoinsTip->GetCoin(txin.prevout, coin) || coin.IsSpent())
     {
-        // Must find the prevout in the txdb / blocks
-
-        CBlock blockKernel; // block containing stake kernel, GetTransaction should only fill the header.
-        if (!GetTransaction(txin.prevout.hash, txPrev, Params().GetConsensus(), blockKernel, true)
-            || txin.prevout.n >= txPrev->vout.size())
-            return state.DoS(10, error("%s: prevout-not-in-chain", __func__), REJECT_INVALID, "prevout-not-in-chain");
+        // Must find the prevout in the kernel cache or the txdb / blocks
+        CTxOut outPrev;
+        if (!stakeKernelCache.GetOrigin(txin.prevout, outPrev, nBlockFromTime))
+        {
+            CBlock blockKernel; // block containing stake kernel, GetTransaction should only fill the header.
+            if (!GetTransaction(txin.prevout.hash, txPrev, Params().GetConsensus(), blockKernel, true)
+                || txin.prevout.n >= txPrev->vout.size())
+                return state.DoS(10, error("%s: prevout-not-in-chain", __func__), REJECT_INVALID, "prevout-not-in-chain");
 
-        const CTxOut outPrev = txPrev->vout[txin.prevout.n];
+            outPrev = txPrev->vout[txin.prevout.n];
+            nBlockFromTime = blockKernel.nTime;
+        }
 
         int nDepth;
         if (!CheckAge(pindexPrev, hashBlock, nDepth))
@@ -183,7 +196,6 @@ bool CheckProofOfStake(const CBlockIndex *pindexPrev, const CTransaction &tx, in
 
         kernelPubKey = outPrev.scriptPubKey;
         amount = outPrev.nValue;
-        nBlockFromTime = blockKernel.nTime;
     } else
     {
         CBlockIndex *pindex = chainActive[coin.nHeight];
@@ -205,6 +217,7 @@ bool CheckProofOfStake(const CBlockIndex *pindexPrev, const CTransaction &tx, in
         kernelPubKey = coin.out.scriptPubKey;
         amount = coin.out.nValue;
         nBlockFromTime = pindex->GetBlockTime();
+        stakeKernelCache.InsertOrigin(txin.prevout, coin.out, pindex);
     };
 
     const CScript &scriptSig = txin.scriptSig;
@@ -243,11 +256,16 @@ bool CheckProofOfStake(const CBlockIndex *pindexPrev, const CTransaction &tx, in
             Coin coin;
             if (!pcoinsTip->GetCoin(txin.prevout, coin) || coin.IsSpent())
             {
-                if (!GetTransaction(txin.prevout.hash, txPrev, Params().GetConsensus(), hashBlock, true)
-                    || txin.prevout.n >= txPrev->vout.size())
-                    return state.DoS(1, error("%s: prevout-not-in-chain %d", __func__, k), REJECT_INVALID, "prevout-not-in-chain");
+                CTxOut outPrev;
+                uint32_t nInputBlockTime;
+                if (!stakeKernelCache.GetOrigin(txin.prevout, outPrev, nInputBlockTime))
+                {
+                    if (!GetTransaction(txin.prevout.hash, txPrev, Params().GetConsensus(), hashBlock, true)
+                        || txin.prevout.n >= txPrev->vout.size())
+                        return state.DoS(1, error("%s: prevout-not-in-chain %d", __func__, k), REJECT_INVALID, "prevout-not-in-chain");
 
-                const CTxOut outPrev = txPrev->vout[txin.prevout.n];
+                    outPrev = txPrev->vout[txin.prevout.n];
+                }
 
                 if (kernelPubKey != outPrev.scriptPubKey)
                     return state.DoS(100, error("%s: mixed-prevout-scripts %d", __func__, k), REJECT_INVALID, "mixed-prevout-scripts");
@@ -259,6 +277,7 @@ bool CheckProofOfStake(const CBlockIndex *pindexPrev, const CTransaction &tx, in
                 if (kernelPubKey != coin.out.scriptPubKey)
                     return state.DoS(100, error("%s: mixed-prevout-scripts %d", __func__, k), REJECT_INVALID, "mixed-prevout-scripts");
                 amount += coin.out.nValue;
+                stakeKernelCache.InsertOrigin(txin.prevout, coin.out, chainActive[coin.nHeight]);
             }
         }
 
@@ -366,3 +385,200 @@ bool CheckKernel(const CBlockIndex *pindexPrev, unsigned int nBits, int64_t nTim
         amount, prevout, nTime, hashProofOfStake, targetProofOfStake);
 }
 
+void CStakeKernelSearch::Reset(const CBlockIndex *pindexPrevIn, unsigned int nBitsIn)
+{
+    pindexPrev = pindexPrevIn;
+    nBits = nBitsIn;
+    vCandidates.clear();
+    setSeen.clear();
+    setHits.clear();
+    nSweepFrom = 0;
+    nSweepStep = 0;
+    nSweepSlots = 0;
+
+    bool fNegative;
+    bool fOverflow;
+    bnTargetPerCoin.SetCompact(nBits, &fNegative, &fOverflow);
+    if (fNegative || fOverflow)
+        bnTargetPerCoin = 0;
+}
+
+void CStakeKernelSearch::AddCoin(const COutPoint &prevout)
+{
+    if (!pindexPrev || bnTargetPerCoin == 0)
+        return;
+    if (!setSeen.insert(prevout).second)
+        return;
+
+    // Same checks as CheckKernel
+    Coin coin;
+    {
+        LOCK(cs_main);
+        if (!pcoinsTip->GetCoin(prevout, coin) || coin.IsSpent())
+            return;
+        CBlockIndex *pindex = chainActive[coin.nHeight];
+        if (!pindex)
+            return;
+
+        int coinbaseMaturity = chainActive.Height() >= Params().GetConsensus().nCoinMaturityReductionHeight ?
+                    COINBASE_MATURITY_V2 : COINBASE_MATURITY;
+
+        bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET || Params().NetworkIDString() == CBaseChainParams::REGTEST);
+        if(fTestNet)
+            coinbaseMaturity = COINBASE_MATURITY_TESTNET;
+
+        int nRequiredDepth = (int)(coinbaseMaturity-1);
+        if (nRequiredDepth > pindexPrev->nHeight - (int)coin.nHeight)
+            return;
+
+        Candidate candidate;
+        candidate.prevout = prevout;
+        candidate.nBlockFromTime = pindex->GetBlockTime();
+        candidate.bnTarget = bnTargetPerCoin * arith_uint256(coin.out.nValue);
+
+        WriteStakeKernelPrefix(candidate.hasher, pindexPrev->bnStakeModifier, candidate.nBlockFromTime, prevout);
+        vCandidates.push_back(candidate);
+    }
+
+    // Coins added after a sweep still need the slots of that sweep
+    if (nSweepSlots > 0)
+    {
+        std::vector<std::pair<int64_t, COutPoint> > vHits;
+        SweepCandidate(vCandidates.back(), nSweepFrom, nSweepStep, nSweepSlots, vHits);
+        setHits.insert(vHits.begin(), vHits.end());
+    }
+}
+
+void CStakeKernelSearch::SweepCandidate(const Candidate &candidate, int64_t nTimeFrom, int64_t nStep, int nSlots,
+    std::vector<std::pair<int64_t, COutPoint> > &vHits) const
+{
+    for (int i = 0; i < nSlots; ++i)
+    {
+        uint32_t nTime = nTimeFrom + i * nStep;
+        if (nTime < candidate.nBlockFromTime)  // Transaction timestamp violation
+            continue;
+
+        CHashWriter ss(candidate.hasher);
+        ss << nTime;
+        uint256 hashProofOfStake = ss.GetHash();
+
+        if (UintToArith256(hashProofOfStake) <= candidate.bnTarget)
+            vHits.push_back(std::make_pair((int64_t)nTime, candidate.prevout));
+    }
+}
+
+void CStakeKernelSearch::Sweep(int64_t nTimeFrom, int64_t nMask, int nThreads, int nSlots)
+{
+    int64_t nStep = nMask + 1;
+    if (nSweepSlots > 0 && nStep == nSweepStep
+        && nTimeFrom >= nSweepFrom && nTimeFrom < nSweepFrom + nSweepSlots * nSweepStep
+        && (nTimeFrom - nSweepFrom) % nSweepStep == 0)
+        return;
+
+    setHits.clear();
+    nSweepFrom = nTimeFrom;
+    nSweepStep = nStep;
+    nSweepSlots = nSlots;
+
+    // Each shard only reads the candidates and writes its own hit list, the lists are merged afterwards
+    size_t nShards = std::max<size_t>(1, std::min<size_t>(std::max(nThreads, 1), vCandidates.size() / SHARD_MIN_COINS));
+    size_t nPerShard = (vCandidates.size() + nShards - 1) / nShards;
+    std::vector<std::vector<std::pair<int64_t, COutPoint> > > vShardHits(nShards);
+    sigma::parallel_for(nShards, nShards, [&](size_t nShard) {
+        size_t nEnd = std::min(vCandidates.size(), (nShard + 1) * nPerShard);
+        for (size_t i = nShard * nPerShard; i < nEnd; ++i)
+            SweepCandidate(vCandidates[i], nSweepFrom, nSweepStep, nSweepSlots, vShardHits[nShard]);
+    });
+    for (const auto &vHits : vShardHits)
+        setHits.insert(vHits.begin(), vHits.end());
+
+    LogPrint(BCLog::POS, "%s: %d coins in %d shards, %d slots from %d, %d hits.\n", __func__, vCandidates.size(), nShards, nSlots, nTimeFrom, setHits.size());
+}
+
+bool CStakeKernelSearch::IsKernel(int64_t nTime, const COutPoint &prevout, int64_t *pBlockTime) const
+{
+    if (!setHits.count(std::make_pair((int64_t)(uint32_t)nTime, prevout)))
+        return false;
+
+    if (pBlockTime)
+    {
+        for (const auto &candidate : vCandidates)
+        {
+            if (candidate.prevout == prevout)
+            {
+                *pBlockTime = candidate.nBlockFromTime;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+namespace {
+
+/** The proof-of-stake blocks of the window, oldest first, and the sum of their difficulties but the oldest's */
+struct StakeWindow
+{
+    std::deque<const CBlockIndex*> vStakes;
+    double dDifficultySum = 0;
+    const CBlockIndex *pindexTip = nullptr;
+
+    void Add(const CBlockIndex *pindex)
+    {
+        if (!vStakes.empty())
+            dDifficultySum += GetDifficulty(pindex);
+        vStakes.push_back(pindex);
+        if ((int)vStakes.size() > NETWORK_STAKE_WINDOW + 1) {
+            vStakes.pop_front();
+            dDifficultySum -= GetDifficulty(vStakes.front());
+        }
+    }
+};
+
+StakeWindow stakeWindow;
+std::atomic<double> dNetworkKernelsPerSecond(0);
+std::atomic<double> dNetworkStakeWeight(0);
+std::atomic<double> dNetworkStakeSpacing(0);
+
+} // namespace
+
+void UpdateNetworkStakeStats(const CBlockIndex *pindexNew)
+{
+    AssertLockHeld(cs_main);
+
+    if (!pindexNew || !stakeWindow.pindexTip || pindexNew->pprev != stakeWindow.pindexTip) {
+        // started, reorganized or disconnected, walk back over the window once
+        std::vector<const CBlockIndex*> vStakes;
+        for (const CBlockIndex *pindex = pindexNew; pindex && (int)vStakes.size() <= NETWORK_STAKE_WINDOW; pindex = pindex->pprev) {
+            if (pindex->IsProofOfStake())
+                vStakes.push_back(pindex);
+        }
+        stakeWindow = StakeWindow();
+        for (auto it = vStakes.rbegin(); it != vStakes.rend(); ++it)
+            stakeWindow.Add(*it);
+    } else if (pindexNew->IsProofOfStake()) {
+        stakeWindow.Add(pindexNew);
+    }
+    stakeWindow.pindexTip = pindexNew;
+
+    double dKernelsPerSecond = 0, dSpacing = 0;
+    if (stakeWindow.vStakes.size() > 1) {
+        int64_t nStakesTime = stakeWindow.vStakes.back()->nTime - stakeWindow.vStakes.front()->nTime;
+        if (nStakesTime > 0) {
+            dKernelsPerSecond = stakeWindow.dDifficultySum * 4294967296.0 / nStakesTime;
+            dSpacing = (double)nStakesTime / (stakeWindow.vStakes.size() - 1);
+        }
+    }
+    dNetworkKernelsPerSecond = dKernelsPerSecond;
+    dNetworkStakeWeight = pindexNew ? dKernelsPerSecond * (Params().GetStakeTimestampMask(pindexNew->nHeight) + 1) : 0;
+    dNetworkStakeSpacing = dSpacing;
+}
+
+NetworkStakeStats GetNetworkStakeStats()
+{
+    NetworkStakeStats stats;
+    stats.dKernelsPerSecond = dNetworkKernelsPerSecond;
+    stats.dWeight = dNetworkStakeWeight;
+    stats.dSpacing = dNetworkStakeSpacing;
+    return stats;
+}
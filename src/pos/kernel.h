@@ -6,12 +6,23 @@
 #ifndef PPCOIN_KERNEL_H
 #define PPCOIN_KERNEL_H
 
+#include <arith_uint256.h>
+#include <hash.h>
 #include <validation.h>
 
+#include <set>
+#include <vector>
+
 
 // Compute the hash modifier for proof-of-stake
 uint256 ComputeStakeModifierV2(const CBlockIndex *pindexPrev, const uint256 &kernel);
 
+/**
+ * Feed everything but nTime into a kernel hash, the state can be copied and reused
+ * for every timestamp tried with the same coin
+ */
+void WriteStakeKernelPrefix(CHashWriter &ss, const uint256 &bnStakeModifier, uint32_t nBlockFromTime, const COutPoint &prevout);
+
 /**
  * Check whether stake kernel meets hash target
  * Sets hashProofOfStake on success return
@@ -41,4 +52,84 @@ bool CheckCoinStakeTimestamp(int nHeight, int64_t nTimeBlock);
  */
 bool CheckKernel(const CBlockIndex *pindexPrev, unsigned int nBits, int64_t nTime, const COutPoint &prevout, int64_t* pBlockTime = nullptr);
 
+//! Proof-of-stake blocks the network stake statistics are taken over
+static const int NETWORK_STAKE_WINDOW = 200;
+
+/**
+ * Move the network stake statistics to the new tip of the active chain. A tip extending
+ * the last one is added to the window, anything else rebuilds it. cs_main must be held.
+ */
+void UpdateNetworkStakeStats(const CBlockIndex *pindexNew);
+
+/** Network stake statistics over the last NETWORK_STAKE_WINDOW stakes, read without a lock */
+struct NetworkStakeStats
+{
+    //! Kernel hashes tried per second by the network
+    double dKernelsPerSecond;
+    //! Stake weight of the network, kernels per second scaled by the timestamp granularity
+    double dWeight;
+    //! Average seconds between proof-of-stake blocks
+    double dSpacing;
+};
+NetworkStakeStats GetNetworkStakeStats();
+
+/**
+ * Kernel search for the staker.
+ * The part of the kernel hash that only depends on the coin (stake modifier, block time
+ * and prevout) is hashed once per tip, each timestamp slot then only appends nTime to a
+ * copy of that state. Several slots are swept in one pass so later searches on the same
+ * tip just look up the hits.
+ */
+class CStakeKernelSearch
+{
+public:
+    static const int SEARCH_SLOTS = 8;
+    //! Coins per shard when a sweep is split over several threads
+    static const size_t SHARD_MIN_COINS = 256;
+
+    CStakeKernelSearch() { Reset(nullptr, 0); }
+
+    //! Drop all state, required whenever the tip or nBits change
+    void Reset(const CBlockIndex *pindexPrevIn, unsigned int nBitsIn);
+    bool IsValidFor(const CBlockIndex *pindexPrevIn, unsigned int nBitsIn) const
+    {
+        return pindexPrevIn && pindexPrev == pindexPrevIn && nBits == nBitsIn;
+    }
+
+    //! Look the coin up and hash its fixed part, coins CheckKernel would reject are ignored
+    void AddCoin(const COutPoint &prevout);
+
+    //! Hash all coins for nSlots slots starting at nTimeFrom, slots already swept are skipped.
+    //! The coins are split into shards evaluated on up to nThreads threads.
+    void Sweep(int64_t nTimeFrom, int64_t nMask, int nThreads = 1, int nSlots = SEARCH_SLOTS);
+
+    //! Same result as CheckKernel() for a swept nTime, without hashing
+    bool IsKernel(int64_t nTime, const COutPoint &prevout, int64_t *pBlockTime) const;
+
+private:
+    struct Candidate
+    {
+        Candidate() : hasher(SER_GETHASH, 0) {}
+
+        COutPoint prevout;
+        uint32_t nBlockFromTime;
+        arith_uint256 bnTarget;
+        CHashWriter hasher; // fed with everything but nTime
+    };
+
+    void SweepCandidate(const Candidate &candidate, int64_t nTimeFrom, int64_t nStep, int nSlots,
+        std::vector<std::pair<int64_t, COutPoint> > &vHits) const;
+
+    const CBlockIndex *pindexPrev;
+    unsigned int nBits;
+    arith_uint256 bnTargetPerCoin;
+
+    std::vector<Candidate> vCandidates;
+    std::set<COutPoint> setSeen;
+    int64_t nSweepFrom;
+    int64_t nSweepStep;
+    int nSweepSlots;
+    std::set<std::pair<int64_t, COutPoint> > setHits;
+};
+
 #endif // PPCOIN_KERNEL_H
@@ -7,7 +7,12 @@
 #include <fs.h>
 #include <sync.h>
 #include <net.h>
+#include <timedata.h>
+#include <txmempool.h>
 #include <validation.h>
+#include <validationinterface.h>
+#include <policy/policy.h>
+#include <zerocoin/sigma.h>
 #include <base58.h>
 #include <crypto/sha256.h>
 
@@ -26,9 +31,11 @@ std::vector<StakeThread*> vStakeThreads;
 
 void StakeThread::condWaitFor(int ms)
 {
+    // Consume the wake flag after waiting, a wake raised while the thread was busy searching
+    // must not be lost by the next wait.
     std::unique_lock<std::mutex> lock(mtxMinerProc);
-    fWakeMinerProc = false;
     condMinerProc.wait_for(lock, std::chrono::milliseconds(ms), [this] { return this->fWakeMinerProc; });
+    fWakeMinerProc = false;
 };
 
 std::atomic<bool> fStopMinerProc(false);
@@ -38,46 +45,216 @@ std::atomic<bool> fIsStaking(false);
 
 int nMinStakeInterval = 0;  // min stake interval in seconds
 int nMinerSleep = 500;
+int nStakeSearchThreads = 1; // threads a single wallet's kernel search is split over
 std::atomic<int64_t> nTimeLastStake(0);
 
-extern double GetDifficulty(const CBlockIndex* blockindex = nullptr);
-
-double GetPoSKernelPS()
+/**
+ * Block template shared by the stake threads. It is assembled once per tip and then kept up to
+ * date from mempool notifications: a new transaction is appended when its in-mempool parents are
+ * already in the template, removing a transaction the template holds has it assembled again.
+ * Transactions that can't be appended (mints, children of left out parents, ...) are picked up
+ * by the next full assembly, at the latest STAKE_TEMPLATE_REFRESH_INTERVAL seconds later.
+ */
+class CStakeTemplate : public CValidationInterface
 {
-    LOCK(cs_main);
+public:
+    /** Copy of the template for a stake attempt, nullptr if no template could be assembled */
+    std::unique_ptr<CBlockTemplate> Get(const CScript& coinbaseScript);
+
+protected:
+    void MempoolSequence(const CTransactionRef &ptx, bool fAdded, MemPoolRemovalReason reason, uint64_t nSequence) override;
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+
+private:
+    void Assemble(const CScript& coinbaseScript);
+    bool Append(const CTransactionRef& ptx, const BlockAssembler::Options& options);
+
+    CCriticalSection cs;
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    std::set<uint256> setTemplateTx;
+    std::vector<CTransactionRef> vPending;
+    bool fStale = true;
+    bool fLeftOut = false;
+    int64_t nTemplateTime = 0;
+    uint64_t nWeight = 0;
+    int64_t nSigOpsCost = 0;
+    int64_t nValidationWeight = 0;
+};
 
-    CBlockIndex *pindex = chainActive.Tip();
-    CBlockIndex *pindexPrevStake = nullptr;
+static CStakeTemplate stakeTemplate;
 
-    int nBestHeight = pindex->nHeight;
+CAmount GetStakeTemplateGhostFees(const CBlock& block)
+{
+    CAmount nGhostFees = 0;
+
+    //check for zerocoin mints, start after coinbase
+    if(chainActive.Height() + 1 > Params().GetConsensus().nGhostnodePaymentsStartBlock){
+        for(int i = 1; i < block.vtx.size(); i++){
+
+            //Avoid 2-way ghosting miscalculation
+            if(block.vtx[i]->IsSigmaMint() && !block.vtx[i]->IsSigmaSpend()){
+                //scrape fees payouts, 0.25% or minimum of 0.01 coins
+                //whole block is zerocoin mint
+                CAmount mintAmount = 0;
+                for(int k = 0; k < block.vtx[i]->vout.size(); k++){
+                    if(block.vtx[i]->vout[k].scriptPubKey.IsSigmaMint())
+                        mintAmount += block.vtx[i]->vout[k].nValue;
+                }
+                nGhostFees += mintAmount * 0.0025;
 
-    int nPoSInterval = 200; // blocks sampled
-    double dStakeKernelsTriedAvg = 0;
-    int nStakesHandled = 0, nStakesTime = 0;
+            }
+
+            if(block.vtx[i]->IsSigmaSpend() && block.vtx[i]->IsSigmaMint()){
+                CAmount inVal = 0;
+                CAmount outVal = 0;
+                for(int k = 0; k < block.vtx[i]->vout.size(); k++){
+                    if(!block.vtx[i]->vout[k].scriptPubKey.IsSigmaMint())
+                        continue;
+                    outVal += block.vtx[i]->vout[k].nValue;
+                }
+                // add input denoms
+                for(int k = 0; k < block.vtx[i]->vin.size(); k++){
+                    inVal += ParseSigmaSpendView(block.vtx[i]->vin[k]).first.getIntDenomination();
+                }
+                nGhostFees += inVal - outVal;
 
-    while (pindex && nStakesHandled < nPoSInterval)
-    {
-        if (pindex->IsProofOfStake())
-        {
-            if (pindexPrevStake)
-            {
-                dStakeKernelsTriedAvg += GetDifficulty(pindexPrevStake) * 4294967296.0;
-                nStakesTime += pindexPrevStake->nTime - pindex->nTime;
-                nStakesHandled++;
             }
-            pindexPrevStake = pindex;
         }
-        pindex = pindex->pprev;
     }
+    return nGhostFees;
+}
 
-    double result = 0;
+void CStakeTemplate::MempoolSequence(const CTransactionRef &ptx, bool fAdded, MemPoolRemovalReason reason, uint64_t nSequence)
+{
+    LOCK(cs);
+    if (fStale)
+        return;
+    if (!fAdded) {
+        if (setTemplateTx.count(ptx->GetHash()))
+            fStale = true;
+        return;
+    }
+    if (vPending.size() >= MAX_STAKE_TEMPLATE_PENDING) {
+        fStale = true;
+        return;
+    }
+    vPending.push_back(ptx);
+}
 
-    if (nStakesTime)
-        result = dStakeKernelsTriedAvg / nStakesTime;
+void CStakeTemplate::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    LOCK(cs);
+    if (pblocktemplate && pblocktemplate->block.hashPrevBlock != pindexNew->GetBlockHash())
+        fStale = true;
+}
 
-    result *= Params().GetStakeTimestampMask(nBestHeight) + 1;
+void CStakeTemplate::Assemble(const CScript& coinbaseScript)
+{
+    AssertLockHeld(cs);
+    vPending.clear();
+    setTemplateTx.clear();
+    fLeftOut = false;
+    nTemplateTime = GetTime();
+    pblocktemplate = BlockAssembler(Params()).CreateNewBlock(coinbaseScript);
+    if (!pblocktemplate)
+        return;
 
-    return result;
+    nWeight = 4000; // as reserved by BlockAssembler for the coinbase
+    nSigOpsCost = 400;
+    nValidationWeight = 0;
+    const std::vector<CTransactionRef>& vtx = pblocktemplate->block.vtx;
+    for (size_t i = 1; i < vtx.size(); i++) {
+        setTemplateTx.insert(vtx[i]->GetHash());
+        nWeight += GetTransactionWeight(*vtx[i]);
+        nSigOpsCost += pblocktemplate->vTxSigOpsCost[i];
+        nValidationWeight += GetPrivateSpendValidationWeight(*vtx[i]);
+    }
+    fStale = false;
+}
+
+bool CStakeTemplate::Append(const CTransactionRef& ptx, const BlockAssembler::Options& options)
+{
+    AssertLockHeld(cs);
+    AssertLockHeld(cs_main);
+    AssertLockHeld(mempool.cs);
+
+    const CTransaction& tx = *ptx;
+    if (setTemplateTx.count(tx.GetHash()))
+        return true;
+    CTxMemPool::txiter it = mempool.mapTx.find(tx.GetHash());
+    if (it == mempool.mapTx.end())
+        return true; // gone again, the removal marked the template if needed
+
+    // Mints have fee rules of their own, they wait for the next assembly
+    if (tx.IsZerocoinMint() || tx.IsSigmaMint())
+        return false;
+    if (tx.IsZerocoinSpend() || tx.IsSigmaSpend()) {
+        if (nValidationWeight + it->GetValidationWeight() > MAX_BLOCK_VALIDATION_WEIGHT)
+            return false;
+    } else {
+        for (CTxMemPool::txiter parent : mempool.GetMemPoolParents(it)) {
+            if (!setTemplateTx.count(parent->GetTx().GetHash()))
+                return false;
+        }
+        if (it->GetModifiedFee() < options.blockMinFeeRate.GetFee(it->GetTxSize()))
+            return false;
+    }
+
+    size_t nBlockMaxWeight = std::max<size_t>(4000, std::min<size_t>(MAX_BLOCK_WEIGHT - 4000, options.nBlockMaxWeight));
+    if (nWeight + it->GetTxWeight() >= nBlockMaxWeight || nSigOpsCost + it->GetSigOpCost() >= MAX_BLOCK_SIGOPS_COST)
+        return false;
+    if (!CheckFinalTx(tx, STANDARD_LOCKTIME_VERIFY_FLAGS))
+        return false;
+    if (tx.HasWitness() && !IsWitnessEnabled(chainActive.Tip(), Params().GetConsensus()))
+        return false;
+
+    pblocktemplate->block.vtx.push_back(ptx);
+    pblocktemplate->vTxFees.push_back(it->GetFee());
+    pblocktemplate->vTxSigOpsCost.push_back(it->GetSigOpCost());
+    pblocktemplate->vTxFees[0] -= it->GetFee();
+    pblocktemplate->nGhostFees = -1;
+    setTemplateTx.insert(tx.GetHash());
+    nWeight += it->GetTxWeight();
+    nSigOpsCost += it->GetSigOpCost();
+    nValidationWeight += it->GetValidationWeight();
+    return true;
+}
+
+std::unique_ptr<CBlockTemplate> CStakeTemplate::Get(const CScript& coinbaseScript)
+{
+    LOCK(cs);
+    if (pblocktemplate && !fStale) {
+        LOCK(cs_main);
+        if (pblocktemplate->block.hashPrevBlock != chainActive.Tip()->GetBlockHash()
+                || (fLeftOut && GetTime() - nTemplateTime > STAKE_TEMPLATE_REFRESH_INTERVAL))
+            fStale = true;
+    }
+
+    if (!pblocktemplate || fStale) {
+        Assemble(coinbaseScript);
+    } else if (!vPending.empty()) {
+        BlockAssembler::Options options = BlockAssembler::DefaultOptions(Params());
+        LOCK2(cs_main, mempool.cs);
+        for (const CTransactionRef& ptx : vPending) {
+            if (!Append(ptx, options))
+                fLeftOut = true;
+        }
+        vPending.clear();
+    }
+
+    if (!pblocktemplate)
+        return nullptr;
+    if (pblocktemplate->nGhostFees < 0) {
+        LOCK(cs_main);
+        pblocktemplate->nGhostFees = GetStakeTemplateGhostFees(pblocktemplate->block);
+    }
+    // SignBlock puts the coinstake into the block it is given, the shared template stays as it is
+    return std::unique_ptr<CBlockTemplate>(new CBlockTemplate(*pblocktemplate));
+}
+
+void StartStakeTemplateUpdates()
+{
+    RegisterValidationInterface(&stakeTemplate);
 }
 
 bool CheckStake(CBlock *pblock)
@@ -135,6 +312,7 @@ void ShutdownThreadStakeMiner()
         delete t;
     };
     vStakeThreads.clear();
+    UnregisterValidationInterface(&stakeTemplate);
 };
 
 void WakeThreadStakeMiner(CWallet *pwallet)
@@ -159,8 +337,32 @@ bool ThreadStakeMinerStopped()
     return fStopMinerProc;
 }
 
+/** Wake the waitforstakingstatus callers when a wallet started or stopped staking, or why it doesn't changed */
+static void NotifyStakingStatus()
+{
+    static CCriticalSection cs_lastStatus;
+    static std::vector<int> vLastStatus;
+    static bool fLastIsStaking = false;
+
+    std::vector<int> vStatus;
+    for (const CWalletRef pwallet : ::vpwallets)
+        vStatus.push_back(pwallet->nIsStaking);
+
+    {
+        LOCK(cs_lastStatus);
+        if (vStatus == vLastStatus && fIsStaking == fLastIsStaking)
+            return;
+        vLastStatus = vStatus;
+        fLastIsStaking = fIsStaking;
+    }
+    NotifyStateChange();
+}
+
 static inline void condWaitFor(size_t nThreadID, int ms)
 {
+    // every round of the stake threads ends here
+    NotifyStakingStatus();
+
     assert(vStakeThreads.size() > nThreadID);
     StakeThread *t = vStakeThreads[nThreadID];
     t->condWaitFor(ms);
@@ -205,21 +407,30 @@ void ThreadStakeMiner(size_t nThreadID, std::vector<CWalletRef> &vpwallets, size
 
         //test pos on regtest
         if(Params().NetworkIDString() != CBaseChainParams::REGTEST && Params().NetworkIDString() != CBaseChainParams::TESTNET){
-            if (g_connman->vNodes.empty() || IsInitialBlockDownload())
+            if (g_connman->vNodes.empty())
             {
                 fIsStaking = false;
                 fTryToSync = true;
-                LogPrint(BCLog::POS, "%s: IsInitialBlockDownload\n", __func__);
+                LogPrint(BCLog::POS, "%s: No peers\n", __func__);
                 condWaitFor(nThreadID, 2000);
                 continue;
             }
+
+            if (IsInitialBlockDownload())
+            {
+                fIsStaking = false;
+                fTryToSync = true;
+                LogPrint(BCLog::POS, "%s: IsInitialBlockDownload\n", __func__);
+                condWaitFor(nThreadID, 30000); // woken by the first tip update after the download
+                continue;
+            }
         }
 
 
         {
-            LOCK(cs_main);
-            nBestHeight = chainActive.Height();
-            nBestTime = chainActive.Tip()->nTime;
+            std::shared_ptr<const CChainSnapshot> chain = GetChainSnapshot();
+            nBestHeight = chain->Height();
+            nBestTime = chain->Tip()->nTime;
         }
 
         if (nBestHeight < GetNumBlocksOfPeers()-1)
@@ -245,9 +456,13 @@ void ThreadStakeMiner(size_t nThreadID, std::vector<CWalletRef> &vpwallets, size
             continue;
         };
 
-        int64_t nTime = GetAdjustedTime();
+        int64_t nTimeMs = GetTimeMillis() + GetTimeOffset() * 1000;
+        int64_t nTime = nTimeMs / 1000;
         int64_t nMask = Params().GetStakeTimestampMask(nBestHeight+1);
         int64_t nSearchTime = nTime & ~nMask;
+        // Milliseconds until the next timestamp slot opens, nothing new can be searched before then
+        // unless the tip or a wallet changes, which wakes the thread.
+        size_t nNextSlotMs = (size_t)std::max((nSearchTime + nMask + 1) * 1000 - nTimeMs, (int64_t)1);
         if (nSearchTime <= nBestTime)
         {
             if (nTime < nBestTime)
@@ -257,8 +472,7 @@ void ThreadStakeMiner(size_t nThreadID, std::vector<CWalletRef> &vpwallets, size
                 continue;
             };
 
-            int64_t nNextSearch = nSearchTime + nMask;
-            condWaitFor(nThreadID, std::min(nMinerSleep + (nNextSearch - nTime) * 1000, (int64_t)10000));
+            condWaitFor(nThreadID, nNextSlotMs);
             continue;
         };
 
@@ -271,7 +485,7 @@ void ThreadStakeMiner(size_t nThreadID, std::vector<CWalletRef> &vpwallets, size
 
             if (nSearchTime <= pwallet->nLastCoinStakeSearchTime)
             {
-                nWaitFor = std::min(nWaitFor, (size_t)nMinerSleep);
+                nWaitFor = std::min(nWaitFor, nNextSlotMs);
                 continue;
             }
 
@@ -303,6 +517,7 @@ void ThreadStakeMiner(size_t nThreadID, std::vector<CWalletRef> &vpwallets, size
                 continue;
             }
 
+            pwallet->RefreshStakeWeight();
             if (pwallet->GetStakeableBalance() <= pwallet->nReserveBalance)
             {
                 pwallet->nIsStaking = CWallet::NOT_STAKING_BALANCE;
@@ -314,7 +529,7 @@ void ThreadStakeMiner(size_t nThreadID, std::vector<CWalletRef> &vpwallets, size
 
             if (!pblocktemplate.get())
             {
-                pblocktemplate = BlockAssembler(Params()).CreateNewBlock(coinbaseScript);
+                pblocktemplate = stakeTemplate.Get(coinbaseScript);
                 if (!pblocktemplate.get())
                 {
                     fIsStaking = false;
@@ -326,11 +541,13 @@ void ThreadStakeMiner(size_t nThreadID, std::vector<CWalletRef> &vpwallets, size
             }
 
             pwallet->nIsStaking = CWallet::IS_STAKING;
-            nWaitFor = nMinerSleep;
+            nWaitFor = std::min(nWaitFor, nNextSlotMs);
             fIsStaking = true;
             if (pwallet->SignBlock(pblocktemplate.get(), nBestHeight+1, nSearchTime))
             {
-                CBlock *pblock = &pblocktemplate->block;
+                // A signed template carries the coinstake, it can't be used for another attempt
+                std::unique_ptr<CBlockTemplate> pblocktemplateSigned = std::move(pblocktemplate);
+                CBlock *pblock = &pblocktemplateSigned->block;
                 if (CheckStake(pblock))
                 {
                      nTimeLastStake = GetTime();
@@ -9,6 +9,11 @@
 
 class CWallet;
 
+/** Seconds after which a stake template that had to leave out new mempool transactions is assembled again */
+static const int64_t STAKE_TEMPLATE_REFRESH_INTERVAL = 60;
+/** Mempool additions kept for the stake template, past this it is assembled again instead */
+static const size_t MAX_STAKE_TEMPLATE_PENDING = 1000;
+
 class StakeThread
 {
 public:
@@ -28,11 +33,15 @@ extern std::atomic<bool> fIsStaking;
 
 extern int nMinStakeInterval;
 extern int nMinerSleep;
-
-double GetPoSKernelPS();
+extern int nStakeSearchThreads;
 
 bool CheckStake(CBlock *pblock);
 
+/** Ghost fees of the transactions of a block to be staked on the tip */
+CAmount GetStakeTemplateGhostFees(const CBlock& block);
+
+/** Keep the block template shared by the stake threads up to date, call before starting them */
+void StartStakeTemplateUpdates();
 void ShutdownThreadStakeMiner();
 void WakeThreadStakeMiner(CWallet *pwallet);
 bool ThreadStakeMinerStopped(); // replace interruption_point
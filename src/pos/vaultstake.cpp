@@ -10,7 +10,7 @@
 #include "boost/foreach.hpp"
 #include "consensus/consensus.h"
 
-bool CompDenom(const CZerocoinEntry &a, const CZerocoinEntry &b) { return a.denomination < b.denomination; }
+#include <map>
 
 CVaultStake::CVaultStake()
 {
@@ -22,19 +22,12 @@ CVaultStake::CVaultStake(list <CZerocoinEntry> &listPubCoin, CValidationState st
 
     CZerocoinState *zerocoinState = CZerocoinState::GetZerocoinState();
 
-    //sort list with highest pubcoin value
-    listPubCoin.sort(CompDenom);
     pubCoinList = listPubCoin;
 
-    CZerocoinEntry coinToUse;
-
-    CBigNum accumulatorValue;
-    uint256 accumulatorBlockHash;
-
-    int coinId = INT_MAX;
-    int coinHeight;
-
-    //remove any coins not old enough
+    // Mature unused coins by group id, the first coin of the list for each. The coin of
+    // the lowest group with a spendable accumulator is used, so the accumulator is only
+    // looked up for groups in order until one qualifies instead of once per coin.
+    std::map<int, std::pair<CZerocoinEntry, int> > mapCandidates;
     BOOST_FOREACH(const CZerocoinEntry &minIdPubcoin, listPubCoin) {
         if (minIdPubcoin.denomination == denomination
                 && minIdPubcoin.IsUsed == false
@@ -42,44 +35,31 @@ CVaultStake::CVaultStake(list <CZerocoinEntry> &listPubCoin, CValidationState st
                 && minIdPubcoin.serialNumber != 0) {
 
             int id;
-            coinHeight = zerocoinState->GetMintedCoinHeightAndId(minIdPubcoin.value, minIdPubcoin.denomination, id);
-            if (coinHeight > 0
-                    && id < coinId
-                    && coinHeight + (1) <= chainActive.Height()
-                    && zerocoinState->GetAccumulatorValueForSpend(&chainActive,
-                            chainActive.Height()-(1),
-                            minIdPubcoin.denomination,
-                            id,
-                            accumulatorValue,
-                            accumulatorBlockHash) > 1
-                    ) {
-                coinId = id;
-                coinToUse = minIdPubcoin;
-            }
+            int nHeight = zerocoinState->GetMintedCoinHeightAndId(minIdPubcoin.value, minIdPubcoin.denomination, id);
+            if (nHeight > 0 && nHeight + (1) <= chainActive.Height())
+                mapCandidates.insert(std::make_pair(id, std::make_pair(minIdPubcoin, nHeight)));
         }
     }
 
-    BOOST_FOREACH(const CZerocoinEntry &minIdPubcoin, listPubCoin) {
-        if (minIdPubcoin.denomination == denomination
-                && minIdPubcoin.IsUsed == false
-                && minIdPubcoin.randomness != 0
-                && minIdPubcoin.serialNumber != 0) {
+    CZerocoinEntry coinToUse;
 
-            int id;
-            coinHeight = zerocoinState->GetMintedCoinHeightAndId(minIdPubcoin.value, minIdPubcoin.denomination, id);
-            if (coinHeight > 0
-                    && id < coinId
-                    && coinHeight + (1) <= chainActive.Height()
-                    && zerocoinState->GetAccumulatorValueForSpend(&chainActive,
-                            chainActive.Height()-(1),
-                            minIdPubcoin.denomination,
-                            id,
-                            accumulatorValue,
-                            accumulatorBlockHash) > 1
-                    ) {
-                coinId = id;
-                coinToUse = minIdPubcoin;
-            }
+    CBigNum accumulatorValue;
+    uint256 accumulatorBlockHash;
+
+    int coinId = INT_MAX;
+    int coinHeight = 0;
+
+    for (const auto &candidate : mapCandidates) {
+        if (zerocoinState->GetAccumulatorValueForSpend(&chainActive,
+                    chainActive.Height()-(1),
+                    candidate.second.first.denomination,
+                    candidate.first,
+                    accumulatorValue,
+                    accumulatorBlockHash) > 1) {
+            coinId = candidate.first;
+            coinToUse = candidate.second.first;
+            coinHeight = candidate.second.second;
+            break;
         }
     }
 
@@ -25,6 +25,17 @@ uint256 CBlockHeader::GetPoWHash(int nHeight) const
    return thash;
 }
 
+void GetPoWHashes(const CBlockHeader* pheaders, size_t nCount, uint256* phashes)
+{
+    std::vector<char> vInput(80 * nCount);
+    std::vector<char> vOutput(32 * nCount);
+    for (size_t i = 0; i < nCount; i++)
+        memcpy(&vInput[80 * i], BEGIN(pheaders[i].nVersion), 80);
+    lyra2re2_hash_batch(vInput.data(), nCount, vOutput.data());
+    for (size_t i = 0; i < nCount; i++)
+        memcpy(phashes[i].begin(), &vOutput[32 * i], 32);
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
@@ -8,6 +8,7 @@
 
 #include <primitives/transaction.h>
 #include <serialize.h>
+#include <support/allocators/arena.h>
 #include <uint256.h>
 #include "crypto/Lyra2RE/Lyra2RE.h"
 
@@ -72,6 +73,9 @@ public:
     }
 };
 
+/** GetPoWHash of nCount consecutive headers, hashed together as one batch */
+void GetPoWHashes(const CBlockHeader* pheaders, size_t nCount, uint256* phashes);
+
 class CZerocoinTxInfo;
 class CSigmaTxInfo;
 
@@ -158,6 +162,33 @@ public:
     void ZerocoinClean() const;
 };
 
+/**
+ * Deserializes a block as CBlock::SerializationOp does, placing all of its transactions
+ * in one arena instead of one heap allocation each. The arena is freed in one go when
+ * the last of the transactions is released.
+ */
+template <typename Stream>
+void UnserializeBlockInArena(Stream& s, CBlock& block)
+{
+    // Transactions taken up front, to bound what an untrusted count can allocate
+    static const uint64_t MAX_ARENA_TX_HINT = 16384;
+
+    block.SetNull();
+    s >> *(CBlockHeader*)&block;
+
+    uint64_t nTx = ReadCompactSize(s);
+    uint64_t nHint = std::min(nTx, MAX_ARENA_TX_HINT);
+    // The transaction and its shared_ptr control block, with room for alignment
+    auto arena = std::make_shared<CMonotonicArena>(nHint * (sizeof(CTransaction) + 64));
+    arena_allocator<CTransaction> alloc(arena);
+    block.vtx.reserve(nHint);
+    for (uint64_t i = 0; i < nTx; i++)
+        block.vtx.push_back(std::allocate_shared<const CTransaction>(alloc, deserialize, s));
+
+    if (block.IsProofOfStake())
+        s >> block.vchBlockSig;
+}
+
 /** Describes a place in the block chain to another node such that if the
  * other node doesn't have the same branch, it can find a recent common trunk.
  * The further back it is, the further before the fork it may be.
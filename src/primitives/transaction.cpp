@@ -73,6 +73,29 @@ uint256 CMutableTransaction::GetHash() const
     return SerializeHash(*this, SER_GETHASH, SERIALIZE_TRANSACTION_NO_WITNESS);
 }
 
+// Same as hashing a copy of tx with the sigma spend scriptSigs cleared, without making the copy
+template<typename TxType>
+static uint256 SigmaMetaDataHash(const TxType& tx)
+{
+    static const CScript emptyScript;
+    CHashWriter ss(SER_GETHASH, SERIALIZE_TRANSACTION_NO_WITNESS);
+    ss << tx.nVersion;
+    WriteCompactSize(ss, tx.vin.size());
+    for (const CTxIn& txin : tx.vin) {
+        ss << txin.prevout;
+        ss << (txin.scriptSig.IsSigmaSpend() ? emptyScript : txin.scriptSig);
+        ss << txin.nSequence;
+    }
+    ss << tx.vout;
+    ss << tx.nLockTime;
+    return ss.GetHash();
+}
+
+uint256 CMutableTransaction::GetSigmaMetaDataHash() const
+{
+    return SigmaMetaDataHash(*this);
+}
+
 
 std::string CMutableTransaction::ToString() const
 {
@@ -96,6 +119,15 @@ uint256 CTransaction::ComputeHash() const
     return SerializeHash(*this, SER_GETHASH, SERIALIZE_TRANSACTION_NO_WITNESS);
 }
 
+uint256 CTransaction::ComputeSigmaMetaDataHash() const
+{
+    for (const CTxIn& txin : vin) {
+        if (txin.scriptSig.IsSigmaSpend())
+            return SigmaMetaDataHash(*this);
+    }
+    return uint256();
+}
+
 uint256 CTransaction::GetWitnessHash() const
 {
     if (!HasWitness()) {
@@ -105,9 +137,9 @@ uint256 CTransaction::GetWitnessHash() const
 }
 
 /* For backward compatibility, the hash is initialized to 0. TODO: remove the need for this default constructor entirely. */
-CTransaction::CTransaction() : vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nLockTime(0), hash() {}
-CTransaction::CTransaction(const CMutableTransaction &tx) : vin(tx.vin), vout(tx.vout), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash(ComputeHash()) {}
-CTransaction::CTransaction(CMutableTransaction &&tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash(ComputeHash()) {}
+CTransaction::CTransaction() : vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nLockTime(0), hash(), sigmaMetaDataHash() {}
+CTransaction::CTransaction(const CMutableTransaction &tx) : vin(tx.vin), vout(tx.vout), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash(ComputeHash()), sigmaMetaDataHash(ComputeSigmaMetaDataHash()) {}
+CTransaction::CTransaction(CMutableTransaction &&tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash(ComputeHash()), sigmaMetaDataHash(ComputeSigmaMetaDataHash()) {}
 
 CAmount CTransaction::GetValueOut() const
 {
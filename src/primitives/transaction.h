@@ -326,8 +326,10 @@ public:
 private:
     /** Memory only. */
     const uint256 hash;
+    const uint256 sigmaMetaDataHash;
 
     uint256 ComputeHash() const;
+    uint256 ComputeSigmaMetaDataHash() const;
 
 public:
     /** Construct a CTransaction that qualifies as IsNull() */
@@ -358,6 +360,12 @@ public:
     // Compute a hash that includes both transaction and witness data
     uint256 GetWitnessHash() const;
 
+    // Hash of the transaction with the scriptSig of every sigma spend input cleared,
+    // signed by sigma spends as metadata. Null if there are no sigma spend inputs.
+    const uint256& GetSigmaMetaDataHash() const {
+        return sigmaMetaDataHash;
+    }
+
     // Return sum of txouts.
     CAmount GetValueOut() const;
     // GetValueIn() is a method on CCoinsViewCache, because
@@ -377,7 +385,7 @@ public:
 
     bool IsCoinBase() const
     {
-        return (vin.size() == 1 && vin[0].prevout.IsNull() && (vin[0].scriptSig[0] != OP_ZEROCOINSPEND) && (vin[0].scriptSig[0] != OP_SIGMASPEND));
+        return (vin.size() == 1 && vin[0].prevout.IsNull() && (vin[0].scriptSig[0] != OP_ZEROCOINSPEND) && !vin[0].scriptSig.IsSigmaSpend());
     }
 
     bool IsCoinStake() const
@@ -403,7 +411,7 @@ public:
 
     bool IsSigmaSpend() const
     {
-        return (vin.size() >= 1 && vin[0].prevout.hash.IsNull() && vin[0].prevout.n >= 1 && (vin[0].scriptSig[0] == OP_SIGMASPEND));
+        return (vin.size() >= 1 && vin[0].prevout.hash.IsNull() && vin[0].prevout.n >= 1 && vin[0].scriptSig.IsSigmaSpend());
     }
 
     bool IsSigmaMint() const
@@ -485,6 +493,9 @@ struct CMutableTransaction
      */
     uint256 GetHash() const;
 
+    /** Compute the hash sigma spends sign as metadata, see CTransaction::GetSigmaMetaDataHash(). */
+    uint256 GetSigmaMetaDataHash() const;
+
     friend bool operator==(const CMutableTransaction& a, const CMutableTransaction& b)
     {
         return a.GetHash() == b.GetHash();
@@ -39,6 +39,12 @@ const char *SENDCMPCT="sendcmpct";
 const char *CMPCTBLOCK="cmpctblock";
 const char *GETBLOCKTXN="getblocktxn";
 const char *BLOCKTXN="blocktxn";
+const char *GETCFILTERS="getcfilters";
+const char *CFILTER="cfilter";
+const char *GETCFHEADERS="getcfheaders";
+const char *CFHEADERS="cfheaders";
+const char *GETCFCHECKPT="getcfcheckpt";
+const char *CFCHECKPT="cfcheckpt";
 //Ghostnode
 const char *TXLOCKVOTE="txlvote";
 const char *SPORK = "spork";
@@ -59,6 +65,9 @@ const char *DSQUEUE = "dsq";
 const char *DSEG = "dseg";
 const char *SYNCSTATUSCOUNT = "ssc";
 const char *MNVERIFY = "mnv";
+const char *SENDMNBATCH = "sendmnbatch";
+const char *MNANNOUNCEBATCH = "mnbbatch";
+const char *GHOSTNODEPAYMENTBATCH = "mnwbatch";
 const char *ZCACC = "zcacc";
 const char *TXLOCKREQUEST = "ix";
 } // namespace NetMsgType
@@ -113,6 +122,12 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::CMPCTBLOCK,
     NetMsgType::GETBLOCKTXN,
     NetMsgType::BLOCKTXN,
+    NetMsgType::GETCFILTERS,
+    NetMsgType::CFILTER,
+    NetMsgType::GETCFHEADERS,
+    NetMsgType::CFHEADERS,
+    NetMsgType::GETCFCHECKPT,
+    NetMsgType::CFCHECKPT,
     //Ghostnode
     NetMsgType::TXLOCKREQUEST,
     NetMsgType::GHOSTNODEPAYMENTVOTE,
@@ -133,6 +148,9 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::DSEG,
     NetMsgType::SYNCSTATUSCOUNT,
     NetMsgType::MNVERIFY,
+    NetMsgType::SENDMNBATCH,
+    NetMsgType::MNANNOUNCEBATCH,
+    NetMsgType::GHOSTNODEPAYMENTBATCH,
     //Lite Zerocoin
     NetMsgType::ZCACC,
 
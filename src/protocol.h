@@ -237,6 +237,42 @@ extern const char *GETBLOCKTXN;
  * @since protocol version 70014 as described by BIP 152
  */
 extern const char *BLOCKTXN;
+/**
+ * getcfilters requests compact filters of a range of blocks.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by
+ * BIP 157 & 158.
+ */
+extern const char *GETCFILTERS;
+/**
+ * cfilter is a response to a getcfilters request containing a single compact
+ * filter.
+ */
+extern const char *CFILTER;
+/**
+ * getcfheaders requests a compact filter header and the filter hashes for a
+ * range of blocks, which can then be used to reconstruct the filter headers
+ * for those blocks.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by
+ * BIP 157 & 158.
+ */
+extern const char *GETCFHEADERS;
+/**
+ * cfheaders is a response to a getcfheaders request containing a filter header
+ * and a vector of filter hashes for each subsequent block in the requested range.
+ */
+extern const char *CFHEADERS;
+/**
+ * getcfcheckpt requests evenly spaced compact filter headers, enabling
+ * parallelized download and validation of the headers between them.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by
+ * BIP 157 & 158.
+ */
+extern const char *GETCFCHECKPT;
+/**
+ * cfcheckpt is a response to a getcfcheckpt request containing a vector of
+ * evenly spaced filter headers for blocks on the requested chain.
+ */
+extern const char *CFCHECKPT;
 
 //GHOSTNODE
 extern const char *TXLOCKVOTE;
@@ -259,6 +295,19 @@ extern const char *DSFINALTX;
 extern const char *TXLOCKVOTE;
 extern const char *DSTX;
 extern const char *TXLOCKREQUEST;
+/**
+ * Indicates that a node prefers to receive the full ghostnode list and the
+ * payment votes in "mnbbatch"/"mnwbatch" messages rather than one inv per entry.
+ */
+extern const char *SENDMNBATCH;
+/**
+ * Contains a vector of ghostnode broadcasts, sent in reply to "dseg" for the full list.
+ */
+extern const char *MNANNOUNCEBATCH;
+/**
+ * Contains a vector of ghostnode payment votes, sent in reply to "mnget".
+ */
+extern const char *GHOSTNODEPAYMENTBATCH;
 
 //Lite zerocoin
 extern const char *ZCACC;
@@ -288,6 +337,9 @@ enum ServiceFlags : uint64_t {
     // NODE_XTHIN means the node supports Xtreme Thinblocks
     // If this is turned off then the node will not service nor make xthin requests
     NODE_XTHIN = (1 << 4),
+    // NODE_COMPACT_FILTERS means the node will answer requests for the basic compact
+    // block filters. See BIP157 and BIP158 for details on how this is implemented.
+    NODE_COMPACT_FILTERS = (1 << 6),
     // NODE_NETWORK_LIMITED means the same as NODE_NETWORK with the limitation of only
     // serving the last 288 (2 day) blocks
     // See BIP159 for details on how this is implemented.
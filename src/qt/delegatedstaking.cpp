@@ -12,6 +12,7 @@
 
 #include <qt/sendcoinsdialog.h>
 #include <qt/addresstablemodel.h>
+#include <qt/guiconstants.h>
 #include <qt/nixgui.h>
 #include <qt/csvmodelwriter.h>
 #include <qt/editaddressdialog.h>
@@ -31,6 +32,7 @@
 #include <qt/recentrequeststablemodel.h>
 #include <ghost-address/commitmentkey.h>
 #include <core_io.h>
+#include <validation.h>
 
 #include <QIcon>
 #include <QMenu>
@@ -46,12 +48,16 @@
 #include <QPoint>
 #include <QVariant>
 #include <QString>
+#include <QTimer>
 
 DelegatedStaking::DelegatedStaking(const PlatformStyle *platformStyle, QWidget *parent) :
     QWidget(parent),
     ui(new Ui::DelegatedStaking),
     model(0),
-    platformStyle(platformStyle)
+    walletModel(0),
+    platformStyle(platformStyle),
+    fRefreshing(false),
+    fRefreshPending(false)
 {
 
     ui->setupUi(this);
@@ -94,18 +100,33 @@ DelegatedStaking::DelegatedStaking(const PlatformStyle *platformStyle, QWidget *
 
     connect(ui->activeContractsView, SIGNAL(customContextMenuRequested(const QPoint&)), this, SLOT(showContextMenu(const QPoint&)));
 
+    refreshTimer = new QTimer(this);
+    refreshTimer->setSingleShot(true);
+    refreshTimer->setInterval(MODEL_REFRESH_THROTTLE);
+    connect(refreshTimer, SIGNAL(timeout()), this, SLOT(startRefresh()));
 }
 
 DelegatedStaking::~DelegatedStaking() {
+    workerThread.quit();
+    workerThread.wait();
     delete ui;
 }
 
 void DelegatedStaking::setWalletModel(WalletModel *walletmodel) {
-    if (!walletmodel)
+    if (!walletmodel || walletModel)
         return;
 
     this->walletModel = walletmodel;
-    updateContractList();
+
+    qRegisterMetaType<LeaseContractSnapshot>("LeaseContractSnapshot");
+    LeaseContractWorker *worker = new LeaseContractWorker(walletmodel->getWallet());
+    worker->moveToThread(&workerThread);
+    connect(this, SIGNAL(refreshRequested()), worker, SLOT(refresh()));
+    connect(worker, SIGNAL(contractsReady(LeaseContractSnapshot)), this, SLOT(setContractList(LeaseContractSnapshot)));
+    connect(&workerThread, SIGNAL(finished()), worker, SLOT(deleteLater()), Qt::DirectConnection);
+    workerThread.start();
+
+    startRefresh();
 }
 
 void DelegatedStaking::enableFeePayoutCheckBoxChecked(int state){
@@ -453,6 +474,28 @@ void DelegatedStaking::updateContractList() {
     if (!walletModel)
         return;
 
+    if (!refreshTimer->isActive())
+        refreshTimer->start();
+}
+
+void DelegatedStaking::startRefresh() {
+
+    if (fRefreshing) {
+        fRefreshPending = true;
+        return;
+    }
+    fRefreshing = true;
+    Q_EMIT refreshRequested();
+}
+
+void DelegatedStaking::setContractList(LeaseContractSnapshot contracts) {
+
+    fRefreshing = false;
+    if (fRefreshPending) {
+        fRefreshPending = false;
+        updateContractList();
+    }
+
     ui->activeContractsView->clear();
     ui->activeContractsView->setRowCount(0);
     //unlock previous coins
@@ -462,16 +505,42 @@ void DelegatedStaking::updateContractList() {
     }
     activeContractsOutpoints.clear();
     activeContractsAmounts.clear();
-    std::map<QString, std::vector<COutput> > mapCoins;
-    walletModel->listCoins(mapCoins);
 
-    for (const std::pair<QString, std::vector<COutput>>& coins : mapCoins) {
+    int unit = walletModel->getOptionsModel()->getDisplayUnit();
+    for (const LeaseContractEntry& contract : *contracts) {
+        QTableWidgetItem *myAddress = new QTableWidgetItem(contract.ownerAddress);
+        QTableWidgetItem *delegateAddress = new QTableWidgetItem(contract.leaseAddress);
+        QTableWidgetItem *contractFee = new QTableWidgetItem(contract.contractFee);
+        QTableWidgetItem *rewardFeeAddress = new QTableWidgetItem(contract.rewardAddress);
+        QTableWidgetItem *coinAmount = new QTableWidgetItem(BitcoinUnits::format(unit, contract.amount));
+
+        ui->activeContractsView->insertRow(0);
+        ui->activeContractsView->setItem(0, 0, myAddress);
+        ui->activeContractsView->setItem(0, 1, delegateAddress);
+        ui->activeContractsView->setItem(0, 2, contractFee);
+        ui->activeContractsView->setItem(0, 3, rewardFeeAddress);
+        ui->activeContractsView->setItem(0, 4, coinAmount);
+
+        //Lock contracts
+        walletModel->lockCoin(contract.outpoint);
+
+        activeContractsOutpoints.push_back(contract.outpoint);
+        activeContractsAmounts.push_back(contract.amount);
+    }
+}
+
+void LeaseContractWorker::refresh() {
+
+    std::shared_ptr<std::vector<LeaseContractEntry> > contracts = std::make_shared<std::vector<LeaseContractEntry> >();
+
+    LOCK2(cs_main, wallet->cs_wallet);
+    for (const std::pair<CTxDestination, std::vector<COutput>>& coins : wallet->ListCoins()) {
         CAmount nSum = 0;
         for (const COutput& out : coins.second) {
             nSum = out.tx->tx->vout[out.i].nValue;
 
             //skip spent coins
-            if(walletModel->getWallet()->IsSpent(out.tx->tx->vout[out.i].GetHash(), out.i)) continue;
+            if(wallet->IsSpent(out.tx->tx->vout[out.i].GetHash(), out.i)) continue;
 
             // address
             CTxDestination ownerDest;
@@ -493,7 +562,7 @@ void DelegatedStaking::updateContractList() {
                     else
                         hash = boost::get<CScriptID>(ownerDest);
 
-                    if(walletModel->getWallet()->HaveCScript(hash)){
+                    if(wallet->HaveCScript(hash)){
                         GetCoinstakeScriptPath(out.tx->tx->vout[out.i].scriptPubKey, delegateScript);
                         bool hasFee = GetCoinstakeScriptFee(out.tx->tx->vout[out.i].scriptPubKey, feeAmount);
                         GetCoinstakeScriptFeeRewardAddress(out.tx->tx->vout[out.i].scriptPubKey, feeRewardScript);
@@ -521,34 +590,18 @@ void DelegatedStaking::updateContractList() {
                             rewardAddress = EncodeDestination(rewardFeeDest, true);
                         }
 
-                        if(walletModel->getWallet()->mapAddressBook.find(ownerDest) != walletModel->getWallet()->mapAddressBook.end())
-                        {
-                            if(walletModel->getWallet()->mapAddressBook[ownerDest].name != "")
-                                ownerAddrString = walletModel->getWallet()->mapAddressBook[ownerDest].name;
-                        }
-
-                        QTableWidgetItem *myAddress = new QTableWidgetItem(QString::fromStdString(ownerAddrString));
-                        QTableWidgetItem *delegateAddress = new QTableWidgetItem(QString::fromStdString(leaseAddress));
-                        QTableWidgetItem *contractFee = new QTableWidgetItem(QString::fromStdString(std::to_string((double)feeAmount/100.00)));
-                        QTableWidgetItem *rewardFeeAddress = new QTableWidgetItem(QString::fromStdString(rewardAddress));
-                        QTableWidgetItem *coinAmount = new QTableWidgetItem(BitcoinUnits::format(walletModel->getOptionsModel()->getDisplayUnit(), nSum));
-
-                        if(!hasFee)
-                             rewardFeeAddress = new QTableWidgetItem(QString::fromStdString("N/A"));
-
-                        ui->activeContractsView->insertRow(0);
-                        ui->activeContractsView->setItem(0, 0, myAddress);
-                        ui->activeContractsView->setItem(0, 1, delegateAddress);
-                        ui->activeContractsView->setItem(0, 2, contractFee);
-                        ui->activeContractsView->setItem(0, 3, rewardFeeAddress);
-                        ui->activeContractsView->setItem(0, 4, coinAmount);
-
-                        //Lock contracts
-                        COutPoint outpt(out.tx->tx->GetHash(), out.i);
-                        walletModel->lockCoin(outpt);
-
-                        activeContractsOutpoints.push_back(outpt);
-                        activeContractsAmounts.push_back(nSum);
+                        std::map<CTxDestination, CAddressBookData>::const_iterator mi = wallet->mapAddressBook.find(ownerDest);
+                        if(mi != wallet->mapAddressBook.end() && mi->second.name != "")
+                            ownerAddrString = mi->second.name;
+
+                        LeaseContractEntry contract;
+                        contract.ownerAddress = QString::fromStdString(ownerAddrString);
+                        contract.leaseAddress = QString::fromStdString(leaseAddress);
+                        contract.contractFee = QString::fromStdString(std::to_string((double)feeAmount/100.00));
+                        contract.rewardAddress = hasFee ? QString::fromStdString(rewardAddress) : QString("N/A");
+                        contract.amount = nSum;
+                        contract.outpoint = COutPoint(out.tx->tx->GetHash(), out.i);
+                        contracts->push_back(contract);
                     }
 
                 }
@@ -556,6 +609,8 @@ void DelegatedStaking::updateContractList() {
 
         }
     }
+
+    Q_EMIT contractsReady(contracts);
 }
 
 void DelegatedStaking::showContextMenu(const QPoint &point)
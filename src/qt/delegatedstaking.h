@@ -7,14 +7,19 @@
 
 #include <QWidget>
 #include <QTableWidget>
+#include <QThread>
 #include <amount.h>
+#include <primitives/transaction.h>
 #include <qt/walletmodel.h>
 
+#include <memory>
+#include <vector>
+
 class AddressTableModel;
+class CWallet;
 class OptionsModel;
 class PlatformStyle;
 class WalletModel;
-class COutPoint;
 
 namespace Ui {
     class DelegatedStaking;
@@ -26,8 +31,43 @@ class QMenu;
 class QModelIndex;
 class QSortFilterProxyModel;
 class QTableView;
+class QTimer;
 QT_END_NAMESPACE
 
+/** An active leasing contract as shown in the contract list */
+struct LeaseContractEntry
+{
+    QString ownerAddress;
+    QString leaseAddress;
+    QString contractFee;
+    QString rewardAddress;
+    CAmount amount;
+    COutPoint outpoint;
+};
+
+/** Contract list handed from LeaseContractWorker to the page, never modified after it is sent */
+typedef std::shared_ptr<const std::vector<LeaseContractEntry> > LeaseContractSnapshot;
+
+Q_DECLARE_METATYPE(LeaseContractSnapshot)
+
+/** Reads the leasing contracts from the wallet on its own thread */
+class LeaseContractWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LeaseContractWorker(CWallet *_wallet) : wallet(_wallet) {}
+
+public Q_SLOTS:
+    void refresh();
+
+Q_SIGNALS:
+    void contractsReady(LeaseContractSnapshot contracts);
+
+private:
+    CWallet *wallet;
+};
+
 /** Widget that shows a list of sending or receiving addresses.
   */
 class DelegatedStaking : public QWidget
@@ -48,6 +88,7 @@ public:
     const QString &getReturnValue() const { return returnValue; }
     void setVaultBalance(CAmount confirmed, CAmount unconfirmed);
     void setKeyList();
+    /** Schedule a refresh of the contract list, at most one per MODEL_REFRESH_THROTTLE */
     void updateContractList();
 
 private:
@@ -65,6 +106,13 @@ private:
     std::vector <COutPoint> activeContractsOutpoints;
     std::vector <CAmount> activeContractsAmounts;
 
+    QThread workerThread;
+    QTimer *refreshTimer;
+    /** A refresh is running on the worker thread */
+    bool fRefreshing;
+    /** Another refresh was asked for while one was running */
+    bool fRefreshPending;
+
     void processDelegatedCoinsReturn(const WalletModel::SendCoinsReturn &sendCoinsReturn, const QString &msgArg = QString());
 
 private Q_SLOTS:
@@ -79,8 +127,12 @@ private Q_SLOTS:
 
     void showContextMenu(const QPoint &);
 
+    void startRefresh();
+    void setContractList(LeaseContractSnapshot contracts);
+
 Q_SIGNALS:
     void message(const QString &title, const QString &message, unsigned int style);
+    void refreshRequested();
 };
 
 
@@ -65,6 +65,14 @@ GhostNode::GhostNode(const PlatformStyle *platformStyle, QWidget *parent) :
     connect(ui->tableWidgetMyGhostnodes, SIGNAL(customContextMenuRequested(const QPoint&)), this, SLOT(showContextMenu(const QPoint&)));
     connect(startAliasAction, SIGNAL(triggered()), this, SLOT(on_startButton_clicked()));
 
+    qRegisterMetaType<GhostnodeListSnapshot>("GhostnodeListSnapshot");
+    GhostnodeListWorker *worker = new GhostnodeListWorker();
+    worker->moveToThread(&workerThread);
+    connect(this, SIGNAL(nodeListRequested(QString)), worker, SLOT(refresh(QString)));
+    connect(worker, SIGNAL(listReady(GhostnodeListSnapshot)), this, SLOT(setNodeList(GhostnodeListSnapshot)));
+    connect(&workerThread, SIGNAL(finished()), worker, SLOT(deleteLater()), Qt::DirectConnection);
+    workerThread.start();
+
     timer = new QTimer(this);
     connect(timer, SIGNAL(timeout()), this, SLOT(updateNodeList()));
     connect(timer, SIGNAL(timeout()), this, SLOT(updateMyNodeList()));
@@ -72,11 +80,16 @@ GhostNode::GhostNode(const PlatformStyle *platformStyle, QWidget *parent) :
 
     fFilterUpdated = false;
     nTimeFilterUpdated = GetTime();
+    nTimeListUpdated = 0;
+    nListStateVersion = -1;
+    fListRefreshing = false;
     updateNodeList();
 }
 
 GhostNode::~GhostNode()
 {
+    workerThread.quit();
+    workerThread.wait();
     delete ui;
 }
 
@@ -255,8 +268,6 @@ void GhostNode::updateNodeList()
         return;
     }
 
-    static int64_t nTimeListUpdated = GetTime();
-
     // to prevent high cpu usage update only once in MASTERNODELIST_UPDATE_SECONDS seconds
     // or MASTERNODELIST_FILTER_COOLDOWN_SECONDS seconds after filter was last changed
     int64_t nSecondsToWait = fFilterUpdated
@@ -266,52 +277,70 @@ void GhostNode::updateNodeList()
     if(fFilterUpdated) ui->countLabel->setText(QString::fromStdString(strprintf("Please wait... %d", nSecondsToWait)));
     if(nSecondsToWait > 0) return;
 
+    // without a filter change only refresh when the ghostnode states changed,
+    // or every MASTERNODELIST_REFRESH_SECONDS seconds for the ping times
+    int nStateVersion = mnodeman.GetStateVersion();
+    if(!fFilterUpdated && nStateVersion == nListStateVersion &&
+       GetTime() < nTimeListUpdated + MASTERNODELIST_REFRESH_SECONDS) return;
+
+    // the next tick asks again once the running refresh is done
+    if(fListRefreshing) return;
+
     nTimeListUpdated = GetTime();
+    nListStateVersion = nStateVersion;
     fFilterUpdated = false;
+    fListRefreshing = true;
 
-    QString strToFilter;
     ui->countLabel->setText("Updating...");
+    Q_EMIT nodeListRequested(strCurrentFilter);
+}
+
+void GhostNode::setNodeList(GhostnodeListSnapshot rows)
+{
+    LOCK(cs_mnlist);
+    fListRefreshing = false;
+
     ui->tableWidgetGhostnodes->setSortingEnabled(false);
     ui->tableWidgetGhostnodes->clearContents();
-    ui->tableWidgetGhostnodes->setRowCount(0);
-//    std::map<COutPoint, CGhostnode> mapGhostnodes = mnodeman.GetFullGhostnodeMap();
-    std::vector<CGhostnode> vGhostnodes = mnodeman.GetFullGhostnodeVector();
+    ui->tableWidgetGhostnodes->setRowCount(rows->size());
+
+    // newest entries first, as the list used to be filled from the top
+    int nRow = rows->size();
+    for (const QStringList& row : *rows)
+    {
+        nRow--;
+        for (int nColumn = 0; nColumn < row.size(); nColumn++)
+            ui->tableWidgetGhostnodes->setItem(nRow, nColumn, new QTableWidgetItem(row.at(nColumn)));
+    }
+
+    ui->countLabel->setText(QString::number(ui->tableWidgetGhostnodes->rowCount()));
+    ui->tableWidgetGhostnodes->setSortingEnabled(true);
+}
+
+void GhostnodeListWorker::refresh(const QString &strFilter)
+{
+    std::shared_ptr<std::vector<QStringList> > rows = std::make_shared<std::vector<QStringList> >();
+    std::shared_ptr<const std::vector<CGhostnode> > pGhostnodes = mnodeman.GetGhostnodeListSnapshot();
     int offsetFromUtc = GetOffsetFromUtc();
 
-    BOOST_FOREACH(CGhostnode & mn, vGhostnodes)
+    rows->reserve(pGhostnodes->size());
+    for (const CGhostnode& mn : *pGhostnodes)
     {
-//        CGhostnode mn = mnpair.second;
-        // populate list
         // Address, Protocol, Status, Active Seconds, Last Seen, Pub Key
-        QTableWidgetItem *addressItem = new QTableWidgetItem(QString::fromStdString(mn.addr.ToString()));
-        QTableWidgetItem *protocolItem = new QTableWidgetItem(QString::number(mn.nProtocolVersion));
-        QTableWidgetItem *statusItem = new QTableWidgetItem(QString::fromStdString(mn.GetStatus()));
-        QTableWidgetItem *activeSecondsItem = new QTableWidgetItem(QString::fromStdString(DurationToDHMS(mn.lastPing.sigTime - mn.sigTime)));
-        QTableWidgetItem *lastSeenItem = new QTableWidgetItem(QString::fromStdString(DateTimeStrFormat("%Y-%m-%d %H:%M", mn.lastPing.sigTime + offsetFromUtc)));
-        QTableWidgetItem *pubkeyItem = new QTableWidgetItem(QString::fromStdString(CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString()));
-
-        if (strCurrentFilter != "")
-        {
-            strToFilter =   addressItem->text() + " " +
-                            protocolItem->text() + " " +
-                            statusItem->text() + " " +
-                            activeSecondsItem->text() + " " +
-                            lastSeenItem->text() + " " +
-                            pubkeyItem->text();
-            if (!strToFilter.contains(strCurrentFilter)) continue;
-        }
+        QStringList row;
+        row << QString::fromStdString(mn.addr.ToString())
+            << QString::number(mn.nProtocolVersion)
+            << QString::fromStdString(mn.GetStatus())
+            << QString::fromStdString(DurationToDHMS(mn.lastPing.sigTime - mn.sigTime))
+            << QString::fromStdString(DateTimeStrFormat("%Y-%m-%d %H:%M", mn.lastPing.sigTime + offsetFromUtc))
+            << QString::fromStdString(CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString());
+
+        if (!strFilter.isEmpty() && !row.join(" ").contains(strFilter)) continue;
 
-        ui->tableWidgetGhostnodes->insertRow(0);
-        ui->tableWidgetGhostnodes->setItem(0, 0, addressItem);
-        ui->tableWidgetGhostnodes->setItem(0, 1, protocolItem);
-        ui->tableWidgetGhostnodes->setItem(0, 2, statusItem);
-        ui->tableWidgetGhostnodes->setItem(0, 3, activeSecondsItem);
-        ui->tableWidgetGhostnodes->setItem(0, 4, lastSeenItem);
-        ui->tableWidgetGhostnodes->setItem(0, 5, pubkeyItem);
+        rows->push_back(row);
     }
 
-    ui->countLabel->setText(QString::number(ui->tableWidgetGhostnodes->rowCount()));
-    ui->tableWidgetGhostnodes->setSortingEnabled(true);
+    Q_EMIT listReady(rows);
 }
 
 void GhostNode::on_filterLineEdit_textChanged(const QString &strFilterIn)
@@ -7,12 +7,18 @@
 #include "util.h"
 
 #include <QMenu>
+#include <QStringList>
+#include <QThread>
 #include <QTimer>
 #include <QWidget>
 
+#include <memory>
+#include <vector>
+
 #define MY_MASTERNODELIST_UPDATE_SECONDS                 60
 #define MASTERNODELIST_UPDATE_SECONDS                    15
 #define MASTERNODELIST_FILTER_COOLDOWN_SECONDS            3
+#define MASTERNODELIST_REFRESH_SECONDS                   60
 
 namespace Ui {
     class GhostNode;
@@ -25,6 +31,23 @@ QT_BEGIN_NAMESPACE
 class QModelIndex;
 QT_END_NAMESPACE
 
+/** Rows of the ghostnode list handed from GhostnodeListWorker to the page, never modified after they are sent */
+typedef std::shared_ptr<const std::vector<QStringList> > GhostnodeListSnapshot;
+
+Q_DECLARE_METATYPE(GhostnodeListSnapshot)
+
+/** Copies and formats the ghostnode list on its own thread */
+class GhostnodeListWorker : public QObject
+{
+    Q_OBJECT
+
+public Q_SLOTS:
+    void refresh(const QString &strFilter);
+
+Q_SIGNALS:
+    void listReady(GhostnodeListSnapshot rows);
+};
+
 /** Ghostnode Manager page widget */
 class GhostNode : public QWidget
 {
@@ -43,6 +66,11 @@ private:
     QMenu *contextMenu;
     int64_t nTimeFilterUpdated;
     bool fFilterUpdated;
+    int64_t nTimeListUpdated;
+    /** mnodeman state version the list was last requested for */
+    int nListStateVersion;
+    /** A refresh is running on the worker thread */
+    bool fListRefreshing;
 
 public Q_SLOTS:
     void updateMyGhostnodeInfo(QString strAlias, QString strAddr, const COutPoint& outpoint);
@@ -50,9 +78,11 @@ public Q_SLOTS:
     void updateNodeList();
 
 Q_SIGNALS:
+    void nodeListRequested(const QString &strFilter);
 
 private:
     QTimer *timer;
+    QThread workerThread;
     Ui::GhostNode *ui;
     ClientModel *clientModel;
     WalletModel *walletModel;
@@ -73,5 +103,6 @@ private Q_SLOTS:
     void on_startMissingButton_clicked();
     void on_tableWidgetMyGhostnodes_itemSelectionChanged();
     void on_UpdateButton_clicked();
+    void setNodeList(GhostnodeListSnapshot rows);
 };
 #endif // MASTERNODELIST_H
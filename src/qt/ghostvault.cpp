@@ -67,12 +67,11 @@ GhostVault::GhostVault(const PlatformStyle *platformStyle, Mode mode, QWidget *p
 
     ui->convertNIXAmount->clear();
 
+    // The balances are filled in by setVaultBalance() from the wallet model,
+    // rather than by scanning the mints here on the GUI thread
     int unit = BitcoinUnits::BTC;
-    CAmount balance = vpwallets.front()->GetGhostBalance(true);
-    ui->total->setText(tr("Ghosted: ") + (BitcoinUnits::formatWithUnit(unit, balance, false, BitcoinUnits::separatorAlways)));
-
-    CAmount unconfirmedBalance = vpwallets.front()->GetGhostBalanceUnconfirmed(true);
-    ui->unconfirmed_label->setText(tr("Unconfirmed: ") + (BitcoinUnits::formatWithUnit(unit, unconfirmedBalance, false, BitcoinUnits::separatorAlways)));
+    ui->total->setText(tr("Ghosted: ") + (BitcoinUnits::formatWithUnit(unit, 0, false, BitcoinUnits::separatorAlways)));
+    ui->unconfirmed_label->setText(tr("Unconfirmed: ") + (BitcoinUnits::formatWithUnit(unit, 0, false, BitcoinUnits::separatorAlways)));
 
     // Build context menu
     contextMenu = new QMenu(this);
@@ -252,12 +251,7 @@ void GhostVault::on_ghostNIXButton_clicked() {
                                           tr("You have successfully ghosted NIX from your wallet"),
                                           QMessageBox::Ok, QMessageBox::Ok);
 
-            int unit = walletModel->getOptionsModel()->getDisplayUnit();
-            CAmount balance = vpwallets.front()->GetGhostBalance(true);
-            ui->total->setText(tr("Ghosted: ") + (BitcoinUnits::formatWithUnit(unit, balance, false, BitcoinUnits::separatorAlways)));
-
-            CAmount unconfirmedBalance = vpwallets.front()->GetGhostBalanceUnconfirmed(true);
-            ui->unconfirmed_label->setText(tr("Unconfirmed: ") + (BitcoinUnits::formatWithUnit(unit, unconfirmedBalance, false, BitcoinUnits::separatorAlways)));
+            // The new balances arrive through setVaultBalance() once the wallet model sees the transaction
 
 
             ui->convertNIXAmount->clear();
@@ -287,12 +281,6 @@ void GhostVault::on_ghostNIXButton_clicked() {
                                           tr("You have successfully ghosted NIX from your wallet"),
                                           QMessageBox::Ok, QMessageBox::Ok);
 
-            int unit = walletModel->getOptionsModel()->getDisplayUnit();
-            CAmount balance = vpwallets.front()->GetGhostBalance(true);
-            ui->total->setText(tr("Ghosted: ") + (BitcoinUnits::formatWithUnit(unit, balance, false, BitcoinUnits::separatorAlways)));
-
-            CAmount unconfirmedBalance = vpwallets.front()->GetGhostBalanceUnconfirmed(true);
-            ui->unconfirmed_label->setText(tr("Unconfirmed: ") + (BitcoinUnits::formatWithUnit(unit, unconfirmedBalance, false, BitcoinUnits::separatorAlways)));
 
             ui->convertNIXAmount->clear();
             ui->ghostAmount->clear();
@@ -443,12 +431,6 @@ void GhostVault::on_convertGhostButton_clicked() {
                                           QMessageBox::Ok, QMessageBox::Ok);
 
 
-            int unit = walletModel->getOptionsModel()->getDisplayUnit();
-            CAmount balance = vpwallets.front()->GetGhostBalance(true);
-            ui->total->setText(tr("Ghosted: ") + (BitcoinUnits::formatWithUnit(unit, balance, false, BitcoinUnits::separatorAlways)));
-
-            CAmount unconfirmedBalance = vpwallets.front()->GetGhostBalanceUnconfirmed(true);
-            ui->unconfirmed_label->setText(tr("Unconfirmed: ") + (BitcoinUnits::formatWithUnit(unit, unconfirmedBalance, false, BitcoinUnits::separatorAlways)));
         }
 
         ui->convertGhostToThirdPartyAddress->clear();
@@ -26,6 +26,8 @@
 #include <QIcon>
 #include <QList>
 
+#include <limits>
+
 // Amount column is right-aligned it contains numbers
 static int column_alignments[] = {
         Qt::AlignLeft|Qt::AlignVCenter, /* status */
@@ -36,22 +38,8 @@ static int column_alignments[] = {
         Qt::AlignRight|Qt::AlignVCenter /* amount */
     };
 
-// Comparison operator for sort/binary search of model tx list
-struct TxLessThan
-{
-    bool operator()(const TransactionRecord &a, const TransactionRecord &b) const
-    {
-        return a.hash < b.hash;
-    }
-    bool operator()(const TransactionRecord &a, const uint256 &b) const
-    {
-        return a.hash < b;
-    }
-    bool operator()(const uint256 &a, const TransactionRecord &b) const
-    {
-        return a < b.hash;
-    }
-};
+// Number of wallet transactions decomposed per fetchMore()
+static const int TRANSACTION_PAGE_SIZE = 250;
 
 // Private implementation
 class TransactionTablePriv
@@ -59,33 +47,100 @@ class TransactionTablePriv
 public:
     TransactionTablePriv(CWallet *_wallet, TransactionTableModel *_parent) :
         wallet(_wallet),
-        parent(_parent)
+        parent(_parent),
+        nPendingOrderPos(std::numeric_limits<int64_t>::min())
     {
     }
 
     CWallet *wallet;
     TransactionTableModel *parent;
 
-    /* Local cache of wallet.
-     * As it is in the same order as the CWallet, by definition
-     * this is sorted by sha256.
+    /* Local cache of the part of the wallet that has been loaded, in load
+     * order. The records of one transaction are always adjacent.
+     */
+    std::vector<TransactionRecord> cachedWallet;
+
+    /* First row and number of rows of each loaded transaction */
+    std::map<uint256, std::pair<int, int>> mapRows;
+
+    /* Transactions that have not been decomposed yet, oldest first, so
+     * pages are taken from the back.
      */
-    QList<TransactionRecord> cachedWallet;
+    std::vector<uint256> pendingTxs;
+
+    /* Transactions ordered before this position are still pending */
+    int64_t nPendingOrderPos;
 
-    /* Query entire wallet anew from core.
+    /* Query the wallet anew from core. Only the transaction order is read
+     * here, records are decomposed a page at a time by loadPage().
      */
     void refreshWallet()
     {
         qDebug() << "TransactionTablePriv::refreshWallet";
         cachedWallet.clear();
+        mapRows.clear();
+        pendingTxs.clear();
+        {
+            LOCK(wallet->cs_wallet);
+            pendingTxs.reserve(wallet->mapWallet.size());
+            for (const auto& item : wallet->wtxOrdered)
+            {
+                if (item.second.first)
+                    pendingTxs.push_back(item.second.first->GetHash());
+            }
+            nPendingOrderPos = wallet->nOrderPosNext;
+        }
+        loadPage(TRANSACTION_PAGE_SIZE);
+    }
+
+    bool hasPending() const
+    {
+        return !pendingTxs.empty();
+    }
+
+    /* Decompose up to nMaxTxs of the newest pending transactions and
+     * append their records to the model.
+     */
+    void loadPage(int nMaxTxs)
+    {
+        std::vector<TransactionRecord> toInsert;
+        std::vector<std::pair<uint256, int>> vTxRows;
         {
             LOCK2(cs_main, wallet->cs_wallet);
-            for (const auto& entry : wallet->mapWallet)
+            while (!pendingTxs.empty() && nMaxTxs > 0)
             {
-                if (TransactionRecord::showTransaction(entry.second))
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, entry.second));
+                uint256 hash = pendingTxs.back();
+                pendingTxs.pop_back();
+                std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(hash);
+                // Skip transactions removed since the refresh, or already
+                // added by a notification
+                if (mi == wallet->mapWallet.end() || mapRows.count(hash))
+                    continue;
+                nPendingOrderPos = mi->second.nOrderPos;
+                if (!TransactionRecord::showTransaction(mi->second))
+                    continue;
+                QList<TransactionRecord> records = TransactionRecord::decomposeTransaction(wallet, mi->second);
+                if (records.isEmpty())
+                    continue;
+                vTxRows.emplace_back(hash, records.size());
+                toInsert.insert(toInsert.end(), records.begin(), records.end());
+                nMaxTxs--;
             }
+            if (pendingTxs.empty())
+                nPendingOrderPos = std::numeric_limits<int64_t>::min();
+        }
+        if (toInsert.empty())
+            return;
+
+        int nRow = cachedWallet.size();
+        parent->beginInsertRows(QModelIndex(), nRow, nRow + toInsert.size() - 1);
+        for (const std::pair<uint256, int>& txRows : vTxRows)
+        {
+            mapRows[txRows.first] = std::make_pair(nRow, txRows.second);
+            nRow += txRows.second;
         }
+        cachedWallet.insert(cachedWallet.end(), std::make_move_iterator(toInsert.begin()), std::make_move_iterator(toInsert.end()));
+        parent->endInsertRows();
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
@@ -98,13 +153,10 @@ public:
         qDebug() << "TransactionTablePriv::updateWallet: " + QString::fromStdString(hash.ToString()) + " " + QString::number(status);
 
         // Find bounds of this transaction in model
-        QList<TransactionRecord>::iterator lower = qLowerBound(
-            cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
-        QList<TransactionRecord>::iterator upper = qUpperBound(
-            cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
-        int lowerIndex = (lower - cachedWallet.begin());
-        int upperIndex = (upper - cachedWallet.begin());
-        bool inModel = (lower != upper);
+        std::map<uint256, std::pair<int, int>>::iterator rows = mapRows.find(hash);
+        bool inModel = (rows != mapRows.end());
+        int lowerIndex = inModel ? rows->second.first : (int)cachedWallet.size();
+        int upperIndex = inModel ? lowerIndex + rows->second.second : lowerIndex;
 
         if(status == CT_UPDATED)
         {
@@ -136,18 +188,17 @@ public:
                     qWarning() << "TransactionTablePriv::updateWallet: Warning: Got CT_NEW, but transaction is not in wallet";
                     break;
                 }
-                // Added -- insert at the right position
+                // Not loaded yet -- it is decomposed when its page is fetched
+                if(mi->second.nOrderPos < nPendingOrderPos)
+                    break;
+                // Added -- append, the views sort by themselves
                 QList<TransactionRecord> toInsert =
                         TransactionRecord::decomposeTransaction(wallet, mi->second);
                 if(!toInsert.isEmpty()) /* only if something to insert */
                 {
                     parent->beginInsertRows(QModelIndex(), lowerIndex, lowerIndex+toInsert.size()-1);
-                    int insert_idx = lowerIndex;
-                    for (const TransactionRecord &rec : toInsert)
-                    {
-                        cachedWallet.insert(insert_idx, rec);
-                        insert_idx += 1;
-                    }
+                    mapRows[hash] = std::make_pair(lowerIndex, toInsert.size());
+                    cachedWallet.insert(cachedWallet.end(), toInsert.begin(), toInsert.end());
                     parent->endInsertRows();
                 }
             }
@@ -160,16 +211,25 @@ public:
             }
             // Removed -- remove entire transaction from table
             parent->beginRemoveRows(QModelIndex(), lowerIndex, upperIndex-1);
-            cachedWallet.erase(lower, upper);
+            cachedWallet.erase(cachedWallet.begin() + lowerIndex, cachedWallet.begin() + upperIndex);
+            mapRows.erase(rows);
+            for (auto& entry : mapRows)
+            {
+                if (entry.second.first > lowerIndex)
+                    entry.second.first -= upperIndex - lowerIndex;
+            }
             parent->endRemoveRows();
             break;
         case CT_UPDATED:
-            // Miscellaneous updates -- nothing to do, status update will take care of this, and is only computed for
-            // visible transactions.
+            // Miscellaneous updates -- the status update is only computed for visible transactions, but the
+            // rows have to be repainted as confirmations no longer do that for settled transactions.
+            if(!inModel)
+                break;
             for (int i = lowerIndex; i < upperIndex; i++) {
                 TransactionRecord *rec = &cachedWallet[i];
                 rec->status.needsUpdate = true;
             }
+            Q_EMIT parent->dataChanged(parent->index(lowerIndex, TransactionTableModel::Status), parent->index(upperIndex-1, TransactionTableModel::Amount));
             break;
         }
     }
@@ -179,9 +239,27 @@ public:
         return cachedWallet.size();
     }
 
+    /* Ranges of rows whose displayed status can still change with the
+     * number of confirmations.
+     */
+    std::vector<std::pair<int, int>> unsettledRows() const
+    {
+        std::vector<std::pair<int, int>> vRanges;
+        for (int i = 0; i < (int)cachedWallet.size(); i++)
+        {
+            if (cachedWallet[i].status.status == TransactionStatus::Confirmed)
+                continue;
+            if (!vRanges.empty() && vRanges.back().second == i - 1)
+                vRanges.back().second = i;
+            else
+                vRanges.emplace_back(i, i);
+        }
+        return vRanges;
+    }
+
     TransactionRecord *index(int idx)
     {
-        if(idx >= 0 && idx < cachedWallet.size())
+        if(idx >= 0 && idx < (int)cachedWallet.size())
         {
             TransactionRecord *rec = &cachedWallet[idx];
 
@@ -278,10 +356,11 @@ void TransactionTableModel::updateConfirmations()
 {
     // Blocks came in since last poll.
     // Invalidate status (number of confirmations) and (possibly) description
-    //  for all rows. Qt is smart enough to only actually request the data for the
-    //  visible rows.
-    Q_EMIT dataChanged(index(0, Status), index(priv->size()-1, Status));
-    Q_EMIT dataChanged(index(0, ToAddress), index(priv->size()-1, ToAddress));
+    //  for the rows that are not settled yet. A settled row only shows its
+    //  number of confirmations in the tooltip, which is recomputed when
+    //  requested, so the filter proxy does not have to revisit every row.
+    for (const std::pair<int, int>& rows : priv->unsettledRows())
+        Q_EMIT dataChanged(index(rows.first, Status), index(rows.second, ToAddress));
 }
 
 int TransactionTableModel::rowCount(const QModelIndex &parent) const
@@ -290,6 +369,28 @@ int TransactionTableModel::rowCount(const QModelIndex &parent) const
     return priv->size();
 }
 
+bool TransactionTableModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && priv->hasPending();
+}
+
+void TransactionTableModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid())
+        return;
+    // Older history is not news, keep it from raising notifications
+    bool fWasProcessing = fProcessingQueuedTransactions;
+    fProcessingQueuedTransactions = true;
+    priv->loadPage(TRANSACTION_PAGE_SIZE);
+    fProcessingQueuedTransactions = fWasProcessing;
+}
+
+void TransactionTableModel::fetchAll()
+{
+    while (canFetchMore(QModelIndex()))
+        fetchMore(QModelIndex());
+}
+
 int TransactionTableModel::columnCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
@@ -543,7 +644,10 @@ QVariant TransactionTableModel::data(const QModelIndex &index, int role) const
 {
     if(!index.isValid())
         return QVariant();
-    TransactionRecord *rec = static_cast<TransactionRecord*>(index.internalPointer());
+    // Rows are looked up by number, records move when the cache grows
+    TransactionRecord *rec = priv->index(index.row());
+    if(!rec)
+        return QVariant();
 
     switch(role)
     {
@@ -718,7 +822,7 @@ QModelIndex TransactionTableModel::index(int row, int column, const QModelIndex
     TransactionRecord *data = priv->index(row);
     if(data)
     {
-        return createIndex(row, column, priv->index(row));
+        return createIndex(row, column);
     }
     return QModelIndex();
 }
@@ -360,6 +360,9 @@ void TransactionView::exportClicked()
     if (filename.isNull())
         return;
 
+    // The export covers the whole history, not just the pages loaded so far
+    model->getTransactionTableModel()->fetchAll();
+
     CSVModelWriter writer(filename);
 
     // name, column, role
@@ -3,9 +3,13 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <addressindex.h>
+#include <base58.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <core_io.h>
+#include <ghostnode/ghostnodeman.h>
+#include <hash.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <validation.h>
@@ -16,13 +20,26 @@
 #include <sync.h>
 #include <txmempool.h>
 #include <utilstrencodings.h>
+#include <validationinterface.h>
 #include <version.h>
+#include <zerocoin/sigma.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 
 #include <boost/algorithm/string.hpp>
 
 #include <univalue.h>
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const size_t MAX_MEMPOOL_EVENTS = 100000; //mempool events kept for /rest/mempool/events
+static const size_t MAX_MEMPOOL_EVENTS_REPLY = 1000; //events returned at once
+static const int64_t MAX_MEMPOOL_EVENTS_WAIT = 30; //seconds a /rest/mempool/events request may wait for new events
+
+// Defined in rpc/misc.cpp
+bool getAddressFromIndex(const int &type, const uint256 &hash, std::string &address);
+bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint256, int> > &addresses);
 
 enum RetFormat {
     RF_UNDEF,
@@ -121,6 +138,48 @@ static bool CheckWarmup(HTTPRequest* req)
     return true;
 }
 
+/**
+ * Sets the validator of a cacheable reply and answers 304 when the client already holds it.
+ * Shared caches may keep the reply but have to revalidate it on every use.
+ */
+static bool RESTNotModified(HTTPRequest* req, const std::string& strETag)
+{
+    req->WriteHeader("ETag", strETag);
+    req->WriteHeader("Cache-Control", "public, no-cache");
+    std::pair<bool, std::string> ifNoneMatch = req->GetHeader("If-None-Match");
+    if (ifNoneMatch.first && ifNoneMatch.second == strETag) {
+        req->WriteReply(HTTP_NOT_MODIFIED);
+        return true;
+    }
+    return false;
+}
+
+/** Validator of replies that only change with the active chain */
+static std::string TipETag()
+{
+    LOCK(cs_main);
+    return "\"" + chainActive.Tip()->GetBlockHash().GetHex() + "\"";
+}
+
+/** Validator of replies that may change without a new block */
+static std::string ContentETag(const std::string& strContent)
+{
+    return "\"" + Hash(strContent.begin(), strContent.end()).GetHex() + "\"";
+}
+
+/** Sends data serialized in ssData in the binary or hex format */
+static bool RESTWriteSerialized(HTTPRequest* req, enum RetFormat rf, const CDataStream& ssData)
+{
+    if (rf == RF_BINARY) {
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ssData.str());
+    } else {
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, HexStr(ssData.begin(), ssData.end()) + "\n");
+    }
+    return true;
+}
+
 static bool rest_headers(HTTPRequest* req,
                          const std::string& strURIPart)
 {
@@ -223,8 +282,10 @@ static bool rest_block(HTTPRequest* req,
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
+    // Only the binary and hex formats need the serialized block
     CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ssBlock << block;
+    if (rf == RF_BINARY || rf == RF_HEX)
+        ssBlock << block;
 
     switch (rf) {
     case RF_BINARY: {
@@ -242,13 +303,19 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RF_JSON: {
+        req->WriteHeader("Content-Type", "application/json");
+        if (showTxDetails) {
+            // Written into the reply transaction by transaction, full blocks would otherwise be held three times over
+            blockToJSONStream(block, pblockindex, [req](const std::string& part) { req->WriteReplyPart(part); });
+            req->WriteReply(HTTP_OK, "\n");
+            return true;
+        }
         UniValue objBlock;
         {
             LOCK(cs_main);
             objBlock = blockToJSON(block, pblockindex, showTxDetails);
         }
         std::string strJSON = objBlock.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strJSON);
         return true;
     }
@@ -326,11 +393,9 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        std::string strJSON = mempoolObject.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        mempoolToJSONStream([req](const std::string& part) { req->WriteReplyPart(part); });
+        req->WriteReply(HTTP_OK, "\n");
         return true;
     }
     default: {
@@ -339,6 +404,122 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
     }
 }
 
+/** The latest mempool additions and removals, for clients following /rest/mempool/events */
+class CMempoolEventLog : public CValidationInterface
+{
+public:
+    struct Event
+    {
+        uint64_t nSequence;
+        uint256 txid;
+        bool fAdded;
+        MemPoolRemovalReason reason;
+    };
+
+    explicit CMempoolEventLog(uint64_t nSequenceStart) : nNextKept(nSequenceStart + 1), fInterrupted(false) {}
+
+    /**
+     * Copies up to nMax events following nAfter, waiting up to nWait seconds for
+     * one if there are none yet. Returns false when some of them were already
+     * dropped, the client then has to start over from a new snapshot.
+     */
+    bool Get(uint64_t nAfter, size_t nMax, int64_t nWait, std::vector<Event>& vEvents)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (nAfter + 1 < nNextKept)
+            return false;
+        cond.wait_for(lock, std::chrono::seconds(nWait), [&] {
+            return fInterrupted || (!events.empty() && events.back().nSequence > nAfter);
+        });
+        // Sequence numbers have no gaps, so the first event wanted is found by its offset
+        if (events.empty() || events.back().nSequence <= nAfter)
+            return true;
+        size_t nSkip = nAfter + 1 > events.front().nSequence ? nAfter + 1 - events.front().nSequence : 0;
+        for (auto it = events.begin() + nSkip; it != events.end() && vEvents.size() < nMax; ++it)
+            vEvents.push_back(*it);
+        return true;
+    }
+
+    void Interrupt()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        fInterrupted = true;
+        cond.notify_all();
+    }
+
+protected:
+    void MempoolSequence(const CTransactionRef &ptx, bool fAdded, MemPoolRemovalReason reason, uint64_t nSequence) override
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        events.push_back(Event{nSequence, ptx->GetHash(), fAdded, reason});
+        if (events.size() > MAX_MEMPOOL_EVENTS) {
+            events.pop_front();
+            nNextKept = events.front().nSequence;
+        }
+        cond.notify_all();
+    }
+
+private:
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::deque<Event> events;
+    uint64_t nNextKept; //!< oldest sequence number still available
+    bool fInterrupted;
+};
+
+static std::unique_ptr<CMempoolEventLog> mempoolEventLog;
+
+static bool rest_mempool_events(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    int64_t nAfter;
+    int64_t nWait = MAX_MEMPOOL_EVENTS_WAIT;
+    if (path.size() < 1 || path.size() > 2 || !ParseInt64(path[0], &nAfter) || nAfter < 0 ||
+        (path.size() == 2 && (!ParseInt64(path[1], &nWait) || nWait < 0)))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/mempool/events/<sequence>[/<timeout>].json.");
+    if (rf != RF_JSON)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+
+    std::vector<CMempoolEventLog::Event> vEvents;
+    if (!mempoolEventLog->Get(nAfter, MAX_MEMPOOL_EVENTS_REPLY, std::min(nWait, MAX_MEMPOOL_EVENTS_WAIT), vEvents))
+        return RESTERR(req, HTTP_GONE, "Events after " + path[0] + " are no longer available, start over from getrawmempool with mempool_sequence");
+
+    UniValue events(UniValue::VARR);
+    for (const CMempoolEventLog::Event& event : vEvents) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("sequence", event.nSequence));
+        obj.push_back(Pair("txid", event.txid.GetHex()));
+        obj.push_back(Pair("type", event.fAdded ? "added" : "removed"));
+        if (!event.fAdded)
+            obj.push_back(Pair("reason", RemovalReasonToString(event.reason)));
+        events.push_back(obj);
+    }
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("events", events));
+    result.push_back(Pair("mempool_sequence", vEvents.empty() ? (uint64_t)nAfter : vEvents.back().nSequence));
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteReply(HTTP_OK, result.write() + "\n");
+    return true;
+}
+
+static bool rest_perf(HTTPRequest* req, const std::string& strURIPart)
+{
+    // Served without an extension, as Prometheus scrapers expect
+    if (!strURIPart.empty())
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/perf.");
+
+    // Prometheus text exposition format
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, FormatPerfStatsPrometheus());
+    return true;
+}
+
 static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -570,6 +751,229 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     }
 }
 
+static bool rest_address(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2 || (path[0] != "deltas" && path[0] != "utxos"))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/address/deltas/<address>.<ext> or /rest/address/utxos/<address>.<ext>.");
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    if (!fAddressIndex)
+        return RESTERR(req, HTTP_NOT_FOUND, "Address index not enabled");
+
+    std::vector<std::pair<uint256, int> > addresses;
+    try {
+        UniValue params(UniValue::VARR);
+        params.push_back(path[1]);
+        getAddressesFromParams(params, addresses);
+    } catch (const UniValue&) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + path[1]);
+    }
+    const uint256& addressHash = addresses[0].first;
+    const int type = addresses[0].second;
+
+    if (RESTNotModified(req, TipETag()))
+        return true;
+
+    // Every entry of a single address scan carries that address, encode it once
+    std::string address;
+    getAddressFromIndex(type, addressHash, address);
+
+    if (path[0] == "deltas") {
+        if (rf == RF_JSON) {
+            // Written entry by entry, busy addresses have a lot of history
+            req->WriteHeader("Content-Type", "application/json");
+            bool fFirst = true;
+            req->WriteReplyPart("[");
+            bool fScanned = ScanAddressIndex(addressHash, type, [&](const CAddressIndexKey& key, CAmount amount) {
+                UniValue delta(UniValue::VOBJ);
+                delta.push_back(Pair("satoshis", amount));
+                delta.push_back(Pair("txid", key.txhash.GetHex()));
+                delta.push_back(Pair("index", (int)key.index));
+                delta.push_back(Pair("blockindex", (int)key.txindex));
+                delta.push_back(Pair("height", key.blockHeight));
+                delta.push_back(Pair("address", address));
+                req->WriteReplyPart((fFirst ? "" : ",") + delta.write());
+                fFirst = false;
+                return true;
+            });
+            req->WriteReply(fScanned ? HTTP_OK : HTTP_INTERNAL_SERVER_ERROR, "]\n");
+            return fScanned;
+        }
+
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        if (!GetAddressIndex(addressHash, type, addressIndex))
+            return RESTERR(req, HTTP_NOT_FOUND, "No information available for address");
+        CDataStream ssData(SER_NETWORK, PROTOCOL_VERSION);
+        ssData << addressIndex;
+        return RESTWriteSerialized(req, rf, ssData);
+    }
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    if (!GetAddressUnspent(addressHash, type, unspentOutputs))
+        return RESTERR(req, HTTP_NOT_FOUND, "No information available for address");
+
+    if (rf == RF_JSON) {
+        UniValue utxos(UniValue::VARR);
+        for (const auto& utxo : unspentOutputs) {
+            UniValue output(UniValue::VOBJ);
+            output.push_back(Pair("address", address));
+            output.push_back(Pair("txid", utxo.first.txhash.GetHex()));
+            output.push_back(Pair("outputIndex", (int)utxo.first.index));
+            output.push_back(Pair("script", HexStr(utxo.second.script.begin(), utxo.second.script.end())));
+            output.push_back(Pair("satoshis", utxo.second.satoshis));
+            output.push_back(Pair("height", utxo.second.blockHeight));
+            utxos.push_back(output);
+        }
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, utxos.write() + "\n");
+        return true;
+    }
+
+    CDataStream ssData(SER_NETWORK, PROTOCOL_VERSION);
+    ssData << unspentOutputs;
+    return RESTWriteSerialized(req, rf, ssData);
+}
+
+static bool rest_spentinfo(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("-"));
+
+    uint256 txid;
+    int32_t nOutput;
+    if (path.size() != 2 || !ParseHashStr(path[0], txid) || !ParseInt32(path[1], &nOutput) || nOutput < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/spentinfo/<txid>-<n>.<ext>.");
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    CSpentIndexKey key(txid, nOutput);
+    CSpentIndexValue value;
+    if (!GetSpentIndex(key, value))
+        return RESTERR(req, HTTP_NOT_FOUND, "Unable to get spent info");
+
+    // Spends in the mempool are reported too, so the reply is validated by its content
+    CDataStream ssData(SER_NETWORK, PROTOCOL_VERSION);
+    ssData << value;
+    if (RESTNotModified(req, ContentETag(ssData.str())))
+        return true;
+
+    if (rf == RF_JSON) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("txid", value.txid.GetHex()));
+        obj.push_back(Pair("index", (int)value.inputIndex));
+        obj.push_back(Pair("height", value.blockHeight));
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, obj.write() + "\n");
+        return true;
+    }
+    return RESTWriteSerialized(req, rf, ssData);
+}
+
+static bool rest_sigma_group(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("-"));
+
+    sigma::CoinDenomination denomination;
+    int32_t nGroupId;
+    if (path.size() != 2 || !sigma::StringToDenomination(path[0], denomination) || !ParseInt32(path[1], &nGroupId))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/sigma/group/<denomination>-<id>.<ext>.");
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    if (RESTNotModified(req, TipETag()))
+        return true;
+
+    int nCoins;
+    int nFirstHeight, nLastHeight;
+    uint256 hashFirstBlock, hashLastBlock;
+    {
+        // the sigma state locks the denomination itself, cs_main is not needed
+        CSigmaState::CoinGroupInfo group;
+        if (!CSigmaState::GetSigmaState()->GetCoinGroupInfo(denomination, nGroupId, group))
+            return RESTERR(req, HTTP_NOT_FOUND, "Coin group not found");
+        nCoins = group.nCoins;
+        nFirstHeight = group.firstBlock->nHeight;
+        nLastHeight = group.lastBlock->nHeight;
+        hashFirstBlock = group.firstBlock->GetBlockHash();
+        hashLastBlock = group.lastBlock->GetBlockHash();
+    }
+
+    if (rf == RF_JSON) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("denomination", path[0]));
+        obj.push_back(Pair("id", nGroupId));
+        obj.push_back(Pair("coins", nCoins));
+        obj.push_back(Pair("firstheight", nFirstHeight));
+        obj.push_back(Pair("firstblock", hashFirstBlock.GetHex()));
+        obj.push_back(Pair("lastheight", nLastHeight));
+        obj.push_back(Pair("lastblock", hashLastBlock.GetHex()));
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, obj.write() + "\n");
+        return true;
+    }
+
+    CDataStream ssData(SER_NETWORK, PROTOCOL_VERSION);
+    ssData << nCoins << nFirstHeight << hashFirstBlock << nLastHeight << hashLastBlock;
+    return RESTWriteSerialized(req, rf, ssData);
+}
+
+static bool rest_ghostnodes(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (!param.empty())
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/ghostnodes.<ext>.");
+    if (rf == RF_UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    std::shared_ptr<const std::vector<CGhostnode> > pGhostnodes = mnodeman.GetGhostnodeListSnapshot();
+
+    // The list follows the network rather than the chain, so the reply is validated by its content
+    CDataStream ssData(SER_NETWORK, PROTOCOL_VERSION);
+    ssData << *pGhostnodes;
+    if (RESTNotModified(req, ContentETag(ssData.str())))
+        return true;
+
+    if (rf == RF_JSON) {
+        UniValue list(UniValue::VARR);
+        for (const CGhostnode& mn : *pGhostnodes) {
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("outpoint", mn.vin.prevout.ToStringShort()));
+            obj.push_back(Pair("status", mn.GetStatus()));
+            obj.push_back(Pair("protocol", mn.nProtocolVersion));
+            obj.push_back(Pair("payee", CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString()));
+            obj.push_back(Pair("lastseen", (int64_t)mn.lastPing.sigTime));
+            obj.push_back(Pair("activeseconds", (int64_t)(mn.lastPing.sigTime - mn.sigTime)));
+            obj.push_back(Pair("lastpaidtime", mn.GetLastPaidTime()));
+            obj.push_back(Pair("lastpaidblock", mn.GetLastPaidBlock()));
+            obj.push_back(Pair("addr", mn.addr.ToString()));
+            list.push_back(obj);
+        }
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, list.write() + "\n");
+        return true;
+    }
+    return RESTWriteSerialized(req, rf, ssData);
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -580,12 +984,20 @@ static const struct {
       {"/rest/chaininfo", rest_chaininfo},
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
+      {"/rest/mempool/events/", rest_mempool_events},
+      {"/rest/perf", rest_perf},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/address/", rest_address},
+      {"/rest/spentinfo/", rest_spentinfo},
+      {"/rest/sigma/group/", rest_sigma_group},
+      {"/rest/ghostnodes", rest_ghostnodes},
 };
 
 bool StartREST()
 {
+    mempoolEventLog.reset(new CMempoolEventLog(mempool.GetSequence()));
+    RegisterValidationInterface(mempoolEventLog.get());
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
         RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
     return true;
@@ -593,10 +1005,16 @@ bool StartREST()
 
 void InterruptREST()
 {
+    if (mempoolEventLog)
+        mempoolEventLog->Interrupt();
 }
 
 void StopREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
         UnregisterHTTPHandler(uri_prefixes[i].prefix, false);
+    if (mempoolEventLog) {
+        UnregisterValidationInterface(mempoolEventLog.get());
+        mempoolEventLog.reset();
+    }
 }
@@ -6,6 +6,7 @@
 #include <rpc/blockchain.h>
 
 #include <amount.h>
+#include <blockfilterindex.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -24,6 +25,7 @@
 #include <util.h>
 #include <utilstrencodings.h>
 #include <hash.h>
+#include <perf.h>
 #include <validationinterface.h>
 #include <warnings.h>
 
@@ -158,6 +160,34 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     return result;
 }
 
+void blockToJSONStream(const CBlock& block, const CBlockIndex* blockindex, const JSONStreamWriter& write)
+{
+    UniValue header;
+    {
+        LOCK(cs_main);
+        header = blockToJSON(block, blockindex, false);
+    }
+
+    // Same keys in the same order, only the transactions are converted and written one by one
+    const std::vector<std::string>& keys = header.getKeys();
+    const std::vector<UniValue>& values = header.getValues();
+    for (size_t i = 0; i < keys.size(); i++) {
+        write((i == 0 ? "{" : ",") + UniValue(keys[i]).write() + ":");
+        if (keys[i] != "tx") {
+            write(values[i].write());
+            continue;
+        }
+        write("[");
+        for (size_t n = 0; n < block.vtx.size(); n++) {
+            UniValue objTx(UniValue::VOBJ);
+            TxToUniv(*block.vtx[n], uint256(), objTx, true, RPCSerializationFlags());
+            write((n == 0 ? "" : ",") + objTx.write());
+        }
+        write("]");
+    }
+    write(keys.empty() ? "{}" : "}");
+}
+
 UniValue getblockcount(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -436,15 +466,31 @@ UniValue mempoolToJSON(bool fVerbose)
     }
 }
 
+void mempoolToJSONStream(const JSONStreamWriter& write)
+{
+    LOCK(mempool.cs);
+    bool fFirst = true;
+    write("{");
+    for (const CTxMemPoolEntry& e : mempool.mapTx)
+    {
+        UniValue info(UniValue::VOBJ);
+        entryToJSON(info, e);
+        write((fFirst ? "" : ",") + UniValue(e.GetTx().GetHash().ToString()).write() + ":" + info.write());
+        fFirst = false;
+    }
+    write("}");
+}
+
 UniValue getrawmempool(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() > 1)
+    if (request.fHelp || request.params.size() > 2)
         throw std::runtime_error(
-            "getrawmempool ( verbose )\n"
+            "getrawmempool ( verbose mempool_sequence )\n"
             "\nReturns all transaction ids in memory pool as a json array of string transaction ids.\n"
             "\nHint: use getmempoolentry to fetch a specific transaction from the mempool.\n"
             "\nArguments:\n"
             "1. verbose (boolean, optional, default=false) True for a json object, false for array of transaction ids\n"
+            "2. mempool_sequence (boolean, optional, default=false) If verbose=false, returns a json object with transaction list and mempool sequence number attached.\n"
             "\nResult: (for verbose = false):\n"
             "[                     (json array of string)\n"
             "  \"transactionid\"     (string) The transaction id\n"
@@ -456,6 +502,11 @@ UniValue getrawmempool(const JSONRPCRequest& request)
             + EntryDescriptionString()
             + "  }, ...\n"
             "}\n"
+            "\nResult: (for verbose = false and mempool_sequence = true):\n"
+            "{                            (json object)\n"
+            "  \"txids\" : [ \"transactionid\", ... ],\n"
+            "  \"mempool_sequence\" : n   (numeric) Sequence number of the last change included, to follow with /rest/mempool/events or -zmqpubmempoolseq\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getrawmempool", "true")
             + HelpExampleRpc("getrawmempool", "true")
@@ -465,6 +516,20 @@ UniValue getrawmempool(const JSONRPCRequest& request)
     if (!request.params[0].isNull())
         fVerbose = request.params[0].get_bool();
 
+    bool fSequence = false;
+    if (!request.params[1].isNull())
+        fSequence = request.params[1].get_bool();
+
+    if (fSequence) {
+        if (fVerbose)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Verbose results cannot contain mempool sequence values.");
+        LOCK(mempool.cs);
+        UniValue o(UniValue::VOBJ);
+        o.push_back(Pair("txids", mempoolToJSON(false)));
+        o.push_back(Pair("mempool_sequence", mempool.GetSequence()));
+        return o;
+    }
+
     return mempoolToJSON(fVerbose);
 }
 
@@ -631,32 +696,191 @@ UniValue getmempoolentry(const JSONRPCRequest& request)
 
 UniValue getblockhashes(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() < 2)
+    if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
         throw runtime_error(
-                "getblockhashes timestamp\n"
+                "getblockhashes high low ( options )\n"
                         "\nReturns array of hashes of blocks within the timestamp range provided.\n"
                         "\nArguments:\n"
                         "1. high         (numeric, required) The newer block timestamp\n"
                         "2. low          (numeric, required) The older block timestamp\n"
+                        "3. options      (object, optional)\n"
+                        "   {\n"
+                        "     \"limit\": n           (numeric, optional, default=0) Return at most n blocks, 0 for all\n"
+                        "     \"reverse\": bool      (boolean, optional, default=false) Start from the newest block\n"
+                        "     \"noOrphans\": bool    (boolean, optional, default=false) Leave out blocks not in the main chain\n"
+                        "     \"logicalTimes\": bool (boolean, optional, default=false) Include the logical timestamps\n"
+                        "     \"headers\": bool      (boolean, optional, default=false) Include the block headers, as getblockheader\n"
+                        "   }\n"
                         "\nResult:\n"
                         "[\n"
                         "  \"hash\"         (string) The block hash\n"
                         "]\n"
+                        "\nResult (with logicalTimes or headers):\n"
+                        "[\n"
+                        "  {\n"
+                        "    \"blockhash\": \"hash\",  (string) The block hash\n"
+                        "    \"logicalts\": n,       (numeric) The logical timestamp, with logicalTimes\n"
+                        "    \"header\": {...}       (object) The block header, with headers\n"
+                        "  }\n"
+                        "]\n"
                         "\nExamples:\n"
                 + HelpExampleCli("getblockhashes", "1231614698 1231024505")
+                + HelpExampleCli("getblockhashes", "1231614698 0 '{\"limit\":10, \"reverse\":true, \"headers\":true}'")
                 + HelpExampleRpc("getblockhashes", "1231614698, 1231024505")
         );
 
     unsigned int high = request.params[0].get_int();
     unsigned int low = request.params[1].get_int();
-    std::vector<uint256> blockHashes;
-    if (!GetTimestampIndex(high, low, blockHashes)) {
+
+    size_t nLimit = 0;
+    bool fReverse = false, fNoOrphans = false, fLogicalTimes = false, fHeaders = false;
+    if (!request.params[2].isNull()) {
+        const UniValue& options = request.params[2].get_obj();
+        RPCTypeCheckObj(options,
+            {
+                {"limit", UniValueType(UniValue::VNUM)},
+                {"reverse", UniValueType(UniValue::VBOOL)},
+                {"noOrphans", UniValueType(UniValue::VBOOL)},
+                {"logicalTimes", UniValueType(UniValue::VBOOL)},
+                {"headers", UniValueType(UniValue::VBOOL)},
+            }, true, true);
+        if (options.exists("limit")) {
+            int limit = options["limit"].get_int();
+            if (limit < 0)
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative limit");
+            nLimit = limit;
+        }
+        if (options.exists("reverse"))
+            fReverse = options["reverse"].get_bool();
+        if (options.exists("noOrphans"))
+            fNoOrphans = options["noOrphans"].get_bool();
+        if (options.exists("logicalTimes"))
+            fLogicalTimes = options["logicalTimes"].get_bool();
+        if (options.exists("headers"))
+            fHeaders = options["headers"].get_bool();
+    }
+
+    // the main chain and the headers need cs_main while scanning
+    CCriticalBlock lock(fNoOrphans || fHeaders ? &cs_main : nullptr, "cs_main", __FILE__, __LINE__);
+
+    UniValue result(UniValue::VARR);
+    bool fScanned = ScanTimestampIndex(high, low, fReverse, [&](const CTimestampIndexKey& key) {
+        const CBlockIndex* pindex = nullptr;
+        if (fNoOrphans || fHeaders) {
+            BlockMap::const_iterator mi = mapBlockIndex.find(key.blockHash);
+            if (mi != mapBlockIndex.end())
+                pindex = mi->second;
+            if (fNoOrphans && (!pindex || !chainActive.Contains(pindex)))
+                return true;
+        }
+
+        if (!fLogicalTimes && !fHeaders) {
+            result.push_back(key.blockHash.GetHex());
+        } else {
+            UniValue entry(UniValue::VOBJ);
+            entry.pushKV("blockhash", key.blockHash.GetHex());
+            if (fLogicalTimes) {
+                unsigned int logicalTS;
+                if (!GetTimestampBlockIndex(key.blockHash, logicalTS))
+                    logicalTS = key.timestamp;
+                entry.pushKV("logicalts", (int64_t)logicalTS);
+            }
+            if (fHeaders && pindex)
+                entry.pushKV("header", blockheaderToJSON(pindex));
+            result.push_back(entry);
+        }
+        return nLimit == 0 || result.size() < nLimit;
+    });
+    if (!fScanned) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for block hashes");
     }
 
+    return result;
+}
+
+//! Maximum number of blocks getghostmints returns per call
+static const int MAX_GHOST_MINTS_RANGE = 2000;
+
+UniValue getghostmints(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "getghostmints start_height ( end_height )\n"
+            "\nReturns the ghost (zerocoin and sigma) mint public coins of the main chain blocks in a height range,\n"
+            "so a wallet can match them against its own commitment keys without downloading the blocks.\n"
+            "Blocks without mints are left out. At most " + std::to_string(MAX_GHOST_MINTS_RANGE) + " blocks are returned per call.\n"
+            "\nArguments:\n"
+            "1. start_height    (numeric, required) The first block height\n"
+            "2. end_height      (numeric, optional) The last block height (default: start_height + " + std::to_string(MAX_GHOST_MINTS_RANGE - 1) + " or the tip)\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"height\" : n,          (numeric) The block height\n"
+            "    \"hash\" : \"hash\",       (string) The block hash\n"
+            "    \"mints\" : [            (array) Zerocoin mints\n"
+            "      { \"denomination\" : n, \"id\" : n, \"pubcoin\" : \"hex\" }, ...\n"
+            "    ],\n"
+            "    \"sigmamints\" : [       (array) Sigma mints\n"
+            "      { \"denomination\" : x.xxx, \"id\" : n, \"pubcoin\" : \"hex\" }, ...\n"
+            "    ]\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getghostmints", "1000 1999")
+            + HelpExampleRpc("getghostmints", "1000, 1999")
+        );
+
+    LOCK(cs_main);
+
+    int nStart = request.params[0].get_int();
+    if (nStart < 0 || nStart > chainActive.Height())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+    int nEnd = std::min(nStart + MAX_GHOST_MINTS_RANGE - 1, chainActive.Height());
+    if (!request.params[1].isNull()) {
+        nEnd = request.params[1].get_int();
+        if (nEnd < nStart || nEnd > chainActive.Height())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "end_height out of range");
+        if (nEnd - nStart >= MAX_GHOST_MINTS_RANGE)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Range is limited to %d blocks", MAX_GHOST_MINTS_RANGE));
+    }
+
     UniValue result(UniValue::VARR);
-    for (std::vector<uint256>::const_iterator it=blockHashes.begin(); it!=blockHashes.end(); it++) {
-        result.push_back(it->GetHex());
+    for (int nHeight = nStart; nHeight <= nEnd; ++nHeight) {
+        const CBlockIndex* pindex = chainActive[nHeight];
+        std::shared_ptr<const CPrivacyBlockData> blockData = pprivacyindex->ReadBlock(pindex);
+        if (blockData->mintedPubCoins.empty() && blockData->mintedPubCoinsV2.empty())
+            continue;
+
+        UniValue mints(UniValue::VARR);
+        for (const auto& group : blockData->mintedPubCoins) {
+            for (const CBigNum& pubCoin : group.second) {
+                UniValue mint(UniValue::VOBJ);
+                mint.push_back(Pair("denomination", group.first.first));
+                mint.push_back(Pair("id", group.first.second));
+                mint.push_back(Pair("pubcoin", pubCoin.GetHex()));
+                mints.push_back(mint);
+            }
+        }
+
+        UniValue sigmaMints(UniValue::VARR);
+        for (const auto& group : blockData->mintedPubCoinsV2) {
+            int64_t nDenom = 0;
+            sigma::DenominationToInteger(group.first.first, nDenom);
+            for (const sigma::PublicCoin& pubCoin : group.second) {
+                UniValue mint(UniValue::VOBJ);
+                mint.push_back(Pair("denomination", ValueFromAmount(nDenom)));
+                mint.push_back(Pair("id", group.first.second));
+                mint.push_back(Pair("pubcoin", pubCoin.getValue().GetHex()));
+                sigmaMints.push_back(mint);
+            }
+        }
+
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("height", nHeight));
+        entry.push_back(Pair("hash", pindex->GetBlockHash().GetHex()));
+        entry.push_back(Pair("mints", mints));
+        entry.push_back(Pair("sigmamints", sigmaMints));
+        result.push_back(entry);
     }
 
     return result;
@@ -746,6 +970,60 @@ UniValue getblockheader(const JSONRPCRequest& request)
     return blockheaderToJSON(pblockindex);
 }
 
+UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "getblockfilter \"blockhash\" ( \"filtertype\" )\n"
+            "\nReturns the BIP158 compact filter of a block, requires -blockfilterindex.\n"
+            "Besides the scripts of the outputs created and spent, the basic filter has the hash of\n"
+            "the public coin of each sigma mint and of the serial of each sigma spend, as well as\n"
+            "the staking and spending scripts of conditional stake outputs.\n"
+            "\nArguments:\n"
+            "1. \"blockhash\"        (string, required) The hash of the block\n"
+            "2. \"filtertype\"       (string, optional, default=basic) The type name of the filter\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"hex\",   (string) the hex-encoded filter data\n"
+            "  \"header\" : \"hex\"    (string) the hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+        );
+
+    uint256 hash = ParseHashV(request.params[0], "blockhash");
+    BlockFilterType filterType = BlockFilterType::BASIC;
+    if (!request.params[1].isNull() && !BlockFilterTypeByName(request.params[1].get_str(), filterType))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+
+    if (!pblockfilterindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + BlockFilterTypeName(filterType));
+
+    const CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hash);
+        if (it == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pindex = it->second;
+    }
+
+    BlockFilter filter;
+    uint256 header;
+    if (!pblockfilterindex->LookupFilter(pindex, filter) || !pblockfilterindex->LookupFilterHeader(pindex, header)) {
+        const CBlockIndex* pindexBest = pblockfilterindex->GetBestBlock();
+        if (!pindexBest || pindexBest->nHeight < pindex->nHeight)
+            throw JSONRPCError(RPC_MISC_ERROR, "Filter not found, the index is still being built");
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Filter not found, the block was never connected");
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("filter", HexStr(filter.GetEncodedFilter())));
+    ret.push_back(Pair("header", header.GetHex()));
+    return ret;
+}
+
 UniValue getblock(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
@@ -999,6 +1277,87 @@ UniValue gettxoutsetinfo(const JSONRPCRequest& request)
     return ret;
 }
 
+static UniValue SnapshotInfoToJSON(const fs::path& path, const SnapshotInfo& info)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("path", path.string()));
+    ret.push_back(Pair("base_hash", info.hashBlock.GetHex()));
+    ret.push_back(Pair("base_height", info.nHeight));
+    ret.push_back(Pair("coins", info.nCoins));
+    ret.push_back(Pair("snapshot_hash", info.hashSnapshot.GetHex()));
+    ret.push_back(Pair("nchaintx", (uint64_t)info.nChainTx));
+    return ret;
+}
+
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the unspent transaction output set, the zerocoin and sigma states and the ghost fee\n"
+            "distribution cycle at the chain tip to a snapshot new nodes can start from with loadtxoutset.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) Path of the snapshot, relative to the data directory. It must not exist yet\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"path\": \"path\",           (string) Absolute path of the snapshot\n"
+            "  \"base_hash\": \"hash\",      (string) The block the snapshot was taken at\n"
+            "  \"base_height\": n,         (numeric) The height of the block\n"
+            "  \"coins\": n,               (numeric) The number of unspent outputs in the snapshot\n"
+            "  \"snapshot_hash\": \"hash\",  (string) The hash to commit for the block in the chain parameters\n"
+            "  \"nchaintx\": n             (numeric) The number of transactions up to and including the block\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    if (fs::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+
+    SnapshotInfo info;
+    std::string strError;
+    if (!DumpUTXOSnapshot(path, info, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    return SnapshotInfoToJSON(path, info);
+}
+
+UniValue loadtxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nMakes a snapshot written by dumptxoutset the chainstate of a node without blocks past the genesis block.\n"
+            "The hash of the snapshot must be committed for its block in the chain parameters, and the headers up to\n"
+            "the block must be known. The node continues from the block, the blocks below it are not downloaded.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) Path of the snapshot, relative to the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"path\": \"path\",           (string) Absolute path of the snapshot\n"
+            "  \"base_hash\": \"hash\",      (string) The block the chainstate is at now\n"
+            "  \"base_height\": n,         (numeric) The height of the block\n"
+            "  \"coins\": n,               (numeric) The number of unspent outputs loaded\n"
+            "  \"snapshot_hash\": \"hash\",  (string) The hash of the snapshot\n"
+            "  \"nchaintx\": n             (numeric) The number of transactions up to and including the block\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("loadtxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("loadtxoutset", "\"utxo.dat\"")
+        );
+
+    fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+
+    SnapshotInfo info;
+    std::string strError;
+    if (!LoadUTXOSnapshot(path, info, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    return SnapshotInfoToJSON(path, info);
+}
+
 UniValue gettxout(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
@@ -1548,6 +1907,103 @@ UniValue reconsiderblock(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+/** Count and total time of the ConnectBlock and DisconnectTip phase timers */
+static std::map<std::string, std::pair<uint64_t, uint64_t>> GetBlockPhaseTimes()
+{
+    std::map<std::string, std::pair<uint64_t, uint64_t>> mapTimes;
+    for (const CPerfTimer* timer : GetPerfTimers()) {
+        std::string strName = timer->GetName();
+        if (strName.compare(0, 13, "connectblock.") != 0 && strName.compare(0, 16, "disconnectblock.") != 0)
+            continue;
+        CPerfHistogram::Snapshot snapshot = timer->Get();
+        mapTimes[strName] = std::make_pair(snapshot.nCount, snapshot.nSumMicros);
+    }
+    return mapTimes;
+}
+
+UniValue replayblocks(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "replayblocks nblocks\n"
+            "\nDisconnects the last nblocks blocks of the active chain and connects them again,\n"
+            "timing both directions and each phase of the blocks' validation.\n"
+            "The node keeps running meanwhile, so this is best done on a node used for measuring only.\n"
+            "\nArguments:\n"
+            "1. nblocks        (numeric, required) The number of blocks to replay\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"blocks\": n,              (numeric) The number of blocks replayed\n"
+            "  \"disconnect_ms\": n,       (numeric) Time spent disconnecting them\n"
+            "  \"connect_ms\": n,          (numeric) Time spent connecting them again\n"
+            "  \"phases\": {               (json object) Time spent per phase while replaying\n"
+            "    \"name\": {\n"
+            "      \"count\": n,           (numeric) Times the phase ran\n"
+            "      \"total_ms\": n         (numeric) Total time spent in it\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("replayblocks", "100")
+            + HelpExampleRpc("replayblocks", "100")
+        );
+
+    int nBlocks = request.params[0].get_int();
+    if (nBlocks < 1)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid number of blocks");
+
+    CValidationState state;
+    CBlockIndex* pindexTip;
+    int64_t nDisconnectMicros;
+    std::map<std::string, std::pair<uint64_t, uint64_t>> mapBefore = GetBlockPhaseTimes();
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+        if (nBlocks >= pindexTip->nHeight)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Block count exceeds the chain height");
+        CBlockIndex* pindexTarget = pindexTip->GetAncestor(pindexTip->nHeight - nBlocks);
+        for (CBlockIndex* pindex = pindexTip; pindex != pindexTarget; pindex = pindex->pprev) {
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA) || pindex == pindexSnapshotBlock)
+                throw JSONRPCError(RPC_MISC_ERROR, strprintf("Block %d can't be disconnected", pindex->nHeight));
+        }
+
+        int64_t nStart = PerfTimeMicros();
+        DisconnectBlocksTo(state, Params(), pindexTarget);
+        nDisconnectMicros = PerfTimeMicros() - nStart;
+    }
+
+    int64_t nStart = PerfTimeMicros();
+    if (state.IsValid())
+        ActivateBestChain(state, Params());
+    int64_t nConnectMicros = PerfTimeMicros() - nStart;
+
+    if (!state.IsValid())
+        throw JSONRPCError(RPC_DATABASE_ERROR, state.GetRejectReason());
+
+    UniValue phases(UniValue::VOBJ);
+    for (const auto& after : GetBlockPhaseTimes()) {
+        const std::pair<uint64_t, uint64_t>& before = mapBefore[after.first];
+        if (after.second.first == before.first)
+            continue;
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("count", after.second.first - before.first));
+        obj.push_back(Pair("total_ms", (after.second.second - before.second) / 1000.0));
+        phases.push_back(Pair(after.first, obj));
+    }
+
+    UniValue result(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        if (!chainActive.Contains(pindexTip))
+            throw JSONRPCError(RPC_MISC_ERROR, "The replayed blocks are not all connected again");
+    }
+    result.push_back(Pair("blocks", nBlocks));
+    result.push_back(Pair("disconnect_ms", nDisconnectMicros / 1000.0));
+    result.push_back(Pair("connect_ms", nConnectMicros / 1000.0));
+    result.push_back(Pair("phases", phases));
+    return result;
+}
+
 UniValue getchaintxstats(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 2)
@@ -1654,18 +2110,22 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getbestblockhash",       &getbestblockhash,       {} },
     { "blockchain",         "getblockcount",          &getblockcount,          {} },
     { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"} },
-    { "blockchain",         "getblockhashes",         &getblockhashes,         {"high","low"}  },
+    { "blockchain",         "getblockhashes",         &getblockhashes,         {"high","low","options"}  },
     { "blockchain",         "getblockhash",           &getblockhash,           {"height"} },
+    { "blockchain",         "getghostmints",          &getghostmints,          {"start_height","end_height"} },
     { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash","filtertype"} },
     { "blockchain",         "getchaintips",           &getchaintips,           {} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          {} },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    {"txid","verbose"} },
     { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  {"txid","verbose"} },
     { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"} },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose", "mempool_sequence"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"} },
+    { "blockchain",         "loadtxoutset",           &loadtxoutset,           {"path"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
@@ -1675,6 +2135,7 @@ static const CRPCCommand commands[] =
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        {"blockhash"} },
     { "hidden",             "reconsiderblock",        &reconsiderblock,        {"blockhash"} },
+    { "hidden",             "replayblocks",           &replayblocks,           {"nblocks"} },
     { "hidden",             "waitfornewblock",        &waitfornewblock,        {"timeout"} },
     { "hidden",             "waitforblock",           &waitforblock,           {"blockhash","timeout"} },
     { "hidden",             "waitforblockheight",     &waitforblockheight,     {"height","timeout"} },
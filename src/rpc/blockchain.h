@@ -5,10 +5,16 @@
 #ifndef BITCOIN_RPC_BLOCKCHAIN_H
 #define BITCOIN_RPC_BLOCKCHAIN_H
 
+#include <functional>
+#include <string>
+
 class CBlock;
 class CBlockIndex;
 class UniValue;
 
+/** Receives JSON text piece by piece from the streaming writers below */
+typedef std::function<void(const std::string&)> JSONStreamWriter;
+
 /**
  * Get the difficulty of the net wrt to the given block index, or the chain tip if
  * not provided.
@@ -24,12 +30,18 @@ void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 /** Block description to JSON */
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
 
+/** Writes blockToJSON(block, blockindex, true) one transaction at a time, takes cs_main itself */
+void blockToJSONStream(const CBlock& block, const CBlockIndex* blockindex, const JSONStreamWriter& write);
+
 /** Mempool information to JSON */
 UniValue mempoolInfoToJSON();
 
 /** Mempool to JSON */
 UniValue mempoolToJSON(bool fVerbose = false);
 
+/** Writes mempoolToJSON(true) one entry at a time */
+void mempoolToJSONStream(const JSONStreamWriter& write);
+
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
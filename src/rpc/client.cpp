@@ -49,10 +49,14 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getbalance", 1, "minconf" },
     { "getbalance", 2, "include_watchonly" },
     { "getblockhash", 0, "height" },
+    { "getghostmints", 0, "start_height" },
+    { "getghostmints", 1, "end_height" },
     { "waitforblockheight", 0, "height" },
     { "waitforblockheight", 1, "timeout" },
     { "waitforblock", 1, "timeout" },
     { "waitfornewblock", 0, "timeout" },
+    { "waitforghostnodestatus", 1, "timeout" },
+    { "waitforstakingstatus", 1, "timeout" },
     { "move", 2, "amount" },
     { "move", 3, "minconf" },
     { "sendfrom", 2, "amount" },
@@ -60,6 +64,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "listtransactions", 1, "count" },
     { "listtransactions", 2, "skip" },
     { "listtransactions", 3, "include_watchonly" },
+    { "listtransactions", 4, "before" },
     { "listaccounts", 0, "minconf" },
     { "listaccounts", 1, "include_watchonly" },
     { "walletpassphrase", 1, "timeout" },
@@ -113,10 +118,13 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "verifychain", 0, "checklevel" },
     { "verifychain", 1, "nblocks" },
     { "pruneblockchain", 0, "height" },
+    { "replayblocks", 0, "nblocks" },
     { "keypoolrefill", 0, "newsize" },
     { "getrawmempool", 0, "verbose" },
+    { "getrawmempool", 1, "mempool_sequence" },
     { "estimatefee", 0, "nblocks" },
     { "estimatesmartfee", 0, "conf_target" },
+    { "estimatesmartfee", 2, "privacy" },
     { "estimaterawfee", 0, "conf_target" },
     { "estimaterawfee", 1, "threshold" },
     { "prioritisetransaction", 1, "dummy" },
@@ -129,11 +137,13 @@ static const CRPCConvertParam vRPCConvertParams[] =
     //insight
     { "getblockhashes", 0 },
     { "getblockhashes", 1 },
+    { "getblockhashes", 2 },
     { "getspentinfo", 0},
     { "getaddresstxids", 0},
     { "getaddressbalance", 0},
     { "getaddressdeltas", 0},
     { "getaddressutxos", 0},
+    { "getdelegatedutxos", 0},
     { "getaddressmempool", 0},
     //
     { "bumpfee", 1, "options" },
@@ -160,6 +170,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "setmininput", 0 , "amount"},
     { "ghostamount", 0 , "amount"},
     { "unghostamount", 0 , "amount"},
+    { "getspendjob", 0, "jobid"},
+    { "cancelspendjob", 0, "jobid"},
     { "setgenerate", 0 , "bool"},
     { "setgenerate", 1 , "bool"},
     { "setghostednixstatus", 2 ,""},
@@ -190,9 +202,12 @@ static const CRPCConvertParam vRPCConvertParams[] =
     {"payunloadedpubcoins", 0, "amount"},
     {"refillghostkeys", 0, "amount"},
     {"listghostednix", 0, "all"},
+    {"listghostednixv2", 0, "all"},
+    {"listghostednixv2", 1, "count"},
     {"listallserials", 0, "height"},
 
     { "getaddressvoteweight", 0},
+    { "getaddressesvoteweight", 0},
     { "getproposaltimeframeinfo", 0},
     { "getvoteweight", 0, "start_time" },
     { "getvoteweight", 1, "end_time" },
@@ -9,17 +9,24 @@
 #include <core_io.h>
 #include <crypto/ripemd160.h>
 #include <init.h>
+#include <lifecycle.h>
 #include <validation.h>
 #include <httpserver.h>
 #include <net.h>
 #include <netbase.h>
+#include <perf.h>
 #include <rpc/blockchain.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <timedata.h>
 #include <util.h>
 #include <utilstrencodings.h>
+#include "ghostnode/ghostnode-payments.h"
 #include "ghostnode/ghostnode-sync.h"
+#include "ghostnode/ghostnodeman.h"
+#include "ghostnode/instantx.h"
+#include <memusage.h>
+#include <zerocoin/sigma.h>
 #ifdef ENABLE_WALLET
 #include <wallet/rpcwallet.h>
 #include <wallet/wallet.h>
@@ -29,6 +36,7 @@
 #include "txmempool.h"
 #include <uint256.h>
 
+#include <limits>
 #include <stdint.h>
 #ifdef HAVE_MALLOC_INFO
 #include <malloc.h>
@@ -594,6 +602,36 @@ static std::string RPCMallocInfo()
 }
 #endif
 
+/** Approximate heap memory of the big in-memory structures, by subsystem */
+static UniValue RPCSubsystemMemoryInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        obj.push_back(Pair("block_index", (uint64_t)(memusage::DynamicUsage(mapBlockIndex) +
+                                                     mapBlockIndex.size() * memusage::MallocUsage(sizeof(CBlockIndex)))));
+        obj.push_back(Pair("coins_cache", (uint64_t)(pcoinsTip ? pcoinsTip->DynamicMemoryUsage() : 0)));
+        obj.push_back(Pair("sigma_state", (uint64_t)CSigmaState::GetSigmaState()->DynamicMemoryUsage()));
+    }
+    obj.push_back(Pair("mempool", (uint64_t)mempool.DynamicMemoryUsage()));
+    // outside cs_main, the ghostnode code takes its own locks before cs_main
+    obj.push_back(Pair("ghostnodes", (uint64_t)mnodeman.DynamicMemoryUsage()));
+    obj.push_back(Pair("ghostnode_payments", (uint64_t)mnpayments.DynamicMemoryUsage()));
+    obj.push_back(Pair("instantsend", (uint64_t)instantsend.DynamicMemoryUsage()));
+    return obj;
+}
+
+static UniValue RPCSubsystemEvictionInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("ghostnode_broadcasts", mnodeman.GetSeenBroadcastsEvicted()));
+    obj.push_back(Pair("ghostnode_pings", mnodeman.GetSeenPingsEvicted()));
+    obj.push_back(Pair("ghostnode_payment_votes", mnpayments.GetVotesEvicted()));
+    obj.push_back(Pair("ghostnode_payment_votes_refused", mnpayments.GetVotesRejected()));
+    obj.push_back(Pair("instantsend_orphan_votes", instantsend.GetOrphanVotesEvicted()));
+    return obj;
+}
+
 UniValue getmemoryinfo(const JSONRPCRequest& request)
 {
     /* Please, avoid using the word "pool" here in the RPC interface or help,
@@ -606,6 +644,7 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "Arguments:\n"
             "1. \"mode\" determines what kind of information is returned. This argument is optional, the default mode is \"stats\".\n"
             "  - \"stats\" returns general statistics about memory usage in the daemon.\n"
+            "  - \"detailed\" returns the statistics and the approximate memory used by each subsystem.\n"
             "  - \"mallocinfo\" returns an XML string describing low-level heap state (only available if compiled with glibc 2.10+).\n"
             "\nResult (mode \"stats\"):\n"
             "{\n"
@@ -616,8 +655,32 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"rpccache\": {             (json object) Information about the RPC response cache (-rpccachesize)\n"
+            "    \"entries\": xxxxx,       (numeric) Number of cached responses\n"
+            "    \"usage\": xxxxx,         (numeric) Approximate bytes used\n"
+            "    \"max\": xxxxx,           (numeric) Size limit in bytes, 0 when disabled\n"
+            "    \"hits\": xxxxx,          (numeric) Calls answered from the cache\n"
+            "    \"misses\": xxxxx,        (numeric) Cacheable calls that were executed\n"
             "  }\n"
             "}\n"
+            "\nResult (mode \"detailed\"): as for \"stats\", with\n"
+            "  \"subsystems\": {           (json object) Approximate bytes used by\n"
+            "    \"block_index\": xxxxx,   (numeric) The headers and block index entries\n"
+            "    \"coins_cache\": xxxxx,   (numeric) The UTXO cache\n"
+            "    \"sigma_state\": xxxxx,   (numeric) The sigma coin groups, mints and serials\n"
+            "    \"mempool\": xxxxx,       (numeric) The transaction memory pool\n"
+            "    \"ghostnodes\": xxxxx,    (numeric) The ghostnode list and its caches\n"
+            "    \"ghostnode_payments\": xxxxx, (numeric) The ghostnode payment votes\n"
+            "    \"instantsend\": xxxxx    (numeric) The InstantSend lock requests and votes\n"
+            "  },\n"
+            "  \"evictions\": {            (json object) Entries dropped to stay within the -max*mem budgets\n"
+            "    \"ghostnode_broadcasts\": n,  (numeric) Seen ghostnode broadcasts forgotten\n"
+            "    \"ghostnode_pings\": n,       (numeric) Seen ghostnode pings forgotten\n"
+            "    \"ghostnode_payment_votes\": n, (numeric) Payment votes of old blocks dropped\n"
+            "    \"ghostnode_payment_votes_refused\": n, (numeric) New payment votes refused for lack of room\n"
+            "    \"instantsend_orphan_votes\": n (numeric) InstantSend votes without a lock request dropped\n"
+            "  }\n"
             "\nResult (mode \"mallocinfo\"):\n"
             "\"<malloc version=\"1\">...\"\n"
             "\nExamples:\n"
@@ -626,9 +689,14 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
         );
 
     std::string mode = request.params[0].isNull() ? "stats" : request.params[0].get_str();
-    if (mode == "stats") {
+    if (mode == "stats" || mode == "detailed") {
         UniValue obj(UniValue::VOBJ);
         obj.push_back(Pair("locked", RPCLockedMemoryInfo()));
+        obj.push_back(Pair("rpccache", RPCResponseCacheInfo()));
+        if (mode == "detailed") {
+            obj.push_back(Pair("subsystems", RPCSubsystemMemoryInfo()));
+            obj.push_back(Pair("evictions", RPCSubsystemEvictionInfo()));
+        }
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -641,6 +709,176 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+static UniValue PerfHistogramToJSON(const CPerfHistogram::Snapshot& snapshot)
+{
+    UniValue buckets(UniValue::VARR);
+    for (uint64_t nBucket : snapshot.vBuckets)
+        buckets.push_back(nBucket);
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("count", snapshot.nCount));
+    obj.push_back(Pair("total_us", snapshot.nSumMicros));
+    obj.push_back(Pair("max_us", snapshot.nMaxMicros));
+    obj.push_back(Pair("buckets", buckets));
+    return obj;
+}
+
+UniValue getperfinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            "getperfinfo ( lockprofile )\n"
+            "Returns lock contention per lock site and the time spent in instrumented code paths.\n"
+            "The same data is served in the Prometheus text format on /rest/perf when -rest is set.\n"
+            "\nArguments:\n"
+            "1. lockprofile        (boolean, optional) Turn lock profiling on or off (see -lockprofile)\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"lockprofiling\": true|false, (boolean) Whether lock sites are being profiled\n"
+            "  \"locks\": [                 (array) Profiled lock sites, longest total wait first\n"
+            "    {\n"
+            "      \"lock\": \"name\",        (string) The locked expression\n"
+            "      \"site\": \"file:line\",   (string) Where it was locked\n"
+            "      \"contended\": n,        (numeric) Acquisitions that found the lock held\n"
+            "      \"wait\": {...},         (json object) Histogram of the time spent acquiring the lock\n"
+            "      \"hold\": {...}          (json object) Histogram of the time the lock was held\n"
+            "    }, ...\n"
+            "  ],\n"
+            "  \"timers\": [                (array) Instrumented code paths\n"
+            "    {\n"
+            "      \"name\": \"name\",        (string) The code path\n"
+            "      \"time\": {...}          (json object) Histogram of its duration\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "Each histogram has \"count\", \"total_us\", \"max_us\" and \"buckets\", where bucket i counts\n"
+            "durations below 2^(i+1) microseconds and the last bucket everything longer.\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getperfinfo", "")
+            + HelpExampleCli("getperfinfo", "true")
+            + HelpExampleRpc("getperfinfo", "")
+        );
+
+    if (!request.params[0].isNull())
+        g_lock_profiling = request.params[0].get_bool();
+
+    std::vector<std::pair<uint64_t, UniValue>> vLocks;
+    for (const CLockSiteStats* site : GetLockSites()) {
+        CPerfHistogram::Snapshot wait = site->wait.Get();
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("lock", site->pszName));
+        obj.push_back(Pair("site", strprintf("%s:%d", site->pszFile, site->nLine)));
+        obj.push_back(Pair("contended", site->nContended.load()));
+        obj.push_back(Pair("wait", PerfHistogramToJSON(wait)));
+        obj.push_back(Pair("hold", PerfHistogramToJSON(site->hold.Get())));
+        vLocks.emplace_back(wait.nSumMicros, obj);
+    }
+    std::stable_sort(vLocks.begin(), vLocks.end(), [](const std::pair<uint64_t, UniValue>& a, const std::pair<uint64_t, UniValue>& b) {
+        return a.first > b.first;
+    });
+    UniValue locks(UniValue::VARR);
+    for (const auto& lock : vLocks)
+        locks.push_back(lock.second);
+
+    UniValue timers(UniValue::VARR);
+    for (const CPerfTimer* timer : GetPerfTimers()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("name", timer->GetName()));
+        obj.push_back(Pair("time", PerfHistogramToJSON(timer->Get())));
+        timers.push_back(obj);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("lockprofiling", g_lock_profiling.load()));
+    result.push_back(Pair("locks", locks));
+    result.push_back(Pair("timers", timers));
+    return result;
+}
+
+static UniValue LifecycleToJSON(LifecycleObject object, const uint256& hash)
+{
+    CLifecycleRecord record;
+    if (!GetLifecycle(object, hash, record))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No lifecycle recorded for this hash");
+
+    std::vector<std::pair<int64_t, LifecycleStage>> vStages;
+    for (size_t i = 0; i < record.vStageMicros.size(); i++) {
+        if (record.vStageMicros[i] != 0)
+            vStages.emplace_back(record.vStageMicros[i], (LifecycleStage)i);
+    }
+    std::stable_sort(vStages.begin(), vStages.end(), [](const std::pair<int64_t, LifecycleStage>& a, const std::pair<int64_t, LifecycleStage>& b) {
+        return a.first < b.first;
+    });
+
+    UniValue stages(UniValue::VARR);
+    for (const auto& stage : vStages) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("stage", LifecycleStageName(stage.second)));
+        obj.push_back(Pair("offset_us", stage.first - vStages.front().first));
+        stages.push_back(obj);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("hash", hash.GetHex()));
+    result.push_back(Pair("time", record.nTime / 1000000));
+    result.push_back(Pair("stages", stages));
+    result.push_back(Pair("total_us", vStages.empty() ? 0 : vStages.back().first - vStages.front().first));
+    return result;
+}
+
+static const char* LIFECYCLE_RESULT_HELP =
+    "\nResult:\n"
+    "{\n"
+    "  \"hash\": \"hex\",           (string) The hash\n"
+    "  \"time\": n,               (numeric) When the first stage was reached, in seconds since epoch\n"
+    "  \"stages\": [              (array) The stages reached, in the order they were reached\n"
+    "    {\n"
+    "      \"stage\": \"name\",     (string) received, accepted, instantsend_locked, ghostnode_checked, connected,\n"
+    "                           tip_updated, relayed, zmq_published or wallet_notified\n"
+    "      \"offset_us\": n        (numeric) Microseconds after the first stage\n"
+    "    }, ...\n"
+    "  ],\n"
+    "  \"total_us\": n            (numeric) Microseconds from the first to the last stage\n"
+    "}\n";
+
+UniValue gettxlifecycle(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            std::string("gettxlifecycle \"txid\"\n"
+            "Returns when a recent transaction reached each stage of its processing (see -lifecycletrace).\n"
+            "Only the first time a stage is reached is kept, and only the last ") + std::to_string(LIFECYCLE_TX_RECORDS) +
+            " transactions received or accepted to the mempool are remembered.\n"
+            "\nArguments:\n"
+            "1. \"txid\"              (string, required) The transaction id\n"
+            + LIFECYCLE_RESULT_HELP +
+            "\nExamples:\n"
+            + HelpExampleCli("gettxlifecycle", "\"mytxid\"")
+            + HelpExampleRpc("gettxlifecycle", "\"mytxid\"")
+        );
+
+    return LifecycleToJSON(LifecycleObject::TX, ParseHashV(request.params[0], "txid"));
+}
+
+UniValue getblocklifecycle(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            std::string("getblocklifecycle \"blockhash\"\n"
+            "Returns when a recent block reached each stage of its processing (see -lifecycletrace).\n"
+            "Only the first time a stage is reached is kept, and only the last ") + std::to_string(LIFECYCLE_BLOCK_RECORDS) +
+            " blocks are remembered.\n"
+            "\nArguments:\n"
+            "1. \"blockhash\"         (string, required) The block hash\n"
+            + LIFECYCLE_RESULT_HELP +
+            "\nExamples:\n"
+            + HelpExampleCli("getblocklifecycle", "\"myblockhash\"")
+            + HelpExampleRpc("getblocklifecycle", "\"myblockhash\"")
+        );
+
+    return LifecycleToJSON(LifecycleObject::BLOCK, ParseHashV(request.params[0], "blockhash"));
+}
+
 uint32_t getCategoryMask(UniValue cats) {
     cats = cats.get_array();
     uint32_t mask = 0;
@@ -754,16 +992,7 @@ static UniValue getinfo_deprecated(const JSONRPCRequest& request)
 
 bool getAddressFromIndex(const int &type, const uint256 &hash, std::string &address)
 {
-    if (type == ADDR_INDT_SCRIPT_ADDRESS) {
-        address = EncodeDestination(CScriptID(uint160(hash.begin(), 20)));
-    } else if (type == ADDR_INDT_PUBKEY_ADDRESS) {
-        address = EncodeDestination(CKeyID(uint160(hash.begin(), 20)));
-    } else if (type == ADDR_INDT_WITNESS_KEY_HASH) {
-        address = EncodeDestination(WitnessV0KeyHash(uint160(hash.begin(), 20)), true);
-    } else {
-        return false;
-    }
-    return true;
+    return EncodeIndexAddress(type, hash, address);
 }
 
 bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint256, int> > &addresses)
@@ -834,6 +1063,86 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+/** Page size of an address index query, 0 if the whole result is wanted */
+static int getPageLimitFromParams(const UniValue& params, size_t nAddresses)
+{
+    if (!params[0].isObject())
+        return 0;
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    if (limitValue.isNull())
+        return 0;
+    int limit = limitValue.get_int();
+    if (limit <= 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "limit must be positive");
+    if (nAddresses != 1)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "limit requires a single address");
+    return limit;
+}
+
+/** Index key to continue a paged query after, read from the "after" cursor, null for the first page */
+template <typename K>
+static std::unique_ptr<K> getPageCursorFromParams(const UniValue& params, const uint256& addressHash)
+{
+    UniValue afterValue = find_value(params[0].get_obj(), "after");
+    if (afterValue.isNull())
+        return nullptr;
+    if (!IsHex(afterValue.get_str()))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "after must be a hex cursor");
+    std::vector<unsigned char> data(ParseHex(afterValue.get_str()));
+    CDataStream ss(data, SER_DISK, CLIENT_VERSION);
+    std::unique_ptr<K> pkey(new K());
+    try {
+        ss >> *pkey;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    if (pkey->hashBytes != addressHash)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor does not belong to the address");
+    return pkey;
+}
+
+template <typename K>
+static std::string EncodePageCursor(const K& key)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << key;
+    return HexStr(ss.begin(), ss.end());
+}
+
+static UniValue AddressDeltaToJSON(CIndexAddressEncoder& encoder, const CAddressIndexKey& key, CAmount amount)
+{
+    std::string address;
+    if (!encoder.Encode(key.type, key.hashBytes, address)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    }
+
+    UniValue delta(UniValue::VOBJ);
+    delta.push_back(Pair("satoshis", amount));
+    delta.push_back(Pair("txid", key.txhash.GetHex()));
+    delta.push_back(Pair("index", (int)key.index));
+    delta.push_back(Pair("blockindex", (int)key.txindex));
+    delta.push_back(Pair("height", key.blockHeight));
+    delta.push_back(Pair("address", address));
+    return delta;
+}
+
+static UniValue AddressUtxoToJSON(CIndexAddressEncoder& encoder, const CAddressUnspentKey& key, const CAddressUnspentValue& value)
+{
+    UniValue output(UniValue::VOBJ);
+    std::string address;
+    if (!encoder.Encode(key.type, key.hashBytes, address)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    }
+
+    output.push_back(Pair("address", address));
+    output.push_back(Pair("txid", key.txhash.GetHex()));
+    output.push_back(Pair("outputIndex", (int)key.index));
+    output.push_back(Pair("script", HexStr(value.script.begin(), value.script.end())));
+    output.push_back(Pair("satoshis", value.satoshis));
+    output.push_back(Pair("height", value.blockHeight));
+    return output;
+}
+
 UniValue getaddressmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -880,11 +1189,12 @@ UniValue getaddressmempool(const JSONRPCRequest& request)
     std::sort(indexes.begin(), indexes.end(), timestampSort);
 
     UniValue result(UniValue::VARR);
+    CIndexAddressEncoder encoder;
 
     for (std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >::iterator it = indexes.begin(); it != indexes.end(); it++) {
 
         std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.addressBytes, address)) {
+        if (!encoder.Encode(it->first.type, it->first.addressBytes, address)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
         }
 
@@ -917,6 +1227,8 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
                         "      \"address\"  (string) The base58check encoded address\n"
                         "      ,...\n"
                         "    ]\n"
+                        "  \"limit\" (number, optional) Return at most this many outputs, in index order, as {\"utxos\": [...], \"next\": cursor}. Single address only\n"
+                        "  \"after\" (string, optional) The \"next\" cursor of the previous page\n"
                         "}\n"
                         "\nResult\n"
                         "[\n"
@@ -940,6 +1252,32 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    CIndexAddressEncoder encoder;
+    int limit = getPageLimitFromParams(request.params, addresses.size());
+    if (limit > 0) {
+        std::unique_ptr<CAddressUnspentKey> pAfter = getPageCursorFromParams<CAddressUnspentKey>(request.params, addresses[0].first);
+        UniValue utxos(UniValue::VARR);
+        CAddressUnspentKey lastKey;
+        bool fMore = false;
+        if (!ScanAddressUnspent(addresses[0].first, addresses[0].second, [&](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+                if ((int)utxos.size() == limit) {
+                    fMore = true;
+                    return false;
+                }
+                utxos.push_back(AddressUtxoToJSON(encoder, key, value));
+                lastKey = key;
+                return true;
+            }, pAfter.get())) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+
+        UniValue result(UniValue::VOBJ);
+        result.push_back(Pair("utxos", utxos));
+        if (fMore)
+            result.push_back(Pair("next", EncodePageCursor(lastKey)));
+        return result;
+    }
+
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 
     for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
@@ -953,21 +1291,94 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
     UniValue result(UniValue::VARR);
 
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++) {
-        UniValue output(UniValue::VOBJ);
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-        }
+        result.push_back(AddressUtxoToJSON(encoder, it->first, it->second));
+    }
+
+    return result;
+}
+
+UniValue getdelegatedutxos(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw runtime_error(
+                "getdelegatedutxos\n"
+                        "\nReturns the unspent conditional stake outputs delegated to staker addresses (requires delegationindex to be enabled).\n"
+                        "\nArguments:\n"
+                        "{\n"
+                        "  \"addresses\"\n"
+                        "    [\n"
+                        "      \"address\"  (string) The staker address\n"
+                        "      ,...\n"
+                        "    ]\n"
+                        "  \"limit\" (number, optional) Return at most this many outputs, in index order, with a \"next\" cursor. Single address only\n"
+                        "  \"after\" (string, optional) The \"next\" cursor of the previous page\n"
+                        "}\n"
+                        "\nResult\n"
+                        "{\n"
+                        "  \"utxos\": [\n"
+                        "    {\n"
+                        "      \"address\"  (string) The staker address\n"
+                        "      \"owner\"  (string) The address the output can be spent by, if known\n"
+                        "      \"txid\"  (string) The output txid\n"
+                        "      \"outputIndex\"  (number) The output index\n"
+                        "      \"script\"  (string) The script hex encoded\n"
+                        "      \"satoshis\"  (number) The value of the output\n"
+                        "      \"height\"  (number) The block height\n"
+                        "    }\n"
+                        "  ],\n"
+                        "  \"satoshis\"  (number) The total value of the returned outputs\n"
+                        "  \"next\"  (string) Cursor of the next page, only if there is one\n"
+                        "}\n"
+                        "\nExamples:\n"
+                + HelpExampleCli("getdelegatedutxos", "'{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+                + HelpExampleRpc("getdelegatedutxos", "{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
+        );
 
-        output.push_back(Pair("address", address));
-        output.push_back(Pair("txid", it->first.txhash.GetHex()));
-        output.push_back(Pair("outputIndex", (int)it->first.index));
-        output.push_back(Pair("script", HexStr(it->second.script.begin(), it->second.script.end())));
-        output.push_back(Pair("satoshis", it->second.satoshis));
-        output.push_back(Pair("height", it->second.blockHeight));
-        result.push_back(output);
+    std::vector<std::pair<uint256, int> > addresses;
+
+    if (!getAddressesFromParams(request.params, addresses)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    CIndexAddressEncoder encoder;
+    int limit = getPageLimitFromParams(request.params, addresses.size());
+    std::unique_ptr<CAddressUnspentKey> pAfter;
+    if (limit > 0)
+        pAfter = getPageCursorFromParams<CAddressUnspentKey>(request.params, addresses[0].first);
+
+    UniValue utxos(UniValue::VARR);
+    CAmount nTotal = 0;
+    CAddressUnspentKey lastKey;
+    bool fMore = false;
+    for (const auto& address : addresses) {
+        if (!ScanDelegatedUnspent(address.first, address.second, [&](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+                if (limit > 0 && (int)utxos.size() == limit) {
+                    fMore = true;
+                    return false;
+                }
+                UniValue output = AddressUtxoToJSON(encoder, key, value);
+                int ownerType = 0;
+                std::vector<uint8_t> ownerHash;
+                std::string owner;
+                CScript scriptOwner;
+                if (GetNonCoinstakeScriptPath(value.script, scriptOwner)
+                        && ExtractIndexInfo(&scriptOwner, ownerType, ownerHash) && ownerType != 0
+                        && encoder.Encode(ownerType, uint256(ownerHash.data(), ownerHash.size()), owner))
+                    output.push_back(Pair("owner", owner));
+                utxos.push_back(output);
+                nTotal += value.satoshis;
+                lastKey = key;
+                return true;
+            }, pAfter.get())) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("utxos", utxos));
+    result.push_back(Pair("satoshis", nTotal));
+    if (fMore)
+        result.push_back(Pair("next", EncodePageCursor(lastKey)));
     return result;
 }
 
@@ -986,6 +1397,8 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
                         "    ]\n"
                         "  \"start\" (number) The start block height\n"
                         "  \"end\" (number) The end block height\n"
+                        "  \"limit\" (number, optional) Return at most this many deltas as {\"deltas\": [...], \"next\": cursor}. Single address only\n"
+                        "  \"after\" (string, optional) The \"next\" cursor of the previous page\n"
                         "}\n"
                         "\nResult:\n"
                         "[\n"
@@ -1024,6 +1437,32 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    CIndexAddressEncoder encoder;
+    int limit = getPageLimitFromParams(request.params, addresses.size());
+    if (limit > 0) {
+        std::unique_ptr<CAddressIndexKey> pAfter = getPageCursorFromParams<CAddressIndexKey>(request.params, addresses[0].first);
+        UniValue deltas(UniValue::VARR);
+        CAddressIndexKey lastKey;
+        bool fMore = false;
+        if (!ScanAddressIndex(addresses[0].first, addresses[0].second, [&](const CAddressIndexKey& key, CAmount amount) {
+                if ((int)deltas.size() == limit) {
+                    fMore = true;
+                    return false;
+                }
+                deltas.push_back(AddressDeltaToJSON(encoder, key, amount));
+                lastKey = key;
+                return true;
+            }, start, end, pAfter.get())) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+
+        UniValue result(UniValue::VOBJ);
+        result.push_back(Pair("deltas", deltas));
+        if (fMore)
+            result.push_back(Pair("next", EncodePageCursor(lastKey)));
+        return result;
+    }
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
@@ -1041,19 +1480,7 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
     UniValue result(UniValue::VARR);
 
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-        }
-
-        UniValue delta(UniValue::VOBJ);
-        delta.push_back(Pair("satoshis", it->second));
-        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
-        delta.push_back(Pair("index", (int)it->first.index));
-        delta.push_back(Pair("blockindex", (int)it->first.txindex));
-        delta.push_back(Pair("height", it->first.blockHeight));
-        delta.push_back(Pair("address", address));
-        result.push_back(delta);
+        result.push_back(AddressDeltaToJSON(encoder, it->first, it->second));
     }
 
     return result;
@@ -1071,7 +1498,8 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
                         "    [\n"
                         "      \"address\"  (string) The base58check encoded address\n"
                         "      ,...\n"
-                        "    ]\n"
+                        "    ],\n"
+                        "  \"height\"  (number, optional) Return the balance after the block at this height\n"
                         "}\n"
                         "\nResult:\n"
                         "{\n"
@@ -1089,22 +1517,42 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    int nHeight = std::numeric_limits<int>::max();
+    if (request.params[0].isObject()) {
+        UniValue heightValue = find_value(request.params[0].get_obj(), "height");
+        if (heightValue.isNum()) {
+            nHeight = heightValue.get_int();
+            if (nHeight < 0) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Height must be non-negative");
+            }
         }
     }
 
     CAmount balance = 0;
     CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        // A single checkpoint lookup when the balance index is kept
+        if (fAddressBalanceIndex) {
+            CAddressBalanceValue value;
+            if (!GetAddressBalance((*it).first, (*it).second, nHeight, value)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+            balance += value.balance;
+            received += value.received;
+            continue;
+        }
+
+        // Summed while scanning, the entries of an address are never held in memory
+        if (!ScanAddressIndex((*it).first, (*it).second, [&](const CAddressIndexKey& key, CAmount amount) {
+                if (amount > 0) {
+                    received += amount;
+                }
+                balance += amount;
+                return true;
+            }, 0, nHeight == std::numeric_limits<int>::max() ? 0 : std::max(nHeight, 1))) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
     }
 
     UniValue result(UniValue::VOBJ);
@@ -1130,6 +1578,8 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
                         "    ]\n"
                         "  \"start\" (number) The start block height\n"
                         "  \"end\" (number) The end block height\n"
+                        "  \"limit\" (number, optional) Return at most this many txids as {\"txids\": [...], \"next\": cursor}. Single address only\n"
+                        "  \"after\" (string, optional) The \"next\" cursor of the previous page\n"
                         "}\n"
                         "\nResult:\n"
                         "[\n"
@@ -1158,6 +1608,36 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         }
     }
 
+    int limit = getPageLimitFromParams(request.params, addresses.size());
+    if (limit > 0) {
+        // Entries of one transaction are adjacent in key order, the cursor is the last entry of the last txid returned
+        std::unique_ptr<CAddressIndexKey> pAfter = getPageCursorFromParams<CAddressIndexKey>(request.params, addresses[0].first);
+        UniValue txids(UniValue::VARR);
+        CAddressIndexKey lastKey;
+        uint256 lastTxid = pAfter ? pAfter->txhash : uint256();
+        bool fMore = false;
+        if (!ScanAddressIndex(addresses[0].first, addresses[0].second, [&](const CAddressIndexKey& key, CAmount amount) {
+                if (key.txhash != lastTxid) {
+                    if ((int)txids.size() == limit) {
+                        fMore = true;
+                        return false;
+                    }
+                    txids.push_back(key.txhash.GetHex());
+                    lastTxid = key.txhash;
+                }
+                lastKey = key;
+                return true;
+            }, start, end, pAfter.get())) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+
+        UniValue result(UniValue::VOBJ);
+        result.push_back(Pair("txids", txids));
+        if (fMore)
+            result.push_back(Pair("next", EncodePageCursor(lastKey)));
+        return result;
+    }
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
@@ -1198,44 +1678,14 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
 
 }
 
-UniValue getaddressvoteweight(const JSONRPCRequest& request)
+/** Resolves the "start" and "end" times of a vote weight request to the block heights they fall in */
+static void getVoteWeightBlockRange(const CChainSnapshot& chain, const UniValue& params, int& start, int& end)
 {
-    if (request.fHelp || request.params.size() != 1 || !request.params[0].isObject())
-        throw runtime_error(
-                "getaddressvoteweight\n"
-                        "\nReturns vote weight for an address (requires addressindex to be enabled).\n"
-                        "\nArguments:\n"
-                        "{\n"
-                        "  \"addresses\"\n"
-                        "    [\n"
-                        "      \"address\"  (string) The base58check encoded address\n"
-                        "      ,...\n"
-                        "    ]\n"
-                        "  \"start\" (number) The start time of the vote weight period\n"
-                        "  \"end\" (number) The end time of the vote weight period\n"
-                        "}\n"
-                        "\nResult:\n"
-                        "[\n"
-                        "  {\n"
-                        "    \"voteweight\"  (number) The vote weight of the address\n"
-                        "  }\n"
-                        "]\n"
-                        "\nExamples:\n"
-                + HelpExampleCli("getaddressvoteweight", "'{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"start\": 10, \"end\": 20}'")
-                + HelpExampleRpc("getaddressvoteweight", "'{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
-        );
-
-    // using chainactive
-
-
-    LOCK(cs_main);
+    UniValue startValue = find_value(params.get_obj(), "start");
+    UniValue endValue = find_value(params.get_obj(), "end");
 
-    UniValue result(UniValue::VOBJ);
-    UniValue startValue = find_value(request.params[0].get_obj(), "start");
-    UniValue endValue = find_value(request.params[0].get_obj(), "end");
-
-    int start = 0;
-    int end = 0;
+    start = 0;
+    end = 0;
 
     if (startValue.isNum() && endValue.isNum()) {
         start = startValue.get_int();
@@ -1247,7 +1697,7 @@ UniValue getaddressvoteweight(const JSONRPCRequest& request)
 
     int start_block = -1;
     int end_block = -1;
-    CBlockIndex *activeTip = chainActive.Tip();
+    CBlockIndex *activeTip = chain.Tip();
     CBlockIndex *lastBlock = activeTip->pprev;
 
     // find start and end blocks
@@ -1272,10 +1722,90 @@ UniValue getaddressvoteweight(const JSONRPCRequest& request)
     }
 
     if(end_block == -1)
-        end_block = chainActive.Height();
+        end_block = chain.Height();
 
     start = start_block;
     end = end_block;
+}
+
+/**
+ * Adds the vote weight of an address over the blocks start to end to weight, and its plain coinstake
+ * sum, used instead when the weight turns out negative, to coinstake. fFirst is cleared once an
+ * address index entry has been seen, the first entry of a tally is skipped for staking bypass.
+ */
+static bool getAddressVoteWeight(const uint256& hash, int type, int start, int end, bool& fFirst, CAmount& weight, CAmount& coinstake)
+{
+    bool fRange = start > 0 && end > 0;
+
+    if (fAddressBalanceIndex) {
+        // Difference of the checkpointed coinstake sums around the range
+        CAddressBalanceValue upper, lower;
+        if (!GetAddressBalance(hash, type, fRange ? end : std::numeric_limits<int>::max(), upper))
+            return false;
+        if (fRange && !GetAddressBalance(hash, type, start - 1, lower))
+            return false;
+        weight += upper.staked - lower.staked;
+        coinstake += upper.staked - lower.staked;
+
+        if (!fFirst)
+            return true;
+        return ScanAddressIndex(hash, type, [&](const CAddressIndexKey& key, CAmount amount) {
+            fFirst = false;
+            if (key.txindex == 0 && key.type == ADDR_INDT_WITNESS_KEY_HASH)
+                weight -= amount;
+            return false;
+        }, fRange ? start : 0, fRange ? end : 0);
+    }
+
+    return ScanAddressIndex(hash, type, [&](const CAddressIndexKey& key, CAmount amount) {
+        bool fSkip = fFirst;
+        fFirst = false;
+        // check for coinstake
+        if (key.txindex != 0)
+            return true;
+        coinstake += amount;
+
+        // check for staking bypass
+        if (key.type == ADDR_INDT_WITNESS_KEY_HASH && fSkip)
+            return true;
+
+        weight += amount;
+        return true;
+    }, fRange ? start : 0, fRange ? end : 0);
+}
+
+UniValue getaddressvoteweight(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1 || !request.params[0].isObject())
+        throw runtime_error(
+                "getaddressvoteweight\n"
+                        "\nReturns vote weight for an address (requires addressindex to be enabled).\n"
+                        "\nArguments:\n"
+                        "{\n"
+                        "  \"addresses\"\n"
+                        "    [\n"
+                        "      \"address\"  (string) The base58check encoded address\n"
+                        "      ,...\n"
+                        "    ]\n"
+                        "  \"start\" (number) The start time of the vote weight period\n"
+                        "  \"end\" (number) The end time of the vote weight period\n"
+                        "}\n"
+                        "\nResult:\n"
+                        "[\n"
+                        "  {\n"
+                        "    \"voteweight\"  (number) The vote weight of the address\n"
+                        "  }\n"
+                        "]\n"
+                        "\nExamples:\n"
+                + HelpExampleCli("getaddressvoteweight", "'{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"start\": 10, \"end\": 20}'")
+                + HelpExampleRpc("getaddressvoteweight", "'{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+        );
+
+    UniValue result(UniValue::VOBJ);
+
+    int start = 0;
+    int end = 0;
+    getVoteWeightBlockRange(*GetChainSnapshot(), request.params[0], start, end);
 
     std::vector<std::pair<uint256, int> > addresses;
 
@@ -1283,58 +1813,92 @@ UniValue getaddressvoteweight(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
-
     CAmount totalWeight = 0;
-    int k = 0;
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+    CAmount coinstakeWeight = 0;
+    bool fFirst = true;
+    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
         std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
+        if (!getAddressFromIndex((*it).second, (*it).first, address)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
         }
+        if (!getAddressVoteWeight((*it).first, (*it).second, start, end, fFirst, totalWeight, coinstakeWeight)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+    }
+    if (totalWeight < 0)
+        totalWeight = coinstakeWeight;
 
-        k++;
-        // check for coinstake
-        if(it->first.txindex != 0) continue;
+    result.pushKV("address_weight", ValueFromAmount(totalWeight));
+    result.pushKV("block_start", std::to_string(start));
+    result.pushKV("block_end", std::to_string(end));
 
-        // check for staking bypass
-        if(it->first.type == ADDR_INDT_WITNESS_KEY_HASH){
-            if(k == 1)
-                continue;
-        }
 
-        totalWeight += it->second;
+    return result;
+}
+
+UniValue getaddressesvoteweight(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1 || !request.params[0].isObject())
+        throw runtime_error(
+                "getaddressesvoteweight\n"
+                        "\nReturns the vote weight of each of the addresses, tallied independently (requires addressindex to be enabled).\n"
+                        "\nArguments:\n"
+                        "{\n"
+                        "  \"addresses\"\n"
+                        "    [\n"
+                        "      \"address\"  (string) The base58check encoded address\n"
+                        "      ,...\n"
+                        "    ]\n"
+                        "  \"start\" (number) The start time of the vote weight period\n"
+                        "  \"end\" (number) The end time of the vote weight period\n"
+                        "}\n"
+                        "\nResult:\n"
+                        "{\n"
+                        "  \"weights\"        (object) The vote weight of each address, as getaddressvoteweight returns it\n"
+                        "  \"total_weight\"   (number) The sum of the weights\n"
+                        "  \"block_start\"    (string) The first block of the period\n"
+                        "  \"block_end\"      (string) The last block of the period\n"
+                        "}\n"
+                        "\nExamples:\n"
+                + HelpExampleCli("getaddressesvoteweight", "'{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"start\": 10, \"end\": 20}'")
+                + HelpExampleRpc("getaddressesvoteweight", "'{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+        );
+
+    int start = 0;
+    int end = 0;
+    getVoteWeightBlockRange(*GetChainSnapshot(), request.params[0], start, end);
+
+    std::vector<std::pair<uint256, int> > addresses;
+
+    if (!getAddressesFromParams(request.params, addresses)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
-    if(totalWeight < 0){
-        totalWeight = 0;
-        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-            std::string address;
-            if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-            }
-                // check for coinstake
-            if(it->first.txindex != 0) continue;
-            totalWeight += it->second;
+
+    UniValue weights(UniValue::VOBJ);
+    CAmount totalWeight = 0;
+    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        std::string address;
+        if (!getAddressFromIndex((*it).second, (*it).first, address)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+        }
+        CAmount weight = 0;
+        CAmount coinstake = 0;
+        bool fFirst = true;
+        if (!getAddressVoteWeight((*it).first, (*it).second, start, end, fFirst, weight, coinstake)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
+        if (weight < 0)
+            weight = coinstake;
+        weights.pushKV(address, ValueFromAmount(weight));
+        totalWeight += weight;
     }
 
-    result.pushKV("address_weight", ValueFromAmount(totalWeight));
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("weights", weights);
+    result.pushKV("total_weight", ValueFromAmount(totalWeight));
     result.pushKV("block_start", std::to_string(start));
     result.pushKV("block_end", std::to_string(end));
 
-
     return result;
 }
 
@@ -1363,52 +1927,22 @@ UniValue getproposaltimeframeinfo(const JSONRPCRequest& request)
     LOCK(cs_main);
 
     UniValue result(UniValue::VOBJ);
-    UniValue startValue = find_value(request.params[0].get_obj(), "start");
-    UniValue endValue = find_value(request.params[0].get_obj(), "end");
 
     int start = 0;
     int end = 0;
-
-    if (startValue.isNum() && endValue.isNum()) {
-        start = startValue.get_int();
-        end = endValue.get_int();
-        if (end < start) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
-        }
+    getVoteWeightBlockRange(*GetChainSnapshot(), request.params[0], start, end);
+
+    // A timeframe's total only depends on its blocks, so it is reused while its last block stays in the active chain
+    static std::map<std::pair<int, int>, std::pair<uint256, CAmount> > mapTimeframeWeight;
+    const uint256 hashEnd = chainActive[end] ? chainActive[end]->GetBlockHash() : uint256();
+    auto itCached = mapTimeframeWeight.find(std::make_pair(start, end));
+    if (itCached != mapTimeframeWeight.end() && itCached->second.first == hashEnd) {
+        result.pushKV("total_possible_votes", ValueFromAmount(itCached->second.second));
+        result.pushKV("block_start", (start));
+        result.pushKV("block_end", (end));
+        return result;
     }
 
-    int start_block = -1;
-    int end_block = -1;
-    CBlockIndex *activeTip = chainActive.Tip();
-    CBlockIndex *lastBlock = activeTip->pprev;
-
-    // find start and end blocks
-    while(lastBlock){
-        // match end block
-        if(activeTip->GetBlockTime() >= end && lastBlock->GetBlockTime() < end && end_block == -1)
-            end_block = activeTip->nHeight;
-        else if(activeTip->GetBlockTime() >= end && lastBlock->GetBlockTime() <= end && end_block == -1)
-            end_block = lastBlock->nHeight;
-
-        // match start block
-        if(activeTip->GetBlockTime() >= start && lastBlock->GetBlockTime() < start && start_block == -1)
-            start_block = activeTip->nHeight;
-        if(activeTip->GetBlockTime() >= start && lastBlock->GetBlockTime() <= start && start_block == -1)
-            start_block = lastBlock->nHeight;
-
-        activeTip = lastBlock;
-        lastBlock = lastBlock->pprev;
-
-        if(start_block != -1 && end_block != -1)
-            break;
-    }
-
-    if(end_block == -1)
-        end_block = chainActive.Height();
-
-    start = start_block;
-    end = end_block;
-
     CAmount totalWeight = 0;
     for(int i = start; i <= end; i++){
         CBlockIndex *pindex = chainActive[i];
@@ -1430,6 +1964,10 @@ UniValue getproposaltimeframeinfo(const JSONRPCRequest& request)
 
     }
 
+    if (mapTimeframeWeight.size() >= 1000)
+        mapTimeframeWeight.clear();
+    mapTimeframeWeight[std::make_pair(start, end)] = std::make_pair(hashEnd, totalWeight);
+
     result.pushKV("total_possible_votes", ValueFromAmount(totalWeight));
     result.pushKV("block_start", (start));
     result.pushKV("block_end", (end));
@@ -1491,6 +2029,9 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
+    { "control",            "getperfinfo",            &getperfinfo,            {"lockprofile"} },
+    { "control",            "gettxlifecycle",         &gettxlifecycle,         {"txid"} },
+    { "control",            "getblocklifecycle",      &getblocklifecycle,      {"blockhash"} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
     { "util",               "validateaddress",        &validateaddress,        {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys"} },
@@ -1501,11 +2042,13 @@ static const CRPCCommand commands[] =
   /* Address index */
   { "addressindex",       "getaddressmempool",      &getaddressmempool,      {"addresses"} },
   { "addressindex",       "getaddressutxos",        &getaddressutxos,        {"addresses"} },
+  { "addressindex",       "getdelegatedutxos",      &getdelegatedutxos,      {"addresses"} },
   { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       {"addresses"} },
   { "addressindex",       "getaddresstxids",        &getaddresstxids,        {"addresses"} },
   { "addressindex",       "getaddressbalance",      &getaddressbalance,      {"addresses"} },
 
   { "NIX Governance",     "getaddressvoteweight",   &getaddressvoteweight,   {"address", "start_time", "end_time"} },
+  { "NIX Governance",     "getaddressesvoteweight", &getaddressesvoteweight, {"addresses", "start_time", "end_time"} },
   { "NIX Governance",     "getproposaltimeframeinfo",   &getproposaltimeframeinfo,   {"start_time", "end_time"} },
 
 
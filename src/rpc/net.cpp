@@ -65,6 +65,20 @@ UniValue ping(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static UniValue MsgCmdProcessToJSON(const mapMsgCmdProcess& mapProcess)
+{
+    UniValue ret(UniValue::VOBJ);
+    for (const mapMsgCmdProcess::value_type &i : mapProcess) {
+        if (i.second.nCount == 0 && i.second.nTimeMicros == 0)
+            continue;
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("count", i.second.nCount));
+        entry.push_back(Pair("time_us", i.second.nTimeMicros));
+        ret.push_back(Pair(i.first, entry));
+    }
+    return ret;
+}
+
 UniValue getpeerinfo(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -89,6 +103,7 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "    \"pingtime\": n,             (numeric) ping time (if available)\n"
             "    \"minping\": n,              (numeric) minimum observed ping time (if any at all)\n"
             "    \"pingwait\": n,             (numeric) ping wait (if non-zero)\n"
+            "    \"blockdelivery\": n,        (numeric) average time requested blocks took to arrive (if measured)\n"
             "    \"version\": v,              (numeric) The peer version, such as 70001\n"
             "    \"subver\": \"/Satoshi:0.8.5/\",  (string) The string version\n"
             "    \"inbound\": true|false,     (boolean) Inbound (true) or Outbound (false)\n"
@@ -101,6 +116,14 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
             "    ],\n"
+            "    \"cmpctblocks\": {            (json object) Compact blocks received from this peer\n"
+            "      \"reconstructed\": n,      (numeric) Blocks rebuilt from the announcement, the mempool and requested transactions\n"
+            "      \"fallback\": n,           (numeric) Blocks that had to be downloaded in full\n"
+            "      \"sigma_available\": n,    (numeric) Sigma spends in reconstructed blocks that were prefilled or in our mempool\n"
+            "      \"sigma_requested\": n,    (numeric) Sigma spends in reconstructed blocks that had to be requested\n"
+            "      \"other_available\": n,    (numeric) Other transactions that were prefilled or in our mempool\n"
+            "      \"other_requested\": n     (numeric) Other transactions that had to be requested\n"
+            "    },\n"
             "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
             "    \"bytessent_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes sent aggregated by message type\n"
@@ -109,6 +132,13 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "    \"bytesrecv_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes received aggregated by message type\n"
             "       ...\n"
+            "    },\n"
+            "    \"processed_per_msg\": {\n"
+            "       \"addr\": {               (json object) Messages of this type handled from the peer\n"
+            "         \"count\": n,           (numeric) The number of messages\n"
+            "         \"time_us\": n          (numeric) The total time spent handling them in microseconds\n"
+            "       },\n"
+            "       ...\n"
             "    }\n"
             "  }\n"
             "  ,...\n"
@@ -150,6 +180,8 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             obj.push_back(Pair("minping", stats.dMinPing));
         if (stats.dPingWait > 0.0)
             obj.push_back(Pair("pingwait", stats.dPingWait));
+        if (stats.dBlockDelivery > 0.0)
+            obj.push_back(Pair("blockdelivery", stats.dBlockDelivery));
         obj.push_back(Pair("version", stats.nVersion));
         // Use the sanitized form of subver here, to avoid tricksy remote peers from
         // corrupting or modifying the JSON output by putting special characters in
@@ -167,6 +199,14 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
                 heights.push_back(height);
             }
             obj.push_back(Pair("inflight", heights));
+            UniValue cmpct(UniValue::VOBJ);
+            cmpct.push_back(Pair("reconstructed", statestats.nCmpctReconstructed));
+            cmpct.push_back(Pair("fallback", statestats.nCmpctFallback));
+            cmpct.push_back(Pair("sigma_available", statestats.cmpctTxCounts.nSigmaAvailable));
+            cmpct.push_back(Pair("sigma_requested", statestats.cmpctTxCounts.nSigmaRequested));
+            cmpct.push_back(Pair("other_available", statestats.cmpctTxCounts.nOtherAvailable));
+            cmpct.push_back(Pair("other_requested", statestats.cmpctTxCounts.nOtherRequested));
+            obj.push_back(Pair("cmpctblocks", cmpct));
         }
         obj.push_back(Pair("whitelisted", stats.fWhitelisted));
 
@@ -183,6 +223,7 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
                 recvPerMsgCmd.push_back(Pair(i.first, i.second));
         }
         obj.push_back(Pair("bytesrecv_per_msg", recvPerMsgCmd));
+        obj.push_back(Pair("processed_per_msg", MsgCmdProcessToJSON(stats.mapProcessPerMsgCmd)));
 
         ret.push_back(obj);
     }
@@ -359,6 +400,13 @@ UniValue getnettotals(const JSONRPCRequest& request)
             "  \"totalbytesrecv\": n,   (numeric) Total bytes received\n"
             "  \"totalbytessent\": n,   (numeric) Total bytes sent\n"
             "  \"timemillis\": t,       (numeric) Current UNIX time in milliseconds\n"
+            "  \"processed_per_msg\": {  (json object) Messages handled from all peers since startup\n"
+            "     \"addr\": {\n"
+            "       \"count\": n,          (numeric) The number of messages of this type\n"
+            "       \"time_us\": n         (numeric) The total time spent handling them in microseconds\n"
+            "     },\n"
+            "     ...\n"
+            "  },\n"
             "  \"uploadtarget\":\n"
             "  {\n"
             "    \"timeframe\": n,                         (numeric) Length of the measuring timeframe in seconds\n"
@@ -380,6 +428,7 @@ UniValue getnettotals(const JSONRPCRequest& request)
     obj.push_back(Pair("totalbytesrecv", g_connman->GetTotalBytesRecv()));
     obj.push_back(Pair("totalbytessent", g_connman->GetTotalBytesSent()));
     obj.push_back(Pair("timemillis", GetTimeMillis()));
+    obj.push_back(Pair("processed_per_msg", MsgCmdProcessToJSON(g_connman->GetTotalProcessPerMsgCmd())));
 
     UniValue outboundLimit(UniValue::VOBJ);
     outboundLimit.push_back(Pair("timeframe", g_connman->GetMaxOutboundTimeframe()));
@@ -408,6 +457,13 @@ static UniValue GetNetworksInfo()
         obj.push_back(Pair("reachable", IsReachable(network)));
         obj.push_back(Pair("proxy", proxy.IsValid() ? proxy.proxy.ToStringIPPort() : std::string()));
         obj.push_back(Pair("proxy_randomize_credentials", proxy.randomize_credentials));
+        if (g_connman) {
+            CNetLatencyStats latency = g_connman->GetNetworkLatency(network);
+            if (latency.nPingUsec)
+                obj.push_back(Pair("pingtime", latency.nPingUsec / 1e6));
+            if (latency.nBlockDeliveryUsec)
+                obj.push_back(Pair("blockdelivery", latency.nBlockDeliveryUsec / 1e6));
+        }
         networks.push_back(obj);
     }
     return networks;
@@ -436,6 +492,8 @@ UniValue getnetworkinfo(const JSONRPCRequest& request)
             "    \"reachable\": true|false,             (boolean) is the network reachable?\n"
             "    \"proxy\": \"host:port\"               (string) the proxy that is used for this network, or empty if none\n"
             "    \"proxy_randomize_credentials\": true|false,  (string) Whether randomized credentials are used\n"
+            "    \"pingtime\": n,                              (numeric) Average ping time of the peers on this network (if measured)\n"
+            "    \"blockdelivery\": n,                         (numeric) Average time requested blocks from those peers took to arrive (if measured)\n"
             "  }\n"
             "  ,...\n"
             "  ],\n"
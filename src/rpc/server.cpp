@@ -20,8 +20,12 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
+#include <atomic>
+#include <condition_variable>
 #include <memory> // for unique_ptr
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 
 static bool fRPCRunning = false;
 static bool fRPCInWarmup = true;
@@ -32,6 +36,119 @@ static RPCTimerInterface* timerInterface = nullptr;
 /* Map of name to timer. */
 static std::map<std::string, std::unique_ptr<RPCTimerBase> > deadlineTimers;
 
+/**
+ * Responses of calls that only depend on the chain, by URI, method and parameters.
+ * Emptied whenever the tip changes, least recently used entries go first when full.
+ */
+class CRPCResponseCache
+{
+private:
+    typedef std::pair<std::string, std::pair<UniValue, size_t> > Entry;
+
+    std::mutex cs;
+    std::list<Entry> lruEntries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> mapEntries;
+    size_t nUsage = 0;
+    size_t nMaxUsage = 0;
+    //! Bumped on every clear so results computed against an older tip are not stored
+    uint64_t nGeneration = 0;
+    uint64_t nHits = 0;
+    uint64_t nMisses = 0;
+
+public:
+    void SetMaxUsage(size_t nMax)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        nMaxUsage = nMax;
+    }
+
+    bool Enabled()
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        return nMaxUsage > 0;
+    }
+
+    bool Get(const std::string& key, UniValue& result, uint64_t& nGenerationOut)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        nGenerationOut = nGeneration;
+        auto it = mapEntries.find(key);
+        if (it == mapEntries.end()) {
+            nMisses++;
+            return false;
+        }
+        lruEntries.splice(lruEntries.begin(), lruEntries, it->second);
+        result = it->second->second.first;
+        nHits++;
+        return true;
+    }
+
+    void Put(const std::string& key, const UniValue& result, uint64_t nGenerationIn)
+    {
+        size_t nSize = key.size() + result.write().size();
+        std::lock_guard<std::mutex> lock(cs);
+        if (nGenerationIn != nGeneration || nSize > nMaxUsage || mapEntries.count(key))
+            return;
+        while (nUsage + nSize > nMaxUsage) {
+            nUsage -= lruEntries.back().second.second;
+            mapEntries.erase(lruEntries.back().first);
+            lruEntries.pop_back();
+        }
+        lruEntries.emplace_front(key, std::make_pair(result, nSize));
+        mapEntries[key] = lruEntries.begin();
+        nUsage += nSize;
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        nGeneration++;
+        lruEntries.clear();
+        mapEntries.clear();
+        nUsage = 0;
+    }
+
+    UniValue Info()
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("entries", (uint64_t)mapEntries.size()));
+        obj.push_back(Pair("usage", (uint64_t)nUsage));
+        obj.push_back(Pair("max", (uint64_t)nMaxUsage));
+        obj.push_back(Pair("hits", nHits));
+        obj.push_back(Pair("misses", nMisses));
+        return obj;
+    }
+};
+
+static CRPCResponseCache rpcResponseCache;
+
+/** Calls whose result only changes with the active chain */
+static const std::unordered_set<std::string> setCacheableRPC = {
+    "getbestblockhash", "getblock", "getblockcount", "getblockhash", "getblockhashes", "getblockheader",
+    "getchaintips", "getdifficulty", "getrawtransaction",
+    "getaddressbalance", "getaddressdeltas", "getaddresstxids", "getaddressutxos",
+    "getaddressvoteweight", "getaddressesvoteweight", "getproposaltimeframeinfo",
+};
+
+static bool IsCacheableResult(const std::string& strMethod, const UniValue& result)
+{
+    // Only confirmed transactions, mempool ones can leave without the tip changing
+    if (strMethod == "getrawtransaction")
+        return result.isObject() && !find_value(result, "blockhash").isNull();
+    return true;
+}
+
+void RPCClearResponseCache(bool ibd, const CBlockIndex* pindex)
+{
+    rpcResponseCache.Clear();
+}
+
+UniValue RPCResponseCacheInfo()
+{
+    return rpcResponseCache.Info();
+}
+
 static struct CRPCSignals
 {
     boost::signals2::signal<void ()> Started;
@@ -279,6 +396,7 @@ static const CRPCCommand vRPCCommands[] =
   { "NIX Ghostnode",               "ghostsync",             &ghostnodesync,             {"command"}  },
   { "NIX Ghostnode",               "ghostnodelist",         &ghostnodelist,         {"mode", "filter"}  },
   { "NIX Ghostnode",               "ghostnodebroadcast",    &ghostnodebroadcast,    {"command"}  },
+  { "NIX Ghostnode",               "waitforghostnodestatus", &waitforghostnodestatus, {"status", "timeout"}  },
   { "NIX Ghostnode",               "getpoolinfo",            &getpoolinfo,            {}  },
 };
 
@@ -319,6 +437,7 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
 bool StartRPC()
 {
     LogPrint(BCLog::RPC, "Starting RPC\n");
+    rpcResponseCache.SetMaxUsage(std::max<int64_t>(gArgs.GetArg("-rpccachesize", DEFAULT_RPC_CACHE_SIZE), 0) << 20);
     fRPCRunning = true;
     g_rpcSignals.Started();
     return true;
@@ -376,7 +495,7 @@ void JSONRPCRequest::parse(const UniValue& valRequest)
     id = find_value(request, "id");
 
     // Parse method
-    UniValue valMethod = find_value(request, "method");
+    const UniValue& valMethod = find_value(request, "method");
     if (valMethod.isNull())
         throw JSONRPCError(RPC_INVALID_REQUEST, "Missing method");
     if (!valMethod.isStr())
@@ -384,8 +503,8 @@ void JSONRPCRequest::parse(const UniValue& valRequest)
     strMethod = valMethod.get_str();
     LogPrint(BCLog::RPC, "ThreadRPCServer method=%s\n", SanitizeString(strMethod));
 
-    // Parse params
-    UniValue valParams = find_value(request, "params");
+    // Parse params, copied once as they can hold large hex strings
+    const UniValue& valParams = find_value(request, "params");
     if (valParams.isArray() || valParams.isObject())
         params = valParams;
     else if (valParams.isNull())
@@ -424,11 +543,94 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
     return rpc_result;
 }
 
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
+/** Calls that only read state, so their order within a batch does not matter */
+static const std::unordered_set<std::string> setReadOnlyRPC = {
+    "getbestblockhash", "getblock", "getblockcount", "getblockhash", "getblockhashes", "getblockheader",
+    "getchaintips", "getdifficulty", "getmempoolentry", "getrawmempool", "gettxout", "getrawtransaction",
+    "decoderawtransaction", "decodescript", "validateaddress", "getspentinfo",
+    "getaddressbalance", "getaddressdeltas", "getaddresstxids", "getaddressutxos", "getaddressmempool",
+    "getaddressvoteweight", "getaddressesvoteweight",
+};
+
+static bool IsReadOnlyRPC(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req, "method");
+    return method.isStr() && setReadOnlyRPC.count(method.get_str());
+}
+
+/** A run of batch entries shared by the threads executing it */
+struct CRPCBatchRun
 {
+    const JSONRPCRequest* jreq;
+    const UniValue* vReq;
+    std::vector<UniValue>* vResults;
+    std::atomic<size_t> nNext;
+    size_t nEnd;
+    size_t nPending;
+    std::mutex cs;
+    std::condition_variable cond;
+
+    //! Executes entries until none are left, safe to call after the run has finished
+    void Work()
+    {
+        size_t nIdx;
+        while ((nIdx = nNext++) < nEnd) {
+            UniValue result;
+            try {
+                result = JSONRPCExecOne(*jreq, (*vReq)[nIdx]);
+            } catch (...) {
+                result = JSONRPCReplyObj(NullUniValue, JSONRPCError(RPC_MISC_ERROR, "Internal error"), NullUniValue);
+            }
+            std::unique_lock<std::mutex> lock(cs);
+            (*vResults)[nIdx] = result;
+            if (--nPending == 0)
+                cond.notify_all();
+        }
+    }
+};
+
+std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq,
+                             const RPCTaskDispatcher& dispatch, int nHelpers)
+{
+    std::vector<UniValue> vResults(vReq.size());
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        size_t reqEnd = reqIdx;
+        if (dispatch && nHelpers > 0) {
+            while (reqEnd < vReq.size() && IsReadOnlyRPC(vReq[reqEnd]))
+                reqEnd++;
+        }
+        if (reqEnd - reqIdx < 2) {
+            vResults[reqIdx] = JSONRPCExecOne(jreq, vReq[reqIdx]);
+            reqIdx++;
+            continue;
+        }
+
+        // Helpers that start after the run is done find nothing left and only drop their reference
+        std::shared_ptr<CRPCBatchRun> run = std::make_shared<CRPCBatchRun>();
+        run->jreq = &jreq;
+        run->vReq = &vReq;
+        run->vResults = &vResults;
+        run->nNext = reqIdx;
+        run->nEnd = reqEnd;
+        run->nPending = reqEnd - reqIdx;
+        for (size_t i = 0; i < std::min<size_t>(nHelpers, reqEnd - reqIdx - 1); i++) {
+            if (!dispatch([run]() { run->Work(); }))
+                break;
+        }
+        run->Work();
+        {
+            std::unique_lock<std::mutex> lock(run->cs);
+            run->cond.wait(lock, [&run]() { return run->nPending == 0; });
+        }
+        reqIdx = reqEnd;
+    }
+
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    for (UniValue& result : vResults)
+        ret.push_back(result);
 
     return ret.write() + "\n";
 }
@@ -499,14 +701,27 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
 
     g_rpcSignals.PreCommand(*pcmd);
 
+    std::string strCacheKey;
+    uint64_t nCacheGeneration = 0;
+    if (!request.fHelp && setCacheableRPC.count(request.strMethod) && rpcResponseCache.Enabled()) {
+        strCacheKey = request.URI + "\n" + request.strMethod + "\n" + request.params.write();
+        UniValue result;
+        if (rpcResponseCache.Get(strCacheKey, result, nCacheGeneration))
+            return result;
+    }
+
     try
     {
         // Execute, convert arguments to array if necessary
+        UniValue result;
         if (request.params.isObject()) {
-            return pcmd->actor(transformNamedArguments(request, pcmd->argNames));
+            result = pcmd->actor(transformNamedArguments(request, pcmd->argNames));
         } else {
-            return pcmd->actor(request);
+            result = pcmd->actor(request);
         }
+        if (!strCacheKey.empty() && IsCacheableResult(request.strMethod, result))
+            rpcResponseCache.Put(strCacheKey, result, nCacheGeneration);
+        return result;
     }
     catch (const std::exception& e)
     {
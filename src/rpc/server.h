@@ -19,6 +19,7 @@
 
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
 
+class CBlockIndex;
 class CRPCCommand;
 
 namespace RPCServer
@@ -199,13 +200,29 @@ extern UniValue getpoolinfo(const JSONRPCRequest& req);
 extern UniValue spork(const UniValue& params, bool fHelp);
 extern UniValue ghostnode(const JSONRPCRequest& req);
 extern UniValue ghostnodelist(const JSONRPCRequest& req);
+extern UniValue waitforghostnodestatus(const JSONRPCRequest& request);
 extern UniValue ghostnodebroadcast(const JSONRPCRequest& req);
 extern UniValue ghostnodesync(const JSONRPCRequest& req);
 
+/** Default size limit of the RPC response cache in MiB, 0 disables it */
+static const unsigned int DEFAULT_RPC_CACHE_SIZE = 0;
+
+/** Drops the cached responses, they may depend on the chain tip. Connected to NotifyBlockTip. */
+void RPCClearResponseCache(bool ibd, const CBlockIndex* pindex);
+/** Response cache statistics for getmemoryinfo */
+UniValue RPCResponseCacheInfo();
+
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq);
+/** Hands a task to another thread, returns false if it could not be queued */
+typedef std::function<bool(const std::function<void()>&)> RPCTaskDispatcher;
+/**
+ * Executes a batch of requests and returns the replies in order. Runs of read-only calls are spread
+ * over up to nHelpers extra threads through dispatch, any other call runs alone in batch order.
+ */
+std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq,
+                             const RPCTaskDispatcher& dispatch = RPCTaskDispatcher(), int nHelpers = 0);
 
 // Retrieves any serialization flags requested in command line argument
 int RPCSerializationFlags();
@@ -9,6 +9,7 @@
 
 #include <assert.h>
 #include <boost/bind.hpp>
+#include <iterator>
 #include <utility>
 
 CScheduler::CScheduler() : nThreadsServicingQueue(0), stopRequested(false), stopWhenEmpty(false)
@@ -73,8 +74,16 @@ void CScheduler::serviceQueue()
             if (shouldStop() || taskQueue.empty())
                 continue;
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            // Of the tasks that are due, run the one with the highest priority,
+            // the earliest of those if there are several
+            boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+            auto itTask = taskQueue.begin();
+            for (auto it = std::next(itTask); it != taskQueue.end() && it->first <= now; ++it) {
+                if (it->second.priority > itTask->second.priority)
+                    itTask = it;
+            }
+            Function f = std::move(itTask->second.f);
+            taskQueue.erase(itTask);
 
             {
                 // Unlock before calling f, so it can reschedule itself or another task
@@ -103,11 +112,11 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
-void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
+void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t, Priority priority)
 {
     {
         boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        taskQueue.insert(std::make_pair(t, Task{std::move(f), priority}));
     }
     newTaskScheduled.notify_one();
 }
@@ -155,7 +164,7 @@ void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue() {
         if (m_are_callbacks_running) return;
         if (m_callbacks_pending.empty()) return;
     }
-    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this));
+    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), boost::chrono::system_clock::now(), m_priority);
 }
 
 void SingleThreadedSchedulerClient::ProcessQueue() {
@@ -16,6 +16,11 @@
 
 #include <sync.h>
 
+//! -schedulerthreads default
+static const int DEFAULT_SCHEDULER_THREADS = 2;
+//! Maximum number of threads servicing the scheduler
+static const int MAX_SCHEDULER_THREADS = 16;
+
 //
 // Simple class for background tasks that should be run
 // periodically or once "after a while"
@@ -33,6 +38,9 @@
 // delete t;
 // delete s; // Must be done after thread is interrupted/joined.
 //
+// Any number of threads may run serviceQueue. Of the tasks that are due,
+// the one with the highest priority runs first.
+//
 
 class CScheduler
 {
@@ -42,8 +50,14 @@ public:
 
     typedef std::function<void(void)> Function;
 
+    enum Priority {
+        PRIORITY_LOW,
+        PRIORITY_NORMAL,
+        PRIORITY_HIGH, //!< notifications whose latency matters, such as those of the wallet and ZMQ
+    };
+
     // Call func at/after time t
-    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now());
+    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now(), Priority priority=PRIORITY_NORMAL);
 
     // Convenience method: call f once deltaSeconds from now
     void scheduleFromNow(Function f, int64_t deltaMilliSeconds);
@@ -75,7 +89,12 @@ public:
     bool AreThreadsServicingQueue() const;
 
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    struct Task {
+        Function f;
+        Priority priority;
+    };
+
+    std::multimap<boost::chrono::system_clock::time_point, Task> taskQueue;
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
@@ -93,6 +112,7 @@ private:
 class SingleThreadedSchedulerClient {
 private:
     CScheduler *m_pscheduler;
+    CScheduler::Priority m_priority;
 
     CCriticalSection m_cs_callbacks_pending;
     std::list<std::function<void (void)>> m_callbacks_pending;
@@ -102,7 +122,8 @@ private:
     void ProcessQueue();
 
 public:
-    explicit SingleThreadedSchedulerClient(CScheduler *pschedulerIn) : m_pscheduler(pschedulerIn) {}
+    explicit SingleThreadedSchedulerClient(CScheduler *pschedulerIn, CScheduler::Priority priority = CScheduler::PRIORITY_NORMAL)
+        : m_pscheduler(pschedulerIn), m_priority(priority) {}
     void AddToProcessQueue(std::function<void (void)> func);
 
     // Processes all remaining queue members on the calling thread, blocking until queue is empty
@@ -10,6 +10,7 @@
 #include <crypto/sha256.h>
 #include <pubkey.h>
 #include <script/script.h>
+#include <streams.h>
 #include <uint256.h>
 
 typedef std::vector<unsigned char> valtype;
@@ -1138,6 +1139,12 @@ public:
         ::WriteCompactSize(s, nInputs);
         for (unsigned int nInput = 0; nInput < nInputs; nInput++)
              SerializeInput(s, nInput);
+        SerializeOutputs(s);
+    }
+
+    /** Serialize the outputs and nLockTime of txTo */
+    template<typename S>
+    void SerializeOutputs(S &s) const {
         // Serialize vout
         unsigned int nOutputs = fHashNone ? 0 : (fHashSingle ? nIn+1 : txTo.vout.size());
         ::WriteCompactSize(s, nOutputs);
@@ -1148,6 +1155,58 @@ public:
     }
 };
 
+/** A CHashWriter that starts from a SHA256 midstate */
+class CMidstateHashWriter
+{
+private:
+    CSHA256 ctx;
+
+public:
+    explicit CMidstateHashWriter(const CSHA256& midstate) : ctx(midstate) {}
+
+    int GetType() const { return SER_GETHASH; }
+    int GetVersion() const { return 0; }
+
+    void write(const char *pch, size_t size) {
+        ctx.Write((const unsigned char*)pch, size);
+    }
+
+    uint256 GetHash() {
+        uint256 result;
+        ctx.Finalize(result.begin());
+        CSHA256().Write(result.begin(), CSHA256::OUTPUT_SIZE).Finalize(result.begin());
+        return result;
+    }
+
+    template<typename T>
+    CMidstateHashWriter& operator<<(const T& obj) {
+        ::Serialize(*this, obj);
+        return (*this);
+    }
+};
+
+void BuildLegacyInputs(const CTransaction& txTo, bool fZeroSequences, PrecomputedTransactionData::LegacyInputs& inputs)
+{
+    CVectorWriter s(SER_GETHASH, 0, inputs.vData, 0);
+    s << txTo.nVersion;
+    WriteCompactSize(s, txTo.vin.size());
+    inputs.vOffsets.reserve(txTo.vin.size() + 1);
+    for (const CTxIn& txin : txTo.vin) {
+        inputs.vOffsets.push_back(inputs.vData.size());
+        s << txin.prevout << CScript() << (fZeroSequences ? 0 : txin.nSequence);
+    }
+    inputs.vOffsets.push_back(inputs.vData.size());
+
+    CSHA256 sha;
+    size_t nHashed = 0;
+    inputs.vMidstates.reserve(txTo.vin.size());
+    for (size_t i = 0; i < txTo.vin.size(); i++) {
+        sha.Write(inputs.vData.data() + nHashed, inputs.vOffsets[i] - nHashed);
+        nHashed = inputs.vOffsets[i];
+        inputs.vMidstates.push_back(sha);
+    }
+}
+
 uint256 GetPrevoutHash(const CTransaction& txTo) {
     CHashWriter ss(SER_GETHASH, 0);
     for (const auto& txin : txTo.vin) {
@@ -1174,15 +1233,23 @@ uint256 GetOutputsHash(const CTransaction& txTo) {
 
 } // namespace
 
-PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
+PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo, bool fSigning)
 {
     // Cache is calculated only for transactions with witness
-    if (txTo.HasWitness()) {
+    if (fSigning || txTo.HasWitness()) {
         hashPrevouts = GetPrevoutHash(txTo);
         hashSequence = GetSequenceHash(txTo);
         hashOutputs = GetOutputsHash(txTo);
         ready = true;
     }
+
+    if (fSigning) {
+        BuildLegacyInputs(txTo, false, legacyInputs);
+        BuildLegacyInputs(txTo, true, legacyInputsNoSequence);
+        CVectorWriter s(SER_GETHASH, 0, vLegacyOutputs, 0);
+        s << txTo.vout << txTo.nLockTime;
+        legacyready = true;
+    }
 }
 
 uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const CAmount& amount, SigVersion sigversion, const PrecomputedTransactionData* cache)
@@ -1248,6 +1315,22 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
+    if (cache && cache->legacyready && !(nHashType & SIGHASH_ANYONECANPAY)) {
+        // Carry on from the inputs before nIn, their serialization does not depend on it
+        const bool fZeroSequences = (nHashType & 0x1f) == SIGHASH_SINGLE || (nHashType & 0x1f) == SIGHASH_NONE;
+        const PrecomputedTransactionData::LegacyInputs& inputs = fZeroSequences ? cache->legacyInputsNoSequence : cache->legacyInputs;
+        CMidstateHashWriter ss(inputs.vMidstates[nIn]);
+        txTmp.SerializeInput(ss, nIn);
+        const size_t nNext = inputs.vOffsets[nIn + 1];
+        ss.write((const char*)inputs.vData.data() + nNext, inputs.vData.size() - nNext);
+        if (fZeroSequences)
+            txTmp.SerializeOutputs(ss);
+        else
+            ss.write((const char*)cache->vLegacyOutputs.data(), cache->vLegacyOutputs.size());
+        ss << nHashType;
+        return ss.GetHash();
+    }
+
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
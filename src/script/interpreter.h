@@ -6,6 +6,7 @@
 #ifndef BITCOIN_SCRIPT_INTERPRETER_H
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
+#include <crypto/sha256.h>
 #include <script/script_error.h>
 #include <primitives/transaction.h>
 
@@ -120,7 +121,25 @@ struct PrecomputedTransactionData
     uint256 hashPrevouts, hashSequence, hashOutputs;
     bool ready = false;
 
-    explicit PrecomputedTransactionData(const CTransaction& tx);
+    /**
+     * The inputs of a legacy signature hash, with the scripts of the inputs blanked out and
+     * their own or zeroed sequences, and the SHA256 midstates at the start of every input,
+     * so the hash of an input only covers the inputs that follow it.
+     */
+    struct LegacyInputs
+    {
+        std::vector<unsigned char> vData;
+        std::vector<size_t> vOffsets;
+        std::vector<CSHA256> vMidstates;
+    };
+    LegacyInputs legacyInputs, legacyInputsNoSequence;
+    //! Serialized outputs and lock time of a legacy SIGHASH_ALL hash
+    std::vector<unsigned char> vLegacyOutputs;
+    bool legacyready = false;
+
+    //! Signers hash every input of the transaction, for them the cache is computed without
+    //! witnesses and for the legacy signature hash as well
+    explicit PrecomputedTransactionData(const CTransaction& tx, bool fSigning = false);
 };
 
 enum SigVersion
@@ -10,6 +10,11 @@
 #include <script/interpreter.h>
 #include <version.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
 namespace {
 
 /** A class that deserializes a single CTransaction one time. */
@@ -122,6 +127,67 @@ int bitcoinconsensus_verify_script(const unsigned char *scriptPubKey, unsigned i
     return ::verify_script(scriptPubKey, scriptPubKeyLen, am, txTo, txToLen, nIn, flags, err);
 }
 
+int bitcoinconsensus_verify_transaction(const unsigned char *txTo, unsigned int txToLen,
+                                        const bitcoinconsensus_spent_output *spentOutputs, unsigned int spentOutputsLen,
+                                        unsigned int flags, unsigned int nThreads,
+                                        unsigned int* failedInput, bitcoinconsensus_error* err)
+{
+    if (!verify_flags(flags)) {
+        return set_error(err, bitcoinconsensus_ERR_INVALID_FLAGS);
+    }
+    try {
+        TxInputStream stream(SER_NETWORK, PROTOCOL_VERSION, txTo, txToLen);
+        CTransaction tx(deserialize, stream);
+        if (GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION) != txToLen)
+            return set_error(err, bitcoinconsensus_ERR_TX_SIZE_MISMATCH);
+        if (spentOutputs == nullptr || spentOutputsLen != tx.vin.size())
+            return set_error(err, bitcoinconsensus_ERR_SPENT_OUTPUTS_MISMATCH);
+
+        // Regardless of the verification result, the tx did not error.
+        set_error(err, bitcoinconsensus_ERR_OK);
+
+        const PrecomputedTransactionData txdata(tx);
+        const unsigned int nInputs = tx.vin.size();
+        std::atomic<unsigned int> nFailed(nInputs);
+
+        // each thread takes a contiguous range of inputs, a range stops early
+        // once a lower input is known to be invalid
+        auto verify_range = [&](unsigned int nBegin, unsigned int nEnd) {
+            for (unsigned int nIn = nBegin; nIn < nEnd && nIn < nFailed.load(std::memory_order_relaxed); nIn++) {
+                const bitcoinconsensus_spent_output& spent = spentOutputs[nIn];
+                CScript scriptPubKey(spent.scriptPubKey, spent.scriptPubKey + spent.scriptPubKeyLen);
+                if (!VerifyScript(tx.vin[nIn].scriptSig, scriptPubKey, &tx.vin[nIn].scriptWitness, flags, TransactionSignatureChecker(&tx, nIn, spent.value, txdata), tx.IsCoinStake(), nullptr)) {
+                    unsigned int nPrev = nFailed.load();
+                    while (nIn < nPrev && !nFailed.compare_exchange_weak(nPrev, nIn)) {}
+                    return;
+                }
+            }
+        };
+
+        nThreads = std::max(1u, std::min(nThreads, nInputs));
+        if (nThreads == 1) {
+            verify_range(0, nInputs);
+        } else {
+            std::vector<std::thread> vThreads;
+            unsigned int nPerThread = (nInputs + nThreads - 1) / nThreads;
+            for (unsigned int nBegin = nPerThread; nBegin < nInputs; nBegin += nPerThread)
+                vThreads.emplace_back(verify_range, nBegin, std::min(nBegin + nPerThread, nInputs));
+            verify_range(0, std::min(nPerThread, nInputs));
+            for (std::thread& thread : vThreads)
+                thread.join();
+        }
+
+        if (nFailed < nInputs) {
+            if (failedInput)
+                *failedInput = nFailed;
+            return 0;
+        }
+        return 1;
+    } catch (const std::exception&) {
+        return set_error(err, bitcoinconsensus_ERR_TX_DESERIALIZE); // Error deserializing
+    }
+}
+
 unsigned int bitcoinconsensus_version()
 {
     // Just use the API version for now
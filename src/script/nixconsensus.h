@@ -33,7 +33,7 @@
 extern "C" {
 #endif
 
-#define BITCOINCONSENSUS_API_VER 1
+#define BITCOINCONSENSUS_API_VER 2
 
 typedef enum bitcoinconsensus_error_t
 {
@@ -43,8 +43,29 @@ typedef enum bitcoinconsensus_error_t
     bitcoinconsensus_ERR_TX_DESERIALIZE,
     bitcoinconsensus_ERR_AMOUNT_REQUIRED,
     bitcoinconsensus_ERR_INVALID_FLAGS,
+    bitcoinconsensus_ERR_SPENT_OUTPUTS_MISMATCH,
+    bitcoinconsensus_ERR_SIGMA_SPEND_DESERIALIZE,
+    bitcoinconsensus_ERR_ANONYMITY_SET,
 } bitcoinconsensus_error;
 
+/** An output spent by a transaction input, see bitcoinconsensus_verify_transaction */
+typedef struct bitcoinconsensus_spent_output
+{
+    const unsigned char *scriptPubKey;
+    unsigned int scriptPubKeyLen;
+    int64_t value;
+} bitcoinconsensus_spent_output;
+
+/** A Sigma spend checked by nixconsensus_verify_sigma_spends */
+typedef struct nixconsensus_sigma_spend
+{
+    const unsigned char *spend;         //!< the serialized spend, the scriptSig of its input past OP_SIGMASPEND
+    unsigned int spendLen;
+    unsigned int coinGroupId;           //!< the coin group spent from, the prevout index of the input
+    const unsigned char *metaDataHash;  //!< 32 bytes, the sigma metadata hash of the spending transaction
+    unsigned int anonymitySetSize;      //!< number of coins of the anonymity set the spend is made against
+} nixconsensus_sigma_spend;
+
 /** Script verification flags */
 enum
 {
@@ -72,6 +93,38 @@ EXPORT_SYMBOL int bitcoinconsensus_verify_script_with_amount(const unsigned char
                                     const unsigned char *txTo        , unsigned int txToLen,
                                     unsigned int nIn, unsigned int flags, bitcoinconsensus_error* err);
 
+/// Returns 1 if every input of the serialized transaction pointed to by txTo
+/// correctly spends its output in spentOutputs, spentOutputs[i] being the output
+/// spent by input i, under the additional constraints specified by flags.
+/// The transaction is deserialized and its signature hashes precomputed once for
+/// all inputs, which are checked on up to nThreads threads (0 or 1 checks them
+/// on the calling thread).
+/// If not nullptr, failedInput will contain the lowest invalid input when 0 is
+/// returned with bitcoinconsensus_ERR_OK, and err an error/success code for the operation
+EXPORT_SYMBOL int bitcoinconsensus_verify_transaction(const unsigned char *txTo, unsigned int txToLen,
+                                                      const bitcoinconsensus_spent_output *spentOutputs, unsigned int spentOutputsLen,
+                                                      unsigned int flags, unsigned int nThreads,
+                                                      unsigned int* failedInput, bitcoinconsensus_error* err);
+
+/// Returns 1 if the serialized Sigma spend pointed to by spend is a valid spend from
+/// coin group coinGroupId, signed over metaDataHash (32 bytes). anonymitySet holds
+/// the coins of the group as 34 byte serialized points, in the order the node keeps
+/// them: the spend is made against all of them, taken in reverse order.
+/// The serial number is not checked against the spent serials, that is up to the caller.
+/// If not nullptr, err will contain an error/success code for the operation
+EXPORT_SYMBOL int nixconsensus_verify_sigma_spend(const unsigned char *spend, unsigned int spendLen,
+                                                  unsigned int coinGroupId, const unsigned char *metaDataHash,
+                                                  const unsigned char *anonymitySet, unsigned int anonymitySetLen,
+                                                  bitcoinconsensus_error* err);
+
+/// Same as above for several spends of the same denomination and coin group, whose
+/// proofs are verified together. Spend k is made against the first
+/// spends[k].anonymitySetSize coins of anonymitySet, taken in reverse order.
+/// Returns 1 if every spend is valid, a failed batch doesn't tell which spend is invalid.
+EXPORT_SYMBOL int nixconsensus_verify_sigma_spends(const nixconsensus_sigma_spend *spends, unsigned int spendsLen,
+                                                   const unsigned char *anonymitySet, unsigned int anonymitySetLen,
+                                                   bitcoinconsensus_error* err);
+
 EXPORT_SYMBOL unsigned int bitcoinconsensus_version();
 
 #ifdef __cplusplus
@@ -0,0 +1,127 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <script/nixconsensus.h>
+
+#include <sigma/coinspend.h>
+#include <sigma/params.h>
+#include <streams.h>
+#include <uint256.h>
+#include <version.h>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+inline int set_error(bitcoinconsensus_error* ret, bitcoinconsensus_error serror)
+{
+    if (ret)
+        *ret = serror;
+    return 0;
+}
+
+/** Read the serialized points of an anonymity set, false if any is malformed */
+bool ParseAnonymitySet(const unsigned char *anonymitySet, unsigned int anonymitySetLen, std::vector<GroupElement>& coins)
+{
+    if (anonymitySet == nullptr || anonymitySetLen == 0 || anonymitySetLen % GroupElement::serialize_size != 0)
+        return false;
+
+    unsigned char buffer[GroupElement::serialize_size];
+    coins.resize(anonymitySetLen / GroupElement::serialize_size);
+    for (std::size_t i = 0; i < coins.size(); i++) {
+        memcpy(buffer, anonymitySet + i * GroupElement::serialize_size, sizeof(buffer));
+        coins[i].deserialize(buffer);
+    }
+    return GroupElement::areMembers(coins);
+}
+
+/** Deserialize a spend and check everything but its sigma proof */
+bool ParseSpend(const sigma::Params* params, const nixconsensus_sigma_spend& in, std::unique_ptr<sigma::CoinSpend>& spend, bitcoinconsensus_error* err)
+{
+    if (in.spend == nullptr || in.metaDataHash == nullptr) {
+        set_error(err, bitcoinconsensus_ERR_SIGMA_SPEND_DESERIALIZE);
+        return false;
+    }
+    try {
+        CDataStream stream((const char*)in.spend, (const char*)in.spend + in.spendLen, SER_NETWORK, PROTOCOL_VERSION);
+        spend.reset(new sigma::CoinSpend(params, stream));
+        if (!stream.empty()) {
+            set_error(err, bitcoinconsensus_ERR_SIGMA_SPEND_DESERIALIZE);
+            return false;
+        }
+    } catch (const std::exception&) {
+        set_error(err, bitcoinconsensus_ERR_SIGMA_SPEND_DESERIALIZE);
+        return false;
+    }
+
+    if (spend->getVersion() != sigma::SIGMA_VERSION_1 && spend->getVersion() != sigma::SIGMA_VERSION_2)
+        return false;
+    if (!spend->HasValidSerial())
+        return false;
+
+    uint256 metaDataHash;
+    memcpy(metaDataHash.begin(), in.metaDataHash, metaDataHash.size());
+    sigma::SpendMetaData metaData(in.coinGroupId, spend->getAccumulatorBlockHash(), metaDataHash);
+    return spend->VerifySignature(metaData);
+}
+
+} // namespace
+
+int nixconsensus_verify_sigma_spends(const nixconsensus_sigma_spend *spends, unsigned int spendsLen,
+                                     const unsigned char *anonymitySet, unsigned int anonymitySetLen,
+                                     bitcoinconsensus_error* err)
+{
+    if (spends == nullptr || spendsLen == 0)
+        return set_error(err, bitcoinconsensus_ERR_SIGMA_SPEND_DESERIALIZE);
+
+    std::vector<GroupElement> coins;
+    if (!ParseAnonymitySet(anonymitySet, anonymitySetLen, coins))
+        return set_error(err, bitcoinconsensus_ERR_ANONYMITY_SET);
+
+    // Regardless of the verification result, the input is well formed unless found otherwise below.
+    set_error(err, bitcoinconsensus_ERR_OK);
+
+    const sigma::Params* params = sigma::Params::get_default();
+    std::vector<std::unique_ptr<sigma::CoinSpend>> parsed(spendsLen);
+    std::vector<const sigma::CoinSpend*> vSpends;
+    std::vector<std::size_t> setSizes;
+    std::vector<bool> fPadding;
+    for (unsigned int i = 0; i < spendsLen; i++) {
+        if (spends[i].anonymitySetSize == 0 || spends[i].anonymitySetSize > coins.size() ||
+                spends[i].coinGroupId != spends[0].coinGroupId)
+            return set_error(err, bitcoinconsensus_ERR_ANONYMITY_SET);
+
+        bitcoinconsensus_error spendErr = bitcoinconsensus_ERR_OK;
+        if (!ParseSpend(params, spends[i], parsed[i], &spendErr))
+            return set_error(err, spendErr);
+        if (parsed[i]->getDenomination() != parsed[0]->getDenomination())
+            return set_error(err, bitcoinconsensus_ERR_ANONYMITY_SET);
+
+        vSpends.push_back(parsed[i].get());
+        setSizes.push_back(spends[i].anonymitySetSize);
+        fPadding.push_back(parsed[i]->getVersion() >= sigma::SIGMA_VERSION_2);
+    }
+
+    try {
+        return sigma::CoinSpend::BatchVerify(params, coins, vSpends, setSizes, fPadding) ? 1 : 0;
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+int nixconsensus_verify_sigma_spend(const unsigned char *spend, unsigned int spendLen,
+                                    unsigned int coinGroupId, const unsigned char *metaDataHash,
+                                    const unsigned char *anonymitySet, unsigned int anonymitySetLen,
+                                    bitcoinconsensus_error* err)
+{
+    nixconsensus_sigma_spend in;
+    in.spend = spend;
+    in.spendLen = spendLen;
+    in.coinGroupId = coinGroupId;
+    in.metaDataHash = metaDataHash;
+    in.anonymitySetSize = anonymitySetLen / GroupElement::serialize_size;
+    return nixconsensus_verify_sigma_spends(&in, 1, anonymitySet, anonymitySetLen, err);
+}
@@ -148,6 +148,7 @@ const char* GetOpName(opcodetype opcode)
     // sigma
     case OP_SIGMAMINT              : return "OP_SIGMAMINT";
     case OP_SIGMASPEND             : return "OP_SIGMASPEND";
+    case OP_SIGMASPENDV3           : return "OP_SIGMASPENDV3";
 
     case OP_ISCOINSTAKE            : return "OP_ISCOINSTAKE";
 
@@ -602,5 +603,10 @@ bool CScript::IsSigmaMint() const
 
 bool CScript::IsSigmaSpend() const {
     return (this->size() > 0 &&
-            (*this)[0] == OP_SIGMASPEND);
+            ((*this)[0] == OP_SIGMASPEND || (*this)[0] == OP_SIGMASPENDV3));
+}
+
+bool CScript::IsCompactSigmaSpend() const {
+    return (this->size() > 0 &&
+            (*this)[0] == OP_SIGMASPENDV3);
 }
@@ -199,6 +199,7 @@ enum opcodetype
     // sigma params
     OP_SIGMAMINT = 0xc3,
     OP_SIGMASPEND = 0xc4,
+    OP_SIGMASPENDV3 = 0xc5, // sigma spend in the compact encoding of sigma::SIGMA_VERSION_3
 };
 
 // Maximum value that an opcode can be
@@ -703,6 +704,8 @@ public:
     //Sigma params
     bool IsSigmaMint() const;
     bool IsSigmaSpend() const;
+    //! Sigma spend in the compact encoding, after OP_SIGMASPENDV3
+    bool IsCompactSigmaSpend() const;
 };
 
 struct CScriptWitness
@@ -12,10 +12,13 @@
 #include <script/standard.h>
 #include <uint256.h>
 
+#include <atomic>
+#include <thread>
 
 typedef std::vector<unsigned char> valtype;
 
-TransactionSignatureCreator::TransactionSignatureCreator(const CKeyStore* keystoreIn, const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, int nHashTypeIn) : BaseSignatureCreator(keystoreIn), txTo(txToIn), nIn(nInIn), nHashType(nHashTypeIn), amount(amountIn), checker(txTo, nIn, amountIn) {}
+TransactionSignatureCreator::TransactionSignatureCreator(const CKeyStore* keystoreIn, const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, int nHashTypeIn) : BaseSignatureCreator(keystoreIn), txTo(txToIn), nIn(nInIn), nHashType(nHashTypeIn), amount(amountIn), txdata(nullptr), checker(txTo, nIn, amountIn) {}
+TransactionSignatureCreator::TransactionSignatureCreator(const CKeyStore* keystoreIn, const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, int nHashTypeIn, const PrecomputedTransactionData& txdataIn) : BaseSignatureCreator(keystoreIn), txTo(txToIn), nIn(nInIn), nHashType(nHashTypeIn), amount(amountIn), txdata(&txdataIn), checker(txTo, nIn, amountIn, txdataIn) {}
 
 bool TransactionSignatureCreator::CreateSig(std::vector<unsigned char>& vchSig, const CKeyID& address, const CScript& scriptCode, SigVersion sigversion) const
 {
@@ -27,7 +30,7 @@ bool TransactionSignatureCreator::CreateSig(std::vector<unsigned char>& vchSig,
     if (sigversion == SIGVERSION_WITNESS_V0 && !key.IsCompressed())
         return false;
 
-    uint256 hash = SignatureHash(scriptCode, *txTo, nIn, nHashType, amount, sigversion);
+    uint256 hash = SignatureHash(scriptCode, *txTo, nIn, nHashType, amount, sigversion, txdata);
     if (!key.Sign(hash, vchSig))
         return false;
     vchSig.push_back((unsigned char)nHashType);
@@ -239,6 +242,67 @@ bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CMutabl
     return ret;
 }
 
+bool SignTransaction(CMutableTransaction& mtx, const CKeyStore& keystore, const std::vector<CTxOut>& vSpent, int nHashType, std::vector<ScriptError>& vErrors, int nThreads)
+{
+    assert(vSpent.size() == mtx.vin.size());
+
+    // The signature hashes blank out the scripts of the other inputs, so all inputs can be
+    // signed against the unsigned transaction
+    const CTransaction txConst(mtx);
+    const PrecomputedTransactionData txdata(txConst, true);
+    const bool fHashSingle = ((nHashType & ~SIGHASH_ANYONECANPAY) == SIGHASH_SINGLE);
+    const bool isCoinstake = txConst.IsCoinStake();
+
+    std::vector<SignatureData> vSigData(mtx.vin.size());
+    vErrors.assign(mtx.vin.size(), SCRIPT_ERR_UNKNOWN_ERROR);
+    auto signInput = [&](unsigned int i) {
+        if (vSpent[i].IsNull())
+            return;
+        const CScript& prevPubKey = vSpent[i].scriptPubKey;
+        const CAmount& amount = vSpent[i].nValue;
+
+        SignatureData& sigdata = vSigData[i];
+        // Only sign SIGHASH_SINGLE if there's a corresponding output:
+        if (!fHashSingle || (i < txConst.vout.size()))
+            ProduceSignature(TransactionSignatureCreator(&keystore, &txConst, i, amount, nHashType, txdata), prevPubKey, sigdata, isCoinstake);
+        const TransactionSignatureChecker checker(&txConst, i, amount, txdata);
+        sigdata = CombineSignatures(prevPubKey, checker, sigdata, DataFromTransaction(mtx, i), isCoinstake);
+
+        ScriptError serror = SCRIPT_ERR_OK;
+        VerifyScript(sigdata.scriptSig, prevPubKey, &sigdata.scriptWitness, STANDARD_SCRIPT_VERIFY_FLAGS, checker, isCoinstake, &serror);
+        vErrors[i] = serror;
+    };
+
+    nThreads = std::max(1, std::min<int>(nThreads, mtx.vin.size()));
+    if (nThreads == 1) {
+        for (unsigned int i = 0; i < mtx.vin.size(); i++)
+            signInput(i);
+    } else {
+        std::atomic<unsigned int> nNext(0);
+        std::vector<std::thread> vThreads;
+        for (int t = 0; t < nThreads; t++) {
+            vThreads.emplace_back([&]() {
+                for (unsigned int i = nNext++; i < txConst.vin.size(); i = nNext++)
+                    signInput(i);
+            });
+        }
+        for (std::thread& thread : vThreads)
+            thread.join();
+    }
+
+    bool fComplete = true;
+    for (unsigned int i = 0; i < mtx.vin.size(); i++) {
+        if (vSpent[i].IsNull()) {
+            fComplete = false;
+            continue;
+        }
+        UpdateTransaction(mtx, i, vSigData[i]);
+        if (vErrors[i] != SCRIPT_ERR_OK)
+            fComplete = false;
+    }
+    return fComplete;
+}
+
 bool SignSignature(const CKeyStore &keystore, const CTransaction& txFrom, CMutableTransaction& txTo, unsigned int nIn, int nHashType)
 {
     assert(nIn < txTo.vin.size());
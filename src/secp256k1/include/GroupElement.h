@@ -15,20 +15,26 @@ namespace secp_primitives {
 class GroupElement final {
 public:
     static constexpr std::size_t serialize_size = 34;
+    static constexpr std::size_t compressed_size = 33;
+    // Size of the storage for the secp256k1_gej
+    static constexpr std::size_t value_size = 128;
 
 public:
 
   GroupElement();
 
-  ~GroupElement();
+  ~GroupElement() = default;
 
-  GroupElement(const GroupElement& other);
+  // Copy and move only copy the inline point.
+  GroupElement(const GroupElement& other) noexcept = default;
+  GroupElement(GroupElement&& other) noexcept = default;
 
   GroupElement(const char* x,const char* y,  int base = 10);
 
   GroupElement& set(const GroupElement& other);
 
-  GroupElement& operator=(const GroupElement& other);
+  GroupElement& operator=(const GroupElement& other) noexcept = default;
+  GroupElement& operator=(GroupElement&& other) noexcept = default;
 
   // Operator for multiplying with a scalar number.
   GroupElement operator*(const Scalar& multiplier) const;
@@ -54,6 +60,14 @@ public:
 
   bool isInfinity() const;
 
+  // Same as calling isMember() on every element, but with one field
+  // inversion for the whole vector instead of one per element.
+  static bool areMembers(const std::vector<GroupElement>& elements);
+
+  // Brings all elements to affine form (z = 1) with one field inversion,
+  // after which serializing or checking them needs no inversion at all.
+  static void normalize(std::vector<GroupElement>& elements);
+
   GroupElement& generate(unsigned char* seed);
 
   void sha256(unsigned char* result) const;
@@ -74,6 +88,11 @@ public:
   unsigned char* serialize(unsigned char* buffer) const;
   unsigned char* deserialize(unsigned char* buffer);
 
+  // Standard 33 byte compressed encoding, the point at infinity is 33 zero bytes.
+  unsigned char* serializeCompressed(unsigned char* buffer) const;
+  // Returns nullptr unless the bytes are the compressed encoding of a point on the curve.
+  const unsigned char* deserializeCompressed(const unsigned char* buffer);
+
   // These functions are for READWRITE() in serialize.h
   unsigned int GetSerializeSize() const
   {
@@ -104,6 +123,7 @@ public:
   std::size_t hash() const;
 
   friend class MultiExponent;
+  friend class MultiExponentTable;
 private:
     // Returns the secp object inside it.
     const void * get_value() const;
@@ -111,7 +131,9 @@ private:
     GroupElement(const void *g);
 
 private:
-    void *g_; // secp256k1_gej
+    // The secp256k1_gej is kept inline, so temporaries and vector elements
+    // don't need an allocation of their own. A point fills two cache lines.
+    alignas(16) unsigned char g_[value_size];
 
 };
 
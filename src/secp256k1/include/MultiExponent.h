@@ -1,24 +1,50 @@
 #ifndef SECP_MULTIEXPONENT_H
 #define SECP_MULTIEXPONENT_H
 
+#include <cstddef>
 #include <vector>
 #include "GroupElement.h"
 #include "Scalar.h"
 
 namespace secp_primitives {
 
+// Computes the sum of generators[i] * powers[i]. The generators and powers are
+// not copied, they must outlive the MultiExponent.
 class MultiExponent final {
 public:
-    MultiExponent(const MultiExponent& other);
     MultiExponent(const std::vector<GroupElement>& generators, const std::vector<Scalar>& powers);
-    ~MultiExponent();
+    MultiExponent(const GroupElement* generators, const Scalar* powers, std::size_t n_points);
+    // Generators gathered from several places by address, so large sets like an
+    // anonymity set can take part without being copied next to the others.
+    MultiExponent(const std::vector<const GroupElement*>& generators, const std::vector<Scalar>& powers);
 
-    GroupElement get_multiple();
+    GroupElement get_multiple() const;
 
 private:
-    void  *sc_; // secp256k1_scalar[]
-    void  *pt_; // secp256k1_gej[]
-    int n_points;
+    const GroupElement* generators_;
+    // Used instead of generators_ when not null
+    const GroupElement* const* generator_ptrs_;
+    const Scalar* powers_;
+    std::size_t n_points;
+};
+
+// Precomputed odd multiples of a fixed list of generators, for multi-exponentiations
+// repeated over the same generators with different powers.
+class MultiExponentTable final {
+public:
+    explicit MultiExponentTable(const std::vector<GroupElement>& generators);
+    MultiExponentTable(const MultiExponentTable& other) = delete;
+    MultiExponentTable& operator=(const MultiExponentTable& other) = delete;
+    ~MultiExponentTable();
+
+    std::size_t size() const { return n_points; }
+
+    // Sum of generators[i] * powers[i] over the first powers.size() generators.
+    GroupElement get_multiple(const std::vector<Scalar>& powers) const;
+
+private:
+    void *pre_; // secp256k1_ge_storage[]
+    std::size_t n_points;
 };
 
 }// namespace secp_primitives
@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 
+#include <cstddef>
+
 #include <inttypes.h>
 #include <stddef.h>
 
@@ -18,16 +20,18 @@ public:
     // Constructor from interger.
     Scalar(uint64_t value);
 
-    // Copy constructor
-    Scalar(const Scalar& other);
+    // Copy and move only copy the inline value.
+    Scalar(const Scalar& other) noexcept = default;
+    Scalar(Scalar&& other) noexcept = default;
 
     Scalar(const unsigned char* str);
 
-    ~Scalar();
+    ~Scalar() = default;
 
     Scalar& set(const Scalar& other);
 
-    Scalar& operator=(const Scalar& other);
+    Scalar& operator=(const Scalar& other) noexcept = default;
+    Scalar& operator=(Scalar&& other) noexcept = default;
 
     Scalar& operator=(unsigned int i);
 
@@ -87,7 +91,7 @@ public:
     unsigned char* deserialize(unsigned char* buffer);
 
     std::string GetHex() const;
-    void SetHex(const std::string& str) const;
+    void SetHex(const std::string& str);
 
     // These functions are for READWRITE() in serialize.h
 
@@ -120,8 +124,15 @@ private:
     // Constructor from secp object.
     Scalar(const void *value);
 
+public:
+    // Size of the storage for the secp256k1_scalar
+    static constexpr std::size_t value_size = 32;
+
 private:
-    void *value_; // secp256k1_scalar
+    // The secp256k1_scalar is kept inline, so temporaries and vector
+    // elements don't need an allocation of their own. Two scalars share
+    // a cache line.
+    alignas(16) unsigned char value_[value_size];
 
 };
 
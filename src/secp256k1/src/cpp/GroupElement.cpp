@@ -26,12 +26,44 @@ static secp256k1_ecmult_context ctx;
 // Converts the value from secp256k1_gej to secp256k1_ge and returns.
 static secp256k1_ge gej_to_ge(const secp256k1_gej &gej)
 {
+    static const secp256k1_fe one = SECP256K1_FE_CONST(0, 0, 0, 0, 0, 0, 0, 1);
+
     secp256k1_ge ge;
+    // Deserialized and normalized points already have z = 1, skip the inversion.
+    secp256k1_fe z(gej.z);
+    secp256k1_fe_normalize_var(&z);
+    if (!gej.infinity && secp256k1_fe_cmp_var(&z, &one) == 0) {
+        secp256k1_ge_set_xy(&ge, &gej.x, &gej.y);
+        return ge;
+    }
+
     secp256k1_gej j(gej);
     secp256k1_ge_set_gej(&ge, &j);
     return ge;
 }
 
+// Converts len points at the cost of a single field inversion,
+// like secp256k1_ge_set_all_gej_var but without the callback.
+static void gej_to_ge_all(secp256k1_ge *r, const secp256k1_gej *a, std::size_t len)
+{
+    std::vector<secp256k1_fe> az;
+    az.reserve(len);
+    for (std::size_t i = 0; i < len; ++i) {
+        if (!a[i].infinity)
+            az.push_back(a[i].z);
+    }
+
+    std::vector<secp256k1_fe> azi(az.size());
+    secp256k1_fe_inv_all_var(azi.data(), az.data(), az.size());
+
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < len; ++i) {
+        r[i].infinity = a[i].infinity;
+        if (!a[i].infinity)
+            secp256k1_ge_set_gej_zinv(&r[i], &a[i], &azi[count++]);
+    }
+}
+
 //	Implements the algorithm from:
 //   Indifferentiable Hashing to Barreto-Naehrig Curves
 //    Pierre-Alain Fouque and Mehdi Tibouchi
@@ -159,22 +191,19 @@ static void _negate (uint8_t(&num) [Len])
     }
 }
 
+static_assert(sizeof(secp256k1_gej) <= GroupElement::value_size, "GroupElement storage too small for secp256k1_gej");
+static_assert(alignof(secp256k1_gej) <= 16, "GroupElement storage not aligned for secp256k1_gej");
+
 GroupElement::GroupElement()
-        : g_(new secp256k1_gej())
 {
     auto g = reinterpret_cast<secp256k1_gej *>(g_);
     secp256k1_gej_clear(g);
     g->infinity = 1;
 }
 
-GroupElement::GroupElement(const GroupElement& other)
-        : g_(new secp256k1_gej(*reinterpret_cast<secp256k1_gej *>(other.g_)))
-{
-}
-
 GroupElement::GroupElement(const void *g)
-        : g_(new secp256k1_gej(*reinterpret_cast<const secp256k1_gej *>(g)))
 {
+    *reinterpret_cast<secp256k1_gej *>(g_) = *reinterpret_cast<const secp256k1_gej *>(g);
 }
 
 static void _convertToFieldElement(secp256k1_fe *r, const char* str, int base) {
@@ -225,7 +254,6 @@ static void _convertToFieldElement(secp256k1_fe *r, const char* str, int base) {
 }
 
 GroupElement::GroupElement(const char* x,const char* y, int base)
-        : g_(new secp256k1_gej())
 {
     auto g = reinterpret_cast<secp256k1_gej *>(g_);
 
@@ -237,19 +265,9 @@ GroupElement::GroupElement(const char* x,const char* y, int base)
     secp256k1_gej_set_ge(g,&element);
 }
 
-GroupElement::~GroupElement()
-{
-    delete reinterpret_cast<secp256k1_gej *>(g_);
-}
-
-GroupElement& GroupElement::operator=(const GroupElement &other)
-{
-    return set(other);
-}
-
 GroupElement& GroupElement::set(const GroupElement &other)
 {
-    *reinterpret_cast<secp256k1_gej *>(g_) = *reinterpret_cast<secp256k1_gej *>(other.g_);
+    *reinterpret_cast<secp256k1_gej *>(g_) = *reinterpret_cast<const secp256k1_gej *>(other.g_);
     return *this;
 }
 
@@ -258,7 +276,7 @@ GroupElement GroupElement::operator*(const Scalar& multiplier) const
     secp256k1_gej result;
     secp256k1_scalar ng;
     secp256k1_scalar_set_int(&ng,0);
-    secp256k1_ecmult(&ctx,&result,reinterpret_cast<secp256k1_gej *>(g_), reinterpret_cast<const secp256k1_scalar *>(multiplier.get_value()),&ng);
+    secp256k1_ecmult(&ctx,&result,reinterpret_cast<const secp256k1_gej *>(g_), reinterpret_cast<const secp256k1_scalar *>(multiplier.get_value()),&ng);
     return &result;
 }
 
@@ -274,21 +292,21 @@ GroupElement& GroupElement::operator*=(const Scalar& multiplier)
 GroupElement GroupElement::operator+(const GroupElement &other) const
 {
     secp256k1_gej result_gej;
-    secp256k1_gej_add_var(&result_gej, reinterpret_cast<secp256k1_gej *>(g_), reinterpret_cast<secp256k1_gej *>(other.g_), NULL);
+    secp256k1_gej_add_var(&result_gej, reinterpret_cast<const secp256k1_gej *>(g_), reinterpret_cast<const secp256k1_gej *>(other.g_), NULL);
     return &result_gej;
 }
 
 GroupElement& GroupElement::operator+=(const GroupElement& other)
 {
     auto g = reinterpret_cast<secp256k1_gej *>(g_);
-    secp256k1_gej_add_var(g, g, reinterpret_cast<secp256k1_gej *>(other.g_), NULL);
+    secp256k1_gej_add_var(g, g, reinterpret_cast<const secp256k1_gej *>(other.g_), NULL);
     return *this;
 }
 
 GroupElement GroupElement::inverse() const
 {
     secp256k1_gej result_gej;
-    secp256k1_gej_neg(&result_gej,reinterpret_cast<secp256k1_gej *>(g_));
+    secp256k1_gej_neg(&result_gej,reinterpret_cast<const secp256k1_gej *>(g_));
     return &result_gej;
 }
 
@@ -300,8 +318,8 @@ void GroupElement::square()
 
 bool GroupElement::operator==(const  GroupElement& other) const
 {
-    auto g = reinterpret_cast<secp256k1_gej *>(g_);
-    auto og = reinterpret_cast<secp256k1_gej *>(other.g_);
+    auto g = reinterpret_cast<const secp256k1_gej *>(g_);
+    auto og = reinterpret_cast<const secp256k1_gej *>(other.g_);
 
     if(g->infinity && og->infinity)
         return true;
@@ -324,7 +342,7 @@ bool GroupElement::operator!=(const  GroupElement& other) const
 
 bool GroupElement::isMember() const
 {
-    secp256k1_ge v1 = gej_to_ge(*reinterpret_cast<secp256k1_gej *>(g_));
+    secp256k1_ge v1 = gej_to_ge(*reinterpret_cast<const secp256k1_gej *>(g_));
     if (secp256k1_ge_is_infinity(&v1)) {
         return true;
     }
@@ -336,6 +354,35 @@ bool GroupElement::isInfinity() const
     return secp256k1_gej_is_infinity(reinterpret_cast<const secp256k1_gej *>(g_));
 }
 
+bool GroupElement::areMembers(const std::vector<GroupElement>& elements)
+{
+    std::vector<secp256k1_gej> points;
+    points.reserve(elements.size());
+    for (const GroupElement& element : elements)
+        points.push_back(*reinterpret_cast<const secp256k1_gej *>(element.g_));
+
+    std::vector<secp256k1_ge> affine(points.size());
+    gej_to_ge_all(affine.data(), points.data(), points.size());
+    for (const secp256k1_ge& ge : affine) {
+        if (!secp256k1_ge_is_infinity(&ge) && !secp256k1_ge_is_valid_var(&ge))
+            return false;
+    }
+    return true;
+}
+
+void GroupElement::normalize(std::vector<GroupElement>& elements)
+{
+    std::vector<secp256k1_gej> points;
+    points.reserve(elements.size());
+    for (const GroupElement& element : elements)
+        points.push_back(*reinterpret_cast<const secp256k1_gej *>(element.g_));
+
+    std::vector<secp256k1_ge> affine(points.size());
+    gej_to_ge_all(affine.data(), points.data(), points.size());
+    for (std::size_t i = 0; i < elements.size(); ++i)
+        secp256k1_gej_set_ge(reinterpret_cast<secp256k1_gej *>(elements[i].g_), &affine[i]);
+}
+
 void GroupElement::randomize() {
     unsigned char temp[32] = { 0 };
 
@@ -388,7 +435,7 @@ GroupElement& GroupElement::generate(unsigned char* seed){
 }
 
 void GroupElement::sha256(unsigned char* result) const{
-    auto g = reinterpret_cast<secp256k1_gej *>(g_);
+    auto g = reinterpret_cast<const secp256k1_gej *>(g_);
     unsigned char buff[64];
     secp256k1_fe_get_b32(&buff[0], &g->x);
     secp256k1_fe_get_b32(&buff[32], &g->y);
@@ -447,7 +494,7 @@ std::string _convertToString(const unsigned char(&buffer) [Len], int base) {
 
 std::string GroupElement::tostring() const {
     int base = 10;
-    secp256k1_ge ge = gej_to_ge(*reinterpret_cast<secp256k1_gej *>(g_));
+    secp256k1_ge ge = gej_to_ge(*reinterpret_cast<const secp256k1_gej *>(g_));
 
     if (ge.infinity) {
     return std::string("O");
@@ -469,7 +516,7 @@ std::string GroupElement::tostring() const {
 
 std::string GroupElement::GetHex() const {
     int base = 16;
-    secp256k1_ge ge = gej_to_ge(*reinterpret_cast<secp256k1_gej *>(g_));
+    secp256k1_ge ge = gej_to_ge(*reinterpret_cast<const secp256k1_gej *>(g_));
 
     if (ge.infinity) {
         return std::string("O");
@@ -495,7 +542,7 @@ size_t GroupElement::memoryRequired() const  {
 
 
 unsigned char* GroupElement::serialize() const {
-    auto g = reinterpret_cast<secp256k1_gej *>(g_);
+    auto g = reinterpret_cast<const secp256k1_gej *>(g_);
     unsigned char* data = new unsigned char[ 2 * sizeof(secp256k1_fe)];
     memcpy(&data[0], &g->x.n[0], sizeof(secp256k1_fe));
     memcpy(&data[0] + sizeof(secp256k1_fe), &g->y.n[0], sizeof(secp256k1_fe));
@@ -503,7 +550,7 @@ unsigned char* GroupElement::serialize() const {
 }
 
 unsigned char* GroupElement::serialize(unsigned char* buffer) const {
-    secp256k1_ge value = gej_to_ge(*reinterpret_cast<secp256k1_gej *>(g_));
+    secp256k1_ge value = gej_to_ge(*reinterpret_cast<const secp256k1_gej *>(g_));
     secp256k1_fe x = value.x;
     secp256k1_fe y = value.y;
     secp256k1_fe_normalize(&x);
@@ -528,6 +575,40 @@ unsigned char* GroupElement::deserialize(unsigned char* buffer) {
     return buffer + memoryRequired();
 }
 
+unsigned char* GroupElement::serializeCompressed(unsigned char* buffer) const {
+    secp256k1_ge value = gej_to_ge(*reinterpret_cast<const secp256k1_gej *>(g_));
+    if (value.infinity) {
+        memset(buffer, 0, compressed_size);
+        return buffer + compressed_size;
+    }
+    secp256k1_fe_normalize(&value.x);
+    secp256k1_fe_normalize(&value.y);
+    buffer[0] = secp256k1_fe_is_odd(&value.y) ? 0x03 : 0x02;
+    secp256k1_fe_get_b32(buffer + 1, &value.x);
+    return buffer + compressed_size;
+}
+
+const unsigned char* GroupElement::deserializeCompressed(const unsigned char* buffer) {
+    secp256k1_gej* g = reinterpret_cast<secp256k1_gej *>(g_);
+    if (buffer[0] == 0) {
+        for (std::size_t i = 1; i < compressed_size; i++) {
+            if (buffer[i] != 0)
+                return nullptr;
+        }
+        secp256k1_gej_set_infinity(g);
+        return buffer + compressed_size;
+    }
+    if (buffer[0] != 0x02 && buffer[0] != 0x03)
+        return nullptr;
+
+    secp256k1_fe x;
+    secp256k1_ge result;
+    if (!secp256k1_fe_set_b32(&x, buffer + 1) || !secp256k1_ge_set_xo_var(&result, &x, buffer[0] == 0x03))
+        return nullptr;
+    secp256k1_gej_set_ge(g, &result);
+    return buffer + compressed_size;
+}
+
 std::vector<unsigned char> GroupElement::getvch() const {
     unsigned char buffer[memoryRequired()];
     serialize(buffer);
@@ -538,7 +619,7 @@ std::vector<unsigned char> GroupElement::getvch() const {
 
 std::size_t GroupElement::hash() const
 {
-    auto ge = gej_to_ge(*reinterpret_cast<secp256k1_gej *>(g_));
+    auto ge = gej_to_ge(*reinterpret_cast<const secp256k1_gej *>(g_));
     std::array<unsigned char, 32 * 2> coord;
 
     if (ge.infinity) {
@@ -10,75 +10,161 @@
 #include "ecmult.h"
 #include "ecmult_impl.h"
 #include "scratch_impl.h"
-#include "ecmult_impl.h"
 
+#include <algorithm>
+#include <memory>
+
+// Window of the precomputed tables of MultiExponentTable, 2^(w-2) odd multiples per generator.
+#define MULTIEXPONENT_TABLE_WINDOW 8
+
+namespace {
+
+// The multi-exponentiations never involve the generator G, the context needs no tables.
+struct MultiExponentContext {
+    secp256k1_ecmult_context ctx;
+
+    MultiExponentContext() { secp256k1_ecmult_context_init(&ctx); }
+};
+
+const MultiExponentContext ecmult_context;
+
+// Scratch space of the calling thread, kept between multi-exponentiations so the
+// frames of the previous calls are reused instead of allocated every time.
+struct MultiExponentArena {
+    secp256k1_scratch *scratch;
+    std::vector<const secp256k1_gej *> points;
+
+    MultiExponentArena() : scratch(secp256k1_scratch_create(NULL, 0)) {}
+    ~MultiExponentArena() { secp256k1_scratch_destroy(scratch); }
+
+    secp256k1_scratch *get_scratch(std::size_t max_size) {
+        scratch->max_size = max_size;
+        return scratch;
+    }
+};
+
+MultiExponentArena& get_arena() {
+    static thread_local std::unique_ptr<MultiExponentArena> arena;
+    if (!arena)
+        arena.reset(new MultiExponentArena());
+    return *arena;
+}
 
 typedef struct {
-    secp256k1_scalar *sc;
-    secp256k1_gej *pt;
+    const secp_primitives::Scalar *sc;
+    const secp256k1_gej * const *pt;
 } ecmult_multi_data;
 
 int ecmult_multi_callback(secp256k1_scalar *sc, secp256k1_gej *pt, size_t idx, void *cbdata) {
     ecmult_multi_data *data = (ecmult_multi_data*) cbdata;
-    *sc = data->sc[idx];
-    *pt = data->pt[idx];
+    *sc = *reinterpret_cast<const secp256k1_scalar *>(data->sc[idx].get_value());
+    *pt = *data->pt[idx];
     return 1;
 }
 
+} // namespace
+
 namespace secp_primitives {
 
-MultiExponent::MultiExponent(const MultiExponent& other)
-        : sc_(new secp256k1_scalar[other.n_points])
-        , pt_(new secp256k1_gej[other.n_points])
-        , n_points(other.n_points)
+MultiExponent::MultiExponent(const std::vector<GroupElement>& generators, const std::vector<Scalar>& powers)
+        : generators_(generators.data())
+        , generator_ptrs_(nullptr)
+        , powers_(powers.data())
+        , n_points(generators.size())
 {
-    for(int i = 0; i < n_points; ++i)
-    {
-        (reinterpret_cast<secp256k1_scalar *>(sc_))[i] = (reinterpret_cast<secp256k1_scalar *>(other.sc_))[i];
-        (reinterpret_cast<secp256k1_gej *>(pt_))[i] = (reinterpret_cast<secp256k1_gej *>(other.pt_))[i];
-    }
 }
 
-MultiExponent::MultiExponent(const std::vector<GroupElement>& generators, const std::vector<Scalar>& powers){
-    sc_ = new secp256k1_scalar[powers.size()];
-    pt_ = new secp256k1_gej[generators.size()];
-    n_points = generators.size();
-    for(int i = 0; i < n_points; ++i)
-    {
-        (reinterpret_cast<secp256k1_scalar *>(sc_))[i] = *reinterpret_cast<const secp256k1_scalar *>(powers[i].get_value());
-        (reinterpret_cast<secp256k1_gej *>(pt_))[i] = *reinterpret_cast<const secp256k1_gej *>(generators[i].get_value());
-    }
+MultiExponent::MultiExponent(const GroupElement* generators, const Scalar* powers, std::size_t n_points)
+        : generators_(generators)
+        , generator_ptrs_(nullptr)
+        , powers_(powers)
+        , n_points(n_points)
+{
 }
 
-MultiExponent::~MultiExponent(){
-    delete []reinterpret_cast<secp256k1_scalar *>(sc_);
-    delete []reinterpret_cast<secp256k1_gej *>(pt_);
+MultiExponent::MultiExponent(const std::vector<const GroupElement*>& generators, const std::vector<Scalar>& powers)
+        : generators_(nullptr)
+        , generator_ptrs_(generators.data())
+        , powers_(powers.data())
+        , n_points(generators.size())
+{
 }
 
-GroupElement MultiExponent::get_multiple(){
+GroupElement MultiExponent::get_multiple() const {
     secp256k1_gej r;
 
+    MultiExponentArena& arena = get_arena();
+    arena.points.resize(n_points);
+    if (generator_ptrs_) {
+        for (std::size_t i = 0; i < n_points; ++i)
+            arena.points[i] = reinterpret_cast<const secp256k1_gej *>(generator_ptrs_[i]->get_value());
+    } else {
+        for (std::size_t i = 0; i < n_points; ++i)
+            arena.points[i] = reinterpret_cast<const secp256k1_gej *>(generators_[i].get_value());
+    }
+
     ecmult_multi_data data;
-    data.sc = reinterpret_cast<secp256k1_scalar *>(sc_);
-    data.pt = reinterpret_cast<secp256k1_gej *>(pt_);
+    data.sc = powers_;
+    data.pt = arena.points.data();
 
     secp256k1_scratch *scratch;
     if (n_points > ECMULT_PIPPENGER_THRESHOLD) {
         int bucket_window = secp256k1_pippenger_bucket_window(n_points);
         size_t scratch_size = secp256k1_pippenger_scratch_size(n_points, bucket_window);
-        scratch = secp256k1_scratch_create(NULL, scratch_size + PIPPENGER_SCRATCH_OBJECTS*ALIGNMENT);
+        scratch = arena.get_scratch(scratch_size + PIPPENGER_SCRATCH_OBJECTS*ALIGNMENT);
     } else {
         size_t scratch_size = secp256k1_strauss_scratch_size(n_points);
-        scratch = secp256k1_scratch_create(NULL, scratch_size + STRAUSS_SCRATCH_OBJECTS*ALIGNMENT);
+        scratch = arena.get_scratch(scratch_size + STRAUSS_SCRATCH_OBJECTS*ALIGNMENT);
     }
 
-    secp256k1_ecmult_context ctx;
+    secp256k1_ecmult_multi_var(&ecmult_context.ctx, scratch, &r, NULL, ecmult_multi_callback, &data, n_points);
 
-    secp256k1_ecmult_multi_var(&ctx, scratch, &r, NULL, ecmult_multi_callback, &data, n_points);
+    return GroupElement(&r);
+}
 
-    secp256k1_scratch_destroy(scratch);
+MultiExponentTable::MultiExponentTable(const std::vector<GroupElement>& generators)
+        : pre_(new secp256k1_ge_storage[generators.size() * ECMULT_TABLE_SIZE(MULTIEXPONENT_TABLE_WINDOW)])
+        , n_points(generators.size())
+{
+    secp256k1_ge_storage *pre = reinterpret_cast<secp256k1_ge_storage *>(pre_);
+    for (std::size_t i = 0; i < n_points; ++i) {
+        secp256k1_ecmult_odd_multiples_table_storage_var(ECMULT_TABLE_SIZE(MULTIEXPONENT_TABLE_WINDOW),
+            pre + i * ECMULT_TABLE_SIZE(MULTIEXPONENT_TABLE_WINDOW),
+            reinterpret_cast<const secp256k1_gej *>(generators[i].get_value()), NULL);
+    }
+}
+
+MultiExponentTable::~MultiExponentTable() {
+    delete []reinterpret_cast<secp256k1_ge_storage *>(pre_);
+}
+
+GroupElement MultiExponentTable::get_multiple(const std::vector<Scalar>& powers) const {
+    const secp256k1_ge_storage *pre = reinterpret_cast<const secp256k1_ge_storage *>(pre_);
+    std::size_t n = std::min(powers.size(), n_points);
+
+    std::vector<int> wnaf(n * 256);
+    int bits = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        int bits_i = secp256k1_ecmult_wnaf(&wnaf[i * 256], 256,
+            reinterpret_cast<const secp256k1_scalar *>(powers[i].get_value()), MULTIEXPONENT_TABLE_WINDOW);
+        bits = std::max(bits, bits_i);
+    }
+
+    secp256k1_gej r;
+    secp256k1_ge tmpa;
+    secp256k1_gej_set_infinity(&r);
+    for (int i = bits - 1; i >= 0; --i) {
+        secp256k1_gej_double_var(&r, &r, NULL);
+        for (std::size_t j = 0; j < n; ++j) {
+            int d = wnaf[j * 256 + i];
+            if (d) {
+                ECMULT_TABLE_GET_GE_STORAGE(&tmpa, pre + j * ECMULT_TABLE_SIZE(MULTIEXPONENT_TABLE_WINDOW), d, MULTIEXPONENT_TABLE_WINDOW);
+                secp256k1_gej_add_ge_var(&r, &r, &tmpa, NULL);
+            }
+        }
+    }
 
-    return  reinterpret_cast<secp256k1_scalar *>(&r);
+    return GroupElement(&r);
 }
 
 }// namespace secp_primitives
@@ -15,36 +15,23 @@
 
 namespace secp_primitives {
 
-Scalar::Scalar()
-   : value_(new secp256k1_scalar()) {
+static_assert(sizeof(secp256k1_scalar) <= Scalar::value_size, "Scalar storage too small for secp256k1_scalar");
+static_assert(alignof(secp256k1_scalar) <= 16, "Scalar storage not aligned for secp256k1_scalar");
+
+Scalar::Scalar() {
+    secp256k1_scalar_clear(reinterpret_cast<secp256k1_scalar *>(value_));
 }
 
-Scalar::Scalar(uint64_t value)
-   : value_(new secp256k1_scalar()) {
+Scalar::Scalar(uint64_t value) {
     secp256k1_scalar_set_int(reinterpret_cast<secp256k1_scalar *>(value_), value);
 }
 
-Scalar::Scalar(const unsigned char* str)
-     : value_(new secp256k1_scalar()) {
+Scalar::Scalar(const unsigned char* str) {
     secp256k1_scalar_set_b32(reinterpret_cast<secp256k1_scalar *>(value_), str, 0);
 }
 
-Scalar::Scalar(const void *value)
-   : value_(new secp256k1_scalar(*reinterpret_cast<const secp256k1_scalar *>(value))) {
-
-}
-
-Scalar::Scalar(const Scalar& other)
-   : value_(new secp256k1_scalar(*reinterpret_cast<const secp256k1_scalar *>(other.value_))) {
-
-}
-
-Scalar::~Scalar() {
-    delete reinterpret_cast<secp256k1_scalar *>(value_);
-}
-
-Scalar& Scalar::operator=(const Scalar& other) {
-    return set(other);
+Scalar::Scalar(const void *value) {
+    *reinterpret_cast<secp256k1_scalar *>(value_) = *reinterpret_cast<const secp256k1_scalar *>(value);
 }
 
 Scalar& Scalar::operator=(unsigned int i) {
@@ -302,7 +289,7 @@ std::string Scalar::GetHex() const {
     return ss.str();
 }
 
-void Scalar::SetHex(const std::string& str) const {
+void Scalar::SetHex(const std::string& str) {
     unsigned char buffer[32];
 
     for (int i = 0; i < 32; i+=2)
@@ -23,6 +23,7 @@
 #include <boost/type_traits/is_fundamental.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <prevector.h>
+#include <unordered_map>
 #include <unordered_set>
 
 
@@ -543,6 +544,12 @@ template<typename Stream, typename K, typename T, typename Pred, typename A> voi
 template<typename Stream, typename K, typename Pred, typename A> void Serialize(Stream& os, const std::set<K, Pred, A>& m);
 template<typename Stream, typename K, typename Pred, typename A> void Unserialize(Stream& is, std::set<K, Pred, A>& m);
 
+/**
+ * unordered_map
+ */
+template<typename Stream, typename K, typename T, typename H, typename E, typename A> void Serialize(Stream& os, const std::unordered_map<K, T, H, E, A>& m);
+template<typename Stream, typename K, typename T, typename H, typename E, typename A> void Unserialize(Stream& is, std::unordered_map<K, T, H, E, A>& m);
+
 /**
  * unordered_set
  */
@@ -896,6 +903,31 @@ void Unserialize(Stream& is, std::set<K, Pred, A>& m)
     }
 }
 
+/**
+ * unordered_map
+ */
+template<typename Stream, typename K, typename T, typename H, typename E, typename A>
+void Serialize(Stream& os, const std::unordered_map<K, T, H, E, A>& m)
+{
+    WriteCompactSize(os, m.size());
+    for (const auto& entry : m)
+        Serialize(os, entry);
+}
+
+template<typename Stream, typename K, typename T, typename H, typename E, typename A>
+void Unserialize(Stream& is, std::unordered_map<K, T, H, E, A>& m)
+{
+    m.clear();
+    unsigned int nSize = ReadCompactSize(is);
+    m.reserve(nSize);
+    for (unsigned int i = 0; i < nSize; i++)
+    {
+        std::pair<K, T> item;
+        Unserialize(is, item);
+        m.insert(item);
+    }
+}
+
 /**
  * unordered_set
  */
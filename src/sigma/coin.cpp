@@ -1,6 +1,8 @@
 #include <sigma/coin.h>
 #include <util.h>
 #include <amount.h>
+#include <hash.h>
+#include <random.h>
 
 #include <openssl/rand.h>
 #include <sstream>
@@ -155,29 +157,39 @@ sigma::CoinDenomination AmountToClosestDenominationSigma(CAmount nAmount, CAmoun
 PublicCoin::PublicCoin()
     : denomination(CoinDenomination::SIGMA_1)
 {
-
+    CacheValue();
 }
 
 PublicCoin::PublicCoin(const GroupElement& coin, const CoinDenomination d)
     : value(coin)
     , denomination(d)
 {
+    CacheValue();
+}
+
+void PublicCoin::CacheValue() {
+    value.serialize(affineValue);
+    valueHash = Hash(affineValue, affineValue + value.memoryRequired());
 }
 
 const GroupElement& PublicCoin::getValue() const{
     return this->value;
 }
 
+const uint256& PublicCoin::getValueHash() const {
+    return valueHash;
+}
+
 CoinDenomination PublicCoin::getDenomination() const {
     return denomination;
 }
 
 bool PublicCoin::operator==(const PublicCoin& other) const{
-    return (*this).value == other.value;
+    return std::memcmp(affineValue, other.affineValue, sizeof(affineValue)) == 0;
 }
 
 bool PublicCoin::operator!=(const PublicCoin& other) const{
-    return (*this).value != other.value;
+    return !(*this == other);
 }
 
 bool PublicCoin::validate() const{
@@ -298,30 +310,16 @@ Scalar PrivateCoin::serialNumberFromSerializedPublicKey(
     return Scalar(hash);
 }
 
-std::size_t CScalarHash::operator ()(const Scalar& bn) const noexcept {
-    vector<unsigned char> bnData(bn.memoryRequired());
-    bn.serialize(&bnData[0]);
-
-    unsigned char hash[CSHA256::OUTPUT_SIZE];
-    CSHA256().Write(&bnData[0], bnData.size()).Finalize(hash);
+CScalarHash::CScalarHash() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-    // take the first bytes of "hash".
-    std::size_t result;
-    std::memcpy(&result, hash, sizeof(std::size_t));
-    return result;
+std::size_t CScalarHash::operator ()(const Scalar& bn) const noexcept {
+    uint256 bnData;
+    bn.serialize(bnData.begin());
+    return SipHashUint256(k0, k1, bnData);
 }
 
 std::size_t CPublicCoinHash::operator ()(const PublicCoin& coin) const noexcept {
-    vector<unsigned char> bnData(coin.getValue().memoryRequired());
-    coin.getValue().serialize(&bnData[0]);
-
-    unsigned char hash[CSHA256::OUTPUT_SIZE];
-    CSHA256().Write(&bnData[0], bnData.size()).Finalize(hash);
-
-    // take the first bytes of "hash".
-    std::size_t result;
-    std::memcpy(&result, hash, sizeof(std::size_t));
-    return result;
+    return coin.getValueHash().GetCheapHash();
 }
 
 } // namespace sigma
@@ -6,6 +6,7 @@
 
 #include <consensus/validation.h>
 #include <libzerocoin/Zerocoin.h>
+#include <uint256.h>
 
 #include <cinttypes>
 
@@ -24,6 +25,8 @@ enum class CoinDenomination : std::uint8_t {
 
 static const int SIGMA_VERSION_1 = 1;
 static const int SIGMA_VERSION_2 = 2;
+// Same proof as version 2 in a compact encoding, written after OP_SIGMASPENDV3
+static const int SIGMA_VERSION_3 = 3;
 
 // for LogPrintf.
 std::ostream& operator<<(std::ostream& stream, CoinDenomination denomination);
@@ -53,6 +56,8 @@ public:
     PublicCoin(const GroupElement& coin, const CoinDenomination d);
 
     const GroupElement& getValue() const;
+    // Equal to GetPubCoinValueHash(getValue())
+    const uint256& getValueHash() const;
     CoinDenomination getDenomination() const;
 
     bool operator==(const PublicCoin& other) const;
@@ -78,11 +83,20 @@ public:
         s.read(b, size + sizeof(int32_t));
         value.deserialize(buffer);
         std::memcpy(&denomination, buffer + size, sizeof(denomination));
+        CacheValue();
     }
 
 private:
+    void CacheValue();
+
     GroupElement value;
     CoinDenomination denomination;
+
+    // The normalized affine encoding of value and its hash. Coins are
+    // compared and hashed through these, so lookups in the sigma state and
+    // mempool maps do no field inversion or SHA256.
+    unsigned char affineValue[GroupElement::serialize_size];
+    uint256 valueHash;
 };
 
 class PrivateCoin {
@@ -148,12 +162,16 @@ void Unserialize(Stream& is, CoinDenomination& d)
     d = static_cast<CoinDenomination>(v);
 }
 
-// Custom hash for Scalar values.
+// Custom hash for Scalar values, salted as serials are chosen by their minters.
 struct CScalarHash {
+    CScalarHash();
     std::size_t operator()(const secp_primitives::Scalar& bn) const noexcept;
+
+private:
+    uint64_t k0, k1;
 };
 
-// Custom hash for the public coin.
+// Custom hash for the public coin, taken from its cached value hash.
 struct CPublicCoinHash {
     std::size_t operator()(const PublicCoin& coin) const noexcept;
 };
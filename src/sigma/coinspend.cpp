@@ -1,8 +1,114 @@
 #include <sigma/coinspend.h>
 #include <sigma/openssl_context.h>
 
+#include <version.h>
+
+#include <cstring>
+
 namespace sigma {
 
+namespace {
+
+// Minimal stream reading from a range of bytes without copying them
+class ByteRangeReader {
+public:
+    ByteRangeReader(const unsigned char* begin, const unsigned char* end) : current(begin), end(end) {}
+
+    int GetType() const { return SER_NETWORK; }
+    int GetVersion() const { return PROTOCOL_VERSION; }
+
+    void read(char* dst, std::size_t n) {
+        ignore(n);
+        memcpy(dst, current - n, n);
+    }
+
+    void ignore(uint64_t n) {
+        if (n > (uint64_t)(end - current))
+            throw std::ios_base::failure("ByteRangeReader::ignore(): end of data");
+        current += n;
+    }
+
+    template<typename T>
+    ByteRangeReader& operator>>(T& obj) {
+        ::Unserialize(*this, obj);
+        return *this;
+    }
+
+    const unsigned char* position() const { return current; }
+
+private:
+    const unsigned char* current;
+    const unsigned char* end;
+};
+
+} // namespace
+
+CoinSpendView::CoinSpendView(const Params* p, const unsigned char* begin, const unsigned char* end, bool fCompactIn)
+    :
+    params(p),
+    version(0),
+    denomination(CoinDenomination::SIGMA_ERROR),
+    proofBegin(begin),
+    fCompact(fCompactIn)
+{
+    const uint64_t groupElementSize = GroupElement().memoryRequired();
+    const uint64_t scalarSize = Scalar().memoryRequired();
+
+    ByteRangeReader s(begin, end);
+    if (fCompact) {
+        // laid out as in SigmaPlusProof::SerializeCompact
+        const uint64_t n = p->get_n(), m = p->get_m();
+        s.ignore(GroupElement::compressed_size * (4 + m)); // B_, A_, C_, D_, Gk_
+        s.ignore(scalarSize * (m * (n - 1) + 3)); // f_, ZA_, ZC_, z_
+    } else {
+        // laid out as in SigmaPlusProof::SerializationOp
+        s.ignore(groupElementSize * 4); // B_, A_, C_, D_
+        s.ignore(ReadCompactSize(s) * scalarSize); // f_
+        s.ignore(scalarSize * 2); // ZA_, ZC_
+        s.ignore(ReadCompactSize(s) * groupElementSize); // Gk_
+        s.ignore(scalarSize); // z_
+    }
+
+    serialBegin = s.position();
+    s.ignore(scalarSize);
+    if (fCompact)
+        version = SIGMA_VERSION_3;
+    else
+        s >> version;
+
+    int64_t denomination_value;
+    s >> denomination_value;
+    IntegerToDenomination(denomination_value, denomination);
+
+    s >> accumulatorBlockHash;
+    // ecdsaPubkey, ecdsaSignature
+    s.ignore(ReadCompactSize(s));
+    s.ignore(ReadCompactSize(s));
+}
+
+int64_t CoinSpendView::getIntDenomination() const {
+    int64_t denom_value = 0;
+    DenominationToInteger(denomination, denom_value);
+    return denom_value;
+}
+
+Scalar CoinSpendView::getCoinSerialNumber() const {
+    Scalar serial;
+    ByteRangeReader s(serialBegin, serialBegin + serial.memoryRequired());
+    s >> serial;
+    return serial;
+}
+
+SigmaPlusProof<Scalar, GroupElement> CoinSpendView::getProof() const {
+    SigmaPlusProof<Scalar, GroupElement> proof(params);
+    ByteRangeReader s(proofBegin, serialBegin);
+    if (fCompact)
+        proof.UnserializeCompact(s);
+    else
+        s >> proof;
+    return proof;
+}
+
 CoinSpend::CoinSpend(
     const Params* p,
     const PrivateCoin& coin,
@@ -21,11 +127,6 @@ CoinSpend::CoinSpend(
     if (!HasValidSerial()) {
         throw ZerocoinException("Invalid serial # range");
     }
-    SigmaPlusProver<Scalar, GroupElement> sigmaProver(
-        params->get_g(),
-        params->get_h(),
-        params->get_n(),
-        params->get_m());
     //compute inverse of g^s
     GroupElement gs = (params->get_g() * coinSerialNumber).inverse();
     std::vector<GroupElement> C_;
@@ -45,6 +146,71 @@ CoinSpend::CoinSpend(
     if(!indexFound)
         throw ZerocoinException("No such coin in this anonymity set");
 
+    generate(coin, C_, coinIndex, m, fPadding);
+}
+
+CoinSpend::CoinSpend(
+    const Params* p,
+    const PrivateCoin& coin,
+    const std::vector<GroupElement>& coins,
+    std::size_t setSize,
+    const SpendMetaData& m,
+    bool fPadding,
+    int threads)
+    :
+    params(p),
+    denomination(coin.getPublicCoin().getDenomination()),
+    accumulatorBlockHash(m.blockHash),
+    coinSerialNumber(coin.getSerialNumber()),
+    ecdsaSignature(64, 0),
+    ecdsaPubkey(33, 0),
+    sigmaProof(p)
+{
+    if (!HasValidSerial()) {
+        throw ZerocoinException("Invalid serial # range");
+    }
+    if (setSize > coins.size()) {
+        throw ZerocoinException("Anonymity set out of range");
+    }
+    //compute inverse of g^s
+    GroupElement gs = (params->get_g() * coinSerialNumber).inverse();
+    std::vector<GroupElement> C_;
+    C_.reserve(setSize);
+    std::size_t coinIndex;
+    bool indexFound = false;
+
+    for (std::size_t j = 0; j < setSize; ++j) {
+        const GroupElement& value = coins[setSize - 1 - j];
+        if (value == coin.getPublicCoin().getValue()) {
+            coinIndex = j;
+            indexFound = true;
+        }
+
+        C_.emplace_back(value + gs);
+    }
+
+    if(!indexFound)
+        throw ZerocoinException("No such coin in this anonymity set");
+
+    generate(coin, C_, coinIndex, m, fPadding, threads);
+}
+
+void CoinSpend::generate(
+    const PrivateCoin& coin,
+    const std::vector<GroupElement>& C_,
+    std::size_t coinIndex,
+    const SpendMetaData& m,
+    bool fPadding,
+    int threads)
+{
+    SigmaPlusProver<Scalar, GroupElement> sigmaProver(
+        params->get_g(),
+        params->get_h(),
+        params->get_n(),
+        params->get_m(),
+        params->get_h_table(),
+        threads);
+
     sigmaProver.proof(C_, coinIndex, coin.getRandomness(), fPadding, sigmaProof);
 
     updateMetaData(coin, m);
@@ -100,7 +266,10 @@ bool CoinSpend::Verify(
         const std::vector<PublicCoin>& anonymity_set,
         const SpendMetaData& m,
         bool fPadding) const {
-    SigmaPlusVerifier<Scalar, GroupElement> sigmaVerifier(params->get_g(), params->get_h(), params->get_n(), params->get_m());
+    if (!VerifySignature(m))
+        return false;
+
+    SigmaPlusVerifier<Scalar, GroupElement> sigmaVerifier(params->get_g(), params->get_h(), params->get_n(), params->get_m(), params->get_h_table());
     //compute inverse of g^s
     GroupElement gs = (params->get_g() * coinSerialNumber).inverse();
     std::vector<GroupElement> C_;
@@ -108,6 +277,22 @@ bool CoinSpend::Verify(
     for(std::size_t j = 0; j < anonymity_set.size(); ++j)
         C_.emplace_back(anonymity_set[j].getValue() + gs);
 
+    // Now verify the sigma proof itself.
+    return sigmaVerifier.verify(C_, sigmaProof, fPadding);
+}
+
+bool CoinSpend::Verify(
+        const std::vector<GroupElement>& coins,
+        std::size_t setSize,
+        const SpendMetaData& m,
+        bool fPadding) const {
+    if (!VerifySignature(m))
+        return false;
+
+    return BatchVerify(params, coins, {this}, {setSize}, {fPadding});
+}
+
+bool CoinSpend::VerifySignature(const SpendMetaData& m) const {
     uint256 metahash = signatureHash(m);
 
     // Verify ecdsa_signature, to make sure someone did not change the output of transaction.
@@ -138,8 +323,27 @@ bool CoinSpend::Verify(
         return false;
     }
 
-    // Now verify the sigma proof itself.
-    return sigmaVerifier.verify(C_, sigmaProof, fPadding);
+    return true;
+}
+
+bool CoinSpend::BatchVerify(
+        const Params* p,
+        const std::vector<GroupElement>& coins,
+        const std::vector<const CoinSpend*>& spends,
+        const std::vector<std::size_t>& setSizes,
+        const std::vector<bool>& fPadding) {
+    SigmaPlusVerifier<Scalar, GroupElement> sigmaVerifier(p->get_g(), p->get_h(), p->get_n(), p->get_m(), p->get_h_table());
+
+    std::vector<Scalar> serials;
+    std::vector<const SigmaPlusProof<Scalar, GroupElement>*> proofs;
+    serials.reserve(spends.size());
+    proofs.reserve(spends.size());
+    for (const CoinSpend* spend : spends) {
+        serials.emplace_back(spend->coinSerialNumber);
+        proofs.emplace_back(&spend->sigmaProof);
+    }
+
+    return sigmaVerifier.batch_verify(coins, serials, setSizes, fPadding, proofs);
 }
 
 const Scalar& CoinSpend::getCoinSerialNumber() {
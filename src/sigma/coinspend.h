@@ -7,6 +7,8 @@
 #include <sigma/sigmaplus_verifier.h>
 #include <sigma/spend_metadata.h>
 
+#include <cassert>
+
 using namespace secp_primitives;
 
 namespace sigma {
@@ -21,6 +23,17 @@ public:
             strm >> * this;
         }
 
+    // Reads the compact encoding of SIGMA_VERSION_3 spends if fCompact is set
+    template<typename Stream>
+    CoinSpend(const Params* p, Stream& strm, bool fCompact):
+        params(p),
+        denomination(CoinDenomination::SIGMA_1),
+        sigmaProof(p) {
+            if (fCompact)
+                UnserializeCompact(strm);
+            else
+                strm >> * this;
+        }
 
     CoinSpend(const Params* p,
               const PrivateCoin& coin,
@@ -28,6 +41,16 @@ public:
               const SpendMetaData& m,
               bool fPadding);
 
+    // Spend against the anonymity set formed by the first setSize coins, taken in reverse order.
+    // The proof is computed on up to threads threads.
+    CoinSpend(const Params* p,
+              const PrivateCoin& coin,
+              const std::vector<GroupElement>& coins,
+              std::size_t setSize,
+              const SpendMetaData& m,
+              bool fPadding,
+              int threads = 1);
+
     void updateMetaData(const PrivateCoin& coin, const SpendMetaData& m);
 
     const Scalar& getCoinSerialNumber();
@@ -52,6 +75,22 @@ public:
 
     bool Verify(const std::vector<PublicCoin>& anonymity_set, const SpendMetaData &m, bool fPadding) const;
 
+    // Same as above for the anonymity set formed by the first setSize coins, taken in reverse order.
+    bool Verify(const std::vector<GroupElement>& coins, std::size_t setSize, const SpendMetaData &m, bool fPadding) const;
+
+    // Checks the serial number and the signature over the spend metadata, but not the sigma proof.
+    bool VerifySignature(const SpendMetaData &m) const;
+
+    // Verifies sigma proofs of several spends of the same denomination and coin group at once.
+    // The anonymity set of spend k is the first setSizes[k] coins, taken in reverse order.
+    // Signatures are not checked, call VerifySignature() for each spend as well.
+    static bool BatchVerify(
+        const Params* p,
+        const std::vector<GroupElement>& coins,
+        const std::vector<const CoinSpend*>& spends,
+        const std::vector<std::size_t>& setSizes,
+        const std::vector<bool>& fPadding);
+
     ADD_SERIALIZE_METHODS;
     template <typename Stream, typename Operation>
     void SerializationOp(Stream& s, Operation ser_action) {
@@ -71,9 +110,41 @@ public:
         READWRITE(ecdsaPubkey);
         READWRITE(ecdsaSignature);
     }
-    
+
+    // Compact encoding of SIGMA_VERSION_3 spends: the proof in its compact layout and
+    // no version, which is implied by the encoding. Everything else is as above.
+    template<typename Stream>
+    void SerializeCompact(Stream& s) const {
+        assert(version == SIGMA_VERSION_3);
+        sigmaProof.SerializeCompact(s);
+        s << coinSerialNumber;
+        int64_t denomination_value = -1;
+        DenominationToInteger(denomination, denomination_value);
+        s << denomination_value << accumulatorBlockHash << ecdsaPubkey << ecdsaSignature;
+    }
+
+    template<typename Stream>
+    void UnserializeCompact(Stream& s) {
+        sigmaProof.UnserializeCompact(s);
+        s >> coinSerialNumber;
+        version = SIGMA_VERSION_3;
+        int64_t denomination_value;
+        s >> denomination_value;
+        IntegerToDenomination(denomination_value, denomination);
+        s >> accumulatorBlockHash >> ecdsaPubkey >> ecdsaSignature;
+    }
+
+
     uint256 signatureHash(const SpendMetaData& m) const;
 
+private:
+    void generate(const PrivateCoin& coin,
+                  const std::vector<GroupElement>& C_,
+                  std::size_t coinIndex,
+                  const SpendMetaData& m,
+                  bool fPadding,
+                  int threads = 1);
+
 private:
     const Params* params;
     unsigned int version = 0;
@@ -86,6 +157,42 @@ private:
 
 };
 
+// Header fields of a serialized CoinSpend, read without deserializing the sigma proof.
+// Refers to the serialized bytes, which must outlive the view.
+class CoinSpendView {
+public:
+    // Throws std::ios_base::failure if the bytes are not a complete CoinSpend,
+    // in its compact encoding if fCompact is set.
+    CoinSpendView(const Params* p, const unsigned char* begin, const unsigned char* end, bool fCompact);
+
+    int getVersion() const {
+        return version;
+    }
+
+    CoinDenomination getDenomination() const {
+        return denomination;
+    }
+
+    int64_t getIntDenomination() const;
+
+    uint256 getAccumulatorBlockHash() const {
+        return accumulatorBlockHash;
+    }
+
+    // These are decoded on every call
+    Scalar getCoinSerialNumber() const;
+    SigmaPlusProof<Scalar, GroupElement> getProof() const;
+
+private:
+    const Params* params;
+    unsigned int version;
+    CoinDenomination denomination;
+    uint256 accumulatorBlockHash;
+    const unsigned char* proofBegin;
+    const unsigned char* serialBegin;
+    bool fCompact;
+};
+
 } //namespace sigma
 
 #endif // SIGMA_COINSPEND_H
@@ -0,0 +1,48 @@
+#include <sigma/parallel.h>
+
+#include <libzerocoin/ParallelTasks.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace sigma {
+
+void parallel_for(std::size_t count, int threads, const std::function<void(std::size_t)>& task) {
+    std::size_t nWorkers = threads > 1 ? std::min<std::size_t>(threads, count) : 1;
+    if (nWorkers <= 1) {
+        for (std::size_t i = 0; i < count; ++i)
+            task(i);
+        return;
+    }
+
+    // Every worker takes the next index until they are all done, stopping
+    // early once a task failed
+    std::atomic<std::size_t> next(0);
+    auto worker = [&]() {
+        try {
+            for (std::size_t i = next++; i < count; i = next++)
+                task(i);
+        } catch (...) {
+            next = count;
+            throw;
+        }
+    };
+
+    libzerocoin::ParallelTasks workers(nWorkers - 1);
+    for (std::size_t i = 1; i < nWorkers; ++i)
+        workers.Add(worker);
+
+    std::exception_ptr error;
+    try {
+        worker();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    workers.Wait();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+} // namespace sigma
@@ -0,0 +1,16 @@
+#ifndef SIGMA_PARALLEL_H
+#define SIGMA_PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+namespace sigma {
+
+// Calls task(i) for every i in [0, count) on at most threads threads of the
+// shared libzerocoin worker pool, the calling one included. Rethrows the first exception thrown by a task once
+// all the threads are done.
+void parallel_for(std::size_t count, int threads, const std::function<void(std::size_t)>& task);
+
+} // namespace sigma
+
+#endif // SIGMA_PARALLEL_H
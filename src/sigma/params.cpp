@@ -2,22 +2,30 @@
 
 namespace sigma {
 
+//fixing generator G;
+static GroupElement GetGenerator() {
+    return GroupElement("9216064434961179932092223867844635691966339998754536116709681652691785432045",
+                        "33986433546870000256104618635743654523665060392313886665479090285075695067131");
+}
+
 Params* Params::instance;
 Params* Params::get_default() {
     if(instance != nullptr)
         return instance;
     else {
-        //fixing generator G;
-        GroupElement g("9216064434961179932092223867844635691966339998754536116709681652691785432045",
-                       "33986433546870000256104618635743654523665060392313886665479090285075695067131");
-        //fixing n and m; N = n^m = 16,384
-        int n = 4;
-        int m = 7;
-        instance = new Params(g, n, m);
+        instance = new Params(GetGenerator(), DEFAULT_N, DEFAULT_M);
         return instance;
     }
 }
 
+Params* Params::extended;
+Params* Params::get_extended() {
+    // the h generators are a hash chain from g, the default ones are a prefix of these
+    if(extended == nullptr)
+        extended = new Params(GetGenerator(), DEFAULT_N, EXTENDED_M);
+    return extended;
+}
+
 Params::Params(const GroupElement& g, int n, int m) :
     g_(g),
     m_(m),
@@ -27,7 +35,7 @@ Params::Params(const GroupElement& g, int n, int m) :
     g.sha256(buff0);
     GroupElement h0;
     h0.generate(buff0);
-    h_.reserve(28);
+    h_.reserve(n*m);
     h_.emplace_back(h0);
     for(int i = 1; i < n*m; ++i) {
         h_.push_back(GroupElement());
@@ -35,6 +43,7 @@ Params::Params(const GroupElement& g, int n, int m) :
         h_[i - 1].sha256(buff);
         h_[i].generate(buff);
     }
+    h_table_.reset(new MultiExponentTable(h_));
 }
 
 Params::~Params(){
@@ -52,6 +61,10 @@ const std::vector<GroupElement>& Params::get_h() const{
     return h_;
 }
 
+const MultiExponentTable* Params::get_h_table() const{
+    return h_table_.get();
+}
+
 uint64_t Params::get_n() const{
     return n_;
 }
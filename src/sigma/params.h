@@ -5,16 +5,29 @@
 #include <secp256k1/include/MultiExponent.h>
 #include <serialize.h>
 
+#include <memory>
+
 using namespace secp_primitives;
 
 namespace sigma {
 
 class Params{
 public:
+    //! Digits of the default set: N = n^m = 16,384
+    static const int DEFAULT_N = 4;
+    static const int DEFAULT_M = 7;
+    //! Digits of the extended set: N = 4^8 = 65,536
+    static const int EXTENDED_M = 8;
+
     static Params* get_default();
+    // Same generators as the default set with m = EXTENDED_M, for measuring larger
+    // anonymity sets. Not used by consensus.
+    static Params* get_extended();
     const GroupElement& get_g() const;
     const GroupElement& get_h0() const;
     const std::vector<GroupElement>& get_h() const;
+    // Precomputed multiples of the h generators
+    const MultiExponentTable* get_h_table() const;
     uint64_t get_n() const;
     uint64_t get_m() const;
 
@@ -24,8 +37,10 @@ private:
 
 private:
     static Params* instance;
+    static Params* extended;
     GroupElement g_;
     std::vector<GroupElement> h_;
+    std::unique_ptr<MultiExponentTable> h_table_;
     int m_;
     int n_;
 };
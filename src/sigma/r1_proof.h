@@ -1,6 +1,7 @@
 #ifndef SIGMA_R1_PROOF_H
 #define SIGMA_R1_PROOF_H
 
+#include <ios>
 #include <vector>
 #include <secp256k1/include/Scalar.h>
 #include <secp256k1/include/GroupElement.h>
@@ -8,6 +9,22 @@
 
 namespace sigma {
 
+// Points of the compact proof layout, see GroupElement::serializeCompressed
+template <typename Stream, typename Point>
+inline void WriteCompressedPoint(Stream& s, const Point& point) {
+    unsigned char buffer[Point::compressed_size];
+    point.serializeCompressed(buffer);
+    s.write((const char*)buffer, sizeof(buffer));
+}
+
+template <typename Stream, typename Point>
+inline void ReadCompressedPoint(Stream& s, Point& point) {
+    unsigned char buffer[Point::compressed_size];
+    s.read((char*)buffer, sizeof(buffer));
+    if (!point.deserializeCompressed(buffer))
+        throw std::ios_base::failure("ReadCompressedPoint(): not a compressed point");
+}
+
 template <class Exponent, class GroupElement>
 class R1Proof {
 
@@ -50,6 +67,29 @@ public:
         READWRITE(ZC_);
     }
 
+    // Compact layout used by SIGMA_VERSION_3 spends: compressed points and no size
+    // for f_, which has m * (n - 1) elements
+    template <typename Stream>
+    inline void SerializeCompact(Stream& s) const {
+        WriteCompressedPoint(s, A_);
+        WriteCompressedPoint(s, C_);
+        WriteCompressedPoint(s, D_);
+        for (const Exponent& f : f_)
+            s << f;
+        s << ZA_ << ZC_;
+    }
+
+    template <typename Stream>
+    inline void UnserializeCompact(Stream& s, int n, int m) {
+        ReadCompressedPoint(s, A_);
+        ReadCompressedPoint(s, C_);
+        ReadCompressedPoint(s, D_);
+        f_.resize(m * (n - 1));
+        for (Exponent& f : f_)
+            s >> f;
+        s >> ZA_ >> ZC_;
+    }
+
     GroupElement A_;
     GroupElement C_;
     GroupElement D_;
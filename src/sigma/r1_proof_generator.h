@@ -14,7 +14,8 @@ public:
                      const std::vector<GroupElement>& h_gens,
                      const std::vector<Exponent>& b,
                      const Exponent& r,
-                     int n, int m);
+                     int n, int m,
+                     const secp_primitives::MultiExponentTable* h_table = nullptr);
 
     GroupElement get_B() const { return  B_Commit; }
 
@@ -27,6 +28,7 @@ public:
 private:
     const GroupElement& g_;
     const std::vector<GroupElement>& h_;
+    const secp_primitives::MultiExponentTable* h_table_;
     std::vector<Exponent> b_;
     Exponent r;
     GroupElement B_Commit;
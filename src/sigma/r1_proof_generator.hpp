@@ -9,14 +9,16 @@ R1ProofGenerator<Exponent,GroupElement>::R1ProofGenerator(
         const std::vector<Exponent>& b,
         const Exponent& r,
         int n ,
-        int m)
+        int m,
+        const secp_primitives::MultiExponentTable* h_table)
     : g_(g)
     , h_(h_gens)
+    , h_table_(h_table)
     , b_(b)
     , r(r)
     , n_(n)
     , m_(m){
-    SigmaPrimitives<Exponent, GroupElement>::commit(g_, h_,b_,r,B_Commit);
+    SigmaPrimitives<Exponent, GroupElement>::commit(g_, h_,b_,r,B_Commit, h_table_);
 }
 
 template<class Exponent, class GroupElement>
@@ -45,7 +47,7 @@ void R1ProofGenerator<Exponent,GroupElement>::proof(
     GroupElement A;
     while(!A.isMember() || A.isInfinity()) {
         rA.randomize();
-        SigmaPrimitives<Exponent, GroupElement>::commit(g_, h_, a, rA, A);
+        SigmaPrimitives<Exponent, GroupElement>::commit(g_, h_, a, rA, A, h_table_);
     }
     proof_out.A_ = A;
     //compute C
@@ -57,7 +59,7 @@ void R1ProofGenerator<Exponent,GroupElement>::proof(
     GroupElement C;
     while(!C.isMember() || C.isInfinity()) {
         rC.randomize();
-        SigmaPrimitives<Exponent, GroupElement>::commit(g_, h_, c, rC, C);
+        SigmaPrimitives<Exponent, GroupElement>::commit(g_, h_, c, rC, C, h_table_);
     }
     proof_out.C_ = C;
     //compute D
@@ -69,11 +71,16 @@ void R1ProofGenerator<Exponent,GroupElement>::proof(
     GroupElement D;
     while(!D.isMember() || D.isInfinity()) {
         rD.randomize();
-        SigmaPrimitives<Exponent, GroupElement>::commit(g_, h_, d, rD, D);
+        SigmaPrimitives<Exponent, GroupElement>::commit(g_, h_, d, rD, D, h_table_);
     }
+    // Hashing for the challenge and serializing the proof both need the affine points
+    std::vector<GroupElement> ACD = {A, C, D};
+    GroupElement::normalize(ACD);
+    proof_out.A_ = ACD[0];
+    proof_out.C_ = ACD[1];
+    proof_out.D_ = ACD[2];
     Exponent x;
-    proof_out.D_ = D;
-    SigmaPrimitives<Exponent, GroupElement>::get_x(A, C, D,x);
+    SigmaPrimitives<Exponent, GroupElement>::get_x(proof_out.A_, proof_out.C_, proof_out.D_, x);
     x_ = x;
     //f
     std::vector<Exponent> f;
@@ -13,7 +13,8 @@ class R1ProofVerifier {
 public:
     R1ProofVerifier(const GroupElement& g,
             const std::vector<GroupElement>& h_gens,
-            const GroupElement& B, int n , int m);
+            const GroupElement& B, int n , int m,
+            const secp_primitives::MultiExponentTable* h_table = nullptr);
 
     bool verify(const R1Proof<Exponent, GroupElement>& proof_) const;
 
@@ -24,6 +25,7 @@ public:
 private:
     const GroupElement& g_;
     const std::vector<GroupElement>& h_;
+    const secp_primitives::MultiExponentTable* h_table_;
     GroupElement B_Commit;
     int n_, m_;
 };
@@ -9,9 +9,11 @@ R1ProofVerifier<Exponent,GroupElement>::R1ProofVerifier(
         const std::vector<GroupElement>& h_gens,
         const GroupElement& B,
         int n ,
-        int m)
+        int m,
+        const secp_primitives::MultiExponentTable* h_table)
     : g_(g)
     , h_(h_gens)
+    , h_table_(h_table)
     , B_Commit(B)
     , n_(n)
     , m_(m){
@@ -29,10 +31,7 @@ bool R1ProofVerifier<Exponent,GroupElement>::verify(
         const R1Proof<Exponent, GroupElement>& proof_,
         std::vector<Exponent>& f_) const{
 
-    if(!(proof_.A_.isMember() &&
-         B_Commit.isMember() &&
-         proof_.C_.isMember() &&
-         proof_.D_.isMember()) ||
+    if(!GroupElement::areMembers({proof_.A_, B_Commit, proof_.C_, proof_.D_}) ||
         (proof_.A_.isInfinity() ||
          B_Commit.isInfinity() ||
          proof_.C_.isInfinity() ||
@@ -66,7 +65,7 @@ bool R1ProofVerifier<Exponent,GroupElement>::verify(
     }
 
     GroupElement one;
-    SigmaPrimitives<Exponent, GroupElement>::commit(g_, h_, f_, proof_.ZA_, one);
+    SigmaPrimitives<Exponent, GroupElement>::commit(g_, h_, f_, proof_.ZA_, one, h_table_);
     if((B_Commit * x + proof_.A_) != one)
         return false;
 
@@ -75,7 +74,7 @@ bool R1ProofVerifier<Exponent,GroupElement>::verify(
     for (std::size_t i = 0; i < f_.size(); i++)
         f_prime.emplace_back(f_[i] * (x - f_[i]));
     GroupElement two;
-    SigmaPrimitives<Exponent, GroupElement>::commit(g_, h_, f_prime, proof_.ZC_, two);
+    SigmaPrimitives<Exponent, GroupElement>::commit(g_, h_, f_prime, proof_.ZC_, two, h_table_);
     if((proof_.C_ * x + proof_.D_) != two)
         return false;
 
@@ -18,7 +18,8 @@ public:
             const std::vector<GroupElement>& h,
             const std::vector<Exponent>& exp,
             const Exponent& r,
-            GroupElement& result_out);
+            GroupElement& result_out,
+            const secp_primitives::MultiExponentTable* h_table = nullptr);
 
     static GroupElement commit(const GroupElement& g, const Exponent m, const GroupElement h, const Exponent r);
 
@@ -30,6 +31,10 @@ public:
 
     static void new_factor(Exponent x, Exponent a, std::vector<Exponent>& coefficients);
 
+    // Appends prod_j f[j * n + i_j] for every i < N, where i_j are the n-ary
+    // digits of i, using about one multiplication per index.
+    static void compute_fis(const std::vector<Exponent>& f, uint64_t n, uint64_t m, std::size_t N, std::vector<Exponent>& f_i_out);
+
     };
 
 } // namespace sigma
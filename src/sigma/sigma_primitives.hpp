@@ -7,7 +7,12 @@ void SigmaPrimitives<Exponent, GroupElement>::commit(const GroupElement& g,
         const std::vector<GroupElement>& h,
         const std::vector<Exponent>& exp,
         const Exponent& r,
-        GroupElement& result_out)  {
+        GroupElement& result_out,
+        const secp_primitives::MultiExponentTable* h_table)  {
+    if (h_table && exp.size() <= h_table->size()) {
+        result_out += g * r + h_table->get_multiple(exp);
+        return;
+    }
     secp_primitives::MultiExponent mult(h, exp);
     result_out += g * r + mult.get_multiple();
 }
@@ -99,4 +104,37 @@ void SigmaPrimitives<Exponent, GroupElement>::new_factor(
     coefficients[0] *= a;
 }
 
+template<class Exponent, class GroupElement>
+void SigmaPrimitives<Exponent, GroupElement>::compute_fis(
+        const std::vector<Exponent>& f,
+        uint64_t n,
+        uint64_t m,
+        std::size_t N,
+        std::vector<Exponent>& f_i_out) {
+    if (N == 0 || m == 0)
+        return;
+    f_i_out.reserve(f_i_out.size() + N);
+
+    // digits[j] is the j-th n-ary digit of the current index, lowest first,
+    // and products[j] the product of the f entries picked by digits j..m-1.
+    std::vector<uint64_t> digits(m, 0);
+    std::vector<Exponent> products(m + 1);
+    products[m] = Exponent(uint64_t(1));
+    for (uint64_t j = m; j-- > 0; )
+        products[j] = products[j + 1] * f[j * n];
+
+    for (std::size_t i = 0; ; ) {
+        f_i_out.emplace_back(products[0]);
+        if (++i == N)
+            break;
+        // Count up like an odometer, only the products of the digits that
+        // changed need to be recomputed, which is almost always just one.
+        uint64_t changed = 0;
+        while (changed < m && ++digits[changed] == n)
+            digits[changed++] = 0;
+        for (uint64_t j = std::min(changed, m - 1) + 1; j-- > 0; )
+            products[j] = products[j + 1] * f[j * n + digits[j]];
+    }
+}
+
 } // namespace sigma
@@ -44,6 +44,27 @@ public:
         READWRITE(z_);
     }
 
+    // Compact layout used by SIGMA_VERSION_3 spends, see R1Proof::SerializeCompact.
+    // Gk_ has m elements.
+    template <typename Stream>
+    inline void SerializeCompact(Stream& s) const {
+        WriteCompressedPoint(s, B_);
+        r1Proof_.SerializeCompact(s);
+        for (const GroupElement& Gk : Gk_)
+            WriteCompressedPoint(s, Gk);
+        s << z_;
+    }
+
+    template <typename Stream>
+    inline void UnserializeCompact(Stream& s) {
+        ReadCompressedPoint(s, B_);
+        r1Proof_.UnserializeCompact(s, params->get_n(), params->get_m());
+        Gk_.resize(params->get_m());
+        for (GroupElement& Gk : Gk_)
+            ReadCompressedPoint(s, Gk);
+        s >> z_;
+    }
+
 public:
     const Params* params;
     GroupElement B_;
@@ -3,6 +3,7 @@
 
 #include <sigma/r1_proof_generator.h>
 #include <sigma/sigmaplus_proof.h>
+#include <sigma/parallel.h>
 #include <secp256k1/include/MultiExponent.h>
 
 #include <cstddef>
@@ -14,7 +15,9 @@ class SigmaPlusProver{
 
 public:
     SigmaPlusProver(const GroupElement& g,
-                    const std::vector<GroupElement>& h_gens, int n, int m);
+                    const std::vector<GroupElement>& h_gens, int n, int m,
+                    const secp_primitives::MultiExponentTable* h_table = nullptr,
+                    int threads = 1);
     void proof(const std::vector<GroupElement>& commits,
                std::size_t l,
                const Exponent& r,
@@ -24,8 +27,11 @@ public:
 private:
     GroupElement g_;
     std::vector<GroupElement> h_;
+    const secp_primitives::MultiExponentTable* h_table_;
     int n_;
     int m_;
+    // Number of threads a single proof is computed on
+    int threads_;
 };
 
 } // namespace sigma
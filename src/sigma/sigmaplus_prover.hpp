@@ -7,11 +7,15 @@ SigmaPlusProver<Exponent, GroupElement>::SigmaPlusProver(
         const GroupElement& g,
         const std::vector<GroupElement>& h_gens,
         int n,
-        int m)
+        int m,
+        const secp_primitives::MultiExponentTable* h_table,
+        int threads)
     : g_(g)
     , h_(h_gens)
+    , h_table_(h_table)
     , n_(n)
-    , m_(m) {
+    , m_(m)
+    , threads_(threads) {
 }
 
 template<class Exponent, class GroupElement>
@@ -38,7 +42,7 @@ void SigmaPlusProver<Exponent, GroupElement>::proof(
         Pk[k].randomize();
     }
 
-    R1ProofGenerator<secp_primitives::Scalar, secp_primitives::GroupElement> r1prover(g_, h_, sigma, rB, n_, m_);
+    R1ProofGenerator<secp_primitives::Scalar, secp_primitives::GroupElement> r1prover(g_, h_, sigma, rB, n_, m_, h_table_);
     proof_out.B_ = r1prover.get_B();
     std::vector<Exponent> a;
     r1prover.proof(a, proof_out.r1Proof_);
@@ -51,15 +55,19 @@ void SigmaPlusProver<Exponent, GroupElement>::proof(
     P_i_k.resize(N);
 
     // last polynomial is special case if fPadding is true
-    for (std::size_t i = 0; i < (fPadding ? N-1 : N); ++i) {
-        std::vector<Exponent>& coefficients = P_i_k[i];
-        std::vector<uint64_t> I = SigmaPrimitives<Exponent, GroupElement>::convert_to_nal(i, n_, m_);
-        coefficients.push_back(a[I[0]]);
-        coefficients.push_back(sigma[I[0]]);
-        for (int j = 1; j < m_; ++j) {
-            SigmaPrimitives<Exponent, GroupElement>::new_factor(sigma[j * n_ + I[j]], a[j * n_ + I[j]], coefficients);
+    std::size_t nPolynomials = fPadding ? N-1 : N;
+    std::size_t nChunks = std::max(threads_, 1);
+    parallel_for(nChunks, threads_, [&](std::size_t chunk) {
+        for (std::size_t i = nPolynomials * chunk / nChunks; i < nPolynomials * (chunk + 1) / nChunks; ++i) {
+            std::vector<Exponent>& coefficients = P_i_k[i];
+            std::vector<uint64_t> I = SigmaPrimitives<Exponent, GroupElement>::convert_to_nal(i, n_, m_);
+            coefficients.push_back(a[I[0]]);
+            coefficients.push_back(sigma[I[0]]);
+            for (int j = 1; j < m_; ++j) {
+                SigmaPrimitives<Exponent, GroupElement>::new_factor(sigma[j * n_ + I[j]], a[j * n_ + I[j]], coefficients);
+            }
         }
-    }
+    });
 
     if (fPadding) {
         /*
@@ -113,9 +121,8 @@ void SigmaPlusProver<Exponent, GroupElement>::proof(
     }
 
     //computing G_k`s;
-    std::vector <GroupElement> Gk;
-    Gk.reserve(m_);
-    for (int k = 0; k < m_; ++k) {
+    std::vector <GroupElement> Gk(m_);
+    parallel_for(m_, threads_, [&](std::size_t k) {
         std::vector <Exponent> P_i;
         P_i.reserve(N);
         for (size_t i = 0; i < N; ++i) {
@@ -124,8 +131,9 @@ void SigmaPlusProver<Exponent, GroupElement>::proof(
         secp_primitives::MultiExponent mult(commits, P_i);
         GroupElement c_k = mult.get_multiple();
         c_k += SigmaPrimitives<Exponent, GroupElement>::commit(g_, Exponent(uint64_t(0)), h_[0], Pk[k]);
-        Gk.emplace_back(c_k);
-    }
+        Gk[k] = c_k;
+    });
+    GroupElement::normalize(Gk);
     proof_out.Gk_ = Gk;
 
     //computing z
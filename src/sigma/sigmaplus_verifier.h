@@ -14,15 +14,36 @@ class SigmaPlusVerifier{
 public:
     SigmaPlusVerifier(const GroupElement& g,
                       const std::vector<GroupElement>& h_gens,
-                      int n, int m_);
+                      int n, int m_,
+                      const secp_primitives::MultiExponentTable* h_table = nullptr);
 
     bool verify(const std::vector<GroupElement>& commits,
                 const SigmaPlusProof<Exponent, GroupElement>& proof,
                 bool fPadding) const;
 
+    // Verifies several proofs with a single multi-exponentiation. All the
+    // proofs must be built over the same list of commitments: the anonymity
+    // set of proof k is the first setSizes[k] elements of commits taken in
+    // reverse order, each offset by g^-serials[k].
+    bool batch_verify(const std::vector<GroupElement>& commits,
+                      const std::vector<Exponent>& serials,
+                      const std::vector<std::size_t>& setSizes,
+                      const std::vector<bool>& fPadding,
+                      const std::vector<const SigmaPlusProof<Exponent, GroupElement>*>& proofs) const;
+
+private:
+    // Checks the proof elements and the embedded R1 proof, and computes the
+    // power of every commitment for an anonymity set of size N.
+    bool compute_fis(const SigmaPlusProof<Exponent, GroupElement>& proof,
+                     std::size_t N,
+                     bool fPadding,
+                     std::vector<Exponent>& f_i_,
+                     Exponent& x) const;
+
 private:
     GroupElement g_;
     std::vector<GroupElement> h_;
+    const secp_primitives::MultiExponentTable* h_table_;
     int n;
     int m;
 };
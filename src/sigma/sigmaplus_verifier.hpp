@@ -6,9 +6,11 @@ SigmaPlusVerifier<Exponent, GroupElement>::SigmaPlusVerifier(
         const GroupElement& g,
         const std::vector<GroupElement>& h_gens,
         int n,
-        int m)
+        int m,
+        const secp_primitives::MultiExponentTable* h_table)
     : g_(g)
     , h_(h_gens)
+    , h_table_(h_table)
     , n(n)
     , m(m){
 }
@@ -19,50 +21,158 @@ bool  SigmaPlusVerifier<Exponent, GroupElement>::verify(
         const SigmaPlusProof<Exponent, GroupElement>& proof,
         bool fPadding) const {
 
-    R1ProofVerifier<Exponent, GroupElement> r1ProofVerifier(g_, h_, proof.B_, n, m);
+    if (commits.empty()) {
+        LogPrintf("No mints in the anonymity set");
+        return false;
+    }
+
+    std::vector<Exponent> f_i_;
+    Exponent x;
+    if (!compute_fis(proof, commits.size(), fPadding, f_i_, x))
+        return false;
+
+    const std::vector <GroupElement>& Gk = proof.Gk_;
+    secp_primitives::MultiExponent mult(commits, f_i_);
+    GroupElement t1 = mult.get_multiple();
+    GroupElement t2;
+    Exponent x_k(uint64_t(1));
+    for(int k = 0; k < m; ++k){
+        t2 += (Gk[k] * (x_k.negate()));
+        x_k *= x;
+    }
+
+    GroupElement left(t1 + t2);
+    if(left != SigmaPrimitives<Exponent, GroupElement>::commit(g_, Exponent(uint64_t(0)), h_[0], proof.z_))
+        return false;
+
+    return true;
+}
+
+template<class Exponent, class GroupElement>
+bool SigmaPlusVerifier<Exponent, GroupElement>::batch_verify(
+        const std::vector<GroupElement>& commits,
+        const std::vector<Exponent>& serials,
+        const std::vector<std::size_t>& setSizes,
+        const std::vector<bool>& fPadding,
+        const std::vector<const SigmaPlusProof<Exponent, GroupElement>*>& proofs) const {
+
+    std::size_t K = proofs.size();
+    if (serials.size() != K || setSizes.size() != K || fPadding.size() != K)
+        return false;
+    if (K == 0)
+        return true;
+
+    // Commitments past the largest set have a zero power, leave them out
+    std::size_t N = *std::max_element(setSizes.begin(), setSizes.end());
+    if (N > commits.size()) {
+        LogPrintf("Invalid anonymity set size in sigma batch verification");
+        return false;
+    }
+
+    /*
+     * Every single proof checks
+     *
+     *   \sum_i f_i (C_i - g s) - \sum_k G_k x^k - h_0 z = 0
+     *
+     * Multiplying proof number t by a random y_t and adding the equations up
+     * gives one multi-exponentiation over the shared commitments, g, h_0 and
+     * all the G_k, which is zero for a valid batch and not zero except with
+     * negligible probability if any proof is invalid.
+     *
+     * The points are passed by address, the commitments are used right where
+     * the coin group keeps them.
+     */
+    std::vector<const GroupElement*> points;
+    std::vector<Exponent> powers;
+    points.reserve(K * m + 2 + N);
+    powers.reserve(K * m + 2 + N);
+    for (std::size_t i = 0; i < N; ++i)
+        points.emplace_back(&commits[i]);
+    powers.resize(N);
+    Exponent gPower, h0Power;
+
+    for (std::size_t t = 0; t < K; ++t) {
+        std::size_t setSize = setSizes[t];
+        if (setSize == 0) {
+            LogPrintf("Invalid anonymity set size in sigma batch verification");
+            return false;
+        }
+
+        std::vector<Exponent> f_i_;
+        Exponent x;
+        if (!compute_fis(*proofs[t], setSize, fPadding[t], f_i_, x))
+            return false;
+
+        Exponent y;
+        y.randomize();
+
+        Exponent f_sum;
+        for (std::size_t i = 0; i < setSize; ++i) {
+            powers[setSize - 1 - i] += f_i_[i] * y;
+            f_sum += f_i_[i];
+        }
+        gPower -= y * serials[t] * f_sum;
+        h0Power -= y * proofs[t]->z_;
+
+        Exponent x_k(y);
+        for (int k = 0; k < m; ++k) {
+            points.emplace_back(&proofs[t]->Gk_[k]);
+            powers.emplace_back(x_k.negate());
+            x_k *= x;
+        }
+    }
+
+    points.emplace_back(&g_);
+    powers.emplace_back(gPower);
+    points.emplace_back(&h_[0]);
+    powers.emplace_back(h0Power);
+
+    secp_primitives::MultiExponent mult(points, powers);
+    return mult.get_multiple().isInfinity();
+}
+
+template<class Exponent, class GroupElement>
+bool SigmaPlusVerifier<Exponent, GroupElement>::compute_fis(
+        const SigmaPlusProof<Exponent, GroupElement>& proof,
+        std::size_t N,
+        bool fPadding,
+        std::vector<Exponent>& f_i_,
+        Exponent& x) const {
+
+    R1ProofVerifier<Exponent, GroupElement> r1ProofVerifier(g_, h_, proof.B_, n, m, h_table_);
     std::vector<Exponent> f;
     const R1Proof<Exponent, GroupElement>& r1Proof = proof.r1Proof_;
 
     if (!r1ProofVerifier.verify(r1Proof, f))
         return false;
 
-    if (!proof.B_.isMember() || proof.B_.isInfinity()) {
+    // B was already checked for membership together with the R1 proof elements
+    if (proof.B_.isInfinity()) {
         LogPrintf("Sigma spend failed due to value of B outside of group.");
         return false;
     }
 
     const std::vector <GroupElement>& Gk = proof.Gk_;
     for (int k = 0; k < m; ++k) {
-        if (!Gk[k].isMember() || Gk[k].isInfinity()) {
+        if (Gk[k].isInfinity()) {
             LogPrintf("Sigma spend failed due to value of GK[i] outside of group.");
             return false;
         }
     }
-
-    if(!proof.z_.isMember() || proof.z_.isZero()) {
-        LogPrintf("Sigma spend failed due to value of Z outside of group.");
+    if (!GroupElement::areMembers(std::vector<GroupElement>(Gk.begin(), Gk.begin() + m))) {
+        LogPrintf("Sigma spend failed due to value of GK[i] outside of group.");
         return false;
     }
 
-    if (commits.empty()) {
-        LogPrintf("No mints in the anonymity set");
+    if(!proof.z_.isMember() || proof.z_.isZero()) {
+        LogPrintf("Sigma spend failed due to value of Z outside of group.");
         return false;
     }
 
-    std::size_t N = commits.size();
-
-    std::vector<Exponent> f_i_;
     f_i_.reserve(N);
-    for (std::size_t i = 0; i < (fPadding ? N-1 : N); ++i) {
-        std::vector<uint64_t> I = SigmaPrimitives<Exponent, GroupElement>::convert_to_nal(i, n, m);
-        Exponent f_i(uint64_t(1));
-        for(int j = 0; j < m; ++j){
-            f_i *= f[j*n + I[j]];
-        }
-        f_i_.emplace_back(f_i);
-    }
+    SigmaPrimitives<Exponent, GroupElement>::compute_fis(f, n, m, fPadding ? N-1 : N, f_i_);
 
-    Exponent x = r1ProofVerifier.x_;
+    x = r1ProofVerifier.x_;
 
     if (fPadding) {
         /*
@@ -82,7 +192,7 @@ bool  SigmaPlusVerifier<Exponent, GroupElement>::verify(
 
         Exponent pow(uint64_t(1));
         std::vector<uint64_t> I = SigmaPrimitives<Exponent, GroupElement>::convert_to_nal(N - 1, n, m);
-        vector<Exponent> f_part_product;    // partial product of f array elements for lastIndex
+        std::vector<Exponent> f_part_product;    // partial product of f array elements for lastIndex
         for (int j = m - 1; j >= 0; j--) {
             f_part_product.push_back(pow);
             pow *= f[j * n + I[j]];
@@ -99,19 +209,6 @@ bool  SigmaPlusVerifier<Exponent, GroupElement>::verify(
         f_i_.emplace_back(pow);
     }
 
-    secp_primitives::MultiExponent mult(commits, f_i_);
-    GroupElement t1 = mult.get_multiple();
-    GroupElement t2;
-    Exponent x_k(uint64_t(1));
-    for(int k = 0; k < m; ++k){
-        t2 += (Gk[k] * (x_k.negate()));
-        x_k *= x;
-    }
-
-    GroupElement left(t1 + t2);
-    if(left != SigmaPrimitives<Exponent, GroupElement>::commit(g_, Exponent(uint64_t(0)), h_[0], proof.z_))
-        return false;
-
     return true;
 }
 
@@ -138,6 +138,43 @@ private:
     size_t nPos;
 };
 
+/** Minimal stream for deserializing from a fixed range of bytes owned elsewhere,
+ * such as a memory-mapped file. Nothing is copied until objects are read out.
+ */
+class CSpanReader
+{
+public:
+    CSpanReader(int nTypeIn, int nVersionIn, const unsigned char* pchDataIn, size_t nSizeIn) : nType(nTypeIn), nVersion(nVersionIn), pchData(pchDataIn), nRemaining(nSizeIn) {}
+
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize > nRemaining)
+            throw std::ios_base::failure("CSpanReader::read(): end of data");
+        if (nSize) {
+            memcpy(pch, pchData, nSize);
+            pchData += nSize;
+            nRemaining -= nSize;
+        }
+    }
+    template<typename T>
+    CSpanReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+    int GetVersion() const { return nVersion; }
+    int GetType() const { return nType; }
+    size_t size() const { return nRemaining; }
+    bool empty() const { return nRemaining == 0; }
+
+private:
+    const int nType;
+    const int nVersion;
+    const unsigned char* pchData;
+    size_t nRemaining;
+};
+
 /** Double ended buffer combining vector and stream-like interfaces.
  *
  * >> and << read and write unformatted data using the above serialization templates.
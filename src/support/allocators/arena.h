@@ -0,0 +1,83 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_ARENA_H
+#define BITCOIN_SUPPORT_ALLOCATORS_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Bump allocator handing out memory from a few large chunks. Nothing is freed on its
+ * own, all chunks go at once when the arena is destroyed. Not thread safe: fill it
+ * from one thread, after that only its lifetime is shared.
+ */
+class CMonotonicArena
+{
+public:
+    explicit CMonotonicArena(size_t nChunkSizeIn) : nChunkSize(std::max(nChunkSizeIn, size_t(256))), pos(nullptr), end(nullptr) {}
+
+    CMonotonicArena(const CMonotonicArena&) = delete;
+    CMonotonicArena& operator=(const CMonotonicArena&) = delete;
+
+    void* Allocate(size_t nSize, size_t nAlign)
+    {
+        char* p = Align(pos, nAlign);
+        if (!pos || p + nSize > end) {
+            // Grow geometrically so a bad size hint costs few extra chunks
+            size_t nNew = std::max(nChunkSize, nSize + nAlign);
+            vChunks.emplace_back(new char[nNew]);
+            pos = vChunks.back().get();
+            end = pos + nNew;
+            nChunkSize *= 2;
+            p = Align(pos, nAlign);
+        }
+        pos = p + nSize;
+        return p;
+    }
+
+    size_t Chunks() const { return vChunks.size(); }
+
+private:
+    static char* Align(char* p, size_t nAlign)
+    {
+        uintptr_t n = reinterpret_cast<uintptr_t>(p);
+        return reinterpret_cast<char*>((n + nAlign - 1) & ~(uintptr_t)(nAlign - 1));
+    }
+
+    size_t nChunkSize;
+    std::vector<std::unique_ptr<char[]>> vChunks;
+    char* pos;
+    char* end;
+};
+
+/** Allocates from a shared CMonotonicArena, which lives as long as any copy of the allocator */
+template <typename T>
+struct arena_allocator {
+    typedef T value_type;
+
+    std::shared_ptr<CMonotonicArena> arena;
+
+    explicit arena_allocator(std::shared_ptr<CMonotonicArena> arenaIn) noexcept : arena(std::move(arenaIn)) {}
+    template <typename U>
+    arena_allocator(const arena_allocator<U>& a) noexcept : arena(a.arena) {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(arena->Allocate(sizeof(T) * n, alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept {}
+
+    template <typename U>
+    bool operator==(const arena_allocator<U>& a) const noexcept { return arena == a.arena; }
+    template <typename U>
+    bool operator!=(const arena_allocator<U>& a) const noexcept { return arena != a.arena; }
+};
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_ARENA_H
@@ -0,0 +1,128 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Hands out small blocks packed into large chunks, keeping freed blocks on a free list
+ * per size to be reused by the next allocation of that size. Node-based containers
+ * using a pool_allocator get their nodes this way instead of one malloc each, with no
+ * per allocation overhead and neighbouring nodes close in memory. Larger requests go
+ * to operator new. Chunks are only returned when the resource is destroyed.
+ * Not thread safe.
+ */
+class CPoolResource
+{
+public:
+    //! Blocks are multiples of this, which is also the alignment they get
+    static const size_t BLOCK_ALIGN = alignof(std::max_align_t);
+    //! Largest request served from the chunks
+    static const size_t MAX_BLOCK_SIZE = 256;
+    static const size_t CHUNK_SIZE = 256 << 10;
+
+    CPoolResource() : pos(nullptr), end(nullptr) { vFree.fill(nullptr); }
+
+    CPoolResource(const CPoolResource&) = delete;
+    CPoolResource& operator=(const CPoolResource&) = delete;
+
+    void* Allocate(size_t nSize, size_t nAlign)
+    {
+        if (!IsPooled(nSize, nAlign))
+            return ::operator new(nSize);
+
+        size_t nClass = SizeClass(nSize);
+        if (FreeBlock* block = vFree[nClass]) {
+            vFree[nClass] = block->next;
+            return block;
+        }
+        size_t nBlock = (nClass + 1) * BLOCK_ALIGN;
+        if (pos == nullptr || (size_t)(end - pos) < nBlock) {
+            vChunks.emplace_back(new char[CHUNK_SIZE]);
+            pos = vChunks.back().get();
+            end = pos + CHUNK_SIZE;
+        }
+        void* p = pos;
+        pos += nBlock;
+        return p;
+    }
+
+    void Deallocate(void* p, size_t nSize, size_t nAlign) noexcept
+    {
+        if (!IsPooled(nSize, nAlign)) {
+            ::operator delete(p);
+            return;
+        }
+        size_t nClass = SizeClass(nSize);
+        vFree[nClass] = new (p) FreeBlock(vFree[nClass]);
+    }
+
+    size_t Chunks() const { return vChunks.size(); }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+        explicit FreeBlock(FreeBlock* nextIn) : next(nextIn) {}
+    };
+
+    static bool IsPooled(size_t nSize, size_t nAlign)
+    {
+        return nSize != 0 && nSize <= MAX_BLOCK_SIZE && nAlign <= BLOCK_ALIGN;
+    }
+
+    static size_t SizeClass(size_t nSize) { return (nSize - 1) / BLOCK_ALIGN; }
+
+    std::vector<std::unique_ptr<char[]>> vChunks;
+    //! free blocks of each size class
+    std::array<FreeBlock*, MAX_BLOCK_SIZE / BLOCK_ALIGN> vFree;
+    //! unused part of the last chunk
+    char* pos;
+    char* end;
+};
+
+/**
+ * Allocates from a shared CPoolResource, which lives as long as any copy of the allocator.
+ * A default constructed allocator makes a resource of its own. Containers hand their
+ * resource over along with their contents on move and swap. A moved from allocator
+ * keeps its resource, so a moved from container can still be used.
+ */
+template <typename T>
+struct pool_allocator {
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    std::shared_ptr<CPoolResource> pool;
+
+    pool_allocator() : pool(std::make_shared<CPoolResource>()) {}
+    explicit pool_allocator(std::shared_ptr<CPoolResource> poolIn) noexcept : pool(std::move(poolIn)) {}
+    pool_allocator(const pool_allocator& a) noexcept : pool(a.pool) {}
+    template <typename U>
+    pool_allocator(const pool_allocator<U>& a) noexcept : pool(a.pool) {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(pool->Allocate(sizeof(T) * n, alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        pool->Deallocate(p, sizeof(T) * n, alignof(T));
+    }
+
+    template <typename U>
+    bool operator==(const pool_allocator<U>& a) const noexcept { return pool == a.pool; }
+    template <typename U>
+    bool operator!=(const pool_allocator<U>& a) const noexcept { return pool != a.pool; }
+};
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
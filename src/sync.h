@@ -6,6 +6,7 @@
 #ifndef BITCOIN_SYNC_H
 #define BITCOIN_SYNC_H
 
+#include <perf.h>
 #include <threadsafety.h>
 
 #include <condition_variable>
@@ -117,10 +118,23 @@ class SCOPED_LOCKABLE CCriticalBlock
 {
 private:
     std::unique_lock<CCriticalSection> lock;
+    // Set while -lockprofile records this acquisition
+    CLockSiteStats* pLockSite = nullptr;
+    int64_t nLockedMicros = 0;
 
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
+        if (g_lock_profiling.load(std::memory_order_relaxed) && (pLockSite = GetLockSiteStats(pszName, pszFile, nLine))) {
+            int64_t nStart = PerfTimeMicros();
+            if (!lock.try_lock()) {
+                pLockSite->nContended.fetch_add(1, std::memory_order_relaxed);
+                lock.lock();
+            }
+            nLockedMicros = PerfTimeMicros();
+            pLockSite->wait.Add(nLockedMicros - nStart);
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -137,6 +151,8 @@ private:
         lock.try_lock();
         if (!lock.owns_lock())
             LeaveCritical();
+        else if (g_lock_profiling.load(std::memory_order_relaxed) && (pLockSite = GetLockSiteStats(pszName, pszFile, nLine)))
+            nLockedMicros = PerfTimeMicros();
         return lock.owns_lock();
     }
 
@@ -162,8 +178,11 @@ public:
 
     ~CCriticalBlock() UNLOCK_FUNCTION()
     {
-        if (lock.owns_lock())
+        if (lock.owns_lock()) {
+            if (pLockSite)
+                pLockSite->hold.Add(PerfTimeMicros() - nLockedMicros);
             LeaveCritical();
+        }
     }
 
     operator bool()
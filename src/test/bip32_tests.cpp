@@ -5,6 +5,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <base58.h>
+#include <ghost-address/extkey.h>
 #include <key.h>
 #include <uint256.h>
 #include <util.h>
@@ -159,4 +160,25 @@ BOOST_AUTO_TEST_CASE(bip32_test3) {
     RunTest(test3);
 }
 
+BOOST_AUTO_TEST_CASE(bip32_derive_keys) {
+    std::vector<unsigned char> seed = ParseHex(test1.strHexMaster);
+    CExtKey key;
+    key.SetMaster(seed.data(), seed.size());
+    CStoredExtKey sek;
+    sek.kp = CExtKeyPair(key);
+
+    for (int nThreads : {1, 4}) {
+        std::vector<std::pair<uint32_t, CPubKey> > vKeys;
+        BOOST_CHECK_EQUAL(sek.DeriveKeys(vKeys, 5, 50, nThreads), 0);
+        BOOST_CHECK_EQUAL(vKeys.size(), 50U);
+        for (const auto& entry : vKeys) {
+            CPubKey pk;
+            uint32_t nChildOut;
+            BOOST_CHECK_EQUAL(sek.DeriveKey(pk, entry.first, nChildOut), 0);
+            BOOST_CHECK_EQUAL(nChildOut, entry.first);
+            BOOST_CHECK(pk == entry.second);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
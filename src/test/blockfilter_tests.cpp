@@ -0,0 +1,122 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilter.h>
+#include <coins.h>
+#include <keystore.h>
+#include <primitives/block.h>
+#include <script/standard.h>
+#include <undo.h>
+#include <utilstrencodings.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilter_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(gcsfilter_test)
+{
+    GCSFilter::ElementSet included;
+    GCSFilter::ElementSet excluded;
+    for (int i = 0; i < 100; ++i) {
+        GCSFilter::Element element1(32);
+        element1[0] = i;
+        included.insert(std::move(element1));
+
+        GCSFilter::Element element2(32);
+        element2[1] = i;
+        excluded.insert(std::move(element2));
+    }
+
+    GCSFilter filter(GCSFilter::Params(0, 0, 10, 1 << 10), included);
+    BOOST_CHECK_EQUAL(filter.GetN(), 100U);
+    for (const GCSFilter::Element& element : included) {
+        BOOST_CHECK(filter.Match(element));
+
+        GCSFilter::ElementSet single = {element};
+        BOOST_CHECK(filter.MatchAny(single));
+        single.insert(excluded.begin(), excluded.end());
+        BOOST_CHECK(filter.MatchAny(single));
+    }
+
+    // The decoded filter matches the same elements
+    GCSFilter decoded(filter.GetParams(), filter.GetEncoded());
+    BOOST_CHECK_EQUAL(decoded.GetN(), 100U);
+    for (const GCSFilter::Element& element : included)
+        BOOST_CHECK(decoded.Match(element));
+
+    // An empty filter matches nothing
+    GCSFilter empty(GCSFilter::Params(0, 0, 10, 1 << 10), GCSFilter::ElementSet());
+    BOOST_CHECK_EQUAL(empty.GetEncoded().size(), 1U);
+    BOOST_CHECK(!empty.MatchAny(included));
+
+    // Too short for the claimed number of elements
+    std::vector<unsigned char> vTruncated(filter.GetEncoded().begin(), filter.GetEncoded().begin() + 10);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), vTruncated), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_bip158_vector)
+{
+    // The basic filter of the bitcoin testnet genesis block, from the BIP158 test vectors
+    uint256 blockHash = uint256S("000000000933ea01ad0ee984209779baaec3ced90fa3f408719526f8d77f4943");
+    GCSFilter::ElementSet elements = {ParseHex("4104678afdb0fe5548271967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac")};
+    GCSFilter filter(GCSFilter::Params(blockHash.GetUint64(0), blockHash.GetUint64(1), BASIC_FILTER_P, BASIC_FILTER_M), elements);
+    BOOST_CHECK_EQUAL(HexStr(filter.GetEncoded()), "019dfca8");
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_basic_test)
+{
+    CScript scriptStaker = GetScriptForDestination(CKeyID(uint160(std::vector<unsigned char>(20, 1))));
+    CScript scriptOwner = GetScriptForDestination(CKeyID(uint160(std::vector<unsigned char>(20, 2))));
+    CScript scriptDelegated = CScript() << OP_ISCOINSTAKE << OP_IF;
+    scriptDelegated += scriptStaker;
+    scriptDelegated << OP_ELSE;
+    scriptDelegated += scriptOwner;
+    scriptDelegated << OP_ENDIF;
+
+    CScript scriptSpent = GetScriptForDestination(CKeyID(uint160(std::vector<unsigned char>(20, 3))));
+    CScript scriptOther = GetScriptForDestination(CKeyID(uint160(std::vector<unsigned char>(20, 4))));
+
+    CMutableTransaction tx;
+    tx.vin.emplace_back(COutPoint(uint256S("01"), 0));
+    tx.vout.emplace_back(100, scriptDelegated);
+    tx.vout.emplace_back(0, CScript() << OP_RETURN << std::vector<unsigned char>(4, 5));
+    tx.vout.emplace_back(0, CScript());
+
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(CMutableTransaction()));
+    block.vtx.push_back(MakeTransactionRef(tx));
+
+    CBlockUndo blockUndo;
+    blockUndo.vtxundo.emplace_back();
+    blockUndo.vtxundo.back().vprevout.emplace_back(CTxOut(500, scriptSpent), 1, false);
+
+    BlockFilter filter(BlockFilterType::BASIC, block, blockUndo);
+    const GCSFilter& gcs = filter.GetFilter();
+    BOOST_CHECK(gcs.Match(GCSFilter::Element(scriptDelegated.begin(), scriptDelegated.end())));
+    BOOST_CHECK(gcs.Match(GCSFilter::Element(scriptStaker.begin(), scriptStaker.end())));
+    BOOST_CHECK(gcs.Match(GCSFilter::Element(scriptOwner.begin(), scriptOwner.end())));
+    BOOST_CHECK(gcs.Match(GCSFilter::Element(scriptSpent.begin(), scriptSpent.end())));
+    BOOST_CHECK(!gcs.Match(GCSFilter::Element(scriptOther.begin(), scriptOther.end())));
+    // OP_RETURN and empty scripts are left out
+    BOOST_CHECK_EQUAL(gcs.GetN(), 4U);
+
+    // A filter read back from its encoding is the same filter
+    BlockFilter decoded(BlockFilterType::BASIC, block.GetHash(), filter.GetEncodedFilter());
+    BOOST_CHECK(decoded.GetHash() == filter.GetHash());
+    BOOST_CHECK(decoded.GetFilter().Match(GCSFilter::Element(scriptSpent.begin(), scriptSpent.end())));
+
+    // Headers chain the filters
+    uint256 header = filter.ComputeHeader(uint256());
+    BOOST_CHECK(header != filter.ComputeHeader(header));
+
+    BlockFilterType filterType;
+    BOOST_CHECK(BlockFilterTypeByName("basic", filterType));
+    BOOST_CHECK(filterType == BlockFilterType::BASIC);
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(BlockFilterType::BASIC), "basic");
+    BOOST_CHECK(!BlockFilterTypeByName("unknown", filterType));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
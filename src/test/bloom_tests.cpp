@@ -178,6 +178,32 @@ BOOST_AUTO_TEST_CASE(bloom_match)
     BOOST_CHECK_MESSAGE(!filter.IsRelevantAndUpdate(tx), "Simple Bloom filter matched COutPoint for an output we didn't care about");
 }
 
+BOOST_AUTO_TEST_CASE(bloom_match_sigma_spend)
+{
+    // A push inside the proof of a spend is not a script element, the spent outpoint still matches
+    std::vector<unsigned char> vPush(20, 0xab);
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(uint256S("0x90c122d70786e899529d71dbeba91ba216982fb6ba58f3bdaab65e73b7e9260b"), 0);
+    mtx.vin[0].scriptSig = CScript() << OP_SIGMASPEND << vPush;
+    mtx.vout.resize(1);
+    CTransaction tx(mtx);
+
+    CBloomFilter filter(10, 0.000001, 0, BLOOM_UPDATE_ALL);
+    filter.insert(vPush);
+    BOOST_CHECK(!filter.IsRelevantAndUpdate(tx));
+
+    filter = CBloomFilter(10, 0.000001, 0, BLOOM_UPDATE_ALL);
+    filter.insert(mtx.vin[0].prevout);
+    BOOST_CHECK(filter.IsRelevantAndUpdate(CBloomTxElements(tx)));
+
+    // The same push in an ordinary scriptSig matches
+    mtx.vin[0].scriptSig = CScript() << vPush;
+    filter = CBloomFilter(10, 0.000001, 0, BLOOM_UPDATE_ALL);
+    filter.insert(vPush);
+    BOOST_CHECK(filter.IsRelevantAndUpdate(CTransaction(mtx)));
+}
+
 BOOST_AUTO_TEST_CASE(merkle_block_1)
 {
     CBlock block = getBlock13b8a();
@@ -125,6 +125,12 @@ struct FrozenCleanupCheck {
     void swap(FrozenCleanupCheck& x){std::swap(should_freeze, x.should_freeze);};
 };
 
+struct HeavyUniqueCheck : public UniqueCheck {
+    HeavyUniqueCheck() {}
+    HeavyUniqueCheck(size_t check_id_in) : UniqueCheck(check_id_in) {}
+    unsigned int GetWeight() const { return QUEUE_BATCH_SIZE / 2; }
+};
+
 // Static Allocations
 std::mutex FrozenCleanupCheck::m{};
 std::atomic<uint64_t> FrozenCleanupCheck::nFrozen{0};
@@ -141,6 +147,7 @@ typedef CCheckQueue<FailingCheck> Failing_Queue;
 typedef CCheckQueue<UniqueCheck> Unique_Queue;
 typedef CCheckQueue<MemoryCheck> Memory_Queue;
 typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
+typedef CCheckQueue<CCheckVariant<FailingCheck, HeavyUniqueCheck>> Mixed_Queue;
 
 
 /** This test case checks that the CCheckQueue works properly
@@ -381,6 +388,59 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_FrozenCleanup)
 }
 
 
+// Test that checks of different types and weights in the same queue are all called
+// once, and that a failing one is caught
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Mixed)
+{
+    typedef CCheckVariant<FailingCheck, HeavyUniqueCheck> MixedCheck;
+    FailingCheck light(false);
+    HeavyUniqueCheck heavy(1);
+    BOOST_CHECK_EQUAL(GetCheckWeight(light), 1U);
+    BOOST_CHECK_EQUAL(GetCheckWeight(heavy), QUEUE_BATCH_SIZE / 2);
+    BOOST_CHECK_EQUAL(GetCheckWeight(MixedCheck(heavy)), QUEUE_BATCH_SIZE / 2);
+
+    auto queue = std::unique_ptr<Mixed_Queue>(new Mixed_Queue {QUEUE_BATCH_SIZE});
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{queue->Thread();});
+    }
+
+    UniqueCheck::results.clear();
+    size_t COUNT = 10000;
+    for (bool fails : {false, true}) {
+        size_t nHeavy = 0;
+        CCheckQueueControl<MixedCheck> control(queue.get());
+        for (size_t i = 0; i < COUNT; ++i) {
+            size_t r = 1 + InsecureRandRange(10);
+            std::vector<MixedCheck> vChecks;
+            for (size_t k = 0; k < r; k++) {
+                if (fails && i == COUNT / 2 && k == 0) {
+                    FailingCheck check(true);
+                    vChecks.emplace_back(check);
+                } else if (InsecureRandRange(4) == 0) {
+                    HeavyUniqueCheck check(nHeavy++);
+                    vChecks.emplace_back(check);
+                } else {
+                    FailingCheck check(false);
+                    vChecks.emplace_back(check);
+                }
+            }
+            control.Add(vChecks);
+        }
+        bool r = control.Wait();
+        if (fails) {
+            BOOST_REQUIRE(!r);
+            continue;
+        }
+        BOOST_REQUIRE(r);
+        BOOST_REQUIRE_EQUAL(UniqueCheck::results.size(), nHeavy);
+        for (size_t i = 0; i < nHeavy; ++i)
+            BOOST_REQUIRE_EQUAL(UniqueCheck::results.count(i), 1U);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
 /** Test that CCheckQueueControl is threadsafe */
 BOOST_AUTO_TEST_CASE(test_CheckQueueControl_Locks)
 {
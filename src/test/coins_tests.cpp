@@ -8,6 +8,7 @@
 #include <undo.h>
 #include <utilstrencodings.h>
 #include <test/test_bitcoin.h>
+#include <txdb.h>
 #include <validation.h>
 #include <consensus/validation.h>
 
@@ -855,4 +856,90 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_pool)
+{
+    CPoolResource pool;
+
+    // freed blocks are reused by the next allocation of their size only
+    void* p1 = pool.Allocate(40, 8);
+    void* p2 = pool.Allocate(100, 8);
+    BOOST_CHECK_EQUAL(pool.Chunks(), 1U);
+    pool.Deallocate(p1, 40, 8);
+    BOOST_CHECK(pool.Allocate(100, 8) != p1);
+    BOOST_CHECK(pool.Allocate(33, 8) == p1);
+    pool.Deallocate(p2, 100, 8);
+    BOOST_CHECK(pool.Allocate(97, 8) == p2);
+
+    // large requests don't take pool memory
+    void* pLarge = pool.Allocate(CPoolResource::CHUNK_SIZE, 8);
+    BOOST_CHECK_EQUAL(pool.Chunks(), 1U);
+    pool.Deallocate(pLarge, CPoolResource::CHUNK_SIZE, 8);
+
+    // a new chunk once the first is used up
+    for (size_t i = 0; i <= CPoolResource::CHUNK_SIZE / 64; i++)
+        pool.Allocate(64, 8);
+    BOOST_CHECK_EQUAL(pool.Chunks(), 2U);
+
+    // a flushed cache gives its memory back
+    CCoinsView base;
+    CCoinsViewCacheTest cache(&base);
+    size_t nEmptyUsage = cache.DynamicMemoryUsage();
+    for (int i = 0; i < 10000; i++) {
+        Coin coin;
+        coin.out.nValue = i;
+        cache.AddCoin(COutPoint(InsecureRand256(), 0), std::move(coin), false);
+    }
+    cache.SelfTest();
+    BOOST_CHECK(cache.DynamicMemoryUsage() > nEmptyUsage);
+    cache.Flush();
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK_EQUAL(cache.map().get_allocator().pool->Chunks(), 0U);
+    cache.SelfTest();
+}
+
+BOOST_FIXTURE_TEST_CASE(ccoins_background_flush, TestingSetup)
+{
+    CCoinsViewDB db(1 << 20, true);
+    db.StartBackgroundFlush();
+    CCoinsViewCacheTest cache(&db);
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 1000; i++) {
+        Coin coin;
+        coin.out.nValue = i;
+        outpoints.emplace_back(InsecureRand256(), 0);
+        cache.AddCoin(outpoints.back(), std::move(coin), false);
+    }
+    uint256 hashBlock = InsecureRand256();
+    cache.SetBestBlock(hashBlock);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+
+    // the coins are readable whether or not they are written yet
+    Coin coin;
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    BOOST_CHECK(db.GetCoin(outpoints[7], coin) && coin.out.nValue == 7);
+
+    // a second flush waits for the first
+    BOOST_CHECK(cache.SpendCoin(outpoints[7]));
+    uint256 hashBlock2 = InsecureRand256();
+    cache.SetBestBlock(hashBlock2);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!db.HaveCoin(outpoints[7]));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock2);
+
+    BOOST_CHECK(db.WaitForFlush());
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_CHECK(db.GetBestBlock() == hashBlock2);
+    BOOST_CHECK(!db.GetCoin(outpoints[7], coin));
+    BOOST_CHECK(db.GetCoin(outpoints[8], coin) && coin.out.nValue == 8);
+
+    std::unique_ptr<CCoinsViewCursor> cursor(db.Cursor());
+    BOOST_CHECK(cursor->GetBestBlock() == hashBlock2);
+    size_t nCoins = 0;
+    for (; cursor->Valid(); cursor->Next())
+        nCoins++;
+    BOOST_CHECK_EQUAL(nCoins, outpoints.size() - 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
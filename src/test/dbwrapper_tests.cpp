@@ -114,6 +114,17 @@ BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
 
         it->Next();
         BOOST_CHECK_EQUAL(it->Valid(), false);
+
+        // And back again
+        it->SeekToLast();
+        it->GetKey(key_res);
+        BOOST_CHECK_EQUAL(key_res, key2);
+
+        it->Prev();
+        it->GetKey(key_res);
+        it->GetValue(val_res);
+        BOOST_CHECK_EQUAL(key_res, key);
+        BOOST_CHECK_EQUAL(val_res.ToString(), in.ToString());
     }
 }
 
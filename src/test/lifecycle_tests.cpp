@@ -0,0 +1,55 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <lifecycle.h>
+#include <random.h>
+#include <utiltime.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(lifecycle_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(lifecycle_stages)
+{
+    const uint256 hash = InsecureRand256();
+    CLifecycleRecord record;
+
+    // Transactions are only tracked from the time they are received or accepted
+    TraceLifecycle(LifecycleObject::TX, hash, LifecycleStage::RELAYED);
+    BOOST_CHECK(!GetLifecycle(LifecycleObject::TX, hash, record));
+
+    TraceLifecycle(LifecycleObject::TX, hash, LifecycleStage::RECEIVED);
+    TraceLifecycle(LifecycleObject::TX, hash, LifecycleStage::ACCEPTED);
+    BOOST_CHECK(GetLifecycle(LifecycleObject::TX, hash, record));
+    BOOST_CHECK(record.hash == hash);
+    const int64_t nAccepted = record.vStageMicros[(size_t)LifecycleStage::ACCEPTED];
+    BOOST_CHECK(record.vStageMicros[(size_t)LifecycleStage::RECEIVED] != 0);
+    BOOST_CHECK(nAccepted >= record.vStageMicros[(size_t)LifecycleStage::RECEIVED]);
+    BOOST_CHECK_EQUAL(record.vStageMicros[(size_t)LifecycleStage::CONNECTED], 0);
+
+    // Only the first time a stage is reached counts
+    MilliSleep(1);
+    TraceLifecycle(LifecycleObject::TX, hash, LifecycleStage::ACCEPTED);
+    BOOST_CHECK(GetLifecycle(LifecycleObject::TX, hash, record));
+    BOOST_CHECK_EQUAL(record.vStageMicros[(size_t)LifecycleStage::ACCEPTED], nAccepted);
+
+    // Blocks and transactions are kept apart
+    BOOST_CHECK(!GetLifecycle(LifecycleObject::BLOCK, hash, record));
+
+    // The oldest records make room for new ones
+    for (size_t i = 0; i < LIFECYCLE_TX_RECORDS; i++)
+        TraceLifecycle(LifecycleObject::TX, InsecureRand256(), LifecycleStage::RECEIVED);
+    BOOST_CHECK(!GetLifecycle(LifecycleObject::TX, hash, record));
+
+    g_lifecycle_tracing = false;
+    TraceLifecycle(LifecycleObject::BLOCK, hash, LifecycleStage::RECEIVED);
+    BOOST_CHECK(!GetLifecycle(LifecycleObject::BLOCK, hash, record));
+    g_lifecycle_tracing = DEFAULT_LIFECYCLE_TRACING;
+
+    BOOST_CHECK_EQUAL(LifecycleStageName(LifecycleStage::ZMQ_PUBLISHED), "zmq_published");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -571,4 +571,70 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolAddressSpentIndexTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+
+    uint160 keyId(ParseHex("0102030405060708090a0b0c0d0e0f1011121314"));
+    CScript scriptPubKey = CScript() << OP_DUP << OP_HASH160 << ToByteVector(keyId) << OP_EQUALVERIFY << OP_CHECKSIG;
+    std::vector<uint8_t> hashBytes(keyId.begin(), keyId.end());
+    std::vector<std::pair<uint256, int> > addresses{{uint256(hashBytes.data(), hashBytes.size()), ADDR_INDT_PUBKEY_ADDRESS}};
+
+    COutPoint prevout(uint256S("01"), 0);
+    view.AddCoin(prevout, Coin(CTxOut(5 * COIN, scriptPubKey), 1, false), false);
+
+    // Spends the coin of the address and pays it back
+    CMutableTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].prevout = prevout;
+    tx1.vout.resize(1);
+    tx1.vout[0].nValue = 4 * COIN;
+    tx1.vout[0].scriptPubKey = scriptPubKey;
+
+    CMutableTransaction tx2;
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx2.vout.resize(1);
+    tx2.vout[0].nValue = 3 * COIN;
+    tx2.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+
+    CTxMemPoolEntry entry1 = entry.Time(1).FromTx(tx1);
+    CTxMemPoolEntry entry2 = entry.Time(2).FromTx(tx2);
+    pool.addAddressIndex(entry1, view);
+    pool.addSpentIndex(entry1, view);
+    pool.addAddressIndex(entry2, view);
+    pool.addSpentIndex(entry2, view);
+
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > deltas;
+    BOOST_CHECK(pool.getAddressIndex(addresses, deltas));
+    BOOST_REQUIRE_EQUAL(deltas.size(), 2U);
+    BOOST_CHECK_EQUAL(deltas[0].second.amount, -5 * COIN);
+    BOOST_CHECK(deltas[0].second.prevhash == prevout.hash);
+    BOOST_CHECK_EQUAL(deltas[1].second.amount, 4 * COIN);
+
+    CSpentIndexKey key(prevout.hash, prevout.n);
+    CSpentIndexValue value;
+    BOOST_CHECK(pool.getSpentIndex(key, value));
+    BOOST_CHECK(value.txid == tx1.GetHash());
+    BOOST_CHECK_EQUAL(value.satoshis, 5 * COIN);
+
+    // The output of tx1 isn't in the view, so its spend by tx2 isn't indexed
+    CSpentIndexKey key2(tx1.GetHash(), 0);
+    BOOST_CHECK(!pool.getSpentIndex(key2, value));
+
+    pool.removeAddressIndex(tx1.GetHash());
+    pool.removeSpentIndex(tx1.GetHash());
+    deltas.clear();
+    BOOST_CHECK(pool.getAddressIndex(addresses, deltas));
+    BOOST_CHECK(deltas.empty());
+    BOOST_CHECK(!pool.getSpentIndex(key, value));
+
+    // Removing a transaction again or one that was never added does nothing
+    BOOST_CHECK(pool.removeAddressIndex(tx1.GetHash()));
+    BOOST_CHECK(pool.removeSpentIndex(tx2.GetHash()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <ghostnode/netfulfilledman.h>
+#include <netbase.h>
+#include <streams.h>
+#include <utiltime.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(netfulfilledman_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(netfulfilledman_expiry)
+{
+    const int64_t nStart = 1500000000;
+    const int64_t nExpire = Params().FulfilledRequestExpireTime();
+    CAddress addr1(LookupNumeric("1.2.3.4", 8333), NODE_NONE);
+    CAddress addr2(LookupNumeric("5.6.7.8", 8333), NODE_NONE);
+    CNetFulfilledRequestManager man;
+
+    SetMockTime(nStart);
+    man.CheckAndRemove();
+    man.AddFulfilledRequest(addr1, FULFILLED_GHOSTNODE_LIST_SYNC);
+    BOOST_CHECK(man.HasFulfilledRequest(addr1, FULFILLED_GHOSTNODE_LIST_SYNC));
+    BOOST_CHECK(!man.HasFulfilledRequest(addr1, FULFILLED_SPORK_SYNC));
+    BOOST_CHECK(!man.HasFulfilledRequest(addr2, FULFILLED_GHOSTNODE_LIST_SYNC));
+
+    // a later request keeps the address past the first expiry
+    SetMockTime(nStart + nExpire / 2);
+    man.CheckAndRemove();
+    man.AddFulfilledRequest(addr1, FULFILLED_SPORK_SYNC);
+    man.AddFulfilledRequest(addr2, FULFILLED_FULL_SYNC);
+    man.RemoveFulfilledRequest(addr2, FULFILLED_FULL_SYNC);
+    BOOST_CHECK(!man.HasFulfilledRequest(addr2, FULFILLED_FULL_SYNC));
+
+    SetMockTime(nStart + nExpire + 120);
+    man.CheckAndRemove();
+    BOOST_CHECK(!man.HasFulfilledRequest(addr1, FULFILLED_GHOSTNODE_LIST_SYNC));
+    BOOST_CHECK(man.HasFulfilledRequest(addr1, FULFILLED_SPORK_SYNC));
+    BOOST_CHECK_EQUAL(man.ToString(), "Nodes with fulfilled requests: 1");
+
+    // stored by name and read back with the same expiry
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << man;
+    CNetFulfilledRequestManager man2;
+    ss >> man2;
+    BOOST_CHECK(man2.HasFulfilledRequest(addr1, FULFILLED_SPORK_SYNC));
+    BOOST_CHECK(!man2.HasFulfilledRequest(addr1, FULFILLED_GHOSTNODE_LIST_SYNC));
+
+    SetMockTime(nStart + nExpire / 2 + nExpire + 120);
+    man.CheckAndRemove();
+    BOOST_CHECK(!man.HasFulfilledRequest(addr1, FULFILLED_SPORK_SYNC));
+    BOOST_CHECK_EQUAL(man.ToString(), "Nodes with fulfilled requests: 0");
+
+    // left alone for longer than a turn of the wheel
+    man.AddFulfilledRequest(addr2, FULFILLED_MNVERIFY_DONE);
+    SetMockTime(nStart + 10 * nExpire);
+    man.CheckAndRemove();
+    BOOST_CHECK_EQUAL(man.ToString(), "Nodes with fulfilled requests: 0");
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
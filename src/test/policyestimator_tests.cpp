@@ -179,4 +179,49 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     }
 }
 
+BOOST_AUTO_TEST_CASE(PrivacyTrackEstimates)
+{
+    CBlockPolicyEstimator feeEst;
+    CTxMemPool mpool(&feeEst);
+    TestMemPoolEntryHelper entry;
+    CAmount nFee(20000);
+
+    // A sigma mint of one coin, its ghost protocol fee is 0.25% of the amount minted
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = COIN;
+    tx.vout[0].scriptPubKey = CScript() << OP_SIGMAMINT << std::vector<unsigned char>(34, 1);
+    const CAmount nGhostFee = COIN / 400;
+    BOOST_CHECK(IsPrivacyTransaction(tx));
+    BOOST_CHECK_EQUAL(GetGhostProtocolFee(tx, nGhostFee + nFee), nGhostFee);
+    BOOST_CHECK_EQUAL(GetGhostProtocolFee(tx, nFee), nFee);
+
+    CMutableTransaction txPlain;
+    txPlain.vin.resize(1);
+    txPlain.vout.resize(1);
+    BOOST_CHECK(!IsPrivacyTransaction(txPlain));
+    BOOST_CHECK_EQUAL(GetGhostProtocolFee(txPlain, nFee), 0);
+
+    // Only privacy transactions, each confirmed in the next block
+    std::vector<CTransactionRef> block;
+    for (int blocknum = 0; blocknum < 200; blocknum++) {
+        for (int k = 0; k < 10; k++) {
+            tx.vin[0].prevout.n = 100*blocknum+k; // make transaction unique
+            uint256 hash = tx.GetHash();
+            mpool.addUnchecked(hash, entry.Fee(nGhostFee + nFee).Time(GetTime()).Height(blocknum).FromTx(tx));
+            block.push_back(mpool.get(hash));
+        }
+        mpool.removeForBlock(block, blocknum + 1);
+        block.clear();
+    }
+
+    // They say nothing of the standard transactions, and their estimate leaves out the ghost fee
+    FeeCalculation feeCalc;
+    BOOST_CHECK(feeEst.estimateSmartFee(2, &feeCalc, false) == CFeeRate(0));
+    CFeeRate privacyRate = feeEst.estimateSmartFee(2, &feeCalc, false, FeeEstimateTrack::PRIVACY);
+    BOOST_CHECK(privacyRate > CFeeRate(0));
+    BOOST_CHECK(privacyRate < CFeeRate(nGhostFee, ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION)));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
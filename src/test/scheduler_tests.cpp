@@ -112,4 +112,50 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+BOOST_AUTO_TEST_CASE(priorities)
+{
+    CScheduler scheduler;
+    std::vector<int> order;
+
+    // all due by the time the thread starts, the high priority ones go first
+    boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+    scheduler.schedule([&order] { order.push_back(0); }, now - boost::chrono::seconds(2), CScheduler::PRIORITY_LOW);
+    scheduler.schedule([&order] { order.push_back(1); }, now - boost::chrono::seconds(1));
+    scheduler.schedule([&order] { order.push_back(2); }, now, CScheduler::PRIORITY_HIGH);
+    scheduler.schedule([&order] { order.push_back(3); }, now - boost::chrono::seconds(1), CScheduler::PRIORITY_HIGH);
+    // not due yet, so it waits whatever its priority
+    scheduler.schedule([&order] { order.push_back(4); }, now + boost::chrono::milliseconds(100), CScheduler::PRIORITY_HIGH);
+
+    scheduler.stop(true);
+    scheduler.serviceQueue();
+    BOOST_CHECK(order == std::vector<int>({3, 2, 1, 0, 4}));
+}
+
+BOOST_AUTO_TEST_CASE(serial_clients)
+{
+    CScheduler scheduler;
+    SingleThreadedSchedulerClient client1(&scheduler), client2(&scheduler, CScheduler::PRIORITY_HIGH);
+    std::vector<int> order1, order2;
+    for (int i = 0; i < 100; i++) {
+        client1.AddToProcessQueue([&order1, i] { order1.push_back(i); });
+        client2.AddToProcessQueue([&order2, i] { order2.push_back(i); });
+    }
+
+    // the clients run side by side, each in its own order
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    while (client1.CallbacksPending() || client2.CallbacksPending())
+        MicroSleep(1000);
+    scheduler.stop(true);
+    threads.join_all();
+
+    BOOST_CHECK_EQUAL(order1.size(), 100U);
+    BOOST_CHECK_EQUAL(order2.size(), 100U);
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK_EQUAL(order1[i], i);
+        BOOST_CHECK_EQUAL(order2[i], i);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -161,6 +161,27 @@ BOOST_AUTO_TEST_CASE(sighash_test)
     #endif
 }
 
+BOOST_AUTO_TEST_CASE(sighash_precomputed)
+{
+    SeedInsecureRand(false);
+
+    // The signers' cache gives the same hashes, for every hash type and both signature versions
+    for (int i = 0; i < 5000; i++) {
+        int nHashType = InsecureRand32();
+        CMutableTransaction txTo;
+        RandomTransaction(txTo, (nHashType & 0x1f) == SIGHASH_SINGLE);
+        CScript scriptCode;
+        RandomScript(scriptCode);
+        int nIn = InsecureRandRange(txTo.vin.size());
+
+        const CTransaction tx(txTo);
+        const PrecomputedTransactionData txdata(tx, true);
+        BOOST_CHECK(txdata.ready && txdata.legacyready);
+        BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, 0, SIGVERSION_BASE, &txdata) == SignatureHash(scriptCode, tx, nIn, nHashType, 0, SIGVERSION_BASE));
+        BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, 1000, SIGVERSION_WITNESS_V0, &txdata) == SignatureHash(scriptCode, tx, nIn, nHashType, 1000, SIGVERSION_WITNESS_V0));
+    }
+}
+
 // Goal: check that SignatureHash generates correct hash
 BOOST_AUTO_TEST_CASE(sighash_from_data)
 {
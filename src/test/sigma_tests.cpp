@@ -0,0 +1,356 @@
+// Copyright (c) 2019 The NIX Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <sigma/coinspend.h>
+#include <sigma/params.h>
+#include <sigma/sigmaplus_prover.h>
+#include <sigma/sigmaplus_verifier.h>
+#include <test/test_nix.h>
+#include <txdb.h>
+#include <zerocoin/sigmacache.h>
+
+#if defined(HAVE_CONSENSUS_LIB)
+#include <script/nixconsensus.h>
+#endif
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+typedef sigma::SigmaPlusProof<secp_primitives::Scalar, secp_primitives::GroupElement> SigmaProof;
+
+namespace {
+
+struct SigmaBatchSetup : public BasicTestingSetup {
+    const sigma::Params *params;
+    std::vector<secp_primitives::GroupElement> coins;
+    std::vector<secp_primitives::Scalar> serials;
+    std::vector<secp_primitives::Scalar> randomness;
+    std::vector<std::size_t> indexes;
+    std::vector<std::size_t> setSizes;
+    std::vector<bool> fPadding;
+    std::vector<SigmaProof> proofs;
+
+    SigmaBatchSetup() : params(sigma::Params::get_default()) {}
+
+    // Mint a coin at the given position of the anonymity set formed by the first setSize coins
+    void AddSpend(std::size_t setSize, std::size_t index) {
+        secp_primitives::Scalar serial, r;
+        serial.randomize();
+        r.randomize();
+        coins[setSize - 1 - index] = params->get_g() * serial + params->get_h()[0] * r;
+
+        serials.push_back(serial);
+        randomness.push_back(r);
+        setSizes.push_back(setSize);
+        indexes.push_back(index);
+        fPadding.push_back(true);
+    }
+
+    // Prove all the spends once every coin is in place
+    void Prove() {
+        const secp_primitives::GroupElement &g = params->get_g();
+        const std::vector<secp_primitives::GroupElement> &h = params->get_h();
+        sigma::SigmaPlusProver<secp_primitives::Scalar, secp_primitives::GroupElement> prover(
+            g, h, params->get_n(), params->get_m());
+
+        for (std::size_t k = 0; k < serials.size(); ++k) {
+            secp_primitives::GroupElement gs = (g * serials[k]).inverse();
+            std::vector<secp_primitives::GroupElement> commits;
+            for (std::size_t i = setSizes[k]; i > 0; --i)
+                commits.push_back(coins[i - 1] + gs);
+
+            proofs.emplace_back(params);
+            prover.proof(commits, indexes[k], randomness[k], fPadding[k], proofs.back());
+        }
+    }
+
+    bool BatchVerify() const {
+        sigma::SigmaPlusVerifier<secp_primitives::Scalar, secp_primitives::GroupElement> verifier(
+            params->get_g(), params->get_h(), params->get_n(), params->get_m());
+        std::vector<const SigmaProof *> proofPtrs;
+        for (const SigmaProof &proof : proofs)
+            proofPtrs.push_back(&proof);
+        return verifier.batch_verify(coins, serials, setSizes, fPadding, proofPtrs);
+    }
+};
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(sigma_tests, SigmaBatchSetup)
+
+BOOST_AUTO_TEST_CASE(sigma_batch_verify)
+{
+    coins.resize(256);
+    for (secp_primitives::GroupElement &coin : coins)
+        coin.randomize();
+
+    // proofs over different prefixes of the same coin group
+    AddSpend(256, 10);
+    AddSpend(200, 120);
+    AddSpend(57, 0);
+    AddSpend(256, 254);
+    Prove();
+
+    BOOST_CHECK(BatchVerify());
+
+    // proof checked against a different anonymity set
+    setSizes[2] = 58;
+    BOOST_CHECK(!BatchVerify());
+    setSizes[2] = 57;
+
+    // proof bound to another serial
+    secp_primitives::Scalar serial = serials[1];
+    serials[1].randomize();
+    BOOST_CHECK(!BatchVerify());
+    serials[1] = serial;
+
+    // set size out of range
+    setSizes[0] = coins.size() + 1;
+    BOOST_CHECK(!BatchVerify());
+    setSizes[0] = coins.size();
+
+    BOOST_CHECK(BatchVerify());
+}
+
+BOOST_AUTO_TEST_CASE(sigma_extended_params)
+{
+    const sigma::Params *defaultParams = sigma::Params::get_default();
+    params = sigma::Params::get_extended();
+    BOOST_CHECK_EQUAL(params->get_n(), defaultParams->get_n());
+    BOOST_CHECK_EQUAL(params->get_m(), (uint64_t)sigma::Params::EXTENDED_M);
+    BOOST_CHECK(params->get_g() == defaultParams->get_g());
+    BOOST_CHECK_EQUAL(params->get_h().size(), params->get_n() * params->get_m());
+    // the default generators are a prefix of the extended ones
+    BOOST_CHECK(std::equal(defaultParams->get_h().begin(), defaultParams->get_h().end(), params->get_h().begin()));
+
+    coins.resize(100);
+    for (secp_primitives::GroupElement &coin : coins)
+        coin.randomize();
+    AddSpend(100, 3);
+    AddSpend(60, 59);
+    Prove();
+    BOOST_CHECK(BatchVerify());
+
+    // a proof for m = 8 does not verify with the default parameters
+    params = defaultParams;
+    BOOST_CHECK(!BatchVerify());
+}
+
+BOOST_AUTO_TEST_CASE(sigma_proof_cache)
+{
+    coins.resize(16);
+    for (secp_primitives::GroupElement &coin : coins)
+        coin.randomize();
+
+    sigma::PrivateCoin privateCoin(params, sigma::CoinDenomination::SIGMA_1);
+    coins[3] = privateCoin.getPublicCoin().getValue();
+    uint256 blockHash = GetRandHash(), metaDataHash = GetRandHash();
+    sigma::SpendMetaData metaData(1, blockHash, metaDataHash);
+    sigma::CoinSpend spend(params, privateCoin, coins, 10, metaData, true);
+
+    uint256 entry = GetSigmaProofCacheEntry(spend, 1, blockHash, 10, metaDataHash);
+    BOOST_CHECK(!IsSigmaProofCached(entry));
+    AddSigmaProofToCache(entry);
+    BOOST_CHECK(IsSigmaProofCached(entry));
+    // entries remain after being looked up
+    BOOST_CHECK(IsSigmaProofCached(entry));
+
+    // the proof is not known to be valid against any other anonymity set or metadata
+    BOOST_CHECK(!IsSigmaProofCached(GetSigmaProofCacheEntry(spend, 2, blockHash, 10, metaDataHash)));
+    BOOST_CHECK(!IsSigmaProofCached(GetSigmaProofCacheEntry(spend, 1, GetRandHash(), 10, metaDataHash)));
+    BOOST_CHECK(!IsSigmaProofCached(GetSigmaProofCacheEntry(spend, 1, blockHash, 11, metaDataHash)));
+    BOOST_CHECK(!IsSigmaProofCached(GetSigmaProofCacheEntry(spend, 1, blockHash, 10, GetRandHash())));
+}
+
+BOOST_AUTO_TEST_CASE(sigma_compact_encoding)
+{
+    // compressed points, including the point at infinity
+    unsigned char buffer[secp_primitives::GroupElement::compressed_size];
+    secp_primitives::GroupElement point, decoded;
+    point.randomize();
+    point.serializeCompressed(buffer);
+    BOOST_CHECK(decoded.deserializeCompressed(buffer) && decoded == point);
+    point = secp_primitives::GroupElement();
+    BOOST_CHECK(point.isInfinity());
+    point.serializeCompressed(buffer);
+    BOOST_CHECK(decoded.deserializeCompressed(buffer) && decoded.isInfinity());
+    buffer[0] = 0x04;
+    BOOST_CHECK(!decoded.deserializeCompressed(buffer));
+
+    coins.resize(16);
+    for (secp_primitives::GroupElement &coin : coins)
+        coin.randomize();
+    sigma::PrivateCoin privateCoin(params, sigma::CoinDenomination::SIGMA_1);
+    coins[3] = privateCoin.getPublicCoin().getValue();
+    sigma::SpendMetaData metaData(1, GetRandHash(), GetRandHash());
+    sigma::CoinSpend spend(params, privateCoin, coins, 10, metaData, true);
+    spend.setVersion(sigma::SIGMA_VERSION_3);
+
+    CDataStream full(SER_NETWORK, PROTOCOL_VERSION), compact(SER_NETWORK, PROTOCOL_VERSION);
+    full << spend;
+    spend.SerializeCompact(compact);
+    BOOST_CHECK(compact.size() < full.size());
+
+    std::vector<unsigned char> vch(compact.begin(), compact.end());
+    sigma::CoinSpendView view(params, vch.data(), vch.data() + vch.size(), true);
+    BOOST_CHECK_EQUAL(view.getVersion(), sigma::SIGMA_VERSION_3);
+    BOOST_CHECK(view.getDenomination() == sigma::CoinDenomination::SIGMA_1);
+    BOOST_CHECK(view.getCoinSerialNumber() == spend.getCoinSerialNumber());
+    BOOST_CHECK(view.getAccumulatorBlockHash() == metaData.blockHash);
+
+    sigma::CoinSpend decodedSpend(params, compact, true);
+    BOOST_CHECK(compact.empty());
+    BOOST_CHECK_EQUAL(decodedSpend.getVersion(), sigma::SIGMA_VERSION_3);
+    BOOST_CHECK(decodedSpend.getCoinSerialNumber() == spend.getCoinSerialNumber());
+    BOOST_CHECK(decodedSpend.Verify(coins, 10, metaData, true));
+
+    // cut short
+    vch.pop_back();
+    BOOST_CHECK_THROW(sigma::CoinSpendView(params, vch.data(), vch.data() + vch.size(), true), std::ios_base::failure);
+}
+
+#if defined(HAVE_CONSENSUS_LIB)
+BOOST_AUTO_TEST_CASE(sigma_consensus_lib)
+{
+    coins.resize(16);
+    for (secp_primitives::GroupElement &coin : coins)
+        coin.randomize();
+
+    sigma::PrivateCoin privateCoin1(params, sigma::CoinDenomination::SIGMA_1);
+    sigma::PrivateCoin privateCoin2(params, sigma::CoinDenomination::SIGMA_1);
+    coins[3] = privateCoin1.getPublicCoin().getValue();
+    coins[12] = privateCoin2.getPublicCoin().getValue();
+    uint256 metaDataHash = GetRandHash();
+    sigma::SpendMetaData metaData(1, GetRandHash(), metaDataHash);
+
+    std::vector<unsigned char> vchSpend1, vchSpend2;
+    {
+        sigma::CoinSpend spend1(params, privateCoin1, coins, 10, metaData, true);
+        sigma::CoinSpend spend2(params, privateCoin2, coins, 16, metaData, true);
+        spend1.setVersion(sigma::SIGMA_VERSION_2);
+        spend2.setVersion(sigma::SIGMA_VERSION_2);
+        CDataStream ss1(SER_NETWORK, PROTOCOL_VERSION), ss2(SER_NETWORK, PROTOCOL_VERSION);
+        ss1 << spend1;
+        ss2 << spend2;
+        vchSpend1.assign(ss1.begin(), ss1.end());
+        vchSpend2.assign(ss2.begin(), ss2.end());
+    }
+
+    std::vector<unsigned char> vchSet(coins.size() * secp_primitives::GroupElement::serialize_size);
+    for (std::size_t i = 0; i < coins.size(); i++)
+        coins[i].serialize(&vchSet[i * secp_primitives::GroupElement::serialize_size]);
+
+    bitcoinconsensus_error err;
+    BOOST_CHECK(nixconsensus_verify_sigma_spend(vchSpend2.data(), vchSpend2.size(), 1, metaDataHash.begin(), vchSet.data(), vchSet.size(), &err) == 1);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_OK);
+
+    // signed over other metadata or for another coin group
+    uint256 otherHash = GetRandHash();
+    BOOST_CHECK(nixconsensus_verify_sigma_spend(vchSpend2.data(), vchSpend2.size(), 1, otherHash.begin(), vchSet.data(), vchSet.size(), &err) == 0);
+    BOOST_CHECK(nixconsensus_verify_sigma_spend(vchSpend2.data(), vchSpend2.size(), 2, metaDataHash.begin(), vchSet.data(), vchSet.size(), &err) == 0);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_OK);
+
+    // made against the first 10 coins only
+    BOOST_CHECK(nixconsensus_verify_sigma_spend(vchSpend1.data(), vchSpend1.size(), 1, metaDataHash.begin(), vchSet.data(), vchSet.size(), &err) == 0);
+
+    nixconsensus_sigma_spend batch[2] = {
+        {vchSpend1.data(), (unsigned int)vchSpend1.size(), 1, metaDataHash.begin(), 10},
+        {vchSpend2.data(), (unsigned int)vchSpend2.size(), 1, metaDataHash.begin(), 16}};
+    BOOST_CHECK(nixconsensus_verify_sigma_spends(batch, 2, vchSet.data(), vchSet.size(), &err) == 1);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_OK);
+    batch[0].anonymitySetSize = 11;
+    BOOST_CHECK(nixconsensus_verify_sigma_spends(batch, 2, vchSet.data(), vchSet.size(), &err) == 0);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_OK);
+    batch[0].anonymitySetSize = 17;
+    BOOST_CHECK(nixconsensus_verify_sigma_spends(batch, 2, vchSet.data(), vchSet.size(), &err) == 0);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_ANONYMITY_SET);
+
+    // malformed input
+    BOOST_CHECK(nixconsensus_verify_sigma_spend(vchSpend2.data(), vchSpend2.size() - 1, 1, metaDataHash.begin(), vchSet.data(), vchSet.size(), &err) == 0);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_SIGMA_SPEND_DESERIALIZE);
+    BOOST_CHECK(nixconsensus_verify_sigma_spend(vchSpend2.data(), vchSpend2.size(), 1, metaDataHash.begin(), vchSet.data(), vchSet.size() - 1, &err) == 0);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_ANONYMITY_SET);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(sigma_multiexponent_table)
+{
+    const std::vector<secp_primitives::GroupElement> &h = params->get_h();
+    const secp_primitives::MultiExponentTable *table = params->get_h_table();
+    BOOST_CHECK_EQUAL(table->size(), h.size());
+
+    std::vector<secp_primitives::Scalar> powers(h.size());
+    for (secp_primitives::Scalar &power : powers)
+        power.randomize();
+    powers[1] = secp_primitives::Scalar(uint64_t(0));
+    powers[2] = secp_primitives::Scalar(uint64_t(1)).negate();
+
+    secp_primitives::GroupElement expected;
+    for (std::size_t i = 0; i < h.size(); ++i)
+        expected += h[i] * powers[i];
+
+    BOOST_CHECK(table->get_multiple(powers) == expected);
+    BOOST_CHECK(secp_primitives::MultiExponent(h, powers).get_multiple() == expected);
+    BOOST_CHECK(secp_primitives::MultiExponent(h.data(), powers.data(), h.size()).get_multiple() == expected);
+
+    // fewer powers than generators
+    powers.resize(5);
+    expected = secp_primitives::GroupElement();
+    for (std::size_t i = 0; i < powers.size(); ++i)
+        expected += h[i] * powers[i];
+    BOOST_CHECK(table->get_multiple(powers) == expected);
+    BOOST_CHECK(secp_primitives::MultiExponent(h.data(), powers.data(), powers.size()).get_multiple() == expected);
+}
+
+BOOST_AUTO_TEST_CASE(sigma_privacy_index)
+{
+    CPrivacyIndexDB privacyIndex(1 << 20, true);
+
+    // a chain of three blocks and a competing block at height 1
+    std::vector<uint256> hashes(4);
+    std::vector<CBlockIndex> blocks(4);
+    for (std::size_t i = 0; i < blocks.size(); ++i) {
+        hashes[i] = GetRandHash();
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].nHeight = i < 3 ? i : 1;
+        blocks[i].pprev = i > 0 ? &blocks[i < 3 ? i - 1 : 0] : nullptr;
+    }
+    CChain chain;
+    chain.SetTip(&blocks[2]);
+
+    secp_primitives::Scalar serial;
+    serial.randomize();
+    sigma::PrivateCoin privateCoin(params, sigma::CoinDenomination::SIGMA_1);
+    CPrivacyBlockData spendData, mintData;
+    spendData.spentSerialsV2.insert(serial);
+    mintData.mintedPubCoinsV2[std::make_pair(sigma::CoinDenomination::SIGMA_1, 1)].push_back(privateCoin.getPublicCoin());
+
+    BOOST_CHECK(privacyIndex.WriteBlock(&blocks[2], spendData));
+    BOOST_CHECK(privacyIndex.WriteBlock(&blocks[1], mintData));
+    BOOST_CHECK(privacyIndex.WriteBlock(&blocks[3], spendData));
+
+    BOOST_CHECK(privacyIndex.ReadBlock(&blocks[0])->IsNull());
+    BOOST_CHECK(privacyIndex.ReadBlock(&blocks[1])->mintedPubCoinsV2 == mintData.mintedPubCoinsV2);
+    BOOST_CHECK(privacyIndex.ReadBlock(&blocks[2])->spentSerialsV2.count(serial) == 1);
+
+    // only the blocks of the chain are visited, in height order
+    std::vector<int> heights;
+    BOOST_CHECK(privacyIndex.ForEachBlock(chain, [&heights](CBlockIndex *pindex, const CPrivacyBlockData &data) {
+        heights.push_back(pindex->nHeight);
+        BOOST_CHECK(!data.IsNull());
+    }));
+    BOOST_CHECK(heights == std::vector<int>({1, 2}));
+
+    // writing empty data removes the block from the index
+    BOOST_CHECK(privacyIndex.WriteBlock(&blocks[1], CPrivacyBlockData()));
+    BOOST_CHECK(privacyIndex.ReadBlock(&blocks[1])->IsNull());
+    heights.clear();
+    BOOST_CHECK(privacyIndex.ForEachBlock(chain, [&heights](CBlockIndex *pindex, const CPrivacyBlockData &data) {
+        heights.push_back(pindex->nHeight);
+    }));
+    BOOST_CHECK(heights == std::vector<int>({2}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
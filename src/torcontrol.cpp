@@ -10,6 +10,7 @@
 #include <util.h>
 #include <crypto/hmac_sha256.h>
 
+#include <atomic>
 #include <vector>
 #include <deque>
 #include <set>
@@ -46,6 +47,8 @@ static const float RECONNECT_TIMEOUT_EXP = 1.5;
  * this is belt-and-suspenders sanity limit to prevent memory exhaustion.
  */
 static const int MAX_LINE_LENGTH = 100000;
+/** Maximum number of known onion peers whose descriptors are fetched ahead of connecting */
+static const size_t MAX_PREWARM_ONIONS = 16;
 
 /****** Low-level TorControlConnection ********/
 
@@ -88,6 +91,13 @@ public:
      */
     bool Connect(const std::string &target, const ConnectionCB& connected, const ConnectionCB& disconnected);
 
+    /**
+     * Use a control socket that is already connected, taking ownership of it.
+     * connected is called right away.
+     * Return true on success.
+     */
+    bool Connect(evutil_socket_t fd, const ConnectionCB& connected, const ConnectionCB& disconnected);
+
     /**
      * Disconnect from Tor control port.
      */
@@ -223,6 +233,26 @@ bool TorControlConnection::Connect(const std::string &target, const ConnectionCB
     return true;
 }
 
+bool TorControlConnection::Connect(evutil_socket_t fd, const ConnectionCB& _connected, const ConnectionCB& _disconnected)
+{
+    if (b_conn)
+        Disconnect();
+    if (evutil_make_socket_nonblocking(fd) < 0 ||
+        !(b_conn = bufferevent_socket_new(base, fd, BEV_OPT_CLOSE_ON_FREE))) {
+        EVUTIL_CLOSESOCKET(fd);
+        return false;
+    }
+    bufferevent_setcb(b_conn, TorControlConnection::readcb, nullptr, TorControlConnection::eventcb, this);
+    bufferevent_enable(b_conn, EV_READ|EV_WRITE);
+    this->connected = _connected;
+    this->disconnected = _disconnected;
+
+    // There is no BEV_EVENT_CONNECTED to wait for
+    LogPrint(BCLog::TOR, "tor: Using control socket %d\n", fd);
+    connected(*this);
+    return true;
+}
+
 bool TorControlConnection::Disconnect()
 {
     if (b_conn)
@@ -408,10 +438,23 @@ static bool WriteBinaryFile(const fs::path &filename, const std::string &data)
 /** Controller that connects to Tor control socket, authenticate, then create
  * and maintain an ephemeral hidden service.
  */
+/** Onion peers, without .onion, queued by PrewarmTorOnions for the controller */
+static CCriticalSection cs_prewarm;
+static std::vector<std::string> vPrewarmOnions;
+
+static std::vector<std::string> TakePrewarmOnions()
+{
+    LOCK(cs_prewarm);
+    std::vector<std::string> vOnions;
+    vOnions.swap(vPrewarmOnions);
+    return vOnions;
+}
+
 class TorController
 {
 public:
-    TorController(struct event_base* base, const std::string& target);
+    /** Connects to target, or uses the authenticated control socket fd of the in-process Tor when it is not -1 */
+    TorController(struct event_base* base, const std::string& target, evutil_socket_t fd = -1);
     ~TorController();
 
     /** Get name fo file to store private key in */
@@ -419,12 +462,16 @@ public:
 
     /** Reconnect, after getting disconnected */
     void Reconnect();
+
+    /** Fetch the descriptors of the onion peers queued by PrewarmTorOnions, once authenticated */
+    void PrewarmOnions();
 private:
     struct event_base* base;
     std::string target;
     TorControlConnection conn;
     std::string private_key;
     std::string service_id;
+    bool fOwnedSocket;
     bool reconnect;
     struct event *reconnect_ev;
     float reconnect_timeout;
@@ -433,7 +480,26 @@ private:
     std::vector<uint8_t> cookie;
     /** ClientNonce for SAFECOOKIE auth */
     std::vector<uint8_t> clientNonce;
-
+    bool fAuthenticated;
+    /** Number of clean circuits to keep built for outbound connections through Tor */
+    size_t nCircuitPool;
+    /** IDs of the clean circuits built for the pool, and the number still being requested */
+    std::set<std::string> setPoolCircuits;
+    size_t nPoolCircuitsPending;
+
+    /** Subscribe to circuit and stream events and build the circuit pool */
+    void StartCircuitPool(TorControlConnection& conn);
+    /** Request circuits until the pool is full */
+    void FillCircuitPool(TorControlConnection& conn);
+    /** Callback for SETEVENTS result */
+    void setevents_cb(TorControlConnection& conn, const TorControlReply& reply);
+    /** Callback for EXTENDCIRCUIT result */
+    void extendcircuit_cb(TorControlConnection& conn, const TorControlReply& reply);
+    /** Callback for CIRC and STREAM events, pool circuits that close or carry a stream leave the pool */
+    void event_cb(TorControlConnection& conn, const TorControlReply& reply);
+
+    /** Set up the onion proxy and request the hidden service once Tor accepted us */
+    void authenticated(TorControlConnection& conn);
     /** Callback for ADD_ONION result */
     void add_onion_cb(TorControlConnection& conn, const TorControlReply& reply);
     /** Callback for AUTHENTICATE result */
@@ -451,25 +517,35 @@ private:
     static void reconnect_cb(evutil_socket_t fd, short what, void *arg);
 };
 
-TorController::TorController(struct event_base* _base, const std::string& _target):
+TorController::TorController(struct event_base* _base, const std::string& _target, evutil_socket_t fd):
     base(_base),
-    target(_target), conn(base), reconnect(true), reconnect_ev(0),
-    reconnect_timeout(RECONNECT_TIMEOUT_START)
+    target(_target), conn(base), fOwnedSocket(fd != -1), reconnect(fd == -1), reconnect_ev(0),
+    reconnect_timeout(RECONNECT_TIMEOUT_START), fAuthenticated(false), nPoolCircuitsPending(0)
 {
+    nCircuitPool = std::max<int64_t>(0, std::min<int64_t>(gArgs.GetArg("-torcircuitpool", DEFAULT_TOR_CIRCUIT_POOL), MAX_TOR_CIRCUIT_POOL));
+    conn.async_handler.connect(boost::bind(&TorController::event_cb, this, _1, _2));
     reconnect_ev = event_new(base, -1, 0, reconnect_cb, this);
     if (!reconnect_ev)
         LogPrintf("tor: Failed to create event for reconnection: out of memory?\n");
-    // Start connection attempts immediately
-    if (!conn.Connect(_target, boost::bind(&TorController::connected_cb, this, _1),
-         boost::bind(&TorController::disconnected_cb, this, _1) )) {
-        LogPrintf("tor: Initiating connection to Tor control port %s failed\n", _target);
-    }
     // Read service private key if cached
     std::pair<bool,std::string> pkf = ReadBinaryFile(GetPrivateKeyFile());
     if (pkf.first) {
         LogPrint(BCLog::TOR, "tor: Reading cached private key from %s\n", GetPrivateKeyFile().string());
         private_key = pkf.second;
     }
+    if (fOwnedSocket) {
+        // The in-process Tor exits when this socket closes, there is nothing to reconnect to
+        if (!conn.Connect(fd, boost::bind(&TorController::connected_cb, this, _1),
+             boost::bind(&TorController::disconnected_cb, this, _1) )) {
+            LogPrintf("tor: Using the control socket of the in-process Tor failed\n");
+        }
+        return;
+    }
+    // Start connection attempts immediately
+    if (!conn.Connect(_target, boost::bind(&TorController::connected_cb, this, _1),
+         boost::bind(&TorController::disconnected_cb, this, _1) )) {
+        LogPrintf("tor: Initiating connection to Tor control port %s failed\n", _target);
+    }
 }
 
 TorController::~TorController()
@@ -518,28 +594,35 @@ void TorController::add_onion_cb(TorControlConnection& _conn, const TorControlRe
     }
 }
 
+void TorController::authenticated(TorControlConnection& _conn)
+{
+    // Now that we know Tor is running setup the proxy for onion addresses
+    // if -onion isn't set to something else.
+    if (gArgs.GetArg("-onion", "") == "") {
+        CService resolved(LookupNumeric("127.0.0.1", 9050));
+        proxyType addrOnion = proxyType(resolved, true);
+        SetProxy(NET_TOR, addrOnion);
+        SetLimited(NET_TOR, false);
+    }
+    fAuthenticated = true;
+    StartCircuitPool(_conn);
+    PrewarmOnions();
+
+    // Finally - now create the service
+    if (private_key.empty()) // No private key, generate one
+        private_key = "NEW:RSA1024"; // Explicitly request RSA1024 - see issue #9214
+    // Request hidden service, redirect port.
+    // Note that the 'virtual' port doesn't have to be the same as our internal port, but this is just a convenient
+    // choice.  TODO; refactor the shutdown sequence some day.
+    _conn.Command(strprintf("ADD_ONION %s Port=%i,127.0.0.1:%i", private_key, GetListenPort(), GetListenPort()),
+        boost::bind(&TorController::add_onion_cb, this, _1, _2));
+}
+
 void TorController::auth_cb(TorControlConnection& _conn, const TorControlReply& reply)
 {
     if (reply.code == 250) {
         LogPrint(BCLog::TOR, "tor: Authentication successful\n");
-
-        // Now that we know Tor is running setup the proxy for onion addresses
-        // if -onion isn't set to something else.
-        if (gArgs.GetArg("-onion", "") == "") {
-            CService resolved(LookupNumeric("127.0.0.1", 9050));
-            proxyType addrOnion = proxyType(resolved, true);
-            SetProxy(NET_TOR, addrOnion);
-            SetLimited(NET_TOR, false);
-        }
-
-        // Finally - now create the service
-        if (private_key.empty()) // No private key, generate one
-            private_key = "NEW:RSA1024"; // Explicitly request RSA1024 - see issue #9214
-        // Request hidden service, redirect port.
-        // Note that the 'virtual' port doesn't have to be the same as our internal port, but this is just a convenient
-        // choice.  TODO; refactor the shutdown sequence some day.
-        _conn.Command(strprintf("ADD_ONION %s Port=%i,127.0.0.1:%i", private_key, GetListenPort(), GetListenPort()),
-            boost::bind(&TorController::add_onion_cb, this, _1, _2));
+        authenticated(_conn);
     } else {
         LogPrintf("tor: Authentication failed\n");
     }
@@ -684,6 +767,11 @@ void TorController::protocolinfo_cb(TorControlConnection& _conn, const TorContro
 void TorController::connected_cb(TorControlConnection& _conn)
 {
     reconnect_timeout = RECONNECT_TIMEOUT_START;
+    // The owning controller socket of the in-process Tor starts out authenticated
+    if (fOwnedSocket) {
+        authenticated(_conn);
+        return;
+    }
     // First send a PROTOCOLINFO command to figure out what authentication is expected
     if (!_conn.Command("PROTOCOLINFO 1", boost::bind(&TorController::protocolinfo_cb, this, _1, _2)))
         LogPrintf("tor: Error sending initial protocolinfo command\n");
@@ -695,6 +783,9 @@ void TorController::disconnected_cb(TorControlConnection& _conn)
     if (service.IsValid())
         RemoveLocal(service);
     service = CService();
+    fAuthenticated = false;
+    setPoolCircuits.clear();
+    nPoolCircuitsPending = 0;
     if (!reconnect)
         return;
 
@@ -707,6 +798,82 @@ void TorController::disconnected_cb(TorControlConnection& _conn)
     reconnect_timeout *= RECONNECT_TIMEOUT_EXP;
 }
 
+void TorController::StartCircuitPool(TorControlConnection& _conn)
+{
+    // Only connections to clearnet peers through Tor use general circuits, onion peers are
+    // reached over internal ones that PrewarmOnions gets Tor to predict and build instead
+    proxyType proxy;
+    if (nCircuitPool == 0 || !GetProxy(NET_IPV4, proxy) || IsLimited(NET_IPV4))
+        return;
+    _conn.Command("SETEVENTS CIRC STREAM", boost::bind(&TorController::setevents_cb, this, _1, _2));
+}
+
+void TorController::setevents_cb(TorControlConnection& _conn, const TorControlReply& reply)
+{
+    if (reply.code == 250) {
+        LogPrint(BCLog::TOR, "tor: Building a pool of %u circuits\n", nCircuitPool);
+        FillCircuitPool(_conn);
+    } else {
+        LogPrintf("tor: Subscribing to circuit events failed; error code %d\n", reply.code);
+    }
+}
+
+void TorController::FillCircuitPool(TorControlConnection& _conn)
+{
+    while (setPoolCircuits.size() + nPoolCircuitsPending < nCircuitPool) {
+        // A new general purpose circuit along a path of Tor's choosing
+        if (!_conn.Command("EXTENDCIRCUIT 0", boost::bind(&TorController::extendcircuit_cb, this, _1, _2)))
+            return;
+        nPoolCircuitsPending++;
+    }
+}
+
+void TorController::extendcircuit_cb(TorControlConnection& _conn, const TorControlReply& reply)
+{
+    if (nPoolCircuitsPending > 0)
+        nPoolCircuitsPending--;
+    // 250 EXTENDED <CircuitID>
+    std::pair<std::string,std::string> l = reply.lines.empty() ? std::make_pair(std::string(), std::string()) : SplitTorReplyLine(reply.lines[0]);
+    if (reply.code != 250 || l.first != "EXTENDED" || l.second.empty()) {
+        // not retried right away, the pool is refilled as its other circuits go
+        LogPrint(BCLog::TOR, "tor: Building a pool circuit failed; error code %d\n", reply.code);
+        return;
+    }
+    setPoolCircuits.insert(l.second);
+}
+
+void TorController::event_cb(TorControlConnection& _conn, const TorControlReply& reply)
+{
+    if (setPoolCircuits.empty() || reply.lines.empty())
+        return;
+    // 650 CIRC <CircuitID> <CircStatus> ...
+    // 650 STREAM <StreamID> <StreamStatus> <CircuitID> <Target> ...
+    std::vector<std::string> vWords;
+    boost::split(vWords, reply.lines[0], boost::is_any_of(" "));
+    std::string circuit;
+    if (vWords.size() >= 3 && vWords[0] == "CIRC" && (vWords[2] == "CLOSED" || vWords[2] == "FAILED"))
+        circuit = vWords[1];
+    else if (vWords.size() >= 4 && vWords[0] == "STREAM" && (vWords[2] == "SENTCONNECT" || vWords[2] == "SUCCEEDED"))
+        circuit = vWords[3];
+    // a circuit that carries a stream is isolated to its credentials and no longer clean
+    if (!circuit.empty() && setPoolCircuits.erase(circuit))
+        FillCircuitPool(_conn);
+}
+
+void TorController::PrewarmOnions()
+{
+    if (!fAuthenticated)
+        return;
+    for (const std::string& onion : TakePrewarmOnions()) {
+        // HSFETCH <address without .onion>, the descriptor is cached and the internal circuits
+        // to reach it are predicted from then on
+        conn.Command("HSFETCH " + onion, [onion](TorControlConnection&, const TorControlReply& reply) {
+            if (reply.code != 250)
+                LogPrint(BCLog::TOR, "tor: Fetching the descriptor of %s.onion failed; error code %d\n", onion, reply.code);
+        });
+    }
+}
+
 void TorController::Reconnect()
 {
     /* Try to reconnect and reestablish if we get booted - for example, Tor
@@ -732,12 +899,50 @@ void TorController::reconnect_cb(evutil_socket_t fd, short what, void *arg)
 /****** Thread ********/
 static struct event_base *gBase;
 static boost::thread torControlThread;
+/** Control socket of the in-process Tor until the controller takes it */
+static std::atomic<evutil_socket_t> torControlSocket(-1);
+/** The controller, only used by the torcontrol thread */
+static TorController* torController = nullptr;
+
+void SetTorControlSocket(int fd)
+{
+    torControlSocket = fd;
+}
 
 static void TorControlThread()
 {
-    TorController ctrl(gBase, gArgs.GetArg("-torcontrol", DEFAULT_TOR_CONTROL));
+    TorController ctrl(gBase, gArgs.GetArg("-torcontrol", DEFAULT_TOR_CONTROL), torControlSocket.exchange(-1));
+    torController = &ctrl;
 
     event_base_dispatch(gBase);
+    torController = nullptr;
+}
+
+static void prewarm_cb(evutil_socket_t fd, short what, void *arg)
+{
+    if (torController)
+        torController->PrewarmOnions();
+}
+
+void PrewarmTorOnions(const std::vector<CAddress>& vAddr)
+{
+    {
+        LOCK(cs_prewarm);
+        vPrewarmOnions.clear();
+        for (const CAddress& addr : vAddr) {
+            if (vPrewarmOnions.size() >= MAX_PREWARM_ONIONS)
+                break;
+            if (!addr.IsTor())
+                continue;
+            std::string onion = addr.ToStringIP();
+            vPrewarmOnions.push_back(onion.substr(0, onion.size() - 6)); // strip .onion
+        }
+        if (vPrewarmOnions.empty())
+            return;
+    }
+    // Handed to the torcontrol thread, the controller fetches them once authenticated
+    if (gBase)
+        event_base_once(gBase, -1, EV_TIMEOUT, prewarm_cb, nullptr, nullptr);
 }
 
 void StartTorControl(boost::thread_group& threadGroup, CScheduler& scheduler)
@@ -772,5 +977,9 @@ void StopTorControl()
         event_base_free(gBase);
         gBase = nullptr;
     }
+    // Not taken when the controller never ran, closing it still stops the in-process Tor
+    evutil_socket_t fd = torControlSocket.exchange(-1);
+    if (fd != -1)
+        EVUTIL_CLOSESOCKET(fd);
 }
 
@@ -10,11 +10,32 @@
 
 #include <scheduler.h>
 
+#include <vector>
+
 extern const std::string DEFAULT_TOR_CONTROL;
 static const bool DEFAULT_LISTEN_ONION = true;
+//! -torcircuitpool default, clean circuits kept built for outbound connections through Tor
+static const int DEFAULT_TOR_CIRCUIT_POOL = 4;
+static const int MAX_TOR_CIRCUIT_POOL = 32;
+
+class CAddress;
 
 void StartTorControl(boost::thread_group& threadGroup, CScheduler& scheduler);
 void InterruptTorControl();
 void StopTorControl();
 
+/**
+ * Hand the owning control socket of the in-process Tor to the controller,
+ * which then uses it instead of connecting to -torcontrol. Tor exits once
+ * StopTorControl closes it.
+ */
+void SetTorControlSocket(int fd);
+
+/**
+ * Have Tor fetch the descriptors of the onion peers among vAddr, in the order given and up to
+ * a limit, ahead of connecting to them. This saves the descriptor fetch from connection setup
+ * and gets Tor to keep internal circuits built for reaching onion services.
+ */
+void PrewarmTorOnions(const std::vector<CAddress>& vAddr);
+
 #endif /* BITCOIN_TORCONTROL_H */
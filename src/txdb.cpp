@@ -17,6 +17,9 @@
 #include "validation.h"
 
 #include <stdint.h>
+#include <exception>
+#include <iterator>
+#include <thread>
 
 #include <boost/thread.hpp>
 
@@ -31,12 +34,21 @@ static const char DB_ADDRESSUNSPENTINDEX = 'u';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCKHASHINDEX = 'z';
+static const char DB_ADDRESSBALANCEINDEX = 'w';
+static const char DB_DELEGATIONINDEX = 'g';
+
+static const char DB_PRIVACY_BLOCK = 'b';
+static const char DB_MINT_OUTPOINT = 'm';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_SNAPSHOT_BLOCK = 'S';
+static const char DB_INDEX_BUILD = 'I';
+static const char DB_KERNEL_ORIGIN = 'k';
+static const char DB_KERNEL_ORIGIN_HEIGHT = 'K';
 
 namespace {
 
@@ -60,21 +72,146 @@ struct CoinEntry {
     }
 };
 
+//! Kernel origins by the height of the spending block, the big endian height lets the old ones be erased in order
+struct KernelOriginHeightEntry {
+    char key;
+    int nHeight;
+    COutPoint outpoint;
+    KernelOriginHeightEntry() : key(DB_KERNEL_ORIGIN_HEIGHT), nHeight(0) {}
+    KernelOriginHeightEntry(int nHeightIn, const COutPoint &outpointIn) : key(DB_KERNEL_ORIGIN_HEIGHT), nHeight(nHeightIn), outpoint(outpointIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << key;
+        ser_writedata32be(s, nHeight);
+        s << outpoint;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        nHeight = ser_readdata32be(s);
+        s >> outpoint;
+    }
+};
+
+//! Privacy index key, the big endian height keeps the blocks of the chain in height order
+struct PrivacyBlockEntry {
+    char key;
+    int nHeight;
+    uint256 hash;
+    PrivacyBlockEntry() : key(DB_PRIVACY_BLOCK), nHeight(0) {}
+    PrivacyBlockEntry(int nHeightIn, const uint256 &hashIn) : key(DB_PRIVACY_BLOCK), nHeight(nHeightIn), hash(hashIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << key;
+        ser_writedata32be(s, nHeight);
+        s << hash;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        nHeight = ser_readdata32be(s);
+        s >> hash;
+    }
+};
+
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, GetDBTuningArgs()), fFlushFailed(false), fStopFlush(false)
 {
 }
 
+CCoinsViewDB::~CCoinsViewDB()
+{
+    {
+        WaitableLock lock(cs_flush);
+        fStopFlush = true;
+    }
+    condFlush.notify_all();
+    // the thread writes whatever it was handed before it stops
+    if (flushThread.joinable())
+        flushThread.join();
+}
+
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    {
+        WaitableLock lock(cs_flush);
+        if (pmapFlushing) {
+            CCoinsMap::const_iterator it = pmapFlushing->find(outpoint);
+            if (it != pmapFlushing->end()) {
+                if (it->second.coin.IsSpent())
+                    return false;
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
     return db.Read(CoinEntry(&outpoint), coin);
 }
 
+void CCoinsViewDB::GetCoins(const std::vector<COutPoint> &outpoints, std::vector<std::pair<COutPoint, Coin>> &coins) const {
+    // The reads are latency bound, so spread larger batches over a few
+    // threads reading the database concurrently
+    const size_t nThreads = std::min(nCoinsReadThreads, outpoints.size() / nCoinsReadsPerThread);
+    if (nThreads <= 1) {
+        CCoinsView::GetCoins(outpoints, coins);
+        return;
+    }
+
+    std::vector<std::vector<std::pair<COutPoint, Coin>>> vResults(nThreads);
+    std::vector<std::exception_ptr> vErrors(nThreads);
+    std::vector<std::thread> threads;
+    threads.reserve(nThreads);
+    for (size_t t = 0; t < nThreads; t++) {
+        threads.emplace_back([this, &outpoints, &vResults, &vErrors, nThreads, t] {
+            try {
+                for (size_t i = t; i < outpoints.size(); i += nThreads) {
+                    Coin coin;
+                    if (GetCoin(outpoints[i], coin))
+                        vResults[t].emplace_back(outpoints[i], std::move(coin));
+                }
+            } catch (...) {
+                vErrors[t] = std::current_exception();
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    // Let read errors reach the caller as if they came from GetCoin
+    for (const std::exception_ptr &error : vErrors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+    for (auto &result : vResults)
+        std::move(result.begin(), result.end(), std::back_inserter(coins));
+}
+
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    {
+        WaitableLock lock(cs_flush);
+        if (pmapFlushing) {
+            CCoinsMap::const_iterator it = pmapFlushing->find(outpoint);
+            if (it != pmapFlushing->end())
+                return !it->second.coin.IsSpent();
+        }
+    }
     return db.Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
+    {
+        WaitableLock lock(cs_flush);
+        if (pmapFlushing)
+            return hashFlushing;
+    }
+    return ReadBestBlock();
+}
+
+uint256 CCoinsViewDB::ReadBestBlock() const {
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
@@ -90,6 +227,70 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    if (!flushThread.joinable()) {
+        bool ret = WriteCoins(mapCoins, hashBlock);
+        mapCoins.clear();
+        return ret;
+    }
+
+    WaitableLock lock(cs_flush);
+    // one flush at a time, the next waits for the one in flight
+    condFlush.wait(lock, [this] { return !pmapFlushing || fFlushFailed; });
+    if (fFlushFailed)
+        return false;
+    // the nodes move over without copying, so the caller gets its map back at once
+    pmapFlushing.reset(new CCoinsMap(std::move(mapCoins)));
+    mapCoins.clear();
+    hashFlushing = hashBlock;
+    lock.unlock();
+    condFlush.notify_all();
+    return true;
+}
+
+void CCoinsViewDB::StartBackgroundFlush()
+{
+    assert(!flushThread.joinable());
+    flushThread = std::thread(&TraceThread<std::function<void()>>, "coinsflush", std::function<void()>(std::bind(&CCoinsViewDB::ThreadFlush, this)));
+}
+
+bool CCoinsViewDB::WaitForFlush()
+{
+    WaitableLock lock(cs_flush);
+    condFlush.wait(lock, [this] { return !pmapFlushing || fFlushFailed; });
+    return !fFlushFailed;
+}
+
+void CCoinsViewDB::ThreadFlush()
+{
+    WaitableLock lock(cs_flush);
+    while (true) {
+        condFlush.wait(lock, [this] { return pmapFlushing || fStopFlush; });
+        if (!pmapFlushing)
+            return;
+
+        // pmapFlushing only changes on this thread while it is set, and readers
+        // just look up entries, so it is written without holding the lock
+        lock.unlock();
+        bool fOk = false;
+        try {
+            fOk = WriteCoins(*pmapFlushing, hashFlushing);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        lock.lock();
+
+        if (!fOk) {
+            // keep the coins readable, the node shuts down on the next flush
+            fFlushFailed = true;
+            condFlush.notify_all();
+            return;
+        }
+        pmapFlushing.reset();
+        condFlush.notify_all();
+    }
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -97,7 +298,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
 
-    uint256 old_tip = GetBestBlock();
+    uint256 old_tip = ReadBestBlock();
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
         std::vector<uint256> old_heads = GetHeadBlocks();
@@ -114,7 +315,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); ++it) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             CoinEntry entry(&it->first);
             if (it->second.coin.IsSpent())
@@ -124,8 +325,6 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -155,7 +354,91 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+//! Address lookups scan all entries of an address, so large blocks and no bloom filters
+static CDBWrapperTuning AddressIndexTuning()
+{
+    CDBWrapperTuning tuning;
+    tuning.nBlockSize = 16 << 10;
+    tuning.nBloomBits = 0;
+    return tuning;
+}
+
+/**
+ * Moves the records under prefix from one database to another. The destination
+ * is synced before the source is erased, so an interrupted move is redone.
+ */
+template <typename K, typename V>
+static bool MoveIndexRecords(CDBWrapper& from, CDBWrapper& to, char prefix)
+{
+    std::unique_ptr<CDBIterator> pcursor(from.NewIterator());
+    CDBBatch batchTo(to);
+    CDBBatch batchFrom(from);
+    size_t nMoved = 0;
+
+    for (pcursor->Seek(prefix); pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, K> key;
+        if (!pcursor->GetKey(key) || key.first != prefix)
+            break;
+        V value;
+        if (!pcursor->GetValue(value))
+            return error("%s: failed to read index record '%c'", __func__, prefix);
+        batchTo.Write(key, value);
+        batchFrom.Erase(key);
+        nMoved++;
+        if (batchTo.SizeEstimate() > (size_t)nDefaultDbBatchSize) {
+            if (!to.WriteBatch(batchTo, true) || !from.WriteBatch(batchFrom))
+                return false;
+            batchTo.Clear();
+            batchFrom.Clear();
+        }
+    }
+    if (!to.WriteBatch(batchTo, true) || !from.WriteBatch(batchFrom))
+        return false;
+
+    if (nMoved > 0) {
+        LogPrintf("Moved %u index records '%c' out of the block index\n", nMoved, prefix);
+        from.CompactRange(prefix, (char)(prefix + 1));
+    }
+    return true;
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, size_t nIndexCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+    // Split the index cache by how much each enabled index is used, the others get a token amount
+    const bool fTxIndex = gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX);
+    const bool fAddressIndex = gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    const bool fSpentIndex = gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    const bool fTimestampIndex = gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+    // The delegation index shares the address database
+    const bool fAddressDB = fAddressIndex || gArgs.GetBoolArg("-delegationindex", DEFAULT_DELEGATIONINDEX);
+    const size_t nWeights = 2 * fTxIndex + 4 * fAddressDB + fSpentIndex + fTimestampIndex;
+    auto cacheShare = [&](bool fEnabled, size_t nWeight) {
+        return fEnabled ? nIndexCacheSize * nWeight / nWeights : (size_t)1 << 20;
+    };
+
+    const fs::path indexes = GetDataDir() / "indexes";
+    ptxindexdb.reset(new CDBWrapper(indexes / "tx", cacheShare(fTxIndex, 2), fMemory, fWipe, false, GetDBTuningArgs()));
+    paddressindexdb.reset(new CDBWrapper(indexes / "address", cacheShare(fAddressDB, 4), fMemory, fWipe, false, GetDBTuningArgs(AddressIndexTuning())));
+    pspentindexdb.reset(new CDBWrapper(indexes / "spent", cacheShare(fSpentIndex, 1), fMemory, fWipe, false, GetDBTuningArgs()));
+    ptimestampindexdb.reset(new CDBWrapper(indexes / "timestamp", cacheShare(fTimestampIndex, 1), fMemory, fWipe, false, GetDBTuningArgs()));
+
+    bool fMoved = false;
+    if (!ReadFlag("separateindexes", fMoved) || !fMoved) {
+        if (!MoveIndexesOut() || !WriteFlag("separateindexes", true))
+            throw std::runtime_error("Failed to move the indexes out of the block index database");
+    }
+}
+
+bool CBlockTreeDB::MoveIndexesOut()
+{
+    uiInterface.InitMessage(_("Moving indexes out of the block index..."));
+    return MoveIndexRecords<uint256, CDiskTxPos>(*this, *ptxindexdb, DB_TXINDEX) &&
+           MoveIndexRecords<CAddressIndexKey, CAmount>(*this, *paddressindexdb, DB_ADDRESSINDEX) &&
+           MoveIndexRecords<CAddressUnspentKey, CAddressUnspentValue>(*this, *paddressindexdb, DB_ADDRESSUNSPENTINDEX) &&
+           MoveIndexRecords<CAddressBalanceKey, CAddressBalanceValue>(*this, *paddressindexdb, DB_ADDRESSBALANCEINDEX) &&
+           MoveIndexRecords<CSpentIndexKey, CSpentIndexValue>(*this, *pspentindexdb, DB_SPENTINDEX) &&
+           MoveIndexRecords<CTimestampIndexKey, int>(*this, *ptimestampindexdb, DB_TIMESTAMPINDEX) &&
+           MoveIndexRecords<uint256, CTimestampBlockIndexValue>(*this, *ptimestampindexdb, DB_BLOCKHASHINDEX);
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -180,7 +463,8 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
-    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
+    // Only sees the database, so callers wait for any flush in flight first
+    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), ReadBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
@@ -245,22 +529,22 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
 }
 
 bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
-    return Read(std::make_pair(DB_TXINDEX, txid), pos);
+    return ptxindexdb->Read(std::make_pair(DB_TXINDEX, txid), pos);
 }
 
 bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
-    CDBBatch batch(*this);
+    CDBBatch batch(*ptxindexdb);
     for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(std::make_pair(DB_TXINDEX, it->first), it->second);
-    return WriteBatch(batch);
+    return ptxindexdb->WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(make_pair(DB_SPENTINDEX, key), value);
+    return pspentindexdb->Read(make_pair(DB_SPENTINDEX, key), value);
 }
 
 bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
-    CDBBatch batch(*this);
+    CDBBatch batch(*pspentindexdb);
     for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
         if (it->second.IsNull()) {
             batch.Erase(make_pair(DB_SPENTINDEX, it->first));
@@ -268,39 +552,77 @@ bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey,
             batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
         }
     }
-    return WriteBatch(batch);
+    return pspentindexdb->WriteBatch(batch);
 }
 
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
-    CDBBatch batch(*this);
+//! Writes or, for null values, erases unspent output records under prefix
+static bool UpdateUnspentRecords(CDBWrapper& db, char prefix, const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vect) {
+    CDBBatch batch(db);
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
         if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+            batch.Erase(make_pair(prefix, it->first));
         } else {
-            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+            batch.Write(make_pair(prefix, it->first), it->second);
         }
     }
-    return WriteBatch(batch);
+    return db.WriteBatch(batch);
+}
+
+bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
+    return UpdateUnspentRecords(*paddressindexdb, DB_ADDRESSUNSPENTINDEX, vect);
+}
+
+bool CBlockTreeDB::UpdateDelegationIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect) {
+    return UpdateUnspentRecords(*paddressindexdb, DB_DELEGATIONINDEX, vect);
+}
+
+//! Index keys are unique, so a cursor key is equal to the one found by seeking to it iff their encodings match
+template <typename K>
+static bool SameIndexKey(const K& a, const K& b)
+{
+    CDataStream ssA(SER_DISK, CLIENT_VERSION), ssB(SER_DISK, CLIENT_VERSION);
+    ssA << a;
+    ssB << b;
+    return ssA.str() == ssB.str();
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint256 addressHash, int type,
                                            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+    return ScanAddressUnspentIndex(addressHash, type, [&unspentOutputs](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+        unspentOutputs.push_back(make_pair(key, value));
+        return true;
+    });
+}
+
+//! Visits the unspent output records of an address under prefix, see ScanAddressUnspentIndex
+static bool ScanUnspentRecords(CDBWrapper& db, char prefix, uint256 addressHash, int type,
+                               const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& visit,
+                               const CAddressUnspentKey* pAfter) {
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
 
-    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    if (pAfter) {
+        pcursor->Seek(make_pair(prefix, *pAfter));
+    } else {
+        pcursor->Seek(make_pair(prefix, CAddressIndexIteratorKey(type, addressHash)));
+    }
 
+    bool fFirst = true;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+        if (pcursor->GetKey(key) && key.first == prefix && key.second.hashBytes == addressHash) {
             CAddressUnspentValue nValue;
-            if (pcursor->GetValue(nValue)) {
-                unspentOutputs.push_back(make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
+            if (!pcursor->GetValue(nValue))
                 return error("failed to get address unspent value");
+            pcursor->Next();
+            if (fFirst && pAfter && SameIndexKey(key.second, *pAfter)) {
+                fFirst = false;
+                continue;
             }
+            fFirst = false;
+            if (!visit(key.second, nValue))
+                break;
         } else {
             break;
         }
@@ -309,32 +631,112 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint256 addressHash, int type,
     return true;
 }
 
+bool CBlockTreeDB::ScanAddressUnspentIndex(uint256 addressHash, int type,
+                                           const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& visit,
+                                           const CAddressUnspentKey* pAfter) {
+    return ScanUnspentRecords(*paddressindexdb, DB_ADDRESSUNSPENTINDEX, addressHash, type, visit, pAfter);
+}
+
+bool CBlockTreeDB::ScanDelegationIndex(uint256 addressHash, int type,
+                                       const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& visit,
+                                       const CAddressUnspentKey* pAfter) {
+    return ScanUnspentRecords(*paddressindexdb, DB_DELEGATIONINDEX, addressHash, type, visit, pAfter);
+}
+
 bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
+    CDBBatch batch(*paddressindexdb);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
     batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
+    return paddressindexdb->WriteBatch(batch);
 }
 
 bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
+    CDBBatch batch(*paddressindexdb);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
     batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
-    return WriteBatch(batch);
+    return paddressindexdb->WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressBalance(uint256 addressHash, int type, int nHeight, CAddressBalanceValue &value) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(paddressindexdb->NewIterator());
+
+    value.SetNull();
+    pcursor->Seek(make_pair(DB_ADDRESSBALANCEINDEX, CAddressBalanceKey(type, addressHash, nHeight)));
+    if (!pcursor->Valid())
+        return true;
+
+    std::pair<char,CAddressBalanceKey> key;
+    if (pcursor->GetKey(key) && key.first == DB_ADDRESSBALANCEINDEX && key.second.type == (unsigned int)type && key.second.hashBytes == addressHash) {
+        if (!pcursor->GetValue(value))
+            return error("failed to get address balance value");
+    }
+
+    return true;
+}
+
+bool CBlockTreeDB::UpdateAddressBalanceIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fDisconnecting) {
+    // Changes per address and height, ordered so each address' heights are applied in turn
+    std::map<std::pair<std::pair<unsigned int, uint256>, int>, CAddressBalanceValue> mapChanges;
+    for (const auto& entry : vect) {
+        CAddressBalanceValue& change = mapChanges[std::make_pair(std::make_pair(entry.first.type, entry.first.hashBytes), entry.first.blockHeight)];
+        change.balance += entry.second;
+        if (entry.second > 0)
+            change.received += entry.second;
+        if (entry.first.txindex == 0)
+            change.staked += entry.second;
+    }
+
+    CDBBatch batch(*paddressindexdb);
+    std::pair<unsigned int, uint256> lastAddress;
+    CAddressBalanceValue running;
+    bool fHaveRunning = false;
+    for (const auto& change : mapChanges) {
+        const std::pair<unsigned int, uint256>& address = change.first.first;
+        int nHeight = change.first.second;
+        CAddressBalanceKey key(address.first, address.second, nHeight);
+        if (fDisconnecting) {
+            batch.Erase(make_pair(DB_ADDRESSBALANCEINDEX, key));
+            continue;
+        }
+        if (!fHaveRunning || address != lastAddress) {
+            if (!ReadAddressBalance(address.second, address.first, nHeight - 1, running))
+                return false;
+            lastAddress = address;
+            fHaveRunning = true;
+        }
+        running.balance += change.second.balance;
+        running.received += change.second.received;
+        running.staked += change.second.staked;
+        batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, key), running);
+    }
+    return paddressindexdb->WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadAddressIndex(uint256 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                                     int start, int end) {
+    return ScanAddressIndex(addressHash, type, [&addressIndex](const CAddressIndexKey& key, CAmount nValue) {
+        addressIndex.push_back(make_pair(key, nValue));
+        return true;
+    }, start, end);
+}
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+bool CBlockTreeDB::ScanAddressIndex(uint256 addressHash, int type,
+                                    const std::function<bool(const CAddressIndexKey&, CAmount)>& visit,
+                                    int start, int end, const CAddressIndexKey* pAfter) {
 
-    if (start > 0 && end > 0) {
+    boost::scoped_ptr<CDBIterator> pcursor(paddressindexdb->NewIterator());
+
+    if (pAfter) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, *pAfter));
+    } else if (start > 0 && end > 0) {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
     } else {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
     }
 
+    bool fFirst = true;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressIndexKey> key;
@@ -343,12 +745,16 @@ bool CBlockTreeDB::ReadAddressIndex(uint256 addressHash, int type,
                 break;
             }
             CAmount nValue;
-            if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
+            if (!pcursor->GetValue(nValue))
                 return error("failed to get address index value");
+            pcursor->Next();
+            if (fFirst && pAfter && SameIndexKey(key.second, *pAfter)) {
+                fFirst = false;
+                continue;
             }
+            fFirst = false;
+            if (!visit(key.second, nValue))
+                break;
         } else {
             break;
         }
@@ -359,41 +765,63 @@ bool CBlockTreeDB::ReadAddressIndex(uint256 addressHash, int type,
 
 
 bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
-    CDBBatch batch(*this);
+    CDBBatch batch(*ptimestampindexdb);
     batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
+    return ptimestampindexdb->WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
+    return ScanTimestampIndex(high, low, false, [&hashes](const CTimestampIndexKey& key) {
+        hashes.push_back(key.blockHash);
+        return true;
+    });
+}
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+bool CBlockTreeDB::ScanTimestampIndex(unsigned int high, unsigned int low, bool fReverse,
+                                      const std::function<bool(const CTimestampIndexKey&)>& visit) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(ptimestampindexdb->NewIterator());
+
+    if (fReverse) {
+        // the last record at or before high is the one in front of the first after it
+        if (high < std::numeric_limits<unsigned int>::max())
+            pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(high + 1)));
+        else
+            pcursor->Seek((char)(DB_TIMESTAMPINDEX + 1));
+        if (pcursor->Valid())
+            pcursor->Prev();
+        else
+            pcursor->SeekToLast();
+    } else {
+        pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+    }
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char, CTimestampIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp <= high) {
-            hashes.push_back(key.second.blockHash);
-            pcursor->Next();
-        } else {
+        if (!pcursor->GetKey(key) || key.first != DB_TIMESTAMPINDEX || key.second.timestamp > high || key.second.timestamp < low)
             break;
-        }
+        if (!visit(key.second))
+            break;
+        if (fReverse)
+            pcursor->Prev();
+        else
+            pcursor->Next();
     }
 
     return true;
 }
 
 bool CBlockTreeDB::WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts) {
-    CDBBatch batch(*this);
+    CDBBatch batch(*ptimestampindexdb);
     batch.Write(std::make_pair(DB_BLOCKHASHINDEX, blockhashIndex), logicalts);
-    return WriteBatch(batch);
+    return ptimestampindexdb->WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp) {
 
     CTimestampBlockIndexValue(lts);
-    if (!Read(std::make_pair(DB_BLOCKHASHINDEX, hash), lts))
+    if (!ptimestampindexdb->Read(std::make_pair(DB_BLOCKHASHINDEX, hash), lts))
         return false;
 
     ltimestamp = lts.ltimestamp;
@@ -413,12 +841,94 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+bool CBlockTreeDB::WriteSnapshotBlock(const uint256 &hash, unsigned int nChainTx) {
+    return Write(DB_SNAPSHOT_BLOCK, std::make_pair(hash, nChainTx), true);
+}
+
+bool CBlockTreeDB::ReadSnapshotBlock(uint256 &hash, unsigned int &nChainTx) {
+    std::pair<uint256, unsigned int> value;
+    if (!Read(DB_SNAPSHOT_BLOCK, value))
+        return false;
+    hash = value.first;
+    nChainTx = value.second;
+    return true;
+}
+
+bool CBlockTreeDB::WriteIndexBuildState(unsigned int nIndexes, const uint256 &hashBest) {
+    return Write(DB_INDEX_BUILD, std::make_pair(nIndexes, hashBest));
+}
+
+bool CBlockTreeDB::ReadIndexBuildState(unsigned int &nIndexes, uint256 &hashBest) {
+    std::pair<unsigned int, uint256> value;
+    if (!Read(DB_INDEX_BUILD, value))
+        return false;
+    nIndexes = value.first;
+    hashBest = value.second;
+    return true;
+}
+
+bool CBlockTreeDB::EraseIndexBuildState() {
+    return Erase(DB_INDEX_BUILD);
+}
+
+bool CBlockTreeDB::WriteKernelOrigins(int nSpendHeight, const std::vector<std::pair<COutPoint, CKernelOrigin> > &vOrigins) {
+    CDBBatch batch(*this);
+    for (const auto &origin : vOrigins) {
+        batch.Write(std::make_pair(DB_KERNEL_ORIGIN, origin.first), origin.second);
+        batch.Write(KernelOriginHeightEntry(nSpendHeight, origin.first), '1');
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadKernelOrigin(const COutPoint &prevout, CKernelOrigin &origin) {
+    return Read(std::make_pair(DB_KERNEL_ORIGIN, prevout), origin);
+}
+
+bool CBlockTreeDB::EraseKernelOrigins(int nHeight) {
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+
+    pcursor->Seek(KernelOriginHeightEntry());
+    while (pcursor->Valid()) {
+        KernelOriginHeightEntry key;
+        if (!pcursor->GetKey(key) || key.key != DB_KERNEL_ORIGIN_HEIGHT || key.nHeight >= nHeight)
+            break;
+        batch.Erase(std::make_pair(DB_KERNEL_ORIGIN, key.outpoint));
+        batch.Erase(key);
+        pcursor->Next();
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, CPrivacyIndexDB& privacyIndex)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    std::vector<const CBlockIndex*> vUpgraded;
+    const bool fCheckAllPoW = gArgs.GetBoolArg("-checkblockindexpow", DEFAULT_CHECKBLOCKINDEXPOW);
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
 
+    // Records whose proof of work is checked are hashed a batch at a time, with
+    // whether the record has to be rewritten to mark it checked
+    std::vector<std::pair<CBlockIndex*, bool>> vPoWIndex;
+    std::vector<CBlockHeader> vPoWHeaders;
+    std::vector<uint256> vPoWHashes(POW_HASH_BATCH_SIZE);
+    auto checkPoW = [&]() {
+        GetPoWHashes(vPoWHeaders.data(), vPoWHeaders.size(), vPoWHashes.data());
+        for (size_t i = 0; i < vPoWIndex.size(); i++) {
+            CBlockIndex* pindex = vPoWIndex[i].first;
+            if (!CheckProofOfWork(vPoWHashes[i], pindex->nBits, consensusParams))
+                return error("%s: CheckProofOfWork failed: %s", __func__, pindex->ToString());
+            pindex->SetBlockPoWHash(vPoWHashes[i]);
+            pindex->nStatus |= BLOCK_POW_CHECKED;
+            if (vPoWIndex[i].second)
+                vUpgraded.push_back(pindex);
+        }
+        vPoWIndex.clear();
+        vPoWHeaders.clear();
+        return true;
+    };
+
     // Load mapBlockIndex
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
@@ -440,15 +950,16 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
                 pindexNew->nNonce         = diskindex.nNonce;
                 pindexNew->nStatus        = diskindex.nStatus;
                 pindexNew->nTx            = diskindex.nTx;
-
-                //zerocoin
-                pindexNew->accumulatorChanges = diskindex.accumulatorChanges;
-                pindexNew->mintedPubCoins     = diskindex.mintedPubCoins;
-                pindexNew->spentSerials       = diskindex.spentSerials;
-
-                pindexNew->accumulatorChangesV2 = diskindex.accumulatorChangesV2;
-                pindexNew->mintedPubCoinsV2     = diskindex.mintedPubCoinsV2;
-                pindexNew->spentSerialsV2       = diskindex.spentSerialsV2;
+                pindexNew->nGhostedCycleAmount = diskindex.nGhostedCycleAmount;
+                if (diskindex.nStatus & BLOCK_HAVE_POW_HASH)
+                    pindexNew->SetBlockPoWHash(diskindex.hashPoW);
+
+                //zerocoin, move the data of old records to the privacy index
+                if (!(diskindex.nStatus & BLOCK_PRIVACY_INDEX)) {
+                    if (!diskindex.privacyData.IsNull() && !privacyIndex.WriteBlock(pindexNew, diskindex.privacyData))
+                        return error("%s: failed to write privacy index", __func__);
+                    vUpgraded.push_back(pindexNew);
+                }
 
                 //PoS
                 if(diskindex.IsProofOfStake() || diskindex.nHeight >= Params().GetConsensus().nPosHeightActivate){
@@ -457,11 +968,14 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
                     pindexNew->prevoutStake             = diskindex.prevoutStake;
                     pindexNew->nMoneySupply             = diskindex.nMoneySupply;
                 }
-                //Check POW limits before PoS onchain
-                else
+                //Check POW limits before PoS onchain, once per record unless asked to recheck all
+                else if (fCheckAllPoW || !(diskindex.nStatus & BLOCK_POW_CHECKED))
                 {
-                    if (!CheckProofOfWork(pindexNew->GetBlockPoWHash(), pindexNew->nBits, consensusParams))
-                        return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
+                    // a full recheck must not trust the stored hash either
+                    vPoWIndex.emplace_back(pindexNew, !(diskindex.nStatus & BLOCK_POW_CHECKED) && (diskindex.nStatus & BLOCK_PRIVACY_INDEX));
+                    vPoWHeaders.push_back(pindexNew->GetBlockHeader());
+                    if (vPoWIndex.size() == POW_HASH_BATCH_SIZE && !checkPoW())
+                        return false;
                 }
 
                 pcursor->Next();
@@ -472,10 +986,123 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
             break;
         }
     }
+    if (!vPoWIndex.empty() && !checkPoW())
+        return false;
+
+    if (vUpgraded.empty())
+        return true;
+
+    // The moved data must be on disk before the records holding it are rewritten
+    LogPrintf("%s: upgrading %u block index records\n", __func__, vUpgraded.size());
+    if (!privacyIndex.Sync())
+        return error("%s: failed to sync privacy index", __func__);
+
+    CDBBatch batch(*this);
+    for (const CBlockIndex* pindex : vUpgraded) {
+        batch.Write(std::make_pair(DB_BLOCK_INDEX, pindex->GetBlockHash()), CDiskBlockIndex(pindex));
+        if (batch.SizeEstimate() > (size_t)nDefaultDbBatchSize) {
+            if (!WriteBatch(batch))
+                return error("%s: failed to rewrite block index", __func__);
+            batch.Clear();
+        }
+    }
+    if (!WriteBatch(batch, true))
+        return error("%s: failed to rewrite block index", __func__);
+
+    return true;
+}
+
+CPrivacyIndexDB::CPrivacyIndexDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "privacyindex", nCacheSize, fMemory, fWipe) {
+}
+
+std::shared_ptr<const CPrivacyBlockData> CPrivacyIndexDB::ReadBlock(const CBlockIndex* pindex) {
+    static const std::shared_ptr<const CPrivacyBlockData> empty = std::make_shared<CPrivacyBlockData>();
+
+    const uint256 hash = pindex->GetBlockHash();
+    {
+        LOCK(cs);
+        auto it = cacheMap.find(hash);
+        if (it != cacheMap.end()) {
+            cacheList.splice(cacheList.begin(), cacheList, it->second);
+            return it->second->second;
+        }
+    }
+
+    // blocks without privacy data are cached as well, lookups of the groups walk through them
+    std::shared_ptr<const CPrivacyBlockData> result = empty;
+    CPrivacyBlockData data;
+    if (Read(PrivacyBlockEntry(pindex->nHeight, hash), data))
+        result = std::make_shared<CPrivacyBlockData>(std::move(data));
+
+    LOCK(cs);
+    CacheBlock(hash, result);
+    return result;
+}
+
+bool CPrivacyIndexDB::WriteBlock(const CBlockIndex* pindex, const CPrivacyBlockData& data) {
+    const uint256 hash = pindex->GetBlockHash();
+    bool fOk = data.IsNull() ? Erase(PrivacyBlockEntry(pindex->nHeight, hash)) : Write(PrivacyBlockEntry(pindex->nHeight, hash), data);
+
+    LOCK(cs);
+    auto it = cacheMap.find(hash);
+    if (it != cacheMap.end()) {
+        cacheList.erase(it->second);
+        cacheMap.erase(it);
+    }
+    if (fOk)
+        CacheBlock(hash, std::make_shared<CPrivacyBlockData>(data));
+    return fOk;
+}
+
+void CPrivacyIndexDB::CacheBlock(const uint256& hash, std::shared_ptr<const CPrivacyBlockData> data) {
+    AssertLockHeld(cs);
+    if (cacheMap.count(hash))
+        return;
+
+    cacheList.emplace_front(hash, std::move(data));
+    cacheMap[hash] = cacheList.begin();
+    if (cacheList.size() > nPrivacyIndexCacheBlocks) {
+        cacheMap.erase(cacheList.back().first);
+        cacheList.pop_back();
+    }
+}
+
+bool CPrivacyIndexDB::ForEachBlock(const CChain& chain, const std::function<void(CBlockIndex*, const CPrivacyBlockData&)>& f) {
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(PrivacyBlockEntry());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        PrivacyBlockEntry key;
+        if (!pcursor->GetKey(key) || key.key != DB_PRIVACY_BLOCK)
+            break;
+
+        // skip the blocks of the other branches
+        CBlockIndex* pindex = chain[key.nHeight];
+        if (pindex && pindex->GetBlockHash() == key.hash) {
+            CPrivacyBlockData data;
+            if (!pcursor->GetValue(data))
+                return error("%s: failed to read value", __func__);
+            f(pindex, data);
+        }
+        pcursor->Next();
+    }
 
     return true;
 }
 
+bool CPrivacyIndexDB::WriteMintOutPoints(const std::vector<std::pair<uint256, COutPoint>>& vMints) {
+    CDBBatch batch(*this);
+    for (const auto& mint : vMints)
+        batch.Write(std::make_pair(DB_MINT_OUTPOINT, mint.first), mint.second);
+    return WriteBatch(batch);
+}
+
+bool CPrivacyIndexDB::ReadMintOutPoint(const uint256& hashPubcoin, COutPoint& outpoint) {
+    return Read(std::make_pair(DB_MINT_OUTPOINT, hashPubcoin), outpoint);
+}
+
 namespace {
 
 //! Legacy class to deserialize pre-pertxout database entries without reindex.
@@ -10,15 +10,24 @@
 #include <dbwrapper.h>
 #include <chain.h>
 
+#include <sync.h>
+
+#include <condition_variable>
+#include <functional>
+#include <list>
 #include <map>
+#include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 #include <spentindex.h>
 #include <addressindex.h>
 
 class CBlockIndex;
+class CChain;
 class CCoinsViewDBCursor;
+class CPrivacyIndexDB;
 class uint256;
 
 //! No need to periodic flush if at least this much space still available.
@@ -27,18 +36,30 @@ static constexpr int MAX_BLOCK_COINSDB_USAGE = 10;
 static const int64_t nDefaultDbCache = 450;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
+//! -dbbackgroundflush default
+static const bool DEFAULT_DB_BACKGROUND_FLUSH = true;
+//! -checkblockindexpow default
+static const bool DEFAULT_CHECKBLOCKINDEXPOW = false;
 //! max. -dbcache (MiB)
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
 static const int64_t nMinDbCache = 4;
-//! Max memory allocated to block tree DB specific cache, if no -txindex (MiB)
+//! Max memory allocated to block tree DB specific cache (MiB)
 static const int64_t nMaxBlockDBCache = 2;
-//! Max memory allocated to block tree DB specific cache, if -txindex (MiB)
+//! Max memory allocated to the tx, address, spent and timestamp index databases together (MiB)
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
-static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
+static const int64_t nMaxIndexDBCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Max memory allocated to privacy index DB specific cache (MiB)
+static const int64_t nMaxPrivacyIndexDBCache = 8;
+//! Number of blocks whose privacy data is kept in memory by the privacy index
+static const size_t nPrivacyIndexCacheBlocks = 2000;
+//! Maximum number of threads reading one batch of coins from the database
+static const size_t nCoinsReadThreads = 8;
+//! Minimum number of coin reads given to each of those threads
+static const size_t nCoinsReadsPerThread = 16;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -65,15 +86,53 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
+/** Coin spent by a recent block, kept in pruned mode so the stake of a competing block spending it can be checked without its block */
+struct CKernelOrigin
+{
+    CTxOut out;
+    uint32_t nBlockTime;
+    uint256 hashBlock;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(out);
+        READWRITE(nBlockTime);
+        READWRITE(hashBlock);
+    }
+
+    CKernelOrigin() : nBlockTime(0) {}
+};
+
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+
+    //! Guards the coins being written by the flush thread and the flags below
+    mutable CWaitableCriticalSection cs_flush;
+    CConditionVariable condFlush;
+    //! Coins handed over by the last BatchWrite, read from here until they are in the database
+    std::unique_ptr<CCoinsMap> pmapFlushing;
+    uint256 hashFlushing;
+    bool fFlushFailed;
+    bool fStopFlush;
+    std::thread flushThread;
+
+    //! Best block of the coins in the database itself
+    uint256 ReadBestBlock() const;
+    //! Write the dirty coins of mapCoins in batches of -dbbatchsize, leaving mapCoins untouched
+    bool WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock);
+    void ThreadFlush();
+
 public:
     explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CCoinsViewDB();
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    void GetCoins(const std::vector<COutPoint> &outpoints, std::vector<std::pair<COutPoint, Coin>> &coins) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
@@ -83,6 +142,20 @@ public:
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+    /**
+     * From now on BatchWrite only hands the coins over to a thread writing them to the
+     * database, so a flush of the cache does not hold up the caller. The coins stay
+     * readable through this view until they are written. The database keeps marking
+     * itself as between two head blocks while a flush is in flight, so a crash during
+     * one is recovered by ReplayBlocks as before.
+     */
+    void StartBackgroundFlush();
+    /**
+     * Wait for the coins handed over to the flush thread to be in the database.
+     * Returns false if writing them failed.
+     */
+    bool WaitForFlush();
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -108,10 +181,25 @@ private:
 };
 
 /** Access to the block database (blocks/index/) */
+/**
+ * Access to the block index database (blocks/index/). The transaction, address,
+ * spent and timestamp indexes each live in a database of their own under
+ * indexes/, tuned for how they are read.
+ */
 class CBlockTreeDB : public CDBWrapper
 {
+private:
+    std::unique_ptr<CDBWrapper> ptxindexdb;
+    std::unique_ptr<CDBWrapper> paddressindexdb;
+    std::unique_ptr<CDBWrapper> pspentindexdb;
+    std::unique_ptr<CDBWrapper> ptimestampindexdb;
+
+    //! Move index records written by older versions out of blocks/index
+    bool MoveIndexesOut();
+
 public:
-    explicit CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    //! nIndexCacheSize is shared out between the index databases
+    CBlockTreeDB(size_t nCacheSize, size_t nIndexCacheSize, bool fMemory = false, bool fWipe = false);
 
     CBlockTreeDB(const CBlockTreeDB&) = delete;
     CBlockTreeDB& operator=(const CBlockTreeDB&) = delete;
@@ -133,15 +221,76 @@ public:
     bool ReadAddressIndex(uint256 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
+    //! Calls visit for the entries of an address in key order, starting after pAfter if given, until visit returns false
+    bool ScanAddressIndex(uint256 addressHash, int type,
+                          const std::function<bool(const CAddressIndexKey&, CAmount)>& visit,
+                          int start = 0, int end = 0, const CAddressIndexKey* pAfter = nullptr);
+    //! Totals of an address after the last block at or below nHeight that touched it, zero if none did
+    bool ReadAddressBalance(uint256 addressHash, int type, int nHeight, CAddressBalanceValue &value);
+    //! Adds or, when disconnecting, erases the checkpoints of the blocks the address index deltas belong to
+    bool UpdateAddressBalanceIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fDisconnecting);
+    bool ScanAddressUnspentIndex(uint256 addressHash, int type,
+                                 const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& visit,
+                                 const CAddressUnspentKey* pAfter = nullptr);
+    //! Unspent conditional stake outputs keyed by staker address, stored next to the address index
+    bool UpdateDelegationIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+    bool ScanDelegationIndex(uint256 addressHash, int type,
+                             const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& visit,
+                             const CAddressUnspentKey* pAfter = nullptr);
 
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
+    //! Visits the blocks with a timestamp in [low, high] oldest first, or newest first when fReverse, until visit returns false
+    bool ScanTimestampIndex(unsigned int high, unsigned int low, bool fReverse,
+                            const std::function<bool(const CTimestampIndexKey&)>& visit);
     bool ReadTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp);
     bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
 
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    //! Block the chainstate was loaded from a UTXO snapshot at, if any, and its chain transaction count
+    bool WriteSnapshotBlock(const uint256 &hash, unsigned int nChainTx);
+    bool ReadSnapshotBlock(uint256 &hash, unsigned int &nChainTx);
+    //! The indexes being built in the background and the last block they were built for, see indexbuilder.h
+    bool WriteIndexBuildState(unsigned int nIndexes, const uint256 &hashBest);
+    bool ReadIndexBuildState(unsigned int &nIndexes, uint256 &hashBest);
+    bool EraseIndexBuildState();
+    //! Origins of the coins spent by the block at nSpendHeight
+    bool WriteKernelOrigins(int nSpendHeight, const std::vector<std::pair<COutPoint, CKernelOrigin> > &vOrigins);
+    bool ReadKernelOrigin(const COutPoint &prevout, CKernelOrigin &origin);
+    //! Forget the origins of the coins spent below nHeight
+    bool EraseKernelOrigins(int nHeight);
+    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, CPrivacyIndexDB& privacyIndex);
+};
+
+/** Access to the zerocoin and sigma data of the blocks (privacyindex/), paged in on demand */
+class CPrivacyIndexDB : public CDBWrapper
+{
+public:
+    explicit CPrivacyIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    CPrivacyIndexDB(const CPrivacyIndexDB&) = delete;
+    CPrivacyIndexDB& operator=(const CPrivacyIndexDB&) = delete;
+
+    //! Privacy data of the block, empty if it has none
+    std::shared_ptr<const CPrivacyBlockData> ReadBlock(const CBlockIndex* pindex);
+    //! Replace the privacy data of the block
+    bool WriteBlock(const CBlockIndex* pindex, const CPrivacyBlockData& data);
+    //! Call f in height order on every block of the chain having privacy data, bypassing the cache
+    bool ForEachBlock(const CChain& chain, const std::function<void(CBlockIndex*, const CPrivacyBlockData&)>& f);
+    //! Outpoints of the sigma mints by the hash of their public coin value
+    bool WriteMintOutPoints(const std::vector<std::pair<uint256, COutPoint>>& vMints);
+    bool ReadMintOutPoint(const uint256& hashPubcoin, COutPoint& outpoint);
+
+private:
+    typedef std::list<std::pair<uint256, std::shared_ptr<const CPrivacyBlockData>>> BlockDataList;
+
+    CCriticalSection cs;
+    //! Recently used block data, most recent first
+    BlockDataList cacheList;
+    std::map<uint256, BlockDataList::iterator> cacheMap;
+
+    void CacheBlock(const uint256& hash, std::shared_ptr<const CPrivacyBlockData> data);
 };
 
 #endif // BITCOIN_TXDB_H
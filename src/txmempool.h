@@ -7,8 +7,10 @@
 #define BITCOIN_TXMEMPOOL_H
 
 #include <memory>
+#include <list>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 #include <string>
@@ -69,6 +71,7 @@ private:
     CTransactionRef tx;
     CAmount nFee;              //!< Cached to avoid expensive parent-transaction lookups
     size_t nTxWeight;          //!< ... and avoid recomputing tx weight (also used for GetTxSize())
+    size_t nValidationWeight;  //!< Extra weight for verifying private spend proofs (also used for GetTxSize())
     size_t nUsageSize;         //!< ... and total memory usage
     int64_t nTime;             //!< Local time when entering the mempool
     unsigned int entryHeight;  //!< Chain height when entering the mempool
@@ -101,6 +104,7 @@ public:
     const CAmount& GetFee() const { return nFee; }
     size_t GetTxSize() const;
     size_t GetTxWeight() const { return nTxWeight; }
+    size_t GetValidationWeight() const { return nValidationWeight; }
     int64_t GetTime() const { return nTime; }
     unsigned int GetHeight() const { return entryHeight; }
     int64_t GetSigOpCost() const { return sigOpCost; }
@@ -347,9 +351,12 @@ enum class MemPoolRemovalReason {
     REORG,       //! Removed for reorganization
     BLOCK,       //! Removed for block
     CONFLICT,    //! Removed for conflict with in-block transaction
-    REPLACED     //! Removed for replacement
+    REPLACED,    //! Removed for replacement
+    SERIAL_CONFLICT //! Removed for spending a Sigma or Zerocoin serial spent in a block
 };
 
+std::string RemovalReasonToString(MemPoolRemovalReason r);
+
 class SaltedTxidHasher
 {
 private:
@@ -364,6 +371,34 @@ public:
     }
 };
 
+/** Salted hasher of spent index keys, the outpoints spent by mempool transactions */
+class SaltedSpentIndexKeyHasher
+{
+private:
+    const uint64_t k0, k1;
+
+public:
+    SaltedSpentIndexKeyHasher();
+
+    size_t operator()(const CSpentIndexKey& key) const {
+        return SipHashUint256Extra(k0, k1, key.txid, key.outputIndex);
+    }
+};
+
+/** Salted hasher of (address hash, address type) pairs as used by the address index queries */
+class SaltedIndexAddressHasher
+{
+private:
+    const uint64_t k0, k1;
+
+public:
+    SaltedIndexAddressHasher();
+
+    size_t operator()(const std::pair<uint256, int>& address) const {
+        return SipHashUint256Extra(k0, k1, address.first, address.second);
+    }
+};
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -440,6 +475,7 @@ class CTxMemPool
 private:
     uint32_t nCheckFrequency; //!< Value n means that n times in 2^32 we check.
     unsigned int nTransactionsUpdated; //!< Used by getblocktemplate to trigger CreateNewBlock() invocation
+    uint64_t nSequence; //!< Bumped for every entry added or removed, never reset
     CBlockPolicyEstimator* minerPolicyEstimator;
 
     uint64_t totalTxSize;      //!< sum of all mempool tx's virtual sizes. Differs from serialized tx size since witness data is discounted. Defined in BIP 141.
@@ -506,16 +542,19 @@ private:
     typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
     txlinksMap mapLinks;
 
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
+    //! Deltas of each address in the order they were added, a query only walks the deltas of its addresses
+    typedef std::list<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > addressDeltaList;
+    typedef std::unordered_map<std::pair<uint256, int>, addressDeltaList, SaltedIndexAddressHasher> addressDeltaMap;
     addressDeltaMap mapAddress;
 
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
+    //! The list entries of each transaction, so removing it doesn't search the lists
+    typedef std::unordered_map<uint256, std::vector<std::pair<std::pair<uint256, int>, addressDeltaList::iterator> >, SaltedTxidHasher> addressDeltaMapInserted;
     addressDeltaMapInserted mapAddressInserted;
 
-    typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
+    typedef std::unordered_map<CSpentIndexKey, CSpentIndexValue, SaltedSpentIndexKeyHasher> mapSpentIndex;
     mapSpentIndex mapSpent;
 
-    typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
+    typedef std::unordered_map<uint256, std::vector<CSpentIndexKey>, SaltedTxidHasher> mapSpentIndexInserted;
     mapSpentIndexInserted mapSpentInserted;
 
     void UpdateParent(txiter entry, txiter parent, bool add);
@@ -572,6 +611,8 @@ public:
     bool isSpent(const COutPoint& outpoint);
     void getTransactions(std::set<uint256>& setTxid);
     unsigned int GetTransactionsUpdated() const;
+    /** Sequence number of the last entry added or removed, as passed to NotifyEntryAdded/Removed */
+    uint64_t GetSequence() const;
     void AddTransactionsUpdated(unsigned int n);
     /**
      * Check that none of this transactions inputs are in the mempool, and thus
@@ -666,8 +707,9 @@ public:
 
     size_t DynamicMemoryUsage() const;
 
-    boost::signals2::signal<void (CTransactionRef)> NotifyEntryAdded;
-    boost::signals2::signal<void (CTransactionRef, MemPoolRemovalReason)> NotifyEntryRemoved;
+    // Called with cs held; the last argument is the sequence number of the change
+    boost::signals2::signal<void (CTransactionRef, uint64_t)> NotifyEntryAdded;
+    boost::signals2::signal<void (CTransactionRef, MemPoolRemovalReason, uint64_t)> NotifyEntryRemoved;
 
 private:
     /** UpdateForDescendants is used by UpdateTransactionsFromBlock to update
@@ -777,11 +819,15 @@ struct DisconnectedBlockTransactions {
 
     indexed_disconnected_transactions queuedTx;
     uint64_t cachedInnerUsage = 0;
+    // Script flags the scripts of a transaction were checked with in the block it
+    // was disconnected from, for the blocks disconnected within SHORT_REORG_DEPTH
+    std::unordered_map<uint256, unsigned int, SaltedTxidHasher> mapScriptFlags;
 
     // Estimate the overhead of queuedTx to be 6 pointers + an allocation, as
     // no exact formula for boost::multi_index_contained is implemented.
     size_t DynamicMemoryUsage() const {
-        return memusage::MallocUsage(sizeof(CTransactionRef) + 6 * sizeof(void*)) * queuedTx.size() + cachedInnerUsage;
+        return memusage::MallocUsage(sizeof(CTransactionRef) + 6 * sizeof(void*)) * queuedTx.size() + cachedInnerUsage +
+               memusage::DynamicUsage(mapScriptFlags);
     }
 
     void addTransaction(const CTransactionRef& tx)
@@ -817,6 +863,7 @@ struct DisconnectedBlockTransactions {
     {
         cachedInnerUsage = 0;
         queuedTx.clear();
+        mapScriptFlags.clear();
     }
 };
 
@@ -48,6 +48,10 @@ public:
         std::string s(val_);
         setStr(s);
     }
+    UniValue(const UniValue&) = default;
+    UniValue(UniValue&&) = default;
+    UniValue& operator=(const UniValue&) = default;
+    UniValue& operator=(UniValue&&) = default;
     ~UniValue() {}
 
     void clear();
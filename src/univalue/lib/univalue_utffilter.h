@@ -45,6 +45,13 @@ public:
                 push_back_u(codepoint);
         }
     }
+    // Write a run of 7-bit ASCII chars at once
+    void append_ascii(const char *s, size_t n)
+    {
+        if (state) // Not a continuation, invalid
+            is_valid = false;
+        str.append(s, n);
+    }
     // Write codepoint directly, possibly collating surrogate pairs
     void push_back_u(unsigned int codepoint_)
     {
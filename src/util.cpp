@@ -294,6 +294,7 @@ const CLogCategoryDesc LogCategories[] =
     {BCLog::COINDB, "coindb"},
     {BCLog::QT, "qt"},
     {BCLog::LEVELDB, "leveldb"},
+    {BCLog::GHOST, "ghost"},
     {BCLog::ALL, "1"},
     {BCLog::ALL, "all"},
 };
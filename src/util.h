@@ -110,6 +110,7 @@ namespace BCLog {
         LEVELDB     = (1 << 20),
         SMSG        = (1 << 21),
         POS         = (1 << 22),
+        GHOST       = (1 << 23),
         HDWALLET    = (1 << 30),
         ALL         = ~(uint32_t)0,
     };
@@ -78,10 +78,9 @@ bool IsHexNumber(const std::string& str)
     return (str.size() > starting_location);
 }
 
-std::vector<unsigned char> ParseHex(const char* psz)
+static void ParseHexInto(const char* psz, std::vector<unsigned char>& vch)
 {
     // convert hex dump to vector
-    std::vector<unsigned char> vch;
     while (true)
     {
         while (isspace(*psz))
@@ -96,12 +95,22 @@ std::vector<unsigned char> ParseHex(const char* psz)
         n |= c;
         vch.push_back(n);
     }
+}
+
+std::vector<unsigned char> ParseHex(const char* psz)
+{
+    std::vector<unsigned char> vch;
+    ParseHexInto(psz, vch);
     return vch;
 }
 
 std::vector<unsigned char> ParseHex(const std::string& str)
 {
-    return ParseHex(str.c_str());
+    // the length is known, hex of transactions and blocks can run to megabytes
+    std::vector<unsigned char> vch;
+    vch.reserve(str.size() / 2);
+    ParseHexInto(str.c_str(), vch);
+    return vch;
 }
 
 void SplitHostPort(std::string in, int &portOut, std::string &hostOut) {
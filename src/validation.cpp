@@ -17,6 +17,7 @@
 #include <cuckoocache.h>
 #include <hash.h>
 #include <init.h>
+#include <lifecycle.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
@@ -40,14 +41,25 @@
 #include <validationinterface.h>
 #include <warnings.h>
 #include <coins.h>
+#include <condition_variable>
 #include <future>
+#include <list>
+#include <thread>
 #include <sstream>
 #include <pos/kernel.h>
+#include <ghost-address/lz4.h>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/thread.hpp>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "ghostnode/darksend.h"
 #include "ghostnode/instantx.h"
 #include "ghostnode/ghostnode-payments.h"
@@ -55,6 +67,7 @@
 #include "ghostnode/ghostnodeman.h"
 #include "zerocoin/zerocoin.h"
 #include <zerocoin/sigma.h>
+#include <sigma/parallel.h>
 
 
 #if defined(NDEBUG)
@@ -68,11 +81,11 @@
 map <uint256, int64_t> mapRejectedBlocks GUARDED_BY(cs_main);
 
 bool GetBlockHash(uint256 &hashRet, int nBlockHeight) {
-    LOCK(cs_main);
-    if (chainActive.Tip() == NULL) return false;
-    if (nBlockHeight < -1 || nBlockHeight > chainActive.Height()) return false;
-    if (nBlockHeight == -1) nBlockHeight = chainActive.Height();
-    hashRet = chainActive[nBlockHeight]->GetBlockPoWHash();
+    std::shared_ptr<const CChainSnapshot> chain = GetChainSnapshot();
+    if (chain->Tip() == NULL) return false;
+    if (nBlockHeight < -1 || nBlockHeight > chain->Height()) return false;
+    if (nBlockHeight == -1) nBlockHeight = chain->Height();
+    hashRet = (*chain)[nBlockHeight]->GetBlockPoWHash();
     return true;
 }
 
@@ -271,8 +284,8 @@ public:
 
     bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams, std::shared_ptr<const CBlock> pblock);
 
-    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex);
-    bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock);
+    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, const uint256* phashPoW = nullptr);
+    bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock, const uint256* phashPoW = nullptr);
 
     // Block (dis)connection on a given view:
     DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view);
@@ -285,6 +298,7 @@ public:
     // Manual block validity manipulation:
     bool PreciousBlock(CValidationState& state, const CChainParams& params, CBlockIndex *pindex);
     bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, CBlockIndex *pindex);
+    bool DisconnectBlocksTo(CValidationState& state, const CChainParams& chainparams, CBlockIndex *pindex);
     bool ResetBlockFailureFlags(CBlockIndex *pindex);
 
     bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
@@ -293,6 +307,9 @@ public:
 
     void PruneBlockIndexCandidates();
 
+    /** Make the block of a UTXO snapshot just loaded the tip, in place of the genesis block */
+    void ActivateSnapshotBlock(CBlockIndex *pindex);
+
     void UnloadBlockIndex();
     void InvalidBlockFound(CBlockIndex *pindex, const CValidationState &state, const CBlock &block);
     CBlockIndex* AddToBlockIndex(const CBlockHeader& block);
@@ -321,16 +338,35 @@ std::map<COutPoint, uint256> mapStakeSeen;
 std::list<COutPoint> listStakeSeen;
 
 CoinStakeCache coinStakeCache;
+StakeKernelCache stakeKernelCache;
 
 BlockMap& mapBlockIndex = g_chainstate.mapBlockIndex;
 CChain& chainActive = g_chainstate.chainActive;
+
+//! Latest snapshot of chainActive, only accessed through std::atomic_load/std::atomic_store
+static std::shared_ptr<const CChainSnapshot> g_chain_snapshot = std::make_shared<const CChainSnapshot>();
+
+std::shared_ptr<const CChainSnapshot> GetChainSnapshot()
+{
+    return std::atomic_load(&g_chain_snapshot);
+}
+
+/** Publish chainActive to the readers of GetChainSnapshot, after every change to it */
+static void PublishChainSnapshot()
+{
+    AssertLockHeld(cs_main);
+    std::shared_ptr<const CChainSnapshot> prev = std::atomic_load(&g_chain_snapshot);
+    std::atomic_store(&g_chain_snapshot, std::make_shared<const CChainSnapshot>(chainActive, prev.get()));
+}
 CBlockIndex *pindexBestHeader = nullptr;
+CBlockIndex *pindexSnapshotBlock = nullptr;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fTxIndex = false;
+bool fCompressBlocks = DEFAULT_COMPRESS_BLOCKS;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
@@ -343,6 +379,8 @@ int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 bool fEnableReplacement = DEFAULT_ENABLE_REPLACEMENT;
 bool fAddressIndex = false;
 bool fSpentIndex = false;
+bool fAddressBalanceIndex = false;
+bool fDelegationIndex = false;
 bool fTimestampIndex = false;
 bool fDisableZerocoinTransactions = true;
 
@@ -410,6 +448,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 std::unique_ptr<CCoinsViewDB> pcoinsdbview;
 std::unique_ptr<CCoinsViewCache> pcoinsTip;
 std::unique_ptr<CBlockTreeDB> pblocktree;
+std::unique_ptr<CPrivacyIndexDB> pprivacyindex;
 
 enum FlushStateMode {
     FLUSH_STATE_NONE,
@@ -583,6 +622,14 @@ static bool IsCurrentForFeeEstimation()
     return true;
 }
 
+static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
+                        bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
+                        bool bypass_limits, const CAmount nAbsurdFee, unsigned int nScriptsCheckedFlags = 0);
+
+// The last SHORT_REORG_DEPTH blocks connected with their scripts checked, with the script flags
+// they were checked with, most recent last
+static std::deque<std::pair<uint256, unsigned int> > dequeScriptCheckedBlocks GUARDED_BY(cs_main);
+
 /* Make mempool consistent after a reorg, by re-adding or recursively erasing
  * disconnected block transactions from the mempool, and also removing any
  * other transactions from the mempool that are no longer valid given the new
@@ -610,9 +657,12 @@ void UpdateMempoolForReorg(DisconnectedBlockTransactions &disconnectpool, bool f
     while (it != disconnectpool.queuedTx.get<insertion_order>().rend()) {
         // ignore validation errors in resurrected transactions
         CValidationState stateDummy;
+        auto itFlags = disconnectpool.mapScriptFlags.find((*it)->GetHash());
+        unsigned int nScriptsCheckedFlags = itFlags != disconnectpool.mapScriptFlags.end() ? itFlags->second : 0;
         if (!fAddToMempool || (*it)->IsCoinBase() ||
-            !AcceptToMemoryPool(mempool, stateDummy, *it, nullptr /* pfMissingInputs */,
-                                nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */)) {
+            !AcceptToMemoryPoolWithTime(Params(), mempool, stateDummy, *it, nullptr /* pfMissingInputs */, GetTime(),
+                                        nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */,
+                                        nScriptsCheckedFlags)) {
             // If the transaction doesn't make it in to the mempool, remove any
             // transactions that depend on it (which would now be orphans).
             mempool.removeRecursive(**it, MemPoolRemovalReason::REORG);
@@ -621,7 +671,7 @@ void UpdateMempoolForReorg(DisconnectedBlockTransactions &disconnectpool, bool f
         }
         ++it;
     }
-    disconnectpool.queuedTx.clear();
+    disconnectpool.clear();
     // AcceptToMemoryPool/addUnchecked all assume that new mempool entries have
     // no in-mempool children, which is generally not true when adding
     // previously-confirmed transactions back to the mempool.
@@ -673,10 +723,11 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
 
 static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
                               bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache)
+                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache,
+                              unsigned int nScriptsCheckedFlags)
 {
     const CTransaction& tx = *ptx;
-    LogPrintf("AcceptToMemoryPoolWorker(), tx.isPrivateSpend()=%s\n", tx.IsZerocoinSpend() || tx.IsSigmaSpend());
+    LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPoolWorker(), tx.isPrivateSpend()=%s\n", tx.IsZerocoinSpend() || tx.IsSigmaSpend());
     const uint256 hash = tx.GetHash();
     AssertLockHeld(cs_main);
     LOCK(pool.cs); // mempool "read lock" (held through GetMainSignals().TransactionAddedToMempool())
@@ -1084,10 +1135,15 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
                 scriptVerifyFlags = gArgs.GetArg("-promiscuousmempoolflags", scriptVerifyFlags);
             }
 
+            // A transaction put back by a short reorg had its scripts checked in its block with the
+            // consensus flags of the tip, its scripts are not run again (nor for the policy flags)
+            unsigned int currentBlockScriptVerifyFlags = GetBlockScriptFlags(chainActive.Tip(), Params().GetConsensus());
+            bool fScriptsChecked = nScriptsCheckedFlags != 0 && nScriptsCheckedFlags == currentBlockScriptVerifyFlags;
+
             // Check against previous transactions
             // This is done last to help prevent CPU exhaustion denial-of-service attacks.
             PrecomputedTransactionData txdata(tx);
-            if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata)) {
+            if (!fScriptsChecked && !CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata)) {
                 // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
                 // need to turn both off, and compare against just turning off CLEANSTACK
                 // to see if the failure is specifically due to witness validation.
@@ -1115,8 +1171,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             // There is a similar check in CreateNewBlock() to prevent creating
             // invalid blocks (using TestBlockValidity), however allowing such
             // transactions into the mempool can be exploited as a DoS attack.
-            unsigned int currentBlockScriptVerifyFlags = GetBlockScriptFlags(chainActive.Tip(), Params().GetConsensus());
-            if (!CheckInputsFromMempoolAndCache(tx, state, view, pool, currentBlockScriptVerifyFlags, true, txdata))
+            if (!fScriptsChecked && !CheckInputsFromMempoolAndCache(tx, state, view, pool, currentBlockScriptVerifyFlags, true, txdata))
             {
                 // If we're using promiscuousmempoolflags, we may hit this normally
                 // Check if current block has some flags that scriptVerifyFlags
@@ -1187,17 +1242,30 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
                 }
                 // add input denoms
                 for(int i = 0; i < tx.vin.size(); i++){
-                    std::pair<std::unique_ptr<sigma::CoinSpend>, uint32_t> newSpend;
-                    newSpend = ParseSigmaSpend(tx.vin[i]);
-                    inVal += newSpend.first->getIntDenomination();
+                    inVal += ParseSigmaSpendView(tx.vin[i]).first.getIntDenomination();
                 }
 
                 nFees = inVal - outVal;
             }
+            else if (tx.IsSigmaSpend()) {
+                CAmount inVal = 0;
+                for (const CTxIn &txin : tx.vin)
+                    inVal += ParseSigmaSpendView(txin).first.getIntDenomination();
+                nFees = inVal - tx.GetValueOut();
+            }
             int64_t nSigOpsCost = GetLegacySigOpCount(tx);
             CTxMemPool::setEntries setAncestors;
             CTxMemPoolEntry entry(ptx, nFees, nAcceptTime, chainActive.Height(),
                                   fSpendsCoinbase, nSigOpsCost, lp);
+
+            // The entry size includes the proof validation weight, so once the mempool has been
+            // trimmed, spends have to pay for their verification cost like any other transaction
+            CAmount nModifiedFees = nFees;
+            pool.ApplyDelta(hash, nModifiedFees);
+            CAmount mempoolRejectFee = pool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(entry.GetTxSize());
+            if (!bypass_limits && mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
+                return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool min fee not met", false, strprintf("%d < %d", nFees, mempoolRejectFee));
+            }
             const bool fReplacementTransaction = setConflicts.size();
             // This transaction should only count for fee estimation if:
             // - it isn't a BIP 125 replacement transaction (may not be widely supported)
@@ -1208,6 +1276,13 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
 
 
             pool.addUnchecked(hash, entry, setAncestors, validForFeeEstimation);
+
+            // trim mempool and check if tx was trimmed
+            if (!bypass_limits) {
+                LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+                if (!pool.exists(hash))
+                    return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
+            }
         }
     }
 
@@ -1239,10 +1314,11 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
 /** (try to) add transaction to memory pool with a specified acceptance time **/
 static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
                         bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                        bool bypass_limits, const CAmount nAbsurdFee)
+                        bool bypass_limits, const CAmount nAbsurdFee, unsigned int nScriptsCheckedFlags)
 {
     std::vector<COutPoint> coins_to_uncache;
-    bool res = AcceptToMemoryPoolWorker(chainparams, pool, state, tx, pfMissingInputs, nAcceptTime, plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache);
+    bool res = AcceptToMemoryPoolWorker(chainparams, pool, state, tx, pfMissingInputs, nAcceptTime, plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache,
+                                        nScriptsCheckedFlags);
     if (!res) {
         for (const COutPoint& hashTx : coins_to_uncache)
             pcoinsTip->Uncache(hashTx);
@@ -1258,7 +1334,10 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool bypass_limits, const CAmount nAbsurdFee)
 {
     const CChainParams& chainparams = Params();
-    return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, pfMissingInputs, GetTime(), plTxnReplaced, bypass_limits, nAbsurdFee);
+    if (!AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, pfMissingInputs, GetTime(), plTxnReplaced, bypass_limits, nAbsurdFee))
+        return false;
+    TraceLifecycle(LifecycleObject::TX, tx->GetHash(), LifecycleStage::ACCEPTED);
+    return true;
 }
 
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes)
@@ -1272,6 +1351,26 @@ bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::v
     return true;
 }
 
+bool ScanTimestampIndex(unsigned int high, unsigned int low, bool fReverse,
+                        const std::function<bool(const CTimestampIndexKey&)>& visit)
+{
+    if (!fTimestampIndex)
+        return error("Timestamp index not enabled");
+
+    if (!pblocktree->ScanTimestampIndex(high, low, fReverse, visit))
+        return error("Unable to get hashes for timestamps");
+
+    return true;
+}
+
+bool GetTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp)
+{
+    if (!fTimestampIndex)
+        return error("Timestamp index not enabled");
+
+    return pblocktree->ReadTimestampBlockIndex(hash, ltimestamp);
+}
+
 
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 {
@@ -1311,6 +1410,154 @@ bool GetAddressUnspent(uint256 addressHash, int type,
     return true;
 }
 
+bool ScanAddressIndex(uint256 addressHash, int type,
+                      const std::function<bool(const CAddressIndexKey&, CAmount)>& visit,
+                      int start, int end, const CAddressIndexKey* pAfter)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ScanAddressIndex(addressHash, type, visit, start, end, pAfter))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressBalance(uint256 addressHash, int type, int nHeight, CAddressBalanceValue &value)
+{
+    if (!fAddressBalanceIndex)
+        return error("address balance index not enabled");
+
+    if (!pblocktree->ReadAddressBalance(addressHash, type, nHeight, value))
+        return error("unable to get balance for address");
+
+    return true;
+}
+
+bool ScanAddressUnspent(uint256 addressHash, int type,
+                        const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& visit,
+                        const CAddressUnspentKey* pAfter)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ScanAddressUnspentIndex(addressHash, type, visit, pAfter))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool ScanDelegatedUnspent(uint256 addressHash, int type,
+                          const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& visit,
+                          const CAddressUnspentKey* pAfter)
+{
+    if (!fDelegationIndex)
+        return error("delegation index not enabled");
+
+    if (!pblocktree->ScanDelegationIndex(addressHash, type, visit, pAfter))
+        return error("unable to get delegated outputs for address");
+
+    return true;
+}
+
+/**
+ * Serializes block into vRecord LZ4 compressed, behind its serialized size. False when
+ * that does not save an eighth of the size, the block is then better stored as is.
+ */
+static bool CompressBlockRecord(const CBlock& block, std::vector<unsigned char>& vRecord)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << block;
+    int nBound = LZ4_compressBound(ss.size());
+    if (nBound <= 0)
+        return false;
+    vRecord.resize(4 + nBound);
+    WriteLE32(vRecord.data(), ss.size());
+    int nCompressed = LZ4_compress_default(ss.data(), (char*)vRecord.data() + 4, ss.size(), nBound);
+    if (nCompressed <= 0 || 4 + (size_t)nCompressed > ss.size() - ss.size() / 8)
+        return false;
+    vRecord.resize(4 + nCompressed);
+    return true;
+}
+
+/** Decompresses the data of a compressed block, as written by CompressBlockRecord, into vBlock */
+static bool DecompressBlockRecord(const unsigned char* pch, size_t nSize, std::vector<unsigned char>& vBlock)
+{
+    if (nSize < 4 || nSize - 4 > (size_t)std::numeric_limits<int>::max())
+        return false;
+    uint32_t nBlockSize = ReadLE32(pch);
+    if (nBlockSize < 80 || nBlockSize > MAX_SIZE)
+        return false;
+    vBlock.resize(nBlockSize);
+    int nRead = LZ4_decompress_safe((const char*)pch + 4, (char*)vBlock.data(), nSize - 4, nBlockSize);
+    return nRead >= 0 && (uint32_t)nRead == nBlockSize;
+}
+
+/** Opens the block file at the magic and size in front of the block at pos */
+static FILE* OpenBlockRecord(const CDiskBlockPos& pos)
+{
+    // Every block is preceded by the network magic and its size
+    if (pos.nPos < 8) {
+        error("%s: no block at %s", __func__, pos.ToString());
+        return nullptr;
+    }
+    CDiskBlockPos hpos = pos;
+    hpos.nPos -= 8;
+    return OpenBlockFile(hpos, true);
+}
+
+/**
+ * Reads the magic and size in front of a block from filein, blk_size being the size of the
+ * block. Returns true for a compressed block, which is read too and decompressed into
+ * vBlock. Otherwise filein is left at the block. Throws on I/O and decompression errors.
+ */
+static bool ReadBlockRecord(CAutoFile& filein, CMessageHeader::MessageStartChars& blk_start, unsigned int& blk_size, std::vector<unsigned char>& vBlock)
+{
+    filein >> FLATDATA(blk_start) >> blk_size;
+    bool fCompressed = (blk_size & BLOCK_RECORD_COMPRESSED) != 0;
+    blk_size &= ~BLOCK_RECORD_COMPRESSED;
+    if (blk_size > MAX_SIZE)
+        throw std::ios_base::failure("block data larger than maximum deserialization size");
+    if (!fCompressed)
+        return false;
+
+    std::vector<unsigned char> vRecord(blk_size);
+    filein.read((char*)vRecord.data(), vRecord.size());
+    if (!DecompressBlockRecord(vRecord.data(), vRecord.size(), vBlock))
+        throw std::ios_base::failure("block decompression failed");
+    blk_size = vBlock.size();
+    return true;
+}
+
+/** Reads the transaction at postx and the header of its block */
+static bool ReadTransactionFromDisk(const CDiskTxPos& postx, CBlockHeader& header, CTransactionRef& txOut)
+{
+    CAutoFile file(OpenBlockRecord(postx), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return error("%s: OpenBlockFile failed", __func__);
+    try {
+        CMessageHeader::MessageStartChars blk_start;
+        unsigned int blk_size;
+        std::vector<unsigned char> vBlock;
+        if (ReadBlockRecord(file, blk_start, blk_size, vBlock)) {
+            CSpanReader reader(SER_DISK, CLIENT_VERSION, vBlock.data(), vBlock.size());
+            reader >> header;
+            size_t nTxPos = vBlock.size() - reader.size() + postx.nTxOffset;
+            if (nTxPos > vBlock.size())
+                throw std::ios_base::failure("transaction offset past the end of the block");
+            CSpanReader txreader(SER_DISK, CLIENT_VERSION, vBlock.data() + nTxPos, vBlock.size() - nTxPos);
+            txreader >> txOut;
+        } else {
+            file >> header;
+            fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+            file >> txOut;
+        }
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    return true;
+}
+
 /**
  * Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock.
  * If blockIndex is provided, the transaction is fetched from the corresponding block.
@@ -1331,17 +1578,9 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
         if (fTxIndex) {
             CDiskTxPos postx;
             if (pblocktree->ReadTxIndex(hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-                if (file.IsNull())
-                    return error("%s: OpenBlockFile failed", __func__);
                 CBlockHeader header;
-                try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txOut;
-                } catch (const std::exception& e) {
-                    return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-                }
+                if (!ReadTransactionFromDisk(postx, header, txOut))
+                    return false;
                 hashBlock = header.GetHash();
                 if (txOut->GetHash() != hash)
                     return error("%s: txid mismatch", __func__);
@@ -1359,9 +1598,9 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
     }
 
     if (pindexSlow) {
-        CBlock block;
-        if (ReadBlockFromDisk(block, pindexSlow, consensusParams)) {
-            for (const auto& tx : block.vtx) {
+        std::shared_ptr<const CBlock> pblock;
+        if (ReadBlockFromDisk(pblock, pindexSlow, consensusParams)) {
+            for (const auto& tx : pblock->vtx) {
                 if (tx->GetHash() == hash) {
                     txOut = tx;
                     hashBlock = pindexSlow->GetBlockHash();
@@ -1387,17 +1626,9 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
             CBlockHeader header;
-            try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
-            } catch (const std::exception& e) {
-                return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            }
+            if (!ReadTransactionFromDisk(postx, header, txOut))
+                return false;
             block = CBlock(header);
             if (txOut->GetHash() != hash)
                 return error("%s: txid mismatch", __func__);
@@ -1431,7 +1662,8 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
 // CBlock and CBlockIndex
 //
 
-static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+/** Writes block, or its compressed form in pvRecord when given */
+static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart, const std::vector<unsigned char>* pvRecord)
 {
     // Open history file to append
     CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
@@ -1439,7 +1671,7 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
         return error("WriteBlockToDisk: OpenBlockFile failed");
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, block);
+    unsigned int nSize = pvRecord ? (pvRecord->size() | BLOCK_RECORD_COMPRESSED) : GetSerializeSize(fileout, block);
     fileout << FLATDATA(messageStart) << nSize;
 
     // Write block
@@ -1447,30 +1679,188 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     if (fileOutPos < 0)
         return error("WriteBlockToDisk: ftell failed");
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << block;
+    if (pvRecord)
+        fileout.write((const char*)pvRecord->data(), pvRecord->size());
+    else
+        fileout << block;
 
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams)
+#ifndef WIN32
+/** A read-only mapping of a whole blk?????.dat file, unmapped once the last reader lets go */
+class CMappedBlockFile
 {
-    block.SetNull();
+public:
+    const unsigned char* const data;
+    const size_t size;
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    CMappedBlockFile(const unsigned char* dataIn, size_t sizeIn) : data(dataIn), size(sizeIn) {}
+    ~CMappedBlockFile() { munmap(const_cast<unsigned char*>(data), size); }
+};
+
+/** The most recently used block file mappings */
+class CBlockFileMappings
+{
+private:
+    std::mutex mtx;
+    std::list<std::pair<int, std::shared_ptr<const CMappedBlockFile>>> lru;
+
+public:
+    /** Returns a mapping of file nFile covering at least nMinSize bytes, remapping a file that has grown */
+    std::shared_ptr<const CMappedBlockFile> Get(int nFile, uint64_t nMinSize)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto it = lru.begin(); it != lru.end(); ++it) {
+            if (it->first != nFile)
+                continue;
+            if (it->second->size >= nMinSize) {
+                lru.splice(lru.begin(), lru, it);
+                return it->second;
+            }
+            lru.erase(it);
+            break;
+        }
+
+        fs::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk");
+        int fd = open(path.string().c_str(), O_RDONLY);
+        if (fd == -1)
+            return nullptr;
+        struct stat st;
+        void* pdata = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0 && (uint64_t)st.st_size >= nMinSize)
+            pdata = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (pdata == MAP_FAILED)
+            return nullptr;
+
+        auto file = std::make_shared<const CMappedBlockFile>(static_cast<const unsigned char*>(pdata), st.st_size);
+        lru.emplace_front(nFile, file);
+        if (lru.size() > MAX_MAPPED_BLOCK_FILES)
+            lru.pop_back();
+        return file;
+    }
+
+    void Drop(int nFile)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        lru.remove_if([nFile](const std::pair<int, std::shared_ptr<const CMappedBlockFile>>& entry) { return entry.first == nFile; });
+    }
+};
+
+static CBlockFileMappings blockFileMappings;
+#endif
+
+/** Deserializes the block at pos straight out of a mapping of its file, false when it cannot be used */
+static bool ReadBlockFromMappedFile(CBlock& block, const CDiskBlockPos& pos)
+{
+#ifndef WIN32
+    // Keep the address space of 32-bit builds for other uses
+    if (sizeof(void*) < 8)
+        return false;
+    // Every block is preceded by the network magic and its size
+    if (pos.nPos < 8)
+        return false;
+    std::shared_ptr<const CMappedBlockFile> file = blockFileMappings.Get(pos.nFile, pos.nPos);
+    if (!file)
+        return false;
+    uint64_t nSize = ReadLE32(file->data + pos.nPos - 4);
+    bool fCompressed = (nSize & BLOCK_RECORD_COMPRESSED) != 0;
+    nSize &= ~BLOCK_RECORD_COMPRESSED;
+    if (pos.nPos + nSize > file->size) {
+        file = blockFileMappings.Get(pos.nFile, pos.nPos + nSize);
+        if (!file)
+            return false;
+    }
+
+    const unsigned char* pchBlock = file->data + pos.nPos;
+    std::vector<unsigned char> vBlock;
+    if (fCompressed) {
+        if (!DecompressBlockRecord(pchBlock, nSize, vBlock))
+            return false;
+        pchBlock = vBlock.data();
+        nSize = vBlock.size();
+    }
 
-    // Read block
     try {
-        filein >> block;
+        CSpanReader reader(SER_DISK, CLIENT_VERSION, pchBlock, nSize);
+        UnserializeBlockInArena(reader, block);
+    } catch (const std::exception& e) {
+        LogPrint(BCLog::BENCH, "%s: falling back to file read at %s: %s\n", __func__, pos.ToString(), e.what());
+        return false;
     }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    return true;
+#else
+    return false;
+#endif
+}
+
+/** Recently read blocks, keyed by hash, shared with the callers that asked for them */
+class CDecodedBlockCache
+{
+private:
+    std::mutex mtx;
+    std::list<std::shared_ptr<const CBlock>> lru;
+    std::map<uint256, std::list<std::shared_ptr<const CBlock>>::iterator> mapBlocks;
+
+public:
+    std::shared_ptr<const CBlock> Get(const uint256& hash)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = mapBlocks.find(hash);
+        if (it == mapBlocks.end())
+            return nullptr;
+        lru.splice(lru.begin(), lru, it->second);
+        return *it->second;
+    }
+
+    void Add(const uint256& hash, const std::shared_ptr<const CBlock>& pblock)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (mapBlocks.count(hash))
+            return;
+        lru.push_front(pblock);
+        mapBlocks.emplace(hash, lru.begin());
+        if (lru.size() > MAX_DECODED_BLOCK_CACHE) {
+            mapBlocks.erase(lru.back()->GetHash());
+            lru.pop_back();
+        }
+    }
+};
+
+static CDecodedBlockCache decodedBlockCache;
+
+static bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams, bool fCheckPOW)
+{
+    block.SetNull();
+
+    if (!ReadBlockFromMappedFile(block, pos)) {
+        block.SetNull();
+
+        // Open history file to read
+        CAutoFile filein(OpenBlockRecord(pos), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+        // Read block
+        try {
+            CMessageHeader::MessageStartChars blk_start;
+            unsigned int blk_size;
+            std::vector<unsigned char> vBlock;
+            if (ReadBlockRecord(filein, blk_start, blk_size, vBlock)) {
+                CSpanReader reader(SER_DISK, CLIENT_VERSION, vBlock.data(), vBlock.size());
+                UnserializeBlockInArena(reader, block);
+            } else {
+                UnserializeBlockInArena(filein, block);
+            }
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
 
     // Check the header only for PoW blocks
-    if (!block.IsProofOfStake()){
+    if (fCheckPOW && !block.IsProofOfStake()){
         // Check the header
         if (!CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams))
             return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
@@ -1479,7 +1869,91 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, con
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams)
+{
+    return ReadBlockFromDisk(block, pos, nHeight, consensusParams, true);
+}
+
+bool ReadBlockFromDisk(std::shared_ptr<const CBlock>& pblock, const CDiskBlockPos& pos, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    pblock = decodedBlockCache.Get(pindex->GetBlockHash());
+    if (pblock)
+        return true;
+
+    std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+    if (!ReadBlockFromDisk(*pblockRead, pos, pindex->nHeight, consensusParams, false))
+        return false;
+    if (pblockRead->GetHash() != pindex->GetBlockHash())
+        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
+                pindex->ToString(), pos.ToString());
+    // The header matches the index entry, so its cached PoW hash applies
+    if (!pblockRead->IsProofOfStake() && !CheckProofOfWork(pindex->GetBlockPoWHash(), pblockRead->nBits, consensusParams))
+        return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
+
+    decodedBlockCache.Add(pindex->GetBlockHash(), pblockRead);
+    pblock = std::move(pblockRead);
+    return true;
+}
+
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    std::shared_ptr<const CBlock> pblock;
+    if (!ReadBlockFromDisk(pblock, pos, pindex, consensusParams))
+        return false;
+    block = *pblock;
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
+{
+    // Every block is preceded by the network magic and its size
+    if (pos.nPos < 8)
+        return error("%s: no block at %s", __func__, pos.ToString());
+
+#ifndef WIN32
+    if (sizeof(void*) >= 8) {
+        std::shared_ptr<const CMappedBlockFile> file = blockFileMappings.Get(pos.nFile, pos.nPos);
+        if (file) {
+            uint64_t nSize = ReadLE32(file->data + pos.nPos - 4);
+            bool fCompressed = (nSize & BLOCK_RECORD_COMPRESSED) != 0;
+            nSize &= ~BLOCK_RECORD_COMPRESSED;
+            if (pos.nPos + nSize > file->size)
+                file = blockFileMappings.Get(pos.nFile, pos.nPos + nSize);
+            if (file && pos.nPos + nSize <= file->size
+                    && memcmp(file->data + pos.nPos - 8, message_start, CMessageHeader::MESSAGE_START_SIZE) == 0) {
+                // Peers always get the block as it is serialized
+                if (!fCompressed) {
+                    block.assign(file->data + pos.nPos, file->data + pos.nPos + nSize);
+                    return true;
+                }
+                if (DecompressBlockRecord(file->data + pos.nPos, nSize, block))
+                    return true;
+            }
+        }
+    }
+#endif
+
+    CAutoFile filein(OpenBlockRecord(pos), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+
+    try {
+        CMessageHeader::MessageStartChars blk_start;
+        unsigned int blk_size;
+        bool fCompressed = ReadBlockRecord(filein, blk_start, blk_size, block);
+        if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE))
+            return error("%s: block magic mismatch at %s", __func__, pos.ToString());
+        if (!fCompressed) {
+            block.resize(blk_size);
+            filein.read((char*)block.data(), blk_size);
+        }
+    } catch (const std::exception& e) {
+        return error("%s: read from block file failed: %s at %s", __func__, e.what(), pos.ToString());
+    }
+    return true;
+}
+
+bool ReadBlockFromDisk(std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
     CDiskBlockPos blockPos;
     {
@@ -1487,34 +1961,57 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
         blockPos = pindex->GetBlockPos();
     }
 
-    if (!ReadBlockFromDisk(block, blockPos, pindex->nHeight, consensusParams))
+    return ReadBlockFromDisk(pblock, blockPos, pindex, consensusParams);
+}
+
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    std::shared_ptr<const CBlock> pblock;
+    if (!ReadBlockFromDisk(pblock, pindex, consensusParams))
         return false;
-    if (block.GetHash() != pindex->GetBlockHash())
-        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
-                pindex->ToString(), pindex->GetBlockPos().ToString());
+    block = *pblock;
     return true;
 }
 
+/** Reads the header of a block and its transaction nIndex, if there is one, from s. Returns the number of transactions. */
+template <typename Stream>
+static int ReadTransactionInBlock(Stream& s, int nIndex, CBlockHeader& header, CTransactionRef& txOut)
+{
+    s >> header;
+
+    int nTxns = ReadCompactSize(s);
+    if (nTxns <= nIndex || nIndex < 0)
+        return nTxns;
+
+    for (int k = 0; k <= nIndex; ++k)
+        s >> txOut;
+    return nTxns;
+}
+
 bool ReadTransactionFromDiskBlock(const CBlockIndex* pindex, int nIndex, CTransactionRef &txOut)
 {
     const CDiskBlockPos &pos = pindex->GetBlockPos();
 
     // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    CAutoFile filein(OpenBlockRecord(pos), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
         return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
 
     CBlockHeader blockHeader;
     try {
-        filein >> blockHeader;
-
-        int nTxns = ReadCompactSize(filein);
+        CMessageHeader::MessageStartChars blk_start;
+        unsigned int blk_size;
+        std::vector<unsigned char> vBlock;
+        int nTxns;
+        if (ReadBlockRecord(filein, blk_start, blk_size, vBlock)) {
+            CSpanReader reader(SER_DISK, CLIENT_VERSION, vBlock.data(), vBlock.size());
+            nTxns = ReadTransactionInBlock(reader, nIndex, blockHeader, txOut);
+        } else {
+            nTxns = ReadTransactionInBlock(filein, nIndex, blockHeader, txOut);
+        }
 
         if (nTxns <= nIndex || nIndex < 0)
             return error("%s: Block %s, txn %d not in available range %d.", __func__, pindex->GetBlockPos().ToString(), nIndex, nTxns);
-
-        for (int k = 0; k <= nIndex; ++k)
-            filein >> txOut;
     } catch (const std::exception& e)
     {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
@@ -1885,7 +2382,9 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
+} // namespace
+
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
 {
     CDiskBlockPos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
@@ -1916,6 +2415,8 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
     return true;
 }
 
+namespace {
+
 /** Abort with a message */
 bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -2038,8 +2539,17 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
 
         }
 
-        // restore inputs
-        if (!tx.IsCoinBase() && !tx.IsZerocoinSpend() && !tx.IsSigmaSpend()) { // not coinbases
+        if (fDelegationIndex) {
+            for (unsigned int k = tx.vout.size(); k-- > 0;) {
+                std::vector<uint8_t> hashBytes;
+                int scriptType = 0;
+                if (ExtractDelegationInfo(tx.vout[k].scriptPubKey, scriptType, hashBytes))
+                    view.delegationIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, uint256(hashBytes.data(), hashBytes.size()), hash, k), CAddressUnspentValue()));
+            }
+        }
+
+        // restore inputs
+        if (!tx.IsCoinBase() && !tx.IsZerocoinSpend() && !tx.IsSigmaSpend()) { // not coinbases
             CTxUndo &txundo = blockUndo.vtxundo[block.IsProofOfStake() ? i: i-1];
             if (txundo.vprevout.size() != tx.vin.size()) {
                 error("DisconnectBlock(): transaction and undo data inconsistent %d, %d, %d \n", txundo.vprevout.size(), blockUndo.vtxundo[i].vprevout.size(), tx.vin.size());
@@ -2055,6 +2565,15 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
                 if (fSpentIndex) // undo and delete the spent index
                     view.spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue()));
 
+                if (fDelegationIndex) // restore the delegated output
+                {
+                    const Coin &coin = view.AccessCoin(input.prevout);
+                    std::vector<uint8_t> hashBytes;
+                    int scriptType = 0;
+                    if (ExtractDelegationInfo(coin.out.scriptPubKey, scriptType, hashBytes))
+                        view.delegationIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, uint256(hashBytes.data(), hashBytes.size()), input.prevout.hash, input.prevout.n), CAddressUnspentValue(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight)));
+                }
+
                 if (fAddressIndex)
                 {
                     const Coin &coin = view.AccessCoin(tx.vin[j].prevout);
@@ -2148,13 +2667,188 @@ static bool WriteTxIndexDataForBlock(const CBlock& block, CValidationState& stat
     return true;
 }
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+//! Script checks and sigma proof checks share the queue and its threads, weighted by their cost
+typedef CCheckVariant<CScriptCheck, CSigmaProofCheck> CBlockCheck;
+static CCheckQueue<CBlockCheck> scriptcheckqueue(128);
 
 void ThreadScriptCheck() {
     RenameThread("nix-scriptch");
     scriptcheckqueue.Thread();
 }
 
+template <typename T>
+static void AddBlockChecks(CCheckQueueControl<CBlockCheck>& control, std::vector<T>& vChecks)
+{
+    if (vChecks.empty())
+        return;
+    std::vector<CBlockCheck> vBlockChecks;
+    vBlockChecks.reserve(vChecks.size());
+    for (T& check : vChecks)
+        vBlockChecks.emplace_back(check);
+    control.Add(vBlockChecks);
+}
+
+bool RunScriptChecks(std::vector<CScriptCheck>& vChecks)
+{
+    if (!nScriptCheckThreads) {
+        for (CScriptCheck& check : vChecks) {
+            if (!check())
+                return false;
+        }
+        return true;
+    }
+
+    CCheckQueueControl<CBlockCheck> control(&scriptcheckqueue);
+    AddBlockChecks(control, vChecks);
+    return control.Wait();
+}
+
+/**
+ * Reads the blocks ActivateBestChainStep is about to connect ahead of the
+ * serial ConnectTip loop. Workers deserialize each block, check its header and
+ * verify the Sigma spend proofs whose anonymity set is already known, filling
+ * the proof cache so ConnectBlockSigma only has to look the proofs up.
+ */
+class CBlockPrefetcher
+{
+private:
+    struct Item {
+        const CBlockIndex* pindex;
+        CDiskBlockPos pos;
+    };
+
+    std::mutex mtx;
+    std::condition_variable cond;
+    //! Blocks waiting for a worker, in connection order
+    std::deque<Item> queue;
+    //! Blocks currently wanted by the connect loop, queued, in flight or done
+    std::set<uint256> setWanted;
+    std::map<uint256, std::shared_ptr<const CBlock>> mapBlocks;
+    std::vector<std::thread> threads;
+    bool fStop;
+
+    void ThreadProcess()
+    {
+        RenameThread("nix-prefetch");
+        const Consensus::Params& consensusParams = Params().GetConsensus();
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            cond.wait(lock, [this] { return fStop || !queue.empty(); });
+            if (fStop)
+                return;
+
+            Item item = queue.front();
+            queue.pop_front();
+            lock.unlock();
+
+            std::shared_ptr<const CBlock> pblock;
+            bool fRead = ReadBlockFromDisk(pblock, item.pos, item.pindex, consensusParams);
+            if (fRead) {
+                // Proofs referring to blocks that are not connected yet are
+                // simply left to ConnectBlock
+                for (const CTransactionRef& tx : pblock->vtx) {
+                    CValidationState state;
+                    if (tx->IsSigmaSpend())
+                        PreVerifySigmaSpend(*tx, state);
+                }
+            }
+
+            lock.lock();
+            if (fRead && setWanted.count(item.pindex->GetBlockHash()))
+                mapBlocks.emplace(item.pindex->GetBlockHash(), std::move(pblock));
+        }
+    }
+
+public:
+    CBlockPrefetcher() : fStop(false) {}
+
+    void Start(int nThreads)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!threads.empty())
+            return;
+        fStop = false;
+        for (int i = 0; i < nThreads; i++)
+            threads.emplace_back(&CBlockPrefetcher::ThreadProcess, this);
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (threads.empty())
+                return;
+            fStop = true;
+        }
+        cond.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+
+        std::lock_guard<std::mutex> lock(mtx);
+        threads.clear();
+        queue.clear();
+        setWanted.clear();
+        mapBlocks.clear();
+    }
+
+    /** Replaces the set of wanted blocks with the given ones, in connection order */
+    void Schedule(const std::vector<const CBlockIndex*>& vpindex)
+    {
+        AssertLockHeld(cs_main);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (threads.empty())
+                return;
+
+            std::set<uint256> setNewWanted;
+            queue.clear();
+            for (const CBlockIndex* pindex : vpindex) {
+                if (setNewWanted.size() >= MAX_BLOCKS_PREFETCH)
+                    break;
+                if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+                    break;
+                const uint256& hash = pindex->GetBlockHash();
+                setNewWanted.insert(hash);
+                if (!setWanted.count(hash))
+                    queue.push_back(Item{pindex, pindex->GetBlockPos()});
+            }
+            for (auto it = mapBlocks.begin(); it != mapBlocks.end();) {
+                if (setNewWanted.count(it->first))
+                    ++it;
+                else
+                    it = mapBlocks.erase(it);
+            }
+            setWanted.swap(setNewWanted);
+        }
+        cond.notify_all();
+    }
+
+    /** Hands out a prefetched block, or nullptr when it is not ready */
+    std::shared_ptr<const CBlock> Take(const uint256& hash)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        setWanted.erase(hash);
+        auto it = mapBlocks.find(hash);
+        if (it == mapBlocks.end())
+            return nullptr;
+        std::shared_ptr<const CBlock> pblock = std::move(it->second);
+        mapBlocks.erase(it);
+        return pblock;
+    }
+};
+
+static CBlockPrefetcher blockPrefetcher;
+
+void StartBlockPrefetchThreads(int nThreads)
+{
+    blockPrefetcher.Start(nThreads);
+}
+
+void StopBlockPrefetchThreads()
+{
+    blockPrefetcher.Stop();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2234,93 +2928,85 @@ static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consens
     return flags;
 }
 
+// Amount the ghost protocol fees of a block are a fraction of
+static CAmount GetBlockGhostedAmount(const CBlock &block){
+    CAmount totalGhosted = 0;
+    for(auto ctx: block.vtx){
+        bool isSpend = ctx->IsZerocoinSpend() || ctx->IsSigmaSpend();
+        bool isMint = ctx->IsZerocoinMint() || ctx->IsSigmaMint();
+        //Found ghost fee transaction
+        if(!isSpend && isMint){
+            for(auto mintTx: ctx->vout){
+                if(mintTx.scriptPubKey.IsZerocoinMint() || mintTx.scriptPubKey.IsSigmaMint())
+                    totalGhosted += mintTx.nValue;
+            }
+        }
+        //ckp tx requires 0.1 fee, but calculate the fee on a dynamic basis
+        if(ctx->IsSigmaSpend() && isMint){
+            CAmount inVal = 0;
+            CAmount outVal = 0;
+            for(int i = 0; i < ctx->vout.size(); i++){
+                if(!ctx->vout[i].scriptPubKey.IsSigmaMint())
+                    continue;
+                outVal += ctx->vout[i].nValue;
+            }
+            // add input denoms
+            for(int i = 0; i < ctx->vin.size(); i++){
+                inVal += ParseSigmaSpendView(ctx->vin[i]).first.getIntDenomination();
+            }
+            CAmount neededForFee = (inVal - outVal)/0.0025;
+            totalGhosted += neededForFee;
+        }
+    }
+    return totalGhosted;
+}
+
+static bool IsFirstBlockOfGhostFeeCycle(int nHeight){
+    return (nHeight - 1) % Params().GetConsensus().nGhostFeeDistributionCycle == 0;
+}
+
+// Ghosted amount of the blocks of the fee distribution cycle of pindex, up to and including it.
+// Blocks connected before the amounts were kept in the block index are read from disk, once:
+// their amounts are stored in the block index too.
+static bool GetGhostedCycleAmount(CBlockIndex *pindex, CAmount &amount){
+    std::vector<CBlockIndex *> vMissing;
+    amount = 0;
+    for(; pindex; pindex = pindex->pprev){
+        if(pindex->nStatus & BLOCK_GHOSTED_AMOUNT){
+            amount = pindex->nGhostedCycleAmount;
+            break;
+        }
+        vMissing.push_back(pindex);
+        if(IsFirstBlockOfGhostFeeCycle(pindex->nHeight))
+            break;
+    }
+
+    for(auto it = vMissing.rbegin(); it != vMissing.rend(); ++it){
+        CBlock block;
+        if(!ReadBlockFromDisk(block, *it, Params().GetConsensus()))
+            return false;
+        amount += GetBlockGhostedAmount(block);
+        (*it)->nGhostedCycleAmount = amount;
+        (*it)->nStatus |= BLOCK_GHOSTED_AMOUNT;
+        setDirtyBlockIndex.insert(*it);
+    }
+    return true;
+}
+
 bool GetGhostnodeFeePayment(int64_t &returnFee, bool &payFees, const CBlock &pBlock){
 
-    CAmount totalGhosted = 0;
-    vector<CAmount> mintVector;
-    mintVector.clear();
     if(chainActive.Height() + 1 >= Params().GetConsensus().nStartGhostFeeDistribution){
+        //Grab fee from current block being checked
+        CAmount totalGhosted = GetBlockGhostedAmount(pBlock);
+
         //Time to payout all ghostnodes and check
-        //LogPrintf("\nGetGhostnodeFeePayment(): height=%d, modulo=%d\n",
-        //          (chainActive.Height() + 1), ((chainActive.Height() + 1) % Params().GetConsensus().nGhostFeeDistributionCycle));
         if(((chainActive.Height() + 1) % Params().GetConsensus().nGhostFeeDistributionCycle) == 0){
-            //Subtract 1 from sample since we check current block fees
-            int sample = Params().GetConsensus().nGhostFeeDistributionCycle - 1;
-            mintVector.clear();
-
-            //Assume chainactive+1 is current block check height
-            int startHeight = chainActive.Height() + 1 - sample;
-            //Grab fee from current block being checked
-            for(auto ctx: pBlock.vtx){
-                bool isSpend = ctx->IsZerocoinSpend() || ctx->IsSigmaSpend();
-                bool isMint = ctx->IsZerocoinMint() || ctx->IsSigmaMint();
-                //Found ghost fee transaction
-                if(!isSpend && isMint){
-                    for(auto mintTx: ctx->vout){
-                        if(mintTx.scriptPubKey.IsZerocoinMint() || mintTx.scriptPubKey.IsSigmaMint())
-                            mintVector.push_back(mintTx.nValue);
-                    }
-                }
-                //ckp tx requires 0.1 fee, but calculate the fee on a dynamic basis
-                if(ctx->IsSigmaSpend() && isMint){
-                    CAmount inVal = 0;
-                    CAmount outVal = 0;
-                    for(int i = 0; i < ctx->vout.size(); i++){
-                        if(!ctx->vout[i].scriptPubKey.IsSigmaMint())
-                            continue;
-                        outVal += ctx->vout[i].nValue;
-                    }
-                    // add input denoms
-                    for(int i = 0; i < ctx->vin.size(); i++){
-                        std::pair<std::unique_ptr<sigma::CoinSpend>, uint32_t> newSpend;
-                        newSpend = ParseSigmaSpend(ctx->vin[i]);
-                        inVal += newSpend.first->getIntDenomination();
-                    }
-                    CAmount neededForFee = (inVal - outVal)/0.0025;
-                    mintVector.push_back(neededForFee);
-                }
-            }
-            //Grab fee from other blocks
-            for(auto it = startHeight; it < chainActive.Height() + 1; it++){
-                CBlock block;
-                CBlockIndex *pindex = chainActive[it];
-                // Now get fees from past 719 blocks
-                if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())){
-                    for(auto ctx: block.vtx){
-                        bool isSpend = ctx->IsZerocoinSpend() || ctx->IsSigmaSpend();
-                        bool isMint = ctx->IsZerocoinMint() || ctx->IsSigmaMint();
-                        //Found ghost fee transaction
-                        if(!isSpend && isMint){
-                            for(auto mintTx: ctx->vout){
-                                if(mintTx.scriptPubKey.IsZerocoinMint() || mintTx.scriptPubKey.IsSigmaMint())
-                                    mintVector.push_back(mintTx.nValue);
-                            }
-                        }
-                        //ckp tx requires 0.1 fee, but calculate the fee on a dynamic basis
-                        if(ctx->IsSigmaSpend() && isMint){
-                            CAmount inVal = 0;
-                            CAmount outVal = 0;
-                            for(int i = 0; i < ctx->vout.size(); i++){
-                                if(!ctx->vout[i].scriptPubKey.IsSigmaMint())
-                                    continue;
-                                outVal += ctx->vout[i].nValue;
-                            }
-                            // add input denoms
-                            for(int i = 0; i < ctx->vin.size(); i++){
-                                std::pair<std::unique_ptr<sigma::CoinSpend>, uint32_t> newSpend;
-                                newSpend = ParseSigmaSpend(ctx->vin[i]);
-                                inVal += newSpend.first->getIntDenomination();
-                            }
-                            CAmount neededForFee = (inVal - outVal)/0.0025;
-                            mintVector.push_back(neededForFee);
-                        }
-                    }
-                }
-                else
-                    return false;
-            }
-            for(auto f: mintVector)
-                totalGhosted += f;
+            //Assume chainactive+1 is current block check height, the tip closes the rest of the cycle
+            CAmount cycleGhosted = 0;
+            if(!GetGhostedCycleAmount(chainActive.Tip(), cycleGhosted))
+                return false;
+            totalGhosted += cycleGhosted;
+
             //Calculate total fees for the 720 block cycle
             returnFee = totalGhosted * 0.0025;
             payFees = true;
@@ -2328,38 +3014,6 @@ bool GetGhostnodeFeePayment(int64_t &returnFee, bool &payFees, const CBlock &pBl
         }
         //Make sure all ghost fees in this block are not paid out
         else{
-            for(auto ctx: pBlock.vtx){
-                bool isSpend = ctx->IsZerocoinSpend() || ctx->IsSigmaSpend();
-                bool isMint = ctx->IsZerocoinMint() || ctx->IsSigmaMint();
-                //Found ghost fee transaction
-                if(!isSpend && isMint){
-                    for(auto mintTx: ctx->vout){
-                        if(mintTx.scriptPubKey.IsZerocoinMint() || mintTx.scriptPubKey.IsSigmaMint())
-                            mintVector.push_back(mintTx.nValue);
-                    }
-                }
-                //ckp tx requires 0.1 fee, but calculate the fee on a dynamic basis
-                if(ctx->IsSigmaSpend() && isMint){
-                    CAmount inVal = 0;
-                    CAmount outVal = 0;
-                    for(int i = 0; i < ctx->vout.size(); i++){
-                        if(!ctx->vout[i].scriptPubKey.IsSigmaMint())
-                            continue;
-                        outVal += ctx->vout[i].nValue;
-                    }
-                    // add input denoms
-                    for(int i = 0; i < ctx->vin.size(); i++){
-                        std::pair<std::unique_ptr<sigma::CoinSpend>, uint32_t> newSpend;
-                        newSpend = ParseSigmaSpend(ctx->vin[i]);
-                        inVal += newSpend.first->getIntDenomination();
-                    }
-                    CAmount neededForFee = (inVal - outVal)/0.0025;
-                    mintVector.push_back(neededForFee);
-                }
-            }
-
-            for(auto f: mintVector)
-                totalGhosted += f;
             //Calculate total fees for the current block
             returnFee = totalGhosted * 0.0025;
             payFees = false;
@@ -2378,22 +3032,13 @@ bool CheckGhostProtocolFeePayouts(const CBlock &pBlock, int64_t &totalFees){
     //If current node is synced with node list, check honesty of payouts
     if(ghostnodeSync.IsSynced() && totalFees != 0){
 
-        vector<CGhostnode> ghostnodeVector = mnodeman.GetFullGhostnodeVector();
-        vector<CScript> ghostnodeVectorWinners;
-        ghostnodeVectorWinners.clear();
-
-        int totalActiveNodes = 0;
         int startBlock = (chainActive.Height() + 1) - (Params().GetConsensus().nGhostFeeDistributionCycle - 1);
         int64_t ensureNodeActiveBefore = chainActive[startBlock]->GetBlockTime();
+        std::shared_ptr<const vector<CScript>> ghostnodeVectorWinners = mnodeman.GetGhostFeePayees(ensureNodeActiveBefore);
 
-        for(auto node: ghostnodeVector){
-
-            if(node.IsEnabled() && (node.sigTime <= ensureNodeActiveBefore)){
-                totalActiveNodes++;
-                CTxDestination dest = node.pubKeyCollateralAddress.GetID();
-                CScript nodeScript = GetScriptForDestination(dest);
-                ghostnodeVectorWinners.push_back(nodeScript);
-            }
+        int totalActiveNodes = ghostnodeVectorWinners->size();
+        if(totalActiveNodes == 0){
+            return true;
         }
 
         CAmount feePayout = totalFees/totalActiveNodes;
@@ -2402,10 +3047,14 @@ bool CheckGhostProtocolFeePayouts(const CBlock &pBlock, int64_t &totalFees){
             return true;
         }
 
-        for(CTxOut out: pBlock.vtx[0]->vout){
-            if((std::find(ghostnodeVectorWinners.begin(), ghostnodeVectorWinners.end(), out.scriptPubKey) != ghostnodeVectorWinners.end()) && out.nValue == feePayout) {
-                //erase this check to prevent duplicate payouts
-                ghostnodeVectorWinners.erase(std::find(ghostnodeVectorWinners.begin(), ghostnodeVectorWinners.end(), out.scriptPubKey));
+        //erase the paid nodes to prevent duplicate payouts
+        std::multiset<CScript> unpaidWinners(ghostnodeVectorWinners->begin(), ghostnodeVectorWinners->end());
+        for(const CTxOut &out: pBlock.vtx[0]->vout){
+            if(out.nValue != feePayout)
+                continue;
+            auto winner = unpaidWinners.find(out.scriptPubKey);
+            if(winner != unpaidWinners.end()) {
+                unpaidWinners.erase(winner);
                 totalNodesPaid++;
             }
         }
@@ -2532,6 +3181,16 @@ static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 static int64_t nBlocksTotal = 0;
 
+// ConnectBlock phases reported by getperfinfo
+static CPerfTimer perfConnectPrefetch("connectblock.prefetch");
+static CPerfTimer perfConnectUtxo("connectblock.utxo");
+static CPerfTimer perfConnectScripts("connectblock.scripts");
+static CPerfTimer perfConnectPrivacy("connectblock.sigma_verify");
+static CPerfTimer perfConnectGhostFee("connectblock.ghost_fee");
+static CPerfTimer perfConnectGhostnodePayments("connectblock.ghostnode_payments");
+static CPerfTimer perfConnectStake("connectblock.stake");
+static CPerfTimer perfConnectPrivacyState("connectblock.privacy_state");
+
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
@@ -2565,6 +3224,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     //check for PoS
     if (block.IsProofOfStake())
     {
+        CPerfScope perfScope(perfConnectStake);
         pindex->bnStakeModifier = ComputeStakeModifierV2(pindex->pprev, pindex->prevoutStake.hash);
         setDirtyBlockIndex.insert(pindex);
 
@@ -2670,9 +3330,30 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     int64_t nTime2 = GetTimeMicros(); nTimeForks += nTime2 - nTime1;
     LogPrint(BCLog::BENCH, "    - Fork checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime2 - nTime1), nTimeForks * MICRO, nTimeForks * MILLI / nBlocksTotal);
 
+    // Load every coin the block spends, the coinstake's included, in one batch
+    // rather than one database lookup per input in the loop below. Outputs
+    // created earlier in the same block are not looked up.
+    {
+        CPerfScope perfScope(perfConnectPrefetch);
+        std::set<uint256> setBlockTxids;
+        std::vector<COutPoint> vPrevouts;
+        for (const auto& tx : block.vtx) {
+            if (!tx->IsCoinBase() && !tx->IsZerocoinSpend() && !tx->IsSigmaSpend()) {
+                for (const CTxIn& txin : tx->vin) {
+                    if (!setBlockTxids.count(txin.prevout.hash))
+                        vPrevouts.push_back(txin.prevout);
+                }
+            }
+            setBlockTxids.insert(tx->GetHash());
+        }
+        view.Prefetch(vPrevouts);
+    }
+
     CBlockUndo blockundo;
 
-    CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
+    // like the scripts, zerocoin and sigma proofs are not verified below the assumed valid block.
+    // Their serials and mints are still checked and recorded in full
+    CCheckQueueControl<CBlockCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
 
     std::vector<int> prevheights;
     CAmount nFees = 0;
@@ -2686,6 +3367,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
+    int64_t nPerfStart = PerfTimeMicros();
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
@@ -2704,9 +3386,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             }
             // add input denoms
             for(int i = 0; i < tx.vin.size(); i++){
-                std::pair<std::unique_ptr<sigma::CoinSpend>, uint32_t> newSpend;
-                newSpend = ParseSigmaSpend(tx.vin[i]);
-                inVal += newSpend.first->getIntDenomination();
+                inVal += ParseSigmaSpendView(tx.vin[i]).first.getIntDenomination();
             }
             nFees += (inVal - outVal);
         }
@@ -2757,6 +3437,12 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                 std::vector<uint8_t> hashBytes;
                 int scriptType = 0;
 
+                if (fDelegationIndex && ExtractDelegationInfo(*pScript, scriptType, hashBytes))
+                {
+                    // remove the spent output from its staker's delegations
+                    view.delegationIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, uint256(hashBytes.data(), hashBytes.size()), input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
+                }
+
                 if (!ExtractIndexInfo(pScript, scriptType, hashBytes)
                         || scriptType == 0)
                     continue;
@@ -2801,7 +3487,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : nullptr))
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
-            control.Add(vChecks);
+            AddBlockChecks(control, vChecks);
         } else if(tx.IsCoinBase()){
             nMoneyCreated += tx.GetValueOut();
         }
@@ -2841,8 +3527,36 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             }
         }
 
+        if (fDelegationIndex)
+        {
+            // Record conditional stake outputs under the address delegated to stake them
+            for (unsigned int k = 0; k < tx.vout.size(); k++)
+            {
+                const CTxOut &out = tx.vout[k];
+                std::vector<uint8_t> hashBytes;
+                int scriptType = 0;
+                if (ExtractDelegationInfo(out.scriptPubKey, scriptType, hashBytes))
+                    view.delegationIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, uint256(hashBytes.data(), hashBytes.size()), txHash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
+            }
+        }
+
+
+    }
+    perfConnectUtxo.Add(PerfTimeMicros() - nPerfStart);
+    nPerfStart = PerfTimeMicros();
+
+    if (block.zerocoinTxInfo && fScriptChecks) {
+        if (!CheckZerocoinSpendProofs(state, block.zerocoinTxInfo.get(), pindex->nHeight))
+            return error("ConnectBlock(): CheckZerocoinSpendProofs failed with %s", FormatStateMessage(state));
+    }
 
+    if (block.sigmaTxInfo && fScriptChecks) {
+        std::vector<CSigmaProofCheck> vSigmaChecks;
+        if (!CheckSigmaSpendProofs(state, block.sigmaTxInfo.get(), pindex->nHeight, nScriptCheckThreads ? &vSigmaChecks : nullptr))
+            return error("ConnectBlock(): CheckSigmaSpendProofs failed with %s", FormatStateMessage(state));
+        AddBlockChecks(control, vSigmaChecks);
     }
+    int64_t nPerfPrivacyMicros = PerfTimeMicros() - nPerfStart;
 
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
@@ -2856,7 +3570,12 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         int64_t returnFee = 0;
         bool payFees = false;
         //Check for ghost fee distribution
-        if(!GetGhostnodeFeePayment(returnFee, payFees, block))
+        bool fGhostFeeValid;
+        {
+            CPerfScope perfScope(perfConnectGhostFee);
+            fGhostFeeValid = GetGhostnodeFeePayment(returnFee, payFees, block);
+        }
+        if(!fGhostFeeValid)
             return state.DoS(100, error("ConnectBlock() : GetGhostnodeFeePayment incorrect ghost fee scheduling."), REJECT_INVALID, "bad-cs-amount");
 
         CAmount nCalculatedStakeReward = 0;
@@ -2913,30 +3632,47 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
 
     // Ghostnode
-    std::string strError = "";
-    if (!IsBlockValueValid(block, pindex->nHeight, blockReward, strError)) {
-        return state.DoS(0, error("ConnectBlock(): %s", strError), REJECT_INVALID, "bad-cb-amount");
-    }
+    {
+        CPerfScope perfScope(perfConnectGhostnodePayments);
+        std::string strError = "";
+        if (!IsBlockValueValid(block, pindex->nHeight, blockReward, strError)) {
+            return state.DoS(0, error("ConnectBlock(): %s", strError), REJECT_INVALID, "bad-cb-amount");
+        }
 
-    if (!IsBlockPayeeValid(*block.vtx[0], pindex->nHeight, blockReward)) {
-        mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
-        return state.DoS(0, error("ConnectBlock(): couldn't find ghostnode payments"),
-                         REJECT_INVALID, "bad-cb-payee");
+        if (!IsBlockPayeeValid(*block.vtx[0], pindex->nHeight, blockReward)) {
+            mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
+            return state.DoS(0, error("ConnectBlock(): couldn't find ghostnode payments"),
+                             REJECT_INVALID, "bad-cb-payee");
+        }
     }
     // END Ghostnode
+    if (!fJustCheck)
+        TraceLifecycle(LifecycleObject::BLOCK, pindex->GetBlockHash(), LifecycleStage::GHOSTNODE_CHECKED);
 
 
+    // the queued sigma proofs are waited for along with the scripts, and timed with them
+    nPerfStart = PerfTimeMicros();
     if (!control.Wait())
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
+    perfConnectScripts.Add(PerfTimeMicros() - nPerfStart);
+    perfConnectPrivacy.Add(nPerfPrivacyMicros);
+    if (block.zerocoinTxInfo)
+        block.zerocoinTxInfo->fSpendsVerified = true;
+    if (block.sigmaTxInfo)
+        block.sigmaTxInfo->fSpendsVerified = true;
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
 
 
-    if (!ConnectBlockGhost(state, chainparams, pindex, &block))
-        return false;
+    CPrivacyBlockData privacyData;
+    {
+        CPerfScope perfScope(perfConnectPrivacyState);
+        if (!ConnectBlockGhost(state, chainparams, pindex, &block, privacyData))
+            return false;
 
-    if (!ConnectBlockSigma(state, chainparams, pindex, &block))
-        return false;
+        if (!ConnectBlockSigma(state, chainparams, pindex, &block, privacyData))
+            return false;
+    }
 
     //Set money supply on block once PoS starts, calculate previous total
     if(!pindex->pprev->IsProofOfStake() && pindex->IsProofOfStake()){
@@ -2952,9 +3688,50 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     if (fJustCheck)
         return true;
 
+    if (fScriptChecks) {
+        dequeScriptCheckedBlocks.emplace_back(pindex->GetBlockHash(), flags);
+        if (dequeScriptCheckedBlocks.size() > SHORT_REORG_DEPTH)
+            dequeScriptCheckedBlocks.pop_front();
+    }
+
     if (!WriteUndoDataForBlock(blockundo, state, pindex, chainparams))
         return false;
 
+    // without the blocks the stakes of competing blocks spending these coins can't be checked otherwise
+    if (fPruneMode) {
+        std::vector<std::pair<COutPoint, CKernelOrigin> > vOrigins;
+        for (unsigned int i = 1; i < block.vtx.size(); i++) {
+            const CTransaction &tx = *(block.vtx[i]);
+            const CTxUndo &txundo = blockundo.vtxundo[i - 1];
+            for (unsigned int j = 0; j < tx.vin.size() && j < txundo.vprevout.size(); j++) {
+                const CBlockIndex *pindexOrigin = pindex->GetAncestor(txundo.vprevout[j].nHeight);
+                if (!pindexOrigin)
+                    continue;
+                CKernelOrigin origin;
+                origin.out = txundo.vprevout[j].out;
+                origin.nBlockTime = pindexOrigin->GetBlockTime();
+                origin.hashBlock = pindexOrigin->GetBlockHash();
+                vOrigins.push_back(std::make_pair(tx.vin[j].prevout, origin));
+            }
+        }
+        if (!vOrigins.empty() && !pblocktree->WriteKernelOrigins(pindex->nHeight, vOrigins))
+            return AbortNode(state, "Failed to write kernel origins");
+    }
+
+    // keep the ghosted amount of the cycle so far for the fee distribution payouts
+    if (!(pindex->nStatus & BLOCK_GHOSTED_AMOUNT)) {
+        CAmount nGhostedCycleAmount = GetBlockGhostedAmount(block);
+        if (!IsFirstBlockOfGhostFeeCycle(pindex->nHeight)) {
+            CAmount nPrevGhostedAmount = 0;
+            if (!GetGhostedCycleAmount(pindex->pprev, nPrevGhostedAmount))
+                return error("ConnectBlock(): failed to read the ghosted amounts of the fee distribution cycle");
+            nGhostedCycleAmount += nPrevGhostedAmount;
+        }
+        pindex->nGhostedCycleAmount = nGhostedCycleAmount;
+        pindex->nStatus |= BLOCK_GHOSTED_AMOUNT;
+        setDirtyBlockIndex.insert(pindex);
+    }
+
     if (!pindex->IsValid(BLOCK_VALID_SCRIPTS)) {
         pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
         setDirtyBlockIndex.insert(pindex);
@@ -2963,6 +3740,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     if (!WriteTxIndexDataForBlock(block, state, pindex))
         return false;
 
+    if (!privacyData.IsNull() && !pprivacyindex->WriteBlock(pindex, privacyData))
+        return AbortNode(state, "Failed to write privacy index");
+
 
     if (fTimestampIndex)
     {
@@ -2990,7 +3770,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                 if (!conflictingTxHash.IsNull() && conflictingTxHash != thisTxHash) {
                     auto pTx = mempool.get(conflictingTxHash);
                     if (pTx)
-                        mempool.removeRecursive(*pTx, MemPoolRemovalReason::BLOCK);
+                        mempool.removeRecursive(*pTx, MemPoolRemovalReason::SERIAL_CONFLICT);
                     LogPrintf("ConnectBlock: removed conflicting zerocoin spend tx %s from the mempool\n",
                               conflictingTxHash.ToString());
                 }
@@ -3011,7 +3791,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                 if (!conflictingTxHash.IsNull() && conflictingTxHash != thisTxHash) {
                     auto pTx = mempool.get(conflictingTxHash);
                     if (pTx)
-                        mempool.removeRecursive(*pTx, MemPoolRemovalReason::BLOCK);
+                        mempool.removeRecursive(*pTx, MemPoolRemovalReason::SERIAL_CONFLICT);
                     LogPrintf("ConnectBlock: removed conflicting zerocoin spend tx %s from the mempool\n",
                               conflictingTxHash.ToString());
                 }
@@ -3022,6 +3802,26 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         }
     }
 
+    // Erase mempool sigma spends of the serials spent in this block
+    CSigmaState *sigmaState = CSigmaState::GetSigmaState();
+    BOOST_FOREACH(const CTransactionRef &tx, block.vtx) {
+        if (tx->IsSigmaSpend()) {
+            for (const CTxIn &txin : tx->vin) {
+                Scalar serial = SigmaGetSpendSerialNumber(*tx, txin);
+                uint256 conflictingTxHash = sigmaState->GetMempoolConflictingTxHash(serial);
+                if (!conflictingTxHash.IsNull() && conflictingTxHash != tx->GetHash()) {
+                    auto pTx = mempool.get(conflictingTxHash);
+                    if (pTx)
+                        mempool.removeRecursive(*pTx, MemPoolRemovalReason::SERIAL_CONFLICT);
+                    LogPrintf("ConnectBlock: removed conflicting sigma spend tx %s from the mempool\n",
+                              conflictingTxHash.ToString());
+                }
+
+                sigmaState->RemoveSpendFromMempool(serial);
+            }
+        }
+    }
+
     int64_t nTime5 = GetTimeMicros(); nTimeIndex += nTime5 - nTime4;
     LogPrint(BCLog::BENCH, "    - Index writing: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime5 - nTime4), nTimeIndex * MICRO, nTimeIndex * MILLI / nBlocksTotal);
 
@@ -3051,6 +3851,11 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
     {
         LOCK(cs_LastBlockFile);
         if (fPruneMode && (fCheckForPruning || nManualPruneHeight > 0) && !fReindex) {
+            // The fee distribution payout sums the ghosted amounts of the current cycle, have them
+            // all in the block index before its blocks can go
+            CAmount nCycleAmount;
+            if (chainActive.Tip() && !GetGhostedCycleAmount(chainActive.Tip(), nCycleAmount))
+                return AbortNode(state, "Failed to read the ghosted amounts of the fee distribution cycle");
             if (nManualPruneHeight > 0) {
                 FindFilesToPruneManual(setFilesToPrune, nManualPruneHeight);
             } else {
@@ -3063,6 +3868,9 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                     pblocktree->WriteFlag("prunedblockfiles", true);
                     fHavePruned = true;
                 }
+                // Stakes deeper than the kept blocks can't be reorganized to anymore
+                if (!pblocktree->EraseKernelOrigins(chainActive.Height() - MIN_BLOCKS_TO_KEEP))
+                    return AbortNode(state, "Failed to erase kernel origins");
             }
         }
         nNow = GetTimeMicros();
@@ -3129,7 +3937,9 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
             // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            // With -dbbackgroundflush the coins are written on a thread of their
+            // own, forced flushes still wait for them to be on disk.
+            if (!pcoinsTip->Flush() || (mode == FLUSH_STATE_ALWAYS && !pcoinsdbview->WaitForFlush()))
                 return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
         }
@@ -3187,6 +3997,9 @@ bool FlushView(CCoinsViewCache *view, CValidationState& state, bool fDisconnecti
 
         if (!pblocktree->UpdateAddressUnspentIndex(view->addressUnspentIndex))
             return AbortNode(state, "Failed to write address unspent index");
+
+        if (fAddressBalanceIndex && !pblocktree->UpdateAddressBalanceIndex(view->addressIndex, fDisconnecting))
+            return AbortNode(state, "Failed to write address balance index");
     };
 
     if (fSpentIndex)
@@ -3195,16 +4008,28 @@ bool FlushView(CCoinsViewCache *view, CValidationState& state, bool fDisconnecti
             return AbortNode(state, "Failed to write transaction index");
     };
 
+    if (fDelegationIndex && !pblocktree->UpdateDelegationIndex(view->delegationIndex))
+        return AbortNode(state, "Failed to write delegation index");
+
     view->addressIndex.clear();
     view->addressUnspentIndex.clear();
+    view->delegationIndex.clear();
     view->spentIndex.clear();
 
     return true;
 };
 
+void NotifyStateChange()
+{
+    // under the lock, a waiter can't miss a change made after it looked
+    WaitableLock lock(csBestBlock);
+    cvBlockChange.notify_all();
+}
+
 /** Check warning conditions and do some notifications on new chain tip set. */
 void static UpdateTip(const CBlockIndex *pindexNew, const CChainParams& chainParams) {
-
+    PublishChainSnapshot();
+    UpdateNetworkStakeStats(pindexNew);
 
     // New best block
     mempool.AddTransactionsUpdated(1);
@@ -3272,6 +4097,10 @@ void static UpdateTip(const CBlockIndex *pindexNew, const CChainParams& chainPar
   * disconnectpool (note that the caller is responsible for mempool consistency
   * in any case).
   */
+// DisconnectTip phases reported by getperfinfo
+static CPerfTimer perfDisconnectUtxo("disconnectblock.utxo");
+static CPerfTimer perfDisconnectPrivacyState("disconnectblock.privacy_state");
+
 bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions *disconnectpool)
 {
     CBlockIndex *pindexDelete = chainActive.Tip();
@@ -3284,6 +4113,7 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
     // Apply the block atomically to the chain state.
     int64_t nStart = GetTimeMicros();
     {
+        CPerfScope perfScope(perfDisconnectUtxo);
         CCoinsViewCache view(pcoinsTip.get());
         assert(view.GetBestBlock() == pindexDelete->GetBlockHash());
         if (DisconnectBlock(block, pindexDelete, view) != DISCONNECT_OK)
@@ -3292,9 +4122,12 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
         assert(flushed);
     }
 
-    DisconnectTipGhost(block, pindexDelete);
+    {
+        CPerfScope perfScope(perfDisconnectPrivacyState);
+        DisconnectTipGhost(block, pindexDelete);
 
-    DisconnectTipSigma(block, pindexDelete);
+        DisconnectTipSigma(block, pindexDelete);
+    }
 
     LogPrint(BCLog::BENCH, "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * MILLI);
     // Write the chain state to disk, if necessary.
@@ -3306,6 +4139,13 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
         for (auto it = block.vtx.rbegin(); it != block.vtx.rend(); ++it) {
             disconnectpool->addTransaction(*it);
         }
+        // with their script checks if the block was connected recently enough
+        if (!dequeScriptCheckedBlocks.empty() && dequeScriptCheckedBlocks.back().first == pindexDelete->GetBlockHash()) {
+            for (const CTransactionRef& tx : block.vtx) {
+                if (!tx->IsCoinBase() && !tx->IsZerocoinSpend() && !tx->IsSigmaSpend())
+                    disconnectpool->mapScriptFlags[tx->GetHash()] = dequeScriptCheckedBlocks.back().second;
+            }
+        }
         while (disconnectpool->DynamicMemoryUsage() > MAX_DISCONNECTED_TX_POOL_SIZE * 1000) {
             // Drop the earliest entry, and remove its children from the mempool.
             auto it = disconnectpool->queuedTx.get<insertion_order>().begin();
@@ -3314,6 +4154,9 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
         }
     }
 
+    if (!dequeScriptCheckedBlocks.empty() && dequeScriptCheckedBlocks.back().first == pindexDelete->GetBlockHash())
+        dequeScriptCheckedBlocks.pop_back();
+
     chainActive.SetTip(pindexDelete->pprev);
 
     UpdateTip(pindexDelete->pprev, chainparams);
@@ -3388,7 +4231,7 @@ public:
 
     void NotifyEntryRemoved(CTransactionRef txRemoved, MemPoolRemovalReason reason) {
         assert(!blocksConnected.back().pindex);
-        if (reason == MemPoolRemovalReason::CONFLICT) {
+        if (reason == MemPoolRemovalReason::CONFLICT || reason == MemPoolRemovalReason::SERIAL_CONFLICT) {
             blocksConnected.back().conflictedTxs->emplace_back(std::move(txRemoved));
         }
     }
@@ -3407,10 +4250,9 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime1 = GetTimeMicros();
     std::shared_ptr<const CBlock> pthisBlock;
     if (!pblock) {
-        std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
-        if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
+        pthisBlock = blockPrefetcher.Take(pindexNew->GetBlockHash());
+        if (!pthisBlock && !ReadBlockFromDisk(pthisBlock, pindexNew, chainparams.GetConsensus()))
             return AbortNode(state, "Failed to read block");
-        pthisBlock = pblockNew;
     } else {
         pthisBlock = pblock;
     }
@@ -3446,6 +4288,9 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
         }
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
         LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
+        TraceLifecycle(LifecycleObject::BLOCK, pindexNew->GetBlockHash(), LifecycleStage::CONNECTED);
+        for (const CTransactionRef& tx : blockConnecting.vtx)
+            TraceLifecycle(LifecycleObject::TX, tx->GetHash(), LifecycleStage::CONNECTED);
         bool flushed = FlushView(&view, state, false);
         assert(flushed);
     }
@@ -3459,9 +4304,11 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     // Remove conflicting transactions from the mempool.;
     mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
     disconnectpool.removeForBlock(blockConnecting.vtx);
+    mnodeman.CheckSpentCollaterals(blockConnecting);
     // Update chainActive & related variables.
     chainActive.SetTip(pindexNew);
     UpdateTip(pindexNew, chainparams);
+    TraceLifecycle(LifecycleObject::BLOCK, pindexNew->GetBlockHash(), LifecycleStage::TIP_UPDATED);
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
@@ -3544,6 +4391,16 @@ void CChainState::PruneBlockIndexCandidates() {
     assert(!setBlockIndexCandidates.empty());
 }
 
+void CChainState::ActivateSnapshotBlock(CBlockIndex *pindex)
+{
+    AssertLockHeld(cs_main);
+    // The genesis block can't be returned to, the blocks in between were never connected
+    setBlockIndexCandidates.insert(pindex);
+    chainActive.SetTip(pindex);
+    PublishChainSnapshot();
+    PruneBlockIndexCandidates();
+}
+
 /**
  * Try to make some progress towards making pindexMostWork the active block.
  * pblock is either nullptr or a pointer to a CBlock corresponding to pindexMostWork.
@@ -3584,6 +4441,15 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
         }
         nHeight = nTargetHeight;
 
+        // Let the prefetch workers read the blocks after the one connected first.
+        std::vector<const CBlockIndex*> vpindexPrefetch;
+        for (CBlockIndex *pindexPrefetch : reverse_iterate(vpindexToConnect)) {
+            if (pindexPrefetch != vpindexToConnect.back() && !(pblock && pindexPrefetch == pindexMostWork))
+                vpindexPrefetch.push_back(pindexPrefetch);
+        }
+        if (!vpindexPrefetch.empty())
+            blockPrefetcher.Schedule(vpindexPrefetch);
+
         // Connect new blocks.
         for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
@@ -3837,6 +4703,28 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
     return g_chainstate.InvalidateBlock(state, chainparams, pindex);
 }
 
+bool CChainState::DisconnectBlocksTo(CValidationState& state, const CChainParams& chainparams, CBlockIndex *pindex)
+{
+    AssertLockHeld(cs_main);
+    assert(chainActive.Contains(pindex));
+
+    // Unlike InvalidateBlock nothing is marked, the old tip stays a candidate so the next
+    // ActivateBestChain connects the same blocks again
+    DisconnectedBlockTransactions disconnectpool;
+    while (chainActive.Tip() != pindex) {
+        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+            UpdateMempoolForReorg(disconnectpool, false);
+            return false;
+        }
+    }
+    UpdateMempoolForReorg(disconnectpool, true);
+    uiInterface.NotifyBlockTip(IsInitialBlockDownload(), pindex);
+    return true;
+}
+bool DisconnectBlocksTo(CValidationState& state, const CChainParams& chainparams, CBlockIndex *pindex) {
+    return g_chainstate.DisconnectBlocksTo(state, chainparams, pindex);
+}
+
 bool CChainState::ResetBlockFailureFlags(CBlockIndex *pindex) {
     AssertLockHeld(cs_main);
 
@@ -3900,6 +4788,7 @@ CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block)
     pindexNew->nTimeMax = (pindexNew->pprev ? std::max(pindexNew->pprev->nTimeMax, pindexNew->nTime) : pindexNew->nTime);
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
+    pindexNew->nStatus |= BLOCK_POW_CHECKED;
     if (pindexBestHeader == nullptr || pindexBestHeader->nChainWork < pindexNew->nChainWork)
         pindexBestHeader = pindexNew;
 
@@ -4045,7 +4934,7 @@ static bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos,
     return true;
 }
 
-static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
+static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, uint256* phashPoW = nullptr)
 {
 
     // Get prev block index
@@ -4060,8 +4949,13 @@ static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state,
 
     // Check proof of work matches claimed amount
     if(nHeight < consensusParams.nPosHeightActivate){
-        if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams))
-            return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
+        if (fCheckPOW) {
+            uint256 hashPoW = block.GetPoWHash(nHeight);
+            if (!CheckProofOfWork(hashPoW, block.nBits, consensusParams))
+                return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
+            if (phashPoW)
+                *phashPoW = hashPoW;
+        }
     }
     else{
         // Check timestamp
@@ -4508,13 +5402,15 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+/** phashPoW, if given, is the PoW hash of block already checked against nBits by the caller */
+bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, const uint256* phashPoW)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
     uint256 hash = block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = nullptr;
+    uint256 hashPoW = phashPoW ? *phashPoW : uint256();
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
 
         if (miSelf != mapBlockIndex.end()) {
@@ -4527,7 +5423,7 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), !phashPoW, &hashPoW))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -4556,8 +5452,11 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             }
         }
     }
-    if (pindex == nullptr)
+    if (pindex == nullptr) {
         pindex = AddToBlockIndex(block);
+        if (!hashPoW.IsNull())
+            pindex->SetBlockPoWHash(hashPoW);
+    }
 
     if (ppindex)
         *ppindex = pindex;
@@ -4571,11 +5470,38 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+
+    // Hash the PoW of pre-PoS headers on the script check threads before taking cs_main for the batch.
+    // A header that passes skips the serial check in AcceptBlockHeader, failures are left to it.
+    const Consensus::Params& consensusParams = chainparams.GetConsensus();
+    std::vector<uint256> vPoWHash(headers.size());
+    int nFirstHeight = -1;
+    if (headers.size() > 1) {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(headers.front().hashPrevBlock);
+        if (mi != mapBlockIndex.end())
+            nFirstHeight = mi->second->nHeight + 1;
+    }
+    if (nFirstHeight >= 0 && nFirstHeight < consensusParams.nPosHeightActivate) {
+        size_t nPoWHeaders = std::min(headers.size(), (size_t)(consensusParams.nPosHeightActivate - nFirstHeight));
+        size_t nChunks = (nPoWHeaders + POW_HASH_BATCH_SIZE - 1) / POW_HASH_BATCH_SIZE;
+        sigma::parallel_for(nChunks, std::max(nScriptCheckThreads, 1), [&](std::size_t nChunk) {
+            size_t nBegin = nChunk * POW_HASH_BATCH_SIZE;
+            size_t nEnd = std::min(nBegin + POW_HASH_BATCH_SIZE, nPoWHeaders);
+            GetPoWHashes(&headers[nBegin], nEnd - nBegin, &vPoWHash[nBegin]);
+            for (size_t i = nBegin; i < nEnd; i++) {
+                if (!CheckProofOfWork(vPoWHash[i], headers[i].nBits, consensusParams))
+                    vPoWHash[i].SetNull();
+            }
+        });
+    }
+
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex, vPoWHash[i].IsNull() ? nullptr : &vPoWHash[i])) {
                 if (first_invalid) *first_invalid = header;
                 return false;
             }
@@ -4591,6 +5517,10 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
 /** Store block on disk. If dbp is non-nullptr, the file is known to already reside on disk */
 static CDiskBlockPos SaveBlockToDisk(const CBlock& block, int nHeight, const CChainParams& chainparams, const CDiskBlockPos* dbp) {
     unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+    std::vector<unsigned char> vRecord;
+    bool fCompressed = dbp == nullptr && fCompressBlocks && CompressBlockRecord(block, vRecord);
+    if (fCompressed)
+        nBlockSize = vRecord.size();
     CDiskBlockPos blockPos;
     if (dbp != nullptr)
         blockPos = *dbp;
@@ -4599,7 +5529,7 @@ static CDiskBlockPos SaveBlockToDisk(const CBlock& block, int nHeight, const CCh
         return CDiskBlockPos();
     }
     if (dbp == nullptr) {
-        if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart())) {
+        if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart(), fCompressed ? &vRecord : nullptr)) {
             AbortNode("Failed to write block");
             return CDiskBlockPos();
         }
@@ -4608,7 +5538,8 @@ static CDiskBlockPos SaveBlockToDisk(const CBlock& block, int nHeight, const CCh
 }
 
 /** Store block on disk. If dbp is non-nullptr, the file is known to already reside on disk */
-bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock)
+/** phashPoW, if given, is the PoW hash of the block already checked against nBits by the caller */
+bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock, const uint256* phashPoW)
 {
     const CBlock& block = *pblock;
 
@@ -4618,7 +5549,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
     CBlockIndex *pindexDummy = nullptr;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
 
-    if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    if (!AcceptBlockHeader(block, state, chainparams, &pindex, phashPoW))
         return false;
 
     if (block.IsProofOfStake())
@@ -4740,6 +5671,7 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
             GetMainSignals().BlockChecked(*pblock, state);
             return error("%s: AcceptBlock FAILED (%s)", __func__, state.GetDebugMessage());
         }
+        TraceLifecycle(LifecycleObject::BLOCK, pblock->GetHash(), LifecycleStage::ACCEPTED);
         if (pindex && state.nFlags & BLOCK_FAILED_DUPLICATE_STAKE)
         {
             pindex->nFlags |= BLOCK_FAILED_DUPLICATE_STAKE;
@@ -4839,6 +5771,9 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+#ifndef WIN32
+        blockFileMappings.Drop(*it);
+#endif
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -5005,11 +5940,16 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
 
 bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlockTreeDB& blocktree)
 {
-    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash){ return this->InsertBlockIndex(hash); }))
+    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash){ return this->InsertBlockIndex(hash); }, *pprivacyindex))
         return false;
 
     boost::this_thread::interruption_point();
 
+    // The block of a UTXO snapshot has no transactions here, the blocks on top of it link to it anyway
+    uint256 hashSnapshotBlock;
+    unsigned int nSnapshotChainTx = 0;
+    blocktree.ReadSnapshotBlock(hashSnapshotBlock, nSnapshotChainTx);
+
     // Calculate nChainWork
     std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
     vSortedByHeight.reserve(mapBlockIndex.size());
@@ -5038,6 +5978,10 @@ bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlo
                 pindex->nChainTx = pindex->nTx;
             }
         }
+        if (pindex->GetBlockHash() == hashSnapshotBlock) {
+            pindex->nChainTx = nSnapshotChainTx;
+            pindexSnapshotBlock = pindex;
+        }
         if (!(pindex->nStatus & BLOCK_FAILED_MASK) && pindex->pprev && (pindex->pprev->nStatus & BLOCK_FAILED_MASK)) {
             pindex->nStatus |= BLOCK_FAILED_CHILD;
             setDirtyBlockIndex.insert(pindex);
@@ -5060,6 +6004,12 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     if (!g_chainstate.LoadBlockIndex(chainparams.GetConsensus(), *pblocktree))
         return false;
 
+    bool fLoadingSnapshot = false;
+    if (pblocktree->ReadFlag("loadingsnapshot", fLoadingSnapshot) && fLoadingSnapshot)
+        return error("%s: loading a UTXO snapshot was interrupted, the chainstate is incomplete", __func__);
+    if (pindexSnapshotBlock)
+        LogPrintf("%s: chainstate loaded from a UTXO snapshot at block %s (height %d)\n", __func__, pindexSnapshotBlock->GetBlockHash().ToString(), pindexSnapshotBlock->nHeight);
+
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
     vinfoBlockFile.resize(nLastBlockFile + 1);
@@ -5113,6 +6063,15 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadFlag("addressindex", fAddressIndex);
     LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
 
+    // Check whether we have address balance checkpoints
+    pblocktree->ReadFlag("addressbalanceindex", fAddressBalanceIndex);
+    fAddressBalanceIndex &= fAddressIndex;
+    LogPrintf("%s: address balance index %s\n", __func__, fAddressBalanceIndex ? "enabled" : "disabled");
+
+    // Check whether we have a delegation index
+    pblocktree->ReadFlag("delegationindex", fDelegationIndex);
+    LogPrintf("%s: delegation index %s\n", __func__, fDelegationIndex ? "enabled" : "disabled");
+
     // Check whether we have a timestamp index
     pblocktree->ReadFlag("timestampindex", fTimestampIndex);
     LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
@@ -5125,13 +6084,9 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadFlag("dataindex", fDataIndex);
     LogPrintf("%s: data index %s\n", __func__, fDataIndex ? "enabled" : "disabled");
 
-    // some blocks in index can change as a result of ZerocoinBuildStateFromIndex() call
+    // accumulators recalculated by ZerocoinBuildStateFromIndex() are rewritten in the privacy index
     set<CBlockIndex *> changes;
     ZerocoinBuildStateFromIndex(&chainActive, changes);
-    if (!changes.empty()) {
-        setDirtyBlockIndex.insert(changes.begin(), changes.end());
-        FlushStateToDisk();
-    }
 
 
     return true;
@@ -5156,6 +6111,7 @@ bool LoadChainTip(const CChainParams& chainparams)
     if (it == mapBlockIndex.end())
         return false;
     chainActive.SetTip(it->second);
+    PublishChainSnapshot();
 
     g_chainstate.PruneBlockIndexCandidates();
 
@@ -5176,6 +6132,8 @@ CVerifyDB::~CVerifyDB()
     uiInterface.ShowProgress("", 100, false);
 }
 
+static bool RebuildPrivacyStateFromSnapshot();
+
 bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth)
 {
     LOCK(cs_main);
@@ -5211,6 +6169,11 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
         }
+        if (pindex == pindexSnapshotBlock) {
+            // Blocks up to a UTXO snapshot were never downloaded
+            LogPrintf("VerifyDB(): block verification stopping at height %d (UTXO snapshot)\n", pindex->nHeight);
+            break;
+        }
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
@@ -5264,16 +6227,20 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         }
     }
 
-    // some blocks in index can change as a result of ZerocoinBuildStateFromIndex() call
-    set<CBlockIndex *> changes;
-    ZerocoinBuildStateFromIndex(&chainActive, changes);
-    if (!changes.empty()) {
-        setDirtyBlockIndex.insert(changes.begin(), changes.end());
-        FlushStateToDisk();
-    }
+    // the state saved at the last shutdown saves walking the privacy index
+    if (!LoadPrivacyState()) {
+        if (pindexSnapshotBlock) {
+            if (!RebuildPrivacyStateFromSnapshot())
+                return error("VerifyDB(): *** unable to rebuild the privacy state from the UTXO snapshot\n");
+        } else {
+            // accumulators recalculated by ZerocoinBuildStateFromIndex() are rewritten in the privacy index
+            set<CBlockIndex *> changes;
+            ZerocoinBuildStateFromIndex(&chainActive, changes);
 
-    if(!SigmaBuildStateFromIndex(&chainActive))
-        return error("VerifyDB(): *** SigmaBuildStateFromIndex error \n");
+            if(!SigmaBuildStateFromIndex(&chainActive))
+                return error("VerifyDB(): *** SigmaBuildStateFromIndex error \n");
+        }
+    }
 
     LogPrintf("[DONE].\n");
     LogPrintf("No coin database inconsistencies in last %i blocks (%i transactions)\n", chainActive.Height() - pindexState->nHeight, nGoodTransactions);
@@ -5377,7 +6344,8 @@ bool CChainState::RewindBlockIndex(const CChainParams& params)
 
     // Note that during -reindex-chainstate we are called with an empty chainActive!
 
-    int nHeight = 1;
+    // Blocks up to a UTXO snapshot are taken as validated
+    int nHeight = pindexSnapshotBlock ? pindexSnapshotBlock->nHeight + 1 : 1;
     while (nHeight <= chainActive.Height()) {
         if (IsWitnessEnabled(chainActive[nHeight - 1], params.GetConsensus()) && !(chainActive[nHeight]->nStatus & BLOCK_OPT_WITNESS)) {
             break;
@@ -5488,8 +6456,10 @@ void UnloadBlockIndex()
 {
     LOCK(cs_main);
     chainActive.SetTip(nullptr);
+    PublishChainSnapshot();
     pindexBestInvalid = nullptr;
     pindexBestHeader = nullptr;
+    pindexSnapshotBlock = nullptr;
     mempool.clear();
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
@@ -5538,6 +6508,16 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         pblocktree->WriteFlag("addressindex", fAddressIndex);
         LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
 
+        // Use the provided setting for -addressbalanceindex in the new database, it builds on the address index
+        fAddressBalanceIndex = fAddressIndex && gArgs.GetBoolArg("-addressbalanceindex", DEFAULT_ADDRESSBALANCEINDEX);
+        pblocktree->WriteFlag("addressbalanceindex", fAddressBalanceIndex);
+        LogPrintf("%s: address balance index %s\n", __func__, fAddressBalanceIndex ? "enabled" : "disabled");
+
+        // Use the provided setting for -delegationindex in the new database
+        fDelegationIndex = gArgs.GetBoolArg("-delegationindex", DEFAULT_DELEGATIONINDEX);
+        pblocktree->WriteFlag("delegationindex", fDelegationIndex);
+        LogPrintf("%s: delegation index %s\n", __func__, fDelegationIndex ? "enabled" : "disabled");
+
         // Use the provided setting for -timestampindex in the new database
         fTimestampIndex = gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
         pblocktree->WriteFlag("timestampindex", fTimestampIndex);
@@ -5591,13 +6571,38 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     return g_chainstate.LoadGenesisBlock(chainparams);
 }
 
-bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
-{
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+namespace {
 
-    int nLoaded = 0;
+/** Disk positions of blocks with unknown parent (only used for reindex), with their PoW hash if it was checked */
+std::multimap<uint256, std::pair<CDiskBlockPos, uint256>> mapBlocksUnknownParent;
+
+/** A block read by a -reindex reader, see ReindexBlockFiles */
+struct CReindexBlock
+{
+    std::shared_ptr<CBlock> pblock;
+    CDiskBlockPos pos;
+    //! PoW hash checked against nBits, null when the block is to be hashed on import
+    uint256 hashPoW;
+    unsigned int nSize;
+};
+
+/** The blocks read from a block file and not imported yet */
+struct CReindexFile
+{
+    std::deque<CReindexBlock> blocks;
+    //! serialized size of blocks
+    uint64_t nSize = 0;
+    bool fDone = false;
+};
+
+} // namespace
+
+/**
+ * Read the blocks of a block file in order and pass each to fn along with its serialized
+ * size, dbp (if given) pointing at it. Stops early when fn returns false.
+ */
+static void ReadBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp, const std::function<bool(const std::shared_ptr<CBlock>&, unsigned int)>& fn)
+{
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
@@ -5619,7 +6624,7 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                     continue;
                 // read size
                 blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                if ((nSize & ~BLOCK_RECORD_COMPRESSED) < 80 || (nSize & ~BLOCK_RECORD_COMPRESSED) > MAX_BLOCK_SERIALIZED_SIZE)
                     continue;
             } catch (const std::exception&) {
                 // no valid block header found; don't complain
@@ -5630,83 +6635,234 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                 uint64_t nBlockPos = blkdat.GetPos();
                 if (dbp)
                     dbp->nPos = nBlockPos;
+                bool fCompressed = (nSize & BLOCK_RECORD_COMPRESSED) != 0;
+                nSize &= ~BLOCK_RECORD_COMPRESSED;
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
                 std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
+                if (fCompressed) {
+                    std::vector<unsigned char> vRecord(nSize), vBlock;
+                    blkdat.read((char*)vRecord.data(), vRecord.size());
+                    if (!DecompressBlockRecord(vRecord.data(), vRecord.size(), vBlock))
+                        throw std::ios_base::failure("block decompression failed");
+                    CSpanReader reader(SER_DISK, CLIENT_VERSION, vBlock.data(), vBlock.size());
+                    reader >> *pblock;
+                    nSize = vBlock.size();
+                } else {
+                    blkdat >> *pblock;
+                }
                 nRewind = blkdat.GetPos();
 
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
+                if (!fn(pblock, nSize))
+                    break;
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+    }
+}
 
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    if (g_chainstate.AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
+/**
+ * Accept a block read from a block file, then the blocks read earlier that were waiting
+ * for it as their parent. phashPoW is as for AcceptBlock. Returns false on a fatal error.
+ */
+static bool ImportBlock(const CChainParams& chainparams, const std::shared_ptr<CBlock>& pblock, const CDiskBlockPos *dbp, const uint256* phashPoW, int& nLoaded)
+{
+    const CBlock& block = *pblock;
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
+    // detect out of order blocks, and store them for later
+    uint256 hash = block.GetHash();
+    if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                block.hashPrevBlock.ToString());
+        if (dbp)
+            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, std::make_pair(*dbp, phashPoW ? *phashPoW : uint256())));
+        return true;
+    }
+
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        LOCK(cs_main);
+        CValidationState state;
+        if (g_chainstate.AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr, phashPoW))
+            nLoaded++;
+        if (state.IsError())
+            return false;
+    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+        LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip();
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        auto range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            auto it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+            const int nHeight = mapBlockIndex[it->first]->nHeight;
+            if (ReadBlockFromDisk(*pblockrecursive, it->second.first, nHeight, chainparams.GetConsensus()))
+            {
+                LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                const uint256& hashPoW = it->second.second;
+                if (g_chainstate.AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second.first, nullptr, hashPoW.IsNull() ? nullptr : &hashPoW))
+                {
+                    nLoaded++;
+                    queue.push_back(pblockrecursive->GetHash());
                 }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
 
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        const int nHeight = mapBlockIndex[it->first]->nHeight;
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, nHeight, chainparams.GetConsensus()))
-                        {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (g_chainstate.AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
-                            {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
+bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
+{
+    int64_t nStart = GetTimeMillis();
+
+    int nLoaded = 0;
+    ReadBlockFile(chainparams, fileIn, dbp, [&](const std::shared_ptr<CBlock>& pblock, unsigned int nSize) {
+        return ImportBlock(chainparams, pblock, dbp, nullptr, nLoaded);
+    });
+    if (nLoaded > 0)
+        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    return nLoaded > 0;
+}
+
+void ReindexBlockFiles(const CChainParams& chainparams, int nReaders)
+{
+    int64_t nStart = GetTimeMillis();
+
+    int nFiles = 0;
+    while (fs::exists(GetBlockPosFilename(CDiskBlockPos(nFiles, 0), "blk")))
+        nFiles++;
+
+    // Readers take the files in order and hand over their blocks, PoW hashed, to this thread,
+    // which imports them file by file. Readers of later files stop once REINDEX_READ_AHEAD_SIZE
+    // is buffered in total, the reader of the file being imported once that much of its own
+    // file is, so it never waits on the others.
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::map<int, CReindexFile> mapFiles;
+    int nNextFile = 0;
+    int nImportFile = 0;
+    uint64_t nBuffered = 0;
+    bool fStop = false;
+
+    auto read_files = [&]() {
+        while (true) {
+            int nFile;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                if (fStop || nNextFile >= nFiles)
+                    return;
+                nFile = nNextFile++;
+            }
+
+            CDiskBlockPos pos(nFile, 0);
+            FILE *file = OpenBlockFile(pos, true);
+            if (file) {
+                LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+                ReadBlockFile(chainparams, file, &pos, [&](const std::shared_ptr<CBlock>& pblock, unsigned int nSize) {
+                    uint256 hashPoW;
+                    if (!pblock->IsProofOfStake()) {
+                        hashPoW = pblock->GetPoWHash(0);
+                        // failures are left to AcceptBlock
+                        if (!CheckProofOfWork(hashPoW, pblock->nBits, chainparams.GetConsensus()))
+                            hashPoW.SetNull();
                     }
+
+                    boost::unique_lock<boost::mutex> lock(cs);
+                    CReindexFile& reading = mapFiles[nFile];
+                    while (!fStop && (nFile == nImportFile ? reading.nSize : nBuffered) >= REINDEX_READ_AHEAD_SIZE)
+                        cond.wait(lock);
+                    if (fStop)
+                        return false;
+                    reading.blocks.push_back(CReindexBlock{pblock, pos, hashPoW, nSize});
+                    reading.nSize += nSize;
+                    nBuffered += nSize;
+                    cond.notify_all();
+                    return true;
+                });
+            }
+
+            boost::unique_lock<boost::mutex> lock(cs);
+            mapFiles[nFile].fDone = true;
+            cond.notify_all();
+        }
+    };
+
+    boost::thread_group readers;
+    for (int i = 0; i < std::min(nReaders, std::max(nFiles, 1)); i++)
+        readers.create_thread(read_files);
+
+    int nLoaded = 0;
+    try {
+        while (nImportFile < nFiles) {
+            CReindexBlock next;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                CReindexFile& importing = mapFiles[nImportFile];
+                while (importing.blocks.empty() && !importing.fDone)
+                    cond.wait(lock);
+                if (importing.blocks.empty()) {
+                    mapFiles.erase(nImportFile++);
+                    cond.notify_all();
+                    continue;
                 }
+                next = std::move(importing.blocks.front());
+                importing.blocks.pop_front();
+                importing.nSize -= next.nSize;
+                nBuffered -= next.nSize;
+                cond.notify_all();
+            }
+
+            try {
+                if (!ImportBlock(chainparams, next.pblock, &next.pos, next.hashPoW.IsNull() ? nullptr : &next.hashPoW, nLoaded))
+                    break;
             } catch (const std::exception& e) {
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
         }
-    } catch (const std::runtime_error& e) {
-        AbortNode(std::string("System error: ") + e.what());
+    } catch (...) {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fStop = true;
+        }
+        cond.notify_all();
+        readers.interrupt_all();
+        readers.join_all();
+        throw;
     }
-    if (nLoaded > 0)
-        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
-    return nLoaded > 0;
+
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = true;
+    }
+    cond.notify_all();
+    readers.join_all();
+
+    LogPrintf("Reindexed %i blocks from %i block files in %dms\n", nLoaded, nFiles, GetTimeMillis() - nStart);
 }
 
 void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
@@ -5725,6 +6881,11 @@ void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
         return;
     }
 
+    // Blocks up to a UTXO snapshot are in the active chain without ever having had data
+    if (pindexSnapshotBlock) {
+        return;
+    }
+
     // Build forward-pointing map of the entire block tree.
     std::multimap<CBlockIndex*,CBlockIndex*> forward;
     for (auto& entry : mapBlockIndex) {
@@ -5923,7 +7084,17 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
     return VersionBitsStateSinceHeight(chainActive.Tip(), params, pos, versionbitscache);
 }
 
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+// Version 2 adds the sigma spends whose proofs were verified at the tip the file was written at
+static const uint64_t MEMPOOL_DUMP_VERSION = 2;
+static const uint64_t MEMPOOL_DUMP_VERSION_NO_SIGMA = 1;
+
+/** Checksum of the sigma section of mempool.dat, which also ties it to the network */
+static uint256 MempoolSigmaChecksum(const uint256& hashTip, const std::vector<uint256>& vSigmaVerified)
+{
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    hasher << FLATDATA(Params().MessageStart()) << hashTip << vSigmaVerified;
+    return hasher.GetHash();
+}
 
 bool LoadMempool(void)
 {
@@ -5940,16 +7111,19 @@ bool LoadMempool(void)
     int64_t expired = 0;
     int64_t failed = 0;
     int64_t already_there = 0;
+    int64_t sigma_known_valid = 0;
     int64_t nNow = GetTime();
 
     try {
         uint64_t version;
         file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
+        if (version != MEMPOOL_DUMP_VERSION && version != MEMPOOL_DUMP_VERSION_NO_SIGMA) {
             return false;
         }
         uint64_t num;
         file >> num;
+        std::vector<std::tuple<CTransactionRef, int64_t, int64_t> > vEntries;
+        vEntries.reserve(std::min<uint64_t>(num, 100000));
         while (num--) {
             CTransactionRef tx;
             int64_t nTime;
@@ -5957,6 +7131,48 @@ bool LoadMempool(void)
             file >> tx;
             file >> nTime;
             file >> nFeeDelta;
+            vEntries.emplace_back(std::move(tx), nTime, nFeeDelta);
+        }
+        std::map<uint256, CAmount> mapDeltas;
+        file >> mapDeltas;
+
+        // the proofs of the sigma spends listed were verified when the file was written, they
+        // can be trusted as long as the anonymity sets are those of the same tip
+        std::set<uint256> setSigmaVerified;
+        if (version == MEMPOOL_DUMP_VERSION) {
+            uint256 hashTip, hashChecksum;
+            std::vector<uint256> vSigmaVerified;
+            file >> hashTip >> vSigmaVerified >> hashChecksum;
+            if (hashChecksum != MempoolSigmaChecksum(hashTip, vSigmaVerified)) {
+                LogPrintf("Sigma section of the mempool file is corrupt, verifying the sigma spends again.\n");
+            } else {
+                LOCK(cs_main);
+                if (chainActive.Tip() && chainActive.Tip()->GetBlockHash() == hashTip)
+                    setSigmaVerified.insert(vSigmaVerified.begin(), vSigmaVerified.end());
+            }
+        }
+
+        // Fill the proof cache for the sigma spends first, on all the script check threads and
+        // without cs_main, so that accepting them below doesn't verify the proofs one by one
+        std::vector<CTransactionRef> vSigmaSpends;
+        for (const auto& entry : vEntries) {
+            if (std::get<0>(entry)->IsSigmaSpend() && std::get<1>(entry) + nExpiryTimeout > nNow)
+                vSigmaSpends.push_back(std::get<0>(entry));
+        }
+        std::atomic<int64_t> nSigmaKnownValid(0);
+        sigma::parallel_for(vSigmaSpends.size(), std::max(nScriptCheckThreads, 1), [&](std::size_t i) {
+            CValidationState state;
+            bool fProofsVerified = setSigmaVerified.count(vSigmaSpends[i]->GetWitnessHash()) != 0;
+            PreVerifySigmaSpend(*vSigmaSpends[i], state, fProofsVerified);
+            if (fProofsVerified)
+                ++nSigmaKnownValid;
+        });
+        sigma_known_valid = nSigmaKnownValid;
+
+        for (const auto& entry : vEntries) {
+            const CTransactionRef& tx = std::get<0>(entry);
+            int64_t nTime = std::get<1>(entry);
+            int64_t nFeeDelta = std::get<2>(entry);
 
             CAmount amountdelta = nFeeDelta;
             if (amountdelta) {
@@ -5986,8 +7202,6 @@ bool LoadMempool(void)
             if (ShutdownRequested())
                 return false;
         }
-        std::map<uint256, CAmount> mapDeltas;
-        file >> mapDeltas;
 
         for (const auto& i : mapDeltas) {
             mempool.PrioritiseTransaction(i.first, i.second);
@@ -5997,7 +7211,7 @@ bool LoadMempool(void)
         return false;
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there\n", count, failed, expired, already_there);
+    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there, %i sigma spends with known valid proofs\n", count, failed, expired, already_there, sigma_known_valid);
     return true;
 }
 
@@ -6007,13 +7221,23 @@ bool DumpMempool(void)
 
     std::map<uint256, CAmount> mapDeltas;
     std::vector<TxMempoolInfo> vinfo;
+    uint256 hashTip;
 
     {
-        LOCK(mempool.cs);
+        LOCK2(cs_main, mempool.cs);
         for (const auto &i : mempool.mapDeltas) {
             mapDeltas[i.first] = i.second;
         }
         vinfo = mempool.infoAll();
+        if (chainActive.Tip())
+            hashTip = chainActive.Tip()->GetBlockHash();
+    }
+
+    // every sigma spend in the mempool had its proofs verified against the anonymity sets of this tip
+    std::vector<uint256> vSigmaVerified;
+    for (const auto& i : vinfo) {
+        if (i.tx->IsSigmaSpend())
+            vSigmaVerified.push_back(i.tx->GetWitnessHash());
     }
 
     int64_t mid = GetTimeMicros();
@@ -6038,6 +7262,7 @@ bool DumpMempool(void)
         }
 
         file << mapDeltas;
+        file << hashTip << vSigmaVerified << MempoolSigmaChecksum(hashTip, vSigmaVerified);
         FileCommit(file.Get());
         file.fclose();
         RenameOver(GetDataDir() / "mempool.dat.new", GetDataDir() / "mempool.dat");
@@ -6050,6 +7275,420 @@ bool DumpMempool(void)
     return true;
 }
 
+static const uint64_t PRIVACY_STATE_DUMP_VERSION = 3;
+
+static const char* PRIVACY_SNAPSHOT_FILE = "privacysnapshot.dat";
+
+// Read the zerocoin and sigma states from a file written at the block hashTip
+static bool ReadPrivacyStateFile(const fs::path& path, const uint256& hashTip)
+{
+    FILE* filestr = fsbridge::fopen(path, "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open privacy state file %s from disk.\n", path.string());
+        return false;
+    }
+
+    CZerocoinState *zerocoinState = CZerocoinState::GetZerocoinState();
+    CSigmaState *sigmaState = CSigmaState::GetSigmaState();
+    try {
+        uint64_t nSize = fs::file_size(path);
+        if (nSize < sizeof(uint256))
+            throw std::runtime_error("file too short");
+
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss.resize(nSize - sizeof(uint256));
+        file.read(ss.data(), ss.size());
+        uint256 hashIn;
+        file >> hashIn;
+        if (hashIn != Hash(ss.begin(), ss.end()))
+            throw std::runtime_error("checksum mismatch");
+
+        uint64_t version;
+        ss >> version;
+        if (version != PRIVACY_STATE_DUMP_VERSION)
+            return false;
+
+        unsigned char pchMsgTmp[4];
+        uint256 hashTipIn;
+        ss >> FLATDATA(pchMsgTmp) >> hashTipIn;
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+            throw std::runtime_error("invalid network magic number");
+        if (hashTipIn != hashTip) {
+            LogPrintf("Privacy state in %s is not at block %s.\n", path.string(), hashTip.ToString());
+            return false;
+        }
+
+        if (!zerocoinState->ReadSnapshot(ss) || !sigmaState->ReadSnapshot(ss))
+            throw std::runtime_error("unknown block");
+    } catch (const std::exception& e) {
+        zerocoinState->Reset();
+        sigmaState->Reset();
+        LogPrintf("Failed to deserialize privacy state in %s: %s.\n", path.string(), e.what());
+        return false;
+    }
+    return true;
+}
+
+// Write the zerocoin and sigma states at the chain tip to a file
+static bool WritePrivacyStateFile(const fs::path& path)
+{
+    int64_t start = GetTimeMicros();
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << PRIVACY_STATE_DUMP_VERSION;
+    ss << FLATDATA(Params().MessageStart()) << chainActive.Tip()->GetBlockHash();
+    CZerocoinState::GetZerocoinState()->WriteSnapshot(ss);
+    CSigmaState::GetSigmaState()->WriteSnapshot(ss);
+    uint256 hash = Hash(ss.begin(), ss.end());
+
+    int64_t mid = GetTimeMicros();
+
+    try {
+        fs::path pathNew = path;
+        pathNew += ".new";
+        FILE* filestr = fsbridge::fopen(pathNew, "wb");
+        if (!filestr) {
+            return false;
+        }
+
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        file.write(ss.data(), ss.size());
+        file << hash;
+        FileCommit(file.Get());
+        file.fclose();
+        RenameOver(pathNew, path);
+        int64_t last = GetTimeMicros();
+        LogPrintf("Dumped privacy state: %gs to copy, %gs to dump\n", (mid-start)*MICRO, (last-mid)*MICRO);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump privacy state: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    return true;
+}
+
+bool LoadPrivacyState()
+{
+    AssertLockHeld(cs_main);
+    if (chainActive.Tip() == nullptr)
+        return false;
+
+    int64_t start = GetTimeMicros();
+
+    if (!ReadPrivacyStateFile(GetDataDir() / "privacystate.dat", chainActive.Tip()->GetBlockHash())) {
+        LogPrintf("Rebuilding the privacy state from the privacy index.\n");
+        return false;
+    }
+
+    LogPrintf("Imported privacy state from disk: %gs\n", (GetTimeMicros()-start)*MICRO);
+    return true;
+}
+
+bool DumpPrivacyState()
+{
+    AssertLockHeld(cs_main);
+    if (chainActive.Tip() == nullptr)
+        return false;
+
+    return WritePrivacyStateFile(GetDataDir() / "privacystate.dat");
+}
+
+// The privacy index of a chainstate loaded from a UTXO snapshot starts after the snapshot block,
+// so the state saved with the snapshot takes the place of the blocks below it
+static bool RebuildPrivacyStateFromSnapshot()
+{
+    AssertLockHeld(cs_main);
+    if (!ReadPrivacyStateFile(GetDataDir() / PRIVACY_SNAPSHOT_FILE, pindexSnapshotBlock->GetBlockHash()))
+        return false;
+
+    CZerocoinState *zerocoinState = CZerocoinState::GetZerocoinState();
+    CSigmaState *sigmaState = CSigmaState::GetSigmaState();
+    int nSnapshotHeight = pindexSnapshotBlock->nHeight;
+    return pprivacyindex->ForEachBlock(chainActive, [&](CBlockIndex *pindex, const CPrivacyBlockData &blockData) {
+        if (pindex->nHeight > nSnapshotHeight) {
+            zerocoinState->AddBlock(pindex, blockData);
+            sigmaState->AddBlock(pindex, blockData);
+        }
+    });
+}
+
+static const uint64_t UTXO_SNAPSHOT_VERSION = 1;
+
+/** What connecting the blocks after a snapshot needs of the snapshot block, beyond its header */
+struct CSnapshotBlockData
+{
+    unsigned int nFlags;
+    uint256 bnStakeModifier;
+    COutPoint prevoutStake;
+    CAmount nMoneySupply;
+    CAmount nGhostedCycleAmount;
+    unsigned int nChainTx;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nFlags);
+        READWRITE(bnStakeModifier);
+        READWRITE(prevoutStake);
+        READWRITE(nMoneySupply);
+        READWRITE(nGhostedCycleAmount);
+        READWRITE(nChainTx);
+    }
+};
+
+bool DumpUTXOSnapshot(const fs::path& path, SnapshotInfo& info, std::string& strError)
+{
+    int64_t start = GetTimeMicros();
+
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    CSnapshotBlockData blockData;
+    std::vector<unsigned char> vPrivacyState;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        CBlockIndex* pindex = chainActive.Tip();
+
+        // The cursor keeps reading the coins as of now, after cs_main is released
+        pcursor.reset(pcoinsdbview->Cursor());
+        if (pcursor->GetBestBlock() != pindex->GetBlockHash()) {
+            strError = "The UTXO set is not at the chain tip";
+            return false;
+        }
+
+        blockData.nFlags = pindex->nFlags;
+        blockData.bnStakeModifier = pindex->bnStakeModifier;
+        blockData.prevoutStake = pindex->prevoutStake;
+        blockData.nMoneySupply = pindex->nMoneySupply;
+        if (!GetGhostedCycleAmount(pindex, blockData.nGhostedCycleAmount)) {
+            strError = "Unable to read the blocks of the ghost fee cycle";
+            return false;
+        }
+        blockData.nChainTx = pindex->nChainTx;
+
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        CZerocoinState::GetZerocoinState()->WriteSnapshot(ss);
+        CSigmaState::GetSigmaState()->WriteSnapshot(ss);
+        vPrivacyState.assign(ss.begin(), ss.end());
+
+        info.hashBlock = pindex->GetBlockHash();
+        info.nHeight = pindex->nHeight;
+        info.nChainTx = pindex->nChainTx;
+    }
+
+    fs::path pathTmp = path;
+    pathTmp += ".incomplete";
+    FILE* filestr = fsbridge::fopen(pathTmp, "wb");
+    if (!filestr) {
+        strError = strprintf("Unable to open %s for writing", pathTmp.string());
+        return false;
+    }
+
+    try {
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        file << UTXO_SNAPSHOT_VERSION << FLATDATA(Params().MessageStart()) << info.hashBlock;
+
+        CHashingWriter<CAutoFile> writer(&file);
+        info.nCoins = 0;
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint outpoint;
+            Coin coin;
+            if (!pcursor->GetKey(outpoint) || !pcursor->GetValue(coin))
+                throw std::runtime_error("unable to read the UTXO set");
+            writer << outpoint << coin;
+            info.nCoins++;
+            pcursor->Next();
+        }
+        // No coin has a null outpoint, it ends the coins
+        writer << COutPoint() << blockData << vPrivacyState;
+        info.hashSnapshot = writer.GetHash();
+
+        file << info.hashSnapshot;
+        FileCommit(file.Get());
+        file.fclose();
+        RenameOver(pathTmp, path);
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to write the snapshot: %s", e.what());
+        return false;
+    }
+
+    LogPrintf("Dumped UTXO snapshot of %u coins at block %s: %gs\n", info.nCoins, info.hashBlock.ToString(), (GetTimeMicros()-start)*MICRO);
+    return true;
+}
+
+// A snapshot committed in the chain parameters can be loaded by a node without blocks past the
+// genesis block, once it has the headers up to the snapshot block
+static bool CheckSnapshotBlock(const uint256& hashBlock, CBlockIndex*& pindex, SnapshotData& snapshot, std::string& strError)
+{
+    AssertLockHeld(cs_main);
+    if (pindexSnapshotBlock) {
+        strError = "A UTXO snapshot was loaded already";
+        return false;
+    }
+    if (chainActive.Height() != 0) {
+        strError = "Only a node without blocks past the genesis block can load a UTXO snapshot";
+        return false;
+    }
+    if (fTxIndex || fAddressIndex || fSpentIndex || fTimestampIndex || fDelegationIndex) {
+        strError = "The transaction, address, spent, timestamp and delegation indexes can't be built from a UTXO snapshot";
+        return false;
+    }
+
+    BlockMap::iterator it = mapBlockIndex.find(hashBlock);
+    if (it == mapBlockIndex.end() || !it->second->IsValid(BLOCK_VALID_TREE)) {
+        strError = strprintf("The headers up to the snapshot block %s are not known yet", hashBlock.ToString());
+        return false;
+    }
+    pindex = it->second;
+
+    MapSnapshots::const_iterator itSnapshot = Params().Snapshots().find(pindex->nHeight);
+    if (itSnapshot == Params().Snapshots().end() || itSnapshot->second.hashBlock != hashBlock) {
+        strError = strprintf("No snapshot at block %s is committed in the chain parameters", hashBlock.ToString());
+        return false;
+    }
+    snapshot = itSnapshot->second;
+    return true;
+}
+
+// Read through a snapshot, adding its coins to pcoinsTip if fLoad
+static bool ReadUTXOSnapshot(const fs::path& path, bool fLoad, SnapshotInfo& info, CSnapshotBlockData& blockData, std::vector<unsigned char>& vPrivacyState, std::string& strError)
+{
+    FILE* filestr = fsbridge::fopen(path, "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strError = strprintf("Unable to open %s", path.string());
+        return false;
+    }
+
+    try {
+        uint64_t nVersion;
+        unsigned char pchMsgTmp[4];
+        file >> nVersion >> FLATDATA(pchMsgTmp) >> info.hashBlock;
+        if (nVersion != UTXO_SNAPSHOT_VERSION) {
+            strError = strprintf("Unsupported snapshot version %u", nVersion);
+            return false;
+        }
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
+            strError = "The snapshot is of another network";
+            return false;
+        }
+
+        CHashVerifier<CAutoFile> verifier(&file);
+        info.nCoins = 0;
+        while (true) {
+            boost::this_thread::interruption_point();
+            COutPoint outpoint;
+            verifier >> outpoint;
+            if (outpoint.IsNull())
+                break;
+            Coin coin;
+            verifier >> coin;
+            info.nCoins++;
+            if (!fLoad)
+                continue;
+
+            pcoinsTip->AddCoin(outpoint, std::move(coin), true);
+            if (info.nCoins % 100000 == 0 && pcoinsTip->DynamicMemoryUsage() > nCoinCacheUsage) {
+                pcoinsTip->SetBestBlock(info.hashBlock);
+                if (!pcoinsTip->Flush())
+                    throw std::runtime_error("failed to write to the coin database");
+            }
+        }
+        verifier >> blockData >> vPrivacyState;
+        info.hashSnapshot = verifier.GetHash();
+
+        uint256 hashIn;
+        file >> hashIn;
+        if (hashIn != info.hashSnapshot) {
+            strError = "Checksum mismatch, the snapshot is corrupted";
+            return false;
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to read the snapshot: %s", e.what());
+        return false;
+    }
+    return true;
+}
+
+bool LoadUTXOSnapshot(const fs::path& path, SnapshotInfo& info, std::string& strError)
+{
+    int64_t start = GetTimeMicros();
+
+    CBlockIndex* pindex;
+    SnapshotData snapshot;
+    CSnapshotBlockData blockData;
+    std::vector<unsigned char> vPrivacyState;
+
+    // A first pass checks the snapshot against the hash committed for its block, before the
+    // chainstate is touched
+    if (!ReadUTXOSnapshot(path, false, info, blockData, vPrivacyState, strError))
+        return false;
+    {
+        LOCK(cs_main);
+        if (!CheckSnapshotBlock(info.hashBlock, pindex, snapshot, strError))
+            return false;
+    }
+    if (info.hashSnapshot != snapshot.hashSnapshot) {
+        strError = strprintf("The snapshot hash %s does not match the hash committed for block %s", info.hashSnapshot.ToString(), info.hashBlock.ToString());
+        return false;
+    }
+
+    LOCK(cs_main);
+    if (!CheckSnapshotBlock(info.hashBlock, pindex, snapshot, strError))
+        return false;
+
+    // Cleared once the chainstate is complete, an interrupted load refuses to start without -reindex
+    if (!pblocktree->WriteFlag("loadingsnapshot", true)) {
+        strError = "Failed to write to the block index database";
+        return false;
+    }
+    if (!ReadUTXOSnapshot(path, true, info, blockData, vPrivacyState, strError) || info.hashSnapshot != snapshot.hashSnapshot) {
+        strError = strprintf("The snapshot changed while it was loaded, restart with -reindex: %s", strError);
+        return false;
+    }
+    pcoinsTip->SetBestBlock(info.hashBlock);
+    if (!pcoinsTip->Flush() || !pcoinsdbview->WaitForFlush()) {
+        strError = "Failed to write to the coin database, restart with -reindex";
+        return false;
+    }
+
+    CDataStream ss(vPrivacyState, SER_DISK, CLIENT_VERSION);
+    if (!CZerocoinState::GetZerocoinState()->ReadSnapshot(ss) || !CSigmaState::GetSigmaState()->ReadSnapshot(ss)) {
+        strError = "The privacy state of the snapshot refers to unknown blocks, restart with -reindex";
+        return false;
+    }
+
+    // Blocks on top of the snapshot block link to it as if it had been connected
+    pindex->nFlags = blockData.nFlags;
+    pindex->bnStakeModifier = blockData.bnStakeModifier;
+    pindex->prevoutStake = blockData.prevoutStake;
+    pindex->nMoneySupply = blockData.nMoneySupply;
+    pindex->nGhostedCycleAmount = blockData.nGhostedCycleAmount;
+    pindex->nStatus |= BLOCK_GHOSTED_AMOUNT;
+    pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
+    pindex->nChainTx = snapshot.nChainTx;
+    setDirtyBlockIndex.insert(pindex);
+
+    pindexSnapshotBlock = pindex;
+    g_chainstate.ActivateSnapshotBlock(pindex);
+
+    if (!pblocktree->WriteSnapshotBlock(info.hashBlock, snapshot.nChainTx) || !WritePrivacyStateFile(GetDataDir() / PRIVACY_SNAPSHOT_FILE)) {
+        strError = "Failed to save the snapshot block, restart with -reindex";
+        return false;
+    }
+    FlushStateToDisk();
+    pblocktree->WriteFlag("loadingsnapshot", false);
+
+    info.nHeight = pindex->nHeight;
+    info.nChainTx = snapshot.nChainTx;
+    GetMainSignals().UpdatedBlockTip(pindex, nullptr, IsInitialBlockDownload());
+    uiInterface.NotifyBlockTip(IsInitialBlockDownload(), pindex);
+
+    LogPrintf("Loaded UTXO snapshot of %u coins at block %s (height %d): %gs\n", info.nCoins, info.hashBlock.ToString(), info.nHeight, (GetTimeMicros()-start)*MICRO);
+    return true;
+}
+
 //! Guess how far we are in the verification process at the given block index
 double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex *pindex) {
     if (pindex == nullptr)
@@ -6115,3 +7754,49 @@ bool CoinStakeCache::InsertCoinStake(const uint256 &blockHash, const CTransactio
 
     return true;
 }
+
+bool StakeKernelCache::GetOrigin(const COutPoint &prevout, CTxOut &out, uint32_t &nBlockTime)
+{
+    Origin origin;
+    auto it = mapData.find(prevout);
+    if (it != mapData.end()) {
+        origin = it->second;
+    } else {
+        // Coins spent by recent blocks in pruned mode, their blocks may be gone already
+        CKernelOrigin diskOrigin;
+        if (!fPruneMode || !pblocktree->ReadKernelOrigin(prevout, diskOrigin))
+            return false;
+        origin.out = diskOrigin.out;
+        origin.nBlockTime = diskOrigin.nBlockTime;
+        origin.hashBlock = diskOrigin.hashBlock;
+    }
+
+    // Only trust origins still in the active chain, as GetTransaction would return
+    BlockMap::iterator mi = mapBlockIndex.find(origin.hashBlock);
+    if (mi == mapBlockIndex.end() || !chainActive.Contains(mi->second))
+        return false;
+
+    out = origin.out;
+    nBlockTime = origin.nBlockTime;
+    return true;
+}
+
+void StakeKernelCache::InsertOrigin(const COutPoint &prevout, const CTxOut &out, const CBlockIndex *pindex)
+{
+    if (!pindex)
+        return;
+
+    Origin origin;
+    origin.out = out;
+    origin.nBlockTime = pindex->GetBlockTime();
+    origin.hashBlock = pindex->GetBlockHash();
+    if (!mapData.insert(std::make_pair(prevout, origin)).second)
+        return;
+    lOrder.push_back(prevout);
+
+    while (lOrder.size() > nMaxSize)
+    {
+        mapData.erase(lOrder.front());
+        lOrder.pop_front();
+    }
+}
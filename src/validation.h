@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <exception>
 #include <map>
+#include <functional>
 #include <set>
 #include <stdint.h>
 #include <string>
@@ -35,10 +36,12 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CChainParams;
 class CCoinsViewDB;
 class CInv;
 class CConnman;
+class CPrivacyIndexDB;
 class CScriptCheck;
 class CBlockPolicyEstimator;
 class CTxMemPool;
@@ -73,6 +76,9 @@ static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 336;
 /** Maximum kilobytes for transactions to store for processing during reorg */
 static const unsigned int MAX_DISCONNECTED_TX_POOL_SIZE = 20000;
+/** Blocks this close to the tip remember their script checks, a reorg disconnecting them puts their
+ *  transactions back in the mempool without running the scripts again */
+static const unsigned int SHORT_REORG_DEPTH = 3;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -84,6 +90,20 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of blocks read and pre-verified ahead of the chain tip while connecting */
+static const unsigned int MAX_BLOCKS_PREFETCH = 16;
+/** Number of recently read blocks kept deserialized in memory */
+static const unsigned int MAX_DECODED_BLOCK_CACHE = 16;
+/** Number of block files kept memory-mapped for reading */
+static const unsigned int MAX_MAPPED_BLOCK_FILES = 4;
+/** Number of headers whose proof of work hashes are computed as one batch */
+static const size_t POW_HASH_BATCH_SIZE = 8;
+/** -reindexreaders default (number of block files read at once during -reindex, 0 = auto) */
+static const int DEFAULT_REINDEX_READERS = 0;
+/** Maximum number of -reindex reader threads */
+static const int MAX_REINDEX_READERS = 8;
+/** Serialized size of the blocks -reindex readers may hold ahead of the block file being imported */
+static const uint64_t REINDEX_READ_AHEAD_SIZE = 64 << 20;
 /** Number of blocks that can be requested at any given time from a single peer (x4 from btc). */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16 * TIME_MULTIPLIER;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -134,6 +154,10 @@ static const int64_t MAX_FEE_ESTIMATION_TIP_AGE = 3 * 60 * 60;
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = true;
+/** Default for -compressblocks */
+static const bool DEFAULT_COMPRESS_BLOCKS = false;
+/** Set in the size in front of a block in a blk?????.dat file when the block is stored LZ4 compressed */
+static const unsigned int BLOCK_RECORD_COMPRESSED = 0x80000000;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
@@ -156,6 +180,8 @@ static const int DEFAULT_STOPATHEIGHT = 0;
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_ADDRESSINDEX = false;
 static const bool DEFAULT_SPENTINDEX = false;
+static const bool DEFAULT_ADDRESSBALANCEINDEX = false;
+static const bool DEFAULT_DELEGATIONINDEX = false;
 static const bool DEFAULT_DATAINDEX = false;
 
 struct BlockHasher
@@ -188,6 +214,26 @@ public:
     bool InsertCoinStake(const uint256 &blockHash, const CTransactionRef &tx);
 };
 
+/** Cache origins of recently seen coinstake inputs, so a competing or reorged block
+ *  staking an output spent in the active chain does not need a disk read */
+class StakeKernelCache
+{
+public:
+    struct Origin
+    {
+        CTxOut out;
+        uint32_t nBlockTime;
+        uint256 hashBlock;
+    };
+
+    size_t nMaxSize = 5000;
+    std::unordered_map<COutPoint, Origin, SaltedOutpointHasher> mapData;
+    std::list<COutPoint> lOrder;
+
+    bool GetOrigin(const COutPoint &prevout, CTxOut &out, uint32_t &nBlockTime);
+    void InsertOrigin(const COutPoint &prevout, const CTxOut &out, const CBlockIndex *pindex);
+};
+
 /*************************/
 /****NIX OP_DATA Flag*****/
 extern bool fDataIndex;
@@ -196,6 +242,7 @@ extern bool fDataIndex;
 
 extern std::map<uint256, StakeConflict> mapStakeConflict;
 extern CoinStakeCache coinStakeCache;
+extern StakeKernelCache stakeKernelCache;
 
 extern CScript COINBASE_FLAGS;
 extern CCriticalSection cs_main;
@@ -211,12 +258,21 @@ extern uint64_t nLastBlockSize;
 extern const std::string strMessageMagic;
 extern CWaitableCriticalSection csBestBlock;
 extern CConditionVariable cvBlockChange;
+/** Wake the waiters on cvBlockChange after something they may watch changed without a new tip,
+ *  such as the active ghostnode state, the staking state or the ghostnode paid by the next block */
+void NotifyStateChange();
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+//! Whether new blocks are written to the block files compressed
+extern bool fCompressBlocks;
 extern bool fAddressIndex;
 extern bool fSpentIndex;
+//! Per address balance checkpoints, only kept along with the address index
+extern bool fAddressBalanceIndex;
+//! Unspent conditional stake outputs by the address delegated to stake them
+extern bool fDelegationIndex;
 extern bool fTimestampIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
@@ -241,6 +297,9 @@ extern arith_uint256 nMinimumChainWork;
 /** Best header we've seen so far (used for getheaders queries' starting points). */
 extern CBlockIndex *pindexBestHeader;
 
+/** Block the chainstate was loaded from a UTXO snapshot at, nullptr if it was built from the genesis block. */
+extern CBlockIndex *pindexSnapshotBlock;
+
 /** Minimum disk space required - used in CheckDiskSpace() */
 static const uint64_t nMinDiskSpace = 52428800;
 
@@ -317,6 +376,8 @@ FILE* OpenBlockFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 fs::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = nullptr);
+/** Import the blk?????.dat files on disk for -reindex, reading and hashing nReaders files at once */
+void ReindexBlockFiles(const CChainParams& chainparams, int nReaders);
 /** Ensures we have a genesis block in the block tree, possibly writing one to disk. */
 bool LoadGenesisBlock(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk,
@@ -328,6 +389,12 @@ bool LoadChainTip(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run the given script checks on the script checking threads, true when all of them pass */
+bool RunScriptChecks(std::vector<CScriptCheck>& vChecks);
+/** Start the threads reading and pre-verifying blocks ahead of ConnectTip */
+void StartBlockPrefetchThreads(int nThreads);
+/** Stop the block prefetch threads and drop any prefetched blocks */
+void StopBlockPrefetchThreads();
 /** Return the average number of blocks that other nodes claim to have */
 int GetNumBlocksOfPeers();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
@@ -453,16 +520,42 @@ void InitScriptExecutionCache();
 
 /** Insight functions */
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes);
+/** Streaming variant of the above, see CBlockTreeDB::ScanTimestampIndex */
+bool ScanTimestampIndex(unsigned int high, unsigned int low, bool fReverse,
+                        const std::function<bool(const CTimestampIndexKey&)>& visit);
+/** Logical timestamp the timestamp index keeps for a block */
+bool GetTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp);
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(uint256 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                      int start = 0, int end = 0);
 bool GetAddressUnspent(uint256 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+/** Streaming variants of the above, see CBlockTreeDB::ScanAddressIndex */
+bool ScanAddressIndex(uint256 addressHash, int type,
+                      const std::function<bool(const CAddressIndexKey&, CAmount)>& visit,
+                      int start = 0, int end = 0, const CAddressIndexKey* pAfter = nullptr);
+/** Balance and total received of an address after the block at nHeight, requires -addressbalanceindex */
+bool GetAddressBalance(uint256 addressHash, int type, int nHeight, CAddressBalanceValue &value);
+bool ScanAddressUnspent(uint256 addressHash, int type,
+                        const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& visit,
+                        const CAddressUnspentKey* pAfter = nullptr);
+/** Unspent conditional stake outputs delegated to a staker address, requires -delegationindex */
+bool ScanDelegatedUnspent(uint256 addressHash, int type,
+                          const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& visit,
+                          const CAddressUnspentKey* pAfter = nullptr);
 
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
+/** Reads the block of pindex stored at pos without taking cs_main, checking its PoW against the cached hash of pindex */
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** As above, sharing the decoded block with the recently read block cache instead of copying it */
+bool ReadBlockFromDisk(std::shared_ptr<const CBlock>& pblock, const CDiskBlockPos& pos, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+bool ReadBlockFromDisk(std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** The serialized block stored at pos, which is also its witness serialization on the wire */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -511,12 +604,21 @@ bool PreciousBlock(CValidationState& state, const CChainParams& params, CBlockIn
 /** Mark a block as invalid. */
 bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, CBlockIndex *pindex);
 
+/** Disconnect the active chain down to pindex without marking anything, the next ActivateBestChain reconnects it. */
+bool DisconnectBlocksTo(CValidationState& state, const CChainParams& chainparams, CBlockIndex *pindex);
+
 /** Remove invalidity status from a block and its descendants. */
 bool ResetBlockFailureFlags(CBlockIndex *pindex);
 
 /** The currently-connected chain of blocks (protected by cs_main). */
 extern CChain& chainActive;
 
+/**
+ * chainActive as of the last tip update, for readers that do not hold cs_main.
+ * The snapshot never changes, it is replaced as a whole whenever the tip moves.
+ */
+std::shared_ptr<const CChainSnapshot> GetChainSnapshot();
+
 /** Global variable that points to the coins database (protected by cs_main) */
 extern std::unique_ptr<CCoinsViewDB> pcoinsdbview;
 
@@ -526,6 +628,9 @@ extern std::unique_ptr<CCoinsViewCache> pcoinsTip;
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern std::unique_ptr<CBlockTreeDB> pblocktree;
 
+/** Global variable that points to the zerocoin and sigma data of the blocks (protected by cs_main) */
+extern std::unique_ptr<CPrivacyIndexDB> pprivacyindex;
+
 /**
  * Return the spend height, which is one more than the inputs.GetBestBlock().
  * While checking, GetBestBlock() refers to the parent block. (protected by cs_main)
@@ -557,4 +662,25 @@ bool DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/** Dump the zerocoin and sigma states at the chain tip to disk. */
+bool DumpPrivacyState();
+
+/** Load the zerocoin and sigma states from disk, returns false if they are not at the chain tip. */
+bool LoadPrivacyState();
+
+/** Where a UTXO snapshot was taken and what it holds */
+struct SnapshotInfo {
+    uint256 hashBlock;
+    int nHeight = 0;
+    uint64_t nCoins = 0;
+    uint256 hashSnapshot;
+    unsigned int nChainTx = 0;
+};
+
+/** Write the UTXO set, the zerocoin and sigma states and the ghost fee cycle at the chain tip to a snapshot. */
+bool DumpUTXOSnapshot(const fs::path& path, SnapshotInfo& info, std::string& strError);
+
+/** Load a snapshot committed in the chain parameters as the chainstate of a node without blocks past the genesis block. */
+bool LoadUTXOSnapshot(const fs::path& path, SnapshotInfo& info, std::string& strError);
+
 #endif // BITCOIN_VALIDATION_H
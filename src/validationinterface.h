@@ -78,6 +78,14 @@ protected:
      * Called on a background thread.
      */
     virtual void TransactionRemovedFromMempool(const CTransactionRef &ptx) {}
+    /**
+     * Notifies listeners of every mempool addition (fAdded) and removal,
+     * whatever the reason, with the mempool sequence number of the change.
+     * Sequence numbers arrive in increasing order without gaps.
+     *
+     * Called on a background thread.
+     */
+    virtual void MempoolSequence(const CTransactionRef &ptx, bool fAdded, MemPoolRemovalReason reason, uint64_t nSequence) {}
     /**
      * Notifies listeners of a block being connected.
      * Provides a vector of transactions evicted from the mempool as a result.
@@ -116,6 +124,18 @@ protected:
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
+    /**
+     * Notifies listeners of a transaction getting locked by InstantSend.
+     *
+     * Called on a background thread.
+     */
+    virtual void NotifyTransactionLock(const CTransactionRef &ptx) {}
+    /**
+     * Notifies listeners of a ghostnode entering a new state, one of the GHOSTNODE_* states.
+     *
+     * Called on a background thread.
+     */
+    virtual void NotifyGhostnodeState(const COutPoint &outpoint, int nState) {}
     friend void ::RegisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
@@ -131,7 +151,8 @@ private:
     friend void ::UnregisterAllValidationInterfaces();
     friend void ::CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
 
-    void MempoolEntryRemoved(CTransactionRef tx, MemPoolRemovalReason reason);
+    void MempoolEntryAdded(CTransactionRef tx, uint64_t nSequence);
+    void MempoolEntryRemoved(CTransactionRef tx, MemPoolRemovalReason reason, uint64_t nSequence);
 
 public:
     /** Register a CScheduler to give callbacks which should run in the background (may only be called once) */
@@ -157,6 +178,8 @@ public:
     void Broadcast(int64_t nBestBlockTime, CConnman* connman);
     void BlockChecked(const CBlock&, const CValidationState&);
     void NewPoWValidBlock(const CBlockIndex *, const std::shared_ptr<const CBlock>&);
+    void NotifyTransactionLock(const CTransactionRef &);
+    void NotifyGhostnodeState(const COutPoint &, int nState);
 };
 
 CMainSignals& GetMainSignals();
@@ -17,9 +17,11 @@
 #include <wallet/wallet.h>
 #include <wallet/coincontrol.h>
 #include <ghostnode/ghostnodeman.h>
+#include <sigma/coin.h>
 
 #include <fs.h>
 
+#include <algorithm>
 #include <atomic>
 #include <stdint.h>
 #include <thread>
@@ -65,7 +67,7 @@ void ShutdownThreadAutoGhoster()
 void WakeThreadAutoGhoster(CWallet *pwallet)
 {
     // Call when chain is synced, wallet unlocked or balance changed
-    LogPrintf("WakeThreadStakeMiner thread %d\n", pwallet->nAutoGhosterThread);
+    LogPrint(BCLog::GHOST, "WakeThreadAutoGhoster thread %d\n", pwallet->nAutoGhosterThread);
     if (pwallet->nAutoGhosterThread >= vAutoGhosterThreads.size())
         return;
     AutoGhosterThread *t = vAutoGhosterThreads[pwallet->nAutoGhosterThread];
@@ -77,6 +79,28 @@ void WakeThreadAutoGhoster(CWallet *pwallet)
     t->condGhostProc.notify_all();
 }
 
+CAmount PlanAutoGhostMint(CAmount nEligible)
+{
+    // leave the 0.25% mint fee, as nEligible * 0.9975
+    CAmount nRemaining = nEligible - nEligible / 400;
+
+    // the denominations are powers of ten, so taking the largest ones first
+    // gives the fewest mints
+    std::vector<sigma::CoinDenomination> denominations;
+    sigma::GetAllDenoms(denominations);
+    CAmount nMint = 0;
+    int nMints = 0;
+    for (sigma::CoinDenomination denomination : denominations) {
+        CAmount nValue;
+        sigma::DenominationToInteger(denomination, nValue);
+        int nCount = std::min<CAmount>(nRemaining / nValue, MAX_AUTOGHOST_MINTS - nMints);
+        nMint += nCount * nValue;
+        nRemaining -= nCount * nValue;
+        nMints += nCount;
+    }
+    return nMint;
+}
+
 bool ThreadAutoGhosterStopped()
 {
     return fStopGhostProc;
@@ -99,7 +123,6 @@ void ThreadAutoGhoster(size_t nThreadID, std::vector<CWalletRef> &vpwallets, siz
     };
 
     std::vector<std::string> blacklistAddr;
-    blacklistAddr.clear();
     std::string blacklistAddresses = gArgs.GetArg("-autoghostblacklist", "");
 
     char sep = ',';
@@ -110,21 +133,24 @@ void ThreadAutoGhoster(size_t nThreadID, std::vector<CWalletRef> &vpwallets, siz
         b = e;
     }
 
-    for(auto addr: blacklistAddr)
-        LogPrintf("\n%s", addr);
+    std::vector<CTxDestination> vBlacklist;
+    for(const std::string& addr: blacklistAddr) {
+        LogPrintf("%s: blacklisted %s\n", __func__, addr);
+        vBlacklist.push_back(DecodeDestination(addr));
+    }
 
     while (!fStopGhostProc)
     {
         if (fReindex || fImporting)
         {
-            LogPrintf("%s: Block import/reindex.\n", __func__);
+            LogPrint(BCLog::GHOST, "%s: Block import/reindex.\n", __func__);
             condWaitFor(nThreadID, 15000);
             continue;
         };
 
         if (g_connman->vNodes.empty() || IsInitialBlockDownload())
         {
-            LogPrintf("%s: IsInitialBlockDownload\n", __func__);
+            LogPrint(BCLog::GHOST, "%s: IsInitialBlockDownload\n", __func__);
             condWaitFor(nThreadID, 15000);
             continue;
         }
@@ -132,7 +158,7 @@ void ThreadAutoGhoster(size_t nThreadID, std::vector<CWalletRef> &vpwallets, siz
 
         if (nTimeLastGhosted + nGhostSleep > GetTime())
         {
-            LogPrintf("%s: timer not expired yet %llf\n", __func__, nGhostSleep);
+            LogPrint(BCLog::GHOST, "%s: timer not expired yet %d\n", __func__, nGhostSleep);
             int64_t waitFor = nTimeLastGhosted + nGhostSleep - GetTime();
             condWaitFor(nThreadID, waitFor * 1000);
             continue;
@@ -147,7 +173,7 @@ void ThreadAutoGhoster(size_t nThreadID, std::vector<CWalletRef> &vpwallets, siz
             if (pwallet->IsLocked())
             {
                 pwallet->nIsAutoGhosting = CWallet::NOT_GHOSTING_LOCKED;
-                LogPrintf("%s: wallet locked, check again in 10 seconds\n", __func__);
+                LogPrint(BCLog::GHOST, "%s: wallet locked, check again in 10 seconds\n", __func__);
                 condWaitFor(nThreadID, 10000);
                 isWalletLocked = true;
                 continue;
@@ -156,58 +182,49 @@ void ThreadAutoGhoster(size_t nThreadID, std::vector<CWalletRef> &vpwallets, siz
             std::vector<COutput> vecOutputs;
             std::vector<COutPoint> vLockedOutpts;
             LOCK2(cs_main, pwallet->cs_wallet);
-            //minimum amount we can ghost (0.1 denom * 0.25% fee)
-            CAmount minGhostAmount = (0.1 * COIN);
-            minGhostAmount += (minGhostAmount * 0.0025);
             pwallet->AvailableCoins(vecOutputs);
             pwallet->ListLockedCoins(vLockedOutpts);
             pwallet->nIsAutoGhosting = CWallet::NOT_GHOSTING;
             // shuffle the outputs
             std::random_shuffle(vecOutputs.begin(), vecOutputs.end());
+
+            // ghost all eligible outputs at once, up to what fits one transaction
+            std::vector<COutPoint> vInputs;
+            CAmount nEligible = 0;
             for (const COutput& out : vecOutputs) {
+                if (vInputs.size() >= MAX_AUTOGHOST_INPUTS)
+                    break;
                 COutPoint selectedInput(out.tx->tx->GetHash(), out.i);
                 // check if we have enought to maintain the min amount
-                if(out.tx->tx->vout[out.i].nValue < minGhostAmount)
+                if(out.tx->tx->vout[out.i].nValue < MIN_AUTOGHOST_AMOUNT)
                     continue;
 
                 // do not spend locked coins, choose another output
-                bool isLocked = false;
-                for(const COutPoint& ind : vLockedOutpts){
-                    if(selectedInput.n == ind.n && selectedInput.hash == ind.hash){
-                        isLocked = true;
-                        break;
-                    }
-                }
+                if (std::find(vLockedOutpts.begin(), vLockedOutpts.end(), selectedInput) != vLockedOutpts.end())
+                    continue;
 
                 CTxDestination address;
                 const CScript& scriptPubKey = out.tx->tx->vout[out.i].scriptPubKey;
-                if(ExtractDestination(scriptPubKey, address)){
-                    for(const std::string addr: blacklistAddr){
-                        CTxDestination blacklistDest = DecodeDestination(addr);
-                        if(blacklistDest == address){
-                            isLocked = true;
-                        }
-                    }
-                } else {
+                if(!ExtractDestination(scriptPubKey, address))
+                    continue;
+                if (std::find(vBlacklist.begin(), vBlacklist.end(), address) != vBlacklist.end())
                     continue;
-                }
-
-                if(!isLocked){
-                    pwallet->nIsAutoGhosting = CWallet::IS_GHOSTING;
-                    g_coincontrol.SetNull();
-                    g_coincontrol.Select(selectedInput);
-                    double decAmount = (double(out.tx->tx->vout[out.i].nValue)/COIN) * 0.9975;
-                    decAmount = (double)((int)(decAmount*10))/10;
-                    std::ostringstream strs;
-                    strs << decAmount;
-                    std::string decString = strs.str();
-                    LogPrintf("Starting GhostModeMintSigma for %llf %s.\n", decAmount, decString);
-                    // if it does not work, try again
-                    if(pwallet->GhostModeMintSigma(decString))
-                        break;
-                }
 
+                vInputs.push_back(selectedInput);
+                nEligible += out.tx->tx->vout[out.i].nValue;
             }
+
+            CAmount nMint = PlanAutoGhostMint(nEligible);
+            if (nMint == 0)
+                continue;
+
+            pwallet->nIsAutoGhosting = CWallet::IS_GHOSTING;
+            g_coincontrol.SetNull();
+            for (const COutPoint& input : vInputs)
+                g_coincontrol.Select(input);
+            LogPrint(BCLog::GHOST, "%s: ghosting %s from %u outputs\n", __func__, FormatMoney(nMint), vInputs.size());
+            if (!pwallet->GhostModeMintSigma(FormatMoney(nMint)))
+                g_coincontrol.SetNull();
         };
 
         if(!isWalletLocked){
@@ -215,7 +232,7 @@ void ThreadAutoGhoster(size_t nThreadID, std::vector<CWalletRef> &vpwallets, siz
             nGhostSleep = (60 + GetRandInt(300));
             // set last ghosted to now
             nTimeLastGhosted = GetTime();
-            LogPrintf("ThreadAutoGhoster sleeping for %llf.\n", nGhostSleep);
+            LogPrint(BCLog::GHOST, "ThreadAutoGhoster sleeping for %d.\n", nGhostSleep);
             // sleep for timer length
             condWaitFor(nThreadID, nGhostSleep * 1000);
         }
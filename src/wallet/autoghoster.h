@@ -1,6 +1,7 @@
 #ifndef NIX_AUTOGHOSTER_H
 #define NIX_AUTOGHOSTER_H
 
+#include <amount.h>
 #include <primitives/block.h>
 #include <thread>
 #include <condition_variable>
@@ -22,6 +23,20 @@ public:
     bool fWakeGhostProc = false;
 };
 
+//! Smallest output autoghost spends, the smallest denomination plus its 0.25% mint fee
+static const CAmount MIN_AUTOGHOST_AMOUNT = COIN / 10 + COIN / 4000;
+//! Most outputs one autoghost mint transaction spends
+static const size_t MAX_AUTOGHOST_INPUTS = 100;
+//! Most sigma mints one autoghost mint transaction creates
+static const int MAX_AUTOGHOST_MINTS = 100;
+
+/**
+ * Amount to ghost out of nEligible in one mint transaction: what is left after the
+ * mint fee, in the fewest sigma denominations and at most MAX_AUTOGHOST_MINTS of them.
+ * Whatever does not fit stays as change for the next round.
+ */
+CAmount PlanAutoGhostMint(CAmount nEligible);
+
 extern std::vector<AutoGhosterThread*> vAutoGhosterThreads;
 extern int64_t nGhostSleep;
 
@@ -34,6 +34,8 @@ public:
     bool signalRbf;
     //! Fee estimation mode to control arguments to estimateSmartFee
     FeeEstimateMode m_fee_mode;
+    //! Kind of transactions to estimate the fee from, privacy transactions pay their ghost protocol fee on top
+    FeeEstimateTrack m_fee_track;
 
     CCoinControl()
     {
@@ -52,6 +54,7 @@ public:
         m_confirm_target.reset();
         signalRbf = fWalletRbf;
         m_fee_mode = FeeEstimateMode::UNSET;
+        m_fee_track = FeeEstimateTrack::STANDARD;
     }
 
     bool HasSelected() const
@@ -171,6 +171,7 @@ bool CCryptoKeyStore::Lock()
     {
         LOCK(cs_KeyStore);
         vMasterKey.clear();
+        mapDecryptedKeys.clear();
         vpwallets[0]->GetGhostWallet()->Lock();
     }
 
@@ -187,7 +188,12 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
         bool keyPass = false;
         bool keyFail = false;
 
+        // Checking every key takes seconds for a large wallet. A sample spread over the
+        // keys catches a wrong master key or a corrupted wallet, the others are checked
+        // against their public key by GetKey when they are used.
+        size_t nStep = std::max<size_t>(1, mapCryptedKeys.size() / WALLET_UNLOCK_CHECKED_KEYS);
         size_t nTries = 0;
+        size_t nKey = 0;
         CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin();
         for (; mi != mapCryptedKeys.end(); ++mi)
         {
@@ -196,6 +202,8 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
 
             if (vchCryptedSecret.size() == 0) // unexpanded key received on stealth address
                 continue;
+            if (nKey++ % nStep != 0)
+                continue;
 
             nTries++;
             CKey key;
@@ -216,6 +224,7 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
         if (keyFail || (!keyPass && nTries > 0))
             return false;
         vMasterKey = vMasterKeyIn;
+        mapDecryptedKeys.clear();
         fDecryptionThoroughlyChecked = true;
 
         uint256 hashSeed;
@@ -271,6 +280,8 @@ bool CCryptoKeyStore::AddCryptedKey(const CPubKey &vchPubKey, const std::vector<
     }
 
     mapCryptedKeys[vchPubKey.GetID()] = make_pair(vchPubKey, vchCryptedSecret);
+    mapDecryptedKeys.erase(vchPubKey.GetID());
+    KeyStoreAdded(ToByteVector(vchPubKey.GetID()));
     ImplicitlyLearnRelatedKeyScripts(vchPubKey);
     return true;
 }
@@ -304,12 +315,26 @@ bool CCryptoKeyStore::GetKey(const CKeyID &address, CKey& keyOut) const
         return CBasicKeyStore::GetKey(address, keyOut);
     }
 
+    // Decrypting and checking a key against its public key costs an EC multiplication,
+    // keys used while unlocked (e.g. for staking) are only decrypted once
+    std::map<CKeyID, CKey>::const_iterator it = mapDecryptedKeys.find(address);
+    if (it != mapDecryptedKeys.end()) {
+        keyOut = it->second;
+        return true;
+    }
+
     CryptedKeyMap::const_iterator mi = mapCryptedKeys.find(address);
     if (mi != mapCryptedKeys.end())
     {
         const CPubKey &vchPubKey = (*mi).second.first;
         const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
-        return DecryptKey(vMasterKey, vchCryptedSecret, vchPubKey, keyOut);
+        if (!DecryptKey(vMasterKey, vchCryptedSecret, vchPubKey, keyOut)) {
+            if (!vMasterKey.empty() && !vchCryptedSecret.empty())
+                LogPrintf("%s: key %s does not decrypt, the wallet is probably corrupted\n", __func__, address.ToString());
+            return false;
+        }
+        mapDecryptedKeys.emplace(address, keyOut);
+        return true;
     }
     return false;
 }
@@ -14,6 +14,8 @@
 const unsigned int WALLET_CRYPTO_KEY_SIZE = 32;
 const unsigned int WALLET_CRYPTO_SALT_SIZE = 8;
 const unsigned int WALLET_CRYPTO_IV_SIZE = 16;
+//! Keys checked against their public key by the first unlock, the others are checked when first used
+const unsigned int WALLET_UNLOCK_CHECKED_KEYS = 64;
 
 /**
  * Private key encryption is done based on a CMasterKey,
@@ -125,10 +127,13 @@ private:
     //! if fUseCrypto is false, vMasterKey must be empty
     std::atomic<bool> fUseCrypto;
 
-    //! keeps track of whether Unlock has run a thorough check before
+    //! keeps track of whether Unlock has checked a sample of the keys before
     bool fDecryptionThoroughlyChecked;
     bool fOnlyMixingAllowed;
 
+    //! keys decrypted since the last unlock, dropped by Lock
+    mutable std::map<CKeyID, CKey> mapDecryptedKeys;
+
 protected:
     bool SetCrypted();
 
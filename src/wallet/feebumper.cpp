@@ -139,6 +139,8 @@ Result CreateTransaction(const CWallet* wallet, const uint256& txid, const CCoin
     // calculate the old fee and fee-rate
     old_fee = wtx.GetDebit(ISMINE_SPENDABLE) - wtx.tx->GetValueOut();
     CFeeRate nOldFeeRate(old_fee, txSize);
+    // the mints of the transaction stay the same and so does their ghost protocol fee
+    const CAmount nGhostFee = GetGhostProtocolFee(*wtx.tx, old_fee);
     CFeeRate nNewFeeRate;
     // The wallet uses a conservative WALLET_INCREMENTAL_RELAY_FEE value to
     // future proof against changes to network wide policy for incremental relay
@@ -163,6 +165,19 @@ Result CreateTransaction(const CWallet* wallet, const uint256& txid, const CCoin
         }
         new_fee = total_fee;
         nNewFeeRate = CFeeRate(total_fee, maxNewTxSize);
+    } else if (IsPrivacyTransaction(*wtx.tx)) {
+        // Privacy transactions are estimated on their own, the ghost protocol fee of the
+        // coins they mint stays the same and comes on top
+        CCoinControl privacy_coin_control = coin_control;
+        privacy_coin_control.m_fee_track = FeeEstimateTrack::PRIVACY;
+        new_fee = nGhostFee + GetMinimumFee(maxNewTxSize, privacy_coin_control, mempool, ::feeEstimator, nullptr /* FeeCalculation */);
+        nNewFeeRate = CFeeRate(new_fee, maxNewTxSize);
+
+        // The replacement must still pay more than the original, BIP 125 compares the whole fees
+        if (nNewFeeRate.GetFeePerK() < nOldFeeRate.GetFeePerK() + 1 + walletIncrementalRelayFee.GetFeePerK()) {
+            nNewFeeRate = CFeeRate(nOldFeeRate.GetFeePerK() + 1 + walletIncrementalRelayFee.GetFeePerK());
+            new_fee = nNewFeeRate.GetFee(maxNewTxSize);
+        }
     } else {
         new_fee = GetMinimumFee(maxNewTxSize, coin_control, mempool, ::feeEstimator, nullptr /* FeeCalculation */);
         nNewFeeRate = CFeeRate(new_fee, maxNewTxSize);
@@ -178,8 +193,9 @@ Result CreateTransaction(const CWallet* wallet, const uint256& txid, const CCoin
         }
     }
 
-    // Check that in all cases the new fee doesn't violate maxTxFee
-     if (new_fee > maxTxFee) {
+    // Check that in all cases the new fee doesn't violate maxTxFee, which like the absurd fee
+    // check of the mempool leaves out the ghost protocol fee
+     if (new_fee - nGhostFee > maxTxFee) {
          errors.push_back(strprintf("Specified or calculated fee %s is too high (cannot be higher than maxTxFee %s)",
                                FormatMoney(new_fee), FormatMoney(maxTxFee)));
          return Result::WALLET_ERROR;
@@ -0,0 +1,103 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/ghostkeypool.h>
+
+#include <util.h>
+#include <wallet/walletdb.h>
+#include <zerocoin/zerocoin.h>
+
+CGhostKeyPool ghostKeyPool;
+
+CZerocoinEntry GenerateUnloadedZCEntry()
+{
+    while (true) {
+        libzerocoin::PrivateCoin newCoin(ZCParams, libzerocoin::ZQ_ONE, 1);
+        if (!newCoin.getPublicCoin().validate())
+            continue;
+
+        const unsigned char *ecdsaSecretKey = newCoin.getEcdsaSeckey();
+        CZerocoinEntry zerocoinTx;
+        zerocoinTx.IsUsed = false;
+        zerocoinTx.denomination = libzerocoin::ZQ_ERROR;
+        zerocoinTx.value = newCoin.getPublicCoin().getValue();
+        zerocoinTx.randomness = newCoin.getRandomness();
+        zerocoinTx.serialNumber = newCoin.getSerialNumber();
+        zerocoinTx.ecdsaSecretKey = std::vector<unsigned char>(ecdsaSecretKey, ecdsaSecretKey+32);
+        return zerocoinTx;
+    }
+}
+
+bool WriteUnloadedZCEntries(CWalletDB& walletdb, const std::vector<CZerocoinEntry>& vEntries)
+{
+    bool fTxn = walletdb.TxnBegin();
+    for (const CZerocoinEntry& zerocoinTx : vEntries) {
+        if (!walletdb.WriteUnloadedZCEntry(zerocoinTx)) {
+            if (fTxn)
+                walletdb.TxnAbort();
+            return false;
+        }
+    }
+    if (fTxn && !walletdb.TxnCommit())
+        return error("%s: failed to commit ghostkeys", __func__);
+    return true;
+}
+
+void CGhostKeyPool::Start(size_t nTargetIn, int nThreads)
+{
+    nTarget = nTargetIn;
+    if (nTarget == 0 || nThreads < 1)
+        return;
+
+    LogPrintf("Starting %d ghostkey thread%s, pool size %u\n", nThreads, nThreads > 1 ? "s" : "", nTarget);
+    for (int i = 0; i < nThreads; ++i)
+        threads.emplace_back(&CGhostKeyPool::ThreadGenerate, this);
+}
+
+void CGhostKeyPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        fStop = true;
+    }
+    cond.notify_all();
+    for (std::thread& t : threads)
+        t.join();
+    threads.clear();
+}
+
+std::vector<CZerocoinEntry> CGhostKeyPool::Take(size_t nCount)
+{
+    std::vector<CZerocoinEntry> vEntries;
+    vEntries.reserve(nCount);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        while (vEntries.size() < nCount && !pool.empty()) {
+            vEntries.push_back(pool.front());
+            pool.pop_front();
+        }
+    }
+    cond.notify_all();
+
+    while (vEntries.size() < nCount)
+        vEntries.push_back(GenerateUnloadedZCEntry());
+    return vEntries;
+}
+
+void CGhostKeyPool::ThreadGenerate()
+{
+    RenameThread("nix-ghostkeys");
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        cond.wait(lock, [this] { return fStop || pool.size() < nTarget; });
+        if (fStop)
+            return;
+
+        lock.unlock();
+        CZerocoinEntry zerocoinTx = GenerateUnloadedZCEntry();
+        lock.lock();
+
+        pool.push_back(zerocoinTx);
+    }
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NIX_WALLET_GHOSTKEYPOOL_H
+#define NIX_WALLET_GHOSTKEYPOOL_H
+
+#include <wallet/wallet.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! -ghostkeypool default, number of ghostkeys kept generated ahead of use
+static const int DEFAULT_GHOSTKEY_POOL_SIZE = 100;
+//! -ghostkeythreads default
+static const int DEFAULT_GHOSTKEY_THREADS = 1;
+
+/** Generate a new unloaded ghostkey, retrying until its public coin validates */
+CZerocoinEntry GenerateUnloadedZCEntry();
+
+/** Write unloaded ghostkeys to the wallet database in one transaction */
+bool WriteUnloadedZCEntries(CWalletDB& walletdb, const std::vector<CZerocoinEntry>& vEntries);
+
+/**
+ * Ghostkeys generated ahead of use by background threads. Generating one is a prime
+ * search over the 2048 bit libzerocoin parameters, so refillghostkeys and the commitment
+ * key top ups take from here instead. Keys belong to no wallet until one writes them,
+ * so a single pool serves all wallets.
+ */
+class CGhostKeyPool
+{
+public:
+    void Start(size_t nTargetIn, int nThreads);
+    void Stop();
+
+    /** Take nCount ghostkeys, generating on the calling thread what the pool cannot cover */
+    std::vector<CZerocoinEntry> Take(size_t nCount);
+
+private:
+    void ThreadGenerate();
+
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::deque<CZerocoinEntry> pool;
+    std::vector<std::thread> threads;
+    size_t nTarget = 0;
+    bool fStop = false;
+};
+
+extern CGhostKeyPool ghostKeyPool;
+
+#endif // NIX_WALLET_GHOSTKEYPOOL_H
@@ -8,12 +8,14 @@
 #include <wallet/wallet.h>
 #include <sigma/sigma_primitives.h>
 #include <sigma/openssl_context.h>
+#include <sigma/parallel.h>
 #include <validation.h>
 #include <hash.h>
 
 CGhostWallet::CGhostWallet(CWallet *pwalletMain)
 {
     this->pwalletMain = pwalletMain;
+    fMintPoolLoaded = false;
 
     CWalletDB walletdb(pwalletMain->GetDBHandle());
 
@@ -71,6 +73,7 @@ bool CGhostWallet::SetMasterSeed(const uint256& seedMaster, bool fResetCount)
         nCountLastUsed = 0;
 
     mintPool.Reset();
+    fMintPoolLoaded = false;
 
     return true;
 }
@@ -97,46 +100,67 @@ void CGhostWallet::GenerateMintPool(uint32_t nCountStart, uint32_t nCountEnd)
     if (nCountStart > 0)
         n = nCountStart;
 
-    uint32_t nStop = n + 50;
+    uint32_t nStop = n + MINT_POOL_LOOKAHEAD;
     if (nCountEnd > 0)
         nStop = std::max(n, n + nCountEnd);
 
-    bool fFound;
-
     uint256 hashSeed = Hash(seedMaster.begin(), seedMaster.end());
     LogPrintf("%s : n=%d nStop=%d\n", __func__, n, nStop - 1);
-    for (uint32_t i = n; i < nStop; ++i) {
-        if (ShutdownRequested())
-            return;
 
-        fFound = false;
+    // Prevent unnecessary repeated minted
+    std::unordered_set<uint32_t> setPoolCounts;
+    for (const auto& pair : mintPool)
+        setPoolCounts.insert(pair.second);
 
-        // Prevent unnecessary repeated minted
-        for (auto& pair : mintPool) {
-            if(pair.second == i) {
-                fFound = true;
-                break;
-            }
-        }
+    std::vector<uint32_t> vCounts;
+    for (uint32_t i = n; i < nStop; ++i) {
+        if (!setPoolCounts.count(i))
+            vCounts.push_back(i);
+    }
 
-        if(fFound)
-            continue;
+    if (vCounts.empty())
+        return;
 
-        uint512 seedZerocoin = GetSigmaSeed(i);
-        GroupElement bnValue;
-        CKey key;
+    // Derive the mints concurrently, each one is independent of the others
+    std::vector<GroupElement> vPubcoins(vCounts.size());
+    sigma::parallel_for(vCounts.size(), nSigmaProverThreads, [&](std::size_t j) {
         sigma::PrivateCoin coin(SParams, sigma::CoinDenomination::SIGMA_1);
-        SeedToSigma(seedZerocoin, bnValue, coin);
+        SeedToSigma(GetSigmaSeed(vCounts[j]), vPubcoins[j], coin);
+    });
+
+    if (ShutdownRequested())
+        return;
 
-        mintPool.Add(bnValue, i);
-        CWalletDB(pwalletMain->GetDBHandle()).WriteMintPoolPair(hashSeed, GetPubCoinValueHash(bnValue), i);
-        LogPrintf("%s : %s count=%d\n", __func__, bnValue.GetHex().substr(0, 6), i);
+    // Write the whole pool in a single database transaction
+    CWalletDB walletdb(pwalletMain->GetDBHandle());
+    bool fTxn = walletdb.TxnBegin();
+    for (std::size_t j = 0; j < vCounts.size(); j++) {
+        mintPool.Add(vPubcoins[j], vCounts[j]);
+        walletdb.WriteMintPoolPair(hashSeed, GetPubCoinValueHash(vPubcoins[j]), vCounts[j]);
+        LogPrintf("%s : %s count=%d\n", __func__, vPubcoins[j].GetHex().substr(0, 6), vCounts[j]);
     }
+    if (fTxn && !walletdb.TxnCommit())
+        LogPrintf("%s : failed to commit the mint pool to the wallet database\n", __func__);
+}
+
+void CGhostWallet::ExtendMintPool()
+{
+    if (seedMaster.IsNull())
+        return;
+
+    uint32_t nLastGenerated = mintPool.CountOfLastGenerated();
+    if (nLastGenerated < nCountLastUsed + MINT_POOL_LOOKAHEAD)
+        GenerateMintPool(nLastGenerated + 1, nCountLastUsed + MINT_POOL_LOOKAHEAD - nLastGenerated);
 }
 
 // pubcoin hashes are stored to db so that a full accounting of mints belonging to the seed can be tracked without regenerating
 bool CGhostWallet::LoadMintPoolFromDB()
 {
+    // Pairs generated since are added to the pool as they are written
+    if (fMintPoolLoaded)
+        return true;
+    fMintPoolLoaded = true;
+
     map<uint256, vector<pair<uint256, uint32_t> > > mapMintPool = CWalletDB(pwalletMain->GetDBHandle()).MapMintPool();
 
      map<uint256, vector<pair<uint256, uint32_t>>>::iterator it;
@@ -169,22 +193,22 @@ void CGhostWallet::SyncWithChain(bool fGenerateMintPool)
 {
     uint32_t nLastCountUsed = 0;
     bool found = true;
-    CWalletDB walletdb(pwalletMain->GetDBHandle());
+    CWalletBatchScope batch(pwalletMain);
 
     set<uint256> setAddedTx;
+    // Each round only looks up the mints the extended pool added
+    std::set<uint256> setChecked;
     while (found) {
         found = false;
         if (fGenerateMintPool)
             GenerateMintPool();
         LogPrintf("%s: Mintpool size=%d\n", __func__, mintPool.size());
 
-        std::set<uint256> setChecked;
         list<pair<uint256,uint32_t> > listMints = mintPool.List();
         for (pair<uint256, uint32_t> pMint : listMints) {
             LOCK(cs_main);
-            if (setChecked.count(pMint.first))
-                return;
-            setChecked.insert(pMint.first);
+            if (!setChecked.insert(pMint.first).second)
+                continue;
 
             if (ShutdownRequested())
                 return;
@@ -279,7 +303,7 @@ bool CGhostWallet::SetMintSeen(const GroupElement& bnValue, const int& nHeight,
         return error("%s: value not in pool", __func__);
     pair<uint256, uint32_t> pMint = mintPool.Get(bnValue);
 
-    CWalletDB walletdb(pwalletMain->GetDBHandle());
+    CWalletDBRef walletdb(pwalletMain);
     CSigmaMint dMint;
 
     // Regenerate the mint
@@ -292,7 +316,7 @@ bool CGhostWallet::SetMintSeen(const GroupElement& bnValue, const int& nHeight,
     CSigmaMint dMint_;
     if(seedMaster.IsNull()){
         uint256 hashPubCoin = pMint.first;
-        if(walletdb.ReadSigmaMint(hashPubCoin, dMint_)){
+        if(walletdb->ReadSigmaMint(hashPubCoin, dMint_)){
             bnValueGen = dMint_.GetPubcoinValue();
             dMint = dMint_;
         } else {
@@ -346,7 +370,7 @@ bool CGhostWallet::SetMintSeen(const GroupElement& bnValue, const int& nHeight,
     //Update the count if it is less than the mint's count
     if (nCountLastUsed < pMint.second) {
         nCountLastUsed = pMint.second;
-        walletdb.WriteSigmaCount(nCountLastUsed);
+        walletdb->WriteSigmaCount(nCountLastUsed);
     }
 
     //remove from the pool
@@ -407,8 +431,8 @@ void CGhostWallet::UpdateCountLocal()
 
 void CGhostWallet::UpdateCountDB()
 {
-    CWalletDB walletdb(pwalletMain->GetDBHandle());
-    walletdb.WriteSigmaCount(nCountLastUsed);
+    CWalletDBRef walletdb(pwalletMain);
+    walletdb->WriteSigmaCount(nCountLastUsed);
 }
 
 void CGhostWallet::UpdateCount()
@@ -10,6 +10,9 @@
 #include <zerocoin/sigma.h>
 #include <key.h>
 
+//! Unused deterministic mint counts kept generated past the last used one
+static const uint32_t MINT_POOL_LOOKAHEAD = 50;
+
 class CDeterministicMint;
 class CWallet;
 class CSigmaEntry;
@@ -63,6 +66,7 @@ private:
     std::map<uint32_t, uint256> sigmaHash;
     uint32_t nCountLastUsed;
     CMintPool mintPool;
+    bool fMintPoolLoaded;
     CWallet *pwalletMain;
 
 public:
@@ -76,6 +80,8 @@ public:
     void GetState(int& nCount, int& nLastGenerated);
     bool RegenerateMint(const CSigmaMint& dMint, CSigmaEntry& sigma);
     void GenerateMintPool(uint32_t nCountStart = 0, uint32_t nCountEnd = 0);
+    //! Generates the mint pool up to MINT_POOL_LOOKAHEAD past the last used count, as a rescan finds used mints
+    void ExtendMintPool();
     bool LoadMintPoolFromDB();
     void RemoveMintsFromPool(const std::vector<uint256>& vPubcoinHashes);
     bool SetMintSeen(const GroupElement& bnValue, const int& nHeight, const uint256& txid, const sigma::CoinDenomination& denom);
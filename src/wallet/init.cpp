@@ -13,6 +13,8 @@
 #include <wallet/wallet.h>
 #include <wallet/walletutil.h>
 #include <wallet/ghostwallet.h>
+#include <wallet/ghostkeypool.h>
+#include <wallet/spendjobs.h>
 
 std::string GetWalletHelpString(bool showDebug)
 {
@@ -63,6 +65,12 @@ std::string GetWalletHelpString(bool showDebug)
     strUsage += HelpMessageGroup(_("Wallet ghosting options:"));
     strUsage += HelpMessageOpt("-autoghost", _("Auto ghost your coins by individual UTXO's on a random time basis from 1 minute to 10 minutes each  (default: false)"));
     strUsage += HelpMessageOpt("-autoghostblacklist=<n>", _("Addresses to blacklist and avoid spending with the autoghost process  (default: none)"));
+    strUsage += HelpMessageOpt("-sigmaproverthreads=<n>", strprintf(_("Set the number of threads used to create sigma spend proofs (up to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
+                                                                    MAX_SIGMA_PROVER_THREADS, DEFAULT_SIGMA_PROVER_THREADS));
+    strUsage += HelpMessageOpt("-ghostkeypool=<n>", strprintf(_("Number of ghostkeys to keep generated ahead of refillghostkeys and commitment key top ups, 0 to disable (default: %u)"), DEFAULT_GHOSTKEY_POOL_SIZE));
+    strUsage += HelpMessageOpt("-ghostkeythreads=<n>", strprintf(_("Number of background threads generating ghostkeys (default: %u)"), DEFAULT_GHOSTKEY_THREADS));
+    strUsage += HelpMessageOpt("-spendjobthreads=<n>", strprintf(_("Number of threads running unghostamountasync jobs, one wallet runs one job at a time (default: %u)"), DEFAULT_SPEND_JOB_THREADS));
+    strUsage += HelpMessageOpt("-spendjobnotify=<cmd>", _("Execute command when an unghostamountasync job finishes (%s in cmd is replaced by the job id)"));
 
     if (showDebug)
     {
@@ -199,6 +207,12 @@ bool WalletParameterInteraction()
     bSpendZeroConfChange = gArgs.GetBoolArg("-spendzeroconfchange", DEFAULT_SPEND_ZEROCONF_CHANGE);
     fWalletRbf = gArgs.GetBoolArg("-walletrbf", DEFAULT_WALLET_RBF);
 
+    // -sigmaproverthreads=0 means autodetect
+    nSigmaProverThreads = gArgs.GetArg("-sigmaproverthreads", DEFAULT_SIGMA_PROVER_THREADS);
+    if (nSigmaProverThreads <= 0)
+        nSigmaProverThreads += GetNumCores();
+    nSigmaProverThreads = std::max(1, std::min(nSigmaProverThreads, MAX_SIGMA_PROVER_THREADS));
+
     g_address_type = ParseOutputType(gArgs.GetArg("-addresstype", ""));
     if (g_address_type == OUTPUT_TYPE_NONE) {
         return InitError(strprintf("Unknown address type '%s'", gArgs.GetArg("-addresstype", "")));
@@ -21,13 +21,17 @@
 #include <rpc/util.h>
 #include <script/sign.h>
 #include <timedata.h>
+#include <txdb.h>
 #include <util.h>
 #include <utilmoneystr.h>
 #include <wallet/coincontrol.h>
 #include <wallet/feebumper.h>
+#include <wallet/ghostkeypool.h>
+#include <wallet/spendjobs.h>
 #include <wallet/wallet.h>
 #include <wallet/walletdb.h>
 #include <wallet/walletutil.h>
+#include <pos/kernel.h>
 #include <pos/miner.h>
 #include <rpc/blockchain.h>
 #include <warnings.h>
@@ -2284,15 +2288,17 @@ UniValue listtransactions(const JSONRPCRequest& request)
         return NullUniValue;
     }
 
-    if (request.fHelp || request.params.size() > 4)
+    if (request.fHelp || request.params.size() > 5)
         throw std::runtime_error(
-            "listtransactions ( \"account\" count skip include_watchonly)\n"
+            "listtransactions ( \"account\" count skip include_watchonly before )\n"
             "\nReturns up to 'count' most recent transactions skipping the first 'from' transactions for account 'account'.\n"
             "\nArguments:\n"
             "1. \"account\"    (string, optional) DEPRECATED. The account name. Should be \"*\".\n"
             "2. count          (numeric, optional, default=10) The number of transactions to return\n"
             "3. skip           (numeric, optional, default=0) The number of transactions to skip\n"
             "4. include_watchonly (bool, optional, default=false) Include transactions to watch-only addresses (see 'importaddress')\n"
+            "5. before         (numeric, optional) Only list transactions with an 'orderpos' below this one. The page then ends\n"
+            "                                       on a whole transaction, pass its oldest 'orderpos' to get the next page.\n"
             "\nResult:\n"
             "[\n"
             "  {\n"
@@ -2332,6 +2338,7 @@ UniValue listtransactions(const JSONRPCRequest& request)
             "                                                     may be unknown for unconfirmed transactions not in the mempool\n"
             "    \"abandoned\": xxx          (bool) 'true' if the transaction has been abandoned (inputs are respendable). Only available for the \n"
             "                                         'send' category of transactions.\n"
+            "    \"orderpos\": n            (numeric) The position of the transaction in the wallet, the cursor for 'before'.\n"
             "  }\n"
             "]\n"
 
@@ -2340,6 +2347,8 @@ UniValue listtransactions(const JSONRPCRequest& request)
             + HelpExampleCli("listtransactions", "") +
             "\nList transactions 100 to 120\n"
             + HelpExampleCli("listtransactions", "\"*\" 20 100") +
+            "\nList the 20 transactions preceding order position 5000\n"
+            + HelpExampleCli("listtransactions", "\"*\" 20 0 false 5000") +
             "\nAs a json rpc call\n"
             + HelpExampleRpc("listtransactions", "\"*\", 20, 100")
         );
@@ -2370,25 +2379,40 @@ UniValue listtransactions(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
     if (nFrom < 0)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative from");
+    bool fBefore = !request.params[4].isNull();
 
     UniValue ret(UniValue::VARR);
 
     const CWallet::TxItems & txOrdered = pwallet->wtxOrdered;
 
+    // wtxOrdered is keyed by order position, so a page starts at the cursor instead of the newest entry
+    CWallet::TxItems::const_reverse_iterator itStart = txOrdered.rbegin();
+    if (fBefore)
+        itStart = CWallet::TxItems::const_reverse_iterator(txOrdered.lower_bound(request.params[4].get_int64()));
+
     // iterate backwards until we have nCount items to return:
-    for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it)
+    for (CWallet::TxItems::const_reverse_iterator it = itStart; it != txOrdered.rend(); ++it)
     {
+        UniValue entries(UniValue::VARR);
         CWalletTx *const pwtx = (*it).second.first;
         if (pwtx != nullptr)
-            ListTransactions(pwallet, *pwtx, strAccount, 0, true, ret, filter);
+            ListTransactions(pwallet, *pwtx, strAccount, 0, true, entries, filter);
         CAccountingEntry *const pacentry = (*it).second.second;
         if (pacentry != nullptr)
-            AcentryToJSON(*pacentry, strAccount, ret);
+            AcentryToJSON(*pacentry, strAccount, entries);
+        for (UniValue entry : entries.getValues()) {
+            entry.pushKV("orderpos", it->first);
+            ret.push_back(entry);
+        }
 
         if ((int)ret.size() >= (nCount+nFrom)) break;
     }
     // ret is newest to oldest
 
+    // keep the entries of the last transaction together so its order position can resume the listing
+    if (fBefore && (int)ret.size() > nFrom)
+        nCount = ret.size() - nFrom;
+
     if (nFrom > (int)ret.size())
         nFrom = ret.size();
     if ((nFrom + nCount) > (int)ret.size())
@@ -4813,6 +4837,35 @@ UniValue manageaddressbook(const JSONRPCRequest &request)
 /*********************/
 /* Staking Protocol */
 
+/** Why a wallet isn't staking, as reported by getstakinginfo, nullptr when there is no known cause */
+static const char* NotStakingCause(int nIsStaking)
+{
+    switch (nIsStaking)
+    {
+        case CWallet::NOT_STAKING_BALANCE:
+            return "low_balance";
+        case CWallet::NOT_STAKING_DEPTH:
+            return "low_depth";
+        case CWallet::NOT_STAKING_LOCKED:
+            return "locked";
+        case CWallet::NOT_STAKING_LIMITED:
+            return "limited";
+        case CWallet::NOT_STAKING_NOT_UNLOCKED_FOR_STAKING_ONLY:
+            return "not unlocked for staking";
+        default:
+            return nullptr;
+    };
+}
+
+/** "staking", the cause of not staking, or "not_staking" */
+static std::string StakingStatus(const CWallet* pwallet)
+{
+    if (fIsStaking && pwallet->nIsStaking == CWallet::IS_STAKING)
+        return "staking";
+    const char* pszCause = NotStakingCause(pwallet->nIsStaking);
+    return pszCause ? pszCause : "not_staking";
+}
+
 UniValue getstakinginfo(const JSONRPCRequest &request)
 {
     CWallet *pwallet = GetWalletForJSONRPCRequest(request);
@@ -4840,6 +4893,7 @@ UniValue getstakinginfo(const JSONRPCRequest &request)
             "  \"lastsearchtime\": xxxxxxx      (numeric) the last time this wallet searched for a coinstake\n"
             "  \"weight\": xxxxxxx              (numeric) the current stake weight of this wallet\n"
             "  \"netstakeweight\": xxxxxxx      (numeric) the current stake weight of the network\n"
+            "  \"netstakespacing\": xxx.xx      (numeric) average seconds between the recent proof-of-stake blocks\n"
             "  \"expectedtime\": xxxxxxx        (numeric) estimated time for next stake\n"
             "}\n"
             "\nExamples:\n"
@@ -4866,33 +4920,17 @@ UniValue getstakinginfo(const JSONRPCRequest &request)
 
     uint64_t nWeight = pwallet->GetStakeWeight();
 
-    uint64_t nNetworkWeight = GetPoSKernelPS();
+    NetworkStakeStats netStake = GetNetworkStakeStats();
+    uint64_t nNetworkWeight = netStake.dWeight;
 
     bool fStaking = nWeight && fIsStaking;
     uint64_t nExpectedTime = fStaking ? (Params().GetTargetSpacing() * nNetworkWeight / nWeight) : 0;
 
     obj.pushKV("enabled", gArgs.GetBoolArg("-staking", true));
     obj.pushKV("staking", fStaking && pwallet->nIsStaking == CWallet::IS_STAKING);
-    switch (pwallet->nIsStaking)
-    {
-        case CWallet::NOT_STAKING_BALANCE:
-            obj.pushKV("cause", "low_balance");
-            break;
-        case CWallet::NOT_STAKING_DEPTH:
-            obj.pushKV("cause", "low_depth");
-            break;
-        case CWallet::NOT_STAKING_LOCKED:
-            obj.pushKV("cause", "locked");
-            break;
-        case CWallet::NOT_STAKING_LIMITED:
-            obj.pushKV("cause", "limited");
-            break;
-        case CWallet::NOT_STAKING_NOT_UNLOCKED_FOR_STAKING_ONLY:
-            obj.pushKV("cause", "not unlocked for staking");
-            break;
-        default:
-            break;
-    };
+    const char* pszCause = NotStakingCause(pwallet->nIsStaking);
+    if (pszCause)
+        obj.pushKV("cause", pszCause);
 
     obj.pushKV("errors", GetWarnings("statusbar"));
 
@@ -4916,6 +4954,7 @@ UniValue getstakinginfo(const JSONRPCRequest &request)
 
     obj.pushKV("weight", (uint64_t)nWeight);
     obj.pushKV("netstakeweight", (uint64_t)nNetworkWeight);
+    obj.pushKV("netstakespacing", netStake.dSpacing);
 
     obj.pushKV("expectedtime", nExpectedTime);
 
@@ -4953,6 +4992,55 @@ UniValue getstakinginfo(const JSONRPCRequest &request)
     return obj;
 }
 
+UniValue waitforstakingstatus(const JSONRPCRequest &request)
+{
+    CWallet *pwallet = GetWalletForJSONRPCRequest(request);
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp))
+        return NullUniValue;
+
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            "waitforstakingstatus ( \"status\" timeout )\n"
+            "\nWaits for the staking status of this wallet to differ from the given one and returns it.\n"
+            "\nReturns the current status on timeout or exit.\n"
+            "\nArguments:\n"
+            "1. \"status\"  (string, optional) The status last seen, the current one if not given\n"
+            "2. timeout     (int, optional, default=0) Time in milliseconds to wait for a response. 0 indicates no timeout.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"status\": \"...\",       (string) \"staking\", \"not_staking\" or the cause given by getstakinginfo\n"
+            "  \"staking\": true|false,   (boolean) if this wallet is staking\n"
+            "  \"height\": n            (numeric) the height of the tip\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("waitforstakingstatus", "\"staking\" 60000")
+            + HelpExampleRpc("waitforstakingstatus", "\"staking\", 60000"));
+
+    std::string strStatus = StakingStatus(pwallet);
+    if (!request.params[0].isNull() && !request.params[0].get_str().empty())
+        strStatus = request.params[0].get_str();
+    int timeout = 0;
+    if (!request.params[1].isNull())
+        timeout = request.params[1].get_int();
+
+    {
+        // woken by the stake threads when the status changes, on new tips and on shutdown
+        WaitableLock lock(csBestBlock);
+        auto changed = [pwallet, &strStatus]{ return StakingStatus(pwallet) != strStatus || !IsRPCRunning(); };
+        if (timeout)
+            cvBlockChange.wait_for(lock, std::chrono::milliseconds(timeout), changed);
+        else
+            cvBlockChange.wait(lock, changed);
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    std::string strStatusNow = StakingStatus(pwallet);
+    obj.pushKV("status", strStatusNow);
+    obj.pushKV("staking", strStatusNow == "staking");
+    obj.pushKV("height", chainActive.Height());
+    return obj;
+}
+
 UniValue getcoldstakinginfo(const JSONRPCRequest &request)
 {
     CWallet *pwallet = GetWalletForJSONRPCRequest(request);
@@ -5133,12 +5221,6 @@ UniValue refillghostkeys(const JSONRPCRequest& request)
     if (request.fHelp || request.params.size() > 1)
         throw runtime_error("refillghostkeys <amount>(default=100)\n" + HelpRequiringPassphrase(pwalletMain));
 
-    libzerocoin::CoinDenomination denomination;
-    libzerocoin::Params *zcParams = ZCParams;
-
-    int mintVersion = 1;
-    denomination = libzerocoin::ZQ_ONE;
-
     vector<std::string> ghostKey;
 
     if (pwalletMain->IsLocked()) {
@@ -5156,26 +5238,14 @@ UniValue refillghostkeys(const JSONRPCRequest& request)
         ideal = 101;
 
     //refill keys to 100 in wallet
-    for(int i = listUnloadedPubcoin.size(); i < ideal; i++){
-        libzerocoin::PrivateCoin newCoinTemp(zcParams, denomination, mintVersion);
-        if(newCoinTemp.getPublicCoin().validate()){
-            const unsigned char *ecdsaSecretKey = newCoinTemp.getEcdsaSeckey();
-            CZerocoinEntry zerocoinTx;
-            zerocoinTx.IsUsed = false;
-            zerocoinTx.denomination = libzerocoin::ZQ_ERROR;
-            zerocoinTx.value = newCoinTemp.getPublicCoin().getValue();
-            zerocoinTx.randomness = newCoinTemp.getRandomness();
-            zerocoinTx.serialNumber = newCoinTemp.getSerialNumber();
-            zerocoinTx.ecdsaSecretKey = std::vector<unsigned char>(ecdsaSecretKey, ecdsaSecretKey+32);
-            if (!walletdb.WriteUnloadedZCEntry(zerocoinTx))
-                return "ghostkeys() Error: Only able to create " + std::to_string(i) + " keys";
-
-            std::vector<unsigned char> commitmentKey = newCoinTemp.getPublicCoin().getValue().getvch();
-            CommitmentKey pubCoin(commitmentKey);
-            ghostKey.push_back(pubCoin.GetPubCoinDataBase58() + "-");
-        }
-        else
-            i--;
+    std::vector<CZerocoinEntry> vEntries = ghostKeyPool.Take(std::max(ideal - (int)listUnloadedPubcoin.size(), 0));
+    if (!WriteUnloadedZCEntries(walletdb, vEntries))
+        return "ghostkeys() Error: Unable to write keys";
+
+    for (const CZerocoinEntry &zerocoinTx : vEntries) {
+        std::vector<unsigned char> commitmentKey = zerocoinTx.value.getvch();
+        CommitmentKey pubCoin(commitmentKey);
+        ghostKey.push_back(pubCoin.GetPubCoinDataBase58() + "-");
     }
 
     string fullKey;
@@ -5396,7 +5466,8 @@ UniValue listallserials(const JSONRPCRequest& request)
     UniValue results(UniValue::VARR);
     if(request.params.size() > 0){
         CBlockIndex *temp = chainActive[request.params[0].get_int()];
-        for(auto it = temp->spentSerials.begin(); it != temp->spentSerials.end(); it++){
+        std::shared_ptr<const CPrivacyBlockData> blockData = pprivacyindex->ReadBlock(temp);
+        for(auto it = blockData->spentSerials.begin(); it != blockData->spentSerials.end(); it++){
             results.push_back(it->ToString());
         }
         return results;
@@ -5405,7 +5476,8 @@ UniValue listallserials(const JSONRPCRequest& request)
 
     for(auto it = 53000; it <= chainActive.Tip()->nHeight; it++){
         CBlockIndex *temp = chainActive[it];
-        for(auto it = temp->spentSerials.begin(); it != temp->spentSerials.end(); it++){
+        std::shared_ptr<const CPrivacyBlockData> blockData = pprivacyindex->ReadBlock(temp);
+        for(auto it = blockData->spentSerials.begin(); it != blockData->spentSerials.end(); it++){
             results.push_back(it->ToString());
         }
     }
@@ -5604,9 +5676,7 @@ UniValue ghostfeepayouttotal(const JSONRPCRequest& request)
                     }
                     // add input denoms
                     for(int k = 0; k < ctx->vin.size(); k++){
-                        std::pair<std::unique_ptr<sigma::CoinSpend>, uint32_t> newSpend;
-                        newSpend = ParseSigmaSpend(ctx->vin[k]);
-                        inVal += newSpend.first->getIntDenomination();
+                        inVal += ParseSigmaSpendView(ctx->vin[k]).first.getIntDenomination();
                     }
                     CAmount neededForFee = (inVal - outVal)/0.0025;
                     mintVector.push_back(neededForFee);
@@ -5622,16 +5692,8 @@ UniValue ghostfeepayouttotal(const JSONRPCRequest& request)
     //Calculate total fees for the 720 block cycle
     returnFee = totalGhosted * 0.0025;
 
-    vector<CGhostnode> ghostnodeVector = mnodeman.GetFullGhostnodeVector();
-
-    int totalActiveNodes = 0;
     int64_t ensureNodeActiveBefore = chainActive[startHeight]->GetBlockTime();
-
-    for(auto node: ghostnodeVector){
-
-        if(node.IsEnabled() && (node.sigTime <= ensureNodeActiveBefore))
-            totalActiveNodes++;
-    }
+    int totalActiveNodes = mnodeman.GetGhostFeePayees(ensureNodeActiveBefore)->size();
 
 
     entry.push_back(Pair("ghost_fee_payout", ValueFromAmount(returnFee)));
@@ -6392,6 +6454,25 @@ UniValue ghostamountv2(const JSONRPCRequest& request)
     return wtx.GetHash().GetHex();
 }
 
+/** Splits the destination of an unghost into an address or the scripts of a commitment key pack */
+static void ParseUnghostDestination(const JSONRPCRequest& request, std::string& toKey, std::vector<CScript>& keyList)
+{
+    toKey = "";
+    keyList.clear();
+    if (request.params.size() > 1){
+        // Address
+        toKey = request.params[1].get_str();
+        CommitmentKeyPack keypack(toKey);
+        CTxDestination dest = DecodeDestination(toKey);
+        if(keypack.IsValidPack()){
+            keyList = keypack.GetPubCoinPackScript();
+            toKey = "";
+        }
+        else if(!IsValidDestination(dest))
+            throw JSONRPCError(RPC_WALLET_ERROR, "invalid key");
+    }
+}
+
 UniValue unghostamountv2(const JSONRPCRequest& request)
 {
     CWallet *pwalletMain = GetWalletForJSONRPCRequest(request);
@@ -6405,22 +6486,9 @@ UniValue unghostamountv2(const JSONRPCRequest& request)
 
     std::string nAmount = request.params[0].get_str();
 
-    CTxDestination dest;
-    std::string toKey = "";
+    std::string toKey;
     std::vector <CScript> keyList;
-    keyList.clear();
-    if (request.params.size() > 1){
-        // Address
-        toKey = request.params[1].get_str();
-        CommitmentKeyPack keypack(toKey);
-        dest = DecodeDestination(toKey);
-        if(keypack.IsValidPack()){
-            keyList = keypack.GetPubCoinPackScript();
-            toKey = "";
-        }
-        else if(!IsValidDestination(dest))
-            throw JSONRPCError(RPC_WALLET_ERROR, "invalid key");
-    }
+    ParseUnghostDestination(request, toKey, keyList);
 
     if (pwalletMain->IsLocked())
         throw JSONRPCError(RPC_WALLET_UNLOCK_NEEDED,
@@ -6432,14 +6500,137 @@ UniValue unghostamountv2(const JSONRPCRequest& request)
     return strError;
 }
 
+static UniValue SpendJobToJSON(const CSpendJob& job)
+{
+    UniValue entry(UniValue::VOBJ);
+    entry.pushKV("jobid", job.nId);
+    entry.pushKV("status", SpendJobStatusString(job.status));
+    entry.pushKV("amount", job.strAmount);
+    entry.pushKV("sent", job.nBatch);
+    entry.pushKV("transactions", job.nBatches);
+    entry.pushKV("submitted", job.nTimeSubmitted);
+    if (job.nTimeStarted)
+        entry.pushKV("started", job.nTimeStarted);
+    if (job.nTimeFinished) {
+        entry.pushKV("finished", job.nTimeFinished);
+        entry.pushKV("result", job.strResult);
+    }
+    return entry;
+}
+
+static const std::string SPEND_JOB_HELP =
+    "{\n"
+    "  \"jobid\" : n,             (numeric) The job id\n"
+    "  \"status\" : \"str\",        (string) queued, running, done or cancelled\n"
+    "  \"amount\" : \"str\",        (string) The amount to unghost\n"
+    "  \"sent\" : n,              (numeric) Spend transactions sent so far\n"
+    "  \"transactions\" : n,      (numeric) Spend transactions the amount needs, 0 until the job runs\n"
+    "  \"submitted\" : n,         (numeric) Time the job was submitted\n"
+    "  \"started\" : n,           (numeric, optional) Time the job started running\n"
+    "  \"finished\" : n,          (numeric, optional) Time the job finished\n"
+    "  \"result\" : \"str\"         (string, optional) What unghostamountv2 would have returned\n"
+    "}\n";
+
+UniValue unghostamountasync(const JSONRPCRequest& request)
+{
+    CWallet *pwalletMain = GetWalletForJSONRPCRequest(request);
+
+    if (request.fHelp || request.params.size() == 0 || request.params.size() > 2)
+        throw runtime_error(
+            "unghostamountasync <amount>(whole numbers only) <addresstosend>(either address or commitment key pack)\n"
+            "\nQueues an unghostamountv2 and returns without waiting for its proofs.\n"
+            "Poll the job with getspendjob, or set -spendjobnotify to be told when it finishes.\n"
+            + HelpRequiringPassphrase(pwalletMain) +
+            "\nResult:\n"
+            "n    (numeric) The job id\n");
+
+    if (!IsSigmaAllowed()) {
+        throw JSONRPCError(RPC_WALLET_ERROR, "Sigma is not activated yet");
+    }
+
+    std::string nAmount = request.params[0].get_str();
+
+    std::string toKey;
+    std::vector <CScript> keyList;
+    ParseUnghostDestination(request, toKey, keyList);
+
+    if (pwalletMain->IsLocked())
+        throw JSONRPCError(RPC_WALLET_UNLOCK_NEEDED,
+                           "Error: Please enter the wallet passphrase with walletpassphrase first.");
+
+    return spendJobQueue.Submit(pwalletMain, nAmount, toKey, keyList);
+}
+
+UniValue getspendjob(const JSONRPCRequest& request)
+{
+    CWallet *pwalletMain = GetWalletForJSONRPCRequest(request);
+
+    if (request.fHelp || request.params.size() != 1)
+        throw runtime_error(
+            "getspendjob jobid\n"
+            "\nReturns the state of a job queued by unghostamountasync.\n"
+            "\nArguments:\n"
+            "1. jobid    (numeric, required) The job id\n"
+            "\nResult:\n"
+            + SPEND_JOB_HELP);
+
+    CSpendJob job;
+    if (!spendJobQueue.Get(request.params[0].get_int64(), job) || job.pwallet != pwalletMain)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown spend job");
+    return SpendJobToJSON(job);
+}
+
+UniValue listspendjobs(const JSONRPCRequest& request)
+{
+    CWallet *pwalletMain = GetWalletForJSONRPCRequest(request);
+
+    if (request.fHelp || request.params.size() != 0)
+        throw runtime_error(
+            "listspendjobs\n"
+            "\nLists the jobs queued by unghostamountasync that are running or recently finished.\n"
+            "\nResult:\n"
+            "[ (array of objects as getspendjob returns them)\n"
+            + SPEND_JOB_HELP +
+            "  ,...\n"
+            "]\n");
+
+    UniValue result(UniValue::VARR);
+    for (const CSpendJob& job : spendJobQueue.List(pwalletMain))
+        result.push_back(SpendJobToJSON(job));
+    return result;
+}
+
+UniValue cancelspendjob(const JSONRPCRequest& request)
+{
+    CWallet *pwalletMain = GetWalletForJSONRPCRequest(request);
+
+    if (request.fHelp || request.params.size() != 1)
+        throw runtime_error(
+            "cancelspendjob jobid\n"
+            "\nCancels a job queued by unghostamountasync. A running job stops before its next spend\n"
+            "transaction, the ones already sent stay sent.\n"
+            "\nArguments:\n"
+            "1. jobid    (numeric, required) The job id\n"
+            "\nResult:\n"
+            "true|false    (boolean) Whether the job was still queued or running\n");
+
+    int64_t nId = request.params[0].get_int64();
+    CSpendJob job;
+    if (!spendJobQueue.Get(nId, job) || job.pwallet != pwalletMain)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown spend job");
+    return spendJobQueue.Cancel(nId);
+}
+
 UniValue listghostednixv2(const JSONRPCRequest& request) {
-    if (request.fHelp || request.params.size() > 1)
+    if (request.fHelp || request.params.size() > 3)
         throw runtime_error(
-                "listghostednixv2 <all>(false/true)\n"
+                "listghostednixv2 <all>(false/true) <count> \"cursor\"\n"
                         "\nArguments:\n"
                         "1. <all> (boolean, optional) false (default) to return unspent minted sigma coins, true to return every minted sigma coin.\n"
+                        "2. <count> (numeric, optional) Return at most this many coins in mint height order. Default is every coin.\n"
+                        "3. \"cursor\" (string, optional) Continue after the coin with this 'cursor', from the last coin of the previous page.\n"
                         "\nResults are an array of Objects, each of which has:\n"
-                        "{id, IsUsed, denomination, value, serialNumber, nHeight, randomness}");
+                        "{deterministic, isUsed, height, denomination, pubcoinValue, cursor}");
 
     bool fAllStatus = false;
     if (request.params.size() > 0) {
@@ -6448,7 +6639,25 @@ UniValue listghostednixv2(const JSONRPCRequest& request) {
 
     CWallet * const pwalletMain = GetWalletForJSONRPCRequest(request);
 
-    std::list<CMintMeta> mintMetas = pwalletMain->sigmaTracker->GetMints(true);
+    std::list<CMintMeta> mintMetas;
+    if (request.params.size() > 1) {
+        int nCount = request.params[1].get_int();
+        if (nCount < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+
+        // the cursor is "height:serialhash" of the last coin returned
+        std::pair<int, uint256> cursor(-1, uint256());
+        if (request.params.size() > 2) {
+            const std::string& strCursor = request.params[2].get_str();
+            size_t nSep = strCursor.find(':');
+            if (nSep == std::string::npos || !ParseInt32(strCursor.substr(0, nSep), &cursor.first) || !IsHex(strCursor.substr(nSep + 1)))
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+            cursor.second.SetHex(strCursor.substr(nSep + 1));
+        }
+        mintMetas = pwalletMain->sigmaTracker->GetMintsPage(cursor, nCount, true, !fAllStatus);
+    } else {
+        mintMetas = pwalletMain->sigmaTracker->GetMints(true, !fAllStatus);
+    }
 
     UniValue results(UniValue::VARR);
 
@@ -6461,6 +6670,7 @@ UniValue listghostednixv2(const JSONRPCRequest& request) {
         entry.push_back(Pair("height", mintItem.nHeight));
         entry.push_back(Pair("denomination", std::to_string(nVal)));
         entry.push_back(Pair("pubcoinValue", mintItem.pubCoinValue.tostring()));
+        entry.push_back(Pair("cursor", strprintf("%d:%s", mintItem.nHeight, mintItem.hashSerial.GetHex())));
         results.push_back(entry);
     }
 
@@ -6620,7 +6830,7 @@ static const CRPCCommand commands[] =
     { "wallet",             "listreceivedbyaccount",    &listreceivedbyaccount,    {"minconf","include_empty","include_watchonly"} },
     { "wallet",             "listreceivedbyaddress",    &listreceivedbyaddress,    {"minconf","include_empty","include_watchonly"} },
     { "wallet",             "listsinceblock",           &listsinceblock,           {"blockhash","target_confirmations","include_watchonly","include_removed"} },
-    { "wallet",             "listtransactions",         &listtransactions,         {"account","count","skip","include_watchonly"} },
+    { "wallet",             "listtransactions",         &listtransactions,         {"account","count","skip","include_watchonly","before"} },
     { "wallet",             "listunspent",              &listunspent,              {"minconf","maxconf","addresses","include_unsafe","query_options"} },
     { "wallet",             "listwallets",              &listwallets,              {} },
     { "wallet",             "lockunspent",              &lockunspent,              {"unlock","transactions"} },
@@ -6640,6 +6850,7 @@ static const CRPCCommand commands[] =
     { "generating",         "generate",                 &generate,                 {"nblocks","maxtries"} },
     // NIX Staking functions
     { "wallet",             "getstakinginfo",           &getstakinginfo,           {} },
+    { "wallet",             "waitforstakingstatus",     &waitforstakingstatus,     {"status","timeout"} },
     { "wallet",             "getcoldstakinginfo",       &getcoldstakinginfo,       {} },
     { "wallet",             "reservebalance",           &reservebalance,           {"enabled","amount"} },
     { "wallet",             "getalladdresses",          &getalladdresses,          {} },
@@ -6655,6 +6866,7 @@ static const CRPCCommand commands[] =
     { "NIX Privacy",        "resetghostednix",          &resetmintzerocoin,        {} },
     { "NIX Privacy",        "setghostednixstatus",      &setmintzerocoinstatus,    {} },
     { "NIX Privacy",        "listghostednix",           &listmintzerocoins,        {"all"} },
+    { "NIX Privacy",        "listghostednixv2",         &listghostednixv2,         {"all","count","cursor"} },
     { "NIX Privacy",        "listpubcoins",             &listpubcoins,             {} },
     { "NIX Privacy",        "refillghostkeys",          &refillghostkeys,          {"amount"} },
     { "NIX Privacy",        "listunloadedpubcoins",     &listunloadedpubcoins,     {"amount"} },
@@ -6677,6 +6889,10 @@ static const CRPCCommand commands[] =
     { "NIX Privacy",        "getpubcoinpackv2",         &getpubcoinpackv2,         {"amount"} },
     { "NIX Privacy",        "ghostamountv2",            &ghostamountv2,            {"amount", "commitment_key_pack"} },
     { "NIX Privacy",        "unghostamountv2",          &unghostamountv2,          {"amount", "to_key"} },
+    { "NIX Privacy",        "unghostamountasync",       &unghostamountasync,       {"amount", "to_key"} },
+    { "NIX Privacy",        "getspendjob",              &getspendjob,              {"jobid"} },
+    { "NIX Privacy",        "listspendjobs",            &listspendjobs,            {} },
+    { "NIX Privacy",        "cancelspendjob",           &cancelspendjob,           {"jobid"} },
     { "NIX Privacy",        "getsigmaseed",             &getsigmaseed,             {} },
     { "NIX Privacy",        "setsigmaseed",             &setsigmaseed,             {"seed"} },
     { "NIX Privacy",        "listsigmaentries",         &listsigmaentries,         {"all"} },
@@ -22,6 +22,10 @@ CSigmaTracker::CSigmaTracker(CWallet *pwallet)
     this->pwalletMain = pwallet;
     mapSerialHashes.clear();
     mapPendingSpends.clear();
+    mapPubcoinHashes.clear();
+    mapMintTxids.clear();
+    mapUnusedValueByHeight.clear();
+    nUnusedValueTotal = 0;
     fInitialized = false;
 }
 
@@ -29,6 +33,53 @@ CSigmaTracker::~CSigmaTracker()
 {
     mapSerialHashes.clear();
     mapPendingSpends.clear();
+    mapPubcoinHashes.clear();
+    mapMintTxids.clear();
+}
+
+void CSigmaTracker::AddToBalance(const CMintMeta& meta, int nSign)
+{
+    if (meta.isUsed || meta.isArchived)
+        return;
+
+    int64_t nValue;
+    sigma::DenominationToInteger(meta.denom, nValue);
+    nValue *= nSign;
+
+    auto it = mapUnusedValueByHeight.insert(make_pair(meta.nHeight, 0)).first;
+    it->second += nValue;
+    if (it->second == 0)
+        mapUnusedValueByHeight.erase(it);
+    nUnusedValueTotal += nValue;
+}
+
+void CSigmaTracker::Store(const CMintMeta& meta)
+{
+    auto it = mapSerialHashes.find(meta.hashSerial);
+    if (it != mapSerialHashes.end()) {
+        // drop the index entries of the meta being replaced
+        const CMintMeta& oldMeta = it->second;
+        AddToBalance(oldMeta, -1);
+        setMintsByHeight.erase(make_pair(oldMeta.nHeight, meta.hashSerial));
+        mapPubcoinHashes.erase(GetPubCoinValueHash(oldMeta.pubCoinValue));
+        auto range = mapMintTxids.equal_range(oldMeta.txid);
+        for (auto itTx = range.first; itTx != range.second; ++itTx) {
+            if (itTx->second == meta.hashSerial) {
+                mapMintTxids.erase(itTx);
+                break;
+            }
+        }
+        it->second = meta;
+    }
+    else {
+        mapSerialHashes.insert(make_pair(meta.hashSerial, meta));
+    }
+
+    AddToBalance(meta, 1);
+    setMintsByHeight.insert(make_pair(meta.nHeight, meta.hashSerial));
+    mapPubcoinHashes[GetPubCoinValueHash(meta.pubCoinValue)] = meta.hashSerial;
+    if (!meta.txid.IsNull())
+        mapMintTxids.insert(make_pair(meta.txid, meta.hashSerial));
 }
 
 void CSigmaTracker::Init()
@@ -44,8 +95,11 @@ bool CSigmaTracker::Archive(CMintMeta& meta)
 {
     uint256 hashPubcoin = GetPubCoinValueHash(meta.pubCoinValue);
 
-    if (HasSerialHash(meta.hashSerial))
-        mapSerialHashes.at(meta.hashSerial).isArchived = true;
+    auto it = mapSerialHashes.find(meta.hashSerial);
+    if (it != mapSerialHashes.end()) {
+        AddToBalance(it->second, -1);
+        it->second.isArchived = true;
+    }
 
     LogPrintf("%s: archived pubcoinhash %s\n", __func__, hashPubcoin.GetHex());
     return true;
@@ -53,15 +107,15 @@ bool CSigmaTracker::Archive(CMintMeta& meta)
 
 bool CSigmaTracker::UnArchive(const uint256& hashPubcoin, bool isDeterministic)
 {
-    CWalletDB walletdb(pwalletMain->GetDBHandle());
+    CWalletDBRef walletdb(pwalletMain);
     if (isDeterministic) {
         CSigmaMint dMint;
-        if (!walletdb.UnarchiveSigmaMint(hashPubcoin, dMint))
+        if (!walletdb->UnarchiveSigmaMint(hashPubcoin, dMint))
             return error("%s: failed to unarchive deterministic mint", __func__);
         Add(dMint, false);
     } else {
         CSigmaEntry sigma;
-        if (!walletdb.UnarchiveSigmaEntry(hashPubcoin, sigma))
+        if (!walletdb->UnarchiveSigmaEntry(hashPubcoin, sigma))
             return error("%s: failed to unarchivesigma mint", __func__);
         Add(sigma, false);
     }
@@ -82,13 +136,11 @@ bool CSigmaTracker::Get(const uint256 &hashSerial, CMintMeta& mMeta)
 
 CMintMeta CSigmaTracker::GetMetaFromPubcoin(const uint256& hashPubcoin)
 {
-    for (auto it : mapSerialHashes) {
-        CMintMeta meta = it.second;
-        if (GetPubCoinValueHash(meta.pubCoinValue) == hashPubcoin)
-            return meta;
-    }
+    auto it = mapPubcoinHashes.find(hashPubcoin);
+    if (it == mapPubcoinHashes.end())
+        return CMintMeta();
 
-    return CMintMeta();
+    return mapSerialHashes.at(it->second);
 }
 
 std::vector<uint256> CSigmaTracker::GetSerialHashes()
@@ -107,34 +159,20 @@ std::vector<uint256> CSigmaTracker::GetSerialHashes()
 
 CAmount CSigmaTracker::GetBalance(bool fConfirmedOnly, bool fUnconfirmedOnly) const
 {
-    CAmount nTotal = 0;
-    //! zerocoin specific fields
-
-    std::map<sigma::CoinDenomination, unsigned int> mySigmaSupply;
-    std::vector<sigma::CoinDenomination> denominations;
-    sigma::GetAllDenoms(denominations);
-    for(sigma::CoinDenomination denomination: denominations){
-        mySigmaSupply.insert(make_pair(denomination, 0));
-    }
+    if (fConfirmedOnly && fUnconfirmedOnly)
+        return 0;
 
-    {
-        //LOCK(cs_pivtracker);
-        // Get Unused coins
-        for (auto& it : mapSerialHashes) {
-            CMintMeta meta = it.second;
-            if (meta.isUsed || meta.isArchived)
-                continue;
-            bool fConfirmed = ((meta.nHeight < chainActive.Height()) && (meta.nHeight != INT_MAX));
-            if (fConfirmedOnly && !fConfirmed)
-                continue;
-            if (fUnconfirmedOnly && fConfirmed)
-                continue;
-            int64_t nValue;
-            sigma::DenominationToInteger(meta.denom, nValue);
-            nTotal += nValue;
-            mySigmaSupply.at(meta.denom)++;
-        }
-    }
+    // A mint is confirmed once it is below the tip, so only the few buckets at or above the
+    // tip height (and the INT_MAX bucket of mints without a height yet) are walked.
+    CAmount nUnconfirmed = 0;
+    for (auto it = mapUnusedValueByHeight.lower_bound(chainActive.Height()); it != mapUnusedValueByHeight.end(); ++it)
+        nUnconfirmed += it->second;
+
+    CAmount nTotal = nUnusedValueTotal;
+    if (fConfirmedOnly)
+        nTotal -= nUnconfirmed;
+    else if (fUnconfirmedOnly)
+        nTotal = nUnconfirmed;
 
     if (nTotal < 0 ) nTotal = 0; // Sanity never hurts
 
@@ -146,33 +184,46 @@ CAmount CSigmaTracker::GetUnconfirmedBalance() const
     return GetBalance(false, true);
 }
 
+static bool IsListedMint(const CMintMeta& mint, bool fConfirmedOnly, bool fInactive)
+{
+    if ((mint.isArchived || mint.isUsed) && fInactive)
+        return false;
+    if(mint.watchOnly && fConfirmedOnly)
+        return false;
+    bool fConfirmed = ((mint.nHeight != INT_MAX) && (mint.nHeight <= chainActive.Height()));
+    if (fConfirmedOnly && !fConfirmed)
+        return false;
+    return true;
+}
+
 std::list<CMintMeta> CSigmaTracker::GetMints(bool fConfirmedOnly, bool fInactive) const
 {
     LOCK(cs_main);
     std::list<CMintMeta> vMints;
     for (auto& it : mapSerialHashes) {
-        CMintMeta mint = it.second;
-        if ((mint.isArchived || mint.isUsed) && fInactive)
-            continue;
-        if(mint.watchOnly && fConfirmedOnly)
-            continue;
-        bool fConfirmed = ((mint.nHeight != INT_MAX) && (mint.nHeight <= chainActive.Height()));
-        if (fConfirmedOnly && !fConfirmed)
-            continue;
-        vMints.push_back(mint);
+        if (IsListedMint(it.second, fConfirmedOnly, fInactive))
+            vMints.push_back(it.second);
     }
     return vMints;
 }
 
-//Does a mint in the tracker have this txid
-bool CSigmaTracker::HasMintTx(const uint256& txid)
+std::list<CMintMeta> CSigmaTracker::GetMintsPage(std::pair<int, uint256>& cursor, size_t nCount, bool fConfirmedOnly, bool fInactive) const
 {
-    for (auto it : mapSerialHashes) {
-        if (it.second.txid == txid)
-            return true;
+    LOCK(cs_main);
+    std::list<CMintMeta> vMints;
+    for (auto it = setMintsByHeight.upper_bound(cursor); it != setMintsByHeight.end() && vMints.size() < nCount; ++it) {
+        cursor = *it;
+        const CMintMeta& mint = mapSerialHashes.at(it->second);
+        if (IsListedMint(mint, fConfirmedOnly, fInactive))
+            vMints.push_back(mint);
     }
+    return vMints;
+}
 
-    return false;
+//Does a mint in the tracker have this txid
+bool CSigmaTracker::HasMintTx(const uint256& txid)
+{
+    return mapMintTxids.count(txid) > 0;
 }
 
 bool CSigmaTracker::HasPubcoin(const GroupElement &pubcoin) const
@@ -184,12 +235,7 @@ bool CSigmaTracker::HasPubcoin(const GroupElement &pubcoin) const
 
 bool CSigmaTracker::HasPubcoinHash(const uint256& hashPubcoin) const
 {
-    for (auto it : mapSerialHashes) {
-        CMintMeta meta = it.second;
-        if (GetPubCoinValueHash(meta.pubCoinValue) == hashPubcoin)
-            return true;
-    }
-    return false;
+    return mapPubcoinHashes.count(hashPubcoin) > 0;
 }
 
 bool CSigmaTracker::HasSerial(const Scalar& bnSerial) const
@@ -217,26 +263,26 @@ bool CSigmaTracker::UpdateZerocoinEntry(const CSigmaEntry& sigma)
     meta.isUsed = sigma.IsUsed;
     meta.denom = sigma.get_denomination();
     meta.nHeight = sigma.nHeight;
-    mapSerialHashes.at(hashSerial) = meta;
+    Store(meta);
 
     //Write to db
-    return CWalletDB(pwalletMain->GetDBHandle()).WriteSigmaEntry(sigma);
+    return CWalletDBRef(pwalletMain)->WriteSigmaEntry(sigma);
 }
 
 bool CSigmaTracker::UpdateState(const CMintMeta& meta)
 {
     uint256 hashPubcoin = GetPubCoinValueHash(meta.pubCoinValue);
-    CWalletDB walletdb(pwalletMain->GetDBHandle());
+    CWalletDBRef walletdb(pwalletMain);
 
     if (meta.isDeterministic) {
         CSigmaMint dMint;
-        if (!walletdb.ReadSigmaMint(hashPubcoin, dMint)) {
+        if (!walletdb->ReadSigmaMint(hashPubcoin, dMint)) {
             // Check archive just in case
             if (!meta.isArchived)
                 return error("%s: failed to read deterministic mint from database", __func__);
 
             // Unarchive this mint since it is being requested and updated
-            if (!walletdb.UnarchiveSigmaMint(hashPubcoin, dMint))
+            if (!walletdb->UnarchiveSigmaMint(hashPubcoin, dMint))
                 return error("%s: failed to unarchive deterministic mint from database", __func__);
         }
 
@@ -245,7 +291,7 @@ bool CSigmaTracker::UpdateState(const CMintMeta& meta)
         dMint.SetUsed(meta.isUsed);
         dMint.SetDenomination(meta.denom);
 
-        if (!walletdb.WriteSigmaMint(dMint))
+        if (!walletdb->WriteSigmaMint(dMint))
             return error("%s: failed to update deterministic mint when writing to db", __func__);
     } else {
         CSigmaEntry sigma;
@@ -257,11 +303,11 @@ bool CSigmaTracker::UpdateState(const CMintMeta& meta)
         sigma.IsUsed = meta.isUsed;
         sigma.set_denomination(meta.denom);
 
-        if (!walletdb.WriteSigmaEntry(sigma))
+        if (!walletdb->WriteSigmaEntry(sigma))
             return error("%s: failed to write mint to database", __func__);
     }
 
-    mapSerialHashes[meta.hashSerial] = meta;
+    Store(meta);
 
     return true;
 }
@@ -285,10 +331,10 @@ void CSigmaTracker::Add(const CSigmaMint& dMint, bool isNew, bool isArchived, CG
     if (!isGhostWalletInitialized)
         delete ghostWallet;
 
-    mapSerialHashes[meta.hashSerial] = meta;
+    Store(meta);
 
     if (isNew)
-        CWalletDB(pwalletMain->GetDBHandle()).WriteSigmaMint(dMint);
+        CWalletDBRef(pwalletMain)->WriteSigmaMint(dMint);
 }
 
 void CSigmaTracker::Add(const CSigmaEntry& sigma, bool isNew, bool isArchived)
@@ -304,10 +350,10 @@ void CSigmaTracker::Add(const CSigmaEntry& sigma, bool isNew, bool isArchived)
     meta.isArchived = isArchived;
     meta.isDeterministic = false;
     meta.isSeedCorrect = true;
-    mapSerialHashes[meta.hashSerial] = meta;
+    Store(meta);
 
     if (isNew)
-        CWalletDB(pwalletMain->GetDBHandle()).WriteSigmaEntry(sigma);
+        CWalletDBRef(pwalletMain)->WriteSigmaEntry(sigma);
 }
 
 void CSigmaTracker::SetPubcoinUsed(const uint256& hashPubcoin, const uint256& txid)
@@ -392,8 +438,9 @@ bool CSigmaTracker::UpdateStatusInternal(const std::set<uint256>& setMempool, CM
         if (setMempool.count(mint.txid))
             return true;
 
-        // Check the transaction associated with this mint
-        if (!IsInitialBlockDownload() && !GetTransaction(mint.txid, tx, Params().GetConsensus(), hashBlock, true)) {
+        // Check the transaction associated with this mint. The mints of the sigma state are in the
+        // active chain, their blocks needn't be read, which pruning may not allow
+        if (!isMintInChain && !IsInitialBlockDownload() && !GetTransaction(mint.txid, tx, Params().GetConsensus(), hashBlock, true)) {
             LogPrintf("%s : Failed to find tx for mint txid=%s\n", __func__, mint.txid.GetHex());
             mint.isArchived = true;
             Archive(mint);
@@ -403,8 +450,8 @@ bool CSigmaTracker::UpdateStatusInternal(const std::set<uint256>& setMempool, CM
         bool isUpdated = false;
 
         // An orphan tx if hashblock is in mapBlockIndex but not in chain active
-        if (mapBlockIndex.count(hashBlock)){
-            if(!chainActive.Contains(mapBlockIndex.at(hashBlock))) {
+        if (isMintInChain || mapBlockIndex.count(hashBlock)){
+            if(!isMintInChain && !chainActive.Contains(mapBlockIndex.at(hashBlock))) {
                 LogPrintf("%s : Found orphaned mint txid=%s\n", __func__, mint.txid.GetHex());
                 mint.isUsed = false;
                 mint.nHeight = 0;
@@ -451,8 +498,9 @@ bool CSigmaTracker::UpdateMints(std::set<uint256> serialHashes, bool fReset, boo
         return false;
 
     std::list<CSigmaEntry> listMintsDB;
-    CWalletDB walletdb(pwalletMain->GetDBHandle());
-    walletdb.ListSigmaEntries(listMintsDB);
+    CWalletBatchScope batch(pwalletMain);
+    CWalletDBRef walletdb(pwalletMain);
+    walletdb->ListSigmaEntries(listMintsDB);
     for (auto& mint : listMintsDB){
         if(fReset){
             mint.nHeight = INT_MAX;
@@ -467,7 +515,7 @@ bool CSigmaTracker::UpdateMints(std::set<uint256> serialHashes, bool fReset, boo
             Add(mint);
         }
     }
-    std::list<CSigmaMint> listDeterministicDB = walletdb.ListSigmaMints();
+    std::list<CSigmaMint> listDeterministicDB = walletdb->ListSigmaMints();
 
     CGhostWallet* zerocoinWallet = new CGhostWallet(pwalletMain);
     for (auto& dMint : listDeterministicDB) {
@@ -558,4 +606,9 @@ std::vector<CMintMeta> CSigmaTracker::ListMints(bool fUnusedOnly, bool fMatureOn
 void CSigmaTracker::Clear()
 {
     mapSerialHashes.clear();
+    setMintsByHeight.clear();
+    mapPubcoinHashes.clear();
+    mapMintTxids.clear();
+    mapUnusedValueByHeight.clear();
+    nUnusedValueTotal = 0;
 }
@@ -6,7 +6,10 @@
 #define SIGMA_TRACKER_H
 
 #include <wallet/wallet.h>
+#include <validation.h>
 #include <list>
+#include <set>
+#include <unordered_map>
 
 class CSigmaMint;
 class CSigmaWallet;
@@ -18,7 +21,17 @@ private:
     CWallet *pwalletMain;
     std::map<uint256, CMintMeta> mapSerialHashes;
     std::map<uint256, uint256> mapPendingSpends; //serialhash, txid of spend
+    // indexes of mapSerialHashes, kept up to date by Store()
+    std::unordered_map<uint256, uint256, BlockHasher> mapPubcoinHashes; //pubcoinhash, serialhash
+    std::unordered_multimap<uint256, uint256, BlockHasher> mapMintTxids; //txid of mint, serialhash
+    // value of the unused, unarchived mints by mint height, kept up to date by Store()
+    std::map<int, CAmount> mapUnusedValueByHeight; //height, value
+    CAmount nUnusedValueTotal;
+    // mapSerialHashes in mint height order for paging, kept up to date by Store()
+    std::set<std::pair<int, uint256>> setMintsByHeight; //height, serialhash
     bool UpdateStatusInternal(const std::set<uint256>& setMempool, CMintMeta& mint);
+    void Store(const CMintMeta& meta);
+    void AddToBalance(const CMintMeta& meta, int nSign);
 public:
     CSigmaTracker(CWallet *pwalletMain);
     ~CSigmaTracker();
@@ -38,6 +51,8 @@ public:
     std::vector<uint256> GetSerialHashes();
     bool UpdateMints(std::set<uint256> serialHashes, bool fReset, bool fUpdateStatus, bool fStatus=false);
     std::list<CMintMeta> GetMints(bool fConfirmedOnly, bool fInactive = true) const;
+    // Up to nCount mints of GetMints in height order following cursor (height, serialhash), cursor is moved past them
+    std::list<CMintMeta> GetMintsPage(std::pair<int, uint256>& cursor, size_t nCount, bool fConfirmedOnly, bool fInactive = true) const;
     CAmount GetUnconfirmedBalance() const;
     bool MintMetaToZerocoinEntries(std::list <CSigmaEntry>& entries, std::list<CMintMeta> setMints) const;
     std::vector<CMintMeta> ListMints(bool fUnusedOnly, bool fMatureOnly, bool fUpdateStatus, bool fWrongSeed = false);
@@ -0,0 +1,178 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/spendjobs.h>
+
+#include <util.h>
+#include <utiltime.h>
+#include <wallet/wallet.h>
+
+#include <algorithm>
+
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/thread.hpp>
+
+CSpendJobQueue spendJobQueue;
+
+std::string SpendJobStatusString(CSpendJob::Status status)
+{
+    switch (status) {
+    case CSpendJob::QUEUED: return "queued";
+    case CSpendJob::RUNNING: return "running";
+    case CSpendJob::DONE: return "done";
+    case CSpendJob::CANCELLED: return "cancelled";
+    }
+    return "unknown";
+}
+
+void CSpendJobQueue::Start(int nThreads)
+{
+    nThreads = std::max(nThreads, 1);
+    LogPrintf("Starting %d spend job thread%s\n", nThreads, nThreads > 1 ? "s" : "");
+    for (int i = 0; i < nThreads; ++i)
+        threads.emplace_back(&CSpendJobQueue::ThreadRun, this);
+}
+
+void CSpendJobQueue::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        fStop = true;
+        // running spends stop before their next batch
+        for (auto& entry : mapJobs)
+            entry.second->fCancel = true;
+    }
+    cond.notify_all();
+    for (std::thread& t : threads)
+        t.join();
+    threads.clear();
+}
+
+int64_t CSpendJobQueue::Submit(CWallet* pwallet, const std::string& strAmount, const std::string& strToKey, const std::vector<CScript>& vPubCoinScripts)
+{
+    std::shared_ptr<CSpendJob> job = std::make_shared<CSpendJob>();
+    job->pwallet = pwallet;
+    job->strAmount = strAmount;
+    job->strToKey = strToKey;
+    job->vPubCoinScripts = vPubCoinScripts;
+    job->nTimeSubmitted = GetTime();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        job->nId = ++nLastId;
+        mapJobs[job->nId] = job;
+        queue.push_back(job);
+    }
+    cond.notify_all();
+    return job->nId;
+}
+
+bool CSpendJobQueue::Get(int64_t nId, CSpendJob& job)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = mapJobs.find(nId);
+    if (it == mapJobs.end())
+        return false;
+    job = *it->second;
+    return true;
+}
+
+std::vector<CSpendJob> CSpendJobQueue::List(const CWallet* pwallet)
+{
+    std::vector<CSpendJob> vJobs;
+    std::lock_guard<std::mutex> lock(mtx);
+    for (const auto& entry : mapJobs) {
+        if (entry.second->pwallet == pwallet)
+            vJobs.push_back(*entry.second);
+    }
+    return vJobs;
+}
+
+bool CSpendJobQueue::Cancel(int64_t nId)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = mapJobs.find(nId);
+    if (it == mapJobs.end())
+        return false;
+
+    std::shared_ptr<CSpendJob> job = it->second;
+    if (job->status == CSpendJob::QUEUED) {
+        queue.erase(std::find(queue.begin(), queue.end(), job));
+        Finish(*job, CSpendJob::CANCELLED, "Cancelled before it started");
+        return true;
+    }
+    if (job->status == CSpendJob::RUNNING) {
+        job->fCancel = true;
+        return true;
+    }
+    return false;
+}
+
+void CSpendJobQueue::Finish(CSpendJob& job, CSpendJob::Status status, const std::string& strResult)
+{
+    job.status = status;
+    job.strResult = strResult;
+    job.nTimeFinished = GetTime();
+
+    finished.push_back(job.nId);
+    while (finished.size() > MAX_FINISHED_SPEND_JOBS) {
+        mapJobs.erase(finished.front());
+        finished.pop_front();
+    }
+
+    std::string strCmd = gArgs.GetArg("-spendjobnotify", "");
+    if (!strCmd.empty()) {
+        boost::replace_all(strCmd, "%s", std::to_string(job.nId));
+        boost::thread t(runCommand, strCmd); // thread runs free
+    }
+}
+
+void CSpendJobQueue::ThreadRun()
+{
+    RenameThread("nix-spendjobs");
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        // the first queued job of a wallet not running one already
+        std::deque<std::shared_ptr<CSpendJob>>::iterator it;
+        cond.wait(lock, [this, &it] {
+            if (fStop)
+                return true;
+            it = std::find_if(queue.begin(), queue.end(), [this](const std::shared_ptr<CSpendJob>& job) {
+                return std::find(vBusyWallets.begin(), vBusyWallets.end(), job->pwallet) == vBusyWallets.end();
+            });
+            return it != queue.end();
+        });
+        if (fStop)
+            return;
+
+        std::shared_ptr<CSpendJob> job = *it;
+        queue.erase(it);
+        vBusyWallets.push_back(job->pwallet);
+        job->status = CSpendJob::RUNNING;
+        job->nTimeStarted = GetTime();
+        lock.unlock();
+
+        bool fCancelled = false;
+        std::string strResult;
+        try {
+            strResult = job->pwallet->GhostModeSpendSigma(job->strAmount, job->strToKey, job->vPubCoinScripts,
+                [this, &job, &fCancelled](int nBatch, int nBatches) {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    job->nBatch = nBatch;
+                    job->nBatches = nBatches;
+                    // the call after the last batch only reports progress
+                    fCancelled = job->fCancel && nBatch < nBatches;
+                    return !fCancelled;
+                });
+        } catch (const std::exception& e) {
+            strResult = strprintf("GhostModeSpendSigma(): Error: %s", e.what());
+        }
+        LogPrintf("spend job %d: %s\n", job->nId, strResult);
+
+        lock.lock();
+        vBusyWallets.erase(std::find(vBusyWallets.begin(), vBusyWallets.end(), job->pwallet));
+        Finish(*job, fCancelled ? CSpendJob::CANCELLED : CSpendJob::DONE, strResult);
+        // a job of the same wallet may be waiting
+        cond.notify_all();
+    }
+}
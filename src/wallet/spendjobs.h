@@ -0,0 +1,94 @@
+// Copyright (c) 2018-2020 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NIX_WALLET_SPENDJOBS_H
+#define NIX_WALLET_SPENDJOBS_H
+
+#include <script/script.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CWallet;
+
+//! -spendjobthreads default
+static const int DEFAULT_SPEND_JOB_THREADS = 1;
+//! Finished spend jobs kept for getspendjob
+static const size_t MAX_FINISHED_SPEND_JOBS = 1000;
+
+/** A sigma spend submitted through unghostamountasync, guarded by the mutex of its queue */
+struct CSpendJob
+{
+    enum Status {
+        QUEUED,
+        RUNNING,
+        DONE,
+        CANCELLED,
+    };
+
+    int64_t nId;
+    CWallet* pwallet;
+    std::string strAmount;
+    std::string strToKey;
+    std::vector<CScript> vPubCoinScripts;
+
+    Status status = QUEUED;
+    bool fCancel = false;
+    // spend batches started and total, known once the job runs
+    int nBatch = 0;
+    int nBatches = 0;
+    // what unghostamountv2 would have returned
+    std::string strResult;
+    int64_t nTimeSubmitted = 0;
+    int64_t nTimeStarted = 0;
+    int64_t nTimeFinished = 0;
+};
+
+std::string SpendJobStatusString(CSpendJob::Status status);
+
+/**
+ * Runs sigma spends off the RPC worker threads. Proving a spend takes seconds, so the
+ * RPC only queues it and returns a job id to poll with getspendjob. A wallet runs one
+ * job at a time since concurrent spends would select the same mints, jobs of different
+ * wallets run in parallel up to the number of threads.
+ */
+class CSpendJobQueue
+{
+public:
+    void Start(int nThreads);
+    void Stop();
+
+    /** Queue a spend, returns the job id */
+    int64_t Submit(CWallet* pwallet, const std::string& strAmount, const std::string& strToKey, const std::vector<CScript>& vPubCoinScripts);
+    /** Copy of a job, false if unknown */
+    bool Get(int64_t nId, CSpendJob& job);
+    std::vector<CSpendJob> List(const CWallet* pwallet);
+
+    /** Cancel a queued job or stop a running one before its next batch. False if already finished */
+    bool Cancel(int64_t nId);
+
+private:
+    void ThreadRun();
+    void Finish(CSpendJob& job, CSpendJob::Status status, const std::string& strResult);
+
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::map<int64_t, std::shared_ptr<CSpendJob>> mapJobs;
+    std::deque<std::shared_ptr<CSpendJob>> queue;
+    std::deque<int64_t> finished;
+    std::vector<const CWallet*> vBusyWallets;
+    std::vector<std::thread> threads;
+    int64_t nLastId = 0;
+    bool fStop = false;
+};
+
+extern CSpendJobQueue spendJobQueue;
+
+#endif // NIX_WALLET_SPENDJOBS_H
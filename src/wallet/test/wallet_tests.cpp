@@ -602,6 +602,52 @@ BOOST_AUTO_TEST_CASE(LoadReceiveRequests)
     BOOST_CHECK_EQUAL(values[1], "val_rr1");
 }
 
+BOOST_AUTO_TEST_CASE(ismine_cache)
+{
+    CWallet wallet;
+    CKey key;
+    key.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+
+    // cached and filtered answers have to follow keys, scripts and watch-only scripts added later
+    CTxOut p2pkh(0, GetScriptForDestination(pubkey.GetID()));
+    CTxOut p2wpkh(0, GetScriptForDestination(WitnessV0KeyHash(pubkey.GetID())));
+    CTxOut p2pk(0, GetScriptForRawPubKey(pubkey));
+    BOOST_CHECK_EQUAL(wallet.IsMine(p2pkh), ISMINE_NO);
+    BOOST_CHECK_EQUAL(wallet.IsMine(p2wpkh), ISMINE_NO);
+    BOOST_CHECK_EQUAL(wallet.IsMine(p2pk), ISMINE_NO);
+    {
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK(wallet.AddKeyPubKey(key, pubkey));
+    }
+    BOOST_CHECK_EQUAL(wallet.IsMine(p2pkh), ISMINE_SPENDABLE);
+    BOOST_CHECK_EQUAL(wallet.IsMine(p2wpkh), ISMINE_SPENDABLE);
+    BOOST_CHECK_EQUAL(wallet.IsMine(p2pk), ISMINE_SPENDABLE);
+
+    CTxOut p2sh(0, GetScriptForDestination(CScriptID(p2pkh.scriptPubKey)));
+    BOOST_CHECK_EQUAL(wallet.IsMine(p2sh), ISMINE_NO);
+    {
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK(wallet.AddCScript(p2pkh.scriptPubKey));
+    }
+    BOOST_CHECK_EQUAL(wallet.IsMine(p2sh), ISMINE_SPENDABLE);
+
+    CKey other;
+    other.MakeNewKey(true);
+    CTxOut watched(0, GetScriptForDestination(other.GetPubKey().GetID()));
+    BOOST_CHECK_EQUAL(wallet.IsMine(watched), ISMINE_NO);
+    {
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK(wallet.AddWatchOnly(watched.scriptPubKey, 0));
+    }
+    BOOST_CHECK(wallet.IsMine(watched) & ISMINE_WATCH_ONLY);
+    {
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK(wallet.RemoveWatchOnly(watched.scriptPubKey));
+    }
+    BOOST_CHECK_EQUAL(wallet.IsMine(watched), ISMINE_NO);
+}
+
 class ListCoinsTestingSetup : public TestChain100Setup
 {
 public:
@@ -15,6 +15,7 @@
 #include <wallet/init.h>
 #include <key.h>
 #include <keystore.h>
+#include <lifecycle.h>
 #include <validation.h>
 #include <net.h>
 #include <policy/fees.h>
@@ -25,6 +26,7 @@
 #include <script/script.h>
 #include <scheduler.h>
 #include <timedata.h>
+#include <txdb.h>
 #include <txmempool.h>
 #include <util.h>
 #include <utilmoneystr.h>
@@ -32,6 +34,8 @@
 #include <utilstrencodings.h>
 #include <assert.h>
 #include <future>
+#include <deque>
+#include <condition_variable>
 #include <rpc/protocol.h>
 #include "ghostnode/activeghostnode.h"
 #include "ghostnode/darksend.h"
@@ -43,7 +47,9 @@
 #include "random.h"
 #include <ghost-address/commitmentkey.h>
 #include <wallet/ghostwallet.h>
+#include <wallet/ghostkeypool.h>
 #include <wallet/autoghoster.h>
+#include <sigma/parallel.h>
 
 #include <rpc/server.h>
 #include <pos/kernel.h>
@@ -58,6 +64,7 @@ std::vector<CWalletRef> vpwallets;
 CFeeRate payTxFee(DEFAULT_TRANSACTION_FEE);
 unsigned int nTxConfirmTarget = DEFAULT_TX_CONFIRM_TARGET;
 bool bSpendZeroConfChange = DEFAULT_SPEND_ZEROCONF_CHANGE;
+int nSigmaProverThreads = 1;
 bool fWalletRbf = DEFAULT_WALLET_RBF;
 
 const char * DEFAULT_WALLET_DAT = "wallet.dat";
@@ -470,6 +477,10 @@ bool CWallet::RemoveWatchOnly(const CScript &dest)
     AssertLockHeld(cs_wallet);
     if (!CCryptoKeyStore::RemoveWatchOnly(dest))
         return false;
+    {
+        LOCK(cs_ismine);
+        ClearIsMineCache();
+    }
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
     if (!CWalletDB(*dbw).EraseWatchOnly(dest))
@@ -693,9 +704,11 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
     return false;
 }
 
-void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
+void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid, bool fSyncMetaData)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
+    if (!fSyncMetaData)
+        return;
 
     std::pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
@@ -703,7 +716,7 @@ void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 }
 
 
-void CWallet::AddToSpends(const uint256& wtxid)
+void CWallet::AddToSpends(const uint256& wtxid, bool fSyncMetaData)
 {
     auto it = mapWallet.find(wtxid);
     assert(it != mapWallet.end());
@@ -711,7 +724,27 @@ void CWallet::AddToSpends(const uint256& wtxid)
     if (thisTx.IsCoinBase() || thisTx.tx->IsZerocoinSpend() || thisTx.tx->IsSigmaSpend()) // Coinbases and zerocoin spends don't spend anything!
         return;
     for (const CTxIn& txin : thisTx.tx->vin)
-        AddToSpends(txin.prevout, wtxid);
+        AddToSpends(txin.prevout, wtxid, fSyncMetaData);
+}
+
+void CWallet::AddToStakeCandidates(const CWalletTx& wtx)
+{
+    const uint256 &wtxid = wtx.GetHash();
+    for (size_t i = 0; i < wtx.tx->vout.size(); ++i)
+    {
+        CScriptID script_dest;
+        WitnessV0KeyHash wit_script_dest;
+        if (ExtractStakingKeyID(wtx.tx->vout[i].scriptPubKey, script_dest, wit_script_dest))
+            setStakeCandidates.insert(COutPoint(wtxid, i));
+    }
+}
+
+void CWallet::RebuildStakeCandidates()
+{
+    AssertLockHeld(cs_wallet);
+    setStakeCandidates.clear();
+    for (const auto &item : mapWallet)
+        AddToStakeCandidates(item.second);
 }
 
 bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
@@ -968,6 +1001,41 @@ bool CWallet::GetAccountDestination(CTxDestination &dest, std::string strAccount
     return true;
 }
 
+// batch opened by the outermost CWalletBatchScope on this thread, joined by CWalletDBRef
+static thread_local CWallet* pwalletBatch = nullptr;
+static thread_local CWalletDB* pwalletdbBatch = nullptr;
+
+CWalletBatchScope::CWalletBatchScope(CWallet* pwallet) : m_prev_wallet(pwalletBatch), m_prev_batch(pwalletdbBatch)
+{
+    if (pwalletBatch == pwallet)
+        return; // nested, the outer scope owns the batch
+
+    // No BDB transaction is held across the batch: the sigma and ghost wallet code reads
+    // through handles of its own mid-operation, which would block on the pages it locks.
+    // Each write still autocommits, only the flush is deferred.
+    m_batch.reset(new CWalletDB(pwallet->GetDBHandle()));
+    pwalletBatch = pwallet;
+    pwalletdbBatch = m_batch.get();
+}
+
+CWalletBatchScope::~CWalletBatchScope()
+{
+    if (!m_batch)
+        return;
+    pwalletBatch = m_prev_wallet;
+    pwalletdbBatch = m_prev_batch;
+}
+
+CWalletDBRef::CWalletDBRef(CWallet* pwallet, bool fFlushOnClose)
+{
+    if (pwalletBatch == pwallet) {
+        m_batch = pwalletdbBatch;
+    } else {
+        m_owned.reset(new CWalletDB(pwallet->GetDBHandle(), "r+", fFlushOnClose));
+        m_batch = m_owned.get();
+    }
+}
+
 void CWallet::MarkDirty()
 {
     {
@@ -975,6 +1043,7 @@ void CWallet::MarkDirty()
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
     }
+    fStakeWeightDirty = true;
 }
 
 bool CWallet::MarkReplaced(const uint256& originalHash, const uint256& newHash)
@@ -1010,7 +1079,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 {
     LOCK(cs_wallet);
 
-    CWalletDB walletdb(*dbw, "r+", fFlushOnClose);
+    CWalletDBRef walletdb(this, fFlushOnClose);
 
     uint256 hash = wtxIn.GetHash();
 
@@ -1022,11 +1091,13 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
     if (fInsertedNew)
     {
         wtx.nTimeReceived = GetAdjustedTime();
-        wtx.nOrderPos = IncOrderPosNext(&walletdb);
+        wtx.nOrderPos = IncOrderPosNext(&*walletdb);
         wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, nullptr)));
         wtx.nTimeSmart = ComputeTimeSmart(wtx);
         AddToSpends(hash);
+        AddToStakeCandidates(wtx);
     }
+    fStakeWeightDirty = true;
 
     bool fUpdated = false;
     if (!fInsertedNew)
@@ -1076,7 +1147,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     // Write to disk
     if (fInsertedNew || fUpdated)
-        if (!walletdb.WriteTx(wtx))
+        if (!walletdb->WriteTx(wtx))
             return false;
 
     // Break debit/credit balance caches:
@@ -1103,7 +1174,8 @@ bool CWallet::LoadToWallet(const CWalletTx& wtxIn)
     CWalletTx& wtx = mapWallet.emplace(hash, wtxIn).first->second;
     wtx.BindWallet(this);
     wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, nullptr)));
-    AddToSpends(hash);
+    // metadata sync and stake candidates are left to FinishLoadTransactions
+    AddToSpends(hash, false);
     for (const CTxIn& txin : wtx.tx->vin) {
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
@@ -1129,6 +1201,20 @@ bool CWallet::LoadToWallet(const CWalletTx& wtxIn)
     return true;
 }
 
+void CWallet::FinishLoadTransactions()
+{
+    AssertLockHeld(cs_wallet);
+    // The oldest spender of an outpoint hands its metadata to the others, the same
+    // result the per record sync gives but one pass over the spends
+    for (auto it = mapTxSpends.begin(); it != mapTxSpends.end(); ) {
+        std::pair<TxSpends::iterator, TxSpends::iterator> range = mapTxSpends.equal_range(it->first);
+        if (std::next(range.first) != range.second)
+            SyncMetaData(range);
+        it = range.second;
+    }
+    RebuildStakeCandidates();
+}
+
 bool CWallet::LoadToWallet(const uint256 &hash, const CTransactionRecord &rtx)
 {
     std::pair<MapRecords_t::iterator, bool> ret = mapRecords.insert(std::make_pair(hash, rtx));
@@ -1195,6 +1281,8 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const CBlockI
                     CAmount nVal = txOut.nValue;
                     sigma::IntegerToDenomination(nVal,  denom);
                     ghostWalletMain->SetMintSeen(pubcoin, (pIndex == nullptr) ? INT_MAX : pIndex->nHeight, tx.GetHash(), denom);
+                    // a rescan then also finds the mints that followed this one
+                    ghostWalletMain->ExtendMintPool();
                 }
             }
         }
@@ -1491,6 +1579,9 @@ void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx) {
     if (it != mapWallet.end()) {
         it->second.fInMempool = true;
     }
+
+    RefreshStakeWeight();
+    TraceLifecycle(LifecycleObject::TX, ptx->GetHash(), LifecycleStage::WALLET_NOTIFIED);
 }
 
 void CWallet::TransactionRemovedFromMempool(const CTransactionRef &ptx) {
@@ -1503,6 +1594,7 @@ void CWallet::TransactionRemovedFromMempool(const CTransactionRef &ptx) {
 
 void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) {
     LOCK2(cs_main, cs_wallet);
+    CWalletBatchScope batch(this);
     // TODO: Temporarily ensure that mempool removals are notified before
     // connected transactions.  This shouldn't matter, but the abandoned
     // state of transactions in our wallet is currently cleared when we
@@ -1515,12 +1607,18 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
         SyncTransaction(ptx);
         TransactionRemovedFromMempool(ptx);
     }
+    // every output's depth moved, refreshed once the tip settles in UpdatedBlockTip
+    fStakeWeightDirty = true;
+
     for (size_t i = 0; i < pblock->vtx.size(); i++) {
         SyncTransaction(pblock->vtx[i], pindex, i);
         TransactionRemovedFromMempool(pblock->vtx[i]);
     }
 
+    AdvanceZerocoinWitnesses(pindex);
+
     m_last_block_processed = pindex;
+    TraceLifecycle(LifecycleObject::BLOCK, pindex->GetBlockHash(), LifecycleStage::WALLET_NOTIFIED);
 }
 
 void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) {
@@ -1529,6 +1627,22 @@ void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) {
     for (const CTransactionRef& ptx : pblock->vtx) {
         SyncTransaction(ptx);
     }
+
+    // outputs pruned as spent may be spendable again (e.g. an orphaned coinstake)
+    RebuildStakeCandidates();
+    fStakeWeightDirty = true;
+}
+
+void CWallet::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
+    // a new tip opens a new kernel search, don't leave the staking thread asleep until its next slot
+    if (fInitialDownload)
+        return;
+
+    RefreshStakeWeight();
+    WakeThreadStakeMiner(this);
+
+    LOCK(cs_sigmaSpendSets);
+    mapSigmaSpendSets.clear();
 }
 
 
@@ -1591,9 +1705,87 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
     return 0;
 }
 
+SaltedScriptHasher::SaltedScriptHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+void CWallet::KeyStoreAdded(const std::vector<unsigned char>& vchId)
+{
+    AssertLockHeld(cs_KeyStore);
+    LOCK(cs_ismine);
+    ClearIsMineCache();
+    if (nIsMineFilterEntries < nIsMineFilterCapacity) {
+        filterIsMine.insert(vchId);
+        nIsMineFilterEntries++;
+        return;
+    }
+
+    // The rolling filter would start forgetting, refill one twice the size of the key store
+    nIsMineFilterCapacity = std::max<size_t>(ISMINE_FILTER_MIN_ELEMENTS,
+        2 * (mapKeys.size() + mapCryptedKeys.size() + mapWatchKeys.size() + mapScripts.size() + setWatchOnly.size()));
+    filterIsMine = CRollingBloomFilter(nIsMineFilterCapacity, ISMINE_FILTER_FP_RATE);
+    for (const auto& entry : mapKeys)
+        filterIsMine.insert(ToByteVector(entry.first));
+    for (const auto& entry : mapCryptedKeys)
+        filterIsMine.insert(ToByteVector(entry.first));
+    for (const auto& entry : mapWatchKeys)
+        filterIsMine.insert(ToByteVector(entry.first));
+    for (const auto& entry : mapScripts)
+        filterIsMine.insert(ToByteVector(entry.first));
+    for (const CScript& script : setWatchOnly)
+        filterIsMine.insert(ToByteVector(script));
+    nIsMineFilterEntries = mapKeys.size() + mapCryptedKeys.size() + mapWatchKeys.size() + mapScripts.size() + setWatchOnly.size();
+}
+
+void CWallet::ClearIsMineCache()
+{
+    AssertLockHeld(cs_ismine);
+    nIsMineGeneration++;
+    mapIsMineCache.clear();
+}
+
+bool CWallet::IsMineFilterRejects(const CScript& script) const
+{
+    AssertLockHeld(cs_ismine);
+    // These pay to an id that has to be in the key store, unless the script itself is watched.
+    // A witness key hash is also ours when the pay to key hash script of its key is watched.
+    std::vector<unsigned char> vchId;
+    if (script.IsPayToPublicKeyHash())
+        vchId.assign(script.begin() + 3, script.begin() + 23);
+    else if (script.IsPayToScriptHash() || script.IsPayToWitnessKeyHash())
+        vchId.assign(script.begin() + 2, script.begin() + 22);
+    else
+        return false;
+
+    if (filterIsMine.contains(vchId) || filterIsMine.contains(ToByteVector(script)))
+        return false;
+    if (script.IsPayToWitnessKeyHash() && filterIsMine.contains(ToByteVector(GetScriptForDestination(CKeyID(uint160(vchId))))))
+        return false;
+    return true;
+}
+
 isminetype CWallet::IsMine(const CTxOut& txout) const
 {
-    return ::IsMine(*this, txout.scriptPubKey);
+    const CScript& script = txout.scriptPubKey;
+    uint64_t nGeneration;
+    {
+        LOCK(cs_ismine);
+        if (IsMineFilterRejects(script))
+            return ISMINE_NO;
+        auto it = mapIsMineCache.find(script);
+        if (it != mapIsMineCache.end())
+            return it->second;
+        nGeneration = nIsMineGeneration;
+    }
+
+    isminetype mine = ::IsMine(*this, script);
+
+    LOCK(cs_ismine);
+    // a key added meanwhile may have changed the answer
+    if (nGeneration == nIsMineGeneration) {
+        if (mapIsMineCache.size() >= MAX_ISMINE_CACHE_SIZE)
+            mapIsMineCache.clear();
+        mapIsMineCache.emplace(script, mine);
+    }
+    return mine;
 }
 
 CAmount CWallet::GetCredit(const CTxOut& txout, const isminefilter& filter) const
@@ -1612,7 +1804,7 @@ bool CWallet::IsChange(const CTxOut& txout) const
     // a better way of identifying which outputs are 'the send' and which are
     // 'the change' will need to be implemented (maybe extend CWalletTx to remember
     // which output, if any, was change).
-    if (::IsMine(*this, txout.scriptPubKey))
+    if (IsMine(txout))
     {
         CTxDestination address;
         if (!ExtractDestination(txout.scriptPubKey, address))
@@ -1944,6 +2136,99 @@ int64_t CWallet::RescanFromTime(int64_t startTime, const WalletRescanReserver& r
     return startTime;
 }
 
+/**
+ * Reads the blocks of a rescan on its own thread, so disk reads and deserialization
+ * overlap with the wallet matching. Blocks are pushed and popped in chain order, a failed
+ * read pops as a null block. The disk position is taken by the pushing thread under
+ * cs_main, the reader itself never locks cs_main as the scan may be run with it held.
+ */
+class CRescanBlockReader
+{
+public:
+    CRescanBlockReader()
+    {
+        thread = std::thread(&CRescanBlockReader::Run, this);
+    }
+
+    ~CRescanBlockReader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            fStop = true;
+        }
+        cond.notify_all();
+        thread.join();
+    }
+
+    size_t Size()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return queue.size();
+    }
+
+    void Push(CBlockIndex* pindex)
+    {
+        AssertLockHeld(cs_main);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            queue.push_back(Entry{pindex, pindex->GetBlockPos(), nullptr, false});
+        }
+        cond.notify_all();
+    }
+
+    std::shared_ptr<const CBlock> Pop(CBlockIndex*& pindex)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        assert(!queue.empty());
+        cond.wait(lock, [this] { return queue.front().fRead; });
+        pindex = queue.front().pindex;
+        std::shared_ptr<const CBlock> pblock = queue.front().pblock;
+        queue.pop_front();
+        --nRead;
+        return pblock;
+    }
+
+private:
+    struct Entry
+    {
+        CBlockIndex* pindex;
+        CDiskBlockPos pos;
+        std::shared_ptr<const CBlock> pblock;
+        bool fRead;
+    };
+
+    void Run()
+    {
+        RenameThread("nix-rescan");
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            cond.wait(lock, [this] { return fStop || nRead < queue.size(); });
+            if (fStop)
+                break;
+            const CBlockIndex* pindex = queue[nRead].pindex;
+            CDiskBlockPos pos = queue[nRead].pos;
+            lock.unlock();
+
+            std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+            if (!ReadBlockFromDisk(*pblock, pos, pindex, Params().GetConsensus()))
+                pblock.reset();
+
+            lock.lock();
+            queue[nRead].pblock = pblock;
+            queue[nRead].fRead = true;
+            ++nRead;
+            cond.notify_all();
+        }
+    }
+
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::deque<Entry> queue;
+    size_t nRead = 0; // queue entries before this one are read
+    bool fStop = false;
+};
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -1973,6 +2258,18 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
     CBlockIndex* pindex = pindexStart;
     CBlockIndex* ret = nullptr;
     {
+        // blocks up to pindexAhead are queued on the reader, kept RESCAN_PREFETCH_BLOCKS ahead
+        CRescanBlockReader reader;
+        CBlockIndex* pindexAhead = pindexStart;
+        auto fillReader = [&]() {
+            AssertLockHeld(cs_main);
+            while (pindexAhead != pindexStop && reader.Size() < RESCAN_PREFETCH_BLOCKS) {
+                CBlockIndex* pindexNext = chainActive.Next(pindexAhead);
+                if (!pindexNext)
+                    break;
+                reader.Push(pindexAhead = pindexNext);
+            }
+        };
         fAbortRescan = false;
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
         CBlockIndex* tip = nullptr;
@@ -1983,9 +2280,13 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
             tip = chainActive.Tip();
             dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
             dProgressTip = GuessVerificationProgress(chainParams.TxData(), tip);
+            reader.Push(pindexStart);
+            fillReader();
         }
-        while (pindex && !fAbortRescan)
+        while (!fAbortRescan && reader.Size() > 0)
         {
+            std::shared_ptr<const CBlock> pblock = reader.Pop(pindex);
+
             if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0) {
                 double gvp = 0;
                 {
@@ -2000,27 +2301,24 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
             }
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            if (pblock) {
                 LOCK2(cs_main, cs_wallet);
+                CWalletBatchScope batch(this);
                 if (pindex && !chainActive.Contains(pindex)) {
                     // Abort scan if current block is no longer active, to prevent
                     // marking transactions as coming from the wrong block.
                     ret = pindex;
                     break;
                 }
-                for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                    AddToWalletIfInvolvingMe(block.vtx[posInBlock], pindex, posInBlock, fUpdate);
+                for (size_t posInBlock = 0; posInBlock < pblock->vtx.size(); ++posInBlock) {
+                    AddToWalletIfInvolvingMe(pblock->vtx[posInBlock], pindex, posInBlock, fUpdate);
                 }
             } else {
                 ret = pindex;
             }
-            if (pindex == pindexStop) {
-                break;
-            }
             {
                 LOCK(cs_main);
-                pindex = chainActive.Next(pindex);
+                fillReader();
                 if (tip != chainActive.Tip()) {
                     tip = chainActive.Tip();
                     // in case the tip has changed, update progress max
@@ -4541,18 +4839,21 @@ void CWallet::LockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.insert(output);
+    fStakeWeightDirty = true;
 }
 
 void CWallet::UnlockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.erase(output);
+    fStakeWeightDirty = true;
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.clear();
+    fStakeWeightDirty = true;
 }
 
 bool CWallet::IsLockedCoin(uint256 hash, unsigned int n) const
@@ -4946,6 +5247,8 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
         }
     }
 
+    walletInstance->RefreshStakeWeight(true);
+
     return walletInstance;
 }
 
@@ -5959,6 +6262,102 @@ bool CWallet::CreateSigmaMintTransaction(vector <CRecipient> vecSend, CWalletTx
  * @param strFailReason
  * @return
  */
+void CWallet::LoadZerocoinWitnesses()
+{
+    AssertLockHeld(cs_wallet);
+    if (fZerocoinWitnessesLoaded)
+        return;
+
+    std::list<CZerocoinWitnessEntry> listWitness;
+    CWalletDB(*dbw).ListZerocoinWitnesses(listWitness);
+    for (const CZerocoinWitnessEntry &witness : listWitness)
+        mapZerocoinWitnesses[witness.pubCoin] = witness;
+    fZerocoinWitnessesLoaded = true;
+}
+
+libzerocoin::AccumulatorWitness CWallet::GetZerocoinWitness(int maxHeight, int denomination, int id, const CBigNum &pubCoin)
+{
+    LOCK2(cs_main, cs_wallet);
+
+    CZerocoinState *zerocoinState = CZerocoinState::GetZerocoinState();
+    libzerocoin::CoinDenomination d = (libzerocoin::CoinDenomination)denomination;
+    libzerocoin::PublicCoin coin(ZCParams, pubCoin, d);
+
+    LoadZerocoinWitnesses();
+
+    CZerocoinWitnessEntry &entry = mapZerocoinWitnesses[pubCoin];
+    BlockMap::const_iterator mi = mapBlockIndex.find(entry.hashBlock);
+    if (entry.denomination == denomination && entry.id == id && mi != mapBlockIndex.end()
+            && chainActive.Contains(mi->second) && mi->second->nHeight <= maxHeight) {
+        // only the coins minted since the stored witness are accumulated
+        CBigNum witnessValue = entry.witnessValue;
+        zerocoinState->AdvanceWitnessForSpend(&chainActive, maxHeight, denomination, id, mi->second, witnessValue);
+        entry.hashBlock = chainActive[maxHeight]->GetBlockHash();
+        if (witnessValue != entry.witnessValue) {
+            entry.witnessValue = witnessValue;
+            CWalletDB(*dbw).WriteZerocoinWitness(entry);
+        }
+        return libzerocoin::AccumulatorWitness(ZCParams, libzerocoin::Accumulator(ZCParams, witnessValue, d), coin);
+    }
+
+    libzerocoin::AccumulatorWitness witness = zerocoinState->GetWitnessForSpend(&chainActive, maxHeight, denomination, id, pubCoin);
+    entry.pubCoin = pubCoin;
+    entry.denomination = denomination;
+    entry.id = id;
+    entry.witnessValue = witness.getValue();
+    entry.hashBlock = chainActive[maxHeight]->GetBlockHash();
+    CWalletDB(*dbw).WriteZerocoinWitness(entry);
+    return witness;
+}
+
+void CWallet::AdvanceZerocoinWitnesses(const CBlockIndex *pindex)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    if (pindex->nHeight < ZEROCOIN_CONFIRM_HEIGHT + 1 || chainActive[pindex->nHeight] != pindex)
+        return;
+    LoadZerocoinWitnesses();
+
+    // the witnesses follow the accumulators spends are made against
+    const CBlockIndex *pindexWitness = chainActive[pindex->nHeight - ZEROCOIN_CONFIRM_HEIGHT];
+    const uint256 &hashPrev = pindexWitness->pprev->GetBlockHash();
+    std::shared_ptr<const CPrivacyBlockData> blockData = pprivacyindex->ReadBlock(pindexWitness);
+
+    CWalletDB walletdb(*dbw);
+    for (auto &item : mapZerocoinWitnesses) {
+        CZerocoinWitnessEntry &entry = item.second;
+        if (entry.hashBlock != hashPrev)
+            continue;
+        entry.hashBlock = pindexWitness->GetBlockHash();
+
+        auto pubCoins = blockData->mintedPubCoins.find(std::make_pair(entry.denomination, entry.id));
+        if (pubCoins == blockData->mintedPubCoins.end())
+            continue;
+        libzerocoin::CoinDenomination d = (libzerocoin::CoinDenomination)entry.denomination;
+        libzerocoin::Accumulator witness(ZCParams, entry.witnessValue, d);
+        for (const CBigNum &coin : pubCoins->second)
+            witness += libzerocoin::PublicCoin(ZCParams, coin, d);
+        entry.witnessValue = witness.getValue();
+        walletdb.WriteZerocoinWitness(entry);
+    }
+
+    if (blockData->mintedPubCoins.empty())
+        return;
+
+    // start following the coins of the wallet minted in the block
+    CZerocoinState *zerocoinState = CZerocoinState::GetZerocoinState();
+    std::list<CZerocoinEntry> listPubCoin;
+    walletdb.ListPubCoin(listPubCoin);
+    for (const CZerocoinEntry &zerocoinItem : listPubCoin) {
+        if (zerocoinItem.IsUsed || mapZerocoinWitnesses.count(zerocoinItem.value))
+            continue;
+        int id;
+        if (zerocoinState->GetMintedCoinHeightAndId(zerocoinItem.value, zerocoinItem.denomination, id) == pindexWitness->nHeight)
+            GetZerocoinWitness(pindexWitness->nHeight, zerocoinItem.denomination, id, zerocoinItem.value);
+    }
+}
+
 bool CWallet::CreateZerocoinSpendTransaction(std::string &toKey, int64_t nValue, libzerocoin::CoinDenomination denomination,
                                              CWalletTx &wtxNew, CReserveKey &reservekey, CBigNum &coinSerial,
                                              uint256 &txHash, CBigNum &zcSelectedValue, bool &zcSelectedIsUsed,
@@ -6106,10 +6505,9 @@ bool CWallet::CreateZerocoinSpendTransaction(std::string &toKey, int64_t nValue,
 
             // 4. Get witness from the index
             libzerocoin::AccumulatorWitness witness =
-                    zerocoinState->GetWitnessForSpend(&chainActive,
-                                                      chainActive.Height()-(ZEROCOIN_CONFIRM_HEIGHT),
-                                                      denomination, coinId,
-                                                      coinToUse.value);
+                    GetZerocoinWitness(chainActive.Height()-(ZEROCOIN_CONFIRM_HEIGHT),
+                                       denomination, coinId,
+                                       coinToUse.value);
 
             CTxIn newTxIn;
             newTxIn.nSequence = coinId;
@@ -6387,10 +6785,9 @@ bool CWallet::CreateZerocoinSpendTransactionBatch(std::string &toKey, vector <CS
 
                 // 4. Get witness from the index
                 libzerocoin::AccumulatorWitness witness =
-                        zerocoinState->GetWitnessForSpend(&chainActive,
-                                                          chainActive.Height()-(ZEROCOIN_CONFIRM_HEIGHT),
-                                                          denominationBatch[i], coinIdBatch[i],
-                                                          coinToUseBatch[i].value);
+                        GetZerocoinWitness(chainActive.Height()-(ZEROCOIN_CONFIRM_HEIGHT),
+                                           denominationBatch[i], coinIdBatch[i],
+                                           coinToUseBatch[i].value);
 
 
                 // We use incomplete transaction hash for now as a metadata
@@ -6889,10 +7286,9 @@ string CWallet::SpendGhostData(libzerocoin::CoinDenomination denomination, CBitc
 
     // 4. Get witness from the index
     libzerocoin::AccumulatorWitness witness =
-            zerocoinState->GetWitnessForSpend(&chainActive,
-                                              chainActive.Height()-(ZEROCOIN_CONFIRM_HEIGHT),
-                                              denomination, coinId,
-                                              coinToUse.value);
+            GetZerocoinWitness(chainActive.Height()-(ZEROCOIN_CONFIRM_HEIGHT),
+                               denomination, coinId,
+                               coinToUse.value);
 
     CTxIn newTxIn;
     newTxIn.nSequence = coinId;
@@ -8213,43 +8609,40 @@ bool CWallet::SetReserveBalance(CAmount nNewReserveBalance)
     LOCK(cs_wallet);
 
     nReserveBalance = nNewReserveBalance;
+    fStakeWeightDirty = true;
     return true;
 }
 
-uint64_t CWallet::GetStakeWeight() const
+void CWallet::RefreshStakeWeight(bool fForce)
 {
-    // Choose coins to use
-    int64_t nBalance = GetStakeableBalance();
-
-    if (nBalance <= nReserveBalance)
-        return 0;
-
-    int nHeight;
-    {
-        LOCK(cs_main);
-        nHeight = chainActive.Height()+1;
-    }
-
-    // Choose coins to use
-    std::set<std::pair<const CWalletTx*,unsigned int> > setCoins;
-    CAmount nValueIn = 0;
-
-    // Select coins with suitable depth
-    if (!SelectCoinsForStaking(nBalance - nReserveBalance, GetTime(), nHeight, setCoins, nValueIn))
-        return 0;
+    if (!fForce && !fStakeWeightDirty)
+        return;
 
-    if (setCoins.empty())
-        return 0;
+    LOCK2(cs_main, cs_wallet);
+    // clear before the walk, a change racing it marks the cache dirty again
+    fStakeWeightDirty = false;
 
+    CAmount nBalance = CalculateStakeableBalance();
     uint64_t nWeight = 0;
 
-    LOCK2(cs_main, cs_wallet);
-    for (auto pcoin : setCoins)
+    if (nBalance > nReserveBalance)
     {
-        nWeight += pcoin.first->tx->vout[pcoin.second].nValue;
+        int nHeight = chainActive.Height()+1;
+
+        // Choose coins to use
+        std::set<std::pair<const CWalletTx*,unsigned int> > setCoins;
+        CAmount nValueIn = 0;
+
+        // Select coins with suitable depth
+        if (SelectCoinsForStaking(nBalance - nReserveBalance, GetTime(), nHeight, setCoins, nValueIn))
+        {
+            for (auto pcoin : setCoins)
+                nWeight += pcoin.first->tx->vout[pcoin.second].nValue;
+        }
     }
 
-    return nWeight;
+    nStakeableBalanceCached = nBalance;
+    nStakeWeightCached = nWeight;
 }
 
 bool SortWeight(const COutput &a, const COutput &b) { return (a.tx->tx->vout[a.i].nValue/a.tx->GetTxTime()) > (b.tx->tx->vout[b.i].nValue/b.tx->GetTxTime()); }
@@ -8272,8 +8665,15 @@ void CWallet::AvailableCoinsForStaking(std::vector<COutput> &vCoins, int64_t nTi
 
         int nRequiredDepth = coinbaseMaturity + 1;
 
-        for (MapWallet_t::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        std::vector<COutPoint> vPrune;
+        for (const COutPoint &outpoint : setStakeCandidates)
         {
+            MapWallet_t::const_iterator it = mapWallet.find(outpoint.hash);
+            if (it == mapWallet.end())
+            {
+                vPrune.push_back(outpoint); // zapped
+                continue;
+            }
             const CWalletTx *pcoin = &it->second;
             CTransactionRef tx = pcoin->tx;
 
@@ -8286,80 +8686,97 @@ void CWallet::AvailableCoinsForStaking(std::vector<COutput> &vCoins, int64_t nTi
                 continue;
 
             const uint256 &wtxid = it->first;
-            for (size_t i = 0; i < tx->vout.size(); ++i)
+            unsigned int i = outpoint.n;
+            const auto &txout = tx->vout[i];
+
+            if (IsSpent(wtxid, i))
             {
-                const auto &txout = tx->vout[i];
+                // drop it for good once the spend is in the chain, BlockDisconnected rebuilds the set
+                std::pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(outpoint);
+                for (TxSpends::const_iterator itSpend = range.first; itSpend != range.second; ++itSpend)
+                {
+                    MapWallet_t::const_iterator mit = mapWallet.find(itSpend->second);
+                    if (mit != mapWallet.end() && mit->second.GetDepthInMainChainCached() > 0)
+                    {
+                        vPrune.push_back(outpoint);
+                        break;
+                    }
+                }
+                continue;
+            }
 
-                if (IsSpent(wtxid, i)|| IsLockedCoin(wtxid, i))
-                    continue;
+            if (IsLockedCoin(wtxid, i))
+                continue;
 
-                const CScript pscriptPubKey = txout.scriptPubKey;
+            const CScript pscriptPubKey = txout.scriptPubKey;
 
-                if(pscriptPubKey.IsPayToScriptHash_CS() || pscriptPubKey.IsPayToWitnessKeyHash_CS()){
-                    // Ignore witness LPOS contracts until clients are updated
-                    if(pscriptPubKey.IsPayToWitnessKeyHash_CS() && ((nHeight + 1) < Params().GetConsensus().nStartWitnessLposContracts))
+            if(pscriptPubKey.IsPayToScriptHash_CS() || pscriptPubKey.IsPayToWitnessKeyHash_CS()){
+                // Ignore witness LPOS contracts until clients are updated
+                if(pscriptPubKey.IsPayToWitnessKeyHash_CS() && ((nHeight + 1) < Params().GetConsensus().nStartWitnessLposContracts))
+                    continue;
+                // Check if contract allows fee payouts
+                int64_t feeOut = 0;
+                if(GetCoinstakeScriptFee(pscriptPubKey, feeOut)){
+                    if(feeOut < nMinimumDelagatePercentage)
                         continue;
-                    // Check if contract allows fee payouts
-                    int64_t feeOut = 0;
-                    if(GetCoinstakeScriptFee(pscriptPubKey, feeOut)){
-                        if(feeOut < nMinimumDelagatePercentage)
+                }
+                //If script does not include fee and percentage is set, skip
+                else if(nMinimumDelagatePercentage > 0)
+                    continue;
+
+                CScript scriptOut;
+                if(GetCoinstakeScriptFeeRewardAddress(pscriptPubKey, scriptOut)){
+                    if(nDelegateRewardToMe){
+                        CScriptID delegateRewardID;
+                        WitnessV0KeyHash wit_script_dest;
+                        ExtractStakingKeyID(scriptOut, delegateRewardID, wit_script_dest);
+
+                        if(!HaveCScript(delegateRewardID))
                             continue;
                     }
-                    //If script does not include fee and percentage is set, skip
-                    else if(nMinimumDelagatePercentage > 0)
-                        continue;
-
-                    CScript scriptOut;
-                    if(GetCoinstakeScriptFeeRewardAddress(pscriptPubKey, scriptOut)){
-                        if(nDelegateRewardToMe){
+                    else if(!nDelegateRewardAddresses.empty()){
+                        bool found = false;
+                        for(std::string addressString: nDelegateRewardAddresses){
                             CScriptID delegateRewardID;
                             WitnessV0KeyHash wit_script_dest;
                             ExtractStakingKeyID(scriptOut, delegateRewardID, wit_script_dest);
-
-                            if(!HaveCScript(delegateRewardID))
-                                continue;
-                        }
-                        else if(!nDelegateRewardAddresses.empty()){
-                            bool found = false;
-                            for(std::string addressString: nDelegateRewardAddresses){
-                                CScriptID delegateRewardID;
-                                WitnessV0KeyHash wit_script_dest;
-                                ExtractStakingKeyID(scriptOut, delegateRewardID, wit_script_dest);
-                                if(!wit_script_dest.IsNull()){
-                                    std::string rewardStr = EncodeDestination(wit_script_dest, true);
-                                    if(rewardStr == addressString)
-                                        found = true;
-                                }
-                                else{
-                                    std::string rewardStr = EncodeDestination(delegateRewardID);
-                                    if(rewardStr == addressString)
-                                        found = true;
-                                }
+                            if(!wit_script_dest.IsNull()){
+                                std::string rewardStr = EncodeDestination(wit_script_dest, true);
+                                if(rewardStr == addressString)
+                                    found = true;
+                            }
+                            else{
+                                std::string rewardStr = EncodeDestination(delegateRewardID);
+                                if(rewardStr == addressString)
+                                    found = true;
                             }
-                            if(!found)
-                                continue;
-
                         }
+                        if(!found)
+                            continue;
 
                     }
-                    //If script does not include reward addres and fields are set, skip
-                    else if(nDelegateRewardToMe || !nDelegateRewardAddresses.empty())
-                        continue;
-                }
 
-                CScriptID script_dest;
-                WitnessV0KeyHash wit_script_dest;
-                //Returns false if not coldstake
-                if (!ExtractStakingKeyID(pscriptPubKey, script_dest, wit_script_dest))
+                }
+                //If script does not include reward addres and fields are set, skip
+                else if(nDelegateRewardToMe || !nDelegateRewardAddresses.empty())
                     continue;
+            }
 
-                // for staking we do not support p2pkh
-                const CScriptID& destScriptID = script_dest;
-                if (HaveCScript(destScriptID))
-                    vCoins.push_back(COutput(pcoin, i, nDepth, true, true, true));
+            CScriptID script_dest;
+            WitnessV0KeyHash wit_script_dest;
+            //Returns false if not coldstake
+            if (!ExtractStakingKeyID(pscriptPubKey, script_dest, wit_script_dest))
+                continue;
+
+            // for staking we do not support p2pkh
+            const CScriptID& destScriptID = script_dest;
+            if (HaveCScript(destScriptID))
+                vCoins.push_back(COutput(pcoin, i, nDepth, true, true, true));
 
-            }
         }
+
+        for (const COutPoint &outpoint : vPrune)
+            setStakeCandidates.erase(outpoint);
     }
 
     //Sort staking list by (amount/height) instead of randomness
@@ -8430,6 +8847,13 @@ bool CWallet::CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHeigh
     if (setCoins.empty())
         return false;
 
+    // Hash the fixed part of each kernel once per tip and sweep the next few slots
+    if (!stakeKernelSearch.IsValidFor(pindexPrev, nBits))
+        stakeKernelSearch.Reset(pindexPrev, nBits);
+    for (const auto &pcoin : setCoins)
+        stakeKernelSearch.AddCoin(COutPoint(pcoin.first->GetHash(), pcoin.second));
+    stakeKernelSearch.Sweep(nTime, Params().GetStakeTimestampMask(nBlockHeight), nStakeSearchThreads);
+
     CAmount nCredit = 0;
     CScript scriptPubKeyKernel;
 
@@ -8445,7 +8869,7 @@ bool CWallet::CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHeigh
 
         int64_t nBlockTime;
 
-        if (CheckKernel(pindexPrev, nBits, nTime, prevoutStake, &nBlockTime))
+        if (stakeKernelSearch.IsKernel(nTime, prevoutStake, &nBlockTime))
         {
             LOCK(cs_wallet);
             // Found a kernel
@@ -8701,27 +9125,15 @@ bool CWallet::CreateCoinStake(unsigned int nBits, int64_t nTime, int nBlockHeigh
 
         //pay or dont pay the fees to all nodes
         if(payFees && returnFee != 0){
-            vector<CGhostnode> ghostnodeVector = mnodeman.GetFullGhostnodeVector();
-
-            int totalActiveNodes = 0;
             int startBlock = (chainActive.Height() + 1) - (Params().GetConsensus().nGhostFeeDistributionCycle - 1);
             int64_t ensureNodeActiveBefore = chainActive[startBlock]->GetBlockTime();
+            std::shared_ptr<const vector<CScript>> ghostnodeVectorWinners = mnodeman.GetGhostFeePayees(ensureNodeActiveBefore);
 
-            for(auto node: ghostnodeVector){
-
-                if(node.IsEnabled() && (node.sigTime <= ensureNodeActiveBefore))
-                    totalActiveNodes++;
-            }
-
-            CAmount feePayout = returnFee/totalActiveNodes;
+            int totalActiveNodes = ghostnodeVectorWinners->size();
+            CAmount feePayout = totalActiveNodes ? returnFee/totalActiveNodes : 0;
 
-            for(auto node: ghostnodeVector){
-                if(node.IsEnabled() && (node.sigTime <= ensureNodeActiveBefore)){
-                    CScript mnpayee;
-                    mnpayee = GetScriptForDestination(node.pubKeyCollateralAddress.GetID());
-                    txNew.vout.push_back(CTxOut(feePayout,mnpayee));
-                }
-            }
+            for(const CScript &mnpayee: *ghostnodeVectorWinners)
+                txNew.vout.push_back(CTxOut(feePayout,mnpayee));
         }
     }
 
@@ -8788,44 +9200,11 @@ bool CWallet::SignBlock(CBlockTemplate *pblocktemplate, int nHeight, int64_t nSe
     int64_t nFees = -pblocktemplate->vTxFees[0];
     CBlockIndex *pindexPrev = chainActive.Tip();
 
-    int64_t nGhostFees = 0;
-
-    //check for zerocoin mints, start after coinbase
-    if(chainActive.Height() + 1 > Params().GetConsensus().nGhostnodePaymentsStartBlock){
-        for(int i = 1; i < pblock->vtx.size(); i++){
-
-            //Avoid 2-way ghosting miscalculation
-            if(pblock->vtx[i]->IsSigmaMint() && !pblock->vtx[i]->IsSigmaSpend()){
-                //scrape fees payouts, 0.25% or minimum of 0.01 coins
-                //whole block is zerocoin mint
-                CAmount mintAmount = 0;
-                for(int k = 0; k < pblock->vtx[i]->vout.size(); k++){
-                    if(pblock->vtx[i]->vout[k].scriptPubKey.IsSigmaMint())
-                        mintAmount += pblock->vtx[i]->vout[k].nValue;
-                }
-                nGhostFees += mintAmount * 0.0025;
+    // the scan is done once per template, stake attempts reuse its result
+    if (pblocktemplate->nGhostFees < 0)
+        pblocktemplate->nGhostFees = GetStakeTemplateGhostFees(*pblock);
+    int64_t nGhostFees = pblocktemplate->nGhostFees;
 
-            }
-
-            if(pblock->vtx[i]->IsSigmaSpend() && pblock->vtx[i]->IsSigmaMint()){
-                CAmount inVal = 0;
-                CAmount outVal = 0;
-                for(int k = 0; k < pblock->vtx[i]->vout.size(); k++){
-                    if(!pblock->vtx[i]->vout[k].scriptPubKey.IsSigmaMint())
-                        continue;
-                    outVal += pblock->vtx[i]->vout[k].nValue;
-                }
-                // add input denoms
-                for(int k = 0; k < pblock->vtx[i]->vin.size(); k++){
-                    std::pair<std::unique_ptr<sigma::CoinSpend>, uint32_t> newSpend;
-                    newSpend = ParseSigmaSpend(pblock->vtx[i]->vin[k]);
-                    inVal += newSpend.first->getIntDenomination();
-                }
-                nGhostFees += inVal - outVal;
-
-            }
-        }
-    }
     if(nGhostFees > nFees){
         LogPrintf("\nCWallet::SignBlock() ERROR: nGhostFees not able to payout, reverting to nFees, nGhostFees=%llf, nFees=%llf \n", nGhostFees, nFees);
         nGhostFees =  nFees;
@@ -8908,7 +9287,7 @@ bool CWallet::InMempool(const uint256 &hash) const
     return mempool.exists(hash);
 }
 
-CAmount CWallet::GetStakeableBalance() const
+CAmount CWallet::CalculateStakeableBalance() const
 {
     CAmount nBalance = 0;
 
@@ -9068,23 +9447,8 @@ bool CWallet::FindUnloadedGhostTransactions(const CTransaction& tx)
 
 
                 //Refill Key
-                libzerocoin::CoinDenomination denomination;
-                libzerocoin::Params *zcParams = ZCParams;
-                int mintVersion = 1;
-                denomination = libzerocoin::ZQ_ONE;
-                libzerocoin::PrivateCoin newCoinTemp(zcParams, denomination, mintVersion);
-                if(newCoinTemp.getPublicCoin().validate()){
-                    const unsigned char *ecdsaSecretKey = newCoinTemp.getEcdsaSeckey();
-                    CZerocoinEntry zerocoinTxNew;
-                    zerocoinTxNew.IsUsed = false;
-                    zerocoinTxNew.denomination = libzerocoin::ZQ_ERROR;
-                    zerocoinTxNew.value = newCoinTemp.getPublicCoin().getValue();
-                    zerocoinTxNew.randomness = newCoinTemp.getRandomness();
-                    zerocoinTxNew.serialNumber = newCoinTemp.getSerialNumber();
-                    zerocoinTxNew.ecdsaSecretKey = std::vector<unsigned char>(ecdsaSecretKey, ecdsaSecretKey+32);
-                    if (!walletdb.WriteUnloadedZCEntry(zerocoinTxNew))
-                        return false;
-                }
+                if (!WriteUnloadedZCEntries(walletdb, ghostKeyPool.Take(1)))
+                    return false;
                 foundCoin = true;
             }
         }
@@ -9102,34 +9466,14 @@ bool CWallet::TopUpUnloadedCommitments(int kpSize)
         //if (IsLocked())
             //return false;
 
-
-        libzerocoin::CoinDenomination denomination;
-        libzerocoin::Params *zcParams = ZCParams;
-
-        int mintVersion = 1;
-        denomination = libzerocoin::ZQ_ONE;
-
         list <CZerocoinEntry> listUnloadedPubcoin;
         CWalletDB walletdb(GetDBHandle());
         walletdb.ListUnloadedPubCoin(listUnloadedPubcoin);
 
         //refill keys to at least 100 in wallet
-        for(int i = listUnloadedPubcoin.size(); i < kpSize; i++){
-            libzerocoin::PrivateCoin newCoinTemp(zcParams, denomination, mintVersion);
-            if(newCoinTemp.getPublicCoin().validate()){
-                const unsigned char *ecdsaSecretKey = newCoinTemp.getEcdsaSeckey();
-                CZerocoinEntry zerocoinTx;
-                zerocoinTx.IsUsed = false;
-                zerocoinTx.denomination = libzerocoin::ZQ_ERROR;
-                zerocoinTx.value = newCoinTemp.getPublicCoin().getValue();
-                zerocoinTx.randomness = newCoinTemp.getRandomness();
-                zerocoinTx.serialNumber = newCoinTemp.getSerialNumber();
-                zerocoinTx.ecdsaSecretKey = std::vector<unsigned char>(ecdsaSecretKey, ecdsaSecretKey+32);
-                if (!walletdb.WriteUnloadedZCEntry(zerocoinTx))
-                    return false;
-            }
-            else
-                i--;
+        if ((int)listUnloadedPubcoin.size() < kpSize) {
+            if (!WriteUnloadedZCEntries(walletdb, ghostKeyPool.Take(kpSize - listUnloadedPubcoin.size())))
+                return false;
         }
     }
 
@@ -9171,9 +9515,19 @@ bool CWallet::GetKeyPackList(std::vector <CommitmentKeyPack> &keyPackList, bool
             }
         }
         else{
+            // the pack only depends on the seed and the next unused count, so reuse the last one if neither moved
+            uint256 seedMaster = GetGhostWallet()->GetMasterSeed();
+            uint256 hashSeed = Hash(seedMaster.begin(), seedMaster.end());
+            int64_t nCount = GetGhostWallet()->GetCount();
+            if(nCount == nKeyPackCacheCount && packSize == nKeyPackCacheSize && hashSeed == hashKeyPackCacheSeed){
+                keyPackList.push_back(CommitmentKeyPack(vKeyPackCache));
+                return true;
+            }
+
             sigma::Params *sParam = SParams;
             // get latest unused mints
             vector<sigma::PrivateCoin> privCoins;
+            CWalletBatchScope batch(this);
             int i = GetGhostWallet()->GetCount();
             int original = packSize + i;
             for(i = i; i < original; i++){
@@ -9185,7 +9539,7 @@ bool CWallet::GetKeyPackList(std::vector <CommitmentKeyPack> &keyPackList, bool
                     continue;
 
                 //write mint to DB, will get scanned if ckp pay is made
-                CWalletDB(this->GetDBHandle()).WriteSigmaMint(dMint);
+                CWalletDBRef(this)->WriteSigmaMint(dMint);
                 privCoins.push_back(coin);
                 GetGhostWallet()->UpdateCountLocal();
             }
@@ -9204,6 +9558,11 @@ bool CWallet::GetKeyPackList(std::vector <CommitmentKeyPack> &keyPackList, bool
             CommitmentKeyPack pubCoinPack(keyList);
 
             keyPackList.push_back(pubCoinPack);
+
+            vKeyPackCache = keyList;
+            hashKeyPackCacheSeed = hashSeed;
+            nKeyPackCacheCount = nCount;
+            nKeyPackCacheSize = packSize;
         }
 
     }
@@ -9437,7 +9796,7 @@ string CWallet::MintAndStoreSigma(vector<CRecipient> vecSend,
         return strError;
     }
 
-    int totalValue = 0;
+    CAmount totalValue = 0;
     for(CRecipient recipient: vecSend){
         // Check amount
         if (recipient.nAmount <= 0)
@@ -9475,11 +9834,12 @@ string CWallet::MintAndStoreSigma(vector<CRecipient> vecSend,
         LogPrintf("MintAndStoreSigma::CommitTransaction() success!\n");
     }
 
+    CWalletBatchScope batch(this);
+
     // Update the count in the database (no effect if no change mints)
     ghostWalletMain->UpdateCountDB();
 
     //update mints with full transaction hash and then database them
-    CWalletDB walletdb(*dbw);
     for (CSigmaMint dMint : vDMints) {
         dMint.SetTxHash(wtxNew.GetHash());
         sigmaTracker->Add(dMint, true);
@@ -9488,12 +9848,34 @@ string CWallet::MintAndStoreSigma(vector<CRecipient> vecSend,
     return "";
 }
 
+int CWallet::GetSigmaCoinSetForSpend(int maxHeight, sigma::CoinDenomination denomination, int coinGroupID,
+                                     uint256& blockHash_out, CSigmaState::CAnonymitySet& set_out)
+{
+    CSigmaState *sigmaState = CSigmaState::GetSigmaState();
+    // taken before the set, a change in between only makes the entry look stale
+    uint64_t nGeneration = sigmaState->GetGeneration(denomination);
+
+    LOCK(cs_sigmaSpendSets);
+    CSigmaSpendSetEntry &entry = mapSigmaSpendSets[std::make_pair(denomination, coinGroupID)];
+    if (!entry.set.coins || entry.nGeneration != nGeneration || entry.nMaxHeight != maxHeight) {
+        entry.set = CSigmaState::CAnonymitySet();
+        entry.nCoins = sigmaState->GetCoinSetForSpend(&chainActive, maxHeight, denomination, coinGroupID, entry.blockHash, entry.set);
+        entry.nGeneration = nGeneration;
+        entry.nMaxHeight = maxHeight;
+    }
+
+    blockHash_out = entry.blockHash;
+    set_out = entry.set;
+    return entry.nCoins;
+}
+
 bool CWallet::CreateSigmaSpendTransaction(std::string &toKey, vector <CScript> pubCoinScripts, vector <sigma::CoinDenomination> denominationBatch,
                                              CWalletTx &wtxNew, CReserveKey &reservekey, vector <Scalar> &coinSerialBatch,
                                              vector <uint256> &txHashBatch, vector <GroupElement> &sSelectedValueBatch, bool &sSelectedIsUsed,
                                              std::string &strFailReason)
 {
     bool forceUsed = false;
+    int64_t nTimeStart = GetTimeMicros();
 
     std::vector <int64_t> nValueBatch;
     for(auto den: denominationBatch){
@@ -9572,7 +9954,7 @@ bool CWallet::CreateSigmaSpendTransaction(std::string &toKey, vector <CScript> p
     CSigmaState *sigmaState = CSigmaState::GetSigmaState();
     sigma::Params* sParams = SParams;
 
-    std::vector<std::vector<sigma::PublicCoin>> anonimity_set_batch;
+    std::vector<CSigmaState::CAnonymitySet> anonimity_set_batch;
 
     uint256 blockHash;
 
@@ -9592,7 +9974,7 @@ bool CWallet::CreateSigmaSpendTransaction(std::string &toKey, vector <CScript> p
         }
 
         CSigmaEntry coinToUse;
-        std::vector<sigma::PublicCoin> anonimity_set;
+        CSigmaState::CAnonymitySet anonimity_set;
         // Cycle through metadata, looking for suitable coin
         list<CMintMeta> listMints(setMints.begin(), setMints.end());
         for (const CMintMeta& mint : listMints) {
@@ -9619,8 +10001,7 @@ bool CWallet::CreateSigmaSpendTransaction(std::string &toKey, vector <CScript> p
                 if (coinHeight > 0
                         && coinGroupID < coinId // Always spend coin with smallest ID that matches.
                         && coinHeight + (ZEROCOIN_CONFIRM_HEIGHT) <= chainActive.Height()
-                        && sigmaState->GetCoinSetForSpend(
-                            &chainActive,
+                        && GetSigmaCoinSetForSpend(
                             chainActive.Height()-(ZEROCOIN_CONFIRM_HEIGHT),
                             denominationBatch[i],
                             coinGroupID,
@@ -9649,20 +10030,29 @@ bool CWallet::CreateSigmaSpendTransaction(std::string &toKey, vector <CScript> p
         serializedId.push_back(coinId);
     }
 
+    // We use incomplete transaction hash as metadata, the same for every spend.
+    uint256 txHashForMetadata = txNewTemp.GetSigmaMetaDataHash();
+    int64_t nTimeSelected = GetTimeMicros();
+
+    // the compact encoding once the next block may carry it
+    int txVersion;
+    {
+        LOCK(cs_main);
+        txVersion = IsSigmaV3Allowed(chainActive.Height() + 1) ? sigma::SIGMA_VERSION_3 : sigma::SIGMA_VERSION_2;
+    }
+    std::vector<sigma::PrivateCoin> privateCoinBatch;
+    std::vector<sigma::SpendMetaData> metaDataBatch;
     for(int i = 0; i < nValueBatch.size(); i++){
         {
             LOCK2(cs_main, cs_wallet);
             {
 
-                // We use incomplete transaction hash as metadata.
-                sigma::SpendMetaData metaData(serializedId[i], txHashBatch[i], txNewTemp.GetHash());
+                metaDataBatch.emplace_back(serializedId[i], txHashBatch[i], txHashForMetadata);
 
                 // Construct the CoinSpend object. This acts like a signature on the
                 // transaction.
                 sigma::PrivateCoin privateCoin(sParams, denominationBatch[i]);
 
-                int txVersion = sigma::SIGMA_VERSION_2;
-
                 LogPrintf("CreateSigmaSpendTransation: tx version=%d, tx metadata hash=%s\n", txVersion, txNew.GetHash().ToString());
 
                 // 2. Get pubcoin from the private coin
@@ -9679,23 +10069,54 @@ bool CWallet::CreateSigmaSpendTransaction(std::string &toKey, vector <CScript> p
                 privateCoin.setRandomness(coinToUseBatch[i].randomness);
                 privateCoin.setSerialNumber(coinToUseBatch[i].serialNumber);
                 privateCoin.setEcdsaSeckey(coinToUseBatch[i].ecdsaSecretKey);
+                privateCoinBatch.push_back(privateCoin);
+            }
+        }
+    }
 
-                sigma::CoinSpend spend(sParams, privateCoin, anonimity_set_batch[i], metaData, true);
-                spend.setVersion(txVersion);
+    // Prove the inputs concurrently without holding the locks, the anonymity sets are
+    // snapshots. The threads left over by the inputs are shared by their proofs.
+    std::size_t nInputs = nValueBatch.size();
+    int nProofThreads = std::max<int>(nSigmaProverThreads / nInputs, 1);
+    std::vector<std::unique_ptr<sigma::CoinSpend>> spendBatch(nInputs);
+    sigma::parallel_for(nInputs, nSigmaProverThreads, [&](std::size_t i) {
+        const CSigmaState::CAnonymitySet &anonimity_set = anonimity_set_batch[i];
+        spendBatch[i].reset(new sigma::CoinSpend(sParams, privateCoinBatch[i], *anonimity_set.coins, anonimity_set.setSize,
+                metaDataBatch[i], true, nProofThreads));
+        spendBatch[i]->setVersion(txVersion);
+    });
+    int64_t nTimeProved = GetTimeMicros();
 
-                // This is a sanity check. The CoinSpend object should always verify,
-                // but why not check before we put it onto the wire?
-                if (!spend.Verify(anonimity_set_batch[i], metaData, true)) {
+    // This is a sanity check. The CoinSpend object should always verify,
+    // but why not check before we put it onto the wire?
+    std::vector<char> spendVerified(nInputs, false);
+    sigma::parallel_for(nInputs, nSigmaProverThreads, [&](std::size_t i) {
+        const CSigmaState::CAnonymitySet &anonimity_set = anonimity_set_batch[i];
+        spendVerified[i] = spendBatch[i]->Verify(*anonimity_set.coins, anonimity_set.setSize, metaDataBatch[i], true);
+    });
+    int64_t nTimeVerified = GetTimeMicros();
+
+    for(int i = 0; i < nValueBatch.size(); i++){
+        {
+            LOCK2(cs_main, cs_wallet);
+            {
+                if (!spendVerified[i]) {
                     strFailReason = _("the sigma spend coin transaction did not verify");
                     return false;
                 }
 
+                sigma::CoinSpend &spend = *spendBatch[i];
                 coinSerialBatch.push_back(spend.getCoinSerialNumber());
                 // Serialize the CoinSpend object into a buffer.
                 CDataStream serializedCoinSpend(SER_NETWORK, PROTOCOL_VERSION);
-                serializedCoinSpend << spend;
-
-                CScript tmp = CScript() << OP_SIGMASPEND; //<< serializedCoinSpend.size();
+                CScript tmp;
+                if (spend.getVersion() == sigma::SIGMA_VERSION_3) {
+                    spend.SerializeCompact(serializedCoinSpend);
+                    tmp << OP_SIGMASPENDV3;
+                } else {
+                    serializedCoinSpend << spend;
+                    tmp << OP_SIGMASPEND;
+                }
 
                 tmp.insert(tmp.end(), serializedCoinSpend.begin(), serializedCoinSpend.end());
                 txNew.vin[i].scriptSig.assign(tmp.begin(), tmp.end());
@@ -9703,6 +10124,10 @@ bool CWallet::CreateSigmaSpendTransaction(std::string &toKey, vector <CScript> p
         }
     }
 
+    LogPrintf("CreateSigmaSpendTransaction: %u inputs, coin selection %.2fms, proofs %.2fms (%d threads), verification %.2fms, serialization %.2fms\n",
+              nInputs, (nTimeSelected - nTimeStart) / 1000.0, (nTimeProved - nTimeSelected) / 1000.0, nSigmaProverThreads,
+              (nTimeVerified - nTimeProved) / 1000.0, (GetTimeMicros() - nTimeVerified) / 1000.0);
+
     // Embed the constructed transaction data in wtxNew.
     wtxNew.SetTx(MakeTransactionRef(std::move(txNew)));
 
@@ -9828,6 +10253,7 @@ string CWallet::SpendSigma(std::string &toKey, std::vector <CScript> pubCoinScri
     }
 
     //Set spent mint as used
+    CWalletBatchScope batch(this);
     uint256 txidSpend = wtxNew.GetHash();
 
     for(int i = 0; i< sSelectedValue.size(); i++){
@@ -9970,7 +10396,8 @@ bool CWallet::CreateSigmaSpendModel(string &stringError, vector <string> denomAm
     return true;
 }
 
-std::string CWallet::GhostModeSpendSigma(string totalAmount, string toKey, vector<CScript> pubCoinScripts){
+std::string CWallet::GhostModeSpendSigma(string totalAmount, string toKey, vector<CScript> pubCoinScripts,
+                                         const std::function<bool(int, int)>& fnProgress){
 
     //Autobackup wallet into ghostbackups
     string backupDir = GetDataDir().string() + "/ghostbackups/wallet-" + std::to_string(GetTime()) + ".dat";
@@ -10182,6 +10609,7 @@ std::string CWallet::GhostModeSpendSigma(string totalAmount, string toKey, vecto
         //limit a batch to 60 coins max of 90kb
         int startIndex = 0;
         int endIndex = denominationBatch.size() > 60 ? 59 : denominationBatch.size() - 1;
+        int nBatches = (denominationBatch.size() + 59) / 60;
         for(int vecSplit = 0; vecSplit < ((denominationBatch.size()/60) + 1); vecSplit++){
             vector <std::string> denominationBatchSub;
             vector <CScript> pubCoinScriptsSub;
@@ -10194,6 +10622,9 @@ std::string CWallet::GhostModeSpendSigma(string totalAmount, string toKey, vecto
             if(denominationBatchSub.size() < 1)
                 continue;
 
+            if(fnProgress && !fnProgress(vecSplit, nBatches))
+                return "GhostModeSpendSigma(): Cancelled after " + std::to_string(vecSplit) + " of " + std::to_string(nBatches) + " spend transactions.";
+
             if(!CreateSigmaSpendModel(stringError, denominationBatchSub, toKey, pubCoinScriptsSub)){
                 if(vecSplit > 0){
                     CAmount amountGhosted = 0;
@@ -10217,6 +10648,9 @@ std::string CWallet::GhostModeSpendSigma(string totalAmount, string toKey, vecto
                 endIndex = denominationBatch.size() - 1;
         }
 
+        if(fnProgress)
+            fnProgress(nBatches, nBatches);
+
         return "Sucessfully sent " + totalAmount + " ghosted NIX";
     }
     else {
@@ -7,6 +7,8 @@
 #define BITCOIN_WALLET_WALLET_H
 
 #include <amount.h>
+#include <bloom.h>
+#include <hash.h>
 #include <policy/feerate.h>
 #include <streams.h>
 #include <tinyformat.h>
@@ -26,11 +28,13 @@
 
 #include <algorithm>
 #include <atomic>
+#include <functional>
 #include <map>
 #include <set>
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include "zerocoin/zerocoin.h"
@@ -39,6 +43,7 @@
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
 #include <miner.h>
+#include <pos/kernel.h>
 #include <univalue/include/univalue.h>
 
 typedef CWallet* CWalletRef;
@@ -52,6 +57,7 @@ extern CFeeRate payTxFee;
 extern unsigned int nTxConfirmTarget;
 extern bool bSpendZeroConfChange;
 extern bool fWalletRbf;
+extern int nSigmaProverThreads;
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
 //! -paytxfee default
@@ -78,6 +84,18 @@ static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 6;
 static const bool DEFAULT_WALLET_RBF = false;
 static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! -sigmaproverthreads default, 0 = auto
+static const int DEFAULT_SIGMA_PROVER_THREADS = 0;
+//! Maximum number of threads a sigma spend is proved on
+static const int MAX_SIGMA_PROVER_THREADS = 16;
+//! Number of blocks a rescan reads ahead of the block being scanned
+static const unsigned int RESCAN_PREFETCH_BLOCKS = 32;
+//! Smallest capacity of the key store filter used by CWallet::IsMine
+static const unsigned int ISMINE_FILTER_MIN_ELEMENTS = 2 * DEFAULT_KEYPOOL_SIZE;
+//! False positive rate of that filter
+static const double ISMINE_FILTER_FP_RATE = 0.0001;
+//! Output scripts with a cached IsMine result, the cache starts over when it is full
+static const size_t MAX_ISMINE_CACHE_SIZE = 100000;
 
 extern const char * DEFAULT_WALLET_DAT;
 
@@ -98,6 +116,20 @@ enum class FeeEstimateMode;
 
 typedef std::map<uint256, CWalletTx> MapWallet_t;
 
+class SaltedScriptHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedScriptHasher();
+
+    size_t operator()(const CScript& script) const {
+        return CSipHasher(k0, k1).Write(script.data(), script.size()).Finalize();
+    }
+};
+
 extern CCoinControl g_coincontrol;
 
 const uint16_t PLACEHOLDER_N = 0xFFFF;
@@ -419,6 +451,43 @@ public:
 
 };
 
+/** Accumulator witness of a zerocoin coin of the wallet, advanced as blocks are connected */
+class CZerocoinWitnessEntry
+{
+public:
+    Bignum pubCoin;
+    int denomination;
+    int id;
+    // accumulated coins of the group but pubCoin, as of hashBlock
+    Bignum witnessValue;
+    uint256 hashBlock;
+
+    CZerocoinWitnessEntry()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        pubCoin = 0;
+        denomination = -1;
+        id = -1;
+        witnessValue = 0;
+        hashBlock.SetNull();
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(pubCoin);
+        READWRITE(denomination);
+        READWRITE(id);
+        READWRITE(witnessValue);
+        READWRITE(hashBlock);
+    }
+};
+
 class CZerocoinSpendEntry
 {
 public:
@@ -1247,8 +1316,44 @@ private:
      */
     typedef std::multimap<COutPoint, uint256> TxSpends;
     TxSpends mapTxSpends;
-    void AddToSpends(const COutPoint& outpoint, const uint256& wtxid);
-    void AddToSpends(const uint256& wtxid);
+    void AddToSpends(const COutPoint& outpoint, const uint256& wtxid, bool fSyncMetaData = true);
+    void AddToSpends(const uint256& wtxid, bool fSyncMetaData = true);
+
+    /**
+     * Outputs with a staking script, so AvailableCoinsForStaking does not have to walk
+     * all of mapWallet. Filled from AddToWallet and once a wallet load is done, outputs spent in the main
+     * chain are pruned lazily and the set is rebuilt when a block is disconnected.
+     */
+    mutable std::set<COutPoint> setStakeCandidates;
+    void AddToStakeCandidates(const CWalletTx& wtx);
+    void RebuildStakeCandidates();
+
+    /**
+     * Stakeable balance and stake weight, recomputed by RefreshStakeWeight once per tip or
+     * mempool update that touched the wallet, so the GUI and RPC polls read them without locks.
+     * Anything changing the wallet's outputs, their depth or the reserve sets fStakeWeightDirty.
+     */
+    std::atomic<CAmount> nStakeableBalanceCached{0};
+    std::atomic<uint64_t> nStakeWeightCached{0};
+    std::atomic<bool> fStakeWeightDirty{true};
+    CAmount CalculateStakeableBalance() const;
+
+    /**
+     * IsMine of output scripts. filterIsMine holds every key id, script id and watch-only
+     * script of the key store, so pay to (witness) key hash and script hash outputs of others
+     * are turned down before Solver runs. Results of the scripts it lets through are cached
+     * until the key store changes, nIsMineGeneration tells a result computed meanwhile.
+     * Lock order is cs_KeyStore before cs_ismine.
+     */
+    mutable CCriticalSection cs_ismine;
+    CRollingBloomFilter filterIsMine{ISMINE_FILTER_MIN_ELEMENTS, ISMINE_FILTER_FP_RATE};
+    unsigned int nIsMineFilterCapacity{ISMINE_FILTER_MIN_ELEMENTS};
+    unsigned int nIsMineFilterEntries{0};
+    mutable std::unordered_map<CScript, isminetype, SaltedScriptHasher> mapIsMineCache;
+    uint64_t nIsMineGeneration{0};
+    void KeyStoreAdded(const std::vector<unsigned char>& vchId) override;
+    void ClearIsMineCache();
+    bool IsMineFilterRejects(const CScript& script) const;
 
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
@@ -1300,6 +1405,39 @@ private:
      */
     const CBlockIndex* m_last_block_processed;
 
+    /**
+     * Witnesses of the zerocoin coins spent from the wallet, loaded on first use.
+     * Kept at the chain tip by BlockConnected so a spend only accumulates the
+     * coins minted since the last update instead of the whole coin group.
+     */
+    std::map<CBigNum, CZerocoinWitnessEntry> mapZerocoinWitnesses;
+    bool fZerocoinWitnessesLoaded;
+
+    void LoadZerocoinWitnesses();
+    void AdvanceZerocoinWitnesses(const CBlockIndex *pindex);
+
+    /** Anonymity set last taken for spends of a sigma coin group */
+    struct CSigmaSpendSetEntry {
+        // generation of the denomination in the sigma state and spend height the set was taken at
+        uint64_t nGeneration;
+        int nMaxHeight;
+        int nCoins;
+        uint256 blockHash;
+        CSigmaState::CAnonymitySet set;
+    };
+
+    /**
+     * Anonymity sets of sigma spends by denomination and group id. The sets are shared with the
+     * sigma state, so an entry is reused across the inputs of a spend and across spends until
+     * the tip moves or the coins of the denomination change.
+     */
+    std::map<std::pair<sigma::CoinDenomination, int>, CSigmaSpendSetEntry> mapSigmaSpendSets;
+    CCriticalSection cs_sigmaSpendSets;
+
+    /** CSigmaState::GetCoinSetForSpend through mapSigmaSpendSets */
+    int GetSigmaCoinSetForSpend(int maxHeight, sigma::CoinDenomination denomination, int coinGroupID,
+                                uint256& blockHash_out, CSigmaState::CAnonymitySet& set_out);
+
 public:
     /*
      * Main wallet lock.
@@ -1385,6 +1523,7 @@ public:
         fScanningWallet = false;
         walletVersion = 0;
         activeContracts.clear();
+        fZerocoinWitnessesLoaded = false;
     }
 
     void setGhostWallet(CGhostWallet* ghostWallet)
@@ -1540,9 +1679,12 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose=true);
     bool LoadToWallet(const CWalletTx& wtxIn);
+    //! Builds what LoadToWallet leaves out once every transaction record is loaded
+    void FinishLoadTransactions();
     void TransactionAddedToMempool(const CTransactionRef& tx) override;
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
     bool AddToWalletIfInvolvingMe(const CTransactionRef& tx, const CBlockIndex* pIndex, int posInBlock, bool fUpdate);
     int64_t RescanFromTime(int64_t startTime, const WalletRescanReserver& reserver, bool update);
     CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, CBlockIndex* pindexStop, const WalletRescanReserver& reserver, bool fUpdate = false);
@@ -1552,7 +1694,7 @@ public:
     // ResendWalletTransactionsBefore may only be called if fBroadcastTransactions!
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
     CAmount GetBalance() const;
-    CAmount GetStakeableBalance() const;
+    CAmount GetStakeableBalance() const { return nStakeableBalanceCached; }
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
     CAmount GetWatchOnlyBalance() const;
@@ -1595,6 +1737,8 @@ public:
     bool CreateZerocoinSpendTransaction(std::string &toKey,int64_t nValue, libzerocoin::CoinDenomination denomination,
                                         CWalletTx& wtxNew, CReserveKey& reservekey, CBigNum& coinSerial, uint256& txHash, CBigNum& zcSelectedValue, bool& zcSelectedIsUsed,  std::string& strFailReason);
     bool CommitZerocoinSpendTransaction(CWalletTx& wtxNew, CReserveKey& reservekey, CConnman* connman, CValidationState& state);
+    /** Witness of a coin against the accumulator at maxHeight, starting from the stored witness when there is one */
+    libzerocoin::AccumulatorWitness GetZerocoinWitness(int maxHeight, int denomination, int id, const CBigNum &pubCoin);
     std::string SendMoney(CScript scriptPubKey, int64_t nValue, CWalletTx& wtxNew, bool fAskFee=false);
     std::string SendMoneyToDestination(const CTxDestination &address, int64_t nValue, CWalletTx& wtxNew, bool fAskFee=false);
     std::string MintZerocoin(CScript pubCoin, int64_t nValue, CWalletTx& wtxNew, bool fAskFee=false);
@@ -1627,6 +1771,12 @@ public:
     bool TopUpUnloadedCommitments(int kpSize = 101);
     bool GetKeyPackList(vector <CommitmentKeyPack> &keyPackList, bool isV2, int packSize = 10);
 
+    //! Commitment keys of the last V2 pack, reused while the ghost wallet seed, count and pack size are unchanged
+    std::vector<std::vector<unsigned char>> vKeyPackCache;
+    uint256 hashKeyPackCacheSeed;
+    int64_t nKeyPackCacheCount = -1;
+    int nKeyPackCacheSize = 0;
+
     bool EncryptPrivateZerocoinData(CZerocoinEntry &zerocoinMintPlain);
     bool DecryptPrivateZerocoinData(CZerocoinEntry &zerocoinMintSecret);
 
@@ -1663,7 +1813,12 @@ public:
                                bool forceUsed = false, bool fAskFee = false);
 
     void ListAvailableSigmaMintCoins(vector <COutput> &vCoins, bool fOnlyConfirmed=true) const;
-    std::string GhostModeSpendSigma(string totalAmount, string toKey = "", vector<CScript> pubCoinScripts = vector<CScript>());
+    /**
+     * fnProgress, if set, is called with the number of spend transactions sent and their total
+     * before each one and after the last, it returns false to stop before the next one.
+     */
+    std::string GhostModeSpendSigma(string totalAmount, string toKey = "", vector<CScript> pubCoinScripts = vector<CScript>(),
+                                    const std::function<bool(int, int)>& fnProgress = nullptr);
     bool GhostModeMintSigma(string totalAmount, vector<CScript> pubCoinScripts = vector<CScript>());
 
     bool CreateSigmaSpendModel(string &stringError, vector <string> denomAmountBatch, string toAddr, vector <CScript> pubCoinScripts);
@@ -1684,7 +1839,8 @@ public:
 
     CAmount GetStaked();
     size_t CountColdstakeOutputs();
-    uint64_t GetStakeWeight() const;
+    uint64_t GetStakeWeight() const { return nStakeWeightCached; }
+    void RefreshStakeWeight(bool fForce = false);
 
     bool SetReserveBalance(CAmount nNewReserveBalance);
     void AvailableCoinsForStaking(std::vector<COutput> &vCoins, int64_t nTime, int nHeight) const;
@@ -1704,6 +1860,7 @@ public:
     size_t nAutoGhosterThread = 9999999; // unset
 
     mutable int deepestTxnDepth = 0; // for stake mining
+    CStakeKernelSearch stakeKernelSearch; // for stake mining
 
     mutable int m_greatest_txn_depth = 0; // depth of most deep txn
     //mutable int m_least_txn_depth = 0; // depth of least deep txn
@@ -2099,4 +2256,40 @@ public:
     }
 };
 
+/**
+ * RAII object grouping the wallet database writes of one logical operation (a mint,
+ * a spend, a connected block) on one CWalletDB, so the database is flushed once when
+ * the outermost scope on this thread ends instead of after every write.
+ */
+class CWalletBatchScope
+{
+private:
+    std::unique_ptr<CWalletDB> m_batch;
+    CWallet* m_prev_wallet;
+    CWalletDB* m_prev_batch;
+public:
+    explicit CWalletBatchScope(CWallet* pwallet);
+    ~CWalletBatchScope();
+    CWalletBatchScope(const CWalletBatchScope&) = delete;
+    CWalletBatchScope& operator=(const CWalletBatchScope&) = delete;
+};
+
+/**
+ * Database handle for a wallet write: the CWalletDB of the CWalletBatchScope open for
+ * the wallet on this thread, or a CWalletDB of its own when there is none.
+ */
+class CWalletDBRef
+{
+private:
+    std::unique_ptr<CWalletDB> m_owned;
+    CWalletDB* m_batch;
+public:
+    explicit CWalletDBRef(CWallet* pwallet, bool fFlushOnClose = true);
+    CWalletDBRef(const CWalletDBRef&) = delete;
+    CWalletDBRef& operator=(const CWalletDBRef&) = delete;
+
+    CWalletDB& operator*() { return *m_batch; }
+    CWalletDB* operator->() { return m_batch; }
+};
+
 #endif // BITCOIN_WALLET_WALLET_H
@@ -16,8 +16,10 @@
 #include <utiltime.h>
 #include <wallet/wallet.h>
 #include <wallet/sigmamint.h>
+#include <sigma/parallel.h>
 
 #include <atomic>
+#include <memory>
 
 #include <boost/thread.hpp>
 #include <boost/foreach.hpp>
@@ -242,9 +244,40 @@ public:
     }
 };
 
+/** Wallet records read off the cursor per batch before their transactions are decoded in parallel */
+static const size_t WALLET_LOAD_BATCH_SIZE = 4096;
+
+namespace {
+/** One record read by LoadWallet, the value of a "tx" record already deserialized */
+struct CWalletLoadRecord
+{
+    CDataStream ssKey{SER_DISK, CLIENT_VERSION};
+    CDataStream ssValue{SER_DISK, CLIENT_VERSION};
+    std::unique_ptr<CWalletTx> pwtx;
+    bool fDecodeFailed{false};
+};
+
+void DecodeWalletTx(CWalletLoadRecord& rec)
+{
+    try {
+        CDataStream ssType(rec.ssKey);
+        std::string strType;
+        ssType >> strType;
+        if (strType != "tx")
+            return;
+        std::unique_ptr<CWalletTx> pwtx(new CWalletTx());
+        rec.ssValue >> *pwtx;
+        rec.pwtx = std::move(pwtx);
+    } catch (...) {
+        rec.fDecodeFailed = true;
+    }
+}
+} // namespace
+
 bool
 ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
-             CWalletScanState &wss, std::string& strType, std::string& strErr)
+             CWalletScanState &wss, std::string& strType, std::string& strErr,
+             CWalletTx* pwtxDecoded = nullptr)
 {
     try {
         // Unserialize
@@ -268,7 +301,10 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
             uint256 hash;
             ssKey >> hash;
             CWalletTx wtx;
-            ssValue >> wtx;
+            if (pwtxDecoded)
+                wtx = std::move(*pwtxDecoded);
+            else
+                ssValue >> wtx;
             CValidationState state;
             int nHeight = INT_MAX;
             if(!wtx.tx->vin.empty()){
@@ -559,39 +595,62 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             return DB_CORRUPT;
         }
 
-        while (true)
+        // Records are read off the cursor a batch at a time, the transactions of a batch
+        // are deserialized in parallel and then every record is applied in cursor order.
+        std::vector<CWalletLoadRecord> vRecords;
+        bool fDone = false;
+        while (!fDone)
         {
-            // Read next record
-            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            int ret = batch.ReadAtCursor(pcursor, ssKey, ssValue);
-            if (ret == DB_NOTFOUND)
-                break;
-            else if (ret != 0)
+            vRecords.clear();
+            while (vRecords.size() < WALLET_LOAD_BATCH_SIZE)
             {
-                LogPrintf("Error reading next record from wallet database\n");
-                return DB_CORRUPT;
+                // Read next record
+                vRecords.emplace_back();
+                int ret = batch.ReadAtCursor(pcursor, vRecords.back().ssKey, vRecords.back().ssValue);
+                if (ret == DB_NOTFOUND)
+                {
+                    vRecords.pop_back();
+                    fDone = true;
+                    break;
+                }
+                else if (ret != 0)
+                {
+                    LogPrintf("Error reading next record from wallet database\n");
+                    return DB_CORRUPT;
+                }
             }
 
-            // Try to be tolerant of single corrupt records:
-            std::string strType, strErr;
-            if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
+            sigma::parallel_for(vRecords.size(), GetNumCores(), [&](std::size_t i) {
+                DecodeWalletTx(vRecords[i]);
+            });
+
+            for (CWalletLoadRecord& rec : vRecords)
             {
-                // losing keys is considered a catastrophic error, anything else
-                // we assume the user can live with:
-                if (IsKeyType(strType) || strType == "defaultkey")
-                    result = DB_CORRUPT;
+                // Try to be tolerant of single corrupt records:
+                std::string strType, strErr;
+                bool fRead = false;
+                if (rec.fDecodeFailed)
+                    strType = "tx";
                 else
+                    fRead = ReadKeyValue(pwallet, rec.ssKey, rec.ssValue, wss, strType, strErr, rec.pwtx.get());
+                if (!fRead)
                 {
-                    // Leave other errors alone, if we try to fix them we might make things worse.
-                    fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
-                    if (strType == "tx")
-                        // Rescan if there is a bad transaction record:
-                        gArgs.SoftSetBoolArg("-rescan", true);
+                    // losing keys is considered a catastrophic error, anything else
+                    // we assume the user can live with:
+                    if (IsKeyType(strType) || strType == "defaultkey")
+                        result = DB_CORRUPT;
+                    else
+                    {
+                        // Leave other errors alone, if we try to fix them we might make things worse.
+                        fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
+                        if (strType == "tx")
+                            // Rescan if there is a bad transaction record:
+                            gArgs.SoftSetBoolArg("-rescan", true);
+                    }
                 }
+                if (!strErr.empty())
+                    LogPrintf("%s\n", strErr);
             }
-            if (!strErr.empty())
-                LogPrintf("%s\n", strErr);
         }
         pcursor->close();
     }
@@ -602,6 +661,8 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
         result = DB_CORRUPT;
     }
 
+    pwallet->FinishLoadTransactions();
+
     if (fNoncriticalErrors && result == DB_LOAD_OK)
         result = DB_NONCRITICAL_ERROR;
 
@@ -913,6 +974,14 @@ bool CWalletDB::EraseUnloadedZCEntry(const CZerocoinEntry &zerocoin) {
     return EraseIC(make_pair(string("unloadedzerocoin"), zerocoin.value));
 }
 
+bool CWalletDB::WriteZerocoinWitness(const CZerocoinWitnessEntry &witness) {
+    return WriteIC(make_pair(string("zcwitness"), witness.pubCoin), witness);
+}
+
+bool CWalletDB::EraseZerocoinWitness(const CZerocoinWitnessEntry &witness) {
+    return EraseIC(make_pair(string("zcwitness"), witness.pubCoin));
+}
+
 // Check Calculated Blocked for Zerocoin
 bool CWalletDB::ReadCalculatedZCBlock(int &height) {
     height = 0;
@@ -989,6 +1058,39 @@ void CWalletDB::ListUnloadedPubCoin(std::list <CZerocoinEntry> &listUnloadedPubC
     pcursor->close();
 }
 
+void CWalletDB::ListZerocoinWitnesses(std::list <CZerocoinWitnessEntry> &listWitness) {
+    Dbc *pcursor = batch.GetCursor();
+    if (!pcursor)
+        throw runtime_error("CWalletDB::ListZerocoinWitnesses() : cannot create DB cursor");
+    unsigned int fFlags = DB_SET_RANGE;
+    while (true) {
+        // Read next record
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        if (fFlags == DB_SET_RANGE)
+            ssKey << make_pair(string("zcwitness"), CBigNum(0));
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        int ret = batch.ReadAtCursor(pcursor, ssKey, ssValue, fFlags);
+        fFlags = DB_NEXT;
+        if (ret == DB_NOTFOUND)
+            break;
+        else if (ret != 0) {
+            pcursor->close();
+            throw runtime_error("CWalletDB::ListZerocoinWitnesses() : error scanning DB");
+        }
+        // Unserialize
+        string strType;
+        ssKey >> strType;
+        if (strType != "zcwitness")
+            break;
+        CBigNum value;
+        ssKey >> value;
+        CZerocoinWitnessEntry witness;
+        ssValue >> witness;
+        listWitness.push_back(witness);
+    }
+    pcursor->close();
+}
+
 void CWalletDB::ListCoinSpendSerial(std::list <CZerocoinSpendEntry> &listCoinSpendSerial) {
     Dbc *pcursor = batch.GetCursor();
     if (!pcursor)
@@ -48,6 +48,7 @@ class CWalletTx;
 class uint160;
 class uint256;
 class CZerocoinEntry;
+class CZerocoinWitnessEntry;
 class CZerocoinSpendEntry;
 class CGovernanceEntry;
 class CSigmaMint;
@@ -379,6 +380,9 @@ public:
     bool WriteZerocoinEntry(const CZerocoinEntry& zerocoin);
     bool EraseZerocoinEntry(const CZerocoinEntry& zerocoin);
     void ListPubCoin(std::list<CZerocoinEntry>& listPubCoin);
+    bool WriteZerocoinWitness(const CZerocoinWitnessEntry& witness);
+    bool EraseZerocoinWitness(const CZerocoinWitnessEntry& witness);
+    void ListZerocoinWitnesses(std::list<CZerocoinWitnessEntry>& listWitness);
     void ListCoinSpendSerial(std::list<CZerocoinSpendEntry>& listCoinSpendSerial);
     bool WriteCoinSpendSerialEntry(const CZerocoinSpendEntry& zerocoinSpend);
     bool EraseCoinSpendSerialEntry(const CZerocoinSpendEntry& zerocoinSpend);
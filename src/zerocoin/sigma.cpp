@@ -4,11 +4,15 @@
 
 #include <zerocoin/sigma.h>
 #include <zerocoin/zerocoin.h>
+#include <zerocoin/sigmacache.h>
+#include <memusage.h>
 #include <timedata.h>
+#include <txdb.h>
 #include <util.h>
 #include <base58.h>
 #include <wallet/wallet.h>
 #include <wallet/walletdb.h>
+#include <algorithm>
 #include <atomic>
 #include <sstream>
 #include <chrono>
@@ -66,6 +70,17 @@ bool IsSigmaAllowed()
     return IsSigmaAllowed(chainActive.Height());
 }
 
+bool IsSigmaV3Allowed(int height)
+{
+    return height >= Params().GetConsensus().nSigmaV3StartBlock;
+}
+
+bool IsSigmaV3Allowed()
+{
+    LOCK(cs_main);
+    return IsSigmaV3Allowed(chainActive.Height());
+}
+
 secp_primitives::GroupElement ParseSigmaMintScript(const CScript& script)
 {
     if (script.size() < 1) {
@@ -94,11 +109,25 @@ std::pair<std::unique_ptr<sigma::CoinSpend>, uint32_t> ParseSigmaSpend(const CTx
         PROTOCOL_VERSION
     );
 
-    std::unique_ptr<sigma::CoinSpend> spend(new sigma::CoinSpend(SParams, serialized));
+    std::unique_ptr<sigma::CoinSpend> spend(new sigma::CoinSpend(SParams, serialized, in.scriptSig.IsCompactSigmaSpend()));
 
     return std::make_pair(std::move(spend), groupId);
 }
 
+std::pair<sigma::CoinSpendView, uint32_t> ParseSigmaSpendView(const CTxIn& in)
+{
+    uint32_t groupId = in.prevout.n;
+
+    if (groupId < 1 || groupId >= INT_MAX || in.scriptSig.size() < 1) {
+        throw CBadTxIn();
+    }
+
+    sigma::CoinSpendView spend(SParams, in.scriptSig.data() + 1, in.scriptSig.data() + in.scriptSig.size(),
+                               in.scriptSig.IsCompactSigmaSpend());
+
+    return std::make_pair(spend, groupId);
+}
+
 bool CheckSigmaSpendTransaction(
         const CTransaction &tx,
         const vector<sigma::CoinDenomination>& targetDenominations,
@@ -112,6 +141,19 @@ bool CheckSigmaSpendTransaction(
     bool hasSigmaSpendInputs = false, hasNonSigmaInputs = false;
     int vinIndex = -1;
     std::unordered_set<Scalar, sigma::CScalarHash> spendSerials;
+    // hash of the transaction sans the sigma part, used as metadata by every spend
+    const uint256 &txHashForMetadata = tx.GetSigmaMetaDataHash();
+
+    // Proofs checked here and not found in the cache, verified together per coin group
+    // once every input has been looked at
+    struct CPendingProofs {
+        std::shared_ptr<const std::vector<GroupElement>> coins;
+        std::vector<std::unique_ptr<sigma::CoinSpend>> spends;
+        std::vector<std::size_t> setSizes;
+        std::vector<bool> fPadding;
+        std::vector<uint256> cacheEntries;
+    };
+    std::map<std::pair<sigma::CoinDenomination, int>, CPendingProofs> pendingProofs;
 
     for (const CTxIn &txin : tx.vin)
     {
@@ -133,23 +175,23 @@ bool CheckSigmaSpendTransaction(
                 "CheckSigmaSpendTransaction: invalid spend transaction");
         }
 
-        if (spend->getVersion() != sigma::SIGMA_VERSION_1 && spend->getVersion() != sigma::SIGMA_VERSION_2) {
+        if (spend->getVersion() != sigma::SIGMA_VERSION_1 && spend->getVersion() != sigma::SIGMA_VERSION_2 &&
+                spend->getVersion() != sigma::SIGMA_VERSION_3) {
             return state.DoS(100,
                              false,
                              NSEQUENCE_INCORRECT,
                              "CTransaction::CheckTransaction() : Error: incorrect spend transaction version");
         }
 
-        uint256 txHashForMetadata;
-
-        // Obtain the hash of the transaction sans the sigma part
-        CMutableTransaction txTemp = tx;
-        for(CTxIn &txTempIn: txTemp.vin) {
-            if (txTempIn.scriptSig.IsSigmaSpend()) {
-                txTempIn.scriptSig.clear();
-            }
+        // version 3 is exactly the compact encoding, which is only allowed once activated
+        if ((spend->getVersion() == sigma::SIGMA_VERSION_3) != txin.scriptSig.IsCompactSigmaSpend()) {
+            return state.DoS(100, false, REJECT_MALFORMED,
+                             "CheckSigmaSpendTransaction: spend version does not match its encoding");
+        }
+        if (txin.scriptSig.IsCompactSigmaSpend() && !(nHeight == INT_MAX ? IsSigmaV3Allowed() : IsSigmaV3Allowed(nHeight))) {
+            return state.DoS(100, false, REJECT_MALFORMED,
+                             "CheckSigmaSpendTransaction: premature compact sigma spend");
         }
-        txHashForMetadata = txTemp.GetHash();
 
         CSigmaState::CoinGroupInfo coinGroup;
         if (!sigmaState.GetCoinGroupInfo(targetDenominations[vinIndex], pubcoinId, coinGroup))
@@ -157,7 +199,6 @@ bool CheckSigmaSpendTransaction(
                     "CheckSigmaSpendTransaction: Error: no coins were minted with such parameters");
 
         bool passVerify = false;
-        CBlockIndex *index = coinGroup.lastBlock;
         pair<sigma::CoinDenomination, int> denominationAndId = std::make_pair(
             targetDenominations[vinIndex], pubcoinId);
 
@@ -169,23 +210,6 @@ bool CheckSigmaSpendTransaction(
             accumulatorBlockHash,
             txHashForMetadata);
 
-        // find index for block with hash of accumulatorBlockHash or set index to the coinGroup.firstBlock if not found
-        while (index != coinGroup.firstBlock && index->GetBlockHash() != accumulatorBlockHash)
-            index = index->pprev;
-
-        // Build a vector with all the public coins with given denomination and accumulator id before
-        // the block on which the spend occured.
-        // This list of public coins is required by function "Verify" of CoinSpend.
-        std::vector<sigma::PublicCoin> anonymity_set;
-        while(true) {
-            for(const sigma::PublicCoin& pubCoinValue: index->mintedPubCoinsV2[denominationAndId]) {
-                anonymity_set.push_back(pubCoinValue);
-            }
-            if (index == coinGroup.firstBlock)
-                break;
-            index = index->pprev;
-        }
-
         bool fPadding = spend->getVersion() >= sigma::SIGMA_VERSION_2;
         // require version 2 right away on full sync
         if (!isVerifyDB) {
@@ -197,7 +221,30 @@ bool CheckSigmaSpendTransaction(
             }
         }
 
-        passVerify = spend->Verify(anonymity_set, newMetaData, fPadding);
+        // When checking a block the sigma proof is only queued here, all the proofs sharing a coin group
+        // are verified together in ConnectBlockSigma. The signature is still checked right away.
+        // Otherwise proofs not in the cache are verified at the end, together with those of the other
+        // inputs of the transaction spending from the same coin group.
+        bool fDeferProof = sigmaTxInfo && !sigmaTxInfo->fInfoIsComplete && !isCheckWallet;
+        CSigmaState::CAnonymitySet anonymitySet;
+        uint256 cacheEntry;
+        bool fProofPending = false;
+        if (fDeferProof) {
+            passVerify = spend->VerifySignature(newMetaData);
+        }
+        else {
+            // All the public coins with given denomination and accumulator id up to the block
+            // with hash of accumulatorBlockHash
+            passVerify = sigmaState.GetAnonymitySet(
+                        targetDenominations[vinIndex], pubcoinId, accumulatorBlockHash, anonymitySet)
+                    && spend->VerifySignature(newMetaData);
+            if (passVerify) {
+                cacheEntry = GetSigmaProofCacheEntry(
+                            *spend, pubcoinId, anonymitySet.blockHash, anonymitySet.setSize, txHashForMetadata);
+                fProofPending = !IsSigmaProofCached(cacheEntry);
+            }
+        }
+
         if (passVerify) {
             Scalar serial = spend->getCoinSerialNumber();
             // do not check for duplicates in case we've seen exact copy of this tx in this block before
@@ -220,6 +267,23 @@ bool CheckSigmaSpendTransaction(
                     sigmaTxInfo->sTransactions.insert(hashTx);
                 }
             }
+
+            if (fDeferProof) {
+                CSigmaTxInfo::CSpendBatch &batch = sigmaTxInfo->spendBatches[denominationAndId];
+                batch.fPadding.push_back(fPadding);
+                batch.metaDataHashes.push_back(txHashForMetadata);
+                batch.spends.push_back(std::move(spend));
+            }
+            else if (fProofPending) {
+                CPendingProofs &pending = pendingProofs[denominationAndId];
+                // the coins of a group only grow, the largest set covers every spend
+                if (!pending.coins || pending.coins->size() < anonymitySet.coins->size())
+                    pending.coins = anonymitySet.coins;
+                pending.setSizes.push_back(anonymitySet.setSize);
+                pending.fPadding.push_back(fPadding);
+                pending.cacheEntries.push_back(cacheEntry);
+                pending.spends.push_back(std::move(spend));
+            }
         }
         else {
             LogPrintf("CheckSigmaSpendTransaction: verification failed at block=%d, denomID=%d, pubcoinID=%d\n", nHeight, spend->getDenomination(), pubcoinId);
@@ -227,6 +291,20 @@ bool CheckSigmaSpendTransaction(
         }
     }
 
+    for (const auto &pendingEntry : pendingProofs) {
+        const CPendingProofs &pending = pendingEntry.second;
+        std::vector<const sigma::CoinSpend*> spends;
+        for (const auto &spend : pending.spends)
+            spends.push_back(spend.get());
+        if (!sigma::CoinSpend::BatchVerify(SParams, *pending.coins, spends, pending.setSizes, pending.fPadding)) {
+            LogPrintf("CheckSigmaSpendTransaction: verification failed at block=%d, denomID=%d, pubcoinID=%d\n",
+                      nHeight, pendingEntry.first.first, pendingEntry.first.second);
+            return false;
+        }
+        for (const uint256 &cacheEntry : pending.cacheEntries)
+            AddSigmaProofToCache(cacheEntry);
+    }
+
     if(!isVerifyDB && !isCheckWallet) {
         if (sigmaTxInfo && !sigmaTxInfo->fInfoIsComplete) {
             sigmaTxInfo->sTransactions.insert(hashTx);
@@ -248,6 +326,7 @@ bool CheckSigmaSpendTransaction(
 
 bool CheckSigmaMintTransaction(
         const CTxOut &txout,
+        uint32_t nOut,
         CValidationState &state,
         uint256 hashTx,
         CSigmaTxInfo *sigmaTxInfo) {
@@ -273,14 +352,9 @@ bool CheckSigmaMintTransaction(
     sigma::PublicCoin pubCoin(pubCoinValue, denomination);
     bool hasCoin = sigmaState.HasCoin(pubCoin);
 
-    if (!hasCoin && sigmaTxInfo && !sigmaTxInfo->fInfoIsComplete) {
-        for(const sigma::PublicCoin& mint: sigmaTxInfo->mints) {
-            if (mint == pubCoin) {
-                hasCoin = true;
-                break;
-            }
-        }
-    }
+    // every mint of the block so far is in mintOutPoints, hashed by its cached value hash
+    if (!hasCoin && sigmaTxInfo && !sigmaTxInfo->fInfoIsComplete)
+        hasCoin = sigmaTxInfo->mintOutPoints.count(pubCoin) != 0;
 
     /*
     if (hasCoin) {
@@ -298,6 +372,7 @@ bool CheckSigmaMintTransaction(
     if (sigmaTxInfo != NULL && !sigmaTxInfo->fInfoIsComplete) {
         // Update public coin list in the info
         sigmaTxInfo->mints.push_back(pubCoin);
+        sigmaTxInfo->mintOutPoints.insert(std::make_pair(pubCoin, COutPoint(hashTx, nOut)));
         sigmaTxInfo->sTransactions.insert(hashTx);
     }
 
@@ -328,9 +403,10 @@ bool CheckSigmaTransaction(
                              REJECT_MALFORMED,
                              "CheckSigmaTransaction: premature sigma transaction");
 
-    for (const CTxOut &txout : tx.vout) {
+    for (uint32_t nOut = 0; nOut < tx.vout.size(); nOut++) {
+        const CTxOut &txout = tx.vout[nOut];
         if (!txout.scriptPubKey.empty() && txout.scriptPubKey.IsSigmaMint()) {
-            if (!CheckSigmaMintTransaction(txout, state, hashTx, sigmaTxInfo))
+            if (!CheckSigmaMintTransaction(txout, nOut, state, hashTx, sigmaTxInfo))
                 return false;
         }
     }
@@ -353,10 +429,8 @@ bool CheckSigmaTransaction(
                 return false;
             }
 
-            CDataStream serializedCoinSpend((const char *)&*(txin.scriptSig.begin() + 1),
-                                            (const char *)&*txin.scriptSig.end(),
-                                            SER_NETWORK, PROTOCOL_VERSION);
-            sigma::CoinSpend newSpend(SParams, serializedCoinSpend);
+            sigma::CoinSpendView newSpend(SParams, txin.scriptSig.data() + 1, txin.scriptSig.data() + txin.scriptSig.size(),
+                                          txin.scriptSig.IsCompactSigmaSpend());
             uint64_t denom = newSpend.getIntDenomination();
             totalValue += denom;
             sigma::CoinDenomination denomination;
@@ -379,6 +453,67 @@ bool CheckSigmaTransaction(
     return true;
 }
 
+bool PreVerifySigmaSpend(const CTransaction &tx, CValidationState &state, bool fProofsVerified)
+{
+    AssertLockNotHeld(cs_main);
+    if (!tx.IsSigmaSpend())
+        return true;
+
+    const uint256 &txHashForMetadata = tx.GetSigmaMetaDataHash();
+    std::vector<std::unique_ptr<sigma::CoinSpend>> spends;
+    std::vector<CSigmaState::CAnonymitySet> anonymitySets;
+    std::vector<uint32_t> pubcoinIds;
+
+    try {
+        for (const CTxIn &txin : tx.vin) {
+            std::unique_ptr<sigma::CoinSpend> spend;
+            uint32_t pubcoinId;
+            std::tie(spend, pubcoinId) = ParseSigmaSpend(txin);
+            spends.push_back(std::move(spend));
+            pubcoinIds.push_back(pubcoinId);
+        }
+    } catch (const std::exception &) {
+        return true;
+    }
+
+    {
+        // The sets share their coins with the state and stay valid once the lock is released
+        LOCK(cs_main);
+        for (std::size_t i = 0; i < spends.size(); i++) {
+            CSigmaState::CAnonymitySet anonymitySet;
+            if (!sigmaState.GetAnonymitySet(spends[i]->getDenomination(), pubcoinIds[i],
+                                            spends[i]->getAccumulatorBlockHash(), anonymitySet))
+                return true;
+            anonymitySets.push_back(std::move(anonymitySet));
+        }
+    }
+
+    for (std::size_t i = 0; i < spends.size(); i++) {
+        const sigma::CoinSpend &spend = *spends[i];
+        const CSigmaState::CAnonymitySet &anonymitySet = anonymitySets[i];
+        uint256 cacheEntry = GetSigmaProofCacheEntry(
+                    spend, pubcoinIds[i], anonymitySet.blockHash, anonymitySet.setSize, txHashForMetadata);
+        if (IsSigmaProofCached(cacheEntry))
+            continue;
+        if (fProofsVerified) {
+            AddSigmaProofToCache(cacheEntry);
+            continue;
+        }
+
+        sigma::SpendMetaData metaData(pubcoinIds[i], spend.getAccumulatorBlockHash(), txHashForMetadata);
+        bool fPadding = spend.getVersion() >= sigma::SIGMA_VERSION_2;
+        if (!spend.VerifySignature(metaData) ||
+                !sigma::CoinSpend::BatchVerify(SParams, *anonymitySet.coins, {&spend}, {anonymitySet.setSize}, {fPadding})) {
+            LogPrintf("PreVerifySigmaSpend: verification failed for tx %s, denomID=%d, pubcoinID=%d\n",
+                      tx.GetHash().ToString(), spend.getDenomination(), pubcoinIds[i]);
+            return state.Invalid(false, REJECT_INVALID, "bad-sigma-spend-proof");
+        }
+        AddSigmaProofToCache(cacheEntry);
+    }
+
+    return true;
+}
+
 void DisconnectTipSigma(CBlock & /*block*/, CBlockIndex *pindexDelete) {
     sigmaState.RemoveBlock(pindexDelete);
 }
@@ -388,11 +523,8 @@ Scalar SigmaGetSpendSerialNumber(const CTransaction &tx, const CTxIn &txin) {
         return Scalar(uint64_t(0));
 
     try {
-        CDataStream serializedCoinSpend(
-                (const char *)&*(txin.scriptSig.begin() + 1),
-                (const char *)&*txin.scriptSig.end(),
-                SER_NETWORK, PROTOCOL_VERSION);
-        sigma::CoinSpend spend(SParams, serializedCoinSpend);
+        sigma::CoinSpendView spend(SParams, txin.scriptSig.data() + 1, txin.scriptSig.data() + txin.scriptSig.size(),
+                                   txin.scriptSig.IsCompactSigmaSpend());
         return spend.getCoinSerialNumber();
     }
     catch (const std::ios_base::failure &) {
@@ -407,11 +539,8 @@ CAmount GetSpendTransactionInput(const CTransaction &tx) {
     try {
         CAmount sum(0);
         for(const CTxIn& txin: tx.vin){
-            CDataStream serializedCoinSpend(
-                    (const char *)&*(txin.scriptSig.begin() + 1),
-                    (const char *)&*txin.scriptSig.end(),
-                    SER_NETWORK, PROTOCOL_VERSION);
-            sigma::CoinSpend spend(SParams, serializedCoinSpend);
+            sigma::CoinSpendView spend(SParams, txin.scriptSig.data() + 1, txin.scriptSig.data() + txin.scriptSig.size(),
+                                       txin.scriptSig.IsCompactSigmaSpend());
             sum += spend.getIntDenomination();
         }
         return sum;
@@ -422,6 +551,80 @@ CAmount GetSpendTransactionInput(const CTransaction &tx) {
 }
 
 
+bool CSigmaProofCheck::operator()() {
+    if (!sigma::CoinSpend::BatchVerify(SParams, *coins, spends, setSizes, fPadding))
+        return false;
+
+    for (const uint256 &entry: cacheEntries)
+        AddSigmaProofToCache(entry);
+    return true;
+}
+
+bool CheckSigmaSpendProofs(
+        CValidationState &state,
+        CSigmaTxInfo *sigmaTxInfo,
+        int nHeight,
+        std::vector<CSigmaProofCheck> *pvChecks) {
+    if (sigmaTxInfo->fSpendsVerified)
+        return true;
+
+    // split every batch so that each check thread gets a share of it
+    std::size_t nChecksPerBatch = pvChecks ? std::max(nScriptCheckThreads, 1) : 1;
+
+    for (const auto &batchEntry: sigmaTxInfo->spendBatches) {
+        const CSigmaTxInfo::CSpendBatch &batch = batchEntry.second;
+
+        // every spend of the group refers to the same coins, only the set size differs.
+        // Proofs already verified when the spends entered the mempool are skipped
+        CSigmaState::CAnonymitySet anonymitySet;
+        std::vector<const sigma::CoinSpend *> spends;
+        std::vector<std::size_t> setSizes;
+        std::vector<bool> fPadding;
+        std::vector<uint256> cacheEntries;
+        for (std::size_t i = 0; i < batch.spends.size(); i++) {
+            const sigma::CoinSpend &spend = *batch.spends[i];
+            if (!sigmaState.GetAnonymitySet(batchEntry.first.first, batchEntry.first.second,
+                                            spend.getAccumulatorBlockHash(), anonymitySet))
+                return state.DoS(100, false, NO_MINT_ZEROCOIN, "bad-sigma-spend-group");
+
+            uint256 cacheEntry = GetSigmaProofCacheEntry(spend, batchEntry.first.second,
+                    anonymitySet.blockHash, anonymitySet.setSize, batch.metaDataHashes[i]);
+            if (IsSigmaProofCached(cacheEntry))
+                continue;
+
+            spends.push_back(&spend);
+            setSizes.push_back(anonymitySet.setSize);
+            fPadding.push_back(batch.fPadding[i]);
+            cacheEntries.push_back(cacheEntry);
+        }
+
+        std::size_t nSpends = spends.size();
+        std::size_t nChecks = std::min(nSpends, nChecksPerBatch);
+        for (std::size_t i = 0; i < nChecks; i++) {
+            std::size_t begin = nSpends * i / nChecks, end = nSpends * (i + 1) / nChecks;
+            CSigmaProofCheck check(anonymitySet.coins,
+                    std::vector<const sigma::CoinSpend *>(spends.begin() + begin, spends.begin() + end),
+                    std::vector<std::size_t>(setSizes.begin() + begin, setSizes.begin() + end),
+                    std::vector<bool>(fPadding.begin() + begin, fPadding.begin() + end),
+                    std::vector<uint256>(cacheEntries.begin() + begin, cacheEntries.begin() + end));
+
+            if (pvChecks) {
+                pvChecks->push_back(CSigmaProofCheck());
+                check.swap(pvChecks->back());
+            }
+            else if (!check()) {
+                LogPrintf("ConnectBlockSigma: batch verification of %d spends failed at block=%d, denomID=%d, pubcoinID=%d\n",
+                          end - begin, nHeight, batchEntry.first.first, batchEntry.first.second);
+                return state.DoS(100, false, REJECT_INVALID, "bad-sigma-spend-proof");
+            }
+        }
+    }
+
+    if (!pvChecks)
+        sigmaTxInfo->fSpendsVerified = true;
+    return true;
+}
+
 /**
  * Connect a new sigma block to chainActive. pblock is either NULL or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
@@ -431,12 +634,18 @@ bool ConnectBlockSigma(
         const CChainParams &chainparams,
         CBlockIndex *pindexNew,
         const CBlock *pblock,
+        CPrivacyBlockData &privacyData,
         bool fJustCheck) {
-    // Add sigma transaction information to index
+    // Add sigma transaction information to the privacy data of the block
     if (pblock && pblock->sigmaTxInfo) {
-        
+
+        if (!CheckSigmaSpendProofs(state, pblock->sigmaTxInfo.get(), pindexNew->nHeight))
+            return false;
+        // proofs are not needed anymore
+        pblock->sigmaTxInfo->spendBatches.clear();
+
         if (!fJustCheck)
-            pindexNew->spentSerialsV2.clear();
+            privacyData.spentSerialsV2.clear();
         
         for(auto& serial: pblock->sigmaTxInfo->spentSerials) {
             if (!CheckSigmaSpendSerial(state, pblock->sigmaTxInfo.get(), serial.first,
@@ -445,7 +654,7 @@ bool ConnectBlockSigma(
             }
             
             if (!fJustCheck) {
-                pindexNew->spentSerialsV2.insert(serial.first);
+                privacyData.spentSerialsV2.insert(serial.first);
                 sigmaState.AddSpend(serial.first);
             }
         }
@@ -455,15 +664,23 @@ bool ConnectBlockSigma(
         if (fJustCheck)
             return true;
         
-        // Update pindexNew.mintedPubCoins
+        // Update the minted coins of the block
+        std::vector<std::pair<uint256, COutPoint>> vMintOutPoints;
         for(const sigma::PublicCoin& mint: pblock->sigmaTxInfo->mints) {
             sigma::CoinDenomination denomination = mint.getDenomination();
-            int mintId = sigmaState.AddMint(pindexNew,	mint);
+            auto outpoint = pblock->sigmaTxInfo->mintOutPoints.find(mint);
+            int mintId = sigmaState.AddMint(pindexNew, mint,
+                    outpoint != pblock->sigmaTxInfo->mintOutPoints.end() ? outpoint->second : COutPoint());
+            if (outpoint != pblock->sigmaTxInfo->mintOutPoints.end())
+                vMintOutPoints.push_back(std::make_pair(mint.getValueHash(), outpoint->second));
             
             //LogPrintf("ConnectTipSigma: mint added denomination=%d, id=%d\n", denomination, mintId);
             pair<sigma::CoinDenomination, int> denomAndId = make_pair(denomination, mintId);
-            pindexNew->mintedPubCoinsV2[denomAndId].push_back(mint);
+            privacyData.mintedPubCoinsV2[denomAndId].push_back(mint);
         }
+        // kept for the wallets to find their mints once the block is pruned
+        if (!vMintOutPoints.empty() && !pprivacyindex->WriteMintOutPoints(vMintOutPoints))
+            return state.Error("ConnectBlockSigma : failed to write the mint outpoints");
     }
     else if (!fJustCheck) {
         sigmaState.AddBlock(pindexNew);
@@ -474,10 +691,10 @@ bool ConnectBlockSigma(
 
 bool SigmaBuildStateFromIndex(CChain *chain) {
     sigmaState.Reset();
-    for (CBlockIndex *blockIndex = chain->Genesis(); blockIndex; blockIndex=chain->Next(blockIndex))
-    {
-        sigmaState.AddBlock(blockIndex);
-    }
+    if (!pprivacyindex->ForEachBlock(*chain, [](CBlockIndex *blockIndex, const CPrivacyBlockData &blockData) {
+            sigmaState.AddBlock(blockIndex, blockData);
+        }))
+        return false;
     // DEBUG
     LogPrintf(
         "Latest IDs for sigma coin groups are %d, %d, %d, %d, %d\n",
@@ -511,19 +728,35 @@ void CSigmaTxInfo::Complete() {
 CSigmaState::CSigmaState() {
 }
 
+CSigmaState::CDenominationShard *CSigmaState::GetShard(sigma::CoinDenomination denomination) {
+    std::size_t index = (std::size_t)denomination;
+    return index < shards.size() ? &shards[index] : NULL;
+}
+
+const CSigmaState::CDenominationShard *CSigmaState::GetShard(sigma::CoinDenomination denomination) const {
+    std::size_t index = (std::size_t)denomination;
+    return index < shards.size() ? &shards[index] : NULL;
+}
+
 int CSigmaState::AddMint(
         CBlockIndex *index,
-        const sigma::PublicCoin &pubCoin) {
+        const sigma::PublicCoin &pubCoin,
+        const COutPoint &outpoint) {
     sigma::CoinDenomination denomination = pubCoin.getDenomination();
+    CDenominationShard *shard = GetShard(denomination);
+    assert(shard);
+
+    boost::unique_lock<boost::shared_mutex> lock(shard->cs);
+    shard->nGeneration++;
 
-    if (latestCoinIds[denomination] < 1)
-        latestCoinIds[denomination] = 1;
-    int	mintCoinGroupId = latestCoinIds[denomination];
+    if (shard->latestCoinId < 1)
+        shard->latestCoinId = 1;
+    int	mintCoinGroupId = shard->latestCoinId;
 
     // ZC_SPEND__COINSPERID = 15.000, yet the actual limit of coins per accumlator is 16.000.
     // We need to cut at 15.000, such that we always have enough space for new mints. Mints for
     // each block will end up in the same accumulator.
-    CoinGroupInfo &coinGroup = coinGroups[make_pair(denomination, mintCoinGroupId)];
+    CoinGroupInfo &coinGroup = shard->coinGroups[mintCoinGroupId];
     int coinsPerId = COINS_PER_ID;
     if (coinGroup.nCoins < coinsPerId // there's still space in the accumulator
         || coinGroup.lastBlock == index // or we have already placed some coins from current block.
@@ -537,8 +770,8 @@ int CSigmaState::AddMint(
         }
     }
     else {
-        latestCoinIds[denomination] = ++mintCoinGroupId;
-        CoinGroupInfo& newCoinGroup = coinGroups[std::make_pair(denomination, mintCoinGroupId)];
+        shard->latestCoinId = ++mintCoinGroupId;
+        CoinGroupInfo& newCoinGroup = shard->coinGroups[mintCoinGroupId];
         newCoinGroup.firstBlock = newCoinGroup.lastBlock = index;
         newCoinGroup.nCoins = 1;
     }
@@ -546,101 +779,173 @@ int CSigmaState::AddMint(
     coinInfo.denomination = denomination;
     coinInfo.id = mintCoinGroupId;
     coinInfo.nHeight = index->nHeight;
-    mintedPubCoins.insert(std::make_pair(pubCoin, coinInfo));
+    coinInfo.outpoint = outpoint;
+    AddMintedCoin(*shard, pubCoin, coinInfo);
+
+    // coins of the block are kept in reverse order, put the new one in front of its block
+    CoinGroupCoins &groupCoins = shard->coinGroupCoins[mintCoinGroupId];
+    std::vector<GroupElement> &coins = GetMutableCoins(groupCoins);
+    if (groupCoins.blocks.empty() || groupCoins.blocks.back().first != index)
+        groupCoins.blocks.emplace_back(index, coins.size());
+    std::size_t blockStart = groupCoins.blocks.size() > 1 ? groupCoins.blocks[groupCoins.blocks.size() - 2].second : 0;
+    coins.insert(coins.begin() + blockStart, pubCoin.getValue());
+    groupCoins.setSizes[index->GetBlockHash()] = ++groupCoins.blocks.back().second;
+
     return mintCoinGroupId;
 }
 
+std::vector<GroupElement> &CSigmaState::GetMutableCoins(CoinGroupCoins &groupCoins) {
+    if (!groupCoins.coins)
+        groupCoins.coins = std::make_shared<std::vector<GroupElement>>();
+    else if (groupCoins.coins.use_count() != 1)
+        groupCoins.coins = std::make_shared<std::vector<GroupElement>>(*groupCoins.coins);
+    return *groupCoins.coins;
+}
+
+void CSigmaState::AddBlockCoins(
+        CDenominationShard &shard,
+        CBlockIndex *index,
+        int id,
+        const vector<sigma::PublicCoin> &pubCoins) {
+    CoinGroupCoins &groupCoins = shard.coinGroupCoins[id];
+    std::vector<GroupElement> &coins = GetMutableCoins(groupCoins);
+    for (auto it = pubCoins.rbegin(); it != pubCoins.rend(); ++it)
+        coins.push_back(it->getValue());
+    groupCoins.blocks.emplace_back(index, coins.size());
+    groupCoins.setSizes[index->GetBlockHash()] = coins.size();
+}
+
 void CSigmaState::AddSpend(const Scalar &serial) {
-    usedCoinSerials.insert(serial);
+    AddUsedSerial(serial);
+}
+
+void CSigmaState::AddUsedSerial(const Scalar &serial) {
+    if (usedCoinSerials.insert(serial).second)
+        usedCoinSerialHashes.insert(std::make_pair(GetSerialHash(serial), serial));
 }
 
 void CSigmaState::AddBlock(CBlockIndex *index) {
+    AddBlock(index, *pprivacyindex->ReadBlock(index));
+}
+
+void CSigmaState::AddBlock(CBlockIndex *index, const CPrivacyBlockData &blockData) {
     for(
         const PAIRTYPE(PAIRTYPE(sigma::CoinDenomination, int), vector<sigma::PublicCoin>) &pubCoins:
-            index->mintedPubCoinsV2) {
+            blockData.mintedPubCoinsV2) {
+        CDenominationShard *shard = GetShard(pubCoins.first.first);
+        assert(shard);
+
+        boost::unique_lock<boost::shared_mutex> lock(shard->cs);
+        shard->nGeneration++;
+
         if (!pubCoins.second.empty()) {
-            CoinGroupInfo& coinGroup = coinGroups[pubCoins.first];
+            CoinGroupInfo& coinGroup = shard->coinGroups[pubCoins.first.second];
 
             if (coinGroup.firstBlock == NULL)
                 coinGroup.firstBlock = index;
             coinGroup.lastBlock = index;
             coinGroup.nCoins += pubCoins.second.size();
+
+            AddBlockCoins(*shard, index, pubCoins.first.second, pubCoins.second);
         }
 
-        latestCoinIds[pubCoins.first.first] = pubCoins.first.second;
+        shard->latestCoinId = pubCoins.first.second;
         for(const sigma::PublicCoin &coin: pubCoins.second) {
             CMintedCoinInfo coinInfo;
             coinInfo.denomination = pubCoins.first.first;
             coinInfo.id = pubCoins.first.second;
             coinInfo.nHeight = index->nHeight;
-            mintedPubCoins.insert(pair<sigma::PublicCoin, CMintedCoinInfo>(coin, coinInfo));
+            AddMintedCoin(*shard, coin, coinInfo);
         }
     }
 
-    for(const Scalar &serial: index->spentSerialsV2) {
-        usedCoinSerials.insert(serial);
+    for(const Scalar &serial: blockData.spentSerialsV2) {
+        AddUsedSerial(serial);
     }
 }
 
 void CSigmaState::RemoveBlock(CBlockIndex *index) {
-    // roll back accumulator updates
+    std::shared_ptr<const CPrivacyBlockData> blockData = pprivacyindex->ReadBlock(index);
+
+    // roll back accumulator updates and mints
     for(
         const PAIRTYPE(PAIRTYPE(sigma::CoinDenomination, int),vector<sigma::PublicCoin>) &coin:
-        index->mintedPubCoinsV2)
+        blockData->mintedPubCoinsV2)
     {
-        CoinGroupInfo   &coinGroup = coinGroups[coin.first];
+        CDenominationShard *shard = GetShard(coin.first.first);
+        assert(shard);
+
+        boost::unique_lock<boost::shared_mutex> lock(shard->cs);
+        shard->nGeneration++;
+
+        CoinGroupInfo   &coinGroup = shard->coinGroups[coin.first.second];
         int  nMintsToForget = coin.second.size();
 
+        auto groupCoins = shard->coinGroupCoins.find(coin.first.second);
+        if (groupCoins != shard->coinGroupCoins.end() && !groupCoins->second.blocks.empty()
+                && groupCoins->second.blocks.back().first == index) {
+            CoinGroupCoins &blockCoins = groupCoins->second;
+            blockCoins.blocks.pop_back();
+            blockCoins.setSizes.erase(index->GetBlockHash());
+            if (blockCoins.blocks.empty())
+                shard->coinGroupCoins.erase(groupCoins);
+            else
+                GetMutableCoins(blockCoins).resize(blockCoins.blocks.back().second);
+        }
+
         assert(coinGroup.nCoins >= nMintsToForget);
 
         if ((coinGroup.nCoins -= nMintsToForget) == 0) {
             // all the coins of this group have been erased, remove the group altogether
-            coinGroups.erase(coin.first);
+            shard->coinGroups.erase(coin.first.second);
             // decrease pubcoin id for this denomination
-            latestCoinIds[coin.first.first]--;
+            shard->latestCoinId--;
         }
         else {
-            // roll back lastBlock to previous position
-            do {
-                assert(coinGroup.lastBlock != coinGroup.firstBlock);
-                coinGroup.lastBlock = coinGroup.lastBlock->pprev;
-            } while (coinGroup.lastBlock->mintedPubCoinsV2.count(coin.first) == 0);
+            // roll back lastBlock to the previous block minting coins of the group, which
+            // the coins of the group keep track of
+            groupCoins = shard->coinGroupCoins.find(coin.first.second);
+            assert(groupCoins != shard->coinGroupCoins.end() && !groupCoins->second.blocks.empty());
+            coinGroup.lastBlock = groupCoins->second.blocks.back().first;
+        }
+
+        int id = coin.first.second;
+        for(const sigma::PublicCoin &pubCoin: coin.second) {
+            auto coinIt = shard->mintedPubCoins.find(pubCoin);
+            assert(coinIt != shard->mintedPubCoins.end() && coinIt->second.id == id);
+            shard->mintedPubCoins.erase(coinIt);
         }
     }
 
-    // roll back mints
     for(const PAIRTYPE(PAIRTYPE(sigma::CoinDenomination, int),vector<sigma::PublicCoin>) &pubCoins:
-                  index->mintedPubCoinsV2) {
+                  blockData->mintedPubCoinsV2) {
         for(const sigma::PublicCoin &coin: pubCoins.second) {
-            auto coins = mintedPubCoins.equal_range(coin);
-            auto coinIt = find_if(
-                coins.first, coins.second,
-                [=](const decltype(mintedPubCoins)::value_type &v) {
-                    return v.second.denomination == pubCoins.first.first &&
-                        v.second.id == pubCoins.first.second;
-                });
-            assert(coinIt != coins.second);
-            mintedPubCoins.erase(coinIt);
-        }
-    }
-    index->mintedPubCoinsV2.clear();
+            auto hashIt = mintedPubCoinHashes.find(coin.getValueHash());
+            if (hashIt != mintedPubCoinHashes.end() && hashIt->second == coin)
+                mintedPubCoinHashes.erase(hashIt);
+        }
+    }
     // roll back spends
-    for(const Scalar &serial: index->spentSerialsV2) {
-        usedCoinSerials.erase(serial);
+    for(const Scalar &serial: blockData->spentSerialsV2) {
+        if (usedCoinSerials.erase(serial))
+            usedCoinSerialHashes.erase(GetSerialHash(serial));
     }
-    index->spentSerialsV2.clear();
 }
 
 bool CSigmaState::GetCoinGroupInfo(
         sigma::CoinDenomination denomination,
         int group_id,
         CoinGroupInfo& result) {
-    std::pair<sigma::CoinDenomination, int> key =
-        std::make_pair(denomination, group_id);
-    if (coinGroups.count(key) == 0)
+    const CDenominationShard *shard = GetShard(denomination);
+    if (!shard)
         return false;
 
-    result = coinGroups[key];
+    boost::shared_lock<boost::shared_mutex> lock(shard->cs);
+    auto coinGroup = shard->coinGroups.find(group_id);
+    if (coinGroup == shard->coinGroups.end())
+        return false;
+
+    result = coinGroup->second;
     return true;
 }
 
@@ -649,7 +954,12 @@ bool CSigmaState::IsUsedCoinSerial(const Scalar &coinSerial) {
 }
 
 bool CSigmaState::HasCoin(const sigma::PublicCoin& pubCoin) {
-    return mintedPubCoins.find(pubCoin) != mintedPubCoins.end();
+    const CDenominationShard *shard = GetShard(pubCoin.getDenomination());
+    if (!shard)
+        return false;
+
+    boost::shared_lock<boost::shared_mutex> lock(shard->cs);
+    return shard->mintedPubCoins.count(pubCoin) != 0;
 }
 
 int CSigmaState::GetCoinSetForSpend(
@@ -660,42 +970,104 @@ int CSigmaState::GetCoinSetForSpend(
         uint256& blockHash_out,
         std::vector<sigma::PublicCoin>& coins_out) {
 
-    pair<sigma::CoinDenomination, int> denomAndId = std::make_pair(denomination, coinGroupID);
+    CAnonymitySet anonymitySet;
+    int numberOfCoins = GetCoinSetForSpend(chain, maxHeight, denomination, coinGroupID, blockHash_out, anonymitySet);
+
+    coins_out.reserve(coins_out.size() + numberOfCoins);
+    for (std::size_t i = anonymitySet.setSize; i > 0; --i)
+        coins_out.emplace_back((*anonymitySet.coins)[i - 1], denomination);
+    return numberOfCoins;
+}
 
-    if (coinGroups.count(denomAndId) == 0)
+int CSigmaState::GetCoinSetForSpend(
+        CChain * /*chain*/,
+        int maxHeight,
+        sigma::CoinDenomination denomination,
+        int coinGroupID,
+        uint256& blockHash_out,
+        CAnonymitySet& set_out) {
+
+    const CDenominationShard *shard = GetShard(denomination);
+    if (!shard)
         return 0;
 
-    CoinGroupInfo coinGroup = coinGroups[denomAndId];
-
-    int numberOfCoins = 0;
-    for (CBlockIndex *block = coinGroup.lastBlock;
-            ;
-            block = block->pprev) {
-        if (block->mintedPubCoinsV2[denomAndId].size() > 0) {
-            if (block->nHeight <= maxHeight) {
-                if (numberOfCoins == 0) {
-                    // latest block satisfying given conditions
-                    // remember block hash
-                    blockHash_out = block->GetBlockHash();
-                }
-                numberOfCoins += block->mintedPubCoinsV2[denomAndId].size();
-                coins_out.insert(coins_out.end(),
-                        block->mintedPubCoinsV2[denomAndId].begin(),
-                        block->mintedPubCoinsV2[denomAndId].end());
-            }
-        }
-        if (block == coinGroup.firstBlock) {
-            break ;
-        }
+    boost::shared_lock<boost::shared_mutex> lock(shard->cs);
+    auto groupCoins = shard->coinGroupCoins.find(coinGroupID);
+    if (groupCoins == shard->coinGroupCoins.end())
+        return 0;
+
+    // latest block satisfying given conditions
+    const std::vector<std::pair<CBlockIndex *, std::size_t>> &blocks = groupCoins->second.blocks;
+    auto block = std::upper_bound(blocks.begin(), blocks.end(), maxHeight,
+            [](int height, const std::pair<CBlockIndex *, std::size_t> &b) {
+                return height < b.first->nHeight;
+            });
+    if (block == blocks.begin())
+        return 0;
+    --block;
+
+    blockHash_out = block->first->GetBlockHash();
+    set_out.coins = groupCoins->second.coins;
+    set_out.setSize = block->second;
+    set_out.blockHash = blockHash_out;
+    return block->second;
+}
+
+bool CSigmaState::GetAnonymitySet(
+        sigma::CoinDenomination denomination,
+        int coinGroupID,
+        const uint256& accumulatorBlockHash,
+        CAnonymitySet& set_out) {
+
+    const CDenominationShard *shard = GetShard(denomination);
+    if (!shard)
+        return false;
+
+    boost::shared_lock<boost::shared_mutex> lock(shard->cs);
+    auto groupCoins = shard->coinGroupCoins.find(coinGroupID);
+    auto coinGroup = shard->coinGroups.find(coinGroupID);
+    if (groupCoins == shard->coinGroupCoins.end() || coinGroup == shard->coinGroups.end())
+        return false;
+
+    const CoinGroupCoins &group = groupCoins->second;
+    set_out.coins = group.coins;
+
+    auto setSize = group.setSizes.find(accumulatorBlockHash);
+    if (setSize != group.setSizes.end()) {
+        set_out.setSize = setSize->second;
+        set_out.blockHash = accumulatorBlockHash;
+        return true;
     }
-    return numberOfCoins;
+
+    // Not a block with coins of the group: find the block with hash of accumulatorBlockHash or
+    // fall back to the coinGroup.firstBlock if not found, then take the coins up to that block
+    CBlockIndex *index = coinGroup->second.lastBlock;
+    while (index != coinGroup->second.firstBlock && index->GetBlockHash() != accumulatorBlockHash)
+        index = index->pprev;
+
+    auto block = std::upper_bound(group.blocks.begin(), group.blocks.end(), index->nHeight,
+            [](int height, const std::pair<CBlockIndex *, std::size_t> &b) {
+                return height < b.first->nHeight;
+            });
+    if (block == group.blocks.begin())
+        return false;
+    --block;
+
+    set_out.setSize = block->second;
+    set_out.blockHash = block->first->GetBlockHash();
+    return true;
 }
 
 std::pair<int, int> CSigmaState::GetMintedCoinHeightAndId(
         const sigma::PublicCoin& pubCoin) {
-    auto coinIt = mintedPubCoins.find(pubCoin);
+    const CDenominationShard *shard = GetShard(pubCoin.getDenomination());
+    if (!shard)
+        return std::make_pair(-1, -1);
 
-    if (coinIt != mintedPubCoins.end()) {
+    boost::shared_lock<boost::shared_mutex> lock(shard->cs);
+    auto coinIt = shard->mintedPubCoins.find(pubCoin);
+
+    if (coinIt != shard->mintedPubCoins.end()) {
         return std::make_pair(coinIt->second.nHeight, coinIt->second.id);
     }
     return std::make_pair(-1, -1);
@@ -760,106 +1132,322 @@ bool CSigmaState::CanAddMintToMempool(const sigma::PublicCoin &coinMint) {
 
 
 void CSigmaState::Reset() {
-    coinGroups.clear();
+    for (CDenominationShard &shard : shards) {
+        boost::unique_lock<boost::shared_mutex> lock(shard.cs);
+        shard.nGeneration++;
+        shard.coinGroups.clear();
+        shard.coinGroupCoins.clear();
+        shard.mintedPubCoins.clear();
+        shard.latestCoinId = 0;
+    }
     usedCoinSerials.clear();
-    latestCoinIds.clear();
-    mintedPubCoins.clear();
+    usedCoinSerialHashes.clear();
+    mintedPubCoinHashes.clear();
     mempoolCoinSerials.clear();
 }
 
+void CSigmaState::WriteSnapshot(CDataStream &s) const {
+    // Writers hold cs_main too, so the shards can't change between the sections below.
+    // The groups are written keyed by <denomination,id> as before the state was sharded.
+    uint64_t nGroups = 0;
+    for (const CDenominationShard &shard : shards) {
+        boost::shared_lock<boost::shared_mutex> lock(shard.cs);
+        nGroups += shard.coinGroups.size();
+    }
+    s << nGroups;
+    for (std::size_t i = 0; i < shards.size(); i++) {
+        boost::shared_lock<boost::shared_mutex> lock(shards[i].cs);
+        for (const auto &coinGroup: shards[i].coinGroups) {
+            s << std::make_pair((sigma::CoinDenomination)i, coinGroup.first);
+            s << GetSnapshotBlockHash(coinGroup.second.firstBlock) << GetSnapshotBlockHash(coinGroup.second.lastBlock);
+            s << coinGroup.second.nCoins;
+        }
+    }
+
+    // the minted coins and the anonymity set sizes are rebuilt from the coins of the groups
+    nGroups = 0;
+    for (const CDenominationShard &shard : shards) {
+        boost::shared_lock<boost::shared_mutex> lock(shard.cs);
+        nGroups += shard.coinGroupCoins.size();
+    }
+    s << nGroups;
+    for (std::size_t i = 0; i < shards.size(); i++) {
+        boost::shared_lock<boost::shared_mutex> lock(shards[i].cs);
+        for (const auto &groupCoins: shards[i].coinGroupCoins) {
+            s << std::make_pair((sigma::CoinDenomination)i, groupCoins.first) << *groupCoins.second.coins;
+            s << (uint64_t)groupCoins.second.blocks.size();
+            for (const auto &block: groupCoins.second.blocks)
+                s << block.first->GetBlockHash() << (uint64_t)block.second;
+        }
+    }
+
+    std::vector<pair<sigma::CoinDenomination, int>> latestCoinIds;
+    for (std::size_t i = 0; i < shards.size(); i++) {
+        int latestCoinId = GetLatestCoinID((sigma::CoinDenomination)i);
+        if (latestCoinId != 0)
+            latestCoinIds.push_back(std::make_pair((sigma::CoinDenomination)i, latestCoinId));
+    }
+    s << (uint64_t)latestCoinIds.size();
+    for (const auto &latestCoinId: latestCoinIds)
+        s << latestCoinId;
+
+    s << usedCoinSerials;
+
+    // outpoints known for the minted coins
+    std::vector<std::pair<sigma::PublicCoin, COutPoint>> outpoints;
+    for (const CDenominationShard &shard : shards) {
+        boost::shared_lock<boost::shared_mutex> lock(shard.cs);
+        for (const auto &mintedCoin: shard.mintedPubCoins) {
+            if (!mintedCoin.second.outpoint.IsNull())
+                outpoints.push_back(std::make_pair(mintedCoin.first, mintedCoin.second.outpoint));
+        }
+    }
+    s << (uint64_t)outpoints.size();
+    for (const auto &outpoint: outpoints)
+        s << outpoint.first << outpoint.second;
+}
+
+bool CSigmaState::ReadSnapshot(CDataStream &s) {
+    Reset();
+
+    uint64_t nGroups;
+    s >> nGroups;
+    while (nGroups--) {
+        pair<sigma::CoinDenomination, int> denominationAndId;
+        uint256 firstBlockHash, lastBlockHash;
+        CoinGroupInfo coinGroup;
+        s >> denominationAndId >> firstBlockHash >> lastBlockHash >> coinGroup.nCoins;
+        CDenominationShard *shard = GetShard(denominationAndId.first);
+        if (!shard || !LookupSnapshotBlock(firstBlockHash, coinGroup.firstBlock) || !LookupSnapshotBlock(lastBlockHash, coinGroup.lastBlock)) {
+            Reset();
+            return false;
+        }
+        boost::unique_lock<boost::shared_mutex> lock(shard->cs);
+        shard->coinGroups[denominationAndId.second] = coinGroup;
+    }
+
+    s >> nGroups;
+    while (nGroups--) {
+        pair<sigma::CoinDenomination, int> denominationAndId;
+        CoinGroupCoins groupCoins;
+        groupCoins.coins = std::make_shared<std::vector<GroupElement>>();
+        s >> denominationAndId >> *groupCoins.coins;
+        CDenominationShard *shard = GetShard(denominationAndId.first);
+        if (!shard) {
+            Reset();
+            return false;
+        }
+        boost::unique_lock<boost::shared_mutex> lock(shard->cs);
+
+        uint64_t nBlocks;
+        s >> nBlocks;
+        std::size_t begin = 0;
+        while (nBlocks--) {
+            uint256 blockHash;
+            uint64_t setSize;
+            CBlockIndex *index;
+            s >> blockHash >> setSize;
+            if (!LookupSnapshotBlock(blockHash, index) || index == NULL || setSize < begin || setSize > groupCoins.coins->size()) {
+                lock.unlock();
+                Reset();
+                return false;
+            }
+            groupCoins.blocks.emplace_back(index, setSize);
+            groupCoins.setSizes[blockHash] = setSize;
+
+            CMintedCoinInfo coinInfo;
+            coinInfo.denomination = denominationAndId.first;
+            coinInfo.id = denominationAndId.second;
+            coinInfo.nHeight = index->nHeight;
+            for (std::size_t i = begin; i < setSize; i++)
+                AddMintedCoin(*shard, sigma::PublicCoin((*groupCoins.coins)[i], denominationAndId.first), coinInfo);
+            begin = setSize;
+        }
+        shard->coinGroupCoins[denominationAndId.second] = std::move(groupCoins);
+    }
+
+    uint64_t nDenominations;
+    s >> nDenominations;
+    while (nDenominations--) {
+        pair<sigma::CoinDenomination, int> latestCoinId;
+        s >> latestCoinId;
+        CDenominationShard *shard = GetShard(latestCoinId.first);
+        if (!shard) {
+            Reset();
+            return false;
+        }
+        boost::unique_lock<boost::shared_mutex> lock(shard->cs);
+        shard->latestCoinId = latestCoinId.second;
+    }
+
+    s >> usedCoinSerials;
+    for (const Scalar &serial : usedCoinSerials)
+        usedCoinSerialHashes.insert(std::make_pair(GetSerialHash(serial), serial));
+
+    uint64_t nOutPoints;
+    s >> nOutPoints;
+    while (nOutPoints--) {
+        sigma::PublicCoin pubCoin;
+        COutPoint outpoint;
+        s >> pubCoin >> outpoint;
+        SetMintedCoinOutPoint(pubCoin, outpoint);
+    }
+
+    return true;
+}
+
 CSigmaState* CSigmaState::GetSigmaState() {
     return &sigmaState;
 }
 
 int CSigmaState::GetLatestCoinID(sigma::CoinDenomination denomination) const {
-    auto iter = latestCoinIds.find(denomination);
-    if (iter == latestCoinIds.end()) {
-        // Do not throw here, if there was no sigma mint, that's fine.
+    const CDenominationShard *shard = GetShard(denomination);
+    if (!shard)
         return 0;
-    }
-    return iter->second;
+
+    // Do not throw here, if there was no sigma mint, that's fine.
+    boost::shared_lock<boost::shared_mutex> lock(shard->cs);
+    return shard->latestCoinId;
 }
 
-bool CSigmaState::HasCoinHash(GroupElement &pubCoinValue, const uint256 &pubCoinValueHash) {
-    for ( auto it = mintedPubCoins.begin(); it != mintedPubCoins.end(); ++it ){
-        sigma::PublicCoin pubCoin = (*it).first;
-        if(GetPubCoinValueHash(pubCoin.getValue())==pubCoinValueHash){
-            pubCoinValue = pubCoin.getValue();
-            return true;
+size_t CSigmaState::DynamicMemoryUsage() const {
+    AssertLockHeld(cs_main);
+    size_t nUsage = 0;
+    for (const CDenominationShard &shard : shards) {
+        boost::shared_lock<boost::shared_mutex> lock(shard.cs);
+        nUsage += memusage::DynamicUsage(shard.coinGroups) + memusage::DynamicUsage(shard.mintedPubCoins);
+        nUsage += memusage::DynamicUsage(shard.coinGroupCoins);
+        for (const auto &group : shard.coinGroupCoins) {
+            // older copies of the coins still referred to by anonymity sets in use are not counted
+            if (group.second.coins)
+                nUsage += memusage::DynamicUsage(group.second.coins) + memusage::DynamicUsage(*group.second.coins);
+            nUsage += memusage::DynamicUsage(group.second.blocks) + memusage::DynamicUsage(group.second.setSizes);
         }
     }
-    return false;
+    nUsage += memusage::DynamicUsage(mintedPubCoinHashes);
+    nUsage += memusage::DynamicUsage(usedCoinSerials) + memusage::DynamicUsage(usedCoinSerialHashes);
+    nUsage += memusage::DynamicUsage(mempoolCoinSerials) + memusage::DynamicUsage(mempoolCoinMints);
+    return nUsage;
+}
+
+uint64_t CSigmaState::GetGeneration(sigma::CoinDenomination denomination) const {
+    const CDenominationShard *shard = GetShard(denomination);
+    if (!shard)
+        return 0;
+
+    boost::shared_lock<boost::shared_mutex> lock(shard->cs);
+    return shard->nGeneration;
+}
+
+bool CSigmaState::HasCoinHash(GroupElement &pubCoinValue, const uint256 &pubCoinValueHash) {
+    auto it = mintedPubCoinHashes.find(pubCoinValueHash);
+    if (it == mintedPubCoinHashes.end())
+        return false;
+
+    pubCoinValue = it->second.getValue();
+    return true;
+}
+
+bool CSigmaState::GetMintedCoinByHash(const uint256 &pubCoinValueHash, sigma::PublicCoin &pubCoin, CMintedCoinInfo &coinInfo) {
+    auto it = mintedPubCoinHashes.find(pubCoinValueHash);
+    if (it == mintedPubCoinHashes.end())
+        return false;
+
+    const CDenominationShard *shard = GetShard(it->second.getDenomination());
+    if (!shard)
+        return false;
+
+    boost::shared_lock<boost::shared_mutex> lock(shard->cs);
+    auto coinIt = shard->mintedPubCoins.find(it->second);
+    if (coinIt == shard->mintedPubCoins.end())
+        return false;
+
+    pubCoin = coinIt->first;
+    coinInfo = coinIt->second;
+    return true;
+}
+
+void CSigmaState::SetMintedCoinOutPoint(const sigma::PublicCoin &pubCoin, const COutPoint &outpoint) {
+    CDenominationShard *shard = GetShard(pubCoin.getDenomination());
+    if (!shard)
+        return;
+
+    boost::unique_lock<boost::shared_mutex> lock(shard->cs);
+    auto coinIt = shard->mintedPubCoins.find(pubCoin);
+    if (coinIt != shard->mintedPubCoins.end())
+        coinIt->second.outpoint = outpoint;
+}
+
+void CSigmaState::AddMintedCoin(CDenominationShard &shard, const sigma::PublicCoin &pubCoin, const CMintedCoinInfo &coinInfo) {
+    shard.mintedPubCoins.insert(std::make_pair(pubCoin, coinInfo));
+    mintedPubCoinHashes.insert(std::make_pair(pubCoin.getValueHash(), pubCoin));
 }
 
 bool CSigmaState::IsUsedCoinSerialHash(Scalar &coinSerial, const uint256 &coinSerialHash) {
-    for ( auto it = usedCoinSerials.begin(); it != usedCoinSerials.end(); ++it ){
-        if(GetSerialHash(*it)==coinSerialHash){
-            coinSerial = *it;
-            return true;
-        }
-    }
-    return false;
+    auto it = usedCoinSerialHashes.find(coinSerialHash);
+    if (it == usedCoinSerialHashes.end())
+        return false;
+    coinSerial = it->second;
+    return true;
 }
 
 
 bool SigmaGetMintTxHash(uint256& txHash, GroupElement pubCoinValue) {
-    int mintHeight = 0;
-    int coinId = 0;
+    return SigmaGetMintTxHash(txHash, GetPubCoinValueHash(pubCoinValue));
+}
 
+bool SigmaGetMintTxHash(uint256& txHash, uint256 pubCoinValueHash) {
     CSigmaState *sigmaState = CSigmaState::GetSigmaState();
-    std::vector<sigma::CoinDenomination> denominations;
-    sigma::GetAllDenoms(denominations);
-    for(sigma::CoinDenomination denomination: denominations){
-        sigma::PublicCoin pubCoin(pubCoinValue, denomination);
-        auto mintedCoinHeightAndId = sigmaState->GetMintedCoinHeightAndId(pubCoin);
-        mintHeight = mintedCoinHeightAndId.first;
-        coinId = mintedCoinHeightAndId.second;
-        if(mintHeight!=-1 && coinId!=-1)
-            break;
-    }
-
-    if(mintHeight==-1 && coinId==-1)
+    sigma::PublicCoin pubCoin;
+    CSigmaState::CMintedCoinInfo coinInfo;
+    if (!sigmaState->GetMintedCoinByHash(pubCoinValueHash, pubCoin, coinInfo))
         return false;
 
-    // get block containing mint
-    CBlockIndex *mintBlock;
+    if (!coinInfo.outpoint.IsNull()) {
+        txHash = coinInfo.outpoint.hash;
+        return true;
+    }
 
-    {
-        LOCK(cs_main);
-        mintBlock = chainActive[mintHeight];
+    // The state was rebuilt from the privacy index, which keeps the outpoints of mints connected
+    // since it indexes them. Find older ones in the block containing the mint and remember all of them
+    COutPoint outpoint;
+    if (pprivacyindex->ReadMintOutPoint(pubCoinValueHash, outpoint)) {
+        sigmaState->SetMintedCoinOutPoint(pubCoin, outpoint);
+        txHash = outpoint.hash;
+        return true;
     }
 
+    CBlockIndex *mintBlock = (*GetChainSnapshot())[coinInfo.nHeight];
     CBlock block;
-    if(!ReadBlockFromDisk(block, mintBlock, Params().GetConsensus()))
+    if (mintBlock == NULL || !ReadBlockFromDisk(block, mintBlock, Params().GetConsensus())) {
         LogPrintf("can't read block from disk.\n");
+        return false;
+    }
 
+    bool fFound = false;
     secp_primitives::GroupElement txPubCoinValue;
-    // cycle transaction hashes, looking for this pubcoin.
-    for(CTransactionRef tx: block.vtx){
-        if(tx->IsSigmaMint()){
-            for (const CTxOut &txout: tx->vout) {
-                if (txout.scriptPubKey.IsSigmaMint()){
-
-                    vector<unsigned char> coin_serialised(txout.scriptPubKey.begin() + 1,
-                                                          txout.scriptPubKey.end());
-                    txPubCoinValue.deserialize(&coin_serialised[0]);
-                    if(pubCoinValue==txPubCoinValue){
-                        txHash = tx->GetHash();
-                        return true;
-                    }
-                }
+    std::vector<std::pair<uint256, COutPoint>> vMintOutPoints;
+    for (const CTransactionRef &tx: block.vtx) {
+        if (!tx->IsSigmaMint())
+            continue;
+        for (uint32_t nOut = 0; nOut < tx->vout.size(); nOut++) {
+            const CTxOut &txout = tx->vout[nOut];
+            sigma::CoinDenomination denomination;
+            if (!txout.scriptPubKey.IsSigmaMint() || !sigma::IntegerToDenomination(txout.nValue, denomination))
+                continue;
+
+            vector<unsigned char> coin_serialised(txout.scriptPubKey.begin() + 1,
+                                                  txout.scriptPubKey.end());
+            txPubCoinValue.deserialize(&coin_serialised[0]);
+            sigmaState->SetMintedCoinOutPoint(sigma::PublicCoin(txPubCoinValue, denomination), COutPoint(tx->GetHash(), nOut));
+            vMintOutPoints.push_back(std::make_pair(GetPubCoinValueHash(txPubCoinValue), COutPoint(tx->GetHash(), nOut)));
+            if (txPubCoinValue == pubCoin.getValue() && denomination == pubCoin.getDenomination()) {
+                txHash = tx->GetHash();
+                fFound = true;
             }
         }
     }
+    pprivacyindex->WriteMintOutPoints(vMintOutPoints);
 
-    return false;
-}
-
-bool SigmaGetMintTxHash(uint256& txHash, uint256 pubCoinValueHash) {
-    GroupElement pubCoinValue;
-    if(!sigmaState.HasCoinHash(pubCoinValue, pubCoinValueHash)){
-        return false;
-    }
-
-    return SigmaGetMintTxHash(txHash, pubCoinValue);
+    return fFound;
 }
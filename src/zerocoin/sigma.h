@@ -16,9 +16,13 @@
 #include <sigma/coinspend.h>
 #include <unordered_set>
 #include <unordered_map>
+#include <array>
 #include <functional>
+#include <memory>
 #include <net.h>
 
+#include <boost/thread/shared_mutex.hpp>
+
 #define COINS_PER_ID 15000
 
 // sigma parameters
@@ -54,6 +58,14 @@ uint256 GetPubCoinValueHash(const GroupElement& bnValue);
 
 class CSigmaTxInfo {
 public: 
+    // Spends of one denomination and coin group whose sigma proofs are verified together.
+    // Anonymity sets are resolved from the sigma state when the block is connected.
+    struct CSpendBatch {
+        std::vector<std::unique_ptr<sigma::CoinSpend>> spends;
+        std::vector<bool> fPadding;
+        std::vector<uint256> metaDataHashes;
+    };
+
     // all the sigma transactions encountered so far
     std::set<uint256> sTransactions;
 
@@ -63,17 +75,70 @@ public:
     // serial for every spend (map from serial to denomination)
     std::unordered_map<Scalar, int, sigma::CScalarHash> spentSerials;
 
+    // outpoints of the mints, recorded in the sigma state when the block is connected.
+    // Also finds the mints of the block by value without going through all of them.
+    std::unordered_map<sigma::PublicCoin, COutPoint, sigma::CPublicCoinHash> mintOutPoints;
+
+    // sigma proofs of the block waiting for batch verification in ConnectBlockSigma
+    std::map<std::pair<sigma::CoinDenomination, int>, CSpendBatch> spendBatches;
+
     // information about transactions in the block is complete
     bool fInfoIsComplete;
 
-    CSigmaTxInfo(): fInfoIsComplete(false) {}
+    // all the sigma proofs in spendBatches have been verified
+    bool fSpendsVerified;
+
+    CSigmaTxInfo(): fInfoIsComplete(false), fSpendsVerified(false) {}
 
     // finalize everything
     void Complete();
 };
 
+//! Cost of verifying a sigma proof relative to a script check
+static const unsigned int SIGMA_PROOF_CHECK_WEIGHT = 100;
+
+/**
+ * Closure representing the verification of sigma proofs of several spends sharing a coin group.
+ * Spends are referenced, not copied: they must outlive the check.
+ */
+class CSigmaProofCheck
+{
+private:
+    std::shared_ptr<const std::vector<GroupElement>> coins;
+    std::vector<const sigma::CoinSpend *> spends;
+    std::vector<std::size_t> setSizes;
+    std::vector<bool> fPadding;
+    // sigma proof cache entries to add once the proofs are verified
+    std::vector<uint256> cacheEntries;
+
+public:
+    CSigmaProofCheck() {}
+    CSigmaProofCheck(std::shared_ptr<const std::vector<GroupElement>> coinsIn,
+                     std::vector<const sigma::CoinSpend *> spendsIn,
+                     std::vector<std::size_t> setSizesIn,
+                     std::vector<bool> fPaddingIn,
+                     std::vector<uint256> cacheEntriesIn) :
+        coins(std::move(coinsIn)), spends(std::move(spendsIn)), setSizes(std::move(setSizesIn)),
+        fPadding(std::move(fPaddingIn)), cacheEntries(std::move(cacheEntriesIn)) { }
+
+    bool operator()();
+
+    //! Cost relative to a script check, for the check queue
+    unsigned int GetWeight() const { return spends.size() * SIGMA_PROOF_CHECK_WEIGHT; }
+
+    void swap(CSigmaProofCheck &check) {
+        coins.swap(check.coins);
+        spends.swap(check.spends);
+        setSizes.swap(check.setSizes);
+        fPadding.swap(check.fPadding);
+        cacheEntries.swap(check.cacheEntries);
+    }
+};
+
 secp_primitives::GroupElement ParseSigmaMintScript(const CScript& script);
 std::pair<std::unique_ptr<sigma::CoinSpend>, uint32_t> ParseSigmaSpend(const CTxIn& in);
+// Same as above without deserializing the sigma proof, the view refers to the scriptSig of in
+std::pair<sigma::CoinSpendView, uint32_t> ParseSigmaSpendView(const CTxIn& in);
 
 bool CheckSigmaTransaction(
   const CTransaction &tx,
@@ -84,13 +149,30 @@ bool CheckSigmaTransaction(
   bool isCheckWallet,
   CSigmaTxInfo *sigmaTxInfo);
 
+// Verify the sigma proofs of a spend before it goes to the mempool. Must be called without cs_main,
+// which is only taken to look up the anonymity sets. Verified proofs are added to the proof cache,
+// so the check done by AcceptToMemoryPool under cs_main does not repeat them. Spends that can't be
+// checked yet (unknown group, malformed) are left for AcceptToMemoryPool to reject.
+// fProofsVerified: the proofs are known to be valid against the current anonymity sets (e.g. from
+// mempool.dat written at the same tip), only fill the cache.
+bool PreVerifySigmaSpend(const CTransaction &tx, CValidationState &state, bool fProofsVerified = false);
+
 void DisconnectTipSigma(CBlock &block, CBlockIndex *pindexDelete);
 
+// Verify the sigma proofs queued in sigmaTxInfo while checking the block. If pvChecks is not
+// nullptr, the proofs are split into checks for the caller to run on the check queue instead.
+bool CheckSigmaSpendProofs(
+  CValidationState& state,
+  CSigmaTxInfo *sigmaTxInfo,
+  int nHeight,
+  std::vector<CSigmaProofCheck> *pvChecks = nullptr);
+
 bool ConnectBlockSigma(
   CValidationState& state,
   const CChainParams& chainparams,
   CBlockIndex* pindexNew,
   const CBlock *pblock,
+  CPrivacyBlockData& privacyData,
   bool fJustCheck=false);
 
 bool SigmaBuildStateFromIndex(CChain *chain);
@@ -100,6 +182,10 @@ CAmount GetSpendTransactionInput(const CTransaction &tx);
 /*
  * State of minted/spent coins as extracted from the index
  */
+// The coin groups, coins and minted coin infos are sharded by denomination. Every shard has its
+// own reader/writer lock, so coin sets and groups can be read without cs_main while blocks are
+// connected. Used serials, coin hashes and mempool entries are still guarded by cs_main.
+// Lock order is cs_main before a shard, and no more than one shard is locked at a time.
 class CSigmaState {
 friend bool SigmaBuildStateFromIndex(CChain *, set<CBlockIndex *> &);
 public:
@@ -114,12 +200,26 @@ public:
         int nCoins;
     };
 
+    // Anonymity set of a spend: the first setSize coins of the group, taken in reverse order.
+    // The coins are shared with the state and are never modified once handed out, so the set
+    // stays valid after the lock of the denomination is released.
+    struct CAnonymitySet {
+        CAnonymitySet() : setSize(0) {}
+
+        std::shared_ptr<const std::vector<GroupElement>> coins;
+        std::size_t setSize;
+        // latest block contributing coins to the set
+        uint256 blockHash;
+    };
+
     struct CMintedCoinInfo {
         sigma::CoinDenomination denomination;
 
         // ID of coin group.
         int id;
         int nHeight;
+        // output of the mint transaction, null if not known yet
+        COutPoint outpoint;
     };
 
     struct pairhash {
@@ -136,13 +236,15 @@ public:
     // Add mint, automatically assigning id to it. Returns id and previous accumulator value (if any)
     int AddMint(
         CBlockIndex *index,
-        const sigma::PublicCoin& pubCoin);
+        const sigma::PublicCoin& pubCoin,
+        const COutPoint& outpoint = COutPoint());
 
     // Add serial to the list of used ones
     void AddSpend(const Scalar& serial);
 
     // Add everything from the block to the state
     void AddBlock(CBlockIndex *index);
+    void AddBlock(CBlockIndex *index, const CPrivacyBlockData &blockData);
 
     // Disconnect block from the chain rolling back mints and spends
     void RemoveBlock(CBlockIndex *index);
@@ -159,6 +261,11 @@ public:
     bool HasCoin(const sigma::PublicCoin& pubCoin);
     bool HasCoinHash(GroupElement &pubCoinValue, const uint256 &pubCoinValueHash);
 
+    // Query the minted coin with given pubCoin value hash
+    bool GetMintedCoinByHash(const uint256 &pubCoinValueHash, sigma::PublicCoin &pubCoin, CMintedCoinInfo &coinInfo);
+    // Record the output of the transaction minting the coin
+    void SetMintedCoinOutPoint(const sigma::PublicCoin &pubCoin, const COutPoint &outpoint);
+
     // Given denomination and id returns latest accumulator value and corresponding block hash
     // Do not take into account coins with height more than maxHeight
     // Returns number of coins satisfying conditions
@@ -170,12 +277,33 @@ public:
         uint256& blockHash_out,
         std::vector<sigma::PublicCoin>& coins_out);
 
+    // Same as above without copying the coins
+    int GetCoinSetForSpend(
+        CChain *chain,
+        int maxHeight,
+        sigma::CoinDenomination denomination,
+        int id,
+        uint256& blockHash_out,
+        CAnonymitySet& set_out);
+
+    // Anonymity set a spend with given accumulator block hash is verified against
+    bool GetAnonymitySet(
+        sigma::CoinDenomination denomination,
+        int id,
+        const uint256& accumulatorBlockHash,
+        CAnonymitySet& set_out);
+
     // Return height of mint transaction and id of minted coin
     std::pair<int, int> GetMintedCoinHeightAndId(const sigma::PublicCoin& pubCoin);
 
     // Reset to initial values
     void Reset();
 
+    // Save the coin groups, mints and spends to a snapshot of the state
+    void WriteSnapshot(CDataStream &s) const;
+    // Replace the state by a snapshot, returns false if it does not match the block index
+    bool ReadSnapshot(CDataStream &s);
+
     // Check if there is a conflicting tx in the blockchain or mempool
     bool CanAddSpendToMempool(const Scalar& coinSerial);
 
@@ -211,22 +339,70 @@ public:
 
     int GetLatestCoinID(sigma::CoinDenomination denomination) const;
 
+    // Heap memory held by the coin groups, minted coins and serials. Requires cs_main
+    size_t DynamicMemoryUsage() const;
+
+    // Counter bumped on every change to the coins of the denomination
+    uint64_t GetGeneration(sigma::CoinDenomination denomination) const;
 
 
 private:
-    // Collection of coin groups. Map from <denomination,id> to CoinGroupInfo structure
-    std::unordered_map<pair<sigma::CoinDenomination, int>, CoinGroupInfo, pairhash> coinGroups;
+    // Coins of a group kept in the order anonymity sets are built in
+    struct CoinGroupCoins {
+        // coins of every block in reverse order, oldest block first. Copied on write
+        // whenever an anonymity set still refers to it
+        std::shared_ptr<std::vector<GroupElement>> coins;
+        // blocks having coins of the group minted, oldest first, with the anonymity set size as of each
+        std::vector<std::pair<CBlockIndex *, std::size_t>> blocks;
+        std::unordered_map<uint256, std::size_t, BlockHasher> setSizes;
+    };
+
+    // Coin groups and coins of one denomination
+    struct CDenominationShard {
+        CDenominationShard() : latestCoinId(0), nGeneration(0) {}
+
+        mutable boost::shared_mutex cs;
 
-    // Set of all minted pubCoin values, keyed by the public coin.
-    // Used for checking if the given coin already exists.
-    unordered_map<sigma::PublicCoin, CMintedCoinInfo, sigma::CPublicCoinHash> mintedPubCoins;
+        // Collection of coin groups. Map from id to CoinGroupInfo structure
+        std::unordered_map<int, CoinGroupInfo> coinGroups;
 
-    // Latest IDs of coins by denomination
-    std::unordered_map<sigma::CoinDenomination, int> latestCoinIds;
+        // Coins of every group, maintained incrementally as blocks are connected and disconnected
+        std::unordered_map<int, CoinGroupCoins> coinGroupCoins;
+
+        // Set of all minted pubCoin values, keyed by the public coin.
+        // Used for checking if the given coin already exists.
+        unordered_map<sigma::PublicCoin, CMintedCoinInfo, sigma::CPublicCoinHash> mintedPubCoins;
+
+        // Latest ID of coins
+        int latestCoinId;
+
+        uint64_t nGeneration;
+    };
+
+    // NULL for an invalid denomination
+    CDenominationShard *GetShard(sigma::CoinDenomination denomination);
+    const CDenominationShard *GetShard(sigma::CoinDenomination denomination) const;
+
+    std::vector<GroupElement> &GetMutableCoins(CoinGroupCoins &groupCoins);
+    void AddMintedCoin(CDenominationShard &shard, const sigma::PublicCoin &pubCoin, const CMintedCoinInfo &coinInfo);
+    void AddUsedSerial(const Scalar &serial);
+    void AddBlockCoins(
+        CDenominationShard &shard,
+        CBlockIndex *index,
+        int id,
+        const vector<sigma::PublicCoin> &coins);
+
+    std::array<CDenominationShard, (std::size_t)sigma::CoinDenomination::SIGMA_ERROR> shards;
+
+    // Minted coins keyed by the hash of their value
+    std::unordered_map<uint256, sigma::PublicCoin, BlockHasher> mintedPubCoinHashes;
 
     // Set of all used coin serials.
     std::unordered_set<Scalar, sigma::CScalarHash> usedCoinSerials;
 
+    // Used coin serials keyed by their GetSerialHash
+    std::unordered_map<uint256, Scalar, BlockHasher> usedCoinSerialHashes;
+
     // serials of spends currently in the mempool mapped to tx hashes
     std::unordered_map<Scalar, uint256, sigma::CScalarHash> mempoolCoinSerials;
 
@@ -236,6 +412,9 @@ private:
 };
 
 bool IsSigmaAllowed();
+//! Whether sigma spends may use the compact encoding of SIGMA_VERSION_3, at the height or the chain tip
+bool IsSigmaV3Allowed(int height);
+bool IsSigmaV3Allowed();
 
 bool SigmaGetMintTxHash(uint256& txHash, uint256 pubCoinValueHash);
 bool SigmaGetMintTxHash(uint256& txHash, GroupElement pubCoinValue);
@@ -0,0 +1,89 @@
+// Copyright (c) 2019 The NIX Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <zerocoin/sigmacache.h>
+
+#include <hash.h>
+#include <random.h>
+#include <script/sigcache.h>
+#include <util.h>
+
+#include <cuckoocache.h>
+#include <boost/thread.hpp>
+
+namespace {
+/**
+ * Valid sigma proof cache, to avoid verifying sigma proofs twice for every spend
+ * (once when accepted into memory pool, and again when the block is connected)
+ */
+class CSigmaProofCache
+{
+private:
+    //! Entries are SHA256(nonce || spend || group id || set block hash || set size || metadata hash):
+    uint256 nonce;
+    CuckooCache::cache<uint256, SignatureCacheHasher> setValid;
+    boost::shared_mutex cs_sigmacache;
+
+public:
+    CSigmaProofCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    uint256 ComputeEntry(const sigma::CoinSpend& spend, int groupId, const uint256& setBlockHash,
+                         std::size_t setSize, const uint256& metaDataHash)
+    {
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << nonce << spend << groupId << setBlockHash << (uint64_t)setSize << metaDataHash;
+        return ss.GetHash();
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigmacache);
+        return setValid.contains(entry, false);
+    }
+
+    void Set(uint256 entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigmacache);
+        setValid.insert(entry);
+    }
+
+    uint32_t setup_bytes(size_t n)
+    {
+        return setValid.setup_bytes(n);
+    }
+};
+
+static CSigmaProofCache sigmaProofCache;
+} // namespace
+
+uint256 GetSigmaProofCacheEntry(
+        const sigma::CoinSpend& spend,
+        int groupId,
+        const uint256& setBlockHash,
+        std::size_t setSize,
+        const uint256& metaDataHash) {
+    return sigmaProofCache.ComputeEntry(spend, groupId, setBlockHash, setSize, metaDataHash);
+}
+
+bool IsSigmaProofCached(const uint256& entry) {
+    return sigmaProofCache.Get(entry);
+}
+
+void AddSigmaProofToCache(const uint256& entry) {
+    sigmaProofCache.Set(entry);
+}
+
+// To be called once in AppInitMain/BasicTestingSetup to initialize the sigmaProofCache.
+void InitSigmaProofCache()
+{
+    // nMaxCacheSize is unsigned. If -maxsigmacachesize is set to zero,
+    // setup_bytes creates the minimum possible cache (2 elements).
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigmacachesize", DEFAULT_MAX_SIGMA_CACHE_SIZE)), MAX_MAX_SIGMA_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = sigmaProofCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for sigma proof cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
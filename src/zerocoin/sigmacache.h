@@ -0,0 +1,36 @@
+// Copyright (c) 2019 The NIX Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NIX_ZEROCOIN_SIGMACACHE_H
+#define NIX_ZEROCOIN_SIGMACACHE_H
+
+#include <sigma/coinspend.h>
+#include <uint256.h>
+
+#include <cstddef>
+
+// Every entry is 32 bytes, 8MB hold more than 250000 verified proofs
+static const unsigned int DEFAULT_MAX_SIGMA_CACHE_SIZE = 8;
+// Maximum sigma proof cache size allowed
+static const int64_t MAX_MAX_SIGMA_CACHE_SIZE = 1024;
+
+// Entry of the cache for the sigma proof of spend verified against the anonymity set formed by
+// the first setSize coins of the group up to block setBlockHash, with given metadata hash
+uint256 GetSigmaProofCacheEntry(
+    const sigma::CoinSpend& spend,
+    int groupId,
+    const uint256& setBlockHash,
+    std::size_t setSize,
+    const uint256& metaDataHash);
+
+// Query if the sigma proof has been verified already. Entries are kept once the spend is in a
+// block, so that reconnecting the block after a reorg is cheap as well
+bool IsSigmaProofCached(const uint256& entry);
+
+// Remember the proof as verified
+void AddSigmaProofToCache(const uint256& entry);
+
+void InitSigmaProofCache();
+
+#endif // NIX_ZEROCOIN_SIGMACACHE_H
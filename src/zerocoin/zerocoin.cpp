@@ -1,5 +1,6 @@
 #include "zerocoin.h"
 #include "timedata.h"
+#include "txdb.h"
 #include "util.h"
 #include "base58.h"
 #include "wallet/wallet.h"
@@ -41,6 +42,25 @@ static bool CheckZerocoinSpendSerial(CValidationState &state, CZerocoinTxInfo *z
     return true;
 }
 
+// Verify the proof of a spend against the accumulator values of its coin group, starting with the latest one
+static bool VerifyZerocoinSpendProof(const libzerocoin::CoinSpend &spend, const libzerocoin::SpendMetaData &metaData,
+                                     libzerocoin::CoinDenomination denomination, int pubcoinId) {
+    // Zerocoin  transaction can cointain block hash of the last mint tx seen at the moment of spend. It speeds
+    // up verification
+    uint256 accumulatorBlockHash;
+    if (spend.getVersion() >= ZEROCOIN_VERSION_1)
+        accumulatorBlockHash = spend.getAccumulatorBlockHash();
+
+    // In most cases the latest accumulator value will be used for verification
+    for (const CBigNum &accValue: zerocoinState.GetAccumulatorValuesForVerify(denomination, pubcoinId, accumulatorBlockHash)) {
+        libzerocoin::Accumulator accumulator(ZCParams, accValue, denomination);
+        if (spend.Verify(accumulator, metaData))
+            return true;
+    }
+
+    return false;
+}
+
 bool CheckSpendZerocoinTransaction(const CTransaction &tx,
                                 libzerocoin::CoinDenomination targetDenomination,
                                 CValidationState &state,
@@ -141,41 +161,10 @@ bool CheckSpendZerocoinTransaction(const CTransaction &tx,
     if (!zerocoinState.GetCoinGroupInfo(targetDenomination, pubcoinId, coinGroup))
         return state.DoS(100, false, NO_MINT_ZEROCOIN, "CheckSpendZerocoinTransaction: Error: no coins were minted with such parameters at height %d", nHeight);
 
-    bool passVerify = false;
-    CBlockIndex *index = coinGroup.lastBlock;
-    pair<int,int> denominationAndId = make_pair(targetDenomination, pubcoinId);
-
-
-    bool spendHasBlockHash;
-
-    // Zerocoin  transaction can cointain block hash of the last mint tx seen at the moment of spend. It speeds
-    // up verification
-    if (spendVersion >= ZEROCOIN_VERSION_1 && !newSpend.getAccumulatorBlockHash().IsNull()) {
-        spendHasBlockHash = true;
-        uint256 accumulatorBlockHash = newSpend.getAccumulatorBlockHash();
-
-        // find index for block with hash of accumulatorBlockHash or set index to the coinGroup.firstBlock if not found
-        while (index != coinGroup.firstBlock && index->GetBlockHash() != accumulatorBlockHash)
-            index = index->pprev;
-    }
-
-    // Enumerate all the accumulator changes seen in the blockchain starting with the latest block
-    // In most cases the latest accumulator value will be used for verification
-    do {
-        if (index->accumulatorChanges.count(denominationAndId) > 0) {
-            libzerocoin::Accumulator accumulator(ZCParams,
-                                                 index->accumulatorChanges[denominationAndId].first,
-                                                 targetDenomination);
-            //LogPrintf("CheckSpendZerocoinTransaction: accumulator=%s\n", accumulator.getValue().ToString().substr(0,15));
-            passVerify = newSpend.Verify(accumulator, newMetadata);
-
-        }
-
-        if (index == coinGroup.firstBlock || spendHasBlockHash)
-            break;
-        else
-            index = index->pprev;
-    } while (!passVerify);
+    // When checking a block the zerocoin proof is only queued here, it is verified in ConnectBlock
+    // unless the block is below the assumed valid one
+    bool fDeferProof = zerocoinTxInfo && !zerocoinTxInfo->fInfoIsComplete && !isCheckWallet;
+    bool passVerify = fDeferProof || VerifyZerocoinSpendProof(newSpend, newMetadata, targetDenomination, pubcoinId);
 
     if (passVerify) {
 
@@ -199,6 +188,9 @@ bool CheckSpendZerocoinTransaction(const CTransaction &tx,
 
             }
         }
+
+        if (fDeferProof)
+            zerocoinTxInfo->pendingSpends.emplace_back(newSpend, newMetadata, targetDenomination, pubcoinId);
     }
     else {
         return false;
@@ -437,6 +429,22 @@ bool CheckZerocoinTransaction(const CTransaction &tx,
     return true;
 }
 
+bool CheckZerocoinSpendProofs(CValidationState &state, CZerocoinTxInfo *zerocoinTxInfo, int nHeight) {
+    if (zerocoinTxInfo->fSpendsVerified)
+        return true;
+
+    for (const CZerocoinTxInfo::CPendingSpend &pending: zerocoinTxInfo->pendingSpends) {
+        if (!VerifyZerocoinSpendProof(pending.spend, pending.metaData, pending.denomination, pending.pubcoinId)) {
+            LogPrintf("CheckZerocoinSpendProofs: verification failed at block=%d, denomination=%d, pubcoinID=%d\n",
+                      nHeight, pending.denomination, pending.pubcoinId);
+            return state.DoS(100, false, REJECT_INVALID, "bad-zerocoin-spend-proof");
+        }
+    }
+
+    zerocoinTxInfo->fSpendsVerified = true;
+    return true;
+}
+
 void DisconnectTipGhost(CBlock & /*block*/, CBlockIndex *pindexDelete) {
     zerocoinState.RemoveBlock(pindexDelete);
 }
@@ -446,15 +454,20 @@ void DisconnectTipGhost(CBlock & /*block*/, CBlockIndex *pindexDelete) {
  * Connect a new ZCblock to chainActive. pblock is either NULL or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
  */
-bool ConnectBlockGhost(CValidationState &state, const CChainParams &chainparams, CBlockIndex *pindexNew, const CBlock *pblock) {
+bool ConnectBlockGhost(CValidationState &state, const CChainParams &chainparams, CBlockIndex *pindexNew, const CBlock *pblock, CPrivacyBlockData &privacyData) {
 
-    // Add zerocoin transaction information to index
+    // Add zerocoin transaction information to the privacy data of the block
     if (pblock && pblock->zerocoinTxInfo) {
 
-        pindexNew->spentSerials.clear();
+        if (!CheckZerocoinSpendProofs(state, pblock->zerocoinTxInfo.get(), pindexNew->nHeight))
+            return false;
+        // proofs are not needed anymore
+        pblock->zerocoinTxInfo->pendingSpends.clear();
+
+        privacyData.spentSerials.clear();
 
         BOOST_FOREACH(const PAIRTYPE(CBigNum,int) &serial, pblock->zerocoinTxInfo->spentSerials) {
-            pindexNew->spentSerials.insert(serial.first);
+            privacyData.spentSerials.insert(serial.first);
             if (!CheckZerocoinSpendSerial(state, pblock->zerocoinTxInfo.get(), (libzerocoin::CoinDenomination)serial.second, serial.first, pindexNew->nHeight, true))
                 return false;
             zerocoinState.AddSpend(serial.first);
@@ -469,26 +482,31 @@ bool ConnectBlockGhost(CValidationState &state, const CChainParams &chainparams,
             //LogPrintf("ConnectTipZC: mint added denomination=%d, id=%d\n", denomination, mintId);
             pair<int,int> denomAndId = make_pair(denomination, mintId);
 
-            pindexNew->mintedPubCoins[denomAndId].push_back(mint.second);
+            privacyData.mintedPubCoins[denomAndId].push_back(mint.second);
 
             CZerocoinState::CoinGroupInfo coinGroupInfo;
             zerocoinState.GetCoinGroupInfo(denomination, mintId, coinGroupInfo);
 
+            // the accumulator may have been updated already by the previous mints of this block
+            auto accChange = privacyData.accumulatorChanges.find(denomAndId);
+            if (accChange != privacyData.accumulatorChanges.end())
+                oldAccValue = accChange->second.first;
+
             libzerocoin::PublicCoin pubCoin(ZCParams, mint.second, (libzerocoin::CoinDenomination)denomination);
             libzerocoin::Accumulator accumulator(ZCParams,
                                                  oldAccValue,
                                                  (libzerocoin::CoinDenomination)denomination);
             accumulator += pubCoin;
 
-            if (pindexNew->accumulatorChanges.count(denomAndId) > 0) {
-                pair<CBigNum,int> &accChange = pindexNew->accumulatorChanges[denomAndId];
-                accChange.first = accumulator.getValue();
-                accChange.second++;
+            if (accChange != privacyData.accumulatorChanges.end()) {
+                accChange->second.first = accumulator.getValue();
+                accChange->second.second++;
             }
             else {
-                pindexNew->accumulatorChanges[denomAndId] = make_pair(accumulator.getValue(), 1);
+                privacyData.accumulatorChanges[denomAndId] = make_pair(accumulator.getValue(), 1);
             }
         }
+        zerocoinState.AddAccumulatorCheckpoints(pindexNew, privacyData);
     }
     else {
         zerocoinState.AddBlock(pindexNew);
@@ -513,8 +531,9 @@ int ZerocoinGetNHeight(const CBlockHeader &block) {
 bool ZerocoinBuildStateFromIndex(CChain *chain, set<CBlockIndex *> &changes) {
 
     zerocoinState.Reset();
-    for (CBlockIndex *blockIndex = chain->Genesis(); blockIndex; blockIndex=chain->Next(blockIndex))
-        zerocoinState.AddBlock(blockIndex);
+    pprivacyindex->ForEachBlock(*chain, [](CBlockIndex *blockIndex, const CPrivacyBlockData &blockData) {
+        zerocoinState.AddBlock(blockIndex, blockData);
+    });
 
     changes = zerocoinState.RecalculateAccumulators(chain);
     // DEBUG
@@ -551,12 +570,24 @@ void CZerocoinTxInfo::Complete() {
 
 std::size_t CZerocoinState::CBigNumHash::operator ()(const CBigNum &bn) const noexcept {
     // we are operating on almost random big numbers and least significant bytes (save for few last bytes) give us a good hash
-    vector<unsigned char> bnData = bn.ToBytes();
-    if (bnData.size() < sizeof(size_t)*3)
+    int nSize = BN_num_bytes(&bn);
+    if (nSize < (int)sizeof(size_t)*3)
         // rare case, put ones like that into one hash bin
         return 0;
-    else
-        return ((size_t*)bnData.data())[1];
+
+    // every lookup of a serial or a mint hashes, keep the bytes of the usual sizes on the stack
+    unsigned char buffer[512];
+    std::vector<unsigned char> vLarge;
+    unsigned char *bnData = buffer;
+    if (nSize > (int)sizeof(buffer)) {
+        vLarge.resize(nSize);
+        bnData = vLarge.data();
+    }
+    BN_bn2bin(&bn, bnData);
+
+    std::size_t result;
+    memcpy(&result, bnData + sizeof(size_t), sizeof(result));
+    return result;
 }
 
 // CZerocoinState
@@ -581,7 +612,13 @@ int CZerocoinState::AddMint(CBlockIndex *index, int denomination, const CBigNum
             coinGroup.firstBlock = coinGroup.lastBlock = index;
         }
         else {
-            previousAccValue = coinGroup.lastBlock->accumulatorChanges[make_pair(denomination,mintId)].first;
+            // mints of index itself are not checkpointed yet, the caller accounts for them
+            if (coinGroup.lastBlock != index) {
+                auto groupCheckpoints = accumulatorCheckpoints.find(make_pair(denomination, mintId));
+                if (groupCheckpoints != accumulatorCheckpoints.end() && !groupCheckpoints->second.checkpoints.empty()
+                        && groupCheckpoints->second.checkpoints.back().block == coinGroup.lastBlock)
+                    previousAccValue = groupCheckpoints->second.checkpoints.back().value;
+            }
             coinGroup.lastBlock = index;
         }
     }
@@ -606,7 +643,11 @@ void CZerocoinState::AddSpend(const CBigNum &serial) {
 }
 
 void CZerocoinState::AddBlock(CBlockIndex *index) {
-    for(const pair<pair<int,int>, pair<CBigNum,int>> &accUpdate: index->accumulatorChanges)
+    AddBlock(index, *pprivacyindex->ReadBlock(index));
+}
+
+void CZerocoinState::AddBlock(CBlockIndex *index, const CPrivacyBlockData &blockData) {
+    for(const pair<pair<int,int>, pair<CBigNum,int>> &accUpdate: blockData.accumulatorChanges)
     {
         CoinGroupInfo   &coinGroup = coinGroups[accUpdate.first];
 
@@ -615,8 +656,9 @@ void CZerocoinState::AddBlock(CBlockIndex *index) {
         coinGroup.lastBlock = index;
         coinGroup.nCoins += accUpdate.second.second;
     }
+    AddAccumulatorCheckpoints(index, blockData);
 
-    for(const pair<pair<int,int>,vector<CBigNum>> &pubCoins: index->mintedPubCoins) {
+    for(const pair<pair<int,int>,vector<CBigNum>> &pubCoins: blockData.mintedPubCoins) {
         latestCoinIds[pubCoins.first.first] = pubCoins.first.second;
         BOOST_FOREACH(const CBigNum &coin, pubCoins.second) {
             CMintedCoinInfo coinInfo;
@@ -626,38 +668,69 @@ void CZerocoinState::AddBlock(CBlockIndex *index) {
             mintedPubCoins.insert(pair<CBigNum,CMintedCoinInfo>(coin, coinInfo));
         }
     }
-    BOOST_FOREACH(const CBigNum &serial, index->spentSerials) {
+    BOOST_FOREACH(const CBigNum &serial, blockData.spentSerials) {
         usedCoinSerials.insert(serial);
     }
 
 }
 
+void CZerocoinState::AddAccumulatorCheckpoints(CBlockIndex *index, const CPrivacyBlockData &blockData) {
+    for (const pair<pair<int,int>, pair<CBigNum,int>> &accUpdate: blockData.accumulatorChanges) {
+        AccumulatorCheckpoints &groupCheckpoints = accumulatorCheckpoints[accUpdate.first];
+        std::vector<AccumulatorCheckpoint> &checkpoints = groupCheckpoints.checkpoints;
+        if (checkpoints.empty() || checkpoints.back().block != index) {
+            groupCheckpoints.positions[index->GetBlockHash()] = checkpoints.size();
+            checkpoints.emplace_back();
+        }
+
+        AccumulatorCheckpoint &checkpoint = checkpoints.back();
+        checkpoint.block = index;
+        checkpoint.value = accUpdate.second.first;
+        checkpoint.nCoins = coinGroups[accUpdate.first].nCoins;
+    }
+}
+
+int CZerocoinState::FindAccumulatorCheckpoint(const AccumulatorCheckpoints &groupCheckpoints, int nHeight) {
+    const std::vector<AccumulatorCheckpoint> &checkpoints = groupCheckpoints.checkpoints;
+    auto checkpoint = std::upper_bound(checkpoints.begin(), checkpoints.end(), nHeight,
+            [](int height, const AccumulatorCheckpoint &c) {
+                return height < c.block->nHeight;
+            });
+    return (int)(checkpoint - checkpoints.begin()) - 1;
+}
+
 void CZerocoinState::RemoveBlock(CBlockIndex *index) {
+    std::shared_ptr<const CPrivacyBlockData> blockData = pprivacyindex->ReadBlock(index);
+
     // roll back accumulator updates
-    for(const pair<pair<int,int>, pair<CBigNum,int>> &accUpdate: index->accumulatorChanges)
+    for(const pair<pair<int,int>, pair<CBigNum,int>> &accUpdate: blockData->accumulatorChanges)
     {
         CoinGroupInfo   &coinGroup = coinGroups[accUpdate.first];
         int  nMintsToForget = accUpdate.second.second;
 
         assert(coinGroup.nCoins >= nMintsToForget);
 
+        AccumulatorCheckpoints &groupCheckpoints = accumulatorCheckpoints[accUpdate.first];
+        assert(!groupCheckpoints.checkpoints.empty() && groupCheckpoints.checkpoints.back().block == index);
+        groupCheckpoints.positions.erase(index->GetBlockHash());
+        groupCheckpoints.checkpoints.pop_back();
+
         if ((coinGroup.nCoins -= nMintsToForget) == 0) {
             // all the coins of this group have been erased, remove the group altogether
             coinGroups.erase(accUpdate.first);
+            accumulatorCheckpoints.erase(accUpdate.first);
             // decrease pubcoin id for this denomination
             latestCoinIds[accUpdate.first.first]--;
         }
         else {
-            // roll back lastBlock to previous position
-            do {
-                assert(coinGroup.lastBlock != coinGroup.firstBlock);
-                coinGroup.lastBlock = coinGroup.lastBlock->pprev;
-            } while (coinGroup.lastBlock->accumulatorChanges.count(accUpdate.first) == 0);
+            // roll back lastBlock to the previous block changing the accumulator
+            assert(!groupCheckpoints.checkpoints.empty());
+            coinGroup.lastBlock = groupCheckpoints.checkpoints.back().block;
         }
     }
 
     // roll back mints
-    for(const pair<pair<int,int>,vector<CBigNum>> &pubCoins: index->mintedPubCoins) {
+    for(const pair<pair<int,int>,vector<CBigNum>> &pubCoins: blockData->mintedPubCoins) {
         BOOST_FOREACH(const CBigNum &coin, pubCoins.second) {
             auto coins = mintedPubCoins.equal_range(coin);
             auto coinIt = find_if(coins.first, coins.second, [=](const decltype(mintedPubCoins)::value_type &v) {
@@ -670,7 +743,7 @@ void CZerocoinState::RemoveBlock(CBlockIndex *index) {
     }
 
     // roll back spends
-    BOOST_FOREACH(const CBigNum &serial, index->spentSerials) {
+    BOOST_FOREACH(const CBigNum &serial, blockData->spentSerials) {
         usedCoinSerials.erase(serial);
     }
 }
@@ -695,40 +768,52 @@ bool CZerocoinState::HasCoin(const CBigNum &pubCoin) {
 int CZerocoinState::GetAccumulatorValueForSpend(CChain *chain, int maxHeight, int denomination, int id, CBigNum &accumulator, uint256 &blockHash) {
     pair<int, int> denomAndId = pair<int, int>(denomination, id);
 
-    if (coinGroups.count(denomAndId) == 0)
+    auto groupCheckpoints = accumulatorCheckpoints.find(denomAndId);
+    if (groupCheckpoints == accumulatorCheckpoints.end())
         return 0;
 
-    CoinGroupInfo coinGroup = coinGroups[denomAndId];
-    CBlockIndex *lastBlock = coinGroup.lastBlock;
-
-    assert(lastBlock->accumulatorChanges.count(denomAndId) > 0);
-    assert(coinGroup.firstBlock->accumulatorChanges.count(denomAndId) > 0);
-
-    // field in the block index structure for accesing accumulator changes
-    decltype(&CBlockIndex::accumulatorChanges) accChangeField;
-    accChangeField = &CBlockIndex::accumulatorChanges;
-
-    int numberOfCoins = 0;
-    for (;;) {
-        map<pair<int,int>, pair<CBigNum,int>> &accumulatorChanges = lastBlock->*accChangeField;
-        if (accumulatorChanges.count(denomAndId) > 0) {
-            if (lastBlock->nHeight <= maxHeight) {
-                if (numberOfCoins == 0) {
-                    // latest block satisfying given conditions
-                    // remember accumulator value and block hash
-                    accumulator = accumulatorChanges[denomAndId].first;
-                    blockHash = lastBlock->GetBlockHash();
-                }
-                numberOfCoins += accumulatorChanges[denomAndId].second;
-            }
-        }
-        if (lastBlock == coinGroup.firstBlock)
-            break;
-        else
-            lastBlock = lastBlock->pprev;
+    // latest block satisfying given conditions
+    int checkpoint = FindAccumulatorCheckpoint(groupCheckpoints->second, maxHeight);
+    if (checkpoint < 0)
+        return 0;
+
+    const AccumulatorCheckpoint &latest = groupCheckpoints->second.checkpoints[checkpoint];
+    accumulator = latest.value;
+    blockHash = latest.block->GetBlockHash();
+    return latest.nCoins;
+}
+
+std::vector<CBigNum> CZerocoinState::GetAccumulatorValuesForVerify(int denomination, int id, const uint256 &accumulatorBlockHash) {
+    std::vector<CBigNum> values;
+
+    auto groupCheckpoints = accumulatorCheckpoints.find(make_pair(denomination, id));
+    if (groupCheckpoints == accumulatorCheckpoints.end() || groupCheckpoints->second.checkpoints.empty())
+        return values;
+    const std::vector<AccumulatorCheckpoint> &checkpoints = groupCheckpoints->second.checkpoints;
+
+    if (accumulatorBlockHash.IsNull()) {
+        values.reserve(checkpoints.size());
+        for (auto checkpoint = checkpoints.rbegin(); checkpoint != checkpoints.rend(); ++checkpoint)
+            values.push_back(checkpoint->value);
+        return values;
+    }
+
+    auto position = groupCheckpoints->second.positions.find(accumulatorBlockHash);
+    if (position != groupCheckpoints->second.positions.end()) {
+        values.push_back(checkpoints[position->second].value);
+        return values;
     }
 
-    return numberOfCoins;
+    // A block within the group not changing its accumulator has nothing to verify against,
+    // any block outside of the group falls back to the first block of the group
+    BlockMap::const_iterator mi = mapBlockIndex.find(accumulatorBlockHash);
+    if (mi != mapBlockIndex.end()) {
+        const CBlockIndex *index = mi->second;
+        if (index->nHeight > checkpoints.front().block->nHeight && checkpoints.back().block->GetAncestor(index->nHeight) == index)
+            return values;
+    }
+    values.push_back(checkpoints.front().value);
+    return values;
 }
 
 libzerocoin::AccumulatorWitness CZerocoinState::GetWitnessForSpend(CChain *chain, int maxHeight, int denomination, int id, const CBigNum &pubCoin) {
@@ -746,34 +831,55 @@ libzerocoin::AccumulatorWitness CZerocoinState::GetWitnessForSpend(CChain *chain
 
     // Find accumulator value preceding mint operation
     CBlockIndex *mintBlock = (*chain)[mintHeight];
-    CBlockIndex *block = mintBlock;
+    const AccumulatorCheckpoints &groupCheckpoints = accumulatorCheckpoints[denomAndId];
+    int checkpoint = FindAccumulatorCheckpoint(groupCheckpoints, mintHeight - 1);
     libzerocoin::Accumulator accumulator(ZCParams, d);
-    if (block != coinGroup.firstBlock) {
-        do {
-            block = block->pprev;
-        } while (block->accumulatorChanges.count(denomAndId) == 0);
-        accumulator = libzerocoin::Accumulator(ZCParams, block->accumulatorChanges[denomAndId].first, d);
+    if (mintBlock != coinGroup.firstBlock) {
+        assert(checkpoint >= 0);
+        accumulator = libzerocoin::Accumulator(ZCParams, groupCheckpoints.checkpoints[checkpoint].value, d);
     }
 
     // Now add to the accumulator every coin minted since that moment except pubCoin
-    block = coinGroup.lastBlock;
-    while(true) {
-        if (block->nHeight <= maxHeight && block->mintedPubCoins.count(denomAndId) > 0) {
-            vector<CBigNum> &pubCoins = block->mintedPubCoins[denomAndId];
-            for (const CBigNum &coin: pubCoins) {
-                if (block != mintBlock || coin != pubCoin)
-                    accumulator += libzerocoin::PublicCoin(ZCParams, coin, d);
-            }
-        }
-        if (block != mintBlock)
-            block = block->pprev;
-        else
+    for (std::size_t i = checkpoint + 1; i < groupCheckpoints.checkpoints.size(); i++) {
+        CBlockIndex *block = groupCheckpoints.checkpoints[i].block;
+        if (block->nHeight > maxHeight)
             break;
+        std::shared_ptr<const CPrivacyBlockData> blockData = pprivacyindex->ReadBlock(block);
+        auto pubCoins = blockData->mintedPubCoins.find(denomAndId);
+        if (pubCoins == blockData->mintedPubCoins.end())
+            continue;
+        for (const CBigNum &coin: pubCoins->second) {
+            if (block != mintBlock || coin != pubCoin)
+                accumulator += libzerocoin::PublicCoin(ZCParams, coin, d);
+        }
     }
 
     return libzerocoin::AccumulatorWitness(ZCParams, accumulator, libzerocoin::PublicCoin(ZCParams, pubCoin, d));
 }
 
+void CZerocoinState::AdvanceWitnessForSpend(CChain *chain, int maxHeight, int denomination, int id, const CBlockIndex *fromBlock, CBigNum &witnessValue) {
+    libzerocoin::CoinDenomination d = (libzerocoin::CoinDenomination)denomination;
+    pair<int, int> denomAndId = pair<int, int>(denomination, id);
+
+    auto coinGroup = coinGroups.find(denomAndId);
+    if (coinGroup == coinGroups.end())
+        return;
+
+    // no coins of the group past its last block
+    maxHeight = std::min(maxHeight, coinGroup->second.lastBlock->nHeight);
+
+    libzerocoin::Accumulator witness(ZCParams, witnessValue, d);
+    for (CBlockIndex *block = (*chain)[fromBlock->nHeight + 1]; block && block->nHeight <= maxHeight; block = chain->Next(block)) {
+        std::shared_ptr<const CPrivacyBlockData> blockData = pprivacyindex->ReadBlock(block);
+        auto pubCoins = blockData->mintedPubCoins.find(denomAndId);
+        if (pubCoins == blockData->mintedPubCoins.end())
+            continue;
+        for (const CBigNum &coin: pubCoins->second)
+            witness += libzerocoin::PublicCoin(ZCParams, coin, d);
+    }
+    witnessValue = witness.getValue();
+}
+
 int CZerocoinState::GetMintedCoinHeightAndId(const CBigNum &pubCoin, int denomination, int &id) {
     auto coins = mintedPubCoins.equal_range(pubCoin);
     auto coinIt = find_if(coins.first, coins.second,
@@ -810,12 +916,13 @@ bool CZerocoinState::GetWitnessForAllSpends(std::vector<CBigNum> &accValues, std
             int denomValue = denoms[i];
             libzerocoin::CoinDenomination d = (libzerocoin::CoinDenomination)denomValue;
             pair<int, int> denomAndId = pair<int, int>(denomValue, mintId);
-            assert(coinGroups.count(denomAndId) > 0);
+            auto groupCheckpoints = accumulatorCheckpoints.find(denomAndId);
+            if (groupCheckpoints == accumulatorCheckpoints.end() || groupCheckpoints->second.checkpoints.empty())
+                return false;
 
-            CoinGroupInfo coinGroup = coinGroups[denomAndId];
-            CBlockIndex *lastBlock = coinGroup.lastBlock;
-            accValues.push_back(lastBlock->accumulatorChanges[make_pair(denomValue,mintId)].first);
-            accBlockHashes.push_back(lastBlock->GetBlockHash());
+            const AccumulatorCheckpoint &latest = groupCheckpoints->second.checkpoints.back();
+            accValues.push_back(latest.value);
+            accBlockHashes.push_back(latest.block->GetBlockHash());
         }
     }
     catch(...){
@@ -844,29 +951,27 @@ CBigNum CZerocoinState::GetWitnessForHeight(int denomination, int mintHeight, in
 
     // Find accumulator value preceding mint operation
     CBlockIndex *mintBlock = chainActive[mintHeight];
-    CBlockIndex *block = mintBlock;
+    const AccumulatorCheckpoints &groupCheckpoints = accumulatorCheckpoints[denomAndId];
+    int checkpoint = FindAccumulatorCheckpoint(groupCheckpoints, mintHeight - 1);
     libzerocoin::Accumulator accumulator(ZCParams, d);
-    if (block != coinGroup.firstBlock) {
-        do {
-            block = block->pprev;
-        } while (block->accumulatorChanges.count(denomAndId) == 0);
-        accumulator = libzerocoin::Accumulator(ZCParams, block->accumulatorChanges[denomAndId].first, d);
+    if (mintBlock != coinGroup.firstBlock) {
+        assert(checkpoint >= 0);
+        accumulator = libzerocoin::Accumulator(ZCParams, groupCheckpoints.checkpoints[checkpoint].value, d);
     }
 
     // Now add to the accumulator every coin minted since that moment except pubCoin
-    block = coinGroup.lastBlock;
-    while(true) {
-        if (block->nHeight <= maxHeight && block->mintedPubCoins.count(denomAndId) > 0) {
-            vector<CBigNum> &pubCoins = block->mintedPubCoins[denomAndId];
-            for (const CBigNum &coin: pubCoins) {
-                if (block != mintBlock)
-                    accumulator += libzerocoin::PublicCoin(ZCParams, coin, d);
-            }
-        }
-        if (block != mintBlock)
-            block = block->pprev;
-        else
+    for (std::size_t i = checkpoint + 1; i < groupCheckpoints.checkpoints.size(); i++) {
+        CBlockIndex *block = groupCheckpoints.checkpoints[i].block;
+        if (block->nHeight > maxHeight)
             break;
+        std::shared_ptr<const CPrivacyBlockData> blockData = pprivacyindex->ReadBlock(block);
+        auto pubCoins = blockData->mintedPubCoins.find(denomAndId);
+        if (pubCoins == blockData->mintedPubCoins.end())
+            continue;
+        for (const CBigNum &coin: pubCoins->second) {
+            if (block != mintBlock)
+                accumulator += libzerocoin::PublicCoin(ZCParams, coin, d);
+        }
     }
 
     return accumulator.getValue();
@@ -929,22 +1034,25 @@ bool CZerocoinState::TestValidity(CChain *chain) {
 
         CBlockIndex *block = coinGroup.second.firstBlock;
         for (;;) {
-            if (block->accumulatorChanges.count(coinGroup.first) > 0) {
-                if (block->mintedPubCoins.count(coinGroup.first) == 0) {
+            std::shared_ptr<const CPrivacyBlockData> blockData = pprivacyindex->ReadBlock(block);
+            auto accChange = blockData->accumulatorChanges.find(coinGroup.first);
+            if (accChange != blockData->accumulatorChanges.end()) {
+                auto pubCoins = blockData->mintedPubCoins.find(coinGroup.first);
+                if (pubCoins == blockData->mintedPubCoins.end()) {
                     fprintf(stderr, "  no minted coins\n");
                     return false;
                 }
 
-                BOOST_FOREACH(const CBigNum &pubCoin, block->mintedPubCoins[coinGroup.first]) {
+                BOOST_FOREACH(const CBigNum &pubCoin, pubCoins->second) {
                     acc += libzerocoin::PublicCoin(zcParams, pubCoin, (libzerocoin::CoinDenomination)coinGroup.first.first);
                 }
 
-                if (acc.getValue() != block->accumulatorChanges[coinGroup.first].first) {
+                if (acc.getValue() != accChange->second.first) {
                     fprintf (stderr, "  accumulator value mismatch at height %d\n", block->nHeight);
                     return false;
                 }
 
-                if (block->accumulatorChanges[coinGroup.first].second != (int)block->mintedPubCoins[coinGroup.first].size()) {
+                if (accChange->second.second != (int)pubCoins->second.size()) {
                     fprintf(stderr, "  number of minted coins mismatch at height %d\n", block->nHeight);
                     return false;
                 }
@@ -972,14 +1080,18 @@ set<CBlockIndex *> CZerocoinState::RecalculateAccumulators(CChain *chain) {
         // Try to calculate accumulator for the first batch of mints. If it doesn't match we need to recalculate the rest of it
         CBlockIndex *block = coinGroup.second.firstBlock;
         for (;;) {
-            if (block->accumulatorChanges.count(coinGroup.first) > 0) {
-                BOOST_FOREACH(const CBigNum &pubCoin, block->mintedPubCoins[coinGroup.first]) {
-                    acc += libzerocoin::PublicCoin(ZCParams, pubCoin, (libzerocoin::CoinDenomination)coinGroup.first.first);
+            std::shared_ptr<const CPrivacyBlockData> blockData = pprivacyindex->ReadBlock(block);
+            auto accChange = blockData->accumulatorChanges.find(coinGroup.first);
+            if (accChange != blockData->accumulatorChanges.end()) {
+                auto pubCoins = blockData->mintedPubCoins.find(coinGroup.first);
+                int nMints = pubCoins != blockData->mintedPubCoins.end() ? pubCoins->second.size() : 0;
+                for (int i = 0; i < nMints; i++) {
+                    acc += libzerocoin::PublicCoin(ZCParams, pubCoins->second[i], (libzerocoin::CoinDenomination)coinGroup.first.first);
                 }
 
                 // First block case is special: do the check
                 if (block == coinGroup.second.firstBlock) {
-                    if (acc.getValue() != block->accumulatorChanges[coinGroup.first].first)
+                    if (acc.getValue() != accChange->second.first)
                         // recalculation is needed
                         LogPrintf("ZerocoinState: accumulator recalculation for denomination=%d, id=%d\n", coinGroup.first.first, coinGroup.first.second);
                     else
@@ -987,8 +1099,16 @@ set<CBlockIndex *> CZerocoinState::RecalculateAccumulators(CChain *chain) {
                         break;
                 }
 
-                block->accumulatorChanges[coinGroup.first] = make_pair(acc.getValue(), (int)block->mintedPubCoins[coinGroup.first].size());
+                CPrivacyBlockData newBlockData = *blockData;
+                newBlockData.accumulatorChanges[coinGroup.first] = make_pair(acc.getValue(), nMints);
+                if (!pprivacyindex->WriteBlock(block, newBlockData))
+                    LogPrintf("ZerocoinState: failed to write recalculated accumulator at height %d\n", block->nHeight);
                 changes.insert(block);
+
+                AccumulatorCheckpoints &groupCheckpoints = accumulatorCheckpoints[coinGroup.first];
+                auto position = groupCheckpoints.positions.find(block->GetBlockHash());
+                if (position != groupCheckpoints.positions.end())
+                    groupCheckpoints.checkpoints[position->second].value = acc.getValue();
             }
 
             if (block != coinGroup.second.lastBlock)
@@ -1052,10 +1172,113 @@ void CZerocoinState::Reset() {
     usedCoinSerials.clear();
     mintedPubCoins.clear();
     latestCoinIds.clear();
+    accumulatorCheckpoints.clear();
     mempoolCoinSerials.clear();
     mempoolCoinMints.clear();
 }
 
+uint256 GetSnapshotBlockHash(const CBlockIndex *index) {
+    return index ? index->GetBlockHash() : uint256();
+}
+
+bool LookupSnapshotBlock(const uint256 &hash, CBlockIndex *&index) {
+    index = NULL;
+    if (hash.IsNull())
+        return true;
+    BlockMap::const_iterator it = mapBlockIndex.find(hash);
+    if (it == mapBlockIndex.end())
+        return false;
+    index = it->second;
+    return true;
+}
+
+void CZerocoinState::WriteSnapshot(CDataStream &s) const {
+    s << (uint64_t)coinGroups.size();
+    for (const PAIRTYPE(PAIRTYPE(int,int), CoinGroupInfo) &coinGroup: coinGroups) {
+        s << coinGroup.first;
+        s << GetSnapshotBlockHash(coinGroup.second.firstBlock) << GetSnapshotBlockHash(coinGroup.second.lastBlock);
+        s << coinGroup.second.nCoins;
+    }
+
+    s << (uint64_t)mintedPubCoins.size();
+    for (const auto &mint: mintedPubCoins)
+        s << mint.first << mint.second.denomination << mint.second.id << mint.second.nHeight;
+
+    s << latestCoinIds;
+
+    s << (uint64_t)usedCoinSerials.size();
+    for (const CBigNum &serial: usedCoinSerials)
+        s << serial;
+
+    s << (uint64_t)accumulatorCheckpoints.size();
+    for (const auto &groupCheckpoints: accumulatorCheckpoints) {
+        s << groupCheckpoints.first << (uint64_t)groupCheckpoints.second.checkpoints.size();
+        for (const AccumulatorCheckpoint &checkpoint: groupCheckpoints.second.checkpoints)
+            s << checkpoint.block->GetBlockHash() << checkpoint.value << checkpoint.nCoins;
+    }
+}
+
+bool CZerocoinState::ReadSnapshot(CDataStream &s) {
+    Reset();
+
+    uint64_t nGroups;
+    s >> nGroups;
+    while (nGroups--) {
+        pair<int,int> denominationAndId;
+        uint256 firstBlockHash, lastBlockHash;
+        CoinGroupInfo coinGroup;
+        s >> denominationAndId >> firstBlockHash >> lastBlockHash >> coinGroup.nCoins;
+        if (!LookupSnapshotBlock(firstBlockHash, coinGroup.firstBlock) || !LookupSnapshotBlock(lastBlockHash, coinGroup.lastBlock)) {
+            Reset();
+            return false;
+        }
+        coinGroups[denominationAndId] = coinGroup;
+    }
+
+    uint64_t nMints;
+    s >> nMints;
+    mintedPubCoins.reserve(nMints);
+    while (nMints--) {
+        CBigNum pubCoin;
+        CMintedCoinInfo coinInfo;
+        s >> pubCoin >> coinInfo.denomination >> coinInfo.id >> coinInfo.nHeight;
+        mintedPubCoins.insert(make_pair(pubCoin, coinInfo));
+    }
+
+    s >> latestCoinIds;
+
+    uint64_t nSerials;
+    s >> nSerials;
+    usedCoinSerials.reserve(nSerials);
+    while (nSerials--) {
+        CBigNum serial;
+        s >> serial;
+        usedCoinSerials.insert(serial);
+    }
+
+    uint64_t nCheckpointGroups;
+    s >> nCheckpointGroups;
+    while (nCheckpointGroups--) {
+        pair<int,int> denominationAndId;
+        uint64_t nCheckpoints;
+        s >> denominationAndId >> nCheckpoints;
+        AccumulatorCheckpoints &groupCheckpoints = accumulatorCheckpoints[denominationAndId];
+        while (nCheckpoints--) {
+            uint256 blockHash;
+            AccumulatorCheckpoint checkpoint;
+            s >> blockHash >> checkpoint.value >> checkpoint.nCoins;
+            if (!LookupSnapshotBlock(blockHash, checkpoint.block) || checkpoint.block == NULL) {
+                Reset();
+                return false;
+            }
+            groupCheckpoints.positions[blockHash] = groupCheckpoints.checkpoints.size();
+            groupCheckpoints.checkpoints.push_back(checkpoint);
+        }
+    }
+
+    return true;
+}
+
 CZerocoinState *CZerocoinState::GetZerocoinState() {
     return &zerocoinState;
 }
@@ -23,16 +23,32 @@ extern libzerocoin::Params *ZCParams;
 
 class CZerocoinTxInfo {
 public:
+    // Spend whose zerocoin proof is verified when the block is connected
+    struct CPendingSpend {
+        libzerocoin::CoinSpend spend;
+        libzerocoin::SpendMetaData metaData;
+        libzerocoin::CoinDenomination denomination;
+        int pubcoinId;
+
+        CPendingSpend(const libzerocoin::CoinSpend &spendIn, const libzerocoin::SpendMetaData &metaDataIn,
+                      libzerocoin::CoinDenomination denominationIn, int pubcoinIdIn) :
+            spend(spendIn), metaData(metaDataIn), denomination(denominationIn), pubcoinId(pubcoinIdIn) { }
+    };
+
     // all the zerocoin transactions encountered so far
     set<uint256> zcTransactions;
     // <denomination, pubCoin> for all the mints
     vector<pair<int,CBigNum> > mints;
     // serial for every spend
     map<CBigNum, int> spentSerials;
+    // zerocoin proofs of the block waiting for verification in ConnectBlock
+    vector<CPendingSpend> pendingSpends;
     // information about transactions in the block is complete
     bool fInfoIsComplete;
+    // all the zerocoin proofs in pendingSpends have been verified (or assumed valid)
+    bool fSpendsVerified;
 
-    CZerocoinTxInfo(): fInfoIsComplete(false) {}
+    CZerocoinTxInfo(): fInfoIsComplete(false), fSpendsVerified(false) {}
     // finalize everything
     void Complete();
 };
@@ -46,13 +62,21 @@ bool CheckZerocoinTransaction(const CTransaction &tx,
     bool isCheckWallet,
     CZerocoinTxInfo *zerocoinTxInfo);
 
+// Verify the zerocoin proofs queued in zerocoinTxInfo while the transactions of the block were checked
+bool CheckZerocoinSpendProofs(CValidationState &state, CZerocoinTxInfo *zerocoinTxInfo, int nHeight);
+
 void DisconnectTipGhost(CBlock &block, CBlockIndex *pindexDelete);
-bool ConnectBlockGhost(CValidationState &state, const CChainParams &chainparams, CBlockIndex *pindexNew, const CBlock *pblock);
+bool ConnectBlockGhost(CValidationState &state, const CChainParams &chainparams, CBlockIndex *pindexNew, const CBlock *pblock, CPrivacyBlockData &privacyData);
 
 int ZerocoinGetNHeight(const CBlockHeader &block);
 
 bool ZerocoinBuildStateFromIndex(CChain *chain, set<CBlockIndex *> &changes);
 
+// Blocks are referred to by hash in the state snapshots, the null hash standing for no block
+uint256 GetSnapshotBlockHash(const CBlockIndex *index);
+// Resolve a block of a snapshot, returns false if it is not in the block index
+bool LookupSnapshotBlock(const uint256 &hash, CBlockIndex *&index);
+
 CBigNum ZerocoinGetSpendSerialNumber(const CTransaction &tx, int i);
 
 /*
@@ -92,6 +116,27 @@ private:
     // Latest IDs of coins by denomination
     map<int, int> latestCoinIds;
 
+    // Accumulator value of a coin group as of a block that changed it
+    struct AccumulatorCheckpoint {
+        CBlockIndex *block;
+        CBigNum value;
+        // coins of the group minted up to and including block
+        int nCoins;
+    };
+
+    struct AccumulatorCheckpoints {
+        // every block with an accumulator change of the group, oldest first
+        std::vector<AccumulatorCheckpoint> checkpoints;
+        // position of a block in checkpoints
+        std::unordered_map<uint256, std::size_t, BlockHasher> positions;
+    };
+
+    // Accumulator checkpoints of the coin groups, so spends and witnesses don't walk the chain
+    map<pair<int, int>, AccumulatorCheckpoints> accumulatorCheckpoints;
+
+    // Index of the latest checkpoint of the group at or below nHeight, -1 if there is none
+    static int FindAccumulatorCheckpoint(const AccumulatorCheckpoints &groupCheckpoints, int nHeight);
+
 public:
     CZerocoinState();
 
@@ -103,13 +148,16 @@ public:
     // serials of mints currently in the mempool mapped to tx hashes
     unordered_map<CBigNum,uint256,CBigNumHash> mempoolCoinMints;
 
-    // Add mint, automatically assigning id to it. Returns id and previous accumulator value (if any)
+    // Add mint, automatically assigning id to it. Returns id and accumulator value of the previous blocks (if any)
     int AddMint(CBlockIndex *index, int denomination, const CBigNum &pubCoin, CBigNum &previousAccValue);
     // Add serial to the list of used ones
     void AddSpend(const CBigNum &serial);
 
     // Add everything from the block to the state
     void AddBlock(CBlockIndex *index);
+    void AddBlock(CBlockIndex *index, const CPrivacyBlockData &blockData);
+    // Record the accumulator changes of a block, after its mints have been added
+    void AddAccumulatorCheckpoints(CBlockIndex *index, const CPrivacyBlockData &blockData);
     // Disconnect block from the chain rolling back mints and spends
     void RemoveBlock(CBlockIndex *index);
 
@@ -126,9 +174,16 @@ public:
     // Returns number of coins satisfying conditions
     int GetAccumulatorValueForSpend(CChain *chain, int maxHeight, int denomination, int id, CBigNum &accumulator, uint256 &blockHash);
 
+    // Accumulator values a spend of the group can be verified against, latest first. A spend naming
+    // its accumulator block only gets the value of that block, or none if it didn't change the accumulator
+    std::vector<CBigNum> GetAccumulatorValuesForVerify(int denomination, int id, const uint256 &accumulatorBlockHash);
+
     // Get witness
     libzerocoin::AccumulatorWitness GetWitnessForSpend(CChain *chain, int maxHeight, int denomination, int id, const CBigNum &pubCoin);
 
+    // Add to the witness value of a coin every coin of its group minted after fromBlock, up to maxHeight
+    void AdvanceWitnessForSpend(CChain *chain, int maxHeight, int denomination, int id, const CBlockIndex *fromBlock, CBigNum &witnessValue);
+
     // Return height of mint transaction and id of minted coin
     int GetMintedCoinHeightAndId(const CBigNum &pubCoin, int denomination, int &id);
 
@@ -137,6 +192,11 @@ public:
     // Reset to initial values
     void Reset();
 
+    // Save the coin groups, mints and spends to a snapshot of the state
+    void WriteSnapshot(CDataStream &s) const;
+    // Replace the state by a snapshot, returns false if it does not match the block index
+    bool ReadSnapshot(CDataStream &s);
+
     // Test function
     bool TestValidity(CChain *chain);
 
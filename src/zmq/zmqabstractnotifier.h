@@ -7,8 +7,13 @@
 
 #include <zmq/zmqconfig.h>
 
+#include <memory>
+
+class CBlock;
 class CBlockIndex;
+class COutPoint;
 class CZMQAbstractNotifier;
+enum class MemPoolRemovalReason;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
@@ -32,8 +37,14 @@ public:
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
+    // pblock is the new tip when it is still in memory, null otherwise
+    virtual bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    // Called for every connected block, unlike NotifyBlock which only sees new tips
+    virtual bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex);
+    virtual bool NotifyTransactionLock(const CTransaction &transaction);
+    virtual bool NotifyGhostnodeState(const COutPoint &outpoint, int nState);
+    virtual bool NotifyMempoolSequence(const CTransaction &transaction, bool fAdded, MemPoolRemovalReason reason, uint64_t nSequence);
 
 protected:
     void *psocket;
@@ -5,6 +5,7 @@
 #include <zmq/zmqnotificationinterface.h>
 #include <zmq/zmqpublishnotifier.h>
 
+#include <lifecycle.h>
 #include <version.h>
 #include <validation.h>
 #include <streams.h>
@@ -39,6 +40,12 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubsigmamint"] = CZMQAbstractNotifier::Create<CZMQPublishSigmaMintNotifier>;
+    factories["pubsigmaspend"] = CZMQAbstractNotifier::Create<CZMQPublishSigmaSpendNotifier>;
+    factories["pubstake"] = CZMQAbstractNotifier::Create<CZMQPublishStakeNotifier>;
+    factories["pubghostnode"] = CZMQAbstractNotifier::Create<CZMQPublishGhostnodeNotifier>;
+    factories["pubtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishTransactionLockNotifier>;
+    factories["pubmempoolseq"] = CZMQAbstractNotifier::Create<CZMQPublishMempoolSequenceNotifier>;
 
     for (const auto& entry : factories)
     {
@@ -103,6 +110,8 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    StartZMQPublisher(gArgs.GetArg("-zmqpubqueuesize", DEFAULT_ZMQ_QUEUE_SIZE));
+
     return true;
 }
 
@@ -112,6 +121,7 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint(BCLog::ZMQ, "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        StopZMQPublisher();
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
@@ -126,13 +136,20 @@ void CZMQNotificationInterface::Shutdown()
 
 void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
 {
+    std::shared_ptr<const CBlock> pblock;
+    pblock.swap(pblockConnected);
+
     if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
         return;
 
+    // BlockConnected for the new tip is queued right before this, saving a disk read
+    if (pblock && pblock->GetHash() != pindexNew->GetBlockHash())
+        pblock.reset();
+
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
+        if (notifier->NotifyBlock(pindexNew, pblock))
         {
             i++;
         }
@@ -142,6 +159,7 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, co
             i = notifiers.erase(i);
         }
     }
+    TraceLifecycle(LifecycleObject::BLOCK, pindexNew->GetBlockHash(), LifecycleStage::ZMQ_PUBLISHED);
 }
 
 void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx)
@@ -163,6 +181,25 @@ void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef&
             i = notifiers.erase(i);
         }
     }
+    TraceLifecycle(LifecycleObject::TX, tx.GetHash(), LifecycleStage::ZMQ_PUBLISHED);
+}
+
+template <typename Function>
+void CZMQNotificationInterface::NotifyAll(const Function& notify)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notify(notifier))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
 }
 
 void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted)
@@ -171,6 +208,25 @@ void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBloc
         // Do a normal notify for each transaction added in the block
         TransactionAddedToMempool(ptx);
     }
+
+    NotifyAll([&](CZMQAbstractNotifier* notifier) { return notifier->NotifyBlockConnected(*pblock, pindexConnected); });
+
+    pblockConnected = pblock;
+}
+
+void CZMQNotificationInterface::NotifyTransactionLock(const CTransactionRef& ptx)
+{
+    NotifyAll([&](CZMQAbstractNotifier* notifier) { return notifier->NotifyTransactionLock(*ptx); });
+}
+
+void CZMQNotificationInterface::NotifyGhostnodeState(const COutPoint& outpoint, int nState)
+{
+    NotifyAll([&](CZMQAbstractNotifier* notifier) { return notifier->NotifyGhostnodeState(outpoint, nState); });
+}
+
+void CZMQNotificationInterface::MempoolSequence(const CTransactionRef& ptx, bool fAdded, MemPoolRemovalReason reason, uint64_t nSequence)
+{
+    NotifyAll([&](CZMQAbstractNotifier* notifier) { return notifier->NotifyMempoolSequence(*ptx, fAdded, reason, nSequence); });
 }
 
 void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock)
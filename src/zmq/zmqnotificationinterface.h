@@ -29,12 +29,21 @@ protected:
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void NotifyTransactionLock(const CTransactionRef &ptx) override;
+    void NotifyGhostnodeState(const COutPoint &outpoint, int nState) override;
+    void MempoolSequence(const CTransactionRef &ptx, bool fAdded, MemPoolRemovalReason reason, uint64_t nSequence) override;
 
 private:
     CZMQNotificationInterface();
 
+    // Calls notify on every notifier, dropping those that fail
+    template <typename Function>
+    void NotifyAll(const Function& notify);
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+    //! Last connected block, handed to NotifyBlock when it becomes the tip
+    std::shared_ptr<const CBlock> pblockConnected;
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
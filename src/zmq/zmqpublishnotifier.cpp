@@ -9,6 +9,16 @@
 #include <validation.h>
 #include <util.h>
 #include <rpc/server.h>
+#include <txmempool.h>
+#include <crypto/common.h>
+#include <zerocoin/sigma.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -16,6 +26,33 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_SIGMAMINT  = "sigmamint";
+static const char *MSG_SIGMASPEND = "sigmaspend";
+static const char *MSG_STAKE      = "stake";
+static const char *MSG_GHOSTNODE  = "ghostnode";
+static const char *MSG_TXLOCK     = "txlock";
+static const char *MSG_MEMPOOLSEQ = "mempoolseq";
+
+// Hashes go out in the byte order they are displayed in, like hashblock and hashtx
+static void PushHash(std::vector<unsigned char>& data, const uint256& hash)
+{
+    for (unsigned int i = 0; i < 32; i++)
+        data.push_back(hash.begin()[31 - i]);
+}
+
+static void PushLE32(std::vector<unsigned char>& data, uint32_t n)
+{
+    unsigned char buf[4];
+    WriteLE32(buf, n);
+    data.insert(data.end(), buf, buf + 4);
+}
+
+static void PushLE64(std::vector<unsigned char>& data, uint64_t n)
+{
+    unsigned char buf[8];
+    WriteLE64(buf, n);
+    data.insert(data.end(), buf, buf + 8);
+}
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -60,6 +97,178 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
     return 0;
 }
 
+/**
+ * Sends the messages of all publish notifiers on its own thread, so slow
+ * subscribers and raw block serialization stay off the validation callbacks.
+ */
+class CZMQPublisher
+{
+private:
+    struct Message
+    {
+        CZMQAbstractPublishNotifier* notifier;
+        const char* command;
+        std::vector<unsigned char> data;
+        std::shared_ptr<const CBlock> pblock; //!< serialized into data by the publisher thread
+        uint32_t nSequence;
+    };
+
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::deque<Message> queue;
+    std::set<CZMQAbstractPublishNotifier*> setNotifiers;
+    //! Held while a message is sent, so a notifier can wait for its last one
+    std::mutex mtxSend;
+    std::thread thread;
+    size_t nMaxQueued;
+    bool fRunning;
+    bool fStop;
+
+    void ThreadPublish();
+    void Send(Message& msg);
+
+public:
+    CZMQPublisher() : nMaxQueued(DEFAULT_ZMQ_QUEUE_SIZE), fRunning(false), fStop(false) {}
+
+    void Start(unsigned int nMaxQueuedIn);
+    void Stop();
+    bool Push(CZMQAbstractPublishNotifier* notifier, const char* command, std::vector<unsigned char>&& data,
+              const std::shared_ptr<const CBlock>& pblock, uint32_t nSequence);
+    void Register(CZMQAbstractPublishNotifier* notifier);
+    void Unregister(CZMQAbstractPublishNotifier* notifier);
+    std::vector<CZMQPublisherStats> GetStats();
+};
+
+static CZMQPublisher publisher;
+
+void CZMQPublisher::Start(unsigned int nMaxQueuedIn)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (fRunning)
+        return;
+    nMaxQueued = std::max(nMaxQueuedIn, 1u);
+    fStop = false;
+    fRunning = true;
+    thread = std::thread(&CZMQPublisher::ThreadPublish, this);
+}
+
+void CZMQPublisher::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!fRunning)
+            return;
+        fStop = true;
+        fRunning = false;
+    }
+    cond.notify_all();
+    thread.join();
+}
+
+void CZMQPublisher::ThreadPublish()
+{
+    RenameThread("nix-zmqpub");
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        cond.wait(lock, [this] { return fStop || !queue.empty(); });
+        // What is already queued still goes out on shutdown; PUB sockets never block
+        if (queue.empty())
+            return;
+
+        Message msg = std::move(queue.front());
+        queue.pop_front();
+        std::unique_lock<std::mutex> lockSend(mtxSend);
+        lock.unlock();
+        Send(msg);
+        lockSend.unlock();
+        lock.lock();
+    }
+}
+
+void CZMQPublisher::Send(Message& msg)
+{
+    if (msg.pblock) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+        ss << *msg.pblock;
+        msg.data.assign(ss.begin(), ss.end());
+        msg.pblock.reset();
+    }
+
+    if (msg.notifier->SendNow(msg.command, msg.data.data(), msg.data.size(), msg.nSequence))
+        msg.notifier->nPublished++;
+    else
+        msg.notifier->nDropped++;
+}
+
+bool CZMQPublisher::Push(CZMQAbstractPublishNotifier* notifier, const char* command, std::vector<unsigned char>&& data,
+                         const std::shared_ptr<const CBlock>& pblock, uint32_t nSequence)
+{
+    Message msg{notifier, command, std::move(data), pblock, nSequence};
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (fRunning) {
+            if (queue.size() >= nMaxQueued) {
+                // Drop the newest message rather than hold up validation
+                if (notifier->nDropped++ == 0)
+                    LogPrintf("zmq: Publisher queue full, dropping %s messages (-zmqpubqueuesize=%u)\n", command, nMaxQueued);
+                return false;
+            }
+            queue.push_back(std::move(msg));
+            cond.notify_one();
+            return true;
+        }
+    }
+
+    // No publisher thread, send on the caller's thread
+    std::lock_guard<std::mutex> lockSend(mtxSend);
+    Send(msg);
+    return true;
+}
+
+void CZMQPublisher::Register(CZMQAbstractPublishNotifier* notifier)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    setNotifiers.insert(notifier);
+}
+
+void CZMQPublisher::Unregister(CZMQAbstractPublishNotifier* notifier)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    setNotifiers.erase(notifier);
+    for (std::deque<Message>::iterator it = queue.begin(); it != queue.end(); ) {
+        if (it->notifier == notifier)
+            it = queue.erase(it);
+        else
+            ++it;
+    }
+    // Wait for a message of this notifier that may be on its way out
+    std::lock_guard<std::mutex> lockSend(mtxSend);
+}
+
+std::vector<CZMQPublisherStats> CZMQPublisher::GetStats()
+{
+    std::vector<CZMQPublisherStats> vStats;
+    std::lock_guard<std::mutex> lock(mtx);
+    for (CZMQAbstractPublishNotifier* notifier : setNotifiers)
+        vStats.push_back(CZMQPublisherStats{notifier->GetType(), notifier->GetAddress(), notifier->nPublished, notifier->nDropped});
+    return vStats;
+}
+
+void StartZMQPublisher(unsigned int nMaxQueued)
+{
+    publisher.Start(nMaxQueued);
+}
+
+void StopZMQPublisher()
+{
+    publisher.Stop();
+}
+
+std::vector<CZMQPublisherStats> GetZMQPublisherStats()
+{
+    return publisher.GetStats();
+}
+
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
     assert(!psocket);
@@ -86,6 +295,7 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 
         // register this notifier for the address, so it can be reused for other publish notifier
         mapPublishNotifiers.insert(std::make_pair(address, this));
+        publisher.Register(this);
         return true;
     }
     else
@@ -94,6 +304,7 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 
         psocket = i->second->psocket;
         mapPublishNotifiers.insert(std::make_pair(address, this));
+        publisher.Register(this);
 
         return true;
     }
@@ -103,6 +314,8 @@ void CZMQAbstractPublishNotifier::Shutdown()
 {
     assert(psocket);
 
+    publisher.Unregister(this);
+
     int count = mapPublishNotifiers.count(address);
 
     // remove this notifier from the list of publishers using this address
@@ -133,20 +346,29 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
 {
     assert(psocket);
 
-    /* send three parts, command & data & a LE 4byte sequence number */
-    unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), nullptr);
-    if (rc == -1)
-        return false;
+    const unsigned char* begin = static_cast<const unsigned char*>(data);
+    publisher.Push(this, command, std::vector<unsigned char>(begin, begin + size), nullptr, nSequence++);
+    return true;
+}
 
-    /* increment memory only sequence number after sending */
-    nSequence++;
+bool CZMQAbstractPublishNotifier::SendBlock(const char *command, const std::shared_ptr<const CBlock>& pblock)
+{
+    assert(psocket);
 
+    publisher.Push(this, command, std::vector<unsigned char>(), pblock, nSequence++);
     return true;
 }
 
-bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQAbstractPublishNotifier::SendNow(const char *command, const void* data, size_t size, uint32_t nSequenceIn)
+{
+    /* send three parts, command & data & a LE 4byte sequence number */
+    unsigned char msgseq[sizeof(uint32_t)];
+    WriteLE32(&msgseq[0], nSequenceIn);
+    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), nullptr);
+    return rc != -1;
+}
+
+bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& /*pblock*/)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish hashblock %s\n", hash.GetHex());
@@ -166,25 +388,119 @@ bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &t
     return SendMessage(MSG_HASHTX, data, 32);
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock)
 {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
+    if (pblock)
+        return SendBlock(MSG_RAWBLOCK, pblock);
+
     const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    std::shared_ptr<const CBlock> pblockRead;
+    if(!ReadBlockFromDisk(pblockRead, pindex, consensusParams))
     {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
+        zmqError("Can't read block from disk");
+        return false;
+    }
+
+    return SendBlock(MSG_RAWBLOCK, pblockRead);
+}
+
+bool CZMQPublishSigmaMintNotifier::NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    // txid (32), output index (4), denomination in satoshis (8), public coin hash (32)
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->IsSigmaMint())
+            continue;
+        for (uint32_t n = 0; n < tx->vout.size(); n++) {
+            const CTxOut& out = tx->vout[n];
+            if (!out.scriptPubKey.IsSigmaMint())
+                continue;
+            std::vector<unsigned char> data;
+            PushHash(data, tx->GetHash());
+            PushLE32(data, n);
+            PushLE64(data, out.nValue);
+            PushHash(data, GetPubCoinValueHash(ParseSigmaMintScript(out.scriptPubKey)));
+            if (!SendMessage(MSG_SIGMAMINT, data.data(), data.size()))
+                return false;
         }
+    }
+    return true;
+}
 
-        ss << block;
+bool CZMQPublishSigmaSpendNotifier::NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    // txid (32), input index (4), denomination in satoshis (8), serial number hash (32)
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->IsSigmaSpend())
+            continue;
+        for (uint32_t n = 0; n < tx->vin.size(); n++) {
+            if (!tx->vin[n].scriptSig.IsSigmaSpend())
+                continue;
+            std::vector<unsigned char> data;
+            try {
+                std::pair<sigma::CoinSpendView, uint32_t> spend = ParseSigmaSpendView(tx->vin[n]);
+                PushHash(data, tx->GetHash());
+                PushLE32(data, n);
+                PushLE64(data, spend.first.getIntDenomination());
+                PushHash(data, GetSerialHash(spend.first.getCoinSerialNumber()));
+            } catch (const std::exception& e) {
+                LogPrint(BCLog::ZMQ, "zmq: Skipping unparsable sigma spend in %s: %s\n", tx->GetHash().GetHex(), e.what());
+                continue;
+            }
+            if (!SendMessage(MSG_SIGMASPEND, data.data(), data.size()))
+                return false;
+        }
     }
+    return true;
+}
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+bool CZMQPublishStakeNotifier::NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    if (!block.IsProofOfStake() || block.vtx[0]->vin.empty())
+        return true;
+
+    // block hash (32), height (4), coinstake txid (32), staked outpoint txid (32) and index (4)
+    const CTransaction& coinstake = *block.vtx[0];
+    std::vector<unsigned char> data;
+    PushHash(data, pindex->GetBlockHash());
+    PushLE32(data, pindex->nHeight);
+    PushHash(data, coinstake.GetHash());
+    PushHash(data, coinstake.vin[0].prevout.hash);
+    PushLE32(data, coinstake.vin[0].prevout.n);
+    LogPrint(BCLog::ZMQ, "zmq: Publish stake %s\n", pindex->GetBlockHash().GetHex());
+    return SendMessage(MSG_STAKE, data.data(), data.size());
+}
+
+bool CZMQPublishGhostnodeNotifier::NotifyGhostnodeState(const COutPoint &outpoint, int nState)
+{
+    // collateral txid (32) and index (4), new GHOSTNODE_* state (4)
+    std::vector<unsigned char> data;
+    PushHash(data, outpoint.hash);
+    PushLE32(data, outpoint.n);
+    PushLE32(data, nState);
+    LogPrint(BCLog::ZMQ, "zmq: Publish ghostnode %s state %d\n", outpoint.ToStringShort(), nState);
+    return SendMessage(MSG_GHOSTNODE, data.data(), data.size());
+}
+
+bool CZMQPublishTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint(BCLog::ZMQ, "zmq: Publish txlock %s\n", hash.GetHex());
+    std::vector<unsigned char> data;
+    PushHash(data, hash);
+    return SendMessage(MSG_TXLOCK, data.data(), data.size());
+}
+
+bool CZMQPublishMempoolSequenceNotifier::NotifyMempoolSequence(const CTransaction &transaction, bool fAdded, MemPoolRemovalReason reason, uint64_t nSequence)
+{
+    // txid (32), 'A' or 'R' (1), removal reason (1), mempool sequence number (8)
+    std::vector<unsigned char> data;
+    PushHash(data, transaction.GetHash());
+    data.push_back(fAdded ? 'A' : 'R');
+    data.push_back(static_cast<unsigned char>(reason));
+    PushLE64(data, nSequence);
+    return SendMessage(MSG_MEMPOOLSEQ, data.data(), data.size());
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
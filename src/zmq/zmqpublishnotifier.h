@@ -7,22 +7,57 @@
 
 #include <zmq/zmqabstractnotifier.h>
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
 class CBlockIndex;
 
+//! -zmqpubqueuesize default
+static const unsigned int DEFAULT_ZMQ_QUEUE_SIZE = 10000;
+
+/** Start the thread that sends the messages queued by publish notifiers.
+ *  At most nMaxQueued messages wait for it; further ones are dropped. */
+void StartZMQPublisher(unsigned int nMaxQueued);
+/** Send what is still queued and stop the publisher thread */
+void StopZMQPublisher();
+
+struct CZMQPublisherStats
+{
+    std::string type;
+    std::string address;
+    uint64_t nPublished;
+    uint64_t nDropped;
+};
+
+/** Counters of every initialized publish notifier */
+std::vector<CZMQPublisherStats> GetZMQPublisherStats();
+
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
     uint32_t nSequence; //!< upcounting per message sequence number
 
 public:
+    std::atomic<uint64_t> nPublished;
+    std::atomic<uint64_t> nDropped; //!< messages not sent because the queue was full or zmq failed
 
-    /* send zmq multipart message
+    CZMQAbstractPublishNotifier() : nSequence(0), nPublished(0), nDropped(0) {}
+
+    /* queue zmq multipart message for the publisher thread
        parts:
           * command
           * data
           * message sequence number
+
+       The sequence number is taken when queueing, so dropped messages
+       show up as gaps to subscribers.
     */
     bool SendMessage(const char *command, const void* data, size_t size);
+    /* as SendMessage, with the block serialized on the publisher thread */
+    bool SendBlock(const char *command, const std::shared_ptr<const CBlock>& pblock);
+    /* send a message right away, only called on the publisher thread */
+    bool SendNow(const char *command, const void* data, size_t size, uint32_t nSequenceIn);
 
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
@@ -31,7 +66,7 @@ public:
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) override;
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -43,7 +78,7 @@ public:
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) override;
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -52,4 +87,40 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+class CZMQPublishSigmaMintNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex) override;
+};
+
+class CZMQPublishSigmaSpendNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex) override;
+};
+
+class CZMQPublishStakeNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex) override;
+};
+
+class CZMQPublishGhostnodeNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyGhostnodeState(const COutPoint &outpoint, int nState) override;
+};
+
+class CZMQPublishTransactionLockNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionLock(const CTransaction &transaction) override;
+};
+
+class CZMQPublishMempoolSequenceNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyMempoolSequence(const CTransaction &transaction, bool fAdded, MemPoolRemovalReason reason, uint64_t nSequence) override;
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H